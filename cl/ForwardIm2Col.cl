@@ -14,37 +14,43 @@
 
 // Kernel for fast unfold+copy
 // (adapted from Caffe: https://github.com/BVLC/caffe/blob/master/src/caffe/layers/conv_layer.cu)
+// unfolds n / ({{channels}} * colSize * colSize) consecutive images side by side: row r of
+// data_col holds image b's values at [r * colsStride + b * colSize * colSize], so with
+// colsStride == numImages * colSize * colSize, data_col is one column-major
+// [numImages * colSize * colSize][channels * filterSize * filterSize] matrix
 kernel void im2col(
     const int n,
     global float const * im_data, int im_offset,
+    const int colsStride,
     global float* data_col) {
-  global const float *data_im = im_data + im_offset;
-
   CL_KERNEL_LOOP(index, n) {
     int w_out = index % {{colSize}};
     index /= {{colSize}};
     int h_out = index % {{colSize}};
-    int channel_in = index / {{colSize}};
+    index /= {{colSize}};
+    int channel_in = index % {{channels}};
+    int b = index / {{channels}};
     int channel_out = channel_in * {{filterSize}} * {{filterSize}};
     int h_in = h_out * {{stride}} - {{padding}};
     int w_in = w_out * {{stride}} - {{padding}};
-    data_col += (channel_out * {{colSize}} + h_out) * {{colSize}} + w_out;
-    data_im += (channel_in * {{size}} + h_in) * {{size}} + w_in;
+    global float *col = data_col + channel_out * colsStride + (b * {{colSize}} + h_out) * {{colSize}} + w_out;
+    global const float *im = im_data + im_offset + ((b * {{channels}} + channel_in) * {{size}} + h_in) * {{size}} + w_in;
     for (int i = 0; i < {{filterSize}}; ++i) {
       for (int j = 0; j < {{filterSize}}; ++j) {
         int h = h_in + i;
         int w = w_in + j;
-        *data_col = (h >= 0 && w >= 0 && h < {{size}} && w < {{size}}) ?
-          data_im[i * {{size}} + j] : 0;
-        data_col += {{colSize}} * {{colSize}};
+        *col = (h >= 0 && w >= 0 && h < {{size}} && w < {{size}}) ?
+          im[i * {{size}} + j] : 0;
+        col += colsStride;
       }
     }
   }
 }
 
+// inverse of im2col: n / ({{channels}} * size * size) images, laid out as above
 kernel void col2im(
     const int n,
-    global float const *data_col,
+    global float const *data_col, const int colsStride,
     global float* im_data, int im_offset) {
   global float *data_im = im_data + im_offset;
 
@@ -52,16 +58,17 @@ kernel void col2im(
     float val = 0;
     int w = index % {{size}} + {{padding}};
     int h = (index / {{size}}) % {{size}} + {{padding}};
-    int c = index / ({{size}} * {{size}});
+    int c = (index / ({{size}} * {{size}})) % {{channels}};
+    int b = index / ({{channels}} * {{size}} * {{size}});
     // compute the start and end of the output
     int w_col_start = (w < {{filterSize}}) ? 0 : (w - {{filterSize}}) / {{stride}} + 1;
     int w_col_end = min(w / {{stride}} + 1, {{colSize}});
     int h_col_start = (h < {{filterSize}}) ? 0 : (h - {{filterSize}}) / {{stride}} + 1;
     int h_col_end = min(h / {{stride}} + 1, {{colSize}});
 
-    int offset = (c * {{filterSize}} * {{filterSize}} + h * {{filterSize}} + w) * {{colSize}} * {{colSize}};
-    int coeff_h_col = (1 - {{stride}} * {{filterSize}} * {{colSize}}) * {{colSize}};
-    int coeff_w_col = (1 - {{stride}} * {{colSize}} * {{colSize}});
+    int offset = (c * {{filterSize}} * {{filterSize}} + h * {{filterSize}} + w) * colsStride + b * {{colSize}} * {{colSize}};
+    int coeff_h_col = {{colSize}} - {{stride}} * {{filterSize}} * colsStride;
+    int coeff_w_col = 1 - {{stride}} * colsStride;
     for (int h_col = h_col_start; h_col < h_col_end; ++h_col) {
       for (int w_col = w_col_start; w_col < w_col_end; ++w_col) {
         val += data_col[offset + h_col * coeff_h_col + w_col * coeff_w_col];
@@ -71,3 +78,30 @@ kernel void col2im(
   }
 }
 
+// swaps the outer two dimensions, between the layer layout,
+// [numImages][numFilters][colSize * colSize], and [numFilters][numImages][colSize * colSize],
+// which is one column-major [numImages * colSize * colSize][numFilters] matrix, for gemm
+kernel void cubesToPlanes(
+    const int n, const int numImages,
+    global float const *cubes, int cubesOffset,
+    global float *planes) {
+  CL_KERNEL_LOOP(index, n) {
+    int pixel = index % ({{colSize}} * {{colSize}});
+    int filter = (index / ({{colSize}} * {{colSize}})) % {{numFilters}};
+    int b = index / ({{numFilters}} * {{colSize}} * {{colSize}});
+    planes[(filter * numImages + b) * {{colSize}} * {{colSize}} + pixel] = cubes[cubesOffset + index];
+  }
+}
+
+kernel void planesToCubes(
+    const int n, const int numImages,
+    global float const *planes,
+    global float *cubes, int cubesOffset) {
+  CL_KERNEL_LOOP(index, n) {
+    int pixel = index % ({{colSize}} * {{colSize}});
+    int filter = (index / ({{colSize}} * {{colSize}})) % {{numFilters}};
+    int b = index / ({{numFilters}} * {{colSize}} * {{colSize}});
+    cubes[cubesOffset + index] = planes[(filter * numImages + b) * {{colSize}} * {{colSize}} + pixel];
+  }
+}
+
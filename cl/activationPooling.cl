@@ -0,0 +1,104 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// an activation layer, followed by a max-pooling layer, in one pass, so the
+// activated values never go to global memory
+
+// expected defines:
+// one of: [ TANH | RELU | LINEAR | SIGMOID | SCALEDTANH | ELU ]
+// gNumPlanes, gInputSize, gInputSizeSquared, gOutputSize, gOutputSizeSquared, gPoolingSize
+
+#ifdef TANH
+    #define ACTIVATION_FUNCTION(output) (tanh(output))
+    #define ACTIVATION_DERIV(output) (1 - output * output)
+#elif defined SCALEDTANH
+    #define ACTIVATION_FUNCTION(output) (1.7159f * tanh(0.66667f * output))
+    #define ACTIVATION_DERIV(output) (0.66667f * (1.7159f - 1 / 1.7159f * output * output) )
+#elif defined SIGMOID
+    #define ACTIVATION_FUNCTION(output) (1.0f / (1 + exp(-output)))
+    #define ACTIVATION_DERIV(output) (output * (1 - output) )
+#elif defined RELU
+    #define ACTIVATION_FUNCTION(output) (output> 0 ? output : 0)
+    #define ACTIVATION_DERIV(output) (output > 0 ? 1 : 0)
+#elif defined ELU
+    #define ACTIVATION_FUNCTION(output) (output> 0 ? output : exp(output) - 1)
+    #define ACTIVATION_DERIV(output) (output > 0 ? 1 : output + 1)
+#elif defined LINEAR
+    #define ACTIVATION_FUNCTION(output) (output)
+    #define ACTIVATION_DERIV(output) (1.0f)
+#endif
+
+// same as forwardNaive in pooling.cl, but activating each input first
+// globalId: [n][plane][outputRow][outputCol]
+#ifdef ACTIVATION_FUNCTION // protect against not defined
+kernel void forwardNaive(const int batchSize, global const float *input, global int *selectors, global float *output) {
+    const int globalId = get_global_id(0);
+
+    const int intraImageOffset = globalId % gOutputSizeSquared;
+    const int outputRow = intraImageOffset / gOutputSize;
+    const int outputCol = intraImageOffset % gOutputSize;
+
+    const int image2dIdx = globalId / gOutputSizeSquared;
+    const int plane = image2dIdx % gNumPlanes;
+    const int n = image2dIdx / gNumPlanes;
+
+    if (n >= batchSize) {
+        return;
+    }
+
+    const int inputRow = outputRow * gPoolingSize;
+    const int inputCol = outputCol * gPoolingSize;
+    const int inputImageOffset = (n * gNumPlanes + plane) * gInputSizeSquared;
+    int selector = 0;
+    int poolInputOffset = inputImageOffset + inputRow * gInputSize + inputCol;
+    float maxValue = ACTIVATION_FUNCTION(input[ poolInputOffset ]);
+    for (int dRow = 0; dRow < gPoolingSize; dRow++) {
+        for (int dCol = 0; dCol < gPoolingSize; dCol++) {
+            bool process = (inputRow + dRow < gInputSize) && (inputCol + dCol < gInputSize);
+            if (process) {
+                float thisValue = ACTIVATION_FUNCTION(input[ poolInputOffset + dRow * gInputSize + dCol ]);
+                if (thisValue > maxValue) {
+                    maxValue = thisValue;
+                    selector = dRow * gPoolingSize + dCol;
+                }
+            }
+        }
+    }
+    output[ globalId ] = maxValue;
+    selectors[ globalId ] = selector;
+}
+#endif
+
+// the pooled output is the activation's output at the selected position, so
+// the derivative can be taken from it directly
+// gradInput should be zeroed first
+// globalId: [n][plane][outputRow][outputCol]
+#ifdef ACTIVATION_DERIV
+kernel void backward(const int batchSize, global const float *output,
+        global const float *gradOutput, global const int *selectors, global float *gradInput) {
+    const int globalId = get_global_id(0);
+
+    const int intraImageOffset = globalId % gOutputSizeSquared;
+    const int outputRow = intraImageOffset / gOutputSize;
+    const int outputCol = intraImageOffset % gOutputSize;
+
+    const int image2dIdx = globalId / gOutputSizeSquared;
+    const int plane = image2dIdx % gNumPlanes;
+    const int n = image2dIdx / gNumPlanes;
+
+    if (n >= batchSize) {
+        return;
+    }
+
+    const int selector = selectors[globalId];
+    const int inputRow = outputRow * gPoolingSize + selector / gPoolingSize;
+    const int inputCol = outputCol * gPoolingSize + selector % gPoolingSize;
+    const int inputIndex = ((n * gNumPlanes + plane) * gInputSize + inputRow) * gInputSize + inputCol;
+    const float pooledOutput = output[globalId];
+    gradInput[inputIndex] = ACTIVATION_DERIV(pooledOutput) * gradOutput[globalId];
+}
+#endif
+
@@ -28,3 +28,52 @@ kernel void backpropNaive(
     output[globalId] = mask[globalId] == 1 ? gradOutput[globalId] : 0.0f;
 }
 
+
+// philox4x32-10 counter-based rng (Salmon et al, 'Parallel random numbers: as easy
+// as 1, 2, 3', 2011): each work item turns (its id, batchCounter) into 4 independent
+// uints, so masks depend only on (key, batchCounter), not on the device or workgroup size
+// mask is 0 (drop) where the uint is below threshold, ie with probability dropRatio
+// key0, key1, batchCounter and threshold are really uints, passed as ints
+kernel void generateMasks(
+        const int N,
+        const int key0,
+        const int key1,
+        const int batchCounter,
+        const int threshold,
+        global unsigned char *mask) {
+    const int globalId = get_global_id(0);
+    const int base = globalId << 2;
+    if (base >= N) {
+        return;
+    }
+    uint c0 = (uint)globalId;
+    uint c1 = (uint)batchCounter;
+    uint c2 = 0;
+    uint c3 = 0;
+    uint k0 = (uint)key0;
+    uint k1 = (uint)key1;
+    for (int round = 0; round < 10; round++) {
+        const uint hi0 = mul_hi(0xD2511F53u, c0);
+        const uint lo0 = 0xD2511F53u * c0;
+        const uint hi1 = mul_hi(0xCD9E8D57u, c2);
+        const uint lo1 = 0xCD9E8D57u * c2;
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    const uint uThreshold = (uint)threshold;
+    mask[base] = c0 < uThreshold ? 0 : 1;
+    if (base + 1 < N) {
+        mask[base + 1] = c1 < uThreshold ? 0 : 1;
+    }
+    if (base + 2 < N) {
+        mask[base + 2] = c2 < uThreshold ? 0 : 1;
+    }
+    if (base + 3 < N) {
+        mask[base + 3] = c3 < uThreshold ? 0 : 1;
+    }
+}
+
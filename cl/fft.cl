@@ -0,0 +1,216 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// convolution in the frequency domain: each plane is zero-padded into a gSize x gSize
+// square, gSize a power of two, large enough that the circular convolution doesn't
+// wrap, and transformed with a radix-2 fft, one work-item per row, then per column
+// spectra are [plane][gSize][gSize] complex, float2 (re, im)
+// with margin the layer's padding:
+// forward: output = ifft(sum over inputPlanes of fft(input at margin) * conj(fft(filters)))
+// backward: gradInput = ifft(sum over filters of fft(gradOutput) * fft(filters)), cropped at margin
+// gradWeights: ifft(sum over images of fft(input at margin) * conj(fft(gradOutput)))
+
+// expected defines:
+// gSize, gLogSize, gSizeSquared
+// gInputPlanes, gNumFilters
+
+// in-place radix-2 fft of one row or column; inverse is unscaled
+// twiddles[j] = exp(-2 pi i j / gSize), for j < gSize / 2
+void fft(float *re, float *im, global const float2 *twiddles, const int inverse) {
+    for (int i = 0; i < gSize; i++) {
+        int j = 0;
+        for (int bit = 0; bit < gLogSize; bit++) {
+            j |= ((i >> bit) & 1) << (gLogSize - 1 - bit);
+        }
+        if (i < j) {
+            float temp = re[i];
+            re[i] = re[j];
+            re[j] = temp;
+            temp = im[i];
+            im[i] = im[j];
+            im[j] = temp;
+        }
+    }
+    for (int half = 1; half < gSize; half <<= 1) {
+        const int step = gSize / (2 * half);
+        for (int start = 0; start < gSize; start += 2 * half) {
+            for (int j = 0; j < half; j++) {
+                const float2 twiddle = twiddles[j * step];
+                const float wr = twiddle.x;
+                const float wi = inverse ? -twiddle.y : twiddle.y;
+                const int a = start + j;
+                const int b = a + half;
+                const float vr = re[b] * wr - im[b] * wi;
+                const float vi = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - vr;
+                im[b] = im[a] - vi;
+                re[a] += vr;
+                im[a] += vi;
+            }
+        }
+    }
+}
+
+// places each sourceSize x sourceSize source plane at (margin, margin), zero elsewhere,
+// and transforms the rows
+// globalId: [plane][row]
+kernel void padAndFftRows(const int numPlanes, global const float *source, const int sourceOffset,
+        const int sourceSize, const int margin, global const float2 *twiddles, global float2 *spectra) {
+    const int globalId = get_global_id(0);
+    const int plane = globalId / gSize;
+    const int row = globalId % gSize;
+    if (plane >= numPlanes) {
+        return;
+    }
+    global float2 *spectrumRow = spectra + (plane * gSize + row) * gSize;
+    const int sourceRow = row - margin;
+    if (sourceRow < 0 || sourceRow >= sourceSize) {
+        for (int col = 0; col < gSize; col++) {
+            spectrumRow[col] = (float2)(0.0f, 0.0f);
+        }
+        return;
+    }
+    global const float *sourceRowData = source + sourceOffset + (plane * sourceSize + sourceRow) * sourceSize;
+    float re[gSize];
+    float im[gSize];
+    for (int col = 0; col < gSize; col++) {
+        const int sourceCol = col - margin;
+        re[col] = (sourceCol >= 0 && sourceCol < sourceSize) ? sourceRowData[sourceCol] : 0.0f;
+        im[col] = 0.0f;
+    }
+    fft(re, im, twiddles, 0);
+    for (int col = 0; col < gSize; col++) {
+        spectrumRow[col] = (float2)(re[col], im[col]);
+    }
+}
+
+// globalId: [plane][col]
+kernel void fftColumns(const int numPlanes, const int inverse, global const float2 *twiddles,
+        global float2 *spectra) {
+    const int globalId = get_global_id(0);
+    const int plane = globalId / gSize;
+    const int col = globalId % gSize;
+    if (plane >= numPlanes) {
+        return;
+    }
+    global float2 *spectrumCol = spectra + plane * gSizeSquared + col;
+    float re[gSize];
+    float im[gSize];
+    for (int row = 0; row < gSize; row++) {
+        const float2 value = spectrumCol[row * gSize];
+        re[row] = value.x;
+        im[row] = value.y;
+    }
+    fft(re, im, twiddles, inverse);
+    for (int row = 0; row < gSize; row++) {
+        spectrumCol[row * gSize] = (float2)(re[row], im[row]);
+    }
+}
+
+// inverse transforms the rows, after fftColumns, and writes the real part of the
+// destSize x destSize square at (margin, margin), times scale, into dest
+// globalId: [plane][destRow]
+kernel void ifftRowsAndCrop(const int numPlanes, global const float2 *spectra, global const float2 *twiddles,
+        const int margin, const int destSize, const float scale, global float *dest, const int destOffset) {
+    const int globalId = get_global_id(0);
+    const int plane = globalId / destSize;
+    const int destRow = globalId % destSize;
+    if (plane >= numPlanes) {
+        return;
+    }
+    global const float2 *spectrumRow = spectra + (plane * gSize + destRow + margin) * gSize;
+    float re[gSize];
+    float im[gSize];
+    for (int col = 0; col < gSize; col++) {
+        const float2 value = spectrumRow[col];
+        re[col] = value.x;
+        im[col] = value.y;
+    }
+    fft(re, im, twiddles, 1);
+    global float *destRowData = dest + destOffset + (plane * destSize + destRow) * destSize;
+    for (int destCol = 0; destCol < destSize; destCol++) {
+        destRowData[destCol] = re[destCol + margin] * scale;
+    }
+}
+
+// output[n][filter] = sum over inputPlane of input[n][inputPlane] * conj(filters[filter][inputPlane])
+// globalId: [n][filter][frequency]
+kernel void multiplyForward(const int numImages, global const float2 *input, global const float2 *filters,
+        global float2 *output) {
+    const int globalId = get_global_id(0);
+    const int frequency = globalId % gSizeSquared;
+    const int filter = (globalId / gSizeSquared) % gNumFilters;
+    const int n = globalId / gSizeSquared / gNumFilters;
+    if (n >= numImages) {
+        return;
+    }
+    float2 sum = (float2)(0.0f, 0.0f);
+    for (int inputPlane = 0; inputPlane < gInputPlanes; inputPlane++) {
+        const float2 a = input[(n * gInputPlanes + inputPlane) * gSizeSquared + frequency];
+        const float2 b = filters[(filter * gInputPlanes + inputPlane) * gSizeSquared + frequency];
+        sum.x += a.x * b.x + a.y * b.y;
+        sum.y += a.y * b.x - a.x * b.y;
+    }
+    output[globalId] = sum;
+}
+
+// gradInput[n][inputPlane] = sum over filter of gradOutput[n][filter] * filters[filter][inputPlane]
+// globalId: [n][inputPlane][frequency]
+kernel void multiplyBackward(const int numImages, global const float2 *gradOutput, global const float2 *filters,
+        global float2 *gradInput) {
+    const int globalId = get_global_id(0);
+    const int frequency = globalId % gSizeSquared;
+    const int inputPlane = (globalId / gSizeSquared) % gInputPlanes;
+    const int n = globalId / gSizeSquared / gInputPlanes;
+    if (n >= numImages) {
+        return;
+    }
+    float2 sum = (float2)(0.0f, 0.0f);
+    for (int filter = 0; filter < gNumFilters; filter++) {
+        const float2 a = gradOutput[(n * gNumFilters + filter) * gSizeSquared + frequency];
+        const float2 b = filters[(filter * gInputPlanes + inputPlane) * gSizeSquared + frequency];
+        sum.x += a.x * b.x - a.y * b.y;
+        sum.y += a.x * b.y + a.y * b.x;
+    }
+    gradInput[globalId] = sum;
+}
+
+// gradWeights[filter][inputPlane] (+)= sum over n of input[n][inputPlane] * conj(gradOutput[n][filter])
+// globalId: [filter][inputPlane][frequency]
+kernel void multiplyGradWeights(const int numImages, global const float2 *input, global const float2 *gradOutput,
+        const int accumulate, global float2 *gradWeights) {
+    const int globalId = get_global_id(0);
+    const int frequency = globalId % gSizeSquared;
+    const int inputPlane = (globalId / gSizeSquared) % gInputPlanes;
+    const int filter = globalId / gSizeSquared / gInputPlanes;
+    if (filter >= gNumFilters) {
+        return;
+    }
+    float2 sum = accumulate ? gradWeights[globalId] : (float2)(0.0f, 0.0f);
+    for (int n = 0; n < numImages; n++) {
+        const float2 a = input[(n * gInputPlanes + inputPlane) * gSizeSquared + frequency];
+        const float2 b = gradOutput[(n * gNumFilters + filter) * gSizeSquared + frequency];
+        sum.x += a.x * b.x + a.y * b.y;
+        sum.y += a.y * b.x - a.x * b.y;
+    }
+    gradWeights[globalId] = sum;
+}
+
+// the zero-frequency term of each gradOutput plane is the sum over its pixels
+// globalId: [filter]
+kernel void gradBias(const int numImages, global const float2 *gradOutput, const int accumulate,
+        const float scale, global float *gradBias) {
+    const int filter = get_global_id(0);
+    if (filter >= gNumFilters) {
+        return;
+    }
+    float sum = 0.0f;
+    for (int n = 0; n < numImages; n++) {
+        sum += gradOutput[(n * gNumFilters + filter) * gSizeSquared].x;
+    }
+    gradBias[filter] = (accumulate ? gradBias[filter] : 0.0f) + sum * scale;
+}
+
@@ -51,6 +51,20 @@
 //    . . .   x x x    . x x x
 //                       x x x
 
+// filters are float, unless the net keeps its weights on the device as 16 bits, see
+// NeuralNet::setDeviceWeights: then gHalfFilters, ieee half, or gBfloat16Filters, the
+// top 16 bits of a float.  Either way, each weight is read as a float, so sums stay fp32
+#if defined(gHalfFilters)
+    #define FilterType half
+    #define loadFilter(filters, i) vload_half(i, filters)
+#elif defined(gBfloat16Filters)
+    #define FilterType ushort
+    #define loadFilter(filters, i) as_float(((uint)(filters)[i]) << 16)
+#else
+    #define FilterType float
+    #define loadFilter(filters, i) ((filters)[i])
+#endif
+
 // images are organized like [imageId][plane][row][col]
 // filters are organized like [filterid][inplane][filterrow][filtercol]
 // output are organized like [imageid][filterid][row][col]
@@ -62,7 +76,7 @@
 //     - writes one output...
 void kernel convolve_imagecubes_float2(
     const int numExamples,
-      global const float *inputs, global const float *filters, 
+      global const float *inputs, global const FilterType *filters, 
     global float *output) {
     int globalId = get_global_id(0);
 
@@ -76,13 +90,13 @@ void kernel convolve_imagecubes_float2(
     int outputCol = localid % gOutputSize;
 
     global float const*inputCube = inputs + exampleId * gNumInputPlanes * gInputSizeSquared;
-    global float const*filterCube = filters + filterId * gNumInputPlanes * gFilterSizeSquared;
+    global FilterType const*filterCube = filters + filterId * gNumInputPlanes * gFilterSizeSquared;
 
     float sum = 0;
     if (exampleId < numExamples) {
         for (int inputPlaneIdx = 0; inputPlaneIdx < gNumInputPlanes; inputPlaneIdx++) {
             global float const*inputPlane = inputCube + inputPlaneIdx * gInputSizeSquared;
-            global float const*filterPlane = filterCube + inputPlaneIdx * gFilterSizeSquared;
+            global FilterType const*filterPlane = filterCube + inputPlaneIdx * gFilterSizeSquared;
             for (int u = -gHalfFilterSize; u <= gHalfFilterSize - gEven; u++) {
                 // trying to reduce register pressure...
                 #if gPadZeros == 1
@@ -91,7 +105,7 @@ void kernel convolve_imagecubes_float2(
                     #define inputRowIdx (outputRow + u + gHalfFilterSize)
                 #endif
                 global float const *inputRow = inputPlane + inputRowIdx * gInputSize;
-                global float const *filterRow = filterPlane + (u+gHalfFilterSize) * gFilterSize + gHalfFilterSize;
+                global FilterType const *filterRow = filterPlane + (u+gHalfFilterSize) * gFilterSize;
                 bool rowOk = inputRowIdx >= 0 && inputRowIdx < gInputSize;
                 #pragma unroll
                 for (int v = -gHalfFilterSize; v <= gHalfFilterSize - gEven; v++) {
@@ -102,7 +116,7 @@ void kernel convolve_imagecubes_float2(
                     #endif
                     bool process = rowOk && inputColIdx >= 0 && inputColIdx < gInputSize;
                     if (process) {
-                            sum += inputRow[inputColIdx] * filterRow[v];
+                            sum += inputRow[inputColIdx] * loadFilter(filterRow, v + gHalfFilterSize);
                     }
                 }
             }
@@ -14,6 +14,20 @@ void copyLocal(local float *restrict target, global float const *restrict source
     }
 }
 
+// filters are float, unless the net keeps its weights on the device as 16 bits, see
+// NeuralNet::setDeviceWeights: then gHalfFilters, ieee half, or gBfloat16Filters, the
+// top 16 bits of a float.  Either way, each weight is read as a float, so sums stay fp32
+#if defined(gHalfFilters)
+    #define FilterType half
+    #define loadFilter(filters, i) vload_half(i, filters)
+#elif defined(gBfloat16Filters)
+    #define FilterType ushort
+    #define loadFilter(filters, i) as_float(((uint)(filters)[i]) << 16)
+#else
+    #define FilterType float
+    #define loadFilter(filters, i) ((filters)[i])
+#endif
+
 // concept:
 //  we want to share each input example across multiple filters
 //   but an entire filter plane is 19*19*4 = 1.4KB
@@ -47,7 +61,7 @@ void copyLocal(local float *restrict target, global float const *restrict source
 //   inputimagesize around 19, not too small
 #if (gFilterSize == gInputSize) && (gPadZeros == 0)
 void kernel forward_fc_workgroup_perrow(const int batchSize,
-    global const float *images, global const float *filters, 
+    global const float *images, global const FilterType *filters, 
     global float *output1,
     local float *_imageRow, local float *_filterRows) {
     const int globalId = get_global_id(0);
@@ -62,14 +76,14 @@ void kernel forward_fc_workgroup_perrow(const int batchSize,
     const int filterId = localId;
 
     // first copy down filter row, which is per-thread, so we have to copy it all ourselves...
-    global const float *filterRow = filters 
+    global const FilterType *filterRow = filters 
         + filterId * gNumInputPlanes * gFilterSizeSquared
         + inputPlaneId * gFilterSizeSquared
         + filterRowId * gFilterSize;
     local float *_threadFilterRow = _filterRows + localId * gFilterSize;
     if (localId < gNumFilters) {
         for (int i = 0; i < gFilterSize; i++) {
-            _threadFilterRow[i] = filterRow[i];
+            _threadFilterRow[i] = loadFilter(filterRow, i);
         }
     }
     const int loopsPerExample = (gInputSize + workgroupSize - 1) / workgroupSize;
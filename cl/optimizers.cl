@@ -0,0 +1,125 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// one kernel per trainer, each reading weights, gradients and trainer state once,
+// and writing them once, rather than a chain of per-element ops
+// see src/trainers/OptimizerCpu.cpp for the cpu versions, which should give the same results
+
+// lastUpdate = momentum * lastUpdate - learningRate * gradWeights
+// weights = (weights + lastUpdate) * (1 - weightDecay)
+kernel void sgd(
+        const int N,
+        const float learningRate,
+        const float momentum,
+        const float weightDecayMultiplier,
+        global float *weights,
+        global const float *gradWeights,
+        global float *lastUpdate) {
+    const int globalId = get_global_id(0);
+    if (globalId >= N) {
+        return;
+    }
+    const float update = momentum * lastUpdate[globalId] - learningRate * gradWeights[globalId];
+    lastUpdate[globalId] = update;
+    weights[globalId] = (weights[globalId] + update) * weightDecayMultiplier;
+}
+
+// oldWeights = weights
+// weights = weights + momentum * delta
+kernel void nesterovLoadFuture(
+        const int N,
+        const float momentum,
+        global float *weights,
+        global const float *delta,
+        global float *oldWeights) {
+    const int globalId = get_global_id(0);
+    if (globalId >= N) {
+        return;
+    }
+    const float weight = weights[globalId];
+    oldWeights[globalId] = weight;
+    weights[globalId] = weight + momentum * delta[globalId];
+}
+
+// lastUpdate = momentum * lastUpdate - learningRate * gradWeights
+// weights = oldWeights + lastUpdate
+kernel void nesterov(
+        const int N,
+        const float learningRate,
+        const float momentum,
+        global float *weights,
+        global const float *gradWeights,
+        global const float *oldWeights,
+        global float *lastUpdate) {
+    const int globalId = get_global_id(0);
+    if (globalId >= N) {
+        return;
+    }
+    const float update = momentum * lastUpdate[globalId] - learningRate * gradWeights[globalId];
+    lastUpdate[globalId] = update;
+    weights[globalId] = oldWeights[globalId] + update;
+}
+
+// sumSquares += gradWeights ^ 2
+// weights -= learningRate * gradWeights / sqrt(sumSquares)
+kernel void adagrad(
+        const int N,
+        const float learningRate,
+        global float *weights,
+        global const float *gradWeights,
+        global float *sumSquares) {
+    const int globalId = get_global_id(0);
+    if (globalId >= N) {
+        return;
+    }
+    const float grad = gradWeights[globalId];
+    const float sumSquare = sumSquares[globalId] + grad * grad;
+    sumSquares[globalId] = sumSquare;
+    weights[globalId] -= learningRate * grad / sqrt(sumSquare);
+}
+
+// meanSquares = 0.9 * meanSquares + 0.1 * gradWeights ^ 2
+// weights -= learningRate * gradWeights / sqrt(meanSquares)
+kernel void rmsprop(
+        const int N,
+        const float learningRate,
+        global float *weights,
+        global const float *gradWeights,
+        global float *meanSquares) {
+    const int globalId = get_global_id(0);
+    if (globalId >= N) {
+        return;
+    }
+    const float grad = gradWeights[globalId];
+    const float meanSquare = 0.9f * meanSquares[globalId] + 0.1f * grad * grad;
+    meanSquares[globalId] = meanSquare;
+    weights[globalId] -= learningRate * grad / sqrt(meanSquare);
+}
+
+// sumGradSquared = decay * sumGradSquared + (1 - decay) * gradWeights ^ 2
+// update = - sqrt(sumUpdateSquared / sumGradSquared) * gradWeights
+// sumUpdateSquared = decay * sumUpdateSquared + (1 - decay) * update ^ 2
+// weights += update
+kernel void adadelta(
+        const int N,
+        const float decay,
+        global float *weights,
+        global const float *gradWeights,
+        global float *sumGradSquared,
+        global float *sumUpdateSquared) {
+    const int globalId = get_global_id(0);
+    if (globalId >= N) {
+        return;
+    }
+    const float grad = gradWeights[globalId];
+    const float gradSquared = decay * sumGradSquared[globalId] + (1 - decay) * grad * grad;
+    const float oldUpdateSquared = sumUpdateSquared[globalId];
+    const float update = - sqrt(oldUpdateSquared / gradSquared) * grad;
+    sumGradSquared[globalId] = gradSquared;
+    sumUpdateSquared[globalId] = decay * oldUpdateSquared + (1 - decay) * update * update;
+    weights[globalId] += update;
+}
+
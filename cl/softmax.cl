@@ -0,0 +1,62 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// expected defines:
+// gGroupSize: number of contiguous values each softmax is taken over,
+//             ie imageSizeSquared for per-plane, or numPlanes for per-column
+//             (per-column only supports imagesize 1, so the planes are contiguous)
+
+// one workitem per group
+kernel void forward(
+        const int numGroups,
+        global const float *input,
+        global float *output) {
+    const int groupId = get_global_id(0);
+    if (groupId >= numGroups) {
+        return;
+    }
+    global const float *groupInput = input + groupId * gGroupSize;
+    global float *groupOutput = output + groupId * gGroupSize;
+    float maxValue = groupInput[0];
+    for (int i = 1; i < gGroupSize; i++) {
+        maxValue = max(maxValue, groupInput[i]);
+    }
+    float denominator = 0.0f;
+    for (int i = 0; i < gGroupSize; i++) {
+        denominator += exp(groupInput[i] - maxValue);
+    }
+    for (int i = 0; i < gGroupSize; i++) {
+        groupOutput[i] = exp(groupInput[i] - maxValue) / denominator;
+    }
+}
+
+// one label per group, one workitem per value
+kernel void gradInputFromLabels(
+        const int N,
+        global const float *output,
+        global const int *labels,
+        global float *gradInput) {
+    const int globalId = get_global_id(0);
+    if (globalId >= N) {
+        return;
+    }
+    const int label = labels[globalId / gGroupSize];
+    const int posInGroup = globalId % gGroupSize;
+    gradInput[globalId] = output[globalId] - (posInGroup == label ? 1.0f : 0.0f);
+}
+
+kernel void gradInput(
+        const int N,
+        global const float *output,
+        global const float *expectedValues,
+        global float *gradInput) {
+    const int globalId = get_global_id(0);
+    if (globalId >= N) {
+        return;
+    }
+    gradInput[globalId] = output[globalId] - expectedValues[globalId];
+}
+
@@ -0,0 +1,36 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// expected defines:
+// gNumPlanes
+// gImageSize
+// gImageSizeSquared
+
+// translations holds [translateRows, translateCols] for each example
+// output pixels that come from outside the input image are zeroed
+// one workitem per output value
+kernel void translate(
+        const int N,
+        global const int *translations,
+        global const float *input,
+        global float *output) {
+    const int globalId = get_global_id(0);
+    if (globalId >= N) {
+        return;
+    }
+    const int n = globalId / gNumPlanes / gImageSizeSquared;
+    const int pos = globalId % gImageSizeSquared;
+    const int outRow = pos / gImageSize;
+    const int outCol = pos % gImageSize;
+    const int inRow = outRow - translations[n * 2];
+    const int inCol = outCol - translations[n * 2 + 1];
+    float value = 0.0f;
+    if (inRow >= 0 && inRow < gImageSize && inCol >= 0 && inCol < gImageSize) {
+        value = input[globalId - pos + inRow * gImageSize + inCol];
+    }
+    output[globalId] = value;
+}
+
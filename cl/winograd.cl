@@ -0,0 +1,197 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// Winograd F(mxm, 3x3) convolution, stride 1, as in Lavin and Gray, "Fast Algorithms
+// for Convolutional Neural Networks":
+// output tile = AT [(G g GT) .* (BT d B)] A
+// the elementwise product, summed over input planes, is done by the host, as one
+// gemm per transformed position xi, between the kernels below
+
+// expected defines:
+// gM: output tile size, 2 or 4
+// gAlpha: input tile size, gM + 2
+// gInPlanes, gOutPlanes, gInputSize, gOutputSize, gPad
+// gTilesPerRow, gNumTiles: tiles per row, and per image, of the output
+// gRotate: 1 if weights are the layer's filters, to be rotated 180 degrees, and
+//     with in and out planes swapped, for backward, else 0
+// gBiased: 1 if bias should be added to the output, else 0
+
+#if gM == 2
+constant float BT[] = {
+    1, 0, -1, 0,
+    0, 1, 1, 0,
+    0, -1, 1, 0,
+    0, 1, 0, -1
+};
+constant float G[] = {
+    1, 0, 0,
+    0.5f, 0.5f, 0.5f,
+    0.5f, -0.5f, 0.5f,
+    0, 0, 1
+};
+constant float AT[] = {
+    1, 1, 1, 0,
+    0, 1, -1, -1
+};
+#elif gM == 4
+constant float BT[] = {
+    4, 0, -5, 0, 1, 0,
+    0, -4, -4, 1, 1, 0,
+    0, 4, -4, -1, 1, 0,
+    0, -2, -1, 2, 1, 0,
+    0, 2, -1, -2, 1, 0,
+    0, 4, 0, -5, 0, 1
+};
+constant float G[] = {
+    1 / 4.0f, 0, 0,
+    -1 / 6.0f, -1 / 6.0f, -1 / 6.0f,
+    -1 / 6.0f, 1 / 6.0f, -1 / 6.0f,
+    1 / 24.0f, 1 / 12.0f, 1 / 6.0f,
+    1 / 24.0f, -1 / 12.0f, 1 / 6.0f,
+    0, 0, 1
+};
+constant float AT[] = {
+    1, 1, 1, 1, 1, 0,
+    0, 1, -1, 2, -2, 0,
+    0, 1, 1, 4, 4, 0,
+    0, 1, -1, 8, -8, 1
+};
+#endif
+
+// transformedFilters: [gAlpha * gAlpha][gOutPlanes][gInPlanes]
+// globalId: [outPlane][inPlane]
+kernel void transformFilters(global const float *weights, global float *transformedFilters) {
+    const int globalId = get_global_id(0);
+    if (globalId >= gOutPlanes * gInPlanes) {
+        return;
+    }
+    const int outPlane = globalId / gInPlanes;
+    const int inPlane = globalId % gInPlanes;
+    float filter[9];
+    #if gRotate
+    global const float *source = weights + (inPlane * gOutPlanes + outPlane) * 9;
+    for (int i = 0; i < 9; i++) {
+        filter[i] = source[8 - i];
+    }
+    #else
+    global const float *source = weights + globalId * 9;
+    for (int i = 0; i < 9; i++) {
+        filter[i] = source[i];
+    }
+    #endif
+    float temp[gAlpha * 3];
+    for (int a = 0; a < gAlpha; a++) {
+        for (int j = 0; j < 3; j++) {
+            temp[a * 3 + j] = G[a * 3] * filter[j] + G[a * 3 + 1] * filter[3 + j] + G[a * 3 + 2] * filter[6 + j];
+        }
+    }
+    for (int a = 0; a < gAlpha; a++) {
+        for (int b = 0; b < gAlpha; b++) {
+            transformedFilters[((a * gAlpha + b) * gOutPlanes + outPlane) * gInPlanes + inPlane] =
+                temp[a * 3] * G[b * 3] + temp[a * 3 + 1] * G[b * 3 + 1] + temp[a * 3 + 2] * G[b * 3 + 2];
+        }
+    }
+}
+
+// transformedInput: [gAlpha * gAlpha][gInPlanes][numImages * gNumTiles]
+// globalId: [n][inPlane][tile]
+kernel void transformInput(const int numImages, global const float *input, const int inputOffset,
+        global float *transformedInput) {
+    const int globalId = get_global_id(0);
+    if (globalId >= numImages * gInPlanes * gNumTiles) {
+        return;
+    }
+    const int tile = globalId % gNumTiles;
+    const int inPlane = (globalId / gNumTiles) % gInPlanes;
+    const int n = globalId / gNumTiles / gInPlanes;
+    const int row0 = (tile / gTilesPerRow) * gM - gPad;
+    const int col0 = (tile % gTilesPerRow) * gM - gPad;
+    global const float *inputPlane = input + inputOffset + (n * gInPlanes + inPlane) * gInputSize * gInputSize;
+    float d[gAlpha * gAlpha];
+    for (int i = 0; i < gAlpha; i++) {
+        const int row = row0 + i;
+        for (int j = 0; j < gAlpha; j++) {
+            const int col = col0 + j;
+            const bool inside = row >= 0 && row < gInputSize && col >= 0 && col < gInputSize;
+            d[i * gAlpha + j] = inside ? inputPlane[row * gInputSize + col] : 0.0f;
+        }
+    }
+    float temp[gAlpha * gAlpha];
+    for (int a = 0; a < gAlpha; a++) {
+        for (int j = 0; j < gAlpha; j++) {
+            float sum = 0;
+            for (int i = 0; i < gAlpha; i++) {
+                sum += BT[a * gAlpha + i] * d[i * gAlpha + j];
+            }
+            temp[a * gAlpha + j] = sum;
+        }
+    }
+    const int columns = numImages * gNumTiles;
+    const int column = n * gNumTiles + tile;
+    for (int a = 0; a < gAlpha; a++) {
+        for (int b = 0; b < gAlpha; b++) {
+            float sum = 0;
+            for (int j = 0; j < gAlpha; j++) {
+                sum += temp[a * gAlpha + j] * BT[b * gAlpha + j];
+            }
+            transformedInput[((a * gAlpha + b) * gInPlanes + inPlane) * columns + column] = sum;
+        }
+    }
+}
+
+// transformedOutput: [gAlpha * gAlpha][gOutPlanes][numImages * gNumTiles]
+// output: [n][outPlane][outputRow][outputCol]
+// globalId: [n][outPlane][tile]
+kernel void transformOutput(const int numImages, global const float *transformedOutput,
+        global const float *bias, global float *output, const int outputOffset) {
+    const int globalId = get_global_id(0);
+    if (globalId >= numImages * gOutPlanes * gNumTiles) {
+        return;
+    }
+    const int tile = globalId % gNumTiles;
+    const int outPlane = (globalId / gNumTiles) % gOutPlanes;
+    const int n = globalId / gNumTiles / gOutPlanes;
+    const int columns = numImages * gNumTiles;
+    const int column = n * gNumTiles + tile;
+    float m[gAlpha * gAlpha];
+    for (int xi = 0; xi < gAlpha * gAlpha; xi++) {
+        m[xi] = transformedOutput[(xi * gOutPlanes + outPlane) * columns + column];
+    }
+    float temp[gM * gAlpha];
+    for (int r = 0; r < gM; r++) {
+        for (int b = 0; b < gAlpha; b++) {
+            float sum = 0;
+            for (int a = 0; a < gAlpha; a++) {
+                sum += AT[r * gAlpha + a] * m[a * gAlpha + b];
+            }
+            temp[r * gAlpha + b] = sum;
+        }
+    }
+    #if gBiased
+    const float planeBias = bias[outPlane];
+    #else
+    const float planeBias = 0.0f;
+    #endif
+    const int row0 = (tile / gTilesPerRow) * gM;
+    const int col0 = (tile % gTilesPerRow) * gM;
+    global float *outputPlane = output + outputOffset + (n * gOutPlanes + outPlane) * gOutputSize * gOutputSize;
+    for (int r = 0; r < gM; r++) {
+        if (row0 + r >= gOutputSize) {
+            break;
+        }
+        for (int s = 0; s < gM; s++) {
+            if (col0 + s >= gOutputSize) {
+                break;
+            }
+            float sum = 0;
+            for (int b = 0; b < gAlpha; b++) {
+                sum += temp[r * gAlpha + b] * AT[s * gAlpha + b];
+            }
+            outputPlane[(row0 + r) * gOutputSize + col0 + s] = sum + planeBias;
+        }
+    }
+}
+
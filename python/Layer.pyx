@@ -33,6 +33,8 @@ cdef class Layer:
 #        outputArrayMv[:] = outputMv
 #        outputArrayMv = self.thisptr.getOutput()
         return outputArray
+    def getPersistSize(self):
+        return self.thisptr.getPersistSize()
     def getWeights(self):
         cdef int weightsSize = self.thisptr.getPersistSize()
         cdef c_array.array weightsArray = array(floatArrayType, [0] * weightsSize )
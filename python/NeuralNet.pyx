@@ -71,3 +71,9 @@ cdef class NeuralNet:
                             # used for example by randomtranslations layer (for now,
                             # used only by randomtranslations layer)
         self.thisptr.setTraining(training)
+    def setInferenceOnly(self, inferenceOnly): # call before adding layers; the net then
+                            # only does forward, with no gradient buffers or backward kernels
+        self.thisptr.setInferenceOnly(inferenceOnly)
+    def setShareActivations(self, share): # inference-only nets: layers reuse each others
+                            # output buffers; only the last layer's output is kept
+        self.thisptr.setShareActivations(share)
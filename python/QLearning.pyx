@@ -14,6 +14,8 @@ cdef class QLearner:
         self.thisptr.setLambda( thislambda )
     def setMaxSamples( self, int maxSamples ):
         self.thisptr.setMaxSamples( maxSamples )
+    def setReplayCapacity( self, int replayCapacity ):
+        self.thisptr.setReplayCapacity( replayCapacity )
     def setEpsilon( self, float epsilon ):
         self.thisptr.setEpsilon( epsilon )
     # def setLearningRate( self, float learningRate ):
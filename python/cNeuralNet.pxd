@@ -16,4 +16,6 @@ cdef extern from "net/NeuralNet.h":
         const float *getOutput()
         int getOutputNumElements()
         void setTraining( bool training )
+        void setInferenceOnly( bool inferenceOnly ) except +
+        void setShareActivations( bool share ) except +
         void deleteMe()
@@ -4,6 +4,7 @@ cdef extern from "qlearning/QLearner.h":
         void run() except +
         void setLambda( float thislambda )
         void setMaxSamples( int maxSamples )
+        void setReplayCapacity( int replayCapacity ) except +
         void setEpsilon( float epsilon )
         # void setLearningRate( float learningRate )
 
@@ -0,0 +1,63 @@
+#!/usr/bin/python
+
+# train on mnist, then predict with an inference-only copy of the net
+# see test_deepcl.py for more about training
+
+from __future__ import print_function, division
+import array
+import PyDeepCL
+import sys
+print('imports done')
+
+if len(sys.argv) != 2:
+    print(
+        'usage: python ' + sys.argv[0] +
+        ' [mnist data directory (containing the .mat files)]')
+    sys.exit(-1)
+
+mnistFilePath = sys.argv[1] + '/t10k-images-idx3-ubyte'
+netdef = "rt2-8c5z-relu-mp2-16c5z-relu-mp3-150n-tanh-10n"
+
+cl = PyDeepCL.DeepCL()
+
+net = PyDeepCL.NeuralNet(cl, 1, 28)
+net.addLayer(PyDeepCL.NormalizationLayerMaker().translate(-0.5).scale(1/255.0))
+PyDeepCL.NetdefToNet.createNetFromNetdef(net, netdef)
+
+(N, planes, size) = PyDeepCL.GenericLoader.getDimensions(mnistFilePath)
+N = 1280
+batchSize = 128
+images = array.array('f', [0] * (N * planes * size * size))
+labels = array.array('i', [0] * N)
+PyDeepCL.GenericLoader.load(mnistFilePath, images, labels, 0, N)
+print('loaded data')
+
+sgd = PyDeepCL.SGD(cl, 0.002, 0.0)
+netLearner = PyDeepCL.NetLearner(
+    sgd, net,
+    N, images, labels,
+    N, images, labels,
+    batchSize)
+netLearner.setSchedule(4)
+netLearner.run()
+
+# the predict net only does forward: setInferenceOnly, before adding layers, means
+# no gradient buffers or backward kernels, and setShareActivations lets the layers
+# reuse each others output buffers
+predictNet = PyDeepCL.NeuralNet(cl, 1, 28)
+predictNet.setInferenceOnly(True)
+predictNet.setShareActivations(True)
+predictNet.addLayer(PyDeepCL.NormalizationLayerMaker().translate(-0.5).scale(1/255.0))
+PyDeepCL.NetdefToNet.createNetFromNetdef(predictNet, netdef)
+for layerIdx in range(net.getNumLayers()):
+    if net.getLayer(layerIdx).getPersistSize() > 0:
+        predictNet.getLayer(layerIdx).setWeights(net.getLayer(layerIdx).getWeights())
+print('created predict net')
+
+predictNet.setTraining(False)
+predictNet.setBatchSize(batchSize)
+numRight = 0
+for batch in range(N // batchSize):
+    predictNet.forward(images[batch * batchSize * planes * size * size:(batch+1) * batchSize * planes * size * size])
+    numRight += predictNet.calcNumRight(labels[batch * batchSize:(batch+1) * batchSize])
+print('num right: ' + str(numRight) + '/' + str(N))
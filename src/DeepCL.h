@@ -28,11 +28,15 @@
 #include "layer/LayerMakers.h"
 
 #include "batch/BatchProcess.h"
+#include "batch/EpochSampler.h"
 #include "batch/NetLearner.h"
 #include "batch/NetLearnerOnDemand.h"
 #include "batch/NetLearnerOnDemandv2.h"
 
 #include "weights/WeightsPersister.h"
+#include "weights/CheckpointWriter.h"
+#include "quantize/Int8Quantizer.h"
+#include "quantize/Int8Predictor.h"
 #include "util/FileHelper.h"
 #include "loaders/GenericLoader.h"
 #include "loaders/GenericLoaderv2.h"
@@ -11,6 +11,9 @@
 #include "activate/ActivationMaker.h"
 #include "activate/ActivationForward.h"
 #include "activate/ActivationBackward.h"
+#include "pooling/PoolingLayer.h"
+#include "pooling/ActivationPoolingForward.h"
+#include "pooling/ActivationPoolingBackward.h"
 
 using namespace std;
 
@@ -26,12 +29,17 @@ ActivationLayer::ActivationLayer(EasyCL *cl, Layer *previousLayer, ActivationMak
         outputSize(previousLayer->getOutputSize()),
         fn(maker->_activationFunction),
         cl(cl),
+        activationBackpropImpl(0),
         output(0),
         gradInput(0),
         outputWrapper(0),
         gradInputWrapper(0),
 //        outputCopiedToHost(false),
 //        gradInputCopiedToHost(false),
+        fusedPoolingLayer(0),
+        activationPoolingForwardImpl(0),
+        activationPoolingBackwardImpl(0),
+        outputStale(false),
         batchSize(0),
         allocatedSize(0) {
     if(inputSize == 0){
@@ -43,15 +51,23 @@ ActivationLayer::ActivationLayer(EasyCL *cl, Layer *previousLayer, ActivationMak
         throw runtime_error("Error: Activation layer " + toString(layerIndex) + ": output image size is 0");
     }
     activationForwardImpl = ActivationForward::instance(cl, numPlanes, inputSize, fn);
-    activationBackpropImpl = ActivationBackward::instance(cl, numPlanes, inputSize, fn);
+    if(!inferenceOnly) {
+        activationBackpropImpl = ActivationBackward::instance(cl, numPlanes, inputSize, fn);
+    }
 }
 VIRTUAL ActivationLayer::~ActivationLayer() {
     delete activationForwardImpl;
     delete activationBackpropImpl;
-    if(outputWrapper != 0) {
+    if(activationPoolingForwardImpl != 0) {
+        delete activationPoolingForwardImpl;
+    }
+    if(activationPoolingBackwardImpl != 0) {
+        delete activationPoolingBackwardImpl;
+    }
+    if(outputWrapper != 0 && !outputShared) {
         delete outputWrapper;
     }
-    if(output != 0) {
+    if(output != 0 && !outputShared) {
         delete[] output;
     }
     if(gradInputWrapper != 0) {
@@ -106,10 +122,10 @@ VIRTUAL void ActivationLayer::setBatchSize(int batchSize) {
         this->batchSize = batchSize;
         return;
     }
-    if(outputWrapper != 0) {
+    if(outputWrapper != 0 && !outputShared) {
         delete outputWrapper;
     }
-    if(output != 0) {
+    if(output != 0 && !outputShared) {
         delete[] output;
     }
     if(gradInputWrapper != 0) {
@@ -120,17 +136,43 @@ VIRTUAL void ActivationLayer::setBatchSize(int batchSize) {
     }
     this->batchSize = batchSize;
     this->allocatedSize = batchSize;
-    output = new float[ getOutputNumElements() ];
-    outputWrapper = cl->wrap(getOutputNumElements(), output);
-    outputWrapper->createOnDevice();
-    gradInput = new float[ previousLayer->getOutputNumElements() ];
-    gradInputWrapper = cl->wrap(previousLayer->getOutputNumElements(), gradInput);
-    gradInputWrapper->createOnDevice();
+    if(!outputShared) {
+        output = new float[ getOutputNumElements() ];
+        outputWrapper = cl->wrap(getOutputNumElements(), output);
+        outputWrapper->createOnDevice();
+    }
+    if(!inferenceOnly) {
+        gradInput = new float[ previousLayer->getOutputNumElements() ];
+        gradInputWrapper = cl->wrap(previousLayer->getOutputNumElements(), gradInput);
+        gradInputWrapper->createOnDevice();
+    }
+}
+VIRTUAL bool ActivationLayer::canShareOutput() const {
+    return true;
+}
+// when fused, we dont write our output during forward, so it would be overwriting the
+// previous layer's output later on
+VIRTUAL bool ActivationLayer::canForwardInPlace() const {
+    return fusedPoolingLayer == 0;
+}
+VIRTUAL void ActivationLayer::setSharedOutput(float *output, CLWrapper *outputWrapper) {
+    if(!outputShared) {
+        delete this->outputWrapper;
+        delete[] this->output;
+    }
+    this->output = output;
+    this->outputWrapper = outputWrapper;
+    outputShared = output != 0;
+    if(!outputShared) {
+        allocatedSize = 0;
+    }
 }
 VIRTUAL int ActivationLayer::getOutputNumElements() {
     return batchSize * numPlanes * outputSize * outputSize;
 }
 VIRTUAL float *ActivationLayer::getOutput() {
+    checkOutputNotOverwritten();
+    forwardIfOutputStale();
     if(outputWrapper->isDeviceDirty()) {
         outputWrapper->copyToHost();
 //        outputCopiedToHost = true;
@@ -164,6 +206,8 @@ VIRTUAL bool ActivationLayer::hasOutputWrapper() const {
     return true;
 }
 VIRTUAL CLWrapper *ActivationLayer::getOutputWrapper() {
+    checkOutputNotOverwritten();
+    forwardIfOutputStale();
     return outputWrapper;
 }
 VIRTUAL int ActivationLayer::getWeightsSize() const {
@@ -182,7 +226,40 @@ VIRTUAL float *ActivationLayer::getGradInput() {
 VIRTUAL ActivationFunction const *ActivationLayer::getActivationFunction() {
     return fn;
 }
-VIRTUAL void ActivationLayer::forward() {
+/// \brief Have forward() and backward() also do the work of poolingLayer, which must be a max-pooling layer directly after this one
+///
+/// Used by NeuralNet::fuseLayers.  Our forward then applies the activation inside the
+/// pooling window, and writes only poolingLayer's output and selectors, so our own
+/// output is never written to, or read back from, global memory.  Our backward takes
+/// the gradient at poolingLayer's output, and scatters it, times the activation's
+/// derivative, straight to our gradInput.  poolingLayer's own forward and backward
+/// then do nothing.
+void ActivationLayer::fuseWithPoolingLayer(PoolingLayer *poolingLayer) {
+    if(poolingLayer->previousLayer != this) {
+        throw runtime_error("ActivationLayer::fuseWithPoolingLayer: pooling layer " + toString(poolingLayer->layerIndex) + " doesnt follow activation layer " + toString(layerIndex));
+    }
+    if(fusedPoolingLayer != 0) {
+        return;
+    }
+    fusedPoolingLayer = poolingLayer;
+    activationPoolingForwardImpl = ActivationPoolingForward::instance(cl, poolingLayer->padZeros, numPlanes, outputSize, poolingLayer->poolingSize, fn);
+    if(!inferenceOnly) {
+        activationPoolingBackwardImpl = ActivationPoolingBackward::instance(cl, poolingLayer->padZeros, numPlanes, outputSize, poolingLayer->poolingSize, fn);
+    }
+    poolingLayer->fusedIntoPreviousLayer = true;
+}
+// when fused, our output is only needed by callers looking at it directly, eg
+// for printing, so calculate it then
+void ActivationLayer::forwardIfOutputStale() {
+    if(!outputStale) {
+        return;
+    }
+    outputStale = false;
+    forwardActivation(outputWrapper, 0);
+}
+// runs the activation on the previous layer's output, into targetWrapper, and, if
+// selectorsWrapper isnt 0, max-pools it too, as the fused pooling layer
+void ActivationLayer::forwardActivation(CLWrapper *targetWrapper, CLWrapper *selectorsWrapper) {
     CLWrapper *inputWrapper = 0;
     if(previousLayer->hasOutputWrapper()) {
         inputWrapper = previousLayer->getOutputWrapper();
@@ -191,12 +268,23 @@ VIRTUAL void ActivationLayer::forward() {
         inputWrapper = cl->wrap(previousLayer->getOutputNumElements(), input);
         inputWrapper->copyToDevice();
     }
-    activationForwardImpl->forward(batchSize, inputWrapper, outputWrapper);
-//    outputCopiedToHost = false;
+    if(selectorsWrapper != 0) {
+        activationPoolingForwardImpl->forward(batchSize, inputWrapper, selectorsWrapper, targetWrapper);
+    } else {
+        activationForwardImpl->forward(batchSize, inputWrapper, targetWrapper);
+    }
     if(!previousLayer->hasOutputWrapper()) {
         delete inputWrapper;
     }
 }
+VIRTUAL void ActivationLayer::forward() {
+    if(fusedPoolingLayer != 0) {
+        forwardActivation(fusedPoolingLayer->outputWrapper, fusedPoolingLayer->selectorsWrapper);
+        outputStale = true;
+        return;
+    }
+    forwardActivation(outputWrapper, 0);
+}
 VIRTUAL void ActivationLayer::backward() {
     // have no weights to backprop to, just need to backprop the errors
 
@@ -208,17 +296,25 @@ VIRTUAL void ActivationLayer::backward() {
 //        imagesWrapper->copyToDevice();
 //    }
 
+    // when fused, the gradient comes from the layer after the pooling layer
+    Layer *gradOutputLayer = fusedPoolingLayer != 0 ? fusedPoolingLayer->nextLayer : nextLayer;
+    const int gradOutputNumElements = fusedPoolingLayer != 0 ? fusedPoolingLayer->getOutputNumElements() : getOutputNumElements();
     CLWrapper *gradOutputWrapper = 0;
     bool weOwnGradOutputWrapper = false;
-    if(nextLayer->providesGradInputWrapper()) {
-        gradOutputWrapper = nextLayer->getGradInputWrapper();
+    if(gradOutputLayer->providesGradInputWrapper()) {
+        gradOutputWrapper = gradOutputLayer->getGradInputWrapper();
     } else {
-        gradOutputWrapper = cl->wrap(getOutputNumElements(), nextLayer->getGradInput());
+        gradOutputWrapper = cl->wrap(gradOutputNumElements, gradOutputLayer->getGradInput());
         gradOutputWrapper->copyToDevice();
         weOwnGradOutputWrapper = true;
     }
 
-    activationBackpropImpl->backward(batchSize, outputWrapper, gradOutputWrapper, gradInputWrapper);
+    if(fusedPoolingLayer != 0) {
+        activationPoolingBackwardImpl->backward(batchSize, fusedPoolingLayer->outputWrapper, gradOutputWrapper,
+            fusedPoolingLayer->selectorsWrapper, gradInputWrapper);
+    } else {
+        activationBackpropImpl->backward(batchSize, outputWrapper, gradOutputWrapper, gradInputWrapper);
+    }
 //    gradInputCopiedToHost = false;
 
 //    if(!previousLayer->hasOutputWrapper()) {
@@ -229,6 +325,9 @@ VIRTUAL void ActivationLayer::backward() {
     }
 }
 VIRTUAL std::string ActivationLayer::asString() const {
+    if(fusedPoolingLayer != 0) {
+        return std::string("ActivationLayer{ ") + fn->getDefineName() + ", fused with layer " + toString(fusedPoolingLayer->layerIndex) + " }";
+    }
     return std::string("ActivationLayer{ ") + fn->getDefineName() + " }";
 }
 VIRTUAL int ActivationLayer::getPersistSize(int version) const {
@@ -16,6 +16,9 @@
 class ActivationForward;
 class ActivationBackward;
 class ActivationMaker;
+class ActivationPoolingForward;
+class ActivationPoolingBackward;
+class PoolingLayer;
 
 // this will contain only activation, and then we can factorize activations away from
 // the convolutional layers etc
@@ -41,6 +44,12 @@ public:
     CLWrapper *outputWrapper; // this is guaranteed to be up to date
     CLWrapper *gradInputWrapper; // this is guaranteed to be up to date
 
+    // set by fuseWithPoolingLayer(); then forward() and backward() do the work of
+    // both layers, and our own output is only calculated if asked for
+    PoolingLayer *fusedPoolingLayer; // NOT owned by us
+    ActivationPoolingForward *activationPoolingForwardImpl;
+    ActivationPoolingBackward *activationPoolingBackwardImpl;
+    bool outputStale;
 //    bool outputCopiedToHost;
 //    bool gradInputCopiedToHost;
 
@@ -58,6 +67,9 @@ public:
     VIRTUAL float getOutput(int n, int plane, int row, int col);
     VIRTUAL void printOutput();
     VIRTUAL void setBatchSize(int batchSize);
+    VIRTUAL bool canShareOutput() const;
+    VIRTUAL bool canForwardInPlace() const;
+    VIRTUAL void setSharedOutput(float *output, CLWrapper *outputWrapper);
     VIRTUAL int getOutputNumElements();
     VIRTUAL float *getOutput();
     VIRTUAL bool needsBackProp();
@@ -73,6 +85,9 @@ public:
     VIRTUAL int getBiasSize() const;
     VIRTUAL float *getGradInput();
     VIRTUAL ActivationFunction const *getActivationFunction();
+    void fuseWithPoolingLayer(PoolingLayer *poolingLayer);
+    void forwardIfOutputStale();
+    void forwardActivation(CLWrapper *targetWrapper, CLWrapper *selectorsWrapper);
     VIRTUAL void forward();
     VIRTUAL void backward();
     VIRTUAL std::string asString() const;
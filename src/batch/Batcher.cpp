@@ -6,8 +6,12 @@
 
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <stdexcept>
 
 #include "batch/NetAction.h"
+#include "batch/EpochSampler.h"
+#include "util/stringhelper.h"
 #include "trainers/Trainer.h"
 
 #include "batch/Batcher.h"
@@ -27,13 +31,18 @@ PUBLICAPI Batcher::Batcher(Trainable *net, int batchSize, int N, float *data, in
         batchSize(batchSize),
         N(N),
         data(data),
-        labels(labels)
+        labels(labels),
+        sampler(0),
+        sampledData(0),
+        sampledLabels(0)
             {
     inputCubeSize = net->getInputCubeSize();
     numBatches = (N + batchSize - 1) / batchSize;
     reset();
 }
 VIRTUAL Batcher::~Batcher() {
+    delete[] sampledData;
+    delete[] sampledLabels;
 }
 /// \brief reset to the first batch, and set epochDone to false
 PUBLICAPI void Batcher::reset() {
@@ -75,6 +84,24 @@ VIRTUAL void Batcher::setN(int N) {
     this->N = N;
     this->numBatches = (N + batchSize - 1) / batchSize;
 }
+/// \brief point at a different set of already-loaded data, eg the next buffer
+/// filled by a prefetching loader
+VIRTUAL void Batcher::setData(float const*data, int const*labels) {
+    this->data = data;
+    this->labels = labels;
+}
+/// \brief present the examples in the order given by sampler, instead of in
+/// file order; sampler is not owned by us, and its N must match ours
+PUBLICAPI VIRTUAL void Batcher::setSampler(EpochSampler *sampler) {
+    if(sampler != 0 && sampler->getN() != N) {
+        throw runtime_error("Batcher::setSampler: sampler N " + toString(sampler->getN()) + " doesnt match N " + toString(N));
+    }
+    this->sampler = sampler;
+    if(sampler != 0 && sampledData == 0) {
+        sampledData = new float[ batchSize * inputCubeSize ];
+        sampledLabels = new int[ batchSize ];
+    }
+}
 /// \brief processes one single batch of data
 ///
 /// could be learning for one batch, or prediction/testing for one batch
@@ -97,11 +124,24 @@ PUBLICAPI bool Batcher::tick(int epoch) {
 //    std::cout << "batchSize=" << batchSize << " thisBatchSize=" << thisBatchSize << " batch=" << batch <<
 //            " batchStart=" << batchStart << " data=" << (void *)data << " labels=" << labels << 
 //            std::endl;
+    float const *batchData = &(data[ batchStart * inputCubeSize ]);
+    int const *batchLabels = &(labels[batchStart]);
+    if(sampler != 0 && sampler->getMode() != EpochSampler::SEQUENTIAL) {
+        // (re)builds the order at the start of each epoch, or after setBatchState
+        sampler->startEpoch(epoch);
+        int const *order = sampler->getOrder() + batchStart;
+        for(int i = 0; i < thisBatchSize; i++) {
+            memcpy(sampledData + i * inputCubeSize, data + (long long)order[i] * inputCubeSize, sizeof(float) * inputCubeSize);
+            sampledLabels[i] = labels[order[i]];
+        }
+        batchData = sampledData;
+        batchLabels = sampledLabels;
+    }
     net->setBatchSize(thisBatchSize);
-    internalTick(epoch, &(data[ batchStart * inputCubeSize ]), &(labels[batchStart]));
+    internalTick(epoch, batchData, batchLabels);
 //        netAction->run(net, &(data[ batchStart * inputCubeSize ]), &(labels[batchStart]));
-    float thisLoss = net->calcLossFromLabels(&(labels[batchStart]));
-    int thisNumRight = net->calcNumRight(&(labels[batchStart]));
+    float thisLoss = net->calcLossFromLabels(batchLabels);
+    int thisNumRight = net->calcNumRight(batchLabels);
 //        std::cout << "thisloss " << thisLoss << " thisnumright " << thisNumRight << std::endl; 
     loss += thisLoss;
     numRight += thisNumRight;
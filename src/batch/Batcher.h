@@ -11,6 +11,7 @@
 #include "DeepCLDllExport.h"
 
 class EpochResult;
+class EpochSampler;
 class NetAction;
 class Trainer;
 #include "trainers/TrainingContext.h"
@@ -43,6 +44,10 @@ protected:
     int numRight;
     float loss;
 
+    EpochSampler *sampler; // NOT owned by us; 0 means file order
+    float *sampledData; // one batch, gathered in sampler order
+    int *sampledLabels;
+
 public:
     virtual void internalTick(int epoch, float const*batchData, int const*batchLabels) = 0;
 
@@ -61,6 +66,8 @@ public:
     PUBLICAPI VIRTUAL bool getEpochDone();
     VIRTUAL void setBatchState(int nextBatch, int numRight, float loss);
     VIRTUAL void setN(int N);
+    VIRTUAL void setData(float const*data, int const*labels);
+    PUBLICAPI VIRTUAL void setSampler(EpochSampler *sampler);
     PUBLICAPI bool tick(int epoch);
     PUBLICAPI EpochResult run(int epoch);
 
@@ -0,0 +1,157 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "batch/EpochSampler.h"
+#include "util/mt19937defs.h"
+#include "util/stringhelper.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+namespace {
+    // fisher-yates, on [begin, end)
+    void shuffleRange(MT19937 &random, int *values, int begin, int end) {
+        for(int i = end - 1; i > begin; i--) {
+            const int j = begin + (int)(random() % (unsigned int)(i - begin + 1));
+            const int value = values[i];
+            values[i] = values[j];
+            values[j] = value;
+        }
+    }
+}
+
+PUBLIC PUBLICAPI EpochSampler::EpochSampler(int N, unsigned int seed) :
+        N(N),
+        seed(seed),
+        mode(SEQUENTIAL),
+        blockSize(1),
+        windowSize(N),
+        epoch(-1) {
+    order.resize(N);
+}
+PUBLIC PUBLICAPI void EpochSampler::setSequential() {
+    mode = SEQUENTIAL;
+    epoch = -1;
+}
+PUBLIC PUBLICAPI void EpochSampler::setShuffle() {
+    mode = SHUFFLE;
+    epoch = -1;
+}
+/// \brief windowSize must be a multiple of blockSize
+PUBLIC PUBLICAPI void EpochSampler::setBlockShuffle(int blockSize, int windowSize) {
+    if(blockSize < 1 || windowSize < blockSize || windowSize % blockSize != 0) {
+        throw runtime_error("EpochSampler: windowSize " + toString(windowSize) + " should be a multiple of blockSize " + toString(blockSize));
+    }
+    mode = BLOCK_SHUFFLE;
+    this->blockSize = blockSize;
+    this->windowSize = windowSize;
+    epoch = -1;
+    const int numBlocks = (N + blockSize - 1) / blockSize;
+    blockOrder.resize(numBlocks);
+    blockPosition.resize(numBlocks);
+}
+/// \brief modeName is one of sequential, shuffle, block; blockSize and windowSize
+/// are only used for block
+PUBLIC PUBLICAPI STATIC EpochSampler *EpochSampler::instance(std::string modeName, int N, int blockSize, int windowSize, unsigned int seed) {
+    EpochSampler *sampler = new EpochSampler(N, seed);
+    if(modeName == "sequential") {
+        sampler->setSequential();
+    } else if(modeName == "shuffle") {
+        sampler->setShuffle();
+    } else if(modeName == "block") {
+        try {
+            sampler->setBlockShuffle(blockSize, windowSize);
+        } catch(runtime_error &) {
+            delete sampler;
+            throw;
+        }
+    } else {
+        delete sampler;
+        throw runtime_error("EpochSampler: mode " + modeName + " not known, choose sequential, shuffle or block");
+    }
+    return sampler;
+}
+PUBLIC PUBLICAPI int EpochSampler::getN() const {
+    return N;
+}
+PUBLIC PUBLICAPI EpochSampler::Mode EpochSampler::getMode() const {
+    return mode;
+}
+PUBLIC PUBLICAPI int EpochSampler::getBlockSize() const {
+    return blockSize;
+}
+PUBLIC PUBLICAPI int EpochSampler::getWindowSize() const {
+    return windowSize;
+}
+PUBLIC PUBLICAPI int EpochSampler::getEpoch() const {
+    return epoch;
+}
+/// \brief builds the order for epoch; cheap to call again for the same epoch
+PUBLIC PUBLICAPI void EpochSampler::startEpoch(int epoch) {
+    if(epoch == this->epoch) {
+        return;
+    }
+    this->epoch = epoch;
+    for(int i = 0; i < N; i++) {
+        order[i] = i;
+    }
+    if(mode == SEQUENTIAL) {
+        return;
+    }
+    MT19937 random;
+    random.seed(seed ^ ((unsigned int)epoch * 0x9E3779B9u));
+    if(mode == SHUFFLE) {
+        shuffleRange(random, &order[0], 0, N);
+        return;
+    }
+    // BLOCK_SHUFFLE
+    // a short last block stays last, so every window is whole blocks
+    const int numBlocks = (int)blockOrder.size();
+    const int numFullBlocks = N / blockSize;
+    for(int b = 0; b < numBlocks; b++) {
+        blockOrder[b] = b;
+    }
+    shuffleRange(random, &blockOrder[0], 0, numFullBlocks);
+    int pos = 0;
+    for(int k = 0; k < numBlocks; k++) {
+        const int block = blockOrder[k];
+        blockPosition[block] = k;
+        const int blockEnd = min(N, (block + 1) * blockSize);
+        for(int example = block * blockSize; example < blockEnd; example++) {
+            order[pos++] = example;
+        }
+    }
+    for(int windowStart = 0; windowStart < N; windowStart += windowSize) {
+        shuffleRange(random, &order[0], windowStart, min(N, windowStart + windowSize));
+    }
+}
+/// \brief order[i] is the index of the i'th example to present this epoch
+PUBLIC PUBLICAPI int const *EpochSampler::getOrder() const {
+    if(epoch == -1) {
+        throw runtime_error("EpochSampler: call startEpoch first");
+    }
+    return &order[0];
+}
+/// \brief BLOCK_SHUFFLE: blocks in the order they are read this epoch
+PUBLIC int const *EpochSampler::getBlockOrder() const {
+    return &blockOrder[0];
+}
+PUBLIC int EpochSampler::getNumBlocks() const {
+    return (int)blockOrder.size();
+}
+/// \brief BLOCK_SHUFFLE: where example sits if the blocks are read in getBlockOrder
+/// order, one after the other, ie before the shuffle within each window
+PUBLIC int EpochSampler::getLoadPosition(int example) const {
+    return blockPosition[example / blockSize] * blockSize + example % blockSize;
+}
+
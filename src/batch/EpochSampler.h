@@ -0,0 +1,77 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+/// \brief The order in which to present the N training examples, each epoch
+///
+/// - SEQUENTIAL: file order, same every epoch (the default)
+/// - SHUFFLE: a fresh random permutation of all N each epoch; needs all the
+///   data in memory, so for NetLearner
+/// - BLOCK_SHUFFLE: the data is cut into blocks of blockSize contiguous examples,
+///   and each epoch the order of the blocks is shuffled, then the examples within
+///   each window of windowSize consecutive (shuffled) examples are shuffled too.
+///   Reading a window only needs windowSize / blockSize contiguous reads, so this
+///   suits OnDemandBatcherv2, where the window is one file batch
+///
+/// The order depends only on (seed, epoch), so restarting part way through an
+/// epoch gives the same order as before
+PUBLICAPI
+class DeepCL_EXPORT EpochSampler {
+    public:
+    enum Mode { SEQUENTIAL, SHUFFLE, BLOCK_SHUFFLE };
+
+    private:
+    const int N;
+    const unsigned int seed;
+    Mode mode;
+    int blockSize;
+    int windowSize;
+    int epoch; // that order was built for, or -1
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    std::vector<int> order;
+    std::vector<int> blockOrder; // BLOCK_SHUFFLE only
+    std::vector<int> blockPosition; // inverse of blockOrder
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    PUBLICAPI EpochSampler(int N, unsigned int seed);
+    PUBLICAPI void setSequential();
+    PUBLICAPI void setShuffle();
+    PUBLICAPI void setBlockShuffle(int blockSize, int windowSize);
+    PUBLICAPI STATIC EpochSampler *instance(std::string modeName, int N, int blockSize, int windowSize, unsigned int seed);
+    PUBLICAPI int getN() const;
+    PUBLICAPI Mode getMode() const;
+    PUBLICAPI int getBlockSize() const;
+    PUBLICAPI int getWindowSize() const;
+    PUBLICAPI int getEpoch() const;
+    PUBLICAPI void startEpoch(int epoch);
+    PUBLICAPI int const *getOrder() const;
+    int const *getBlockOrder() const;
+    int getNumBlocks() const;
+    int getLoadPosition(int example) const;
+
+    // [[[end]]]
+};
+
@@ -115,6 +115,10 @@ VIRTUAL void NetLearner::setBatchState(int nextBatch, int numRight, float loss)
 //    trainBatcher->numRight = numRight;
 //    trainBatcher->loss = loss;
 }
+/// \brief sampler (NOT owned) chooses the order of the training examples each epoch
+PUBLICAPI VIRTUAL void NetLearner::setTrainSampler(EpochSampler *sampler) {
+    trainBatcher->setSampler(sampler);
+}
 PUBLICAPI VIRTUAL bool NetLearner::tickEpoch() {
 //    int epoch = nextEpoch;
 //    cout << "NetLearner.tickEpoch epoch=" << epoch << " learningDone=" << learningDone << " epochDone=" << trainBatcher->getEpochDone() << endl;
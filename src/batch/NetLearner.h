@@ -75,6 +75,7 @@ public:
     PUBLICAPI VIRTUAL int getBatchNumRight();
     PUBLICAPI VIRTUAL float getBatchLoss();
     VIRTUAL void setBatchState(int nextBatch, int numRight, float loss);
+    PUBLICAPI VIRTUAL void setTrainSampler(EpochSampler *sampler);
     PUBLICAPI VIRTUAL bool tickEpoch();
     PUBLICAPI VIRTUAL void run();
     PUBLICAPI VIRTUAL bool isLearningDone();
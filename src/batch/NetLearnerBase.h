@@ -11,6 +11,7 @@
 #include "DeepCLDllExport.h"
 
 class Trainer;
+class EpochSampler;
 
 class DeepCL_EXPORT NetLearnerBase {
 public:
@@ -33,6 +34,7 @@ public:
     virtual float getBatchLoss() = 0;
     virtual int getNTrain() = 0;
     virtual void setBatchState(int batch, int numRight, float loss) = 0;
+    virtual void setTrainSampler(EpochSampler *sampler) = 0; // order of the training examples each epoch, NOT owned
     virtual void run() = 0;
 //    virtual void setTrainer(Trainer *trainer) = 0;
 };
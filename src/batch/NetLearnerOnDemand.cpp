@@ -12,6 +12,7 @@
 #include "batch/NetAction.h"
 #include "batch/OnDemandBatcher.h"
 #include "util/stringhelper.h"
+#include "batch/EpochSampler.h"
 #include "batch/NetLearnerOnDemand.h"
 
 using namespace std;
@@ -88,6 +89,11 @@ PUBLICAPI VIRTUAL float NetLearnerOnDemand::getBatchLoss() {
 VIRTUAL void NetLearnerOnDemand::setBatchState(int nextBatch, int numRight, float loss) {
     learnBatcher->setBatchState(nextBatch, numRight, loss);
 }
+PUBLICAPI VIRTUAL void NetLearnerOnDemand::setTrainSampler(EpochSampler *sampler) {
+    if(sampler != 0 && sampler->getMode() != EpochSampler::SEQUENTIAL) {
+        throw runtime_error("NetLearnerOnDemand doesnt support shuffling, please use NetLearnerOnDemandv2");
+    }
+}
 PUBLICAPI VIRTUAL void NetLearnerOnDemand::reset() {
     timer.lap();
     learningDone = false;
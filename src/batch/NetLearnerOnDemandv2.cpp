@@ -89,6 +89,16 @@ PUBLICAPI VIRTUAL float NetLearnerOnDemandv2::getBatchLoss() {
 VIRTUAL void NetLearnerOnDemandv2::setBatchState(int nextBatch, int numRight, float loss) {
     learnBatcher->setBatchState(nextBatch, numRight, loss);
 }
+/// \brief sampler (NOT owned) chooses the order of the training examples each epoch;
+/// for BLOCK_SHUFFLE, its windowSize must be fileReadBatches * batchSize
+PUBLICAPI VIRTUAL void NetLearnerOnDemandv2::setTrainSampler(EpochSampler *sampler) {
+    learnBatcher->setSampler(sampler);
+}
+/// \brief the loaders normalize the data as they read it, see OnDemandBatcherv2::setNormalization
+PUBLICAPI VIRTUAL void NetLearnerOnDemandv2::setNormalization(float translate, float scale) {
+    learnBatcher->setNormalization(translate, scale);
+    testBatcher->setNormalization(translate, scale);
+}
 PUBLICAPI VIRTUAL void NetLearnerOnDemandv2::reset() {
     timer.lap();
     learningDone = false;
@@ -79,6 +79,8 @@ public:
     PUBLICAPI VIRTUAL int getBatchNumRight();
     PUBLICAPI VIRTUAL float getBatchLoss();
     VIRTUAL void setBatchState(int nextBatch, int numRight, float loss);
+    PUBLICAPI VIRTUAL void setTrainSampler(EpochSampler *sampler);
+    PUBLICAPI VIRTUAL void setNormalization(float translate, float scale);
     PUBLICAPI VIRTUAL void reset();
     VIRTUAL void postEpochTesting();
     PUBLICAPI VIRTUAL bool tickBatch();  // means: filebatch, not low-level batch
@@ -4,12 +4,18 @@
 // v. 2.0. If a copy of the MPL was not distributed with this file, You can 
 // obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
 #include "batch/NetAction.h"
 #include "net/Trainable.h"
 #include "loaders/GenericLoaderv2.h"
 #include "batch/Batcher.h"
+#include "batch/EpochSampler.h"
 
 #include "batch/OnDemandBatcherv2.h"
+#include "util/stringhelper.h"
 
 using namespace std;
 
@@ -30,16 +36,43 @@ PUBLICAPI OnDemandBatcherv2::OnDemandBatcherv2(Trainable *net, NetAction *netAct
             fileBatchSize(batchSize * fileReadBatches),
             inputCubeSize(net->getInputCubeSize())
         {
-    numFileBatches = (N + fileBatchSize - 1) / fileBatchSize;
-    dataBuffer = new float[ fileBatchSize * inputCubeSize ];
-    labelsBuffer = new int[ fileBatchSize ];
-    netActionBatcher = new NetActionBatcher(net, batchSize, fileBatchSize, dataBuffer, labelsBuffer, netAction);
-    reset();
+    init(2);
+}
+/// \brief numBuffers is how many file batches can be in memory at once: the one
+/// being trained on, plus numBuffers - 1 read ahead by the prefetch thread
+PUBLICAPI OnDemandBatcherv2::OnDemandBatcherv2(Trainable *net, NetAction *netAction, 
+            GenericLoaderv2 *loader, int N, int fileReadBatches, int batchSize, int numBuffers) :
+            net(net),
+            netAction(netAction),
+            netActionBatcher(0),
+            loader(loader),
+            N(N),
+            fileReadBatches(fileReadBatches),
+            batchSize(batchSize),
+            fileBatchSize(batchSize * fileReadBatches),
+            inputCubeSize(net->getInputCubeSize())
+        {
+    init(numBuffers);
 }
 VIRTUAL OnDemandBatcherv2::~OnDemandBatcherv2() {
+    #ifndef NOTHREADS
+    if(prefetchThread != 0) {
+        {
+            lock_guard<mutex> lock(prefetchMutex);
+            stopping = true;
+        }
+        prefetchChanged.notify_all();
+        prefetchThread->join(); // waits for any load in progress
+        delete prefetchThread;
+    }
+    #endif
     delete netActionBatcher;
-    delete[] dataBuffer;
-    delete[] labelsBuffer;
+    delete[] stagingData;
+    delete[] stagingLabels;
+    for(int i = 0; i < numBuffers; i++) {
+        delete[] dataBuffers[i];
+        delete[] labelsBuffers[i];
+    }
 }
 VIRTUAL void OnDemandBatcherv2::setBatchState(int nextBatch, int numRight, float loss) {
     this->nextFileBatch = nextBatch / fileReadBatches;
@@ -68,6 +101,37 @@ PUBLICAPI VIRTUAL bool OnDemandBatcherv2::getEpochDone() {
 PUBLICAPI VIRTUAL int OnDemandBatcherv2::getN() {
     return N;
 }
+/// \brief sampler (NOT owned) chooses the order of the examples each epoch; call
+/// before the first tick
+/// SHUFFLE would need a separate read per example, so only SEQUENTIAL and
+/// BLOCK_SHUFFLE, with windowSize equal to fileReadBatches * batchSize, are allowed
+PUBLICAPI VIRTUAL void OnDemandBatcherv2::setSampler(EpochSampler *sampler) {
+    if(sampler != 0) {
+        if(sampler->getN() != N) {
+            throw runtime_error("OnDemandBatcherv2::setSampler: sampler N " + toString(sampler->getN()) + " doesnt match N " + toString(N));
+        }
+        if(sampler->getMode() == EpochSampler::SHUFFLE) {
+            throw runtime_error("OnDemandBatcherv2::setSampler: use block shuffle, rather than shuffle, when loading on demand");
+        }
+        if(sampler->getMode() == EpochSampler::BLOCK_SHUFFLE && sampler->getWindowSize() != fileBatchSize) {
+            throw runtime_error("OnDemandBatcherv2::setSampler: sampler windowSize " + toString(sampler->getWindowSize())
+                + " should be fileReadBatches * batchSize = " + toString(fileBatchSize));
+        }
+        if(sampler->getMode() == EpochSampler::BLOCK_SHUFFLE && stagingData == 0) {
+            stagingData = new float[ fileBatchSize * inputCubeSize ];
+            stagingLabels = new int[ fileBatchSize ];
+        }
+    }
+    this->sampler = sampler;
+    plannedEpoch = -1;
+}
+/// \brief the loader normalizes each file batch, as (value + translate) * scale, as it
+/// converts the bytes to float, so the net's NormalizationLayer can skip its own pass,
+/// see NormalizationLayer::setInputNormalized; call before the first tick
+PUBLICAPI VIRTUAL void OnDemandBatcherv2::setNormalization(float translate, float scale) {
+    this->translate = translate;
+    this->scale = scale;
+}
 //VIRTUAL void OnDemandBatcherv2::setLearningRate(float learningRate) {
 //    this->learningRate = learningRate;
 //}
@@ -92,15 +156,12 @@ PUBLICAPI bool OnDemandBatcherv2::tick(int epoch) {
         reset();
     }
     int fileBatch = nextFileBatch;
-    int fileBatchStart = fileBatch * fileBatchSize;
-    int thisFileBatchSize = fileBatchSize;
-    if(fileBatch == numFileBatches - 1) {
-        thisFileBatchSize = N - fileBatchStart;
-    }
-    netActionBatcher->setN(thisFileBatchSize);
+    netActionBatcher->setN(getFileBatchSize(fileBatch));
 //    cout << "batchlearnerondemand, read data... filebatchstart=" << fileBatchStart << " filebatchsize=" << thisFileBatchSize << endl;
-    loader->load(dataBuffer, labelsBuffer, fileBatchStart, thisFileBatchSize);
+    int buffer = waitForFileBatch(fileBatch, epoch);
+    netActionBatcher->setData(dataBuffers[buffer], labelsBuffers[buffer]);
     EpochResult epochResult = netActionBatcher->run(epoch);
+    releaseFileBatch(fileBatch);
     loss += epochResult.loss;
     numRight += epochResult.numRight;
 
@@ -121,4 +182,165 @@ PUBLICAPI EpochResult OnDemandBatcherv2::run(int epoch) {
     EpochResult epochResult(loss, numRight);
     return epochResult;
 }
+void OnDemandBatcherv2::init(int numBuffers) {
+    #ifdef NOTHREADS
+    numBuffers = 1;
+    #endif
+    if(numBuffers < 1) {
+        throw runtime_error("OnDemandBatcherv2: numBuffers must be at least 1, but was " + toString(numBuffers));
+    }
+    this->numBuffers = numBuffers;
+    numFileBatches = (N + fileBatchSize - 1) / fileBatchSize;
+    for(int i = 0; i < numBuffers; i++) {
+        dataBuffers.push_back(new float[ fileBatchSize * inputCubeSize ]);
+        labelsBuffers.push_back(new int[ fileBatchSize ]);
+        bufferFileBatch.push_back(-1);
+        bufferReady.push_back(false);
+        bufferError.push_back(exception_ptr());
+    }
+    nextToLoad = 0;
+    firstUnconsumed = -1;
+    loading = false;
+    stopping = false;
+    #ifndef NOTHREADS
+    prefetchThread = 0;
+    #endif
+    sampler = 0;
+    plannedEpoch = -1;
+    stagingData = 0;
+    stagingLabels = 0;
+    translate = 0.0f;
+    scale = 1.0f;
+    netActionBatcher = new NetActionBatcher(net, batchSize, fileBatchSize, dataBuffers[0], labelsBuffers[0], netAction);
+    reset();
+}
+int OnDemandBatcherv2::getFileBatchSize(int fileBatch) {
+    if(fileBatch == numFileBatches - 1) {
+        return N - fileBatch * fileBatchSize;
+    }
+    return fileBatchSize;
+}
+// returns the index of the buffer holding fileBatch, once it has been loaded
+// if the prefetch thread isnt already working towards fileBatch (first call, new epoch,
+// setBatchState...), then we restart it from fileBatch
+// the sampler order for epoch is only (re)built while nothing is loading
+int OnDemandBatcherv2::waitForFileBatch(int fileBatch, int epoch) {
+    int buffer = fileBatch % numBuffers;
+    const bool needsPlan = sampler != 0 && sampler->getMode() != EpochSampler::SEQUENTIAL && epoch != plannedEpoch;
+    #ifdef NOTHREADS
+    if(needsPlan) {
+        sampler->startEpoch(epoch);
+        plannedEpoch = epoch;
+    }
+    loadFileBatch(fileBatch, buffer);
+    #else
+    unique_lock<mutex> lock(prefetchMutex);
+    if(prefetchThread == 0) {
+        prefetchThread = new thread(&OnDemandBatcherv2::prefetchLoop, this);
+    }
+    if(fileBatch != firstUnconsumed || needsPlan) {
+        // whatever is in flight is for the wrong file batches, so let it finish, then discard
+        while(loading) {
+            prefetchChanged.wait(lock);
+        }
+        if(needsPlan) {
+            sampler->startEpoch(epoch);
+            plannedEpoch = epoch;
+        }
+        for(int i = 0; i < numBuffers; i++) {
+            bufferFileBatch[i] = -1;
+            bufferReady[i] = false;
+            bufferError[i] = exception_ptr();
+        }
+        nextToLoad = fileBatch;
+        firstUnconsumed = fileBatch;
+        prefetchChanged.notify_all();
+    }
+    while(!(bufferFileBatch[buffer] == fileBatch && bufferReady[buffer])) {
+        prefetchChanged.wait(lock);
+    }
+    if(bufferError[buffer]) {
+        exception_ptr error = bufferError[buffer];
+        bufferError[buffer] = exception_ptr();
+        bufferFileBatch[buffer] = -1;
+        firstUnconsumed = -1; // so the next tick reloads from scratch
+        rethrow_exception(error);
+    }
+    #endif
+    return buffer;
+}
+// fileBatch's buffer can be reused now
+void OnDemandBatcherv2::releaseFileBatch(int fileBatch) {
+    #ifndef NOTHREADS
+    {
+        lock_guard<mutex> lock(prefetchMutex);
+        if(firstUnconsumed != fileBatch) {
+            return;
+        }
+        firstUnconsumed = fileBatch + 1;
+    }
+    prefetchChanged.notify_all();
+    #endif
+}
+// runs on prefetchThread: loads file batches in order, as long as there is a free
+// buffer, and we havent reached the end of the epoch
+void OnDemandBatcherv2::prefetchLoop() {
+    #ifndef NOTHREADS
+    unique_lock<mutex> lock(prefetchMutex);
+    while(true) {
+        while(!stopping && !(nextToLoad < numFileBatches && firstUnconsumed >= 0 
+                && nextToLoad < firstUnconsumed + numBuffers)) {
+            prefetchChanged.wait(lock);
+        }
+        if(stopping) {
+            return;
+        }
+        int fileBatch = nextToLoad;
+        nextToLoad++;
+        int buffer = fileBatch % numBuffers;
+        bufferFileBatch[buffer] = fileBatch;
+        bufferReady[buffer] = false;
+        loading = true;
+        lock.unlock();
+        exception_ptr error;
+        try {
+            loadFileBatch(fileBatch, buffer);
+        } catch(...) {
+            error = current_exception();
+        }
+        lock.lock();
+        loading = false;
+        bufferReady[buffer] = true;
+        bufferError[buffer] = error;
+        prefetchChanged.notify_all();
+    }
+    #endif
+}
+// reads fileBatch into buffer; in file order, or, for BLOCK_SHUFFLE, as the
+// sampler's window number fileBatch
+void OnDemandBatcherv2::loadFileBatch(int fileBatch, int buffer) {
+    const int thisFileBatchSize = getFileBatchSize(fileBatch);
+    if(sampler == 0 || sampler->getMode() != EpochSampler::BLOCK_SHUFFLE) {
+        loader->load(dataBuffers[buffer], labelsBuffers[buffer], fileBatch * fileBatchSize, thisFileBatchSize, translate, scale);
+        return;
+    }
+    const int blockSize = sampler->getBlockSize();
+    const int windowStart = fileBatch * fileBatchSize;
+    int const *blockOrder = sampler->getBlockOrder();
+    int pos = 0;
+    for(int k = windowStart / blockSize; pos < thisFileBatchSize; k++) {
+        const int blockStart = blockOrder[k] * blockSize;
+        const int thisBlockSize = min(blockSize, N - blockStart);
+        loader->load(stagingData + pos * inputCubeSize, stagingLabels + pos, blockStart, thisBlockSize, translate, scale);
+        pos += thisBlockSize;
+    }
+    int const *order = sampler->getOrder() + windowStart;
+    float *data = dataBuffers[buffer];
+    int *labels = labelsBuffers[buffer];
+    for(int i = 0; i < thisFileBatchSize; i++) {
+        const int src = sampler->getLoadPosition(order[i]) - windowStart;
+        memcpy(data + i * inputCubeSize, stagingData + src * inputCubeSize, sizeof(float) * inputCubeSize);
+        labels[i] = stagingLabels[src];
+    }
+}
 
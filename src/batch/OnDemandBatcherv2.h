@@ -6,6 +6,17 @@
 
 #pragma once
 
+#include <vector>
+#include <exception>
+
+#if defined(_MSC_VER) && _MSC_VER < 1700 // visual studio 2010 has no std::thread
+#define NOTHREADS
+#else
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
 //#include "net/Trainable.h"
 //#include "BatchLearner.h"
 
@@ -13,6 +24,7 @@ class NetActionBatcher;
 class Trainable;
 class NetAction;
 class GenericLoaderv2;
+class EpochSampler;
 
 #include "batch/NetAction.h"
 
@@ -31,6 +43,15 @@ class GenericLoaderv2;
 ///
 /// compared to v1, v2 recevies a GenericLoaderv2 loader object, instead of a filepath
 /// so we can handle imagenet manifests etc
+///
+/// file batches are read by a background thread, into a ring of numBuffers
+/// buffers, so the next file batch is loaded and decoded while the current one
+/// is being trained on.  The thread only reads ahead within the current epoch,
+/// so it is idle once the epoch has been consumed
+///
+/// with a BLOCK_SHUFFLE EpochSampler, each file batch is one sampler window: its
+/// blocks are read, one contiguous read each, into a staging buffer, and then
+/// gathered into the file batch's buffer in the sampler's order
 PUBLICAPI
 class OnDemandBatcherv2 {
 protected:
@@ -49,8 +70,37 @@ protected:
     const int inputCubeSize;
     int numFileBatches;
 
-    float *dataBuffer;
-    int *labelsBuffer;
+    int numBuffers;
+    // as long as these stay private, should be ok to disable the warnings I think?
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    std::vector<float *> dataBuffers;
+    std::vector<int *> labelsBuffers;
+    // which file batch each buffer holds, or is being loaded with, -1 if none
+    std::vector<int> bufferFileBatch;
+    std::vector<char> bufferReady;
+    std::vector<std::exception_ptr> bufferError; // rethrown from tick(), on the calling thread
+    #ifndef NOTHREADS
+    std::thread *prefetchThread;
+    std::mutex prefetchMutex;
+    std::condition_variable prefetchChanged;
+    #endif
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+    // state shared with the prefetch thread, protected by prefetchMutex:
+    int nextToLoad; // next file batch the prefetch thread will load
+    int firstUnconsumed; // file batch tick() will ask for next; buffers before this are free
+    bool loading;
+    bool stopping;
+
+    EpochSampler *sampler; // NOT owned by us; 0 means file order
+    int plannedEpoch; // epoch the loaded buffers were planned for, by sampler
+    float *stagingData; // BLOCK_SHUFFLE only, one file batch, used by whoever loads
+    int *stagingLabels;
+    float translate; // applied by the loader, as it converts to float, see setNormalization
+    float scale;
 
     bool epochDone;
     int numRight;
@@ -66,6 +116,8 @@ public:
     // generated, using cog:
     PUBLICAPI OnDemandBatcherv2(Trainable *net, NetAction *netAction,
     GenericLoaderv2 *loader, int N, int fileReadBatches, int batchSize);
+    PUBLICAPI OnDemandBatcherv2(Trainable *net, NetAction *netAction,
+    GenericLoaderv2 *loader, int N, int fileReadBatches, int batchSize, int numBuffers);
     VIRTUAL ~OnDemandBatcherv2();
     VIRTUAL void setBatchState(int nextBatch, int numRight, float loss);
     VIRTUAL int getBatchSize();
@@ -75,9 +127,17 @@ public:
     PUBLICAPI VIRTUAL int getNumRight();
     PUBLICAPI VIRTUAL bool getEpochDone();
     PUBLICAPI VIRTUAL int getN();
+    PUBLICAPI VIRTUAL void setSampler(EpochSampler *sampler);
+    PUBLICAPI VIRTUAL void setNormalization(float translate, float scale);
     PUBLICAPI void reset();
     PUBLICAPI bool tick(int epoch);
     PUBLICAPI EpochResult run(int epoch);
+    void init(int numBuffers);
+    int getFileBatchSize(int fileBatch);
+    int waitForFileBatch(int fileBatch, int epoch);
+    void releaseFileBatch(int fileBatch);
+    void prefetchLoop();
+    void loadFileBatch(int fileBatch, int buffer);
 
     // [[[end]]]
 };
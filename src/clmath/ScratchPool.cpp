@@ -0,0 +1,50 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+
+#include "EasyCL.h"
+#include "clmath/ScratchPool.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+PUBLIC ScratchPool::ScratchPool(EasyCL *cl) :
+        cl(cl) {
+}
+PUBLIC ScratchPool::~ScratchPool() {
+    for(int i = 0; i < (int)wrappers.size(); i++) {
+        delete wrappers[i];
+        delete[] hostArrays[i];
+    }
+}
+// returns a wrapper of exactly numFloats, created on the device, contents undefined
+PUBLIC CLWrapper *ScratchPool::borrow(int numFloats) {
+    multimap<int, CLWrapper *>::iterator it = available.find(numFloats);
+    if(it != available.end()) {
+        CLWrapper *wrapper = it->second;
+        available.erase(it);
+        return wrapper;
+    }
+    float *hostArray = new float[numFloats];
+    CLWrapper *wrapper = cl->wrap(numFloats, hostArray);
+    wrapper->createOnDevice();
+    wrappers.push_back(wrapper);
+    hostArrays.push_back(hostArray);
+    return wrapper;
+}
+PUBLIC void ScratchPool::giveBack(CLWrapper *wrapper) {
+    available.insert(pair<int, CLWrapper *>(wrapper->size(), wrapper));
+}
+// total buffers held, whether borrowed or available
+PUBLIC int ScratchPool::getNumBuffers() const {
+    return (int)wrappers.size();
+}
+
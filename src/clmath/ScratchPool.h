@@ -0,0 +1,54 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+class EasyCL;
+class CLWrapper;
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// keeps float scratch buffers, each with its device buffer already created, so hot
+// paths that need a temporary once per layer per batch can borrow one, and give it
+// back afterwards, rather than allocating on the host and on the device every time
+// buffers are keyed by their exact size, since CLMathWrapper etc use the wrapper size,
+// and are only freed when the pool is deleted
+// not thread-safe
+class DeepCL_EXPORT ScratchPool {
+    private:
+    EasyCL *cl; // NOT owned by us
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    std::multimap<int, CLWrapper *> available;
+    std::vector<CLWrapper *> wrappers; // all of them, borrowed or not
+    std::vector<float *> hostArrays;
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    ScratchPool(EasyCL *cl);
+    ~ScratchPool();
+    CLWrapper *borrow(int numFloats);
+    void giveBack(CLWrapper *wrapper);
+    int getNumBuffers() const;
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,138 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "EasyCL.h"
+#include "conv/AutoTuneCache.h"
+#include "util/FileHelper.h"
+#include "util/stringhelper.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+
+PUBLIC AutoTuneCache::AutoTuneCache(std::string filepath) :
+        filepath(filepath) {
+    load();
+}
+PUBLIC STATIC AutoTuneCache *AutoTuneCache::instance() {
+    static AutoTuneCache *thisinstance = new AutoTuneCache(getDefaultFilepath());
+    return thisinstance;
+}
+PUBLIC STATIC std::string AutoTuneCache::getDefaultFilepath() {
+    const char *fromEnv = getenv("DEEPCL_TUNINGCACHE");
+    if(fromEnv != 0) {
+        return fromEnv;
+    }
+    const char *home = getenv("HOME");
+    if(home == 0) {
+        home = getenv("USERPROFILE");
+    }
+    if(home == 0) {
+        return "";
+    }
+    return string(home) + "/.deepcl_tuningcache.txt";
+}
+// kind is eg "forward", numImplementations is part of the key, so adding
+// new implementations invalidates old choices
+PUBLIC STATIC std::string AutoTuneCache::makeKey(EasyCL *cl, std::string kind, int numImplementations,
+        LayerDimensions dim, int batchSize) {
+    ostringstream key;
+    key << kind << "|" << numImplementations << "|" << getDeviceDescription(cl) << "|"
+        << dim.inputPlanes << "," << dim.inputSize << "," << dim.numFilters << ","
+        << dim.filterSize << "," << dim.padZeros << "," << dim.biased << "," << dim.skip << "|"
+        << batchSize;
+    string keyString = key.str();
+    // keep one entry per line
+    keyString = replaceGlobal(keyString, "\t", " ");
+    keyString = replaceGlobal(keyString, "\n", " ");
+    keyString = replaceGlobal(keyString, "\r", " ");
+    return keyString;
+}
+PUBLIC STATIC std::string AutoTuneCache::getDeviceDescription(EasyCL *cl) {
+    if(cl == 0) {
+        return "nodevice";
+    }
+    return getDeviceInfoString(cl, CL_DEVICE_NAME) + "|" + getDeviceInfoString(cl, CL_DRIVER_VERSION);
+}
+// returns false if we havent seen this key before
+PUBLIC bool AutoTuneCache::get(std::string key, int *p_index) {
+    #ifndef NOTHREADS
+    std::lock_guard<std::mutex> lock(mutex);
+    #endif
+    map<string, int>::iterator it = chosenByKey.find(key);
+    if(it == chosenByKey.end()) {
+        return false;
+    }
+    *p_index = it->second;
+    return true;
+}
+PUBLIC void AutoTuneCache::set(std::string key, int index) {
+    #ifndef NOTHREADS
+    std::lock_guard<std::mutex> lock(mutex);
+    #endif
+    chosenByKey[key] = index;
+    save();
+}
+PRIVATE STATIC std::string AutoTuneCache::getDeviceInfoString(EasyCL *cl, int name) {
+    char buffer[256];
+    buffer[0] = 0;
+    size_t size = 0;
+    if(clGetDeviceInfo(cl->device, (cl_device_info)name, sizeof(buffer) - 1, buffer, &size) != CL_SUCCESS) {
+        return "unknown";
+    }
+    buffer[sizeof(buffer) - 1] = 0;
+    return trim(buffer);
+}
+PRIVATE void AutoTuneCache::load() {
+    if(filepath == "") {
+        return;
+    }
+    ifstream file(FileHelper::localizePath(filepath).c_str());
+    if(!file.is_open()) {
+        return;
+    }
+    string line;
+    while(getline(file, line)) {
+        size_t tabPos = line.rfind('\t');
+        if(tabPos == string::npos) {
+            continue;
+        }
+        chosenByKey[line.substr(0, tabPos)] = atoi(line.substr(tabPos + 1));
+    }
+}
+// other processes might have added entries since we loaded, so we merge theirs in
+// first, then write the whole lot via a '~' file, like WeightsPersister
+PRIVATE void AutoTuneCache::save() {
+    if(filepath == "") {
+        return;
+    }
+    map<string, int> ours = chosenByKey;
+    load();
+    for(map<string, int>::iterator it = ours.begin(); it != ours.end(); it++) {
+        chosenByKey[it->first] = it->second;
+    }
+    ofstream file(FileHelper::localizePath(filepath + "~").c_str());
+    if(!file.is_open()) {
+        cout << "AutoTuneCache: couldnt write " << filepath << "~, keeping tuning results in memory only" << endl;
+        filepath = "";
+        return;
+    }
+    for(map<string, int>::iterator it = chosenByKey.begin(); it != chosenByKey.end(); it++) {
+        file << it->first << "\t" << it->second << "\n";
+    }
+    file.close();
+    FileHelper::remove(filepath);
+    FileHelper::rename(filepath + "~", filepath);
+}
+
@@ -0,0 +1,72 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#if defined(_MSC_VER) && _MSC_VER < 1700 // visual studio 2010 has no std::mutex
+#define NOTHREADS
+#else
+#include <mutex>
+#endif
+
+#include "conv/LayerDimensions.h"
+
+#include "DeepCLDllExport.h"
+
+class EasyCL;
+
+#define STATIC static
+#define VIRTUAL virtual
+
+// remembers which implementation ForwardAuto, BackwardAuto and BackpropWeightsAuto
+// chose, keyed by device name, driver version, LayerDimensions and batchsize,
+// so that we only need to benchmark each layer shape once per device, rather
+// than every time the process starts
+// persisted as a text file, one 'key<tab>index' per line, by default
+// $HOME/.deepcl_tuningcache.txt, or set environment variable DEEPCL_TUNINGCACHE
+// to another path, or to an empty string to keep the cache in memory only
+// get and set are threadsafe, eg for MultiNet columns tuning concurrently
+class DeepCL_EXPORT AutoTuneCache {
+    private:
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    std::map<std::string, int> chosenByKey;
+    std::string filepath;
+    #ifndef NOTHREADS
+    std::mutex mutex;
+    #endif
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    AutoTuneCache(std::string filepath);
+    STATIC AutoTuneCache *instance();
+    STATIC std::string getDefaultFilepath();
+    STATIC std::string makeKey(EasyCL *cl, std::string kind, int numImplementations,
+    LayerDimensions dim, int batchSize);
+    STATIC std::string getDeviceDescription(EasyCL *cl);
+    bool get(std::string key, int *p_index);
+    void set(std::string key, int index);
+
+    private:
+    STATIC std::string getDeviceInfoString(EasyCL *cl, int name);
+    void load();
+    void save();
+
+    // [[[end]]]
+};
+
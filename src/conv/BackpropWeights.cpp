@@ -16,6 +16,9 @@
 #include "BackpropWeightsScratch.h"
 #include "BackpropWeightsScratchLarge.h"
 #include "BackpropWeightsIm2Col.h"
+#include "BackpropWeightsCpuIm2Col.h"
+#include "BackpropWeightsFft.h"
+#include "Fft.h"
 #include "BackpropWeightsAuto.h"
 
 using namespace std;
@@ -46,13 +49,16 @@ STATIC BackpropWeights *BackpropWeights::instance(EasyCL *cl, LayerDimensions di
 //    }
 }
 STATIC int BackpropWeights::getNumImplementations() {
-    return 5;
+    return 7;
 }
 STATIC bool BackpropWeights::plausiblyOptimal(int index, int batchSize, LayerDimensions dim) {
     if(index == 0) { 
         return false;
     }
-    if(index >= 5) {
+    if(index >= 7) {
+        return false;
+    }
+    if(index == 6 && (dim.filterSize < 5 || !Fft::isSupported(dim))) {
         return false;
     }
     return true;
@@ -79,6 +85,12 @@ STATIC BackpropWeights *BackpropWeights::instanceSpecific(int idx, EasyCL *cl, L
     if(idx == 4) {
         return new BackpropWeightsIm2Col(cl, layerDimensions);
     }
+    if(idx == 5) {
+        return new BackpropWeightsCpuIm2Col(cl, layerDimensions);
+    }
+    if(idx == 6) {
+        return new BackpropWeightsFft(cl, layerDimensions);
+    }
     throw std::runtime_error("BackpropWeights::instanceSpecific doesnt handle idx " + toString(idx));
 }
 
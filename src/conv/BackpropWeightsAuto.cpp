@@ -9,6 +9,7 @@
 #include <stdexcept>
 
 #include "conv/BackpropWeightsAuto.h"
+#include "conv/AutoTuneCache.h"
 #include "util/stringhelper.h"
 #include "util/StatefulTimer.h"
 #include "util/Timer.h"
@@ -21,21 +22,25 @@ using namespace std;
 #undef VIRTUAL
 #define VIRTUAL 
 
+// each candidate is run once untimed, to warm up, then timed this many times,
+// and we take the median
+#define NUM_TIMING_REPS 3
+
 BackpropWeightsAuto::BackpropWeightsAuto(EasyCL *cl, LayerDimensions dim) :
         BackpropWeights(cl, dim),
-        milliseconds(0),
+        microseconds(0),
         valid(0),
         chosenIndex(-1),
         instances(0)
          {
     num = BackpropWeights::getNumImplementations();
-    milliseconds = new int[ num];
+    microseconds = new double[ num];
     valid = new bool[ num ];
     instances = new BackpropWeights *[ num ];
     for(int i = 0; i < num; i++) {
         instances[i] = 0;
         valid[i] = false;
-        milliseconds[i] = -1;
+        microseconds[i] = -1;
     }
     nextIndex = 0;
 }
@@ -45,31 +50,54 @@ VIRTUAL BackpropWeightsAuto::~BackpropWeightsAuto() {
             delete instances[i];
         }
     }
+    delete[] instances;
+    delete[] valid;
+    delete[] microseconds;
 }
 VIRTUAL void BackpropWeightsAuto::calcGradWeights(
         int batchSize, CLWrapper *inputDataWrapper, CLWrapper *gradOutput, CLWrapper *weightsWrapper,
         CLWrapper *gradInput) {
+    if(chosenIndex == -1 && nextIndex == 0) {
+        // maybe we already benchmarked this layer shape on this device, in an earlier run?
+        string key = AutoTuneCache::makeKey(cl, "calcGradWeights", num, dim, batchSize);
+        int cachedIndex = -1;
+        if(AutoTuneCache::instance()->get(key, &cachedIndex) && cachedIndex >= 0 && cachedIndex < num) {
+            try {
+                instances[cachedIndex] = BackpropWeights::instanceSpecific(cachedIndex, cl, dim);
+                valid[cachedIndex] = true;
+                chosenIndex = cachedIndex;
+            } catch(runtime_error &e) {
+                cout << StatefulTimer::instance()->prefix << "BackpropWeightsAuto: cached kernel " << cachedIndex << " cant be used, retuning: " << e.what() << endl;
+            }
+        }
+    }
     while(chosenIndex == -1 && nextIndex < num) {
         int thisIndex = nextIndex;
         nextIndex++;
-        cout << "calcGradWeights try kernel " << thisIndex << endl;
         if(BackpropWeights::plausiblyOptimal(thisIndex, batchSize, dim)) {
             BackpropWeights *candidate = 0;
             try {
                 candidate = BackpropWeights::instanceSpecific(thisIndex, cl, dim);
                 instances[thisIndex] = candidate;
                 valid[thisIndex] = true;
-                cout << "   ... seems valid" << endl;
             } catch(runtime_error &e) {
                 cout << StatefulTimer::instance()->prefix << "BackpropWeightsAuto: kernel " << thisIndex << ": this instance cant be used: " << e.what() << endl;
                 valid[thisIndex] = false;
             }
             if(valid[thisIndex]) {
-                Timer timer;
                 try {
+                    // calcGradWeights is idempotent, so the last rep leaves a valid result for our caller
                     candidate->calcGradWeights(batchSize, inputDataWrapper, gradOutput, weightsWrapper, gradInput);
-                    milliseconds[thisIndex] = (int)timer.lap();
-                    cout << StatefulTimer::instance()->prefix << "BackpropWeightsAuto: kernel " << thisIndex << " " << milliseconds[thisIndex] << "ms" << endl;
+                    cl->finish();
+                    double timesMicroseconds[NUM_TIMING_REPS];
+                    for(int rep = 0; rep < NUM_TIMING_REPS; rep++) {
+                        Timer timer;
+                        candidate->calcGradWeights(batchSize, inputDataWrapper, gradOutput, weightsWrapper, gradInput);
+                        cl->finish();
+                        timesMicroseconds[rep] = timer.lapMicroseconds();
+                    }
+                    sort(timesMicroseconds, timesMicroseconds + NUM_TIMING_REPS);
+                    microseconds[thisIndex] = timesMicroseconds[NUM_TIMING_REPS / 2];
                     return;
                 } catch(runtime_error &e) {
                     cout << StatefulTimer::instance()->prefix << "BackpropWeightsAuto: kernel " << thisIndex << " this instance cant be used: " << e.what() << endl;
@@ -77,41 +105,36 @@ VIRTUAL void BackpropWeightsAuto::calcGradWeights(
                     delete instances[thisIndex];
                     instances[thisIndex] = 0;
                 }
-            } else {
-                cout << "   ... not valid" << endl;
             }
-        } else {
-            cout << "  ... not plausibly optimal, skipping" << endl;
         }
     }
     if(chosenIndex == -1) {
-//        cout << StatefulTimer::instance()->prefix + "BackpropWeightsAuto::calcGradWeights choosing best instance:" << endl;
         int bestIndex = -1;
-        int bestTime = 0;
+        double bestTime = 0;
         for(int i = 0; i < num; i++) {
             if(!valid[i]) {
-                cout << "   calcGradWeights kernel " << i << ": cannot be used" << endl;
                 continue;
             }
-            cout << "   calcGradWeights kernel " << i << " time: " << milliseconds[i] << "ms" << endl;
-            if(bestIndex == -1) {
-                bestIndex = i;
-                bestTime = milliseconds[i];
-                continue;
-            }
-            if(milliseconds[i] < bestTime) {
-                bestTime = milliseconds[i];
+            if(bestIndex == -1 || microseconds[i] < bestTime) {
+                bestTime = microseconds[i];
                 bestIndex = i;
             }
         }
         if(bestIndex != -1) {
-            cout << "   calcGradWeights layer selected kernel " << bestIndex << endl;
+            cout << StatefulTimer::instance()->prefix << "BackpropWeightsAuto: selected kernel " << bestIndex << " (" << bestTime << "us)" << endl;
             this->chosenIndex = bestIndex;
+            AutoTuneCache::instance()->set(AutoTuneCache::makeKey(cl, "calcGradWeights", num, dim, batchSize), bestIndex);
         } else {
             throw runtime_error(StatefulTimer::instance()->prefix + "No valid calcGradWeights implementations found");
         }
+        // free the losers
+        for(int i = 0; i < num; i++) {
+            if(i != chosenIndex && instances[i] != 0) {
+                delete instances[i];
+                instances[i] = 0;
+            }
+        }
     }
-//    cout << "BackpropWeightsAuto::calcGradWeights using instance index: " << chosenIndex << endl;
     instances[chosenIndex]->calcGradWeights(batchSize, inputDataWrapper, gradOutput, weightsWrapper, gradInput);
 }
 
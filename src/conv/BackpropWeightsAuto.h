@@ -32,7 +32,7 @@ public:
 //    ActivationFunction const*fn;
 
     int num;
-    int *milliseconds;
+    double *microseconds; // median time of each candidate
     bool *valid;
     int chosenIndex;
     BackpropWeights **instances;
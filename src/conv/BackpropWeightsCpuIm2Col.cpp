@@ -0,0 +1,202 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "conv/BackpropWeightsCpuIm2Col.h"
+#include "conv/CpuGemm.h"
+#include "conv/Im2ColCpu.h"
+#include "util/ThreadPool.h"
+#include "util/stringhelper.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+
+namespace {
+    class BackpropWeightsCpuIm2ColTask : public ThreadPoolTask {
+    public:
+        BackpropWeightsCpuIm2Col *owner;
+        int numFilterBlocks;
+        int filtersPerBlock;
+        const float *gradOutput;
+        const float *inputs;
+        virtual void run(int threadId, int taskId) {
+            const int n = taskId / numFilterBlocks;
+            const int filterBegin = (taskId % numFilterBlocks) * filtersPerBlock;
+            const int filterEnd = min(owner->dim.numFilters, filterBegin + filtersPerBlock);
+            owner->accumulateTask(threadId, n, filterBegin, filterEnd, gradOutput, inputs);
+        }
+    };
+    class BackpropWeightsCpuIm2ColReduceTask : public ThreadPoolTask {
+    public:
+        BackpropWeightsCpuIm2Col *owner;
+        int sliceSize;
+        float multiplier;
+        float *gradWeights;
+        virtual void run(int threadId, int taskId) {
+            owner->reduceSlice(taskId * sliceSize, sliceSize, multiplier, gradWeights);
+        }
+    };
+}
+
+PUBLIC BackpropWeightsCpuIm2Col::BackpropWeightsCpuIm2Col(EasyCL *cl, LayerDimensions dim) :
+        BackpropWeights(cl, dim),
+        threadPool(ThreadPool::instance()) {
+    if(dim.skip != 0) {
+        throw runtime_error("BackpropWeightsCpuIm2Col: skip not supported, skip=" + toString(dim.skip));
+    }
+    const int numThreads = threadPool->getNumThreads();
+    columnsByThread.resize(numThreads, 0);
+    gemmByThread.resize(numThreads, 0);
+    gradWeightsByThread.resize(numThreads, 0);
+    gradBiasByThread.resize(numThreads, 0);
+    threadUsed.resize(numThreads, 0);
+}
+PUBLIC VIRTUAL BackpropWeightsCpuIm2Col::~BackpropWeightsCpuIm2Col() {
+    for(int i = 0; i < (int)columnsByThread.size(); i++) {
+        delete[] columnsByThread[i];
+        delete gemmByThread[i];
+        delete[] gradWeightsByThread[i];
+        delete[] gradBiasByThread[i];
+    }
+}
+PUBLIC VIRTUAL void BackpropWeightsCpuIm2Col::calcGradWeights(int batchSize, CLWrapper *gradOutputWrapper, CLWrapper *imagesWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *gradBiasWrapper) {
+    gradOutputWrapper->copyToHost();
+    imagesWrapper->copyToHost();
+    float *gradBias = 0;
+    if(dim.biased) {
+        gradBias = (float *)gradBiasWrapper->getHostArray();
+    }
+    calcGradWeights(batchSize, (float *)gradOutputWrapper->getHostArray(), (float *)imagesWrapper->getHostArray(),
+        (float *)gradWeightsWrapper->getHostArray(), gradBias);
+    gradWeightsWrapper->copyToDevice();
+    if(dim.biased) {
+        gradBiasWrapper->copyToDevice();
+    }
+}
+PUBLIC VIRTUAL void BackpropWeightsCpuIm2Col::calcGradWeights(int batchSize, float *gradOutput,
+        float *inputs, float *gradWeights, float *gradBias) {
+    StatefulTimer::timeCheck("BackpropWeightsCpuIm2Col::calcGradWeights START");
+    const int numThreads = threadPool->getNumThreads();
+    for(int i = 0; i < numThreads; i++) {
+        threadUsed[i] = 0;
+    }
+    // if the batch is smaller than the pool, also split the filters, as for ForwardCpuIm2Col
+    int numFilterBlocks = 1;
+    if(batchSize < numThreads) {
+        numFilterBlocks = (numThreads + batchSize - 1) / batchSize;
+        numFilterBlocks = max(1, min(numFilterBlocks, dim.numFilters / 16));
+    }
+    BackpropWeightsCpuIm2ColTask task;
+    task.owner = this;
+    task.numFilterBlocks = numFilterBlocks;
+    task.filtersPerBlock = (dim.numFilters + numFilterBlocks - 1) / numFilterBlocks;
+    task.gradOutput = gradOutput;
+    task.inputs = inputs;
+    threadPool->run(batchSize * numFilterBlocks, &task);
+    StatefulTimer::timeCheck("BackpropWeightsCpuIm2Col::calcGradWeights after accumulate");
+
+    const float learningMultiplier = learningRateToMultiplier(batchSize);
+    const int sliceSize = 4096;
+    BackpropWeightsCpuIm2ColReduceTask reduceTask;
+    reduceTask.owner = this;
+    reduceTask.sliceSize = sliceSize;
+    reduceTask.multiplier = learningMultiplier;
+    reduceTask.gradWeights = gradWeights;
+    threadPool->run((dim.filtersSize + sliceSize - 1) / sliceSize, &reduceTask);
+    if(dim.biased) {
+        for(int filter = 0; filter < dim.numFilters; filter++) {
+            float sum = 0;
+            for(int threadId = 0; threadId < numThreads; threadId++) {
+                if(threadUsed[threadId]) {
+                    sum += gradBiasByThread[threadId][filter];
+                }
+            }
+            gradBias[filter] = sum * learningMultiplier;
+        }
+    }
+    StatefulTimer::timeCheck("BackpropWeightsCpuIm2Col::calcGradWeights END");
+}
+PUBLIC void BackpropWeightsCpuIm2Col::accumulateTask(int threadId, int n, int filterBegin, int filterEnd,
+        const float *gradOutput, const float *inputs) {
+    if(filterBegin >= filterEnd) {
+        return;
+    }
+    const int columnsRows = dim.inputPlanes * dim.filterSizeSquared;
+    if(gemmByThread[threadId] == 0) {
+        gemmByThread[threadId] = new CpuGemm();
+        gradWeightsByThread[threadId] = new float[dim.filtersSize];
+        gradBiasByThread[threadId] = new float[dim.numFilters];
+    }
+    if(!threadUsed[threadId]) {
+        memset(gradWeightsByThread[threadId], 0, sizeof(float) * dim.filtersSize);
+        memset(gradBiasByThread[threadId], 0, sizeof(float) * dim.numFilters);
+        threadUsed[threadId] = 1;
+    }
+    const float *image = inputs + n * dim.inputCubeSize;
+    const float *columns = image;
+    if(!Im2ColCpu::isIdentity(dim)) {
+        if(columnsByThread[threadId] == 0) {
+            columnsByThread[threadId] = new float[columnsRows * dim.outputSizeSquared];
+        }
+        Im2ColCpu::im2Col(dim, image, columnsByThread[threadId]);
+        columns = columnsByThread[threadId];
+    }
+    const float *gradOutputBlock = gradOutput + n * dim.outputCubeSize + filterBegin * dim.outputSizeSquared;
+    // gradWeights[filter][inPlane, filterRow, filterCol] += sum over outPos of
+    //     gradOutput[filter][outPos] * columns[inPlane, filterRow, filterCol][outPos]
+    gemmByThread[threadId]->sgemm(false, true, filterEnd - filterBegin, columnsRows, dim.outputSizeSquared,
+        gradOutputBlock, dim.outputSizeSquared,
+        columns, dim.outputSizeSquared,
+        1.0f, gradWeightsByThread[threadId] + filterBegin * columnsRows, columnsRows);
+    if(dim.biased) {
+        float *gradBias = gradBiasByThread[threadId];
+        for(int filter = filterBegin; filter < filterEnd; filter++) {
+            const float *gradOutputPlane = gradOutputBlock + (filter - filterBegin) * dim.outputSizeSquared;
+            float sum = 0;
+            for(int i = 0; i < dim.outputSizeSquared; i++) {
+                sum += gradOutputPlane[i];
+            }
+            gradBias[filter] += sum;
+        }
+    }
+}
+PUBLIC void BackpropWeightsCpuIm2Col::reduceSlice(int begin, int count, float multiplier, float *gradWeights) {
+    const int end = min(dim.filtersSize, begin + count);
+    bool first = true;
+    for(int threadId = 0; threadId < (int)threadUsed.size(); threadId++) {
+        if(!threadUsed[threadId]) {
+            continue;
+        }
+        const float *threadGradWeights = gradWeightsByThread[threadId];
+        if(first) {
+            for(int i = begin; i < end; i++) {
+                gradWeights[i] = threadGradWeights[i];
+            }
+            first = false;
+        } else {
+            for(int i = begin; i < end; i++) {
+                gradWeights[i] += threadGradWeights[i];
+            }
+        }
+    }
+    if(first) {
+        fill(gradWeights + begin, gradWeights + end, 0.0f);
+    }
+    if(multiplier != 1.0f) {
+        for(int i = begin; i < end; i++) {
+            gradWeights[i] *= multiplier;
+        }
+    }
+}
+
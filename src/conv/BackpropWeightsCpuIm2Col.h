@@ -0,0 +1,58 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+#include "BackpropWeights.h"
+
+class CpuGemm;
+class ThreadPool;
+
+#include "DeepCLDllExport.h"
+
+#define STATIC static
+#define VIRTUAL virtual
+
+// multithreaded cpu weight gradients: per [image][block of filters], im2col,
+// then one blocked gemm of gradOutput with the transposed columns, accumulated
+// into a per-thread gradWeights, and the per-thread results summed at the end
+class DeepCL_EXPORT BackpropWeightsCpuIm2Col : public BackpropWeights {
+    private:
+    ThreadPool *threadPool;
+    // per-thread scratch and accumulators, indexed by threadId, allocated on first use
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    std::vector<float *> columnsByThread;
+    std::vector<CpuGemm *> gemmByThread;
+    std::vector<float *> gradWeightsByThread;
+    std::vector<float *> gradBiasByThread;
+    std::vector<char> threadUsed; // by this call to calcGradWeights
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    BackpropWeightsCpuIm2Col(EasyCL *cl, LayerDimensions dim);
+    VIRTUAL ~BackpropWeightsCpuIm2Col();
+    VIRTUAL void calcGradWeights(int batchSize, CLWrapper *gradOutputWrapper, CLWrapper *imagesWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *gradBiasWrapper);
+    VIRTUAL void calcGradWeights(int batchSize, float *gradOutput,
+    float *inputs, float *gradWeights, float *gradBias);
+    void accumulateTask(int threadId, int n, int filterBegin, int filterEnd,
+    const float *gradOutput, const float *inputs);
+    void reduceSlice(int begin, int count, float multiplier, float *gradWeights);
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,32 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "conv/BackpropWeightsFft.h"
+#include "conv/Fft.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+#define PUBLIC
+
+PUBLIC BackpropWeightsFft::BackpropWeightsFft(EasyCL *cl, LayerDimensions dim) :
+        BackpropWeights(cl, dim),
+        fft(0) {
+    fft = new Fft(cl, dim);
+}
+PUBLIC VIRTUAL BackpropWeightsFft::~BackpropWeightsFft() {
+    delete fft;
+}
+PUBLIC VIRTUAL void BackpropWeightsFft::calcGradWeights(int batchSize, CLWrapper *gradOutputWrapper, CLWrapper *inputWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *gradBiasWrapper) {
+    StatefulTimer::timeCheck("BackpropWeightsFft::calcGradWeights START");
+    fft->calcGradWeights(batchSize, gradOutputWrapper, inputWrapper, learningRateToMultiplier(batchSize),
+        gradWeightsWrapper, gradBiasWrapper);
+    StatefulTimer::timeCheck("BackpropWeightsFft::calcGradWeights END");
+}
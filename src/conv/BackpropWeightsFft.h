@@ -0,0 +1,39 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "BackpropWeights.h"
+
+#include "DeepCLDllExport.h"
+
+class Fft;
+class CLWrapper;
+class EasyCL;
+
+#define STATIC static
+#define VIRTUAL virtual
+
+// gradWeights in the frequency domain, see Fft: the products of the input and gradOutput
+// spectra are summed over the whole batch, then transformed back once
+class DeepCL_EXPORT BackpropWeightsFft : public BackpropWeights {
+    private:
+    Fft *fft;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    BackpropWeightsFft(EasyCL *cl, LayerDimensions dim);
+    VIRTUAL ~BackpropWeightsFft();
+    VIRTUAL void calcGradWeights(int batchSize, CLWrapper *gradOutputWrapper, CLWrapper *inputWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *gradBiasWrapper);
+
+    // [[[end]]]
+};
+
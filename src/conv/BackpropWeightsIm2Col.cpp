@@ -30,26 +30,36 @@ PUBLIC BackpropWeightsIm2Col::BackpropWeightsIm2Col(EasyCL *cl, LayerDimensions
 //    addBias = new AddBias(cl);
 
     this->im2Col = new Im2Col(cl, dim);
+    this->ones = 0;
+    this->onesWrapper = 0;
+    this->onesSize = 0;
 }
 PUBLIC VIRTUAL BackpropWeightsIm2Col::~BackpropWeightsIm2Col() {
     delete im2Col;
+    delete onesWrapper;
+    delete[] ones;
 //    delete addBias;
 }
 //int batchSize, CLWrapper *gradOutputWrapper, CLWrapper *imagesWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *gradBiasWrapper
 PUBLIC VIRTUAL void BackpropWeightsIm2Col::calcGradWeights(int batchSize, CLWrapper *gradOutputWrapper, CLWrapper *inputWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *gradBiasWrapper) {
     StatefulTimer::timeCheck("BackpropWeightsIm2Col::calcGradWeights START");
 
-    int columnsSize = dim.inputPlanes * dim.filterSizeSquared * dim.outputSizeSquared;
-    float *columns = new float[columnsSize];
-    CLWrapper *columnsWrapper = cl->wrap(columnsSize, columns);
-    columnsWrapper->createOnDevice();
-
-    int onesSize = dim.outputSizeSquared;
-    float *ones = new float[onesSize];
-    CLWrapper *onesWrapper = cl->wrap(onesSize, ones);
-    onesWrapper->createOnDevice();
-    CLMathWrapper ones_(onesWrapper);
-    ones_ = 1.0f;
+    // each gemm covers a sub-batch of images, summing their contributions to
+    // gradWeights along its inner dimension
+    int subBatchSize = im2Col->allocateWorkspace(batchSize);
+    CLWrapper *columnsWrapper = im2Col->getColumnsWrapper();
+
+    int onesSize = subBatchSize * dim.outputSizeSquared;
+    if(onesSize > this->onesSize) {
+        delete onesWrapper;
+        delete[] ones;
+        this->onesSize = onesSize;
+        ones = new float[onesSize];
+        onesWrapper = cl->wrap(onesSize, ones);
+        onesWrapper->createOnDevice();
+        CLMathWrapper ones_(onesWrapper);
+        ones_ = 1.0f;
+    }
 
 //    cout << "gradColumnsSize: " << gradColumnsSize << endl;
 //    cout << "weightsize: " << weightsWrapper->size() << endl;
@@ -62,17 +72,27 @@ PUBLIC VIRTUAL void BackpropWeightsIm2Col::calcGradWeights(int batchSize, CLWrap
         CLMathWrapper gradBias_(gradBiasWrapper);
         gradBias_ = 0.0f;
     }
-    for (int b = 0; b < batchSize; b ++) {
+    for (int b = 0; b < batchSize; b += subBatchSize) {
+        int numImages = batchSize - b < subBatchSize ? batchSize - b : subBatchSize;
 //        cout << "b=" << b << " numkernels=" << numKernels << endl;
 
         im2Col->im2Col(
-            inputWrapper, b * dim.inputCubeSize,
+            inputWrapper, b * dim.inputCubeSize, numImages,
             columnsWrapper
         );
-        
+
+        // a single image's gradOutput is already in gemm layout
+        CLWrapper *gradOutputPlanesWrapper = gradOutputWrapper;
+        int64 gradOutputOffset = b * dim.outputCubeSize;
+        if(numImages > 1) {
+            gradOutputPlanesWrapper = im2Col->getPlanesWrapper();
+            gradOutputOffset = 0;
+            im2Col->cubesToPlanes(gradOutputWrapper, b * dim.outputCubeSize, numImages, gradOutputPlanesWrapper);
+        }
+
         int64 m = dim.inputPlanes * dim.filterSizeSquared;
         int64 n = dim.numFilters;
-        int64 k = dim.outputSizeSquared;
+        int64 k = (int64)numImages * dim.outputSizeSquared;
 
         ClBlasHelper::Gemm(
             cl,
@@ -81,12 +101,12 @@ PUBLIC VIRTUAL void BackpropWeightsIm2Col::calcGradWeights(int batchSize, CLWrap
             m, k, n,
             1,
             columnsWrapper, 0,
-            gradOutputWrapper, b * dim.outputCubeSize,
+            gradOutputPlanesWrapper, gradOutputOffset,
             1,
             gradWeightsWrapper, 0
         );
         if(dim.biased) {
-            int64 m_ = dim.outputSizeSquared;
+            int64 m_ = (int64)numImages * dim.outputSizeSquared;
             int64 n_ = dim.numFilters;
             ClBlasHelper::Gemv(
                 cl,
@@ -94,7 +114,7 @@ PUBLIC VIRTUAL void BackpropWeightsIm2Col::calcGradWeights(int batchSize, CLWrap
                 clblasTrans,
                 m_, n_,
                 1,
-                gradOutputWrapper, b * dim.outputCubeSize,
+                gradOutputPlanesWrapper, gradOutputOffset,
                 onesWrapper, 0,
                 1,
                 gradBiasWrapper, 0
@@ -102,12 +122,6 @@ PUBLIC VIRTUAL void BackpropWeightsIm2Col::calcGradWeights(int batchSize, CLWrap
         }
     }
 
-    delete onesWrapper;
-    delete[] ones;
-
-    delete columnsWrapper;
-    delete[] columns;
-
     StatefulTimer::timeCheck("BackpropWeightsIm2Col::calcGradWeights after call calcGradWeights");
 
     StatefulTimer::timeCheck("BackpropWeightsIm2Col::calcGradWeights END");
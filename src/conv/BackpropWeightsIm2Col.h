@@ -18,9 +18,9 @@ class DeepCL_EXPORT BackpropWeightsIm2Col : public BackpropWeights {
 //    CLKernel *kernelIm2Col;
     Im2Col *im2Col;
 
-    float *columns;
-    CLWrapper *columnsWrapper;
-    int numKernels;
+    float *ones; // [workspace images * outputSizeSquared], for the gradBias gemv
+    CLWrapper *onesWrapper;
+    int onesSize;
 
     // [[[cog
     // import cog_addheaders
@@ -14,6 +14,12 @@
 #include "BackwardGpuNaive.h"
 #include "BackwardGpuCached.h"
 #include "BackwardIm2Col.h"
+#include "BackwardCpuIm2Col.h"
+#include "BackwardWinograd.h"
+#include "BackwardCpuWinograd.h"
+#include "WinogradCpu.h"
+#include "BackwardFft.h"
+#include "Fft.h"
 
 #include "Backward.h"
 
@@ -52,20 +58,46 @@ STATIC Backward *Backward::instanceSpecific(int idx, EasyCL *cl, LayerDimensions
     if(idx == 3) {
         return new BackwardIm2Col(cl, layerDimensions);
     }
+    if(idx == 4) {
+        return new BackwardCpuIm2Col(cl, layerDimensions);
+    }
+    if(idx == 5) {
+        return new BackwardWinograd(cl, layerDimensions, 2);
+    }
+    if(idx == 6) {
+        return new BackwardWinograd(cl, layerDimensions, 4);
+    }
+    if(idx == 7) {
+        return new BackwardCpuWinograd(cl, layerDimensions);
+    }
+    if(idx == 8) {
+        return new BackwardFft(cl, layerDimensions);
+    }
     throw std::runtime_error("backproperrorsv2::isntancespecifc, index not known: " + toString(idx));
 }
 Backward::Backward(EasyCL *cl, LayerDimensions layerDimensions) :
         cl(cl),
-        dim(layerDimensions) {
+        dim(layerDimensions),
+        weightsGeneration(-1) {
+}
+// as Forward::setWeightsGeneration
+VIRTUAL void Backward::setWeightsGeneration(int generation) {
+    weightsGeneration = generation;
 }
 STATIC int Backward::getNumImplementations() {
-    return 4;
+    return 9;
 }
 STATIC bool Backward::plausiblyOptimal(int index, int batchSize, LayerDimensions dim) {
     if(index == 0) { 
         return false;
     }
-    if(index >= 4) {
+    if(index >= 9) {
+        return false;
+    }
+    if(index >= 5 && index <= 7 && !WinogradCpu::isSupported(dim)) {
+        return false;
+    }
+    if(index == 8 && (dim.filterSize < 5 || !Fft::isSupported(dim))) {
         return false;
     }
     return true;
@@ -22,6 +22,7 @@ class DeepCL_EXPORT Backward {
 public:
     EasyCL *cl;
     LayerDimensions dim;
+    int weightsGeneration; // see Forward::setWeightsGeneration
 //    ActivationFunction const *upstreamFn;
 
     virtual ~Backward() {}
@@ -38,6 +39,7 @@ public:
     STATIC Backward *instanceForTest(EasyCL *cl, LayerDimensions layerDimensions);
     STATIC Backward *instanceSpecific(int idx, EasyCL *cl, LayerDimensions layerDimensions);
     Backward(EasyCL *cl, LayerDimensions layerDimensions);
+    VIRTUAL void setWeightsGeneration(int generation);
     STATIC int getNumImplementations();
     STATIC bool plausiblyOptimal(int index, int batchSize, LayerDimensions dim);
     VIRTUAL float * backward(int batchSize, float *input, float *gradOutput, float *filters);
@@ -9,6 +9,7 @@
 #include <stdexcept>
 
 #include "conv/BackwardAuto.h"
+#include "conv/AutoTuneCache.h"
 #include "util/stringhelper.h"
 #include "util/StatefulTimer.h"
 #include "util/Timer.h"
@@ -21,21 +22,25 @@ using namespace std;
 #undef VIRTUAL
 #define VIRTUAL 
 
+// each candidate is run once untimed, to warm up, then timed this many times,
+// and we take the median
+#define NUM_TIMING_REPS 3
+
 BackwardAuto::BackwardAuto(EasyCL *cl, LayerDimensions dim) :
         Backward(cl, dim),
-        milliseconds(0),
+        microseconds(0),
         valid(0),
         chosenIndex(-1),
         instances(0)
          {
     num = Backward::getNumImplementations();
-    milliseconds = new int[ num];
+    microseconds = new double[ num];
     valid = new bool[ num ];
     instances = new Backward *[ num ];
     for(int i = 0; i < num; i++) {
         instances[i] = 0;
         valid[i] = false;
-        milliseconds[i] = -1;
+        microseconds[i] = -1;
     }
     nextIndex = 0;
 }
@@ -45,31 +50,54 @@ VIRTUAL BackwardAuto::~BackwardAuto() {
             delete instances[i];
         }
     }
+    delete[] instances;
+    delete[] valid;
+    delete[] microseconds;
 }
 VIRTUAL void BackwardAuto::backward(
         int batchSize, CLWrapper *inputDataWrapper, CLWrapper *gradOutput, CLWrapper *weightsWrapper,
         CLWrapper *gradInput) {
+    if(chosenIndex == -1 && nextIndex == 0) {
+        // maybe we already benchmarked this layer shape on this device, in an earlier run?
+        string key = AutoTuneCache::makeKey(cl, "backward", num, dim, batchSize);
+        int cachedIndex = -1;
+        if(AutoTuneCache::instance()->get(key, &cachedIndex) && cachedIndex >= 0 && cachedIndex < num) {
+            try {
+                instances[cachedIndex] = Backward::instanceSpecific(cachedIndex, cl, dim);
+                valid[cachedIndex] = true;
+                chosenIndex = cachedIndex;
+            } catch(runtime_error &e) {
+                cout << StatefulTimer::instance()->prefix << "BackwardAuto: cached kernel " << cachedIndex << " cant be used, retuning: " << e.what() << endl;
+            }
+        }
+    }
     while(chosenIndex == -1 && nextIndex < num) {
         int thisIndex = nextIndex;
         nextIndex++;
-        cout << "backward try kernel " << thisIndex << endl;
         if(Backward::plausiblyOptimal(thisIndex, batchSize, dim)) {
             Backward *candidate = 0;
             try {
                 candidate = Backward::instanceSpecific(thisIndex, cl, dim);
                 instances[thisIndex] = candidate;
                 valid[thisIndex] = true;
-                cout << "   ... seems valid" << endl;
             } catch(runtime_error &e) {
                 cout << StatefulTimer::instance()->prefix << "BackwardAuto: kernel " << thisIndex << ": this instance cant be used: " << e.what() << endl;
                 valid[thisIndex] = false;
             }
             if(valid[thisIndex]) {
-                Timer timer;
                 try {
+                    // backward is idempotent, so the last rep leaves a valid result for our caller
                     candidate->backward(batchSize, inputDataWrapper, gradOutput, weightsWrapper, gradInput);
-                    milliseconds[thisIndex] = (int)timer.lap();
-                    cout << StatefulTimer::instance()->prefix << "BackwardAuto: kernel " << thisIndex << " " << milliseconds[thisIndex] << "ms" << endl;
+                    cl->finish();
+                    double timesMicroseconds[NUM_TIMING_REPS];
+                    for(int rep = 0; rep < NUM_TIMING_REPS; rep++) {
+                        Timer timer;
+                        candidate->backward(batchSize, inputDataWrapper, gradOutput, weightsWrapper, gradInput);
+                        cl->finish();
+                        timesMicroseconds[rep] = timer.lapMicroseconds();
+                    }
+                    sort(timesMicroseconds, timesMicroseconds + NUM_TIMING_REPS);
+                    microseconds[thisIndex] = timesMicroseconds[NUM_TIMING_REPS / 2];
                     return;
                 } catch(runtime_error &e) {
                     cout << StatefulTimer::instance()->prefix << "BackwardAuto: kernel " << thisIndex << " this instance cant be used: " << e.what() << endl;
@@ -77,41 +105,38 @@ VIRTUAL void BackwardAuto::backward(
                     delete instances[thisIndex];
                     instances[thisIndex] = 0;
                 }
-            } else {
-                cout << "   ... not valid" << endl;
             }
-        } else {
-            cout << "  ... not plausibly optimal, skipping" << endl;
         }
     }
     if(chosenIndex == -1) {
-//        cout << StatefulTimer::instance()->prefix + "BackwardAuto::backward choosing best instance:" << endl;
         int bestIndex = -1;
-        int bestTime = 0;
+        double bestTime = 0;
         for(int i = 0; i < num; i++) {
             if(!valid[i]) {
-                cout << "   backward kernel " << i << ": cannot be used" << endl;
                 continue;
             }
-            cout << "   backward kernel " << i << " time: " << milliseconds[i] << "ms" << endl;
-            if(bestIndex == -1) {
-                bestIndex = i;
-                bestTime = milliseconds[i];
-                continue;
-            }
-            if(milliseconds[i] < bestTime) {
-                bestTime = milliseconds[i];
+            if(bestIndex == -1 || microseconds[i] < bestTime) {
+                bestTime = microseconds[i];
                 bestIndex = i;
             }
         }
         if(bestIndex != -1) {
-            cout << "   backward layer selected kernel " << bestIndex << endl;
+            cout << StatefulTimer::instance()->prefix << "BackwardAuto: selected kernel " << bestIndex << " (" << bestTime << "us)" << endl;
             this->chosenIndex = bestIndex;
+            AutoTuneCache::instance()->set(AutoTuneCache::makeKey(cl, "backward", num, dim, batchSize), bestIndex);
         } else {
             throw runtime_error(StatefulTimer::instance()->prefix + "No valid backward implementations found");
         }
+        // free the losers
+        for(int i = 0; i < num; i++) {
+            if(i != chosenIndex && instances[i] != 0) {
+                delete instances[i];
+                instances[i] = 0;
+            }
+        }
     }
-//    cout << "BackwardAuto::backward using instance index: " << chosenIndex << endl;
+    // as in ForwardAuto, candidates are timed as if the weights always changed
+    instances[chosenIndex]->setWeightsGeneration(weightsGeneration);
     instances[chosenIndex]->backward(batchSize, inputDataWrapper, gradOutput, weightsWrapper, gradInput);
 }
 
@@ -0,0 +1,126 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "conv/BackwardCpuIm2Col.h"
+#include "conv/CpuGemm.h"
+#include "conv/Im2ColCpu.h"
+#include "util/ThreadPool.h"
+#include "util/stringhelper.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+
+namespace {
+    class BackwardCpuIm2ColTask : public ThreadPoolTask {
+    public:
+        BackwardCpuIm2Col *owner;
+        int numPlaneBlocks;
+        int planesPerBlock;
+        const float *gradOutput;
+        const float *weights;
+        float *gradInput;
+        virtual void run(int threadId, int taskId) {
+            const int n = taskId / numPlaneBlocks;
+            const int planeBegin = (taskId % numPlaneBlocks) * planesPerBlock;
+            const int planeEnd = min(owner->dim.inputPlanes, planeBegin + planesPerBlock);
+            owner->backwardTask(threadId, n, planeBegin, planeEnd, gradOutput, weights, gradInput);
+        }
+    };
+}
+
+PUBLIC BackwardCpuIm2Col::BackwardCpuIm2Col(EasyCL *cl, LayerDimensions dim) :
+        Backward(cl, dim),
+        threadPool(ThreadPool::instance()) {
+    if(dim.skip != 0) {
+        throw runtime_error("BackwardCpuIm2Col: skip not supported, skip=" + toString(dim.skip));
+    }
+    columnsByThread.resize(threadPool->getNumThreads(), 0);
+    gemmByThread.resize(threadPool->getNumThreads(), 0);
+}
+PUBLIC VIRTUAL BackwardCpuIm2Col::~BackwardCpuIm2Col() {
+    for(int i = 0; i < (int)columnsByThread.size(); i++) {
+        delete[] columnsByThread[i];
+        delete gemmByThread[i];
+    }
+}
+PUBLIC VIRTUAL void BackwardCpuIm2Col::backward(int batchSize,
+        CLWrapper *inputDataWrapper, CLWrapper *gradOutputWrapper, CLWrapper *weightsWrapper,
+        CLWrapper *gradInputWrapper) {
+    gradOutputWrapper->copyToHost();
+    weightsWrapper->copyToHost();
+    calcGradInput(batchSize, (float *)gradOutputWrapper->getHostArray(), (float *)weightsWrapper->getHostArray(),
+        (float *)gradInputWrapper->getHostArray());
+    gradInputWrapper->copyToDevice();
+}
+// you own the returned gradInput array, and are responsible for deleting it
+PUBLIC VIRTUAL float *BackwardCpuIm2Col::backward(int batchSize, float *input, float *gradOutput, float *filters) {
+    float *gradInput = new float[batchSize * dim.inputCubeSize];
+    calcGradInput(batchSize, gradOutput, filters, gradInput);
+    return gradInput;
+}
+PUBLIC void BackwardCpuIm2Col::calcGradInput(int batchSize, const float *gradOutput, const float *weights, float *gradInput) {
+    StatefulTimer::timeCheck("BackwardCpuIm2Col::calcGradInput START");
+    // if the batch is smaller than the pool, also split the input planes, so all threads
+    // get some work.  each block writes its own planes of gradInput, so no overlap
+    const int numThreads = threadPool->getNumThreads();
+    int numPlaneBlocks = 1;
+    if(batchSize < numThreads) {
+        numPlaneBlocks = (numThreads + batchSize - 1) / batchSize;
+        numPlaneBlocks = max(1, min(numPlaneBlocks, dim.inputPlanes));
+    }
+    BackwardCpuIm2ColTask task;
+    task.owner = this;
+    task.numPlaneBlocks = numPlaneBlocks;
+    task.planesPerBlock = (dim.inputPlanes + numPlaneBlocks - 1) / numPlaneBlocks;
+    task.gradOutput = gradOutput;
+    task.weights = weights;
+    task.gradInput = gradInput;
+    threadPool->run(batchSize * numPlaneBlocks, &task);
+    StatefulTimer::timeCheck("BackwardCpuIm2Col::calcGradInput END");
+}
+PUBLIC void BackwardCpuIm2Col::backwardTask(int threadId, int n, int planeBegin, int planeEnd,
+        const float *gradOutput, const float *weights, float *gradInput) {
+    if(planeBegin >= planeEnd) {
+        return;
+    }
+    if(gemmByThread[threadId] == 0) {
+        gemmByThread[threadId] = new CpuGemm();
+    }
+    // the columns for a contiguous run of input planes are themselves contiguous,
+    // so this block looks just like a layer with fewer input planes
+    LayerDimensions blockDim = dim;
+    blockDim.setInputPlanes(planeEnd - planeBegin);
+    const int columnsRowsTotal = dim.inputPlanes * dim.filterSizeSquared;
+    const int columnsRowBegin = planeBegin * dim.filterSizeSquared;
+    const int columnsRows = (planeEnd - planeBegin) * dim.filterSizeSquared;
+    float *gradImageBlock = gradInput + n * dim.inputCubeSize + planeBegin * dim.inputSizeSquared;
+    float *gradColumns = gradImageBlock;
+    const bool isIdentity = Im2ColCpu::isIdentity(dim);
+    if(!isIdentity) {
+        if(columnsByThread[threadId] == 0) {
+            columnsByThread[threadId] = new float[columnsRowsTotal * dim.outputSizeSquared];
+        }
+        gradColumns = columnsByThread[threadId];
+    }
+    // gradColumns[inPlane, filterRow, filterCol][outPos] = sum over filter of
+    //     weights[filter][inPlane, filterRow, filterCol] * gradOutput[filter][outPos]
+    gemmByThread[threadId]->sgemm(true, false, columnsRows, dim.outputSizeSquared, dim.numFilters,
+        weights + columnsRowBegin, columnsRowsTotal,
+        gradOutput + n * dim.outputCubeSize, dim.outputSizeSquared,
+        0.0f, gradColumns, dim.outputSizeSquared);
+    if(!isIdentity) {
+        Im2ColCpu::col2Im(blockDim, gradColumns, gradImageBlock);
+    }
+}
+
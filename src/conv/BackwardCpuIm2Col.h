@@ -0,0 +1,56 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+#include "Backward.h"
+
+class CpuGemm;
+class ThreadPool;
+
+#include "DeepCLDllExport.h"
+
+#define STATIC static
+#define VIRTUAL virtual
+
+// multithreaded cpu backward: per [image][block of input planes], one blocked
+// gemm of the transposed weights with gradOutput, then col2im, spread across
+// the ThreadPool, writing directly into gradInput
+class DeepCL_EXPORT BackwardCpuIm2Col : public Backward {
+    private:
+    ThreadPool *threadPool;
+    // per-thread scratch, indexed by threadId, allocated on first use
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    std::vector<float *> columnsByThread;
+    std::vector<CpuGemm *> gemmByThread;
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    BackwardCpuIm2Col(EasyCL *cl, LayerDimensions dim);
+    VIRTUAL ~BackwardCpuIm2Col();
+    VIRTUAL void backward(int batchSize,
+        CLWrapper *inputDataWrapper, CLWrapper *gradOutputWrapper, CLWrapper *weightsWrapper,
+    CLWrapper *gradInputWrapper);
+    VIRTUAL float *backward(int batchSize, float *input, float *gradOutput, float *filters);
+    void calcGradInput(int batchSize, const float *gradOutput, const float *weights, float *gradInput);
+    void backwardTask(int threadId, int n, int planeBegin, int planeEnd,
+    const float *gradOutput, const float *weights, float *gradInput);
+
+    // [[[end]]]
+};
+
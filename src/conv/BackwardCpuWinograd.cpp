@@ -0,0 +1,56 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+
+#include "conv/BackwardCpuWinograd.h"
+#include "conv/WinogradCpu.h"
+#include "util/stringhelper.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+
+PUBLIC BackwardCpuWinograd::BackwardCpuWinograd(EasyCL *cl, LayerDimensions dim) :
+        Backward(cl, dim),
+        winograd(0) {
+    if(!WinogradCpu::isSupported(dim)) {
+        throw runtime_error("BackwardCpuWinograd: only 3x3 filters, without skip, are supported, filterSize=" + toString(dim.filterSize) + " skip=" + toString(dim.skip));
+    }
+    // padding 1 in forward leaves padding 1 here; no padding in forward needs 2, to
+    // get back to the input size
+    winograd = new WinogradCpu(dim.numFilters, dim.outputSize, dim.inputPlanes, dim.padZeros ? 1 : 2,
+        WinogradCpu::chooseTileSize(dim.inputSize));
+}
+PUBLIC VIRTUAL BackwardCpuWinograd::~BackwardCpuWinograd() {
+    delete winograd;
+}
+PUBLIC VIRTUAL void BackwardCpuWinograd::backward(int batchSize,
+        CLWrapper *inputDataWrapper, CLWrapper *gradOutputWrapper, CLWrapper *weightsWrapper,
+        CLWrapper *gradInputWrapper) {
+    gradOutputWrapper->copyToHost();
+    weightsWrapper->copyToHost();
+    calcGradInput(batchSize, (float *)gradOutputWrapper->getHostArray(), (float *)weightsWrapper->getHostArray(),
+        (float *)gradInputWrapper->getHostArray());
+    gradInputWrapper->copyToDevice();
+}
+// you own the returned gradInput array, and are responsible for deleting it
+PUBLIC VIRTUAL float *BackwardCpuWinograd::backward(int batchSize, float *input, float *gradOutput, float *filters) {
+    float *gradInput = new float[batchSize * dim.inputCubeSize];
+    calcGradInput(batchSize, gradOutput, filters, gradInput);
+    return gradInput;
+}
+PUBLIC void BackwardCpuWinograd::calcGradInput(int batchSize, const float *gradOutput, const float *weights, float *gradInput) {
+    StatefulTimer::timeCheck("BackwardCpuWinograd::calcGradInput START");
+    winograd->setFilters(weights, true);
+    winograd->convolve(batchSize, gradOutput, 0, gradInput);
+    StatefulTimer::timeCheck("BackwardCpuWinograd::calcGradInput END");
+}
+
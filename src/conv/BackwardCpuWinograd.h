@@ -0,0 +1,42 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "Backward.h"
+
+class WinogradCpu;
+
+#include "DeepCLDllExport.h"
+
+#define STATIC static
+#define VIRTUAL virtual
+
+// multithreaded cpu backward, for 3x3 filters: gradInput is gradOutput convolved
+// with the filters rotated 180 degrees, which WinogradCpu does in F(4x4, 3x3), or
+// F(2x2, 3x3) tiles
+class DeepCL_EXPORT BackwardCpuWinograd : public Backward {
+    private:
+    WinogradCpu *winograd;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    BackwardCpuWinograd(EasyCL *cl, LayerDimensions dim);
+    VIRTUAL ~BackwardCpuWinograd();
+    VIRTUAL void backward(int batchSize,
+        CLWrapper *inputDataWrapper, CLWrapper *gradOutputWrapper, CLWrapper *weightsWrapper,
+    CLWrapper *gradInputWrapper);
+    VIRTUAL float *backward(int batchSize, float *input, float *gradOutput, float *filters);
+    void calcGradInput(int batchSize, const float *gradOutput, const float *weights, float *gradInput);
+
+    // [[[end]]]
+};
+
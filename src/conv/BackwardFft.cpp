@@ -0,0 +1,33 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "conv/BackwardFft.h"
+#include "conv/Fft.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+#define PUBLIC
+
+PUBLIC BackwardFft::BackwardFft(EasyCL *cl, LayerDimensions dim) :
+        Backward(cl, dim),
+        fft(0) {
+    fft = new Fft(cl, dim);
+}
+PUBLIC VIRTUAL BackwardFft::~BackwardFft() {
+    delete fft;
+}
+PUBLIC VIRTUAL void BackwardFft::backward(int batchSize,
+        CLWrapper *inputDataWrapper, CLWrapper *gradOutputWrapper, CLWrapper *weightsWrapper,
+        CLWrapper *gradInputWrapper) {
+    StatefulTimer::timeCheck("BackwardFft::backward START");
+    fft->backward(batchSize, gradOutputWrapper, weightsWrapper, weightsGeneration, gradInputWrapper);
+    StatefulTimer::timeCheck("BackwardFft::backward END");
+}
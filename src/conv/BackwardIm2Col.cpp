@@ -34,41 +34,44 @@ PUBLIC VIRTUAL void BackwardIm2Col::backward(int batchSize,
         CLWrapper *gradInputWrapper) {
     StatefulTimer::timeCheck("BackwardIm2Col::backward START");
 
-    int gradColumnsSize = dim.inputPlanes * dim.filterSizeSquared * dim.outputSizeSquared;
-    float *gradColumns = new float[gradColumnsSize];
-    CLWrapper *gradColumnsWrapper = cl->wrap(gradColumnsSize, gradColumns);
-    gradColumnsWrapper->createOnDevice();
-//    cout << "gradColumnsSize: " << gradColumnsSize << endl;
-//    cout << "weightsize: " << weightsWrapper->size() << endl;
+    // each gemm covers a sub-batch of images: their gradOutput is reordered into
+    // one matrix, and the resulting gradColumns folded back into each image
+    int subBatchSize = im2Col->allocateWorkspace(batchSize);
+    CLWrapper *gradColumnsWrapper = im2Col->getColumnsWrapper();
 
     StatefulTimer::timeCheck("BackwardIm2Col::backward after alloc");
 
     if(!gradInputWrapper->isOnDevice()) {
         gradInputWrapper->createOnDevice();
     }
-    for (int b = 0; b < batchSize; b ++) {
-//        cout << "b=" << b << " numkernels=" << numKernels << endl;
-        long m = dim.outputSizeSquared;
-        long n = dim.inputPlanes * dim.filterSizeSquared;
-        long k = dim.numFilters;
+    for (int b = 0; b < batchSize; b += subBatchSize) {
+        int numImages = batchSize - b < subBatchSize ? batchSize - b : subBatchSize;
+        int64 m = (int64)numImages * dim.outputSizeSquared;
+        int64 n = dim.inputPlanes * dim.filterSizeSquared;
+        int64 k = dim.numFilters;
 //        cout << "m=" << m << " k=" << k << " n=" << n << endl;
 
+        // a single image's gradOutput is already in gemm layout
+        CLWrapper *gradOutputPlanesWrapper = gradOutputWrapper;
+        int64 gradOutputOffset = b * dim.outputCubeSize;
+        if(numImages > 1) {
+            gradOutputPlanesWrapper = im2Col->getPlanesWrapper();
+            gradOutputOffset = 0;
+            im2Col->cubesToPlanes(gradOutputWrapper, b * dim.outputCubeSize, numImages, gradOutputPlanesWrapper);
+        }
         ClBlasHelper::Gemm(
             cl, clblasColumnMajor, clblasNoTrans, clblasTrans,
             m, k, n,
             1,
-            gradOutputWrapper, b * dim.outputCubeSize,
+            gradOutputPlanesWrapper, gradOutputOffset,
             weightsWrapper, 0,
             0,
             gradColumnsWrapper, 0
         );
 
-        im2Col->col2Im(gradColumnsWrapper, gradInputWrapper, b * dim.inputCubeSize);
+        im2Col->col2Im(gradColumnsWrapper, numImages, gradInputWrapper, b * dim.inputCubeSize);
     }
 
-    delete gradColumnsWrapper;
-    delete[] gradColumns;
-
     StatefulTimer::timeCheck("BackwardIm2Col::backward after call backward");
 
     StatefulTimer::timeCheck("BackwardIm2Col::backward END");
@@ -16,10 +16,6 @@ class DeepCL_EXPORT BackwardIm2Col : public Backward {
 //    CLKernel *kernelCol2Im;
 //    AddBias *addBias;
 
-    float *columns;
-    CLWrapper *columnsWrapper;
-    int numKernels;
-
     // [[[cog
     // import cog_addheaders
     // cog_addheaders.addv2()
@@ -0,0 +1,42 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+
+#include "conv/BackwardWinograd.h"
+#include "conv/Winograd.h"
+#include "conv/WinogradCpu.h"
+#include "util/stringhelper.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+#define PUBLIC
+
+PUBLIC BackwardWinograd::BackwardWinograd(EasyCL *cl, LayerDimensions dim, int tileSize) :
+        Backward(cl, dim),
+        winograd(0) {
+    if(!WinogradCpu::isSupported(dim)) {
+        throw runtime_error("BackwardWinograd: only 3x3 filters, without skip, are supported, filterSize=" + toString(dim.filterSize) + " skip=" + toString(dim.skip));
+    }
+    // same geometry as BackwardCpuWinograd
+    winograd = new Winograd(cl, dim.numFilters, dim.outputSize, dim.inputPlanes, dim.padZeros ? 1 : 2,
+        tileSize, true, false);
+}
+PUBLIC VIRTUAL BackwardWinograd::~BackwardWinograd() {
+    delete winograd;
+}
+PUBLIC VIRTUAL void BackwardWinograd::backward(int batchSize,
+        CLWrapper *inputDataWrapper, CLWrapper *gradOutputWrapper, CLWrapper *weightsWrapper,
+        CLWrapper *gradInputWrapper) {
+    StatefulTimer::timeCheck("BackwardWinograd::backward START");
+    winograd->convolve(batchSize, gradOutputWrapper, weightsWrapper, 0, gradInputWrapper);
+    StatefulTimer::timeCheck("BackwardWinograd::backward END");
+}
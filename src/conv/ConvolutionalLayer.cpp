@@ -18,6 +18,8 @@
 #include "clmath/GpuAdd.h"
 #include "clmath/CopyBuffer.h"
 #include "layer/Layer.h"
+#include "weights/WeightsPersister.h"
+#include "util/ReducedPrecision.h"
 
 using namespace std;
 
@@ -33,6 +35,7 @@ ConvolutionalLayer::ConvolutionalLayer(EasyCL *cl, Layer *previousLayer, Convolu
         trainerState(0),
         biasTrainerState(0),
         forwardImpl(0),
+        backpropWeightsImpl(0),
         backwardImpl(0),
 
         weights(0),
@@ -50,7 +53,12 @@ ConvolutionalLayer::ConvolutionalLayer(EasyCL *cl, Layer *previousLayer, Convolu
         gradBiasWrapper(0),
 
         batchSize(0),
-        allocatedSpaceNumExamples(0)
+        allocatedSpaceNumExamples(0),
+        deviceWeights(maker->deviceWeights),
+        reducedWeights(0),
+        reducedWeightsWrapper(0),
+        inputQuantizationScale(0),
+        weightsGeneration(0)
             {
     dim.setInputPlanes(previousLayer->getOutputPlanes())
         .setInputSize(previousLayer->getOutputSize())
@@ -66,10 +74,15 @@ ConvolutionalLayer::ConvolutionalLayer(EasyCL *cl, Layer *previousLayer, Convolu
 
 //    dim = LayerDimensions(upstreamNumPlanes, upstreamImageSize, 
 //        numPlanes, filterSize, padZeros, biased);
-    forwardImpl = Forward::instance(cl, dim);
-    backpropWeightsImpl = BackpropWeights::instance(cl, dim);
-    if(previousLayer->needsBackProp()) {
-        backwardImpl = Backward::instance(cl, dim);
+    if(deviceWeights != WeightsPersister::DTYPE_FLOAT32 && !inferenceOnly) {
+        throw runtime_error("ConvolutionalLayer: " + WeightsPersister::dtypeName(deviceWeights) + " weights on the device need an inference-only net, see NeuralNet::setDeviceWeights");
+    }
+    forwardImpl = Forward::instanceForFiltersDtype(cl, dim, deviceWeights);
+    if(!inferenceOnly) {
+        backpropWeightsImpl = BackpropWeights::instance(cl, dim);
+        if(previousLayer->needsBackProp()) {
+            backwardImpl = Backward::instance(cl, dim);
+        }
     }
 
     if(dim.filterSize > dim.inputSize) {
@@ -83,21 +96,30 @@ ConvolutionalLayer::ConvolutionalLayer(EasyCL *cl, Layer *previousLayer, Convolu
     randomizeWeights(maker->_weightsInitializer);
 
     weightsWrapper = cl->wrap(getWeightsSize(), weights);
-    weightsWrapper->copyToDevice();
+    if(deviceWeights == WeightsPersister::DTYPE_FLOAT32) {
+        weightsWrapper->copyToDevice();
+    } else {
+        // two bytes per weight, which the kernels read as half, or as bf16
+        reducedWeights = new unsigned short[ getWeightsSize() ];
+        reducedWeightsWrapper = cl->wrap(getWeightsSize() * 2, (unsigned char *)reducedWeights);
+        copyReducedWeightsToDevice();
+    }
 
     if(dim.biased) {
         biasWrapper = cl->wrap(getBiasSize(), bias);
         biasWrapper->copyToDevice();
     }
 
-    gradWeights = new float[ getWeightsSize() ];
-    gradWeightsWrapper = cl->wrap(getWeightsSize(), gradWeights);
-    gradWeightsWrapper->createOnDevice();
+    if(!inferenceOnly) {
+        gradWeights = new float[ getWeightsSize() ];
+        gradWeightsWrapper = cl->wrap(getWeightsSize(), gradWeights);
+        gradWeightsWrapper->createOnDevice();
 
-    if(dim.biased) {
-        gradBias = new float[ getBiasSize() ];
-        gradBiasWrapper = cl->wrap(getBiasSize(), gradBias);
-        gradBiasWrapper->createOnDevice();
+        if(dim.biased) {
+            gradBias = new float[ getBiasSize() ];
+            gradBiasWrapper = cl->wrap(getBiasSize(), gradBias);
+            gradBiasWrapper->createOnDevice();
+        }
     }
 
     gpuAdd = new GpuAdd(cl);
@@ -107,15 +129,19 @@ VIRTUAL ConvolutionalLayer::~ConvolutionalLayer() {
     delete gpuAdd;
     delete copyBuffer;
 
+    if(!outputShared) {
+        delete outputWrapper;
+        delete[] output;
+    }
     delete weightsWrapper;
+    delete reducedWeightsWrapper;
     delete biasWrapper;
-    delete outputWrapper;
     delete gradInputWrapper;
     delete gradWeightsWrapper;
     delete gradBiasWrapper;
 
-    delete[] output;
     delete[] weights;
+    delete[] reducedWeights;
     delete[] bias;
     delete[] gradInput;
     delete[] gradWeights;
@@ -161,6 +187,11 @@ VIRTUAL CLWrapper *ConvolutionalLayer::getGradInputWrapper() {
     return gradInputWrapper;
 }
 VIRTUAL CLWrapper *ConvolutionalLayer::getWeightsWrapper() {
+    // trainers update the weights through this
+    if(deviceWeights != WeightsPersister::DTYPE_FLOAT32) {
+        throw runtime_error("ConvolutionalLayer " + toString(layerIndex) + " keeps its weights on the device as " + WeightsPersister::dtypeName(deviceWeights) + ", so has no fp32 weights wrapper");
+    }
+    weightsGeneration++;
     return weightsWrapper;
 }
 VIRTUAL CLWrapper *ConvolutionalLayer::getBiasWrapper() {
@@ -176,6 +207,7 @@ VIRTUAL bool ConvolutionalLayer::hasOutputWrapper() const {
     return true;
 }
 VIRTUAL CLWrapper *ConvolutionalLayer::getOutputWrapper() {
+    checkOutputNotOverwritten();
     return outputWrapper;
 }
 VIRTUAL bool ConvolutionalLayer::needsBackProp() {
@@ -277,20 +309,38 @@ VIRTUAL void ConvolutionalLayer::setBatchSize(int batchSize) {
     this->batchSize = batchSize;
     this->allocatedSpaceNumExamples = batchSize;
 
-    delete outputWrapper;
-    delete[] output;
-
     delete gradInputWrapper;
     delete[] gradInput;
+    gradInputWrapper = 0;
+    gradInput = 0;
 
-    output = new float[getOutputNumElements()];
-    outputWrapper = cl->wrap(getOutputNumElements(), output);
+    if(!outputShared) {
+        delete outputWrapper;
+        delete[] output;
+        output = new float[getOutputNumElements()];
+        outputWrapper = cl->wrap(getOutputNumElements(), output);
+    }
 
-    if(layerIndex > 1) {
+    if(layerIndex > 1 && !inferenceOnly) {
         gradInput = new float[ previousLayer->getOutputNumElements() ];
         gradInputWrapper = cl->wrap(previousLayer->getOutputNumElements(), gradInput);
     }
 }
+VIRTUAL bool ConvolutionalLayer::canShareOutput() const {
+    return true;
+}
+VIRTUAL void ConvolutionalLayer::setSharedOutput(float *output, CLWrapper *outputWrapper) {
+    if(!outputShared) {
+        delete this->outputWrapper;
+        delete[] this->output;
+    }
+    this->output = output;
+    this->outputWrapper = outputWrapper;
+    outputShared = output != 0;
+    if(!outputShared) {
+        allocatedSpaceNumExamples = 0;
+    }
+}
 VIRTUAL void ConvolutionalLayer::setWeights(float *weights, float *bias) {
 //    cout << "setweights" << endl;
     initWeights(weights);
@@ -328,7 +378,21 @@ VIRTUAL void ConvolutionalLayer::initWeights(float const*weights) {
 //    cout << "initweights()" << endl;
     int weightsSize = getWeightsSize();
     memcpy(this->weights, weights, sizeof(float) * weightsSize);
-    weightsWrapper->copyToDevice();
+    if(deviceWeights == WeightsPersister::DTYPE_FLOAT32) {
+        weightsWrapper->copyToDevice();
+    } else {
+        copyReducedWeightsToDevice();
+    }
+    weightsGeneration++;
+}
+// rounds the host weights to deviceWeights, and writes them to the device
+void ConvolutionalLayer::copyReducedWeightsToDevice() {
+    if(deviceWeights == WeightsPersister::DTYPE_FLOAT16) {
+        ReducedPrecision::floatsToHalves(weights, reducedWeights, getWeightsSize());
+    } else {
+        ReducedPrecision::floatsToBfloat16s(weights, reducedWeights, getWeightsSize());
+    }
+    reducedWeightsWrapper->copyToDevice();
 }
 VIRTUAL void ConvolutionalLayer::initBias(float const*bias) {
     int biasSize = dim.numFilters;
@@ -373,6 +437,7 @@ VIRTUAL float const*ConvolutionalLayer::getBias() const {
     return bias;
 }
 VIRTUAL float * ConvolutionalLayer::getOutput() {
+    checkOutputNotOverwritten();
     if(outputWrapper->isDeviceDirty()) {
         outputWrapper->copyToHost();
 //        outputCopiedToHost = true;
@@ -395,7 +460,9 @@ VIRTUAL void ConvolutionalLayer::forward() {
         upstreamWrapper->copyToDevice();
     }
     StatefulTimer::instance()->timeCheck("    forward layer " + toString(layerIndex) + ", copied to device");
-    forwardImpl->forward(batchSize, upstreamWrapper, weightsWrapper, biasWrapper, outputWrapper);
+    forwardImpl->setWeightsGeneration(weightsGeneration);
+    CLWrapper *deviceWeightsWrapper = reducedWeightsWrapper != 0 ? reducedWeightsWrapper : weightsWrapper;
+    forwardImpl->forward(batchSize, upstreamWrapper, deviceWeightsWrapper, biasWrapper, outputWrapper);
     StatefulTimer::instance()->timeCheck("    forward layer " + toString(layerIndex) + ",  after clFinish");
 
     if(!previousLayer->hasOutputWrapper()) {
@@ -425,6 +492,7 @@ VIRTUAL void ConvolutionalLayer::backward() {
     }
 
     if(previousLayer->needsBackProp()) {
+        backwardImpl->setWeightsGeneration(weightsGeneration);
         backwardImpl->backward(batchSize, inputWrapper, gradOutputWrapper, weightsWrapper, gradInputWrapper);
         StatefulTimer::instance()->timeCheck("backproperrors(): calced gradInput, layer " + ::toString(layerIndex) );
     }
@@ -476,6 +544,9 @@ VIRTUAL TrainerState *ConvolutionalLayer::getBiasTrainerState() {
     return biasTrainerState;
 }
 VIRTUAL void ConvolutionalLayer::setTrainerState(TrainerStateMaker *trainerStateMaker) {
+    if(inferenceOnly) {
+        throw runtime_error("ConvolutionalLayer " + toString(layerIndex) + " is inference-only, so cannot be trained");
+    }
     delete trainerState;
     delete biasTrainerState;
     this->trainerState = trainerStateMaker->instance(cl, getWeightsSize());
@@ -62,6 +62,13 @@ public:
     int batchSize;
     int allocatedSpaceNumExamples;
 
+    int deviceWeights; // WeightsPersister::DTYPE_FLOAT32, or, inference-only, DTYPE_FLOAT16 or DTYPE_BFLOAT16
+    unsigned short *reducedWeights; // the weights as deviceWeights, if not fp32, else 0
+    CLWrapper *reducedWeightsWrapper; // what the forward kernel reads, if not fp32; weightsWrapper then stays on the host
+
+    float inputQuantizationScale; // for int8 inference, 0 until calibrated, see Int8Quantizer
+    int weightsGeneration; // bumped whenever the weights might change, see Forward::setWeightsGeneration
+
 //    bool weightsCopiedToHost;
 //    bool biasCopiedToHost;
 //    bool outputCopiedToHost;
@@ -134,12 +141,15 @@ public:
     VIRTUAL void printWeights();
     VIRTUAL void printOutput();
     VIRTUAL void setBatchSize(int batchSize);
+    VIRTUAL bool canShareOutput() const;
+    VIRTUAL void setSharedOutput(float *output, CLWrapper *outputWrapper);
     VIRTUAL void setWeights(float *weights, float *bias);
     VIRTUAL int getOutputCubeSize() const;
     VIRTUAL int getPersistSize(int version) const;
     VIRTUAL void persistToArray(int version, float *array);
     VIRTUAL void unpersistFromArray(int version, float const*array);
     VIRTUAL void initWeights(float const*weights);
+    void copyReducedWeightsToDevice();
     VIRTUAL void initBias(float const*bias);
     VIRTUAL int getWeightsSize() const;
     VIRTUAL int getBiasSize() const;
@@ -0,0 +1,170 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#define CPUGEMM_AVX2
+#include <immintrin.h>
+#endif
+
+#include "conv/CpuGemm.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+
+// register tile is MR x NR, cache blocks are MC x KC of A, and KC x NC of B
+// MR x NR = 6 x 16 uses 12 of the 16 avx2 registers for the accumulators
+#define MR 6
+#define NR 16
+#define MC 120
+#define KC 256
+#define NC 1024
+
+PUBLIC CpuGemm::CpuGemm() {
+    packedA = new float[MC * KC];
+    packedB = new float[KC * NC];
+}
+PUBLIC CpuGemm::~CpuGemm() {
+    delete[] packedA;
+    delete[] packedB;
+}
+PUBLIC void CpuGemm::sgemm(bool transA, bool transB, int M, int N, int K,
+        const float *A, int lda, const float *B, int ldb,
+        float beta, float *C, int ldc) {
+    if(beta == 0.0f) {
+        for(int row = 0; row < M; row++) {
+            memset(C + row * ldc, 0, sizeof(float) * N);
+        }
+    } else if(beta != 1.0f) {
+        for(int row = 0; row < M; row++) {
+            float *cRow = C + row * ldc;
+            for(int col = 0; col < N; col++) {
+                cRow[col] *= beta;
+            }
+        }
+    }
+    for(int jc = 0; jc < N; jc += NC) {
+        const int nc = min(NC, N - jc);
+        for(int pc = 0; pc < K; pc += KC) {
+            const int kc = min(KC, K - pc);
+            packB(transB, B, ldb, pc, kc, jc, nc);
+            for(int ic = 0; ic < M; ic += MC) {
+                const int mc = min(MC, M - ic);
+                packA(transA, A, lda, ic, mc, pc, kc);
+                for(int jr = 0; jr < nc; jr += NR) {
+                    const int nr = min(NR, nc - jr);
+                    for(int ir = 0; ir < mc; ir += MR) {
+                        const int mr = min(MR, mc - ir);
+                        microKernel(kc, packedA + ir * kc, packedB + jr * kc,
+                            C + (ic + ir) * ldc + jc + jr, ldc, mr, nr);
+                    }
+                }
+            }
+        }
+    }
+}
+// packs op(A)[row0..row0+numRows)[col0..col0+numCols) into panels of MR rows,
+// each stored as [col][MR], zero-padded at the bottom
+PRIVATE void CpuGemm::packA(bool transA, const float *A, int lda, int row0, int numRows, int col0, int numCols) {
+    float *dst = packedA;
+    for(int panelRow = 0; panelRow < numRows; panelRow += MR) {
+        const int rowsInPanel = min(MR, numRows - panelRow);
+        for(int col = 0; col < numCols; col++) {
+            for(int i = 0; i < rowsInPanel; i++) {
+                const int row = row0 + panelRow + i;
+                dst[i] = transA ? A[(col0 + col) * lda + row] : A[row * lda + col0 + col];
+            }
+            for(int i = rowsInPanel; i < MR; i++) {
+                dst[i] = 0.0f;
+            }
+            dst += MR;
+        }
+    }
+}
+// packs op(B)[row0..row0+numRows)[col0..col0+numCols) into panels of NR columns,
+// each stored as [row][NR], zero-padded at the right
+PRIVATE void CpuGemm::packB(bool transB, const float *B, int ldb, int row0, int numRows, int col0, int numCols) {
+    float *dst = packedB;
+    for(int panelCol = 0; panelCol < numCols; panelCol += NR) {
+        const int colsInPanel = min(NR, numCols - panelCol);
+        for(int row = 0; row < numRows; row++) {
+            if(transB) {
+                for(int j = 0; j < colsInPanel; j++) {
+                    dst[j] = B[(col0 + panelCol + j) * ldb + row0 + row];
+                }
+            } else {
+                memcpy(dst, B + (row0 + row) * ldb + col0 + panelCol, sizeof(float) * colsInPanel);
+            }
+            for(int j = colsInPanel; j < NR; j++) {
+                dst[j] = 0.0f;
+            }
+            dst += NR;
+        }
+    }
+}
+// C[mr][nr] += a[kc][MR] * b[kc][NR], where only the top-left mr x nr of the tile is stored back
+PRIVATE STATIC void CpuGemm::microKernel(int kc, const float *a, const float *b, float *C, int ldc, int mr, int nr) {
+    float tile[MR * NR];
+#ifdef CPUGEMM_AVX2
+    __m256 acc[MR][2];
+    for(int i = 0; i < MR; i++) {
+        acc[i][0] = _mm256_setzero_ps();
+        acc[i][1] = _mm256_setzero_ps();
+    }
+    for(int p = 0; p < kc; p++) {
+        const __m256 b0 = _mm256_loadu_ps(b);
+        const __m256 b1 = _mm256_loadu_ps(b + 8);
+        for(int i = 0; i < MR; i++) {
+            const __m256 ai = _mm256_broadcast_ss(a + i);
+            acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+        }
+        a += MR;
+        b += NR;
+    }
+    if(mr == MR && nr == NR) {
+        for(int i = 0; i < MR; i++) {
+            float *cRow = C + i * ldc;
+            _mm256_storeu_ps(cRow, _mm256_add_ps(_mm256_loadu_ps(cRow), acc[i][0]));
+            _mm256_storeu_ps(cRow + 8, _mm256_add_ps(_mm256_loadu_ps(cRow + 8), acc[i][1]));
+        }
+        return;
+    }
+    for(int i = 0; i < MR; i++) {
+        _mm256_storeu_ps(tile + i * NR, acc[i][0]);
+        _mm256_storeu_ps(tile + i * NR + 8, acc[i][1]);
+    }
+#else
+    for(int i = 0; i < MR * NR; i++) {
+        tile[i] = 0.0f;
+    }
+    for(int p = 0; p < kc; p++) {
+        for(int i = 0; i < MR; i++) {
+            const float ai = a[i];
+            float *tileRow = tile + i * NR;
+            for(int j = 0; j < NR; j++) {
+                tileRow[j] += ai * b[j];
+            }
+        }
+        a += MR;
+        b += NR;
+    }
+#endif
+    for(int i = 0; i < mr; i++) {
+        float *cRow = C + i * ldc;
+        const float *tileRow = tile + i * NR;
+        for(int j = 0; j < nr; j++) {
+            cRow[j] += tileRow[j];
+        }
+    }
+}
+
@@ -0,0 +1,49 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// cache-blocked, packed single-precision gemm, for the cpu implementations
+// all matrices are row-major:
+//     C[M][N] = op(A)[M][K] * op(B)[K][N] + beta * C
+// where op(A) is A, stored as [M][lda], or, if transA, A stored as [K][lda]
+// and similarly for op(B)
+// single-threaded: the callers split the work across the ThreadPool themselves
+// each instance owns its packing buffers, so use one instance per thread
+// inner kernel uses avx2+fma if compiled with those enabled (eg -march=native,
+// see option BUILD_NATIVE_CPU_KERNELS), otherwise plain loops, which
+// the compiler can auto-vectorize
+class DeepCL_EXPORT CpuGemm {
+    private:
+    float *packedA;
+    float *packedB;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    CpuGemm();
+    ~CpuGemm();
+    void sgemm(bool transA, bool transB, int M, int N, int K,
+        const float *A, int lda, const float *B, int ldb,
+    float beta, float *C, int ldc);
+
+    private:
+    void packA(bool transA, const float *A, int lda, int row0, int numRows, int col0, int numCols);
+    void packB(bool transB, const float *B, int ldb, int row0, int numRows, int col0, int numCols);
+    STATIC void microKernel(int kc, const float *a, const float *b, float *C, int ldc, int mr, int nr);
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,482 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "EasyCL.h"
+#include "util/stringhelper.h"
+#include "conv/Im2Col.h"
+
+#include "conv/Fft.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+#define PUBLIC
+
+// the padded square, size, is kept to this, so each work-item's row fits in private memory
+static const int maxSize = 256;
+static const double pi = 3.14159265358979323846;
+
+PUBLIC STATIC int Fft::chooseSize(LayerDimensions dim) {
+    int padded = dim.inputSize + (dim.padZeros ? 2 * dim.halfFilterSize : 0);
+    int size = 2;
+    while(size < padded) {
+        size <<= 1;
+    }
+    return size;
+}
+PUBLIC STATIC bool Fft::isSupported(LayerDimensions dim) {
+    return dim.skip == 0 && dim.filterSize % 2 == 1 && chooseSize(dim) <= maxSize;
+}
+PUBLIC Fft::Fft(EasyCL *cl, LayerDimensions dim) :
+        cl(cl),
+        dim(dim),
+        size(chooseSize(dim)),
+        logSize(log2Ceil(chooseSize(dim))),
+        sizeSquared(chooseSize(dim) * chooseSize(dim)),
+        margin(dim.padZeros ? dim.halfFilterSize : 0) {
+    if(!isSupported(dim)) {
+        throw runtime_error("Fft: needs skip 0, odd filterSize, and a padded input of at most " + toString(maxSize) +
+            ", skip=" + toString(dim.skip) + " filterSize=" + toString(dim.filterSize) + " size=" + toString(size));
+    }
+    this->kernelPadAndFftRows = 0;
+    this->kernelFftColumns = 0;
+    this->kernelIfftRowsAndCrop = 0;
+    this->kernelMultiplyForward = 0;
+    this->kernelMultiplyBackward = 0;
+    this->kernelMultiplyGradWeights = 0;
+    this->kernelGradBias = 0;
+    this->spectraHostPlaceholder = 0;
+    this->filterSpectraWrapper = 0;
+    this->filterSpectraGeneration = -1;
+    this->workspaceImages = 0;
+    this->inputSpectraWrapper = 0;
+    this->outputSpectraWrapper = 0;
+
+    // computed in double, so the twiddles are as accurate as a float can hold
+    twiddles = new float[size];
+    for(int j = 0; j < size / 2; j++) {
+        double angle = 2 * pi * j / size;
+        twiddles[2 * j] = (float)cos(angle);
+        twiddles[2 * j + 1] = (float)-sin(angle);
+    }
+    twiddlesWrapper = cl->wrap(size, twiddles);
+    twiddlesWrapper->copyToDevice();
+}
+PUBLIC VIRTUAL Fft::~Fft() {
+    delete kernelPadAndFftRows;
+    delete kernelFftColumns;
+    delete kernelIfftRowsAndCrop;
+    delete kernelMultiplyForward;
+    delete kernelMultiplyBackward;
+    delete kernelMultiplyGradWeights;
+    delete kernelGradBias;
+    delete twiddlesWrapper;
+    delete[] twiddles;
+    delete filterSpectraWrapper;
+    freeWorkspace();
+}
+// output should be [batchSize][numFilters][outputSize][outputSize]; doesnt add bias
+PUBLIC void Fft::forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, int weightsGeneration,
+        CLWrapper *outputWrapper) {
+    transformFilters(weightsWrapper, weightsGeneration);
+    int subBatchSize = allocateWorkspace(batchSize);
+    if(!outputWrapper->isOnDevice()) {
+        outputWrapper->createOnDevice();
+    }
+    if(kernelMultiplyForward == 0) {
+        kernelMultiplyForward = buildKernel("multiplyForward");
+    }
+    for(int b = 0; b < batchSize; b += subBatchSize) {
+        int numImages = batchSize - b < subBatchSize ? batchSize - b : subBatchSize;
+        toFrequency(numImages * dim.inputPlanes, dataWrapper, b * dim.inputCubeSize, dim.inputSize, margin, inputSpectraWrapper);
+        kernelMultiplyForward->in(numImages)->in(inputSpectraWrapper)->in(filterSpectraWrapper)->out(outputSpectraWrapper);
+        run(kernelMultiplyForward, numImages * dim.numFilters * sizeSquared);
+        fromFrequency(numImages * dim.numFilters, outputSpectraWrapper, 0, dim.outputSize, 1.0f / sizeSquared,
+            outputWrapper, b * dim.outputCubeSize);
+    }
+}
+// gradInput should be [batchSize][inputPlanes][inputSize][inputSize]
+PUBLIC void Fft::backward(int batchSize, CLWrapper *gradOutputWrapper, CLWrapper *weightsWrapper, int weightsGeneration,
+        CLWrapper *gradInputWrapper) {
+    transformFilters(weightsWrapper, weightsGeneration);
+    int subBatchSize = allocateWorkspace(batchSize);
+    if(!gradInputWrapper->isOnDevice()) {
+        gradInputWrapper->createOnDevice();
+    }
+    if(kernelMultiplyBackward == 0) {
+        kernelMultiplyBackward = buildKernel("multiplyBackward");
+    }
+    for(int b = 0; b < batchSize; b += subBatchSize) {
+        int numImages = batchSize - b < subBatchSize ? batchSize - b : subBatchSize;
+        toFrequency(numImages * dim.numFilters, gradOutputWrapper, b * dim.outputCubeSize, dim.outputSize, 0, outputSpectraWrapper);
+        kernelMultiplyBackward->in(numImages)->in(outputSpectraWrapper)->in(filterSpectraWrapper)->out(inputSpectraWrapper);
+        run(kernelMultiplyBackward, numImages * dim.inputPlanes * sizeSquared);
+        fromFrequency(numImages * dim.inputPlanes, inputSpectraWrapper, margin, dim.inputSize, 1.0f / sizeSquared,
+            gradInputWrapper, b * dim.inputCubeSize);
+    }
+}
+// the gradWeights spectra are summed over the whole batch, then transformed back once
+PUBLIC void Fft::calcGradWeights(int batchSize, CLWrapper *gradOutputWrapper, CLWrapper *inputWrapper, float multiplier,
+        CLWrapper *gradWeightsWrapper, CLWrapper *gradBiasWrapper) {
+    allocateFilterSpectra();
+    // filterSpectraWrapper now holds gradWeights, not the filters
+    filterSpectraGeneration = -1;
+    int subBatchSize = allocateWorkspace(batchSize);
+    if(kernelMultiplyGradWeights == 0) {
+        kernelMultiplyGradWeights = buildKernel("multiplyGradWeights");
+    }
+    if(dim.biased && kernelGradBias == 0) {
+        kernelGradBias = buildKernel("gradBias");
+    }
+    for(int b = 0; b < batchSize; b += subBatchSize) {
+        int numImages = batchSize - b < subBatchSize ? batchSize - b : subBatchSize;
+        int accumulate = b == 0 ? 0 : 1;
+        toFrequency(numImages * dim.inputPlanes, inputWrapper, b * dim.inputCubeSize, dim.inputSize, margin, inputSpectraWrapper);
+        toFrequency(numImages * dim.numFilters, gradOutputWrapper, b * dim.outputCubeSize, dim.outputSize, 0, outputSpectraWrapper);
+        kernelMultiplyGradWeights->in(numImages)->in(inputSpectraWrapper)->in(outputSpectraWrapper)->in(accumulate);
+        kernelMultiplyGradWeights->inout(filterSpectraWrapper);
+        run(kernelMultiplyGradWeights, dim.numFilters * dim.inputPlanes * sizeSquared);
+        if(dim.biased) {
+            kernelGradBias->in(numImages)->in(outputSpectraWrapper)->in(accumulate)->in(multiplier)->inout(gradBiasWrapper);
+            run(kernelGradBias, dim.numFilters);
+        }
+    }
+    fromFrequency(dim.numFilters * dim.inputPlanes, filterSpectraWrapper, 0, dim.filterSize, multiplier / sizeSquared,
+        gradWeightsWrapper, 0);
+}
+// transforms the filters, unless filterSpectraWrapper already holds this generation of them
+void Fft::transformFilters(CLWrapper *weightsWrapper, int weightsGeneration) {
+    if(weightsGeneration >= 0 && weightsGeneration == filterSpectraGeneration) {
+        return;
+    }
+    allocateFilterSpectra();
+    toFrequency(dim.numFilters * dim.inputPlanes, weightsWrapper, 0, dim.filterSize, 0, filterSpectraWrapper);
+    filterSpectraGeneration = weightsGeneration;
+}
+void Fft::allocateFilterSpectra() {
+    if(filterSpectraWrapper != 0) {
+        return;
+    }
+    filterSpectraWrapper = createSpectraWrapper(dim.numFilters * dim.inputPlanes * sizeSquared * 2);
+}
+// a wrapper of numFloats, on the device only, see spectraHostPlaceholder
+CLWrapper *Fft::createSpectraWrapper(int numFloats) {
+    CLWrapper *wrapper = cl->wrap(numFloats, &spectraHostPlaceholder);
+    wrapper->createOnDevice();
+    return wrapper;
+}
+// how many images each pass will cover, for this batchSize, growing the workspace if
+// it has to
+int Fft::allocateWorkspace(int batchSize) {
+    int64 bytesPerImage = (int64)(dim.inputPlanes + dim.numFilters) * sizeSquared * 2 * sizeof(float);
+    int64 numImages = Im2Col::getWorkspaceBudget() / bytesPerImage;
+    if(numImages > batchSize) {
+        numImages = batchSize;
+    }
+    if(numImages < 1) {
+        numImages = 1;
+    }
+    if(numImages > workspaceImages) {
+        freeWorkspace();
+        workspaceImages = (int)numImages;
+        inputSpectraWrapper = createSpectraWrapper(workspaceImages * dim.inputPlanes * sizeSquared * 2);
+        outputSpectraWrapper = createSpectraWrapper(workspaceImages * dim.numFilters * sizeSquared * 2);
+    }
+    return (int)numImages;
+}
+void Fft::freeWorkspace() {
+    delete inputSpectraWrapper;
+    delete outputSpectraWrapper;
+    inputSpectraWrapper = 0;
+    outputSpectraWrapper = 0;
+    workspaceImages = 0;
+}
+// numPlanes sourceSize x sourceSize planes, from sourceOffset, placed at (sourceMargin, sourceMargin)
+void Fft::toFrequency(int numPlanes, CLWrapper *sourceWrapper, int sourceOffset, int sourceSize, int sourceMargin,
+        CLWrapper *spectraWrapper) {
+    if(kernelPadAndFftRows == 0) {
+        kernelPadAndFftRows = buildKernel("padAndFftRows");
+    }
+    if(kernelFftColumns == 0) {
+        kernelFftColumns = buildKernel("fftColumns");
+    }
+    kernelPadAndFftRows->in(numPlanes)->in(sourceWrapper)->in(sourceOffset)->in(sourceSize)->in(sourceMargin);
+    kernelPadAndFftRows->in(twiddlesWrapper)->out(spectraWrapper);
+    run(kernelPadAndFftRows, numPlanes * size);
+    kernelFftColumns->in(numPlanes)->in(0)->in(twiddlesWrapper)->inout(spectraWrapper);
+    run(kernelFftColumns, numPlanes * size);
+}
+// inverse of toFrequency, keeping the destSize x destSize square at (destMargin, destMargin);
+// overwrites the spectra
+void Fft::fromFrequency(int numPlanes, CLWrapper *spectraWrapper, int destMargin, int destSize, float scale,
+        CLWrapper *destWrapper, int destOffset) {
+    if(kernelIfftRowsAndCrop == 0) {
+        kernelIfftRowsAndCrop = buildKernel("ifftRowsAndCrop");
+    }
+    if(kernelFftColumns == 0) {
+        kernelFftColumns = buildKernel("fftColumns");
+    }
+    kernelFftColumns->in(numPlanes)->in(1)->in(twiddlesWrapper)->inout(spectraWrapper);
+    run(kernelFftColumns, numPlanes * size);
+    kernelIfftRowsAndCrop->in(numPlanes)->in(spectraWrapper)->in(twiddlesWrapper)->in(destMargin)->in(destSize);
+    kernelIfftRowsAndCrop->in(scale)->out(destWrapper)->in(destOffset);
+    run(kernelIfftRowsAndCrop, numPlanes * destSize);
+}
+void Fft::run(CLKernel *kernel, int numElements) {
+    int workgroupSize = cl->getMaxWorkgroupSize();
+    int numWorkgroups = (numElements + workgroupSize - 1) / workgroupSize;
+    kernel->run_1d(numWorkgroups * workgroupSize, workgroupSize);
+}
+CLKernel *Fft::buildKernel(std::string kernelName) {
+    string options = "";
+    options += " -DgSize=" + toString(size);
+    options += " -DgLogSize=" + toString(logSize);
+    options += " -DgSizeSquared=" + toString(sizeSquared);
+    options += " -DgInputPlanes=" + toString(dim.inputPlanes);
+    options += " -DgNumFilters=" + toString(dim.numFilters);
+    return cl->buildKernelFromString(getKernelSource(), kernelName, options, "cl/fft.cl");
+}
+STATIC int Fft::log2Ceil(int value) {
+    int log = 0;
+    while((1 << log) < value) {
+        log++;
+    }
+    return log;
+}
+STATIC std::string Fft::getKernelSource() {
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel("kernel", "cl/fft.cl")
+    // ]]]
+    // generated using cog, from cl/fft.cl:
+    const char * kernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "// convolution in the frequency domain: each plane is zero-padded into a gSize x gSize\n"
+    "// square, gSize a power of two, large enough that the circular convolution doesn't\n"
+    "// wrap, and transformed with a radix-2 fft, one work-item per row, then per column\n"
+    "// spectra are [plane][gSize][gSize] complex, float2 (re, im)\n"
+    "// with margin the layer's padding:\n"
+    "// forward: output = ifft(sum over inputPlanes of fft(input at margin) * conj(fft(filters)))\n"
+    "// backward: gradInput = ifft(sum over filters of fft(gradOutput) * fft(filters)), cropped at margin\n"
+    "// gradWeights: ifft(sum over images of fft(input at margin) * conj(fft(gradOutput)))\n"
+    "\n"
+    "// expected defines:\n"
+    "// gSize, gLogSize, gSizeSquared\n"
+    "// gInputPlanes, gNumFilters\n"
+    "\n"
+    "// in-place radix-2 fft of one row or column; inverse is unscaled\n"
+    "// twiddles[j] = exp(-2 pi i j / gSize), for j < gSize / 2\n"
+    "void fft(float *re, float *im, global const float2 *twiddles, const int inverse) {\n"
+    "    for (int i = 0; i < gSize; i++) {\n"
+    "        int j = 0;\n"
+    "        for (int bit = 0; bit < gLogSize; bit++) {\n"
+    "            j |= ((i >> bit) & 1) << (gLogSize - 1 - bit);\n"
+    "        }\n"
+    "        if (i < j) {\n"
+    "            float temp = re[i];\n"
+    "            re[i] = re[j];\n"
+    "            re[j] = temp;\n"
+    "            temp = im[i];\n"
+    "            im[i] = im[j];\n"
+    "            im[j] = temp;\n"
+    "        }\n"
+    "    }\n"
+    "    for (int half = 1; half < gSize; half <<= 1) {\n"
+    "        const int step = gSize / (2 * half);\n"
+    "        for (int start = 0; start < gSize; start += 2 * half) {\n"
+    "            for (int j = 0; j < half; j++) {\n"
+    "                const float2 twiddle = twiddles[j * step];\n"
+    "                const float wr = twiddle.x;\n"
+    "                const float wi = inverse ? -twiddle.y : twiddle.y;\n"
+    "                const int a = start + j;\n"
+    "                const int b = a + half;\n"
+    "                const float vr = re[b] * wr - im[b] * wi;\n"
+    "                const float vi = re[b] * wi + im[b] * wr;\n"
+    "                re[b] = re[a] - vr;\n"
+    "                im[b] = im[a] - vi;\n"
+    "                re[a] += vr;\n"
+    "                im[a] += vi;\n"
+    "            }\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// places each sourceSize x sourceSize source plane at (margin, margin), zero elsewhere,\n"
+    "// and transforms the rows\n"
+    "// globalId: [plane][row]\n"
+    "kernel void padAndFftRows(const int numPlanes, global const float *source, const int sourceOffset,\n"
+    "        const int sourceSize, const int margin, global const float2 *twiddles, global float2 *spectra) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    const int plane = globalId / gSize;\n"
+    "    const int row = globalId % gSize;\n"
+    "    if (plane >= numPlanes) {\n"
+    "        return;\n"
+    "    }\n"
+    "    global float2 *spectrumRow = spectra + (plane * gSize + row) * gSize;\n"
+    "    const int sourceRow = row - margin;\n"
+    "    if (sourceRow < 0 || sourceRow >= sourceSize) {\n"
+    "        for (int col = 0; col < gSize; col++) {\n"
+    "            spectrumRow[col] = (float2)(0.0f, 0.0f);\n"
+    "        }\n"
+    "        return;\n"
+    "    }\n"
+    "    global const float *sourceRowData = source + sourceOffset + (plane * sourceSize + sourceRow) * sourceSize;\n"
+    "    float re[gSize];\n"
+    "    float im[gSize];\n"
+    "    for (int col = 0; col < gSize; col++) {\n"
+    "        const int sourceCol = col - margin;\n"
+    "        re[col] = (sourceCol >= 0 && sourceCol < sourceSize) ? sourceRowData[sourceCol] : 0.0f;\n"
+    "        im[col] = 0.0f;\n"
+    "    }\n"
+    "    fft(re, im, twiddles, 0);\n"
+    "    for (int col = 0; col < gSize; col++) {\n"
+    "        spectrumRow[col] = (float2)(re[col], im[col]);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// globalId: [plane][col]\n"
+    "kernel void fftColumns(const int numPlanes, const int inverse, global const float2 *twiddles,\n"
+    "        global float2 *spectra) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    const int plane = globalId / gSize;\n"
+    "    const int col = globalId % gSize;\n"
+    "    if (plane >= numPlanes) {\n"
+    "        return;\n"
+    "    }\n"
+    "    global float2 *spectrumCol = spectra + plane * gSizeSquared + col;\n"
+    "    float re[gSize];\n"
+    "    float im[gSize];\n"
+    "    for (int row = 0; row < gSize; row++) {\n"
+    "        const float2 value = spectrumCol[row * gSize];\n"
+    "        re[row] = value.x;\n"
+    "        im[row] = value.y;\n"
+    "    }\n"
+    "    fft(re, im, twiddles, inverse);\n"
+    "    for (int row = 0; row < gSize; row++) {\n"
+    "        spectrumCol[row * gSize] = (float2)(re[row], im[row]);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// inverse transforms the rows, after fftColumns, and writes the real part of the\n"
+    "// destSize x destSize square at (margin, margin), times scale, into dest\n"
+    "// globalId: [plane][destRow]\n"
+    "kernel void ifftRowsAndCrop(const int numPlanes, global const float2 *spectra, global const float2 *twiddles,\n"
+    "        const int margin, const int destSize, const float scale, global float *dest, const int destOffset) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    const int plane = globalId / destSize;\n"
+    "    const int destRow = globalId % destSize;\n"
+    "    if (plane >= numPlanes) {\n"
+    "        return;\n"
+    "    }\n"
+    "    global const float2 *spectrumRow = spectra + (plane * gSize + destRow + margin) * gSize;\n"
+    "    float re[gSize];\n"
+    "    float im[gSize];\n"
+    "    for (int col = 0; col < gSize; col++) {\n"
+    "        const float2 value = spectrumRow[col];\n"
+    "        re[col] = value.x;\n"
+    "        im[col] = value.y;\n"
+    "    }\n"
+    "    fft(re, im, twiddles, 1);\n"
+    "    global float *destRowData = dest + destOffset + (plane * destSize + destRow) * destSize;\n"
+    "    for (int destCol = 0; destCol < destSize; destCol++) {\n"
+    "        destRowData[destCol] = re[destCol + margin] * scale;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// output[n][filter] = sum over inputPlane of input[n][inputPlane] * conj(filters[filter][inputPlane])\n"
+    "// globalId: [n][filter][frequency]\n"
+    "kernel void multiplyForward(const int numImages, global const float2 *input, global const float2 *filters,\n"
+    "        global float2 *output) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    const int frequency = globalId % gSizeSquared;\n"
+    "    const int filter = (globalId / gSizeSquared) % gNumFilters;\n"
+    "    const int n = globalId / gSizeSquared / gNumFilters;\n"
+    "    if (n >= numImages) {\n"
+    "        return;\n"
+    "    }\n"
+    "    float2 sum = (float2)(0.0f, 0.0f);\n"
+    "    for (int inputPlane = 0; inputPlane < gInputPlanes; inputPlane++) {\n"
+    "        const float2 a = input[(n * gInputPlanes + inputPlane) * gSizeSquared + frequency];\n"
+    "        const float2 b = filters[(filter * gInputPlanes + inputPlane) * gSizeSquared + frequency];\n"
+    "        sum.x += a.x * b.x + a.y * b.y;\n"
+    "        sum.y += a.y * b.x - a.x * b.y;\n"
+    "    }\n"
+    "    output[globalId] = sum;\n"
+    "}\n"
+    "\n"
+    "// gradInput[n][inputPlane] = sum over filter of gradOutput[n][filter] * filters[filter][inputPlane]\n"
+    "// globalId: [n][inputPlane][frequency]\n"
+    "kernel void multiplyBackward(const int numImages, global const float2 *gradOutput, global const float2 *filters,\n"
+    "        global float2 *gradInput) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    const int frequency = globalId % gSizeSquared;\n"
+    "    const int inputPlane = (globalId / gSizeSquared) % gInputPlanes;\n"
+    "    const int n = globalId / gSizeSquared / gInputPlanes;\n"
+    "    if (n >= numImages) {\n"
+    "        return;\n"
+    "    }\n"
+    "    float2 sum = (float2)(0.0f, 0.0f);\n"
+    "    for (int filter = 0; filter < gNumFilters; filter++) {\n"
+    "        const float2 a = gradOutput[(n * gNumFilters + filter) * gSizeSquared + frequency];\n"
+    "        const float2 b = filters[(filter * gInputPlanes + inputPlane) * gSizeSquared + frequency];\n"
+    "        sum.x += a.x * b.x - a.y * b.y;\n"
+    "        sum.y += a.x * b.y + a.y * b.x;\n"
+    "    }\n"
+    "    gradInput[globalId] = sum;\n"
+    "}\n"
+    "\n"
+    "// gradWeights[filter][inputPlane] (+)= sum over n of input[n][inputPlane] * conj(gradOutput[n][filter])\n"
+    "// globalId: [filter][inputPlane][frequency]\n"
+    "kernel void multiplyGradWeights(const int numImages, global const float2 *input, global const float2 *gradOutput,\n"
+    "        const int accumulate, global float2 *gradWeights) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    const int frequency = globalId % gSizeSquared;\n"
+    "    const int inputPlane = (globalId / gSizeSquared) % gInputPlanes;\n"
+    "    const int filter = globalId / gSizeSquared / gInputPlanes;\n"
+    "    if (filter >= gNumFilters) {\n"
+    "        return;\n"
+    "    }\n"
+    "    float2 sum = accumulate ? gradWeights[globalId] : (float2)(0.0f, 0.0f);\n"
+    "    for (int n = 0; n < numImages; n++) {\n"
+    "        const float2 a = input[(n * gInputPlanes + inputPlane) * gSizeSquared + frequency];\n"
+    "        const float2 b = gradOutput[(n * gNumFilters + filter) * gSizeSquared + frequency];\n"
+    "        sum.x += a.x * b.x + a.y * b.y;\n"
+    "        sum.y += a.y * b.x - a.x * b.y;\n"
+    "    }\n"
+    "    gradWeights[globalId] = sum;\n"
+    "}\n"
+    "\n"
+    "// the zero-frequency term of each gradOutput plane is the sum over its pixels\n"
+    "// globalId: [filter]\n"
+    "kernel void gradBias(const int numImages, global const float2 *gradOutput, const int accumulate,\n"
+    "        const float scale, global float *gradBias) {\n"
+    "    const int filter = get_global_id(0);\n"
+    "    if (filter >= gNumFilters) {\n"
+    "        return;\n"
+    "    }\n"
+    "    float sum = 0.0f;\n"
+    "    for (int n = 0; n < numImages; n++) {\n"
+    "        sum += gradOutput[(n * gNumFilters + filter) * gSizeSquared].x;\n"
+    "    }\n"
+    "    gradBias[filter] = (accumulate ? gradBias[filter] : 0.0f) + sum * scale;\n"
+    "}\n"
+    "\n"
+    "";
+    // [[[end]]]
+    return kernelSource;
+}
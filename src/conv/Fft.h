@@ -0,0 +1,97 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+
+#include "LayerDimensions.h"
+
+class EasyCL;
+class CLWrapper;
+class CLKernel;
+
+#include "DeepCLDllExport.h"
+
+#define STATIC static
+#define VIRTUAL virtual
+
+// convolution in the frequency domain, on the gpu, for large filters: the cost per
+// output no longer grows with filterSize squared, see cl/fft.cl
+// each plane is zero-padded into a size x size square, size the smallest power of two
+// that holds the padded input, so the circular convolution doesn't wrap
+// the transformed filters are kept, and reused, until weightsGeneration changes, see
+// Forward::setWeightsGeneration; a generation of -1 means unknown, and always transforms
+// like Im2Col, images are processed in sub-batches, sized to fit Im2Col::getWorkspaceBudget(),
+// and the workspace is kept for the life of the layer
+class DeepCL_EXPORT Fft {
+    EasyCL *cl;
+    LayerDimensions dim;
+
+    public:
+    const int size;
+    const int logSize;
+    const int sizeSquared;
+    const int margin; // where the input sits, in the padded square
+
+    private:
+    CLKernel *kernelPadAndFftRows;
+    CLKernel *kernelFftColumns;
+    CLKernel *kernelIfftRowsAndCrop;
+    CLKernel *kernelMultiplyForward;
+    CLKernel *kernelMultiplyBackward;
+    CLKernel *kernelMultiplyGradWeights;
+    CLKernel *kernelGradBias;
+
+    float *twiddles; // [size / 2] complex
+    CLWrapper *twiddlesWrapper;
+    // the spectra only live on the device, so their wrappers all point at this, rather
+    // than at host arrays, and are never copied to or from the host
+    float spectraHostPlaceholder;
+    // [numFilters][inputPlanes][sizeSquared] complex: the transformed filters, or, in
+    // calcGradWeights, the gradWeights being accumulated
+    CLWrapper *filterSpectraWrapper;
+    int filterSpectraGeneration; // generation of the weights in filterSpectraWrapper, or -1
+    int workspaceImages; // how many images the workspace currently holds
+    CLWrapper *inputSpectraWrapper; // [workspaceImages][inputPlanes][sizeSquared] complex
+    CLWrapper *outputSpectraWrapper; // [workspaceImages][numFilters][sizeSquared] complex
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    STATIC int chooseSize(LayerDimensions dim);
+    STATIC bool isSupported(LayerDimensions dim);
+    Fft(EasyCL *cl, LayerDimensions dim);
+    VIRTUAL ~Fft();
+    void forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, int weightsGeneration,
+    CLWrapper *outputWrapper);
+    void backward(int batchSize, CLWrapper *gradOutputWrapper, CLWrapper *weightsWrapper, int weightsGeneration,
+    CLWrapper *gradInputWrapper);
+    void calcGradWeights(int batchSize, CLWrapper *gradOutputWrapper, CLWrapper *inputWrapper, float multiplier,
+    CLWrapper *gradWeightsWrapper, CLWrapper *gradBiasWrapper);
+
+    private:
+    void transformFilters(CLWrapper *weightsWrapper, int weightsGeneration);
+    void allocateFilterSpectra();
+    CLWrapper *createSpectraWrapper(int numFloats);
+    int allocateWorkspace(int batchSize);
+    void freeWorkspace();
+    void toFrequency(int numPlanes, CLWrapper *sourceWrapper, int sourceOffset, int sourceSize, int sourceMargin,
+    CLWrapper *spectraWrapper);
+    void fromFrequency(int numPlanes, CLWrapper *spectraWrapper, int destMargin, int destSize, float scale,
+    CLWrapper *destWrapper, int destOffset);
+    void run(CLKernel *kernel, int numElements);
+    CLKernel *buildKernel(std::string kernelName);
+    STATIC int log2Ceil(int value);
+    STATIC std::string getKernelSource();
+
+    // [[[end]]]
+};
+
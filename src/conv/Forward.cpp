@@ -17,8 +17,15 @@
 #include "conv/ForwardFc.h"
 #include "conv/ForwardByInputPlane.h"
 #include "conv/ForwardIm2Col.h"
+#include "conv/ForwardCpuIm2Col.h"
+#include "conv/ForwardWinograd.h"
+#include "conv/ForwardCpuWinograd.h"
+#include "conv/WinogradCpu.h"
+#include "conv/ForwardFft.h"
+#include "conv/Fft.h"
 #include "conv/ForwardAuto.h"
 #include "util/StatefulTimer.h"
+#include "weights/WeightsPersister.h"
 
 using namespace std;
 
@@ -30,7 +37,8 @@ using namespace std;
 
 Forward::Forward(EasyCL *cl, LayerDimensions layerDimensions) :
         cl(cl),
-        dim(layerDimensions) {
+        dim(layerDimensions),
+        weightsGeneration(-1) {
 }
 STATIC Forward *Forward::instance(EasyCL *cl, LayerDimensions dim) {
     return new ForwardAuto(cl, dim);
@@ -50,17 +58,49 @@ STATIC Forward *Forward::instance(EasyCL *cl, LayerDimensions dim) {
 //        return new Forward3(cl, dim);
 //    }
 }
+// for a net keeping its weights on the device as fp16 or bf16, see NeuralNet::setDeviceWeights:
+// only Forward1, and, for fully-connected shapes, ForwardFc, read 16-bit weights
+STATIC Forward *Forward::instanceForFiltersDtype(EasyCL *cl, LayerDimensions dim, int filtersDtype) {
+    if(filtersDtype == WeightsPersister::DTYPE_FLOAT32) {
+        return instance(cl, dim);
+    }
+    // ForwardFc runs one thread per filter, and keeps a row of each filter in local memory
+    const int fcWorkgroupSize = ((dim.numFilters + 32 - 1) / 32) * 32;
+    if(dim.filterSize == dim.inputSize && !dim.padZeros && fcWorkgroupSize <= cl->getMaxWorkgroupSize()
+        && dim.numFilters * dim.filterSize + dim.inputSize <= 4096) {
+        return new ForwardFc(cl, dim, filtersDtype);
+    }
+    return new Forward1(cl, dim, filtersDtype);
+}
+// build options for kernels reading the weights as filtersDtype, see cl/forward1.cl
+STATIC std::string Forward::filtersDtypeOptions(int filtersDtype) {
+    if(filtersDtype == WeightsPersister::DTYPE_FLOAT32) {
+        return "";
+    } else if(filtersDtype == WeightsPersister::DTYPE_FLOAT16) {
+        return " -D gHalfFilters";
+    } else if(filtersDtype == WeightsPersister::DTYPE_BFLOAT16) {
+        return " -D gBfloat16Filters";
+    }
+    throw runtime_error("Forward: weights on the device must be fp32, fp16 or bf16, not " + WeightsPersister::dtypeName(filtersDtype));
+}
 STATIC Forward *Forward::instanceTest(EasyCL *cl, LayerDimensions layerDimensions) {
     return new Forward2(cl, layerDimensions);
 }
 STATIC int Forward::getNumImplementations() {
-    return 8;
+    return 13;
 }
 STATIC bool Forward::plausiblyOptimal(int index, int batchSize, LayerDimensions dim) {
     if(index == 0) { 
         return false;
     }
-    if(index > 7) {
+    if(index > 12) {
+        return false;
+    }
+    if(index >= 9 && index <= 11 && !WinogradCpu::isSupported(dim)) {
+        return false;
+    }
+    // the transforms only pay for themselves for larger filters
+    if(index == 12 && (dim.filterSize < 5 || !Fft::isSupported(dim))) {
         return false;
     }
     return true;
@@ -87,6 +127,16 @@ STATIC Forward *Forward::instanceSpecific(int idx, EasyCL *cl, LayerDimensions l
         return new ForwardByInputPlane(cl, layerDimensions);
     } else if(idx == 7) {
         return new ForwardIm2Col(cl, layerDimensions);
+    } else if(idx == 8) {
+        return new ForwardCpuIm2Col(cl, layerDimensions);
+    } else if(idx == 9) {
+        return new ForwardWinograd(cl, layerDimensions, 2);
+    } else if(idx == 10) {
+        return new ForwardWinograd(cl, layerDimensions, 4);
+    } else if(idx == 11) {
+        return new ForwardCpuWinograd(cl, layerDimensions);
+    } else if(idx == 12) {
+        return new ForwardFft(cl, layerDimensions);
     } else {
         throw runtime_error(string("") + __FILE__ + ":" + toString(__LINE__) + " Forward::instanceSpecific: no instance defined for index " + toString(idx));
     }
@@ -104,6 +154,16 @@ STATIC Forward *Forward::instanceSpecific(std::string name, EasyCL *cl, LayerDim
         return new ForwardFc(cl, layerDimensions);
     } else if(name == "byinplane") {
         return new ForwardByInputPlane(cl, layerDimensions);
+    } else if(name == "cpuim2col") {
+        return new ForwardCpuIm2Col(cl, layerDimensions);
+    } else if(name == "winograd2") {
+        return new ForwardWinograd(cl, layerDimensions, 2);
+    } else if(name == "winograd4") {
+        return new ForwardWinograd(cl, layerDimensions, 4);
+    } else if(name == "cpuwinograd") {
+        return new ForwardCpuWinograd(cl, layerDimensions);
+    } else if(name == "fft") {
+        return new ForwardFft(cl, layerDimensions);
     } else {
         throw runtime_error(string("") + __FILE__ + ":" + toString(__LINE__) + " Forward::instanceSpecific: no instance defined for name " + name);
     }
@@ -114,6 +174,12 @@ STATIC Forward *Forward::instanceSpecific(std::string name, EasyCL *cl, LayerDim
 //    forward(batchSize, inputData, filters, biases, output);
 //    return output;
 //}
+// the owning layer bumps the generation whenever the weights might have changed, so
+// implementations that cache something derived from the weights, eg ForwardFft, know
+// when to redo it.  -1, the default, means unknown: assume they changed
+VIRTUAL void Forward::setWeightsGeneration(int generation) {
+    weightsGeneration = generation;
+}
 VIRTUAL int Forward::getOutputTotalSize(int batchSize) {
     return batchSize * dim.outputCubeSize;
 }
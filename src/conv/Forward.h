@@ -28,6 +28,7 @@ class DeepCL_EXPORT Forward {
 public:
     EasyCL *cl;
     LayerDimensions dim;
+    int weightsGeneration; // see setWeightsGeneration
 
     virtual ~Forward() {}
     virtual void forward(int batchSize, 
@@ -41,11 +42,14 @@ public:
     // generated, using cog:
     Forward(EasyCL *cl, LayerDimensions layerDimensions);
     STATIC Forward *instance(EasyCL *cl, LayerDimensions dim);
+    STATIC Forward *instanceForFiltersDtype(EasyCL *cl, LayerDimensions dim, int filtersDtype);
+    STATIC std::string filtersDtypeOptions(int filtersDtype);
     STATIC Forward *instanceTest(EasyCL *cl, LayerDimensions layerDimensions);
     STATIC int getNumImplementations();
     STATIC bool plausiblyOptimal(int index, int batchSize, LayerDimensions dim);
     STATIC Forward *instanceSpecific(int idx, EasyCL *cl, LayerDimensions layerDimensions);
     STATIC Forward *instanceSpecific(std::string name, EasyCL *cl, LayerDimensions layerDimensions);
+    VIRTUAL void setWeightsGeneration(int generation);
     VIRTUAL int getOutputTotalSize(int batchSize);
     VIRTUAL void forward(int batchSize, float *inputData, float *filters, float *biases, float *output);
 
@@ -8,6 +8,7 @@
 #include "util/stringhelper.h"
 #include "util/StatefulTimer.h"
 #include "conv/AddBias.h"
+#include "weights/WeightsPersister.h"
 
 using namespace std;
 
@@ -48,10 +49,21 @@ VIRTUAL void Forward1::forward(int batchSize, CLWrapper *dataWrapper, CLWrapper
 Forward1::Forward1(EasyCL *cl, LayerDimensions dim) :
             Forward(cl, dim)
         {
+    buildKernel(WeightsPersister::DTYPE_FLOAT32);
+}
+// weights stored on the device as filtersDtype, ie WeightsPersister::DTYPE_FLOAT32,
+// DTYPE_FLOAT16 or DTYPE_BFLOAT16, see Forward::filtersDtypeOptions
+Forward1::Forward1(EasyCL *cl, LayerDimensions dim, int filtersDtype) :
+            Forward(cl, dim)
+        {
+    buildKernel(filtersDtype);
+}
+void Forward1::buildKernel(int filtersDtype) {
     addBias = new AddBias(cl);
 
     std::string options = "";
     options += dim.buildOptionsString();
+    options += filtersDtypeOptions(filtersDtype);
 
     // [[[cog
     // import stringify
@@ -112,6 +124,20 @@ Forward1::Forward1(EasyCL *cl, LayerDimensions dim) :
     "//    . . .   x x x    . x x x\n"
     "//                       x x x\n"
     "\n"
+    "// filters are float, unless the net keeps its weights on the device as 16 bits, see\n"
+    "// NeuralNet::setDeviceWeights: then gHalfFilters, ieee half, or gBfloat16Filters, the\n"
+    "// top 16 bits of a float.  Either way, each weight is read as a float, so sums stay fp32\n"
+    "#if defined(gHalfFilters)\n"
+    "    #define FilterType half\n"
+    "    #define loadFilter(filters, i) vload_half(i, filters)\n"
+    "#elif defined(gBfloat16Filters)\n"
+    "    #define FilterType ushort\n"
+    "    #define loadFilter(filters, i) as_float(((uint)(filters)[i]) << 16)\n"
+    "#else\n"
+    "    #define FilterType float\n"
+    "    #define loadFilter(filters, i) ((filters)[i])\n"
+    "#endif\n"
+    "\n"
     "// images are organized like [imageId][plane][row][col]\n"
     "// filters are organized like [filterid][inplane][filterrow][filtercol]\n"
     "// output are organized like [imageid][filterid][row][col]\n"
@@ -123,7 +149,7 @@ Forward1::Forward1(EasyCL *cl, LayerDimensions dim) :
     "//     - writes one output...\n"
     "void kernel convolve_imagecubes_float2(\n"
     "    const int numExamples,\n"
-    "      global const float *inputs, global const float *filters,\n"
+    "      global const float *inputs, global const FilterType *filters,\n"
     "    global float *output) {\n"
     "    int globalId = get_global_id(0);\n"
     "\n"
@@ -137,13 +163,13 @@ Forward1::Forward1(EasyCL *cl, LayerDimensions dim) :
     "    int outputCol = localid % gOutputSize;\n"
     "\n"
     "    global float const*inputCube = inputs + exampleId * gNumInputPlanes * gInputSizeSquared;\n"
-    "    global float const*filterCube = filters + filterId * gNumInputPlanes * gFilterSizeSquared;\n"
+    "    global FilterType const*filterCube = filters + filterId * gNumInputPlanes * gFilterSizeSquared;\n"
     "\n"
     "    float sum = 0;\n"
     "    if (exampleId < numExamples) {\n"
     "        for (int inputPlaneIdx = 0; inputPlaneIdx < gNumInputPlanes; inputPlaneIdx++) {\n"
     "            global float const*inputPlane = inputCube + inputPlaneIdx * gInputSizeSquared;\n"
-    "            global float const*filterPlane = filterCube + inputPlaneIdx * gFilterSizeSquared;\n"
+    "            global FilterType const*filterPlane = filterCube + inputPlaneIdx * gFilterSizeSquared;\n"
     "            for (int u = -gHalfFilterSize; u <= gHalfFilterSize - gEven; u++) {\n"
     "                // trying to reduce register pressure...\n"
     "                #if gPadZeros == 1\n"
@@ -152,7 +178,7 @@ Forward1::Forward1(EasyCL *cl, LayerDimensions dim) :
     "                    #define inputRowIdx (outputRow + u + gHalfFilterSize)\n"
     "                #endif\n"
     "                global float const *inputRow = inputPlane + inputRowIdx * gInputSize;\n"
-    "                global float const *filterRow = filterPlane + (u+gHalfFilterSize) * gFilterSize + gHalfFilterSize;\n"
+    "                global FilterType const *filterRow = filterPlane + (u+gHalfFilterSize) * gFilterSize;\n"
     "                bool rowOk = inputRowIdx >= 0 && inputRowIdx < gInputSize;\n"
     "                #pragma unroll\n"
     "                for (int v = -gHalfFilterSize; v <= gHalfFilterSize - gEven; v++) {\n"
@@ -163,7 +189,7 @@ Forward1::Forward1(EasyCL *cl, LayerDimensions dim) :
     "                    #endif\n"
     "                    bool process = rowOk && inputColIdx >= 0 && inputColIdx < gInputSize;\n"
     "                    if (process) {\n"
-    "                            sum += inputRow[inputColIdx] * filterRow[v];\n"
+    "                            sum += inputRow[inputColIdx] * loadFilter(filterRow, v + gHalfFilterSize);\n"
     "                    }\n"
     "                }\n"
     "            }\n"
@@ -24,6 +24,8 @@ public:
     VIRTUAL void forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper,
     CLWrapper *outputWrapper);
     Forward1(EasyCL *cl, LayerDimensions dim);
+    Forward1(EasyCL *cl, LayerDimensions dim, int filtersDtype);
+    void buildKernel(int filtersDtype);
 
     // [[[end]]]
 };
@@ -9,6 +9,7 @@
 #include "ForwardByInputPlane.h"
 #include "util/stringhelper.h"
 #include "util/StatefulTimer.h"
+#include "clmath/ScratchPool.h"
 
 using namespace std;
 
@@ -22,6 +23,7 @@ VIRTUAL ForwardByInputPlane::~ForwardByInputPlane() {
     delete reduceSegments;
     delete repeatedAdd;
 //    delete activate;
+    delete scratchPool;
 }
 VIRTUAL void ForwardByInputPlane::forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper,
     CLWrapper *outputWrapper) {
@@ -39,8 +41,7 @@ VIRTUAL void ForwardByInputPlane::forward(int batchSize, CLWrapper *dataWrapper,
     // [n][filterId][outRow][outCol][inputPlane]
     int output1Size = batchSize * dim.numFilters * dim.outputSizeSquared * dim.numInputPlanes;
 //    cout << "output1size: " << output1Size << endl;
-    float *output1 = new float[output1Size];
-    CLWrapper *output1Wrapper = cl->wrap(output1Size, output1);
+    CLWrapper *output1Wrapper = scratchPool->borrow(output1Size);
 
     kernel->in(batchSize);
     kernel->input(dataWrapper);
@@ -94,13 +95,13 @@ VIRTUAL void ForwardByInputPlane::forward(int batchSize, CLWrapper *dataWrapper,
 //    cl->finish();
 //    StatefulTimer::timeCheck("ForwardByInputPlane::forward after activate");
 
-    delete output1Wrapper;
-    delete[] output1;
+    scratchPool->giveBack(output1Wrapper);
 
     StatefulTimer::timeCheck("ForwardByInputPlane::forward after call forward");
 }
 ForwardByInputPlane::ForwardByInputPlane(EasyCL *cl, LayerDimensions dim) :
-        Forward(cl, dim)
+        Forward(cl, dim),
+        scratchPool(new ScratchPool(cl))
             {
 
     std::string options = ""; // "-D " + fn->getDefineName();
@@ -2,12 +2,15 @@
 
 #include "Forward.h"
 
+class ScratchPool;
+
 class ForwardByInputPlane : public Forward {
 public:
     CLKernel *kernel;
     CLKernel *reduceSegments;
     CLKernel *repeatedAdd;
 //    CLKernel *activate;
+    ScratchPool *scratchPool; // output1, kept between calls
 
     // [[[cog
     // import cog_addheaders
@@ -0,0 +1,124 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "conv/ForwardCpuIm2Col.h"
+#include "conv/CpuGemm.h"
+#include "conv/Im2ColCpu.h"
+#include "util/ThreadPool.h"
+#include "util/stringhelper.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#undef STATIC
+#define VIRTUAL
+#define STATIC
+
+namespace {
+    class ForwardCpuIm2ColTask : public ThreadPoolTask {
+    public:
+        ForwardCpuIm2Col *owner;
+        int numFilterBlocks;
+        int filtersPerBlock;
+        const float *inputData;
+        const float *weights;
+        const float *bias;
+        float *output;
+        virtual void run(int threadId, int taskId) {
+            const int n = taskId / numFilterBlocks;
+            const int filterBegin = (taskId % numFilterBlocks) * filtersPerBlock;
+            const int filterEnd = min(owner->dim.numFilters, filterBegin + filtersPerBlock);
+            owner->forwardTask(threadId, n, filterBegin, filterEnd, inputData, weights, bias, output);
+        }
+    };
+}
+
+PUBLIC ForwardCpuIm2Col::ForwardCpuIm2Col(EasyCL *cl, LayerDimensions dim) :
+        Forward(cl, dim),
+        threadPool(ThreadPool::instance()) {
+    if(dim.skip != 0) {
+        throw runtime_error("ForwardCpuIm2Col: skip not supported, skip=" + toString(dim.skip));
+    }
+    columnsByThread.resize(threadPool->getNumThreads(), 0);
+    gemmByThread.resize(threadPool->getNumThreads(), 0);
+}
+PUBLIC VIRTUAL ForwardCpuIm2Col::~ForwardCpuIm2Col() {
+    for(int i = 0; i < (int)columnsByThread.size(); i++) {
+        delete[] columnsByThread[i];
+        delete gemmByThread[i];
+    }
+}
+PUBLIC VIRTUAL void ForwardCpuIm2Col::forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper, CLWrapper *outputWrapper) {
+    dataWrapper->copyToHost();
+    weightsWrapper->copyToHost();
+    float *bias = 0;
+    if(dim.biased) {
+        biasWrapper->copyToHost();
+        bias = (float *)biasWrapper->getHostArray();
+    }
+    forward(batchSize, (float *)dataWrapper->getHostArray(), (float *)weightsWrapper->getHostArray(), bias,
+        (float *)outputWrapper->getHostArray());
+    outputWrapper->copyToDevice();
+}
+// must allocate output yourself before the call
+PUBLIC VIRTUAL void ForwardCpuIm2Col::forward(int batchSize, float *inputData, float *weights, float *bias, float *output) {
+    StatefulTimer::timeCheck("ForwardCpuIm2Col::forward START");
+    // if the batch is smaller than the pool, also split the filters, so all threads
+    // get some work, but keep each gemm at least 16 rows, else the im2col, which
+    // every block redoes for its image, starts to dominate
+    const int numThreads = threadPool->getNumThreads();
+    int numFilterBlocks = 1;
+    if(batchSize < numThreads) {
+        numFilterBlocks = (numThreads + batchSize - 1) / batchSize;
+        numFilterBlocks = max(1, min(numFilterBlocks, dim.numFilters / 16));
+    }
+    ForwardCpuIm2ColTask task;
+    task.owner = this;
+    task.numFilterBlocks = numFilterBlocks;
+    task.filtersPerBlock = (dim.numFilters + numFilterBlocks - 1) / numFilterBlocks;
+    task.inputData = inputData;
+    task.weights = weights;
+    task.bias = bias;
+    task.output = output;
+    threadPool->run(batchSize * numFilterBlocks, &task);
+    StatefulTimer::timeCheck("ForwardCpuIm2Col::forward END");
+}
+PUBLIC void ForwardCpuIm2Col::forwardTask(int threadId, int n, int filterBegin, int filterEnd,
+        const float *inputData, const float *weights, const float *bias, float *output) {
+    if(filterBegin >= filterEnd) {
+        return;
+    }
+    const int columnsRows = dim.inputPlanes * dim.filterSizeSquared;
+    if(gemmByThread[threadId] == 0) {
+        gemmByThread[threadId] = new CpuGemm();
+    }
+    const float *image = inputData + n * dim.inputCubeSize;
+    const float *columns = image;
+    if(!Im2ColCpu::isIdentity(dim)) {
+        if(columnsByThread[threadId] == 0) {
+            columnsByThread[threadId] = new float[columnsRows * dim.outputSizeSquared];
+        }
+        Im2ColCpu::im2Col(dim, image, columnsByThread[threadId]);
+        columns = columnsByThread[threadId];
+    }
+    float *outputBlock = output + n * dim.outputCubeSize + filterBegin * dim.outputSizeSquared;
+    if(dim.biased) {
+        for(int filter = filterBegin; filter < filterEnd; filter++) {
+            float *outputPlane = output + n * dim.outputCubeSize + filter * dim.outputSizeSquared;
+            fill(outputPlane, outputPlane + dim.outputSizeSquared, bias[filter]);
+        }
+    }
+    // output[filter][outPos] = weights[filter][inPlane, filterRow, filterCol] * columns[inPlane, filterRow, filterCol][outPos]
+    gemmByThread[threadId]->sgemm(false, false, filterEnd - filterBegin, dim.outputSizeSquared, columnsRows,
+        weights + filterBegin * columnsRows, columnsRows,
+        columns, dim.outputSizeSquared,
+        dim.biased ? 1.0f : 0.0f, outputBlock, dim.outputSizeSquared);
+}
+
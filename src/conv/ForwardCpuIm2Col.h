@@ -0,0 +1,53 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+#include "Forward.h"
+
+class CpuGemm;
+class ThreadPool;
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// multithreaded cpu forward: im2col per image, then one blocked gemm per
+// [image][block of filters], spread across the ThreadPool, writing
+// directly into the output array
+class DeepCL_EXPORT ForwardCpuIm2Col : public Forward {
+    private:
+    ThreadPool *threadPool;
+    // per-thread scratch, indexed by threadId, allocated on first use
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    std::vector<float *> columnsByThread;
+    std::vector<CpuGemm *> gemmByThread;
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    ForwardCpuIm2Col(EasyCL *cl, LayerDimensions dim);
+    VIRTUAL ~ForwardCpuIm2Col();
+    VIRTUAL void forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper, CLWrapper *outputWrapper);
+    VIRTUAL void forward(int batchSize, float *inputData, float *weights, float *bias, float *output);
+    void forwardTask(int threadId, int n, int filterBegin, int filterEnd,
+    const float *inputData, const float *weights, const float *bias, float *output);
+
+    // [[[end]]]
+};
+
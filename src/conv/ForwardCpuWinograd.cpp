@@ -0,0 +1,54 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+
+#include "conv/ForwardCpuWinograd.h"
+#include "conv/WinogradCpu.h"
+#include "util/stringhelper.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#undef STATIC
+#define VIRTUAL
+#define STATIC
+
+PUBLIC ForwardCpuWinograd::ForwardCpuWinograd(EasyCL *cl, LayerDimensions dim) :
+        Forward(cl, dim),
+        winograd(0) {
+    if(!WinogradCpu::isSupported(dim)) {
+        throw runtime_error("ForwardCpuWinograd: only 3x3 filters, without skip, are supported, filterSize=" + toString(dim.filterSize) + " skip=" + toString(dim.skip));
+    }
+    winograd = new WinogradCpu(dim.inputPlanes, dim.inputSize, dim.numFilters, dim.padZeros ? 1 : 0,
+        WinogradCpu::chooseTileSize(dim.outputSize));
+}
+PUBLIC VIRTUAL ForwardCpuWinograd::~ForwardCpuWinograd() {
+    delete winograd;
+}
+PUBLIC VIRTUAL void ForwardCpuWinograd::forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper, CLWrapper *outputWrapper) {
+    dataWrapper->copyToHost();
+    weightsWrapper->copyToHost();
+    float *bias = 0;
+    if(dim.biased) {
+        biasWrapper->copyToHost();
+        bias = (float *)biasWrapper->getHostArray();
+    }
+    forward(batchSize, (float *)dataWrapper->getHostArray(), (float *)weightsWrapper->getHostArray(), bias,
+        (float *)outputWrapper->getHostArray());
+    outputWrapper->copyToDevice();
+}
+// must allocate output yourself before the call
+PUBLIC VIRTUAL void ForwardCpuWinograd::forward(int batchSize, float *inputData, float *weights, float *bias, float *output) {
+    StatefulTimer::timeCheck("ForwardCpuWinograd::forward START");
+    // the weights change every batch, during training, so transform them each time;
+    // it's cheap next to the convolution itself
+    winograd->setFilters(weights, false);
+    winograd->convolve(batchSize, inputData, dim.biased ? bias : 0, output);
+    StatefulTimer::timeCheck("ForwardCpuWinograd::forward END");
+}
+
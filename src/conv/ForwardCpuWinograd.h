@@ -0,0 +1,38 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "Forward.h"
+
+class WinogradCpu;
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// multithreaded cpu forward, for 3x3 filters, using Winograd F(4x4, 3x3), or
+// F(2x2, 3x3) for small outputs, see WinogradCpu
+class DeepCL_EXPORT ForwardCpuWinograd : public Forward {
+    private:
+    WinogradCpu *winograd;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    ForwardCpuWinograd(EasyCL *cl, LayerDimensions dim);
+    VIRTUAL ~ForwardCpuWinograd();
+    VIRTUAL void forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper, CLWrapper *outputWrapper);
+    VIRTUAL void forward(int batchSize, float *inputData, float *weights, float *bias, float *output);
+
+    // [[[end]]]
+};
+
@@ -11,6 +11,8 @@
 #include "util/StatefulTimer.h"
 #include "conv/AddBias.h"
 #include "conv/ReduceSegments.h"
+#include "clmath/ScratchPool.h"
+#include "weights/WeightsPersister.h"
 
 using namespace std;
 
@@ -24,6 +26,7 @@ VIRTUAL ForwardFc::~ForwardFc() {
 //    delete kernel_reduce;
     delete addBias;
     delete reduceSegments;
+    delete scratchPool;
 }
 VIRTUAL void ForwardFc::forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper, CLWrapper *outputWrapper) {
     StatefulTimer::timeCheck("ForwardFc::forward begin");
@@ -35,14 +38,10 @@ VIRTUAL void ForwardFc::forward(int batchSize, CLWrapper *dataWrapper, CLWrapper
     const int output1Size = output2Size * dim.filterSize; // need to reduce also over each row
 
 //    const int output1Size = batchSize * dim.numFilters * dim.numInputPlanes * dim.filterSize;
-    float *output1 = new float[ output1Size ];
-    CLWrapper *output1Wrapper = cl->wrap(output1Size, output1);
-    output1Wrapper->createOnDevice();
+    CLWrapper *output1Wrapper = scratchPool->borrow(output1Size);
 
 //    const int output2Size = batchSize * dim.numFilters * dim.numInputPlanes;
-    float *output2 = new float[ output2Size ];
-    CLWrapper *output2Wrapper = cl->wrap(output2Size, output2);
-    output2Wrapper->createOnDevice();
+    CLWrapper *output2Wrapper = scratchPool->borrow(output2Size);
 
     kernel1->in(batchSize);
     kernel1->input(dataWrapper);
@@ -70,17 +69,22 @@ VIRTUAL void ForwardFc::forward(int batchSize, CLWrapper *dataWrapper, CLWrapper
             outputWrapper, biasWrapper);
     }
 
-    delete output2Wrapper;
-    delete[] output2;
-
-    delete output1Wrapper;
-    delete[] output1;
+    scratchPool->giveBack(output2Wrapper);
+    scratchPool->giveBack(output1Wrapper);
     StatefulTimer::timeCheck("ForwardFc::forward end");
 }
 ForwardFc::ForwardFc(EasyCL *cl, LayerDimensions dim) :
         Forward(cl, dim)
             {
-
+    buildKernel(WeightsPersister::DTYPE_FLOAT32);
+}
+// weights stored on the device as filtersDtype, see Forward::filtersDtypeOptions
+ForwardFc::ForwardFc(EasyCL *cl, LayerDimensions dim, int filtersDtype) :
+        Forward(cl, dim)
+            {
+    buildKernel(filtersDtype);
+}
+void ForwardFc::buildKernel(int filtersDtype) {
     if(dim.inputSize != dim.filterSize) {
         throw runtime_error("For ForwardFc, filtersize and inputimagesize must be identical");
     }
@@ -90,9 +94,11 @@ ForwardFc::ForwardFc(EasyCL *cl, LayerDimensions dim) :
 
     this->addBias = new AddBias(cl);
     this->reduceSegments = new ReduceSegments(cl);
+    this->scratchPool = new ScratchPool(cl);
 
     std::string options = "";
     options += dim.buildOptionsString();
+    options += filtersDtypeOptions(filtersDtype);
 
     // [[[cog
     // import stringify
@@ -117,6 +123,20 @@ ForwardFc::ForwardFc(EasyCL *cl, LayerDimensions dim) :
     "    }\n"
     "}\n"
     "\n"
+    "// filters are float, unless the net keeps its weights on the device as 16 bits, see\n"
+    "// NeuralNet::setDeviceWeights: then gHalfFilters, ieee half, or gBfloat16Filters, the\n"
+    "// top 16 bits of a float.  Either way, each weight is read as a float, so sums stay fp32\n"
+    "#if defined(gHalfFilters)\n"
+    "    #define FilterType half\n"
+    "    #define loadFilter(filters, i) vload_half(i, filters)\n"
+    "#elif defined(gBfloat16Filters)\n"
+    "    #define FilterType ushort\n"
+    "    #define loadFilter(filters, i) as_float(((uint)(filters)[i]) << 16)\n"
+    "#else\n"
+    "    #define FilterType float\n"
+    "    #define loadFilter(filters, i) ((filters)[i])\n"
+    "#endif\n"
+    "\n"
     "// concept:\n"
     "//  we want to share each input example across multiple filters\n"
     "//   but an entire filter plane is 19*19*4 = 1.4KB\n"
@@ -150,7 +170,7 @@ ForwardFc::ForwardFc(EasyCL *cl, LayerDimensions dim) :
     "//   inputimagesize around 19, not too small\n"
     "#if (gFilterSize == gInputSize) && (gPadZeros == 0)\n"
     "void kernel forward_fc_workgroup_perrow(const int batchSize,\n"
-    "    global const float *images, global const float *filters,\n"
+    "    global const float *images, global const FilterType *filters,\n"
     "    global float *output1,\n"
     "    local float *_imageRow, local float *_filterRows) {\n"
     "    const int globalId = get_global_id(0);\n"
@@ -165,14 +185,14 @@ ForwardFc::ForwardFc(EasyCL *cl, LayerDimensions dim) :
     "    const int filterId = localId;\n"
     "\n"
     "    // first copy down filter row, which is per-thread, so we have to copy it all ourselves...\n"
-    "    global const float *filterRow = filters\n"
+    "    global const FilterType *filterRow = filters\n"
     "        + filterId * gNumInputPlanes * gFilterSizeSquared\n"
     "        + inputPlaneId * gFilterSizeSquared\n"
     "        + filterRowId * gFilterSize;\n"
     "    local float *_threadFilterRow = _filterRows + localId * gFilterSize;\n"
     "    if (localId < gNumFilters) {\n"
     "        for (int i = 0; i < gFilterSize; i++) {\n"
-    "            _threadFilterRow[i] = filterRow[i];\n"
+    "            _threadFilterRow[i] = loadFilter(filterRow, i);\n"
     "        }\n"
     "    }\n"
     "    const int loopsPerExample = (gInputSize + workgroupSize - 1) / workgroupSize;\n"
@@ -10,6 +10,7 @@
 
 class AddBias;
 class ReduceSegments;
+class ScratchPool;
 
 #define STATIC static
 #define VIRTUAL virtual
@@ -20,6 +21,7 @@ public:
 //    CLKernel *kernel_reduce;
     AddBias *addBias;
     ReduceSegments *reduceSegments;
+    ScratchPool *scratchPool; // output1 and output2, kept between calls
 
     // [[[cog
     // import cog_addheaders
@@ -29,6 +31,8 @@ public:
     VIRTUAL ~ForwardFc();
     VIRTUAL void forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper, CLWrapper *outputWrapper);
     ForwardFc(EasyCL *cl, LayerDimensions dim);
+    ForwardFc(EasyCL *cl, LayerDimensions dim, int filtersDtype);
+    void buildKernel(int filtersDtype);
 
     // [[[end]]]
 };
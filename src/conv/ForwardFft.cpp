@@ -0,0 +1,41 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "conv/ForwardFft.h"
+#include "conv/AddBias.h"
+#include "conv/Fft.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#undef STATIC
+#define VIRTUAL
+#define STATIC
+#define PUBLIC
+
+PUBLIC ForwardFft::ForwardFft(EasyCL *cl, LayerDimensions dim) :
+        Forward(cl, dim),
+        addBias(0),
+        fft(0) {
+    fft = new Fft(cl, dim);
+    addBias = new AddBias(cl);
+}
+PUBLIC VIRTUAL ForwardFft::~ForwardFft() {
+    delete fft;
+    delete addBias;
+}
+PUBLIC VIRTUAL void ForwardFft::forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper, CLWrapper *outputWrapper) {
+    StatefulTimer::timeCheck("ForwardFft::forward START");
+    fft->forward(batchSize, dataWrapper, weightsWrapper, weightsGeneration, outputWrapper);
+    StatefulTimer::timeCheck("ForwardFft::forward after fft");
+    if(dim.biased) {
+        addBias->forward(
+            batchSize, dim.numFilters, dim.outputSize,
+            outputWrapper, biasWrapper);
+    }
+    StatefulTimer::timeCheck("ForwardFft::forward END");
+}
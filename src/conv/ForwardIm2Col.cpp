@@ -39,23 +39,27 @@ PUBLIC VIRTUAL ForwardIm2Col::~ForwardIm2Col() {
 PUBLIC VIRTUAL void ForwardIm2Col::forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper, CLWrapper *outputWrapper) {
     StatefulTimer::timeCheck("ForwardIm2Col::forward START");
 
-    int columnsSize= dim.inputPlanes * dim.filterSizeSquared * dim.outputSizeSquared;
-    float *columns = new float[columnsSize];
-    CLWrapper *columnsWrapper = cl->wrap(columnsSize, columns);
-    columnsWrapper->createOnDevice();
-//    cout << "columnsSize: " << columnsSize << endl;
-//    cout << "weightsize: " << weightsWrapper->size() << endl;
+    // each gemm covers a sub-batch of images, unrolled side by side into the columns
+    // workspace, then the result is reordered into the output
+    int subBatchSize = im2Col->allocateWorkspace(batchSize);
+    CLWrapper *columnsWrapper = im2Col->getColumnsWrapper();
 
     StatefulTimer::timeCheck("ForwardIm2Col::forward after alloc");
 
-    for (int b = 0; b < batchSize; b ++) {
-        im2Col->im2Col(dataWrapper, b * dim.inputCubeSize, columnsWrapper);
+    if(!outputWrapper->isOnDevice()) {
+        outputWrapper->createOnDevice();
+    }
+    for (int b = 0; b < batchSize; b += subBatchSize) {
+        int numImages = batchSize - b < subBatchSize ? batchSize - b : subBatchSize;
+        im2Col->im2Col(dataWrapper, b * dim.inputCubeSize, numImages, columnsWrapper);
 
-        long m = dim.outputSizeSquared;
-        long n = dim.numFilters;
-        long k = dim.inputPlanes * dim.filterSizeSquared;
+        int64 m = (int64)numImages * dim.outputSizeSquared;
+        int64 n = dim.numFilters;
+        int64 k = dim.inputPlanes * dim.filterSizeSquared;
 //        cout << "m=" << m << " n=" << n << " k=" << k << endl;
 
+        // a single image's gemm result is already in the output layout
+        CLWrapper *resultWrapper = numImages == 1 ? outputWrapper : im2Col->getPlanesWrapper();
         ClBlasHelper::Gemm(
             cl, clblasColumnMajor, clblasNoTrans, clblasNoTrans,
             m, k, n,
@@ -63,13 +67,13 @@ PUBLIC VIRTUAL void ForwardIm2Col::forward(int batchSize, CLWrapper *dataWrapper
             columnsWrapper, 0,
             weightsWrapper, 0,
             0,
-            outputWrapper, b * dim.outputCubeSize
+            resultWrapper, numImages == 1 ? b * dim.outputCubeSize : 0
         );
+        if(numImages > 1) {
+            im2Col->planesToCubes(resultWrapper, numImages, outputWrapper, b * dim.outputCubeSize);
+        }
     }
 
-    delete columnsWrapper;
-    delete[] columns;
-
     StatefulTimer::timeCheck("ForwardIm2Col::forward after call forward");
 
     if(dim.biased) {
@@ -23,10 +23,6 @@ class DeepCL_EXPORT ForwardIm2Col : public Forward {
     AddBias *addBias;
     Im2Col *im2Col;
 
-    float *columns;
-    CLWrapper *columnsWrapper;
-    int numKernels;
-
     // [[[cog
     // import cog_addheaders
     // cog_addheaders.addv2()
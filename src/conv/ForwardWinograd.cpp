@@ -0,0 +1,39 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+
+#include "conv/ForwardWinograd.h"
+#include "conv/Winograd.h"
+#include "conv/WinogradCpu.h"
+#include "util/stringhelper.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#undef STATIC
+#define VIRTUAL
+#define STATIC
+#define PUBLIC
+
+PUBLIC ForwardWinograd::ForwardWinograd(EasyCL *cl, LayerDimensions dim, int tileSize) :
+        Forward(cl, dim),
+        winograd(0) {
+    if(!WinogradCpu::isSupported(dim)) {
+        throw runtime_error("ForwardWinograd: only 3x3 filters, without skip, are supported, filterSize=" + toString(dim.filterSize) + " skip=" + toString(dim.skip));
+    }
+    winograd = new Winograd(cl, dim.inputPlanes, dim.inputSize, dim.numFilters, dim.padZeros ? 1 : 0,
+        tileSize, false, dim.biased);
+}
+PUBLIC VIRTUAL ForwardWinograd::~ForwardWinograd() {
+    delete winograd;
+}
+PUBLIC VIRTUAL void ForwardWinograd::forward(int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper, CLWrapper *outputWrapper) {
+    StatefulTimer::timeCheck("ForwardWinograd::forward START");
+    winograd->convolve(batchSize, dataWrapper, weightsWrapper, biasWrapper, outputWrapper);
+    StatefulTimer::timeCheck("ForwardWinograd::forward END");
+}
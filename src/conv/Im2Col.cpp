@@ -7,6 +7,7 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <cstdlib>
 using namespace std;
 
 #undef STATIC
@@ -15,84 +16,177 @@ using namespace std;
 #define VIRTUAL
 #define PUBLIC
 
+int64 Im2Col::workspaceBudget = -1;
+
 PUBLIC Im2Col::Im2Col(EasyCL *cl, LayerDimensions dim) :
         cl(cl),
         dim(dim) {
 //    ClBlasInstance::initializeIfNecessary();
     this->kernelIm2Col = 0;
     this->kernelCol2Im = 0;
+    this->kernelCubesToPlanes = 0;
+    this->kernelPlanesToCubes = 0;
+    this->workspaceImages = 0;
+    this->columns = 0;
+    this->columnsWrapper = 0;
+    this->planes = 0;
+    this->planesWrapper = 0;
 }
 PUBLIC VIRTUAL Im2Col::~Im2Col() {
     delete kernelIm2Col;
     delete kernelCol2Im;
+    delete kernelCubesToPlanes;
+    delete kernelPlanesToCubes;
+    freeWorkspace();
+}
+// the im2col callers unroll as many images as fit in this many bytes of workspace
+// into one wide column matrix, so one gemm covers the whole sub-batch
+// defaults to DEEPCL_IM2COL_WORKSPACE_MB megabytes, if set, otherwise 64MB
+// always at least one image, however large
+PUBLIC STATIC void Im2Col::setWorkspaceBudget(int64 bytes) {
+    workspaceBudget = bytes;
+}
+PUBLIC STATIC int64 Im2Col::getWorkspaceBudget() {
+    if(workspaceBudget < 0) {
+        workspaceBudget = 64ll * 1024 * 1024;
+        const char *fromEnv = getenv("DEEPCL_IM2COL_WORKSPACE_MB");
+        if(fromEnv != 0 && atoi(fromEnv) > 0) {
+            workspaceBudget = atoi(fromEnv) * 1024ll * 1024;
+        }
+    }
+    return workspaceBudget;
+}
+// how many images each gemm will cover, for this batchSize; makes sure the workspace
+// holds that many, allocating it on first use, and when it has to grow.  After that
+// it's reused, for the life of the layer
+// per image, we need the columns, and, to reorder the layer's [image][filter][pixel]
+// output or gradOutput to and from gemm layout, numFilters planes
+PUBLIC int Im2Col::allocateWorkspace(int batchSize) {
+    int64 bytesPerImage = (int64)(dim.inputPlanes * dim.filterSizeSquared + dim.numFilters) * dim.outputSizeSquared * sizeof(float);
+    int64 numImages = getWorkspaceBudget() / bytesPerImage;
+    if(numImages > batchSize) {
+        numImages = batchSize;
+    }
+    if(numImages < 1) {
+        numImages = 1;
+    }
+    if(numImages > workspaceImages) {
+        freeWorkspace();
+        workspaceImages = (int)numImages;
+        int columnsSize = workspaceImages * dim.inputPlanes * dim.filterSizeSquared * dim.outputSizeSquared;
+        columns = new float[columnsSize];
+        columnsWrapper = cl->wrap(columnsSize, columns);
+        columnsWrapper->createOnDevice();
+        if(workspaceImages > 1) {
+            int planesSize = workspaceImages * dim.numFilters * dim.outputSizeSquared;
+            planes = new float[planesSize];
+            planesWrapper = cl->wrap(planesSize, planes);
+            planesWrapper->createOnDevice();
+        }
+    }
+    return (int)numImages;
+}
+PUBLIC CLWrapper *Im2Col::getColumnsWrapper() {
+    return columnsWrapper;
+}
+// only allocated if the workspace holds more than one image; with one image, the
+// layer layout is already the gemm layout
+PUBLIC CLWrapper *Im2Col::getPlanesWrapper() {
+    return planesWrapper;
+}
+void Im2Col::freeWorkspace() {
+    delete columnsWrapper;
+    delete[] columns;
+    delete planesWrapper;
+    delete[] planes;
+    columnsWrapper = 0;
+    columns = 0;
+    planesWrapper = 0;
+    planes = 0;
+    workspaceImages = 0;
 }
 void Im2Col::setupBuilder(TemplatedKernel *builder) {
     int size = dim.inputSize;
     int padding = dim.padZeros ? dim.halfFilterSize : 0;
     int stride = 1;
-    int channels = dim.inputPlanes;
     int size_col = (size + 2 * padding - dim.filterSize) / stride + 1;
 
-    this->numKernelsIm2Col = channels * size_col * size_col;
-    this->numKernelsCol2Im = channels * dim.inputSizeSquared;
-
     builder->set("padding", dim.padZeros ? dim.halfFilterSize : 0);
     builder->set("stride", 1);
     builder->set("colSize", size_col);
     builder->set("channels", dim.inputPlanes);
     builder->set("filterSize", dim.filterSize);
     builder->set("size", dim.inputSize);
+    builder->set("numFilters", dim.numFilters);
 }
-void Im2Col::buildKernelIm2Col() {
+CLKernel *Im2Col::buildKernel(std::string kernelName) {
     TemplatedKernel builder(cl);
     setupBuilder(&builder);
-    this->kernelIm2Col = builder.buildKernel(
-        "im2col",
+    return builder.buildKernel(
+        kernelName,
         "ForwardIm2Col.cl",
         getKernelTemplate(),
-        "im2col",
+        kernelName,
         false
     );
 }
-void Im2Col::buildKernelCol2Im() {
-    TemplatedKernel builder(cl);
-    setupBuilder(&builder);
-    this->kernelCol2Im = builder.buildKernel(
-        "col2im",
-        "ForwardIm2Col.cl",
-        getKernelTemplate(),
-        "col2im",
-        false
-    );
+void Im2Col::run(CLKernel *kernel, int numElements) {
+    int workgroupSize = cl->getMaxWorkgroupSize();
+    int numWorkgroups = (numElements + workgroupSize - 1) / workgroupSize;
+    kernel->run_1d(numWorkgroups * workgroupSize, workgroupSize);
 }
-PUBLIC void Im2Col::im2Col(CLWrapper *imagesWrapper, int imagesOffset, CLWrapper *columnsWrapper) {
+// unrolls numImages images, starting at imagesOffset, into columnsWrapper, as one
+// column-major [numImages * outputSizeSquared][inputPlanes * filterSizeSquared] matrix
+PUBLIC void Im2Col::im2Col(CLWrapper *imagesWrapper, int imagesOffset, int numImages, CLWrapper *columnsWrapper) {
     if(kernelIm2Col == 0) {
-        buildKernelIm2Col();
+        kernelIm2Col = buildKernel("im2col");
     }
-    kernelIm2Col->in(numKernelsIm2Col);
+    int numElements = numImages * dim.inputPlanes * dim.outputSizeSquared;
+    kernelIm2Col->in(numElements);
     kernelIm2Col->in(imagesWrapper);
     kernelIm2Col->in(imagesOffset);
+    kernelIm2Col->in(numImages * dim.outputSizeSquared);
     kernelIm2Col->out(columnsWrapper);
-
-    int workgroupSize = cl->getMaxWorkgroupSize();
-    int numWorkgroups = this->numKernelsIm2Col;
-
-    kernelIm2Col->run_1d(numWorkgroups * workgroupSize, workgroupSize);
+    run(kernelIm2Col, numElements);
 }
-PUBLIC void Im2Col::col2Im(CLWrapper *columnsWrapper, CLWrapper *imagesWrapper, int imagesOffset) {
+PUBLIC void Im2Col::col2Im(CLWrapper *columnsWrapper, int numImages, CLWrapper *imagesWrapper, int imagesOffset) {
     if(kernelCol2Im == 0) {
-        buildKernelCol2Im();
+        kernelCol2Im = buildKernel("col2im");
     }
-    kernelCol2Im->in(numKernelsCol2Im);
+    int numElements = numImages * dim.inputCubeSize;
+    kernelCol2Im->in(numElements);
     kernelCol2Im->in(columnsWrapper);
+    kernelCol2Im->in(numImages * dim.outputSizeSquared);
     kernelCol2Im->out(imagesWrapper);
     kernelCol2Im->in(imagesOffset);
-
-    int workgroupSize = cl->getMaxWorkgroupSize();
-    int numWorkgroups = this->numKernelsCol2Im;
-
-//        cout << "numworkgroups=" << numWorkgroups << " workgorupSize=" << workgroupSize << endl;
-    kernelCol2Im->run_1d(numWorkgroups * workgroupSize, workgroupSize);
+    run(kernelCol2Im, numElements);
+}
+// reorders numImages output-shaped cubes, [image][filter][pixel], starting at
+// cubesOffset, into planes, [filter][image][pixel], ie one column-major
+// [numImages * outputSizeSquared][numFilters] matrix
+PUBLIC void Im2Col::cubesToPlanes(CLWrapper *cubesWrapper, int cubesOffset, int numImages, CLWrapper *planesWrapper) {
+    if(kernelCubesToPlanes == 0) {
+        kernelCubesToPlanes = buildKernel("cubesToPlanes");
+    }
+    int numElements = numImages * dim.outputCubeSize;
+    kernelCubesToPlanes->in(numElements);
+    kernelCubesToPlanes->in(numImages);
+    kernelCubesToPlanes->in(cubesWrapper);
+    kernelCubesToPlanes->in(cubesOffset);
+    kernelCubesToPlanes->out(planesWrapper);
+    run(kernelCubesToPlanes, numElements);
+}
+PUBLIC void Im2Col::planesToCubes(CLWrapper *planesWrapper, int numImages, CLWrapper *cubesWrapper, int cubesOffset) {
+    if(kernelPlanesToCubes == 0) {
+        kernelPlanesToCubes = buildKernel("planesToCubes");
+    }
+    int numElements = numImages * dim.outputCubeSize;
+    kernelPlanesToCubes->in(numElements);
+    kernelPlanesToCubes->in(numImages);
+    kernelPlanesToCubes->in(planesWrapper);
+    kernelPlanesToCubes->out(cubesWrapper);
+    kernelPlanesToCubes->in(cubesOffset);
+    run(kernelPlanesToCubes, numElements);
 }
 STATIC std::string Im2Col::getKernelTemplate() {
     // [[[cog
@@ -117,37 +211,43 @@ STATIC std::string Im2Col::getKernelTemplate() {
     "\n"
     "// Kernel for fast unfold+copy\n"
     "// (adapted from Caffe: https://github.com/BVLC/caffe/blob/master/src/caffe/layers/conv_layer.cu)\n"
+    "// unfolds n / ({{channels}} * colSize * colSize) consecutive images side by side: row r of\n"
+    "// data_col holds image b's values at [r * colsStride + b * colSize * colSize], so with\n"
+    "// colsStride == numImages * colSize * colSize, data_col is one column-major\n"
+    "// [numImages * colSize * colSize][channels * filterSize * filterSize] matrix\n"
     "kernel void im2col(\n"
     "    const int n,\n"
     "    global float const * im_data, int im_offset,\n"
+    "    const int colsStride,\n"
     "    global float* data_col) {\n"
-    "  global const float *data_im = im_data + im_offset;\n"
-    "\n"
     "  CL_KERNEL_LOOP(index, n) {\n"
     "    int w_out = index % {{colSize}};\n"
     "    index /= {{colSize}};\n"
     "    int h_out = index % {{colSize}};\n"
-    "    int channel_in = index / {{colSize}};\n"
+    "    index /= {{colSize}};\n"
+    "    int channel_in = index % {{channels}};\n"
+    "    int b = index / {{channels}};\n"
     "    int channel_out = channel_in * {{filterSize}} * {{filterSize}};\n"
     "    int h_in = h_out * {{stride}} - {{padding}};\n"
     "    int w_in = w_out * {{stride}} - {{padding}};\n"
-    "    data_col += (channel_out * {{colSize}} + h_out) * {{colSize}} + w_out;\n"
-    "    data_im += (channel_in * {{size}} + h_in) * {{size}} + w_in;\n"
+    "    global float *col = data_col + channel_out * colsStride + (b * {{colSize}} + h_out) * {{colSize}} + w_out;\n"
+    "    global const float *im = im_data + im_offset + ((b * {{channels}} + channel_in) * {{size}} + h_in) * {{size}} + w_in;\n"
     "    for (int i = 0; i < {{filterSize}}; ++i) {\n"
     "      for (int j = 0; j < {{filterSize}}; ++j) {\n"
     "        int h = h_in + i;\n"
     "        int w = w_in + j;\n"
-    "        *data_col = (h >= 0 && w >= 0 && h < {{size}} && w < {{size}}) ?\n"
-    "          data_im[i * {{size}} + j] : 0;\n"
-    "        data_col += {{colSize}} * {{colSize}};\n"
+    "        *col = (h >= 0 && w >= 0 && h < {{size}} && w < {{size}}) ?\n"
+    "          im[i * {{size}} + j] : 0;\n"
+    "        col += colsStride;\n"
     "      }\n"
     "    }\n"
     "  }\n"
     "}\n"
     "\n"
+    "// inverse of im2col: n / ({{channels}} * size * size) images, laid out as above\n"
     "kernel void col2im(\n"
     "    const int n,\n"
-    "    global float const *data_col,\n"
+    "    global float const *data_col, const int colsStride,\n"
     "    global float* im_data, int im_offset) {\n"
     "  global float *data_im = im_data + im_offset;\n"
     "\n"
@@ -155,16 +255,17 @@ STATIC std::string Im2Col::getKernelTemplate() {
     "    float val = 0;\n"
     "    int w = index % {{size}} + {{padding}};\n"
     "    int h = (index / {{size}}) % {{size}} + {{padding}};\n"
-    "    int c = index / ({{size}} * {{size}});\n"
+    "    int c = (index / ({{size}} * {{size}})) % {{channels}};\n"
+    "    int b = index / ({{channels}} * {{size}} * {{size}});\n"
     "    // compute the start and end of the output\n"
     "    int w_col_start = (w < {{filterSize}}) ? 0 : (w - {{filterSize}}) / {{stride}} + 1;\n"
     "    int w_col_end = min(w / {{stride}} + 1, {{colSize}});\n"
     "    int h_col_start = (h < {{filterSize}}) ? 0 : (h - {{filterSize}}) / {{stride}} + 1;\n"
     "    int h_col_end = min(h / {{stride}} + 1, {{colSize}});\n"
     "\n"
-    "    int offset = (c * {{filterSize}} * {{filterSize}} + h * {{filterSize}} + w) * {{colSize}} * {{colSize}};\n"
-    "    int coeff_h_col = (1 - {{stride}} * {{filterSize}} * {{colSize}}) * {{colSize}};\n"
-    "    int coeff_w_col = (1 - {{stride}} * {{colSize}} * {{colSize}});\n"
+    "    int offset = (c * {{filterSize}} * {{filterSize}} + h * {{filterSize}} + w) * colsStride + b * {{colSize}} * {{colSize}};\n"
+    "    int coeff_h_col = {{colSize}} - {{stride}} * {{filterSize}} * colsStride;\n"
+    "    int coeff_w_col = 1 - {{stride}} * colsStride;\n"
     "    for (int h_col = h_col_start; h_col < h_col_end; ++h_col) {\n"
     "      for (int w_col = w_col_start; w_col < w_col_end; ++w_col) {\n"
     "        val += data_col[offset + h_col * coeff_h_col + w_col * coeff_w_col];\n"
@@ -174,6 +275,33 @@ STATIC std::string Im2Col::getKernelTemplate() {
     "  }\n"
     "}\n"
     "\n"
+    "// swaps the outer two dimensions, between the layer layout,\n"
+    "// [numImages][numFilters][colSize * colSize], and [numFilters][numImages][colSize * colSize],\n"
+    "// which is one column-major [numImages * colSize * colSize][numFilters] matrix, for gemm\n"
+    "kernel void cubesToPlanes(\n"
+    "    const int n, const int numImages,\n"
+    "    global float const *cubes, int cubesOffset,\n"
+    "    global float *planes) {\n"
+    "  CL_KERNEL_LOOP(index, n) {\n"
+    "    int pixel = index % ({{colSize}} * {{colSize}});\n"
+    "    int filter = (index / ({{colSize}} * {{colSize}})) % {{numFilters}};\n"
+    "    int b = index / ({{numFilters}} * {{colSize}} * {{colSize}});\n"
+    "    planes[(filter * numImages + b) * {{colSize}} * {{colSize}} + pixel] = cubes[cubesOffset + index];\n"
+    "  }\n"
+    "}\n"
+    "\n"
+    "kernel void planesToCubes(\n"
+    "    const int n, const int numImages,\n"
+    "    global float const *planes,\n"
+    "    global float *cubes, int cubesOffset) {\n"
+    "  CL_KERNEL_LOOP(index, n) {\n"
+    "    int pixel = index % ({{colSize}} * {{colSize}});\n"
+    "    int filter = (index / ({{colSize}} * {{colSize}})) % {{numFilters}};\n"
+    "    int b = index / ({{numFilters}} * {{colSize}} * {{colSize}});\n"
+    "    cubes[cubesOffset + index] = planes[(filter * numImages + b) * {{colSize}} * {{colSize}} + pixel];\n"
+    "  }\n"
+    "}\n"
+    "\n"
     "";
     // [[[end]]]
     return kernelSource;
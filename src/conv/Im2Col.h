@@ -12,15 +12,22 @@ class TemplatedKernel;
 #define STATIC static
 #define VIRTUAL virtual
 
-class Im2Col {
+class DeepCL_EXPORT Im2Col {
     EasyCL *cl;
     LayerDimensions dim;
 
     CLKernel *kernelIm2Col;
     CLKernel *kernelCol2Im;
+    CLKernel *kernelCubesToPlanes;
+    CLKernel *kernelPlanesToCubes;
 
-    int numKernelsIm2Col;
-    int numKernelsCol2Im;
+    static int64 workspaceBudget; // bytes; -1 until first read
+
+    int workspaceImages; // how many images the workspace currently holds
+    float *columns;
+    CLWrapper *columnsWrapper;
+    float *planes;
+    CLWrapper *planesWrapper;
 
     // [[[cog
     // import cog_addheaders
@@ -31,13 +38,21 @@ class Im2Col {
     public:
     Im2Col(EasyCL *cl, LayerDimensions dim);
     VIRTUAL ~Im2Col();
-    void im2Col(CLWrapper *imagesWrapper, int imagesOffset, CLWrapper *columnsWrapper);
-    void col2Im(CLWrapper *columnsWrapper, CLWrapper *imagesWrapper, int imagesOffset);
+    STATIC void setWorkspaceBudget(int64 bytes);
+    STATIC int64 getWorkspaceBudget();
+    int allocateWorkspace(int batchSize);
+    CLWrapper *getColumnsWrapper();
+    CLWrapper *getPlanesWrapper();
+    void im2Col(CLWrapper *imagesWrapper, int imagesOffset, int numImages, CLWrapper *columnsWrapper);
+    void col2Im(CLWrapper *columnsWrapper, int numImages, CLWrapper *imagesWrapper, int imagesOffset);
+    void cubesToPlanes(CLWrapper *cubesWrapper, int cubesOffset, int numImages, CLWrapper *planesWrapper);
+    void planesToCubes(CLWrapper *planesWrapper, int numImages, CLWrapper *cubesWrapper, int cubesOffset);
 
     private:
+    void freeWorkspace();
     void setupBuilder(TemplatedKernel *builder);
-    void buildKernelIm2Col();
-    void buildKernelCol2Im();
+    CLKernel *buildKernel(std::string kernelName);
+    void run(CLKernel *kernel, int numElements);
     STATIC std::string getKernelTemplate();
 
     // [[[end]]]
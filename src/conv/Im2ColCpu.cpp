@@ -0,0 +1,85 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <cstring>
+
+#include "conv/Im2ColCpu.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+
+// 1x1 filters, without padding: the columns matrix is just the image itself,
+// so callers can skip im2Col/col2Im entirely
+PUBLIC STATIC bool Im2ColCpu::isIdentity(const LayerDimensions &dim) {
+    return dim.filterSize == 1 && dim.skip == 0 && dim.outputSize == dim.inputSize;
+}
+PUBLIC STATIC void Im2ColCpu::im2Col(const LayerDimensions &dim, const float *image, float *columns) {
+    const int margin = dim.padZeros ? dim.halfFilterSize : 0;
+    for(int inPlane = 0; inPlane < dim.inputPlanes; inPlane++) {
+        const float *imagePlane = image + inPlane * dim.inputSizeSquared;
+        for(int filterRow = 0; filterRow < dim.filterSize; filterRow++) {
+            for(int filterCol = 0; filterCol < dim.filterSize; filterCol++) {
+                int outColBegin, outColEnd;
+                validOutColRange(dim, filterCol, &outColBegin, &outColEnd);
+                for(int outRow = 0; outRow < dim.outputSize; outRow++) {
+                    float *dst = columns + outRow * dim.outputSize;
+                    const int inRow = outRow - margin + filterRow;
+                    if(inRow < 0 || inRow >= dim.inputSize || outColBegin >= outColEnd) {
+                        memset(dst, 0, sizeof(float) * dim.outputSize);
+                        continue;
+                    }
+                    memset(dst, 0, sizeof(float) * outColBegin);
+                    memcpy(dst + outColBegin,
+                        imagePlane + inRow * dim.inputSize + outColBegin - margin + filterCol,
+                        sizeof(float) * (outColEnd - outColBegin));
+                    memset(dst + outColEnd, 0, sizeof(float) * (dim.outputSize - outColEnd));
+                }
+                columns += dim.outputSizeSquared;
+            }
+        }
+    }
+}
+// overwrites image, summing the contributions from each column that overlaps each pixel
+PUBLIC STATIC void Im2ColCpu::col2Im(const LayerDimensions &dim, const float *columns, float *image) {
+    const int margin = dim.padZeros ? dim.halfFilterSize : 0;
+    memset(image, 0, sizeof(float) * dim.inputCubeSize);
+    for(int inPlane = 0; inPlane < dim.inputPlanes; inPlane++) {
+        float *imagePlane = image + inPlane * dim.inputSizeSquared;
+        for(int filterRow = 0; filterRow < dim.filterSize; filterRow++) {
+            for(int filterCol = 0; filterCol < dim.filterSize; filterCol++) {
+                int outColBegin, outColEnd;
+                validOutColRange(dim, filterCol, &outColBegin, &outColEnd);
+                for(int outRow = 0; outRow < dim.outputSize; outRow++) {
+                    const int inRow = outRow - margin + filterRow;
+                    if(inRow < 0 || inRow >= dim.inputSize) {
+                        continue;
+                    }
+                    const float *src = columns + outRow * dim.outputSize;
+                    float *dst = imagePlane + inRow * dim.inputSize - margin + filterCol;
+                    for(int outCol = outColBegin; outCol < outColEnd; outCol++) {
+                        dst[outCol] += src[outCol];
+                    }
+                }
+                columns += dim.outputSizeSquared;
+            }
+        }
+    }
+}
+// outCols in [begin, end) map to inCols inside the image, for this filterCol
+PRIVATE STATIC void Im2ColCpu::validOutColRange(const LayerDimensions &dim, int filterCol, int *p_begin, int *p_end) {
+    const int margin = dim.padZeros ? dim.halfFilterSize : 0;
+    *p_begin = max(0, margin - filterCol);
+    *p_end = min(dim.outputSize, dim.inputSize + margin - filterCol);
+    if(*p_end < *p_begin) {
+        *p_end = *p_begin;
+    }
+}
+
@@ -0,0 +1,38 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "LayerDimensions.h"
+
+#include "DeepCLDllExport.h"
+
+#define STATIC static
+#define VIRTUAL virtual
+
+// host-side twin of Im2Col, for the cpu implementations
+// one image at a time, columns are [inputPlane][filterRow][filterCol][outRow][outCol],
+// ie a [inputPlanes * filterSizeSquared][outputSizeSquared] row-major matrix
+// supports skip == 0 only
+class DeepCL_EXPORT Im2ColCpu {
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    STATIC bool isIdentity(const LayerDimensions &dim);
+    STATIC void im2Col(const LayerDimensions &dim, const float *image, float *columns);
+    STATIC void col2Im(const LayerDimensions &dim, const float *columns, float *image);
+
+    private:
+    STATIC void validOutColRange(const LayerDimensions &dim, int filterCol, int *p_begin, int *p_end);
+
+    // [[[end]]]
+};
+
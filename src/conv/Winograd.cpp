@@ -0,0 +1,771 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "clblas/ClBlasHelper.h"
+#include "EasyCL.h"
+#include "util/stringhelper.h"
+#include "conv/Im2Col.h"
+
+#include "conv/Winograd.h"
+
+#include <iostream>
+#include <stdexcept>
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+#define PUBLIC
+
+// pad is on each side; the output is inputSize + 2 * pad - 2 square
+// rotate: weights are the layer's filters, [outPlanes here][inPlanes here][3][3] in the
+// layer's terms, ie [inPlanes][outPlanes][3][3] here, to be rotated 180 degrees; that's
+// how backward uses it
+PUBLIC Winograd::Winograd(EasyCL *cl, int inPlanes, int inputSize, int outPlanes, int pad, int tileSize, bool rotate, bool biased) :
+        cl(cl),
+        inPlanes(inPlanes),
+        inputSize(inputSize),
+        outPlanes(outPlanes),
+        pad(pad),
+        tileSize(tileSize),
+        alpha(tileSize + 2),
+        outputSize(inputSize + 2 * pad - 2),
+        tilesPerRow((inputSize + 2 * pad - 2 + tileSize - 1) / tileSize),
+        numTiles(tilesPerRow * tilesPerRow),
+        rotate(rotate),
+        biased(biased) {
+    if(tileSize != 2 && tileSize != 4) {
+        throw runtime_error("Winograd: tileSize should be 2 or 4, not " + toString(tileSize));
+    }
+    if(outputSize <= 0) {
+        throw runtime_error("Winograd: input too small, inputSize=" + toString(inputSize) + " pad=" + toString(pad));
+    }
+    this->workspaceImages = 0;
+    this->transformedInput = 0;
+    this->transformedInputWrapper = 0;
+    this->transformedOutput = 0;
+    this->transformedOutputWrapper = 0;
+
+    int transformedFiltersSize = alpha * alpha * outPlanes * inPlanes;
+    transformedFilters = new float[transformedFiltersSize];
+    transformedFiltersWrapper = cl->wrap(transformedFiltersSize, transformedFilters);
+    transformedFiltersWrapper->createOnDevice();
+
+    string options = "";
+    options += " -DgM=" + toString(tileSize);
+    options += " -DgAlpha=" + toString(alpha);
+    options += " -DgInPlanes=" + toString(inPlanes);
+    options += " -DgOutPlanes=" + toString(outPlanes);
+    options += " -DgInputSize=" + toString(inputSize);
+    options += " -DgOutputSize=" + toString(outputSize);
+    options += " -DgPad=" + toString(pad);
+    options += " -DgTilesPerRow=" + toString(tilesPerRow);
+    options += " -DgNumTiles=" + toString(numTiles);
+    options += " -DgRotate=" + toString(rotate ? 1 : 0);
+    options += " -DgBiased=" + toString(biased ? 1 : 0);
+
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel2("kernelTransformFilters", "cl/winograd.cl", "transformFilters", 'options')
+    // stringify.write_kernel2("kernelTransformInput", "cl/winograd.cl", "transformInput", 'options')
+    // stringify.write_kernel2("kernelTransformOutput", "cl/winograd.cl", "transformOutput", 'options')
+    // ]]]
+    // generated using cog, from cl/winograd.cl:
+    const char * kernelTransformFiltersSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "// Winograd F(mxm, 3x3) convolution, stride 1, as in Lavin and Gray, \"Fast Algorithms\n"
+    "// for Convolutional Neural Networks\":\n"
+    "// output tile = AT [(G g GT) .* (BT d B)] A\n"
+    "// the elementwise product, summed over input planes, is done by the host, as one\n"
+    "// gemm per transformed position xi, between the kernels below\n"
+    "\n"
+    "// expected defines:\n"
+    "// gM: output tile size, 2 or 4\n"
+    "// gAlpha: input tile size, gM + 2\n"
+    "// gInPlanes, gOutPlanes, gInputSize, gOutputSize, gPad\n"
+    "// gTilesPerRow, gNumTiles: tiles per row, and per image, of the output\n"
+    "// gRotate: 1 if weights are the layer's filters, to be rotated 180 degrees, and\n"
+    "//     with in and out planes swapped, for backward, else 0\n"
+    "// gBiased: 1 if bias should be added to the output, else 0\n"
+    "\n"
+    "#if gM == 2\n"
+    "constant float BT[] = {\n"
+    "    1, 0, -1, 0,\n"
+    "    0, 1, 1, 0,\n"
+    "    0, -1, 1, 0,\n"
+    "    0, 1, 0, -1\n"
+    "};\n"
+    "constant float G[] = {\n"
+    "    1, 0, 0,\n"
+    "    0.5f, 0.5f, 0.5f,\n"
+    "    0.5f, -0.5f, 0.5f,\n"
+    "    0, 0, 1\n"
+    "};\n"
+    "constant float AT[] = {\n"
+    "    1, 1, 1, 0,\n"
+    "    0, 1, -1, -1\n"
+    "};\n"
+    "#elif gM == 4\n"
+    "constant float BT[] = {\n"
+    "    4, 0, -5, 0, 1, 0,\n"
+    "    0, -4, -4, 1, 1, 0,\n"
+    "    0, 4, -4, -1, 1, 0,\n"
+    "    0, -2, -1, 2, 1, 0,\n"
+    "    0, 2, -1, -2, 1, 0,\n"
+    "    0, 4, 0, -5, 0, 1\n"
+    "};\n"
+    "constant float G[] = {\n"
+    "    1 / 4.0f, 0, 0,\n"
+    "    -1 / 6.0f, -1 / 6.0f, -1 / 6.0f,\n"
+    "    -1 / 6.0f, 1 / 6.0f, -1 / 6.0f,\n"
+    "    1 / 24.0f, 1 / 12.0f, 1 / 6.0f,\n"
+    "    1 / 24.0f, -1 / 12.0f, 1 / 6.0f,\n"
+    "    0, 0, 1\n"
+    "};\n"
+    "constant float AT[] = {\n"
+    "    1, 1, 1, 1, 1, 0,\n"
+    "    0, 1, -1, 2, -2, 0,\n"
+    "    0, 1, 1, 4, 4, 0,\n"
+    "    0, 1, -1, 8, -8, 1\n"
+    "};\n"
+    "#endif\n"
+    "\n"
+    "// transformedFilters: [gAlpha * gAlpha][gOutPlanes][gInPlanes]\n"
+    "// globalId: [outPlane][inPlane]\n"
+    "kernel void transformFilters(global const float *weights, global float *transformedFilters) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= gOutPlanes * gInPlanes) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int outPlane = globalId / gInPlanes;\n"
+    "    const int inPlane = globalId % gInPlanes;\n"
+    "    float filter[9];\n"
+    "    #if gRotate\n"
+    "    global const float *source = weights + (inPlane * gOutPlanes + outPlane) * 9;\n"
+    "    for (int i = 0; i < 9; i++) {\n"
+    "        filter[i] = source[8 - i];\n"
+    "    }\n"
+    "    #else\n"
+    "    global const float *source = weights + globalId * 9;\n"
+    "    for (int i = 0; i < 9; i++) {\n"
+    "        filter[i] = source[i];\n"
+    "    }\n"
+    "    #endif\n"
+    "    float temp[gAlpha * 3];\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int j = 0; j < 3; j++) {\n"
+    "            temp[a * 3 + j] = G[a * 3] * filter[j] + G[a * 3 + 1] * filter[3 + j] + G[a * 3 + 2] * filter[6 + j];\n"
+    "        }\n"
+    "    }\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int b = 0; b < gAlpha; b++) {\n"
+    "            transformedFilters[((a * gAlpha + b) * gOutPlanes + outPlane) * gInPlanes + inPlane] =\n"
+    "                temp[a * 3] * G[b * 3] + temp[a * 3 + 1] * G[b * 3 + 1] + temp[a * 3 + 2] * G[b * 3 + 2];\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// transformedInput: [gAlpha * gAlpha][gInPlanes][numImages * gNumTiles]\n"
+    "// globalId: [n][inPlane][tile]\n"
+    "kernel void transformInput(const int numImages, global const float *input, const int inputOffset,\n"
+    "        global float *transformedInput) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= numImages * gInPlanes * gNumTiles) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int tile = globalId % gNumTiles;\n"
+    "    const int inPlane = (globalId / gNumTiles) % gInPlanes;\n"
+    "    const int n = globalId / gNumTiles / gInPlanes;\n"
+    "    const int row0 = (tile / gTilesPerRow) * gM - gPad;\n"
+    "    const int col0 = (tile % gTilesPerRow) * gM - gPad;\n"
+    "    global const float *inputPlane = input + inputOffset + (n * gInPlanes + inPlane) * gInputSize * gInputSize;\n"
+    "    float d[gAlpha * gAlpha];\n"
+    "    for (int i = 0; i < gAlpha; i++) {\n"
+    "        const int row = row0 + i;\n"
+    "        for (int j = 0; j < gAlpha; j++) {\n"
+    "            const int col = col0 + j;\n"
+    "            const bool inside = row >= 0 && row < gInputSize && col >= 0 && col < gInputSize;\n"
+    "            d[i * gAlpha + j] = inside ? inputPlane[row * gInputSize + col] : 0.0f;\n"
+    "        }\n"
+    "    }\n"
+    "    float temp[gAlpha * gAlpha];\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int j = 0; j < gAlpha; j++) {\n"
+    "            float sum = 0;\n"
+    "            for (int i = 0; i < gAlpha; i++) {\n"
+    "                sum += BT[a * gAlpha + i] * d[i * gAlpha + j];\n"
+    "            }\n"
+    "            temp[a * gAlpha + j] = sum;\n"
+    "        }\n"
+    "    }\n"
+    "    const int columns = numImages * gNumTiles;\n"
+    "    const int column = n * gNumTiles + tile;\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int b = 0; b < gAlpha; b++) {\n"
+    "            float sum = 0;\n"
+    "            for (int j = 0; j < gAlpha; j++) {\n"
+    "                sum += temp[a * gAlpha + j] * BT[b * gAlpha + j];\n"
+    "            }\n"
+    "            transformedInput[((a * gAlpha + b) * gInPlanes + inPlane) * columns + column] = sum;\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// transformedOutput: [gAlpha * gAlpha][gOutPlanes][numImages * gNumTiles]\n"
+    "// output: [n][outPlane][outputRow][outputCol]\n"
+    "// globalId: [n][outPlane][tile]\n"
+    "kernel void transformOutput(const int numImages, global const float *transformedOutput,\n"
+    "        global const float *bias, global float *output, const int outputOffset) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= numImages * gOutPlanes * gNumTiles) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int tile = globalId % gNumTiles;\n"
+    "    const int outPlane = (globalId / gNumTiles) % gOutPlanes;\n"
+    "    const int n = globalId / gNumTiles / gOutPlanes;\n"
+    "    const int columns = numImages * gNumTiles;\n"
+    "    const int column = n * gNumTiles + tile;\n"
+    "    float m[gAlpha * gAlpha];\n"
+    "    for (int xi = 0; xi < gAlpha * gAlpha; xi++) {\n"
+    "        m[xi] = transformedOutput[(xi * gOutPlanes + outPlane) * columns + column];\n"
+    "    }\n"
+    "    float temp[gM * gAlpha];\n"
+    "    for (int r = 0; r < gM; r++) {\n"
+    "        for (int b = 0; b < gAlpha; b++) {\n"
+    "            float sum = 0;\n"
+    "            for (int a = 0; a < gAlpha; a++) {\n"
+    "                sum += AT[r * gAlpha + a] * m[a * gAlpha + b];\n"
+    "            }\n"
+    "            temp[r * gAlpha + b] = sum;\n"
+    "        }\n"
+    "    }\n"
+    "    #if gBiased\n"
+    "    const float planeBias = bias[outPlane];\n"
+    "    #else\n"
+    "    const float planeBias = 0.0f;\n"
+    "    #endif\n"
+    "    const int row0 = (tile / gTilesPerRow) * gM;\n"
+    "    const int col0 = (tile % gTilesPerRow) * gM;\n"
+    "    global float *outputPlane = output + outputOffset + (n * gOutPlanes + outPlane) * gOutputSize * gOutputSize;\n"
+    "    for (int r = 0; r < gM; r++) {\n"
+    "        if (row0 + r >= gOutputSize) {\n"
+    "            break;\n"
+    "        }\n"
+    "        for (int s = 0; s < gM; s++) {\n"
+    "            if (col0 + s >= gOutputSize) {\n"
+    "                break;\n"
+    "            }\n"
+    "            float sum = 0;\n"
+    "            for (int b = 0; b < gAlpha; b++) {\n"
+    "                sum += temp[r * gAlpha + b] * AT[s * gAlpha + b];\n"
+    "            }\n"
+    "            outputPlane[(row0 + r) * gOutputSize + col0 + s] = sum + planeBias;\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "";
+    kernelTransformFilters = cl->buildKernelFromString(kernelTransformFiltersSource, "transformFilters", options, "cl/winograd.cl");
+    // generated using cog, from cl/winograd.cl:
+    const char * kernelTransformInputSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "// Winograd F(mxm, 3x3) convolution, stride 1, as in Lavin and Gray, \"Fast Algorithms\n"
+    "// for Convolutional Neural Networks\":\n"
+    "// output tile = AT [(G g GT) .* (BT d B)] A\n"
+    "// the elementwise product, summed over input planes, is done by the host, as one\n"
+    "// gemm per transformed position xi, between the kernels below\n"
+    "\n"
+    "// expected defines:\n"
+    "// gM: output tile size, 2 or 4\n"
+    "// gAlpha: input tile size, gM + 2\n"
+    "// gInPlanes, gOutPlanes, gInputSize, gOutputSize, gPad\n"
+    "// gTilesPerRow, gNumTiles: tiles per row, and per image, of the output\n"
+    "// gRotate: 1 if weights are the layer's filters, to be rotated 180 degrees, and\n"
+    "//     with in and out planes swapped, for backward, else 0\n"
+    "// gBiased: 1 if bias should be added to the output, else 0\n"
+    "\n"
+    "#if gM == 2\n"
+    "constant float BT[] = {\n"
+    "    1, 0, -1, 0,\n"
+    "    0, 1, 1, 0,\n"
+    "    0, -1, 1, 0,\n"
+    "    0, 1, 0, -1\n"
+    "};\n"
+    "constant float G[] = {\n"
+    "    1, 0, 0,\n"
+    "    0.5f, 0.5f, 0.5f,\n"
+    "    0.5f, -0.5f, 0.5f,\n"
+    "    0, 0, 1\n"
+    "};\n"
+    "constant float AT[] = {\n"
+    "    1, 1, 1, 0,\n"
+    "    0, 1, -1, -1\n"
+    "};\n"
+    "#elif gM == 4\n"
+    "constant float BT[] = {\n"
+    "    4, 0, -5, 0, 1, 0,\n"
+    "    0, -4, -4, 1, 1, 0,\n"
+    "    0, 4, -4, -1, 1, 0,\n"
+    "    0, -2, -1, 2, 1, 0,\n"
+    "    0, 2, -1, -2, 1, 0,\n"
+    "    0, 4, 0, -5, 0, 1\n"
+    "};\n"
+    "constant float G[] = {\n"
+    "    1 / 4.0f, 0, 0,\n"
+    "    -1 / 6.0f, -1 / 6.0f, -1 / 6.0f,\n"
+    "    -1 / 6.0f, 1 / 6.0f, -1 / 6.0f,\n"
+    "    1 / 24.0f, 1 / 12.0f, 1 / 6.0f,\n"
+    "    1 / 24.0f, -1 / 12.0f, 1 / 6.0f,\n"
+    "    0, 0, 1\n"
+    "};\n"
+    "constant float AT[] = {\n"
+    "    1, 1, 1, 1, 1, 0,\n"
+    "    0, 1, -1, 2, -2, 0,\n"
+    "    0, 1, 1, 4, 4, 0,\n"
+    "    0, 1, -1, 8, -8, 1\n"
+    "};\n"
+    "#endif\n"
+    "\n"
+    "// transformedFilters: [gAlpha * gAlpha][gOutPlanes][gInPlanes]\n"
+    "// globalId: [outPlane][inPlane]\n"
+    "kernel void transformFilters(global const float *weights, global float *transformedFilters) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= gOutPlanes * gInPlanes) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int outPlane = globalId / gInPlanes;\n"
+    "    const int inPlane = globalId % gInPlanes;\n"
+    "    float filter[9];\n"
+    "    #if gRotate\n"
+    "    global const float *source = weights + (inPlane * gOutPlanes + outPlane) * 9;\n"
+    "    for (int i = 0; i < 9; i++) {\n"
+    "        filter[i] = source[8 - i];\n"
+    "    }\n"
+    "    #else\n"
+    "    global const float *source = weights + globalId * 9;\n"
+    "    for (int i = 0; i < 9; i++) {\n"
+    "        filter[i] = source[i];\n"
+    "    }\n"
+    "    #endif\n"
+    "    float temp[gAlpha * 3];\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int j = 0; j < 3; j++) {\n"
+    "            temp[a * 3 + j] = G[a * 3] * filter[j] + G[a * 3 + 1] * filter[3 + j] + G[a * 3 + 2] * filter[6 + j];\n"
+    "        }\n"
+    "    }\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int b = 0; b < gAlpha; b++) {\n"
+    "            transformedFilters[((a * gAlpha + b) * gOutPlanes + outPlane) * gInPlanes + inPlane] =\n"
+    "                temp[a * 3] * G[b * 3] + temp[a * 3 + 1] * G[b * 3 + 1] + temp[a * 3 + 2] * G[b * 3 + 2];\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// transformedInput: [gAlpha * gAlpha][gInPlanes][numImages * gNumTiles]\n"
+    "// globalId: [n][inPlane][tile]\n"
+    "kernel void transformInput(const int numImages, global const float *input, const int inputOffset,\n"
+    "        global float *transformedInput) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= numImages * gInPlanes * gNumTiles) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int tile = globalId % gNumTiles;\n"
+    "    const int inPlane = (globalId / gNumTiles) % gInPlanes;\n"
+    "    const int n = globalId / gNumTiles / gInPlanes;\n"
+    "    const int row0 = (tile / gTilesPerRow) * gM - gPad;\n"
+    "    const int col0 = (tile % gTilesPerRow) * gM - gPad;\n"
+    "    global const float *inputPlane = input + inputOffset + (n * gInPlanes + inPlane) * gInputSize * gInputSize;\n"
+    "    float d[gAlpha * gAlpha];\n"
+    "    for (int i = 0; i < gAlpha; i++) {\n"
+    "        const int row = row0 + i;\n"
+    "        for (int j = 0; j < gAlpha; j++) {\n"
+    "            const int col = col0 + j;\n"
+    "            const bool inside = row >= 0 && row < gInputSize && col >= 0 && col < gInputSize;\n"
+    "            d[i * gAlpha + j] = inside ? inputPlane[row * gInputSize + col] : 0.0f;\n"
+    "        }\n"
+    "    }\n"
+    "    float temp[gAlpha * gAlpha];\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int j = 0; j < gAlpha; j++) {\n"
+    "            float sum = 0;\n"
+    "            for (int i = 0; i < gAlpha; i++) {\n"
+    "                sum += BT[a * gAlpha + i] * d[i * gAlpha + j];\n"
+    "            }\n"
+    "            temp[a * gAlpha + j] = sum;\n"
+    "        }\n"
+    "    }\n"
+    "    const int columns = numImages * gNumTiles;\n"
+    "    const int column = n * gNumTiles + tile;\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int b = 0; b < gAlpha; b++) {\n"
+    "            float sum = 0;\n"
+    "            for (int j = 0; j < gAlpha; j++) {\n"
+    "                sum += temp[a * gAlpha + j] * BT[b * gAlpha + j];\n"
+    "            }\n"
+    "            transformedInput[((a * gAlpha + b) * gInPlanes + inPlane) * columns + column] = sum;\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// transformedOutput: [gAlpha * gAlpha][gOutPlanes][numImages * gNumTiles]\n"
+    "// output: [n][outPlane][outputRow][outputCol]\n"
+    "// globalId: [n][outPlane][tile]\n"
+    "kernel void transformOutput(const int numImages, global const float *transformedOutput,\n"
+    "        global const float *bias, global float *output, const int outputOffset) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= numImages * gOutPlanes * gNumTiles) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int tile = globalId % gNumTiles;\n"
+    "    const int outPlane = (globalId / gNumTiles) % gOutPlanes;\n"
+    "    const int n = globalId / gNumTiles / gOutPlanes;\n"
+    "    const int columns = numImages * gNumTiles;\n"
+    "    const int column = n * gNumTiles + tile;\n"
+    "    float m[gAlpha * gAlpha];\n"
+    "    for (int xi = 0; xi < gAlpha * gAlpha; xi++) {\n"
+    "        m[xi] = transformedOutput[(xi * gOutPlanes + outPlane) * columns + column];\n"
+    "    }\n"
+    "    float temp[gM * gAlpha];\n"
+    "    for (int r = 0; r < gM; r++) {\n"
+    "        for (int b = 0; b < gAlpha; b++) {\n"
+    "            float sum = 0;\n"
+    "            for (int a = 0; a < gAlpha; a++) {\n"
+    "                sum += AT[r * gAlpha + a] * m[a * gAlpha + b];\n"
+    "            }\n"
+    "            temp[r * gAlpha + b] = sum;\n"
+    "        }\n"
+    "    }\n"
+    "    #if gBiased\n"
+    "    const float planeBias = bias[outPlane];\n"
+    "    #else\n"
+    "    const float planeBias = 0.0f;\n"
+    "    #endif\n"
+    "    const int row0 = (tile / gTilesPerRow) * gM;\n"
+    "    const int col0 = (tile % gTilesPerRow) * gM;\n"
+    "    global float *outputPlane = output + outputOffset + (n * gOutPlanes + outPlane) * gOutputSize * gOutputSize;\n"
+    "    for (int r = 0; r < gM; r++) {\n"
+    "        if (row0 + r >= gOutputSize) {\n"
+    "            break;\n"
+    "        }\n"
+    "        for (int s = 0; s < gM; s++) {\n"
+    "            if (col0 + s >= gOutputSize) {\n"
+    "                break;\n"
+    "            }\n"
+    "            float sum = 0;\n"
+    "            for (int b = 0; b < gAlpha; b++) {\n"
+    "                sum += temp[r * gAlpha + b] * AT[s * gAlpha + b];\n"
+    "            }\n"
+    "            outputPlane[(row0 + r) * gOutputSize + col0 + s] = sum + planeBias;\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "";
+    kernelTransformInput = cl->buildKernelFromString(kernelTransformInputSource, "transformInput", options, "cl/winograd.cl");
+    // generated using cog, from cl/winograd.cl:
+    const char * kernelTransformOutputSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "// Winograd F(mxm, 3x3) convolution, stride 1, as in Lavin and Gray, \"Fast Algorithms\n"
+    "// for Convolutional Neural Networks\":\n"
+    "// output tile = AT [(G g GT) .* (BT d B)] A\n"
+    "// the elementwise product, summed over input planes, is done by the host, as one\n"
+    "// gemm per transformed position xi, between the kernels below\n"
+    "\n"
+    "// expected defines:\n"
+    "// gM: output tile size, 2 or 4\n"
+    "// gAlpha: input tile size, gM + 2\n"
+    "// gInPlanes, gOutPlanes, gInputSize, gOutputSize, gPad\n"
+    "// gTilesPerRow, gNumTiles: tiles per row, and per image, of the output\n"
+    "// gRotate: 1 if weights are the layer's filters, to be rotated 180 degrees, and\n"
+    "//     with in and out planes swapped, for backward, else 0\n"
+    "// gBiased: 1 if bias should be added to the output, else 0\n"
+    "\n"
+    "#if gM == 2\n"
+    "constant float BT[] = {\n"
+    "    1, 0, -1, 0,\n"
+    "    0, 1, 1, 0,\n"
+    "    0, -1, 1, 0,\n"
+    "    0, 1, 0, -1\n"
+    "};\n"
+    "constant float G[] = {\n"
+    "    1, 0, 0,\n"
+    "    0.5f, 0.5f, 0.5f,\n"
+    "    0.5f, -0.5f, 0.5f,\n"
+    "    0, 0, 1\n"
+    "};\n"
+    "constant float AT[] = {\n"
+    "    1, 1, 1, 0,\n"
+    "    0, 1, -1, -1\n"
+    "};\n"
+    "#elif gM == 4\n"
+    "constant float BT[] = {\n"
+    "    4, 0, -5, 0, 1, 0,\n"
+    "    0, -4, -4, 1, 1, 0,\n"
+    "    0, 4, -4, -1, 1, 0,\n"
+    "    0, -2, -1, 2, 1, 0,\n"
+    "    0, 2, -1, -2, 1, 0,\n"
+    "    0, 4, 0, -5, 0, 1\n"
+    "};\n"
+    "constant float G[] = {\n"
+    "    1 / 4.0f, 0, 0,\n"
+    "    -1 / 6.0f, -1 / 6.0f, -1 / 6.0f,\n"
+    "    -1 / 6.0f, 1 / 6.0f, -1 / 6.0f,\n"
+    "    1 / 24.0f, 1 / 12.0f, 1 / 6.0f,\n"
+    "    1 / 24.0f, -1 / 12.0f, 1 / 6.0f,\n"
+    "    0, 0, 1\n"
+    "};\n"
+    "constant float AT[] = {\n"
+    "    1, 1, 1, 1, 1, 0,\n"
+    "    0, 1, -1, 2, -2, 0,\n"
+    "    0, 1, 1, 4, 4, 0,\n"
+    "    0, 1, -1, 8, -8, 1\n"
+    "};\n"
+    "#endif\n"
+    "\n"
+    "// transformedFilters: [gAlpha * gAlpha][gOutPlanes][gInPlanes]\n"
+    "// globalId: [outPlane][inPlane]\n"
+    "kernel void transformFilters(global const float *weights, global float *transformedFilters) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= gOutPlanes * gInPlanes) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int outPlane = globalId / gInPlanes;\n"
+    "    const int inPlane = globalId % gInPlanes;\n"
+    "    float filter[9];\n"
+    "    #if gRotate\n"
+    "    global const float *source = weights + (inPlane * gOutPlanes + outPlane) * 9;\n"
+    "    for (int i = 0; i < 9; i++) {\n"
+    "        filter[i] = source[8 - i];\n"
+    "    }\n"
+    "    #else\n"
+    "    global const float *source = weights + globalId * 9;\n"
+    "    for (int i = 0; i < 9; i++) {\n"
+    "        filter[i] = source[i];\n"
+    "    }\n"
+    "    #endif\n"
+    "    float temp[gAlpha * 3];\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int j = 0; j < 3; j++) {\n"
+    "            temp[a * 3 + j] = G[a * 3] * filter[j] + G[a * 3 + 1] * filter[3 + j] + G[a * 3 + 2] * filter[6 + j];\n"
+    "        }\n"
+    "    }\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int b = 0; b < gAlpha; b++) {\n"
+    "            transformedFilters[((a * gAlpha + b) * gOutPlanes + outPlane) * gInPlanes + inPlane] =\n"
+    "                temp[a * 3] * G[b * 3] + temp[a * 3 + 1] * G[b * 3 + 1] + temp[a * 3 + 2] * G[b * 3 + 2];\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// transformedInput: [gAlpha * gAlpha][gInPlanes][numImages * gNumTiles]\n"
+    "// globalId: [n][inPlane][tile]\n"
+    "kernel void transformInput(const int numImages, global const float *input, const int inputOffset,\n"
+    "        global float *transformedInput) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= numImages * gInPlanes * gNumTiles) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int tile = globalId % gNumTiles;\n"
+    "    const int inPlane = (globalId / gNumTiles) % gInPlanes;\n"
+    "    const int n = globalId / gNumTiles / gInPlanes;\n"
+    "    const int row0 = (tile / gTilesPerRow) * gM - gPad;\n"
+    "    const int col0 = (tile % gTilesPerRow) * gM - gPad;\n"
+    "    global const float *inputPlane = input + inputOffset + (n * gInPlanes + inPlane) * gInputSize * gInputSize;\n"
+    "    float d[gAlpha * gAlpha];\n"
+    "    for (int i = 0; i < gAlpha; i++) {\n"
+    "        const int row = row0 + i;\n"
+    "        for (int j = 0; j < gAlpha; j++) {\n"
+    "            const int col = col0 + j;\n"
+    "            const bool inside = row >= 0 && row < gInputSize && col >= 0 && col < gInputSize;\n"
+    "            d[i * gAlpha + j] = inside ? inputPlane[row * gInputSize + col] : 0.0f;\n"
+    "        }\n"
+    "    }\n"
+    "    float temp[gAlpha * gAlpha];\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int j = 0; j < gAlpha; j++) {\n"
+    "            float sum = 0;\n"
+    "            for (int i = 0; i < gAlpha; i++) {\n"
+    "                sum += BT[a * gAlpha + i] * d[i * gAlpha + j];\n"
+    "            }\n"
+    "            temp[a * gAlpha + j] = sum;\n"
+    "        }\n"
+    "    }\n"
+    "    const int columns = numImages * gNumTiles;\n"
+    "    const int column = n * gNumTiles + tile;\n"
+    "    for (int a = 0; a < gAlpha; a++) {\n"
+    "        for (int b = 0; b < gAlpha; b++) {\n"
+    "            float sum = 0;\n"
+    "            for (int j = 0; j < gAlpha; j++) {\n"
+    "                sum += temp[a * gAlpha + j] * BT[b * gAlpha + j];\n"
+    "            }\n"
+    "            transformedInput[((a * gAlpha + b) * gInPlanes + inPlane) * columns + column] = sum;\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// transformedOutput: [gAlpha * gAlpha][gOutPlanes][numImages * gNumTiles]\n"
+    "// output: [n][outPlane][outputRow][outputCol]\n"
+    "// globalId: [n][outPlane][tile]\n"
+    "kernel void transformOutput(const int numImages, global const float *transformedOutput,\n"
+    "        global const float *bias, global float *output, const int outputOffset) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= numImages * gOutPlanes * gNumTiles) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int tile = globalId % gNumTiles;\n"
+    "    const int outPlane = (globalId / gNumTiles) % gOutPlanes;\n"
+    "    const int n = globalId / gNumTiles / gOutPlanes;\n"
+    "    const int columns = numImages * gNumTiles;\n"
+    "    const int column = n * gNumTiles + tile;\n"
+    "    float m[gAlpha * gAlpha];\n"
+    "    for (int xi = 0; xi < gAlpha * gAlpha; xi++) {\n"
+    "        m[xi] = transformedOutput[(xi * gOutPlanes + outPlane) * columns + column];\n"
+    "    }\n"
+    "    float temp[gM * gAlpha];\n"
+    "    for (int r = 0; r < gM; r++) {\n"
+    "        for (int b = 0; b < gAlpha; b++) {\n"
+    "            float sum = 0;\n"
+    "            for (int a = 0; a < gAlpha; a++) {\n"
+    "                sum += AT[r * gAlpha + a] * m[a * gAlpha + b];\n"
+    "            }\n"
+    "            temp[r * gAlpha + b] = sum;\n"
+    "        }\n"
+    "    }\n"
+    "    #if gBiased\n"
+    "    const float planeBias = bias[outPlane];\n"
+    "    #else\n"
+    "    const float planeBias = 0.0f;\n"
+    "    #endif\n"
+    "    const int row0 = (tile / gTilesPerRow) * gM;\n"
+    "    const int col0 = (tile % gTilesPerRow) * gM;\n"
+    "    global float *outputPlane = output + outputOffset + (n * gOutPlanes + outPlane) * gOutputSize * gOutputSize;\n"
+    "    for (int r = 0; r < gM; r++) {\n"
+    "        if (row0 + r >= gOutputSize) {\n"
+    "            break;\n"
+    "        }\n"
+    "        for (int s = 0; s < gM; s++) {\n"
+    "            if (col0 + s >= gOutputSize) {\n"
+    "                break;\n"
+    "            }\n"
+    "            float sum = 0;\n"
+    "            for (int b = 0; b < gAlpha; b++) {\n"
+    "                sum += temp[r * gAlpha + b] * AT[s * gAlpha + b];\n"
+    "            }\n"
+    "            outputPlane[(row0 + r) * gOutputSize + col0 + s] = sum + planeBias;\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "";
+    kernelTransformOutput = cl->buildKernelFromString(kernelTransformOutputSource, "transformOutput", options, "cl/winograd.cl");
+    // [[[end]]]
+}
+PUBLIC VIRTUAL Winograd::~Winograd() {
+    delete kernelTransformFilters;
+    delete kernelTransformInput;
+    delete kernelTransformOutput;
+    delete transformedFiltersWrapper;
+    delete[] transformedFilters;
+    freeWorkspace();
+}
+// output should be [batchSize][outPlanes][outputSize][outputSize]; biasWrapper is
+// only read if biased
+PUBLIC void Winograd::convolve(int batchSize, CLWrapper *inputWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper, CLWrapper *outputWrapper) {
+    // the weights change every batch, during training, so transform them each time
+    kernelTransformFilters->in(weightsWrapper)->out(transformedFiltersWrapper);
+    run(kernelTransformFilters, outPlanes * inPlanes);
+
+    int subBatchSize = allocateWorkspace(batchSize);
+    if(!outputWrapper->isOnDevice()) {
+        outputWrapper->createOnDevice();
+    }
+    const int inputCubeSize = inPlanes * inputSize * inputSize;
+    const int outputCubeSize = outPlanes * outputSize * outputSize;
+    for(int b = 0; b < batchSize; b += subBatchSize) {
+        int numImages = batchSize - b < subBatchSize ? batchSize - b : subBatchSize;
+        int64 columns = (int64)numImages * numTiles;
+
+        kernelTransformInput->in(numImages)->in(inputWrapper)->in(b * inputCubeSize)->out(transformedInputWrapper);
+        run(kernelTransformInput, numImages * inPlanes * numTiles);
+
+        // transformedOutput[xi] = transformedFilters[xi] * transformedInput[xi], ie
+        // [outPlanes][columns] = [outPlanes][inPlanes] * [inPlanes][columns]
+        for(int xi = 0; xi < alpha * alpha; xi++) {
+            ClBlasHelper::Gemm(
+                cl, clblasRowMajor, clblasNoTrans, clblasNoTrans,
+                outPlanes, inPlanes, columns,
+                1,
+                transformedFiltersWrapper, (int64)xi * outPlanes * inPlanes,
+                transformedInputWrapper, xi * inPlanes * columns,
+                0,
+                transformedOutputWrapper, xi * outPlanes * columns
+            );
+        }
+
+        // the kernel only reads bias if biased, but needs some buffer passed in
+        kernelTransformOutput->in(numImages)->in(transformedOutputWrapper);
+        kernelTransformOutput->in(biased ? biasWrapper : transformedFiltersWrapper);
+        kernelTransformOutput->out(outputWrapper)->in(b * outputCubeSize);
+        run(kernelTransformOutput, numImages * outPlanes * numTiles);
+    }
+}
+// how many images each set of gemms will cover, for this batchSize, growing the
+// workspace if it has to
+int Winograd::allocateWorkspace(int batchSize) {
+    int64 bytesPerImage = (int64)alpha * alpha * numTiles * (inPlanes + outPlanes) * sizeof(float);
+    int64 numImages = Im2Col::getWorkspaceBudget() / bytesPerImage;
+    if(numImages > batchSize) {
+        numImages = batchSize;
+    }
+    if(numImages < 1) {
+        numImages = 1;
+    }
+    if(numImages > workspaceImages) {
+        freeWorkspace();
+        workspaceImages = (int)numImages;
+        int transformedInputSize = alpha * alpha * inPlanes * workspaceImages * numTiles;
+        transformedInput = new float[transformedInputSize];
+        transformedInputWrapper = cl->wrap(transformedInputSize, transformedInput);
+        transformedInputWrapper->createOnDevice();
+        int transformedOutputSize = alpha * alpha * outPlanes * workspaceImages * numTiles;
+        transformedOutput = new float[transformedOutputSize];
+        transformedOutputWrapper = cl->wrap(transformedOutputSize, transformedOutput);
+        transformedOutputWrapper->createOnDevice();
+    }
+    return (int)numImages;
+}
+void Winograd::freeWorkspace() {
+    delete transformedInputWrapper;
+    delete[] transformedInput;
+    delete transformedOutputWrapper;
+    delete[] transformedOutput;
+    transformedInputWrapper = 0;
+    transformedInput = 0;
+    transformedOutputWrapper = 0;
+    transformedOutput = 0;
+    workspaceImages = 0;
+}
+void Winograd::run(CLKernel *kernel, int numElements) {
+    int workgroupSize = cl->getMaxWorkgroupSize();
+    int numWorkgroups = (numElements + workgroupSize - 1) / workgroupSize;
+    kernel->run_1d(numWorkgroups * workgroupSize, workgroupSize);
+}
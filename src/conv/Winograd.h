@@ -0,0 +1,73 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "LayerDimensions.h"
+
+class EasyCL;
+class CLWrapper;
+class CLKernel;
+
+#include "DeepCLDllExport.h"
+
+#define STATIC static
+#define VIRTUAL virtual
+
+// Winograd F(mxm, 3x3) convolution on the gpu, the opencl counterpart of WinogradCpu:
+// cl/winograd.cl transforms the filters, and the input tiles, then one clBLAS gemm
+// per transformed position multiplies them, summing over input planes, and the
+// result is transformed back into output tiles
+// like Im2Col, images are processed in sub-batches, sized to fit
+// Im2Col::getWorkspaceBudget(), and the workspace is kept for the life of the layer
+class DeepCL_EXPORT Winograd {
+    EasyCL *cl;
+
+    public:
+    const int inPlanes;
+    const int inputSize;
+    const int outPlanes;
+    const int pad;
+    const int tileSize; // m
+    const int alpha; // m + 2
+    const int outputSize;
+    const int tilesPerRow;
+    const int numTiles; // per image
+    const bool rotate;
+    const bool biased;
+
+    private:
+    CLKernel *kernelTransformFilters;
+    CLKernel *kernelTransformInput;
+    CLKernel *kernelTransformOutput;
+
+    float *transformedFilters; // [alpha * alpha][outPlanes][inPlanes]
+    CLWrapper *transformedFiltersWrapper;
+    int workspaceImages; // how many images the workspace currently holds
+    float *transformedInput; // [alpha * alpha][inPlanes][workspaceImages * numTiles]
+    CLWrapper *transformedInputWrapper;
+    float *transformedOutput; // [alpha * alpha][outPlanes][workspaceImages * numTiles]
+    CLWrapper *transformedOutputWrapper;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    Winograd(EasyCL *cl, int inPlanes, int inputSize, int outPlanes, int pad, int tileSize, bool rotate, bool biased);
+    VIRTUAL ~Winograd();
+    void convolve(int batchSize, CLWrapper *inputWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWrapper, CLWrapper *outputWrapper);
+
+    private:
+    int allocateWorkspace(int batchSize);
+    void freeWorkspace();
+    void run(CLKernel *kernel, int numElements);
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,281 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "conv/WinogradCpu.h"
+#include "conv/CpuGemm.h"
+#include "util/ThreadPool.h"
+#include "util/stringhelper.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#undef STATIC
+#define VIRTUAL
+#define STATIC
+
+namespace {
+    // the transforms, as in Lavin and Gray, "Fast Algorithms for Convolutional Neural Networks"
+    // output tile = AT [(G g GT) .* (BT d B)] A
+    const float BT2[] = {
+        1, 0, -1, 0,
+        0, 1, 1, 0,
+        0, -1, 1, 0,
+        0, 1, 0, -1
+    };
+    const float G2[] = {
+        1, 0, 0,
+        0.5f, 0.5f, 0.5f,
+        0.5f, -0.5f, 0.5f,
+        0, 0, 1
+    };
+    const float AT2[] = {
+        1, 1, 1, 0,
+        0, 1, -1, -1
+    };
+    const float BT4[] = {
+        4, 0, -5, 0, 1, 0,
+        0, -4, -4, 1, 1, 0,
+        0, 4, -4, -1, 1, 0,
+        0, -2, -1, 2, 1, 0,
+        0, 2, -1, -2, 1, 0,
+        0, 4, 0, -5, 0, 1
+    };
+    const float G4[] = {
+        1 / 4.0f, 0, 0,
+        -1 / 6.0f, -1 / 6.0f, -1 / 6.0f,
+        -1 / 6.0f, 1 / 6.0f, -1 / 6.0f,
+        1 / 24.0f, 1 / 12.0f, 1 / 6.0f,
+        1 / 24.0f, -1 / 12.0f, 1 / 6.0f,
+        0, 0, 1
+    };
+    const float AT4[] = {
+        1, 1, 1, 1, 1, 0,
+        0, 1, -1, 2, -2, 0,
+        0, 1, 1, 4, 4, 0,
+        0, 1, -1, 8, -8, 1
+    };
+    // result[rows][rows] = left[rows][inner] * x[inner][inner] * leftT
+    void sandwich(const float *left, int rows, int inner, const float *x, float *result) {
+        float temp[6 * 6];
+        for(int r = 0; r < rows; r++) {
+            for(int j = 0; j < inner; j++) {
+                float sum = 0;
+                for(int i = 0; i < inner; i++) {
+                    sum += left[r * inner + i] * x[i * inner + j];
+                }
+                temp[r * inner + j] = sum;
+            }
+        }
+        for(int r = 0; r < rows; r++) {
+            for(int c = 0; c < rows; c++) {
+                float sum = 0;
+                for(int j = 0; j < inner; j++) {
+                    sum += temp[r * inner + j] * left[c * inner + j];
+                }
+                result[r * rows + c] = sum;
+            }
+        }
+    }
+    class WinogradCpuTask : public ThreadPoolTask {
+    public:
+        WinogradCpu *owner;
+        int numBlocks;
+        int planesPerBlock;
+        const float *input;
+        const float *bias;
+        float *output;
+        virtual void run(int threadId, int taskId) {
+            const int n = taskId / numBlocks;
+            const int outPlaneBegin = (taskId % numBlocks) * planesPerBlock;
+            const int outPlaneEnd = min(owner->outPlanes, outPlaneBegin + planesPerBlock);
+            owner->convolveTask(threadId, n, outPlaneBegin, outPlaneEnd, input, bias, output);
+        }
+    };
+}
+
+PUBLIC STATIC bool WinogradCpu::isSupported(const LayerDimensions &dim) {
+    return dim.filterSize == 3 && dim.skip == 0;
+}
+// 4x4 output tiles, unless the output is so small that most of each tile would be wasted
+PUBLIC STATIC int WinogradCpu::chooseTileSize(int outputSize) {
+    return outputSize >= 8 ? 4 : 2;
+}
+// filter is 3x3, transformed is alpha x alpha
+PUBLIC STATIC void WinogradCpu::transformFilter(int tileSize, const float *filter, float *transformed) {
+    const int alpha = tileSize + 2;
+    const float *G = tileSize == 2 ? G2 : G4;
+    float temp[6 * 3];
+    for(int a = 0; a < alpha; a++) {
+        for(int j = 0; j < 3; j++) {
+            temp[a * 3 + j] = G[a * 3] * filter[j] + G[a * 3 + 1] * filter[3 + j] + G[a * 3 + 2] * filter[6 + j];
+        }
+    }
+    for(int a = 0; a < alpha; a++) {
+        for(int b = 0; b < alpha; b++) {
+            transformed[a * alpha + b] = temp[a * 3] * G[b * 3] + temp[a * 3 + 1] * G[b * 3 + 1] + temp[a * 3 + 2] * G[b * 3 + 2];
+        }
+    }
+}
+// tile and transformed are alpha x alpha
+PUBLIC STATIC void WinogradCpu::transformInputTile(int tileSize, const float *tile, float *transformed) {
+    const int alpha = tileSize + 2;
+    sandwich(tileSize == 2 ? BT2 : BT4, alpha, alpha, tile, transformed);
+}
+// transformed is alpha x alpha, tile is tileSize x tileSize
+PUBLIC STATIC void WinogradCpu::transformOutputTile(int tileSize, const float *transformed, float *tile) {
+    sandwich(tileSize == 2 ? AT2 : AT4, tileSize, tileSize + 2, transformed, tile);
+}
+PUBLIC WinogradCpu::WinogradCpu(int inPlanes, int inputSize, int outPlanes, int pad, int tileSize) :
+        inPlanes(inPlanes),
+        inputSize(inputSize),
+        outPlanes(outPlanes),
+        pad(pad),
+        tileSize(tileSize),
+        alpha(tileSize + 2),
+        outputSize(inputSize + 2 * pad - 2),
+        tilesPerRow((inputSize + 2 * pad - 2 + tileSize - 1) / tileSize),
+        numTiles(tilesPerRow * tilesPerRow),
+        threadPool(ThreadPool::instance()) {
+    if(tileSize != 2 && tileSize != 4) {
+        throw runtime_error("WinogradCpu: tileSize should be 2 or 4, not " + toString(tileSize));
+    }
+    if(outputSize <= 0) {
+        throw runtime_error("WinogradCpu: output size " + toString(outputSize) + " too small");
+    }
+    transformedFilters = new float[alpha * alpha * outPlanes * inPlanes];
+    transformedInputByThread.resize(threadPool->getNumThreads(), 0);
+    transformedOutputByThread.resize(threadPool->getNumThreads(), 0);
+    gemmByThread.resize(threadPool->getNumThreads(), 0);
+}
+PUBLIC WinogradCpu::~WinogradCpu() {
+    delete[] transformedFilters;
+    for(int i = 0; i < (int)gemmByThread.size(); i++) {
+        delete[] transformedInputByThread[i];
+        delete[] transformedOutputByThread[i];
+        delete gemmByThread[i];
+    }
+}
+// weights is [outPlanes][inPlanes][3][3], or, if rotate, [inPlanes][outPlanes][3][3],
+// ie the layer's own filters, for backward, which are then rotated 180 degrees
+PUBLIC void WinogradCpu::setFilters(const float *weights, bool rotate) {
+    float filter[9];
+    float transformed[6 * 6];
+    const int alphaSquared = alpha * alpha;
+    for(int outPlane = 0; outPlane < outPlanes; outPlane++) {
+        for(int inPlane = 0; inPlane < inPlanes; inPlane++) {
+            if(rotate) {
+                const float *source = weights + (inPlane * outPlanes + outPlane) * 9;
+                for(int i = 0; i < 9; i++) {
+                    filter[i] = source[8 - i];
+                }
+            } else {
+                copy(weights + (outPlane * inPlanes + inPlane) * 9, weights + (outPlane * inPlanes + inPlane + 1) * 9, filter);
+            }
+            transformFilter(tileSize, filter, transformed);
+            for(int xi = 0; xi < alphaSquared; xi++) {
+                transformedFilters[(xi * outPlanes + outPlane) * inPlanes + inPlane] = transformed[xi];
+            }
+        }
+    }
+}
+// call setFilters first.  input is [batchSize][inPlanes][inputSize][inputSize], bias is
+// [outPlanes], or 0
+PUBLIC void WinogradCpu::convolve(int batchSize, const float *input, const float *bias, float *output) {
+    StatefulTimer::timeCheck("WinogradCpu::convolve START");
+    // if the batch is smaller than the pool, also split the out planes, like ForwardCpuIm2Col
+    const int numThreads = threadPool->getNumThreads();
+    int numBlocks = 1;
+    if(batchSize < numThreads) {
+        numBlocks = (numThreads + batchSize - 1) / batchSize;
+        numBlocks = max(1, min(numBlocks, outPlanes / 16));
+    }
+    WinogradCpuTask task;
+    task.owner = this;
+    task.numBlocks = numBlocks;
+    task.planesPerBlock = (outPlanes + numBlocks - 1) / numBlocks;
+    task.input = input;
+    task.bias = bias;
+    task.output = output;
+    threadPool->run(batchSize * numBlocks, &task);
+    StatefulTimer::timeCheck("WinogradCpu::convolve END");
+}
+PUBLIC void WinogradCpu::convolveTask(int threadId, int n, int outPlaneBegin, int outPlaneEnd,
+        const float *input, const float *bias, float *output) {
+    if(outPlaneBegin >= outPlaneEnd) {
+        return;
+    }
+    const int alphaSquared = alpha * alpha;
+    const int numBlockPlanes = outPlaneEnd - outPlaneBegin;
+    if(gemmByThread[threadId] == 0) {
+        gemmByThread[threadId] = new CpuGemm();
+        transformedInputByThread[threadId] = new float[alphaSquared * inPlanes * numTiles];
+        transformedOutputByThread[threadId] = new float[alphaSquared * outPlanes * numTiles];
+    }
+    float *transformedInput = transformedInputByThread[threadId];
+    float *transformedOutput = transformedOutputByThread[threadId];
+
+    // transformedInput[xi][inPlane][tile]
+    float tile[6 * 6];
+    float transformed[6 * 6];
+    const float *image = input + (long long)n * inPlanes * inputSize * inputSize;
+    for(int inPlane = 0; inPlane < inPlanes; inPlane++) {
+        const float *inputPlane = image + inPlane * inputSize * inputSize;
+        for(int tileRow = 0; tileRow < tilesPerRow; tileRow++) {
+            for(int tileCol = 0; tileCol < tilesPerRow; tileCol++) {
+                const int row0 = tileRow * tileSize - pad;
+                const int col0 = tileCol * tileSize - pad;
+                for(int i = 0; i < alpha; i++) {
+                    const int row = row0 + i;
+                    for(int j = 0; j < alpha; j++) {
+                        const int col = col0 + j;
+                        const bool inside = row >= 0 && row < inputSize && col >= 0 && col < inputSize;
+                        tile[i * alpha + j] = inside ? inputPlane[row * inputSize + col] : 0.0f;
+                    }
+                }
+                transformInputTile(tileSize, tile, transformed);
+                const int tileIdx = tileRow * tilesPerRow + tileCol;
+                for(int xi = 0; xi < alphaSquared; xi++) {
+                    transformedInput[(xi * inPlanes + inPlane) * numTiles + tileIdx] = transformed[xi];
+                }
+            }
+        }
+    }
+
+    // transformedOutput[xi][outPlane - outPlaneBegin][tile] = sum over inPlane of
+    //     transformedFilters[xi][outPlane][inPlane] * transformedInput[xi][inPlane][tile]
+    for(int xi = 0; xi < alphaSquared; xi++) {
+        gemmByThread[threadId]->sgemm(false, false, numBlockPlanes, numTiles, inPlanes,
+            transformedFilters + (xi * outPlanes + outPlaneBegin) * inPlanes, inPlanes,
+            transformedInput + xi * inPlanes * numTiles, numTiles,
+            0.0f, transformedOutput + xi * numBlockPlanes * numTiles, numTiles);
+    }
+
+    float outputTile[4 * 4];
+    for(int outPlane = outPlaneBegin; outPlane < outPlaneEnd; outPlane++) {
+        float *outputPlane = output + ((long long)n * outPlanes + outPlane) * outputSize * outputSize;
+        const float planeBias = bias != 0 ? bias[outPlane] : 0.0f;
+        for(int tileIdx = 0; tileIdx < numTiles; tileIdx++) {
+            for(int xi = 0; xi < alphaSquared; xi++) {
+                transformed[xi] = transformedOutput[(xi * numBlockPlanes + outPlane - outPlaneBegin) * numTiles + tileIdx];
+            }
+            transformOutputTile(tileSize, transformed, outputTile);
+            const int row0 = (tileIdx / tilesPerRow) * tileSize;
+            const int col0 = (tileIdx % tilesPerRow) * tileSize;
+            const int numRows = min(tileSize, outputSize - row0);
+            const int numCols = min(tileSize, outputSize - col0);
+            for(int i = 0; i < numRows; i++) {
+                for(int j = 0; j < numCols; j++) {
+                    outputPlane[(row0 + i) * outputSize + col0 + j] = outputTile[i * tileSize + j] + planeBias;
+                }
+            }
+        }
+    }
+}
+
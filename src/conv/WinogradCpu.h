@@ -0,0 +1,78 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+#include "conv/LayerDimensions.h"
+
+class CpuGemm;
+class ThreadPool;
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// Winograd F(mxm, 3x3) convolution on the cpu, for 3x3 filters, stride 1
+// output is [outPlanes][outputSize][outputSize], outputSize = inputSize + 2 * pad - 2
+// each mxm output tile comes from an (m+2)x(m+2) input tile: the filters and input
+// tiles are transformed, then, for each of the (m+2)^2 transformed positions, one
+// gemm over the input planes, then each tile is transformed back
+// m is 2, or 4; 4 does fewer multiplies, 2 is a bit more accurate
+// forward is pad 1 or 0, with the layer's filters; backward is the same
+// convolution, of gradOutput, with pad 2 - pad, and the filters rotated 180
+// degrees, and their in and out planes swapped, see setFilters
+// work is spread across the ThreadPool by [image][block of out planes], like ForwardCpuIm2Col
+class DeepCL_EXPORT WinogradCpu {
+    public:
+    const int inPlanes;
+    const int inputSize;
+    const int outPlanes;
+    const int pad;
+    const int tileSize; // m
+    const int alpha; // m + 2
+    const int outputSize;
+    const int tilesPerRow;
+    const int numTiles; // per image
+
+    private:
+    ThreadPool *threadPool;
+    float *transformedFilters; // [alpha * alpha][outPlanes][inPlanes]
+    // per-thread scratch, indexed by threadId, allocated on first use
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    std::vector<float *> transformedInputByThread; // [alpha * alpha][inPlanes][numTiles]
+    std::vector<float *> transformedOutputByThread; // [alpha * alpha][outPlanes][numTiles]
+    std::vector<CpuGemm *> gemmByThread;
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    STATIC bool isSupported(const LayerDimensions &dim);
+    STATIC int chooseTileSize(int outputSize);
+    STATIC void transformFilter(int tileSize, const float *filter, float *transformed);
+    STATIC void transformInputTile(int tileSize, const float *tile, float *transformed);
+    STATIC void transformOutputTile(int tileSize, const float *transformed, float *tile);
+    WinogradCpu(int inPlanes, int inputSize, int outPlanes, int pad, int tileSize);
+    ~WinogradCpu();
+    void setFilters(const float *weights, bool rotate);
+    void convolve(int batchSize, const float *input, const float *bias, float *output);
+    void convolveTask(int threadId, int n, int outPlaneBegin, int outPlaneEnd,
+    const float *input, const float *bias, float *output);
+
+    // [[[end]]]
+};
+
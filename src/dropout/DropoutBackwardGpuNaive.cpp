@@ -113,6 +113,55 @@ DropoutBackwardGpuNaive::DropoutBackwardGpuNaive(EasyCL *cl, int numPlanes, int
     "    output[globalId] = mask[globalId] == 1 ? gradOutput[globalId] : 0.0f;\n"
     "}\n"
     "\n"
+    "\n"
+    "// philox4x32-10 counter-based rng (Salmon et al, 'Parallel random numbers: as easy\n"
+    "// as 1, 2, 3', 2011): each work item turns (its id, batchCounter) into 4 independent\n"
+    "// uints, so masks depend only on (key, batchCounter), not on the device or workgroup size\n"
+    "// mask is 0 (drop) where the uint is below threshold, ie with probability dropRatio\n"
+    "// key0, key1, batchCounter and threshold are really uints, passed as ints\n"
+    "kernel void generateMasks(\n"
+    "        const int N,\n"
+    "        const int key0,\n"
+    "        const int key1,\n"
+    "        const int batchCounter,\n"
+    "        const int threshold,\n"
+    "        global unsigned char *mask) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    const int base = globalId << 2;\n"
+    "    if (base >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    uint c0 = (uint)globalId;\n"
+    "    uint c1 = (uint)batchCounter;\n"
+    "    uint c2 = 0;\n"
+    "    uint c3 = 0;\n"
+    "    uint k0 = (uint)key0;\n"
+    "    uint k1 = (uint)key1;\n"
+    "    for (int round = 0; round < 10; round++) {\n"
+    "        const uint hi0 = mul_hi(0xD2511F53u, c0);\n"
+    "        const uint lo0 = 0xD2511F53u * c0;\n"
+    "        const uint hi1 = mul_hi(0xCD9E8D57u, c2);\n"
+    "        const uint lo1 = 0xCD9E8D57u * c2;\n"
+    "        c0 = hi1 ^ c1 ^ k0;\n"
+    "        c1 = lo1;\n"
+    "        c2 = hi0 ^ c3 ^ k1;\n"
+    "        c3 = lo0;\n"
+    "        k0 += 0x9E3779B9u;\n"
+    "        k1 += 0xBB67AE85u;\n"
+    "    }\n"
+    "    const uint uThreshold = (uint)threshold;\n"
+    "    mask[base] = c0 < uThreshold ? 0 : 1;\n"
+    "    if (base + 1 < N) {\n"
+    "        mask[base + 1] = c1 < uThreshold ? 0 : 1;\n"
+    "    }\n"
+    "    if (base + 2 < N) {\n"
+    "        mask[base + 2] = c2 < uThreshold ? 0 : 1;\n"
+    "    }\n"
+    "    if (base + 3 < N) {\n"
+    "        mask[base + 3] = c3 < uThreshold ? 0 : 1;\n"
+    "    }\n"
+    "}\n"
+    "\n"
     "";
     kernel = cl->buildKernelFromString(kernelSource, "backpropNaive", options, "cl/dropout.cl");
     // [[[end]]]
@@ -12,6 +12,7 @@
 #include "dropout/DropoutMaker.h"
 #include "dropout/DropoutForward.h"
 #include "dropout/DropoutBackward.h"
+#include "dropout/DropoutMaskGenerator.h"
 #include "util/RandomSingleton.h"
 #include "clmath/MultiplyBuffer.h"
 
@@ -31,7 +32,10 @@ DropoutLayer::DropoutLayer(EasyCL *cl, Layer *previousLayer, DropoutMaker *maker
         dropRatio(maker->_dropRatio),
         outputSize(previousLayer->getOutputSize()),
         random(RandomSingleton::instance()),
+        maskGenerator(0),
+        batchCounter(0),
         cl(cl),
+        dropoutBackwardImpl(0),
         masks(0),
         output(0),
         gradInput(0),
@@ -51,23 +55,28 @@ DropoutLayer::DropoutLayer(EasyCL *cl, Layer *previousLayer, DropoutMaker *maker
         throw runtime_error("Error: Dropout layer " + toString(layerIndex) + ": output image size is 0");
     }
     dropoutForwardImpl = DropoutForward::instance(cl, numPlanes, inputSize, dropRatio);
-    dropoutBackwardImpl = DropoutBackward::instance(cl, numPlanes, inputSize, dropRatio);
     multiplyBuffer = new MultiplyBuffer(cl);
+    // an inference-only net never drops out, so needs no masks
+    if(!inferenceOnly) {
+        dropoutBackwardImpl = DropoutBackward::instance(cl, numPlanes, inputSize, dropRatio);
+        maskGenerator = new DropoutMaskGenerator(cl, dropRatio, RandomSingleton::uniformUInt32(), layerIndex);
+    }
 }
 VIRTUAL DropoutLayer::~DropoutLayer() {
+    delete maskGenerator;
     delete multiplyBuffer;
     delete dropoutForwardImpl;
     delete dropoutBackwardImpl;
     if(maskWrapper != 0) {
         delete maskWrapper;
     }
-    if(outputWrapper != 0) {
+    if(outputWrapper != 0 && !outputShared) {
         delete outputWrapper;
     }
     if(masks != 0) {
         delete[] masks;
     }
-    if(output != 0) {
+    if(output != 0 && !outputShared) {
         delete[] output;
     }
     if(gradInputWrapper != 0) {
@@ -80,8 +89,14 @@ VIRTUAL DropoutLayer::~DropoutLayer() {
 VIRTUAL std::string DropoutLayer::getClassName() const {
     return "DropoutLayer";
 }
+// the masks are seeded from random, so reseed from the new one
 VIRTUAL void DropoutLayer::fortesting_setRandomSingleton(RandomSingleton *random) {
     this->random = random;
+    if(inferenceOnly) {
+        return;
+    }
+    delete maskGenerator;
+    maskGenerator = new DropoutMaskGenerator(cl, dropRatio, (unsigned int)(random->_uniform() * 2147483647.0f), layerIndex);
 }
 VIRTUAL void DropoutLayer::setBatchSize(int batchSize) {
 //    cout << "DropoutLayer::setBatchSize" << endl;
@@ -92,13 +107,13 @@ VIRTUAL void DropoutLayer::setBatchSize(int batchSize) {
     if(maskWrapper != 0) {
         delete maskWrapper;
     }
-    if(outputWrapper != 0) {
+    if(outputWrapper != 0 && !outputShared) {
         delete outputWrapper;
     }
     if(masks != 0) {
         delete[] masks;
     }
-    if(output != 0) {
+    if(output != 0 && !outputShared) {
         delete[] output;
     }
     if(gradInputWrapper != 0) {
@@ -109,18 +124,43 @@ VIRTUAL void DropoutLayer::setBatchSize(int batchSize) {
     }
     this->batchSize = batchSize;
     this->allocatedSize = batchSize;
-    masks = new unsigned char[ getOutputNumElements() ];
-    maskWrapper = cl->wrap(getOutputNumElements(), masks);
-    output = new float[ getOutputNumElements() ];
-    outputWrapper = cl->wrap(getOutputNumElements(), output);
-    gradInput = new float[ previousLayer->getOutputNumElements() ];
-    gradInputWrapper = cl->wrap(previousLayer->getOutputNumElements(), gradInput);
-    gradInputWrapper->createOnDevice();
+    if(!outputShared) {
+        output = new float[ getOutputNumElements() ];
+        outputWrapper = cl->wrap(getOutputNumElements(), output);
+    }
+    if(!inferenceOnly) {
+        masks = new unsigned char[ getOutputNumElements() ];
+        maskWrapper = cl->wrap(getOutputNumElements(), masks);
+        maskWrapper->createOnDevice();
+        gradInput = new float[ previousLayer->getOutputNumElements() ];
+        gradInputWrapper = cl->wrap(previousLayer->getOutputNumElements(), gradInput);
+        gradInputWrapper->createOnDevice();
+    }
+}
+VIRTUAL bool DropoutLayer::canShareOutput() const {
+    return true;
+}
+// dropout, and the copy when not training, are element-wise
+VIRTUAL bool DropoutLayer::canForwardInPlace() const {
+    return true;
+}
+VIRTUAL void DropoutLayer::setSharedOutput(float *output, CLWrapper *outputWrapper) {
+    if(!outputShared) {
+        delete this->outputWrapper;
+        delete[] this->output;
+    }
+    this->output = output;
+    this->outputWrapper = outputWrapper;
+    outputShared = output != 0;
+    if(!outputShared) {
+        allocatedSize = 0;
+    }
 }
 VIRTUAL int DropoutLayer::getOutputNumElements() {
     return batchSize * numPlanes * outputSize * outputSize;
 }
 VIRTUAL float *DropoutLayer::getOutput() {
+    checkOutputNotOverwritten();
     if(outputWrapper->isDeviceDirty()) {
         outputWrapper->copyToHost();
 //        outputCopiedToHost = true;
@@ -155,6 +195,7 @@ VIRTUAL bool DropoutLayer::hasOutputWrapper() const {
     return true;
 }
 VIRTUAL CLWrapper *DropoutLayer::getOutputWrapper() {
+    checkOutputNotOverwritten();
     return outputWrapper;
 }
 VIRTUAL float *DropoutLayer::getGradInput() {
@@ -187,11 +228,10 @@ VIRTUAL ActivationFunction const *DropoutLayer::getActivationFunction() {
 //        }
 //    }
 //}
+// straight into maskWrapper, on the device
 VIRTUAL void DropoutLayer::generateMasks() {
-    int totalInputLinearSize = getOutputNumElements();
-    for(int i = 0; i < totalInputLinearSize; i++) {
-        masks[i] = random->_uniform() <= dropRatio ? 0 : 1;
-    }
+    maskGenerator->generate(getOutputNumElements(), batchCounter, maskWrapper);
+    batchCounter++;
 }
 VIRTUAL void DropoutLayer::forward() {
     CLWrapper *upstreamOutputWrapper = 0;
@@ -204,10 +244,9 @@ VIRTUAL void DropoutLayer::forward() {
     }
 
 //    cout << "training: " << training << endl;
-    if(training) {
+    if(training && !inferenceOnly) {
         // create new masks...
         generateMasks();
-        maskWrapper->copyToDevice();
         dropoutForwardImpl->forward(batchSize, maskWrapper, upstreamOutputWrapper, outputWrapper);
     } else {
         // if not training, then simply skip the dropout bit, copy the buffers directly
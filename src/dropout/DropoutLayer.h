@@ -18,6 +18,7 @@ class DropoutBackward;
 class RandomSingleton;
 class DropoutMaker;
 class MultiplyBuffer;
+class DropoutMaskGenerator;
 
 class DropoutLayer : public Layer {
 public:
@@ -28,6 +29,8 @@ public:
     const int outputSize;
 
     RandomSingleton *random;
+    DropoutMaskGenerator *maskGenerator;
+    unsigned int batchCounter; // one per training forward, so each batch gets new masks
 
     EasyCL *const cl; // NOT owned by us
     DropoutForward *dropoutForwardImpl;
@@ -58,6 +61,9 @@ public:
     VIRTUAL std::string getClassName() const;
     VIRTUAL void fortesting_setRandomSingleton(RandomSingleton *random);
     VIRTUAL void setBatchSize(int batchSize);
+    VIRTUAL bool canShareOutput() const;
+    VIRTUAL bool canForwardInPlace() const;
+    VIRTUAL void setSharedOutput(float *output, CLWrapper *outputWrapper);
     VIRTUAL int getOutputNumElements();
     VIRTUAL float *getOutput();
     VIRTUAL bool needsBackProp();
@@ -0,0 +1,208 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+
+#include "EasyCL.h"
+#include "dropout/DropoutMaskGenerator.h"
+#include "util/ThreadPool.h"
+#include "util/StatefulTimer.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+
+namespace {
+    const int chunkSize = 16384; // masks per task, multiple of 4
+
+    class DropoutMaskCpuTask : public ThreadPoolTask {
+    public:
+        int N;
+        unsigned int key0;
+        unsigned int key1;
+        unsigned int batchCounter;
+        unsigned int threshold;
+        unsigned char *masks;
+        virtual void run(int threadId, int taskId) {
+            const int begin = taskId * chunkSize;
+            const int end = min(N, begin + chunkSize);
+            for(int base = begin; base < end; base += 4) {
+                unsigned int counter[4];
+                counter[0] = (unsigned int)(base >> 2);
+                counter[1] = batchCounter;
+                counter[2] = 0;
+                counter[3] = 0;
+                DropoutMaskGenerator::philox4x32(key0, key1, counter);
+                const int count = min(4, end - base);
+                for(int j = 0; j < count; j++) {
+                    masks[base + j] = counter[j] < threshold ? 0 : 1;
+                }
+            }
+        }
+    };
+}
+
+PUBLIC DropoutMaskGenerator::DropoutMaskGenerator(EasyCL *cl, float dropRatio, unsigned int seed, int layerIndex) :
+        cl(cl),
+        key0(seed),
+        key1((unsigned int)layerIndex),
+        threshold(calcThreshold(dropRatio)) {
+}
+// masksWrapper must already exist on the device; its host array is not touched
+PUBLIC void DropoutMaskGenerator::generate(int N, unsigned int batchCounter, CLWrapper *masksWrapper) {
+    StatefulTimer::instance()->timeCheck("DropoutMaskGenerator::generate start");
+    CLKernel *kernel = getKernel();
+    kernel->in(N)->in((int)key0)->in((int)key1)->in((int)batchCounter)->in((int)threshold);
+    kernel->out(masksWrapper);
+    int globalSize = (N + 3) / 4;
+    int workgroupSize = cl->getMaxWorkgroupSize();
+    globalSize = ((globalSize + workgroupSize - 1) / workgroupSize) * workgroupSize;
+    kernel->run_1d(globalSize, workgroupSize);
+    cl->finish();
+    StatefulTimer::instance()->timeCheck("DropoutMaskGenerator::generate end");
+}
+PUBLIC void DropoutMaskGenerator::generateCpu(int N, unsigned int batchCounter, unsigned char *masks) {
+    DropoutMaskCpuTask task;
+    task.N = N;
+    task.key0 = key0;
+    task.key1 = key1;
+    task.batchCounter = batchCounter;
+    task.threshold = threshold;
+    task.masks = masks;
+    ThreadPool::instance()->run((N + chunkSize - 1) / chunkSize, &task);
+}
+// philox4x32-10, in place on counter[4], same as the kernel in cl/dropout.cl
+PUBLIC STATIC void DropoutMaskGenerator::philox4x32(unsigned int key0, unsigned int key1, unsigned int *counter) {
+    unsigned int c0 = counter[0];
+    unsigned int c1 = counter[1];
+    unsigned int c2 = counter[2];
+    unsigned int c3 = counter[3];
+    for(int round = 0; round < 10; round++) {
+        const unsigned long long product0 = (unsigned long long)0xD2511F53u * c0;
+        const unsigned long long product1 = (unsigned long long)0xCD9E8D57u * c2;
+        c0 = (unsigned int)(product1 >> 32) ^ c1 ^ key0;
+        c1 = (unsigned int)product1;
+        c2 = (unsigned int)(product0 >> 32) ^ c3 ^ key1;
+        c3 = (unsigned int)product0;
+        key0 += 0x9E3779B9u;
+        key1 += 0xBB67AE85u;
+    }
+    counter[0] = c0;
+    counter[1] = c1;
+    counter[2] = c2;
+    counter[3] = c3;
+}
+// uints below this are dropped, so that the drop probability is dropRatio
+PUBLIC STATIC unsigned int DropoutMaskGenerator::calcThreshold(float dropRatio) {
+    if(dropRatio <= 0.0f) {
+        return 0;
+    }
+    if(dropRatio >= 1.0f) {
+        return 0xFFFFFFFFu;
+    }
+    return (unsigned int)((double)dropRatio * 4294967296.0);
+}
+PRIVATE CLKernel *DropoutMaskGenerator::getKernel() {
+    const string kernelName = "dropout.generateMasks";
+    if(cl->kernelExists(kernelName)) {
+        return cl->getKernel(kernelName);
+    }
+    string options = "";
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel("kernel", "cl/dropout.cl")
+    // ]]]
+    // generated using cog, from cl/dropout.cl:
+    const char * kernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "kernel void forwardNaive(\n"
+    "        const int N,\n"
+    "        global const unsigned char *mask,\n"
+    "        global const float *input,\n"
+    "        global float *output) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    output[globalId] = mask[globalId] == 1 ? input[globalId] : 0.0f;\n"
+    "}\n"
+    "\n"
+    "kernel void backpropNaive(\n"
+    "        const int N,\n"
+    "        global const unsigned char *mask,\n"
+    "        global const float *gradOutput,\n"
+    "        global float *output) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    output[globalId] = mask[globalId] == 1 ? gradOutput[globalId] : 0.0f;\n"
+    "}\n"
+    "\n"
+    "\n"
+    "// philox4x32-10 counter-based rng (Salmon et al, 'Parallel random numbers: as easy\n"
+    "// as 1, 2, 3', 2011): each work item turns (its id, batchCounter) into 4 independent\n"
+    "// uints, so masks depend only on (key, batchCounter), not on the device or workgroup size\n"
+    "// mask is 0 (drop) where the uint is below threshold, ie with probability dropRatio\n"
+    "// key0, key1, batchCounter and threshold are really uints, passed as ints\n"
+    "kernel void generateMasks(\n"
+    "        const int N,\n"
+    "        const int key0,\n"
+    "        const int key1,\n"
+    "        const int batchCounter,\n"
+    "        const int threshold,\n"
+    "        global unsigned char *mask) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    const int base = globalId << 2;\n"
+    "    if (base >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    uint c0 = (uint)globalId;\n"
+    "    uint c1 = (uint)batchCounter;\n"
+    "    uint c2 = 0;\n"
+    "    uint c3 = 0;\n"
+    "    uint k0 = (uint)key0;\n"
+    "    uint k1 = (uint)key1;\n"
+    "    for (int round = 0; round < 10; round++) {\n"
+    "        const uint hi0 = mul_hi(0xD2511F53u, c0);\n"
+    "        const uint lo0 = 0xD2511F53u * c0;\n"
+    "        const uint hi1 = mul_hi(0xCD9E8D57u, c2);\n"
+    "        const uint lo1 = 0xCD9E8D57u * c2;\n"
+    "        c0 = hi1 ^ c1 ^ k0;\n"
+    "        c1 = lo1;\n"
+    "        c2 = hi0 ^ c3 ^ k1;\n"
+    "        c3 = lo0;\n"
+    "        k0 += 0x9E3779B9u;\n"
+    "        k1 += 0xBB67AE85u;\n"
+    "    }\n"
+    "    const uint uThreshold = (uint)threshold;\n"
+    "    mask[base] = c0 < uThreshold ? 0 : 1;\n"
+    "    if (base + 1 < N) {\n"
+    "        mask[base + 1] = c1 < uThreshold ? 0 : 1;\n"
+    "    }\n"
+    "    if (base + 2 < N) {\n"
+    "        mask[base + 2] = c2 < uThreshold ? 0 : 1;\n"
+    "    }\n"
+    "    if (base + 3 < N) {\n"
+    "        mask[base + 3] = c3 < uThreshold ? 0 : 1;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "";
+    // [[[end]]]
+    CLKernel *kernel = cl->buildKernelFromString(kernelSource, "generateMasks", options, "cl/dropout.cl");
+    cl->storeKernel(kernelName, kernel, true);
+    return kernel;
+}
+
@@ -0,0 +1,48 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+class EasyCL;
+class CLKernel;
+class CLWrapper;
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// dropout masks from the philox4x32-10 counter-based rng, keyed on (seed, layerIndex),
+// with the batch counter as part of the counter, so each mask depends only on those,
+// and can be generated straight into the device buffer, with no host loop or upload
+// generateCpu gives identical masks on the host, spread across the ThreadPool
+// the kernel is built on first use, and shared by all layers on the same EasyCL
+class DeepCL_EXPORT DropoutMaskGenerator {
+    private:
+    EasyCL *cl; // NOT owned by us
+    unsigned int key0;
+    unsigned int key1;
+    unsigned int threshold;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    DropoutMaskGenerator(EasyCL *cl, float dropRatio, unsigned int seed, int layerIndex);
+    void generate(int N, unsigned int batchCounter, CLWrapper *masksWrapper);
+    void generateCpu(int N, unsigned int batchCounter, unsigned char *masks);
+    STATIC void philox4x32(unsigned int key0, unsigned int key1, unsigned int *counter);
+    STATIC unsigned int calcThreshold(float dropRatio);
+
+    private:
+    CLKernel *getKernel();
+
+    // [[[end]]]
+};
+
@@ -26,6 +26,8 @@ FullyConnectedLayer::FullyConnectedLayer(EasyCL *cl, Layer *previousLayer, Fully
                       ->filterSize(previousLayer->getOutputSize())
                         ->biased(maker->_biased)
                         ->weightsInitializer(maker->_weightsInitializer);
+    convolutionalMaker->setInferenceOnly(inferenceOnly);
+    convolutionalMaker->setDeviceWeights(maker->deviceWeights);
     convolutionalLayer = new ConvolutionalLayer(cl, previousLayer, convolutionalMaker);
 //    delete convolutionalMaker;
 }
@@ -80,6 +82,7 @@ VIRTUAL int FullyConnectedLayer::getOutputNumElements() const {
     return convolutionalLayer->getOutputNumElements();
 }
 VIRTUAL float *FullyConnectedLayer::getOutput() {
+    checkOutputNotOverwritten();
     return convolutionalLayer->getOutput();
 }
 VIRTUAL float *FullyConnectedLayer::getGradInput() {
@@ -106,10 +109,18 @@ VIRTUAL bool FullyConnectedLayer::providesGradInputWrapper() const {
 VIRTUAL CLWrapper *FullyConnectedLayer::getGradInputWrapper() {
     return convolutionalLayer->getGradInputWrapper();
 }
+VIRTUAL bool FullyConnectedLayer::canShareOutput() const {
+    return convolutionalLayer->canShareOutput();
+}
+VIRTUAL void FullyConnectedLayer::setSharedOutput(float *output, CLWrapper *outputWrapper) {
+    convolutionalLayer->setSharedOutput(output, outputWrapper);
+    outputShared = convolutionalLayer->outputShared;
+}
 VIRTUAL bool FullyConnectedLayer::hasOutputWrapper() const {
     return convolutionalLayer->hasOutputWrapper();
 }
 VIRTUAL CLWrapper *FullyConnectedLayer::getOutputWrapper() {
+    checkOutputNotOverwritten();
     return convolutionalLayer->getOutputWrapper();
 }
 //VIRTUAL ActivationFunction const*FullyConnectedLayer::getActivationFunction() {
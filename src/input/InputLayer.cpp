@@ -4,6 +4,9 @@
 // v. 2.0. If a copy of the MPL was not distributed with this file, You can 
 // obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <cstring>
+
+#include "EasyCL.h"
 #include "input/InputLayerMaker.h"
 
 #include "input/InputLayer.h"
@@ -20,16 +23,47 @@ InputLayer::InputLayer(InputLayerMaker *maker) :
     outputPlanes(maker->_numPlanes),
     outputSize(maker->_imageSize),
     input(0),
-    output(0) {
+    output(0),
+    outputUpToDate(false),
+    cl(maker->cl),
+    outputWrapper(0),
+    outputWrapperUpToDate(false) {
 }
 VIRTUAL InputLayer::~InputLayer() {
+    if(outputWrapper != 0) {
+        delete outputWrapper;
+    }
+    if(output != 0) {
+        delete[] output;
+    }
 }
 VIRTUAL std::string InputLayer::getClassName() const {
     return "InputLayer";
 }
 VIRTUAL float *InputLayer::getOutput() {
+    if(!outputUpToDate && input != 0) {
+        memcpy(output, input, sizeof(float) * getOutputNumElements());
+        outputUpToDate = true;
+    }
     return output;
 }
+VIRTUAL bool InputLayer::hasOutputWrapper() const {
+    return cl != 0;
+}
+VIRTUAL CLWrapper *InputLayer::getOutputWrapper() {
+    if(!outputWrapperUpToDate && input != 0) {
+        // write from input directly, rather than copying into output, then calling copyToDevice
+        cl_int err = clEnqueueWriteBuffer(*cl->queue, outputWrapper->getBuffer(), CL_TRUE, 0,
+            sizeof(float) * getOutputNumElements(), input, 0, NULL, NULL);
+        EasyCL::checkError(err);
+        outputWrapperUpToDate = true;
+    }
+    return outputWrapper;
+}
+// the images passed to in(), without copying, for layers that just need to read them
+float const*InputLayer::getInput() const {
+    return input;
+}
 VIRTUAL bool InputLayer::needsBackProp() {
     return false;
 }
@@ -37,7 +71,7 @@ VIRTUAL int InputLayer::getPersistSize(int version) const {
     return 0;
 }
 VIRTUAL void InputLayer::printOutput() {
-    if(output == 0) {
+    if(input == 0) {
          return;
     }
     for(int n = 0; n < std::min(5,batchSize); n++) {
@@ -66,9 +100,12 @@ VIRTUAL void InputLayer::printOutput() {
 VIRTUAL void InputLayer::print() {
     printOutput();
 }
+// images must stay valid until the next call to in(), since getOutput() reads from them
  void InputLayer::in(float const*images) {
 //        std::cout << "InputLayer::in()" << std::endl;
     this->input = images;
+    outputUpToDate = false;
+    outputWrapperUpToDate = false;
 //        this->batchStart = batchStart;
 //        this->batchEnd = batchEnd;
 //        print();
@@ -80,20 +117,30 @@ VIRTUAL void InputLayer::setBatchSize(int batchSize) {
 //        std::cout << "inputlayer setting batchsize " << batchSize << std::endl;
     if(batchSize <= allocatedSize) {
         this->batchSize = batchSize;
+        outputUpToDate = false;
+        outputWrapperUpToDate = false;
         return;
     }
+    if(outputWrapper != 0) {
+        delete outputWrapper;
+    }
     if(output != 0) {
         delete[] output;
     }
     this->batchSize = batchSize;
     this->allocatedSize = batchSize;
     output = new float[batchSize * getOutputCubeSize() ];
+    outputUpToDate = false;
+    if(cl != 0) {
+        outputWrapper = cl->wrap(batchSize * getOutputCubeSize(), output);
+        outputWrapper->createOnDevice();
+    }
+    outputWrapperUpToDate = false;
 }
 VIRTUAL void InputLayer::forward() {
-    int totalLinearLength = getOutputNumElements();
-    for(int i = 0; i < totalLinearLength; i++) {
-        output[i] = input[i];
-    }
+    // nothing to do until someone calls getOutput() or getOutputWrapper()
+    outputUpToDate = false;
+    outputWrapperUpToDate = false;
 }
 //VIRTUAL void InputLayer::backward(float learningRate, float const *gradOutput) {
 //}
@@ -13,6 +13,7 @@
 #include "DeepCLDllExport.h"
 
 class InputLayerMaker;
+class CLWrapper;
 
 #define VIRTUAL virtual
 
@@ -26,6 +27,15 @@ public:
 
     float const*input; // we dont own this
     float *output; // we own this :-)
+    // output is only copied from input when someone asks for it, since eg a NormalizationLayer
+    // straight after us reads input directly, and we'd just be making an extra pass for nothing
+    bool outputUpToDate;
+
+    EasyCL *const cl; // NOT owned by us, may be 0, in which case we only provide output on host
+    // uploaded straight from input when the next layer first asks for it, without
+    // going through output on the host
+    CLWrapper *outputWrapper;
+    bool outputWrapperUpToDate;
 
     inline int getOutputIndex(int n, int outPlane, int outRow, int outCol) const {
         return (( n
@@ -34,7 +44,7 @@ public:
             * outputSize + outCol;
     }
     inline float getOutput(int n, int outPlane, int outRow, int outCol) const {
-        return output[ getOutputIndex(n,outPlane, outRow, outCol) ];
+        return input[ getOutputIndex(n,outPlane, outRow, outCol) ];
     }
 
     // [[[cog
@@ -46,6 +56,9 @@ public:
     VIRTUAL ~InputLayer();
     VIRTUAL std::string getClassName() const;
     VIRTUAL float *getOutput();
+    VIRTUAL bool hasOutputWrapper() const;
+    VIRTUAL CLWrapper *getOutputWrapper();
+    float const*getInput() const;
     VIRTUAL bool needsBackProp();
     VIRTUAL int getPersistSize(int version) const;
     VIRTUAL void printOutput();
@@ -12,6 +12,9 @@ PUBLICAPI Layer::Layer(Layer *previousLayer, LayerMaker2 *maker) :
     nextLayer(0),
     layerIndex(previousLayer == 0 ? 0 : previousLayer->layerIndex + 1),
     training(false),
+    inferenceOnly(maker == 0 ? false : maker->inferenceOnly),
+    outputShared(false),
+    outputOverwritten(false),
     maker(maker)
      {
     if(previousLayer != 0) {
@@ -79,6 +82,36 @@ PUBLICAPI VIRTUAL int Layer::getOutputSize() const {
 VIRTUAL void Layer::forward() {
     throw std::runtime_error("forward not implemented for " + getClassName());
 }
+/// \brief Can our output live in a buffer the net shares between layers, see setSharedOutput
+VIRTUAL bool Layer::canShareOutput() const {
+    return false;
+}
+/// \brief Can our output overwrite our input, ie is forward element-wise
+VIRTUAL bool Layer::canForwardInPlace() const {
+    return false;
+}
+/// \brief Is our output just the previous layer's output, eg for loss layers
+VIRTUAL bool Layer::aliasesPreviousOutput() const {
+    return false;
+}
+/// \brief Write our output to output, and outputWrapper, which belong to the net, and are at least as big as our output
+///
+/// Used by NeuralNet::setShareActivations; 0, 0 goes back to our own output, allocated by
+/// the next setBatchSize
+VIRTUAL void Layer::setSharedOutput(float *output, CLWrapper *outputWrapper) {
+    throw std::runtime_error("setSharedOutput not implemented for " + getClassName());
+}
+/// \brief Throws if our shared output has been overwritten by a later layer, since forward
+///
+/// For getOutput and getOutputWrapper of layers that can share their output, so that reading
+/// an intermediate output with NeuralNet::setShareActivations fails, rather than returning
+/// another layer's values
+void Layer::checkOutputNotOverwritten() const {
+    if(outputOverwritten) {
+        throw std::runtime_error("output of layer " + toString(layerIndex) + ", " + getClassName()
+            + ", has been overwritten by a later layer, since the net shares activations; call setShareActivations(false) to keep every layer's output");
+    }
+}
 VIRTUAL bool Layer::needsBackProp() {
     throw std::runtime_error("needsBackProp not implemented for " + getClassName());
 }
@@ -31,6 +31,9 @@ public:
     Layer *nextLayer;
     const int layerIndex;
     bool training;
+    const bool inferenceOnly; // no gradients, gradInput, or backward kernels, see NeuralNet::setInferenceOnly
+    bool outputShared; // output belongs to the net, and is shared with other layers, see NeuralNet::setShareActivations
+    bool outputOverwritten; // shared output since written by a later layer, in the last forward
 
     LayerMaker2 *maker;
 
@@ -67,6 +70,11 @@ public:
     PUBLICAPI VIRTUAL int getOutputPlanes() const;
     PUBLICAPI VIRTUAL int getOutputSize() const;
     VIRTUAL void forward();
+    VIRTUAL bool canShareOutput() const;
+    VIRTUAL bool canForwardInPlace() const;
+    VIRTUAL bool aliasesPreviousOutput() const;
+    VIRTUAL void setSharedOutput(float *output, CLWrapper *outputWrapper);
+    void checkOutputNotOverwritten() const;
     VIRTUAL bool needsBackProp();
     VIRTUAL void print();
     VIRTUAL void initWeights(float const*weights);
@@ -33,13 +33,23 @@ class SoftMaxLayer;
 class DeepCL_EXPORT LayerMaker2 {
 public:
     EasyCL *cl; // NOT owned by us
+    bool inferenceOnly; // set from the net, see NeuralNet::setInferenceOnly
+    int deviceWeights; // set from the net, see NeuralNet::setDeviceWeights; 0 is WeightsPersister::DTYPE_FLOAT32
     LayerMaker2() :
-        cl(0) {
+        cl(0),
+        inferenceOnly(false),
+        deviceWeights(0) {
     }
     virtual ~LayerMaker2() {}
     void setCl(EasyCL *cl) {
         this->cl = cl;
     }
+    void setInferenceOnly(bool inferenceOnly) {
+        this->inferenceOnly = inferenceOnly;
+    }
+    void setDeviceWeights(int deviceWeights) {
+        this->deviceWeights = deviceWeights;
+    }
     virtual Layer *createLayer(Layer *previousLayer) = 0;
 
     // see http://stackoverflow.com/questions/5148706/copying-a-polymorphic-object-in-c/5148751#5148751
@@ -6,11 +6,8 @@
 
 #include <iostream>
 
-#include "loaders/NorbLoader.h"
-#include "util/FileHelper.h"
-#include "Kgsv2Loader.h"
+#include "loaders/MappedDataset.h"
 #include "util/StatefulTimer.h"
-#include "loaders/MnistLoader.h"
 #include "DeepCLDllExport.h"
 #include "loaders/GenericLoader.h"
 
@@ -28,34 +25,21 @@ using namespace std;
 PUBLIC PUBLICAPI STATIC void GenericLoader::getDimensions(const char * trainFilepath, int *p_numExamples, int *p_numPlanes, int *p_imageSize) {
     cout << "GenericLoader::getDimensions" << endl;
     cout << "trainFilepath: " << trainFilepath << endl;
-    char *headerBytes = FileHelper::readBinaryChunk(trainFilepath, 0, 1024);
-    char type[1025];
-    strncpy(type, headerBytes, 4);
-    type[4] = 0;
-    unsigned int *headerInts = reinterpret_cast< unsigned int *>(headerBytes);
-
-    if(string(type) == "mlv2") {
-//        cout << "Loading as a Kgsv2 file" << endl;
-        Kgsv2Loader::getDimensions(trainFilepath, p_numExamples, p_numPlanes, p_imageSize);
-    } else if(headerInts[0] == 0x1e3d4c55) {
-//        cout << "Loading as a Norb mat file" << endl;
-        NorbLoader::getDimensions(trainFilepath, p_numExamples, p_numPlanes, p_imageSize);
-    } else if(headerInts[0] == 0x03080000) {
-        MnistLoader::getDimensions(trainFilepath, p_numExamples, p_numPlanes, p_imageSize);
-    } else {
-        cout << "headstring" << type << endl;
-        throw runtime_error(string("Filetype of ") + trainFilepath + " not recognised");
-    }
+    MappedDataset dataset(trainFilepath);
+    *p_numExamples = dataset.getN();
+    *p_numPlanes = dataset.getPlanes();
+    *p_imageSize = dataset.getImageSize();
 }
 
 PUBLIC PUBLICAPI STATIC void GenericLoader::load(const char * imagesFilePath, float *images, int *labels, int startN, int numExamples) {
 //    cout << "GenericLoader::load " << numExamples << endl;
     cout << "GenericLoader::load " << endl;
     cout << imagesFilePath << endl;
-    int N, planes, size;
-    getDimensions(imagesFilePath, &N, &planes, &size);
+    MappedDataset dataset(imagesFilePath);
+    int planes = dataset.getPlanes();
+    int size = dataset.getImageSize();
     unsigned char *ucImages = new unsigned char[ numExamples * planes * size * size ];
-    load(imagesFilePath, ucImages, labels, startN, numExamples);
+    dataset.load(ucImages, labels, startN, numExamples);
     int linearSize =  numExamples * planes * size * size;
 
     for(int i = 0; i < linearSize; i++) {
@@ -68,27 +52,12 @@ PUBLIC STATIC void GenericLoader::load(const char * trainFilepath, unsigned char
     load(trainFilepath, images, labels, 0, 0);
 }
 // for now, if pass in 0 for labels, it wont read labels
+// if you are going to call this repeatedly on the same file, you can save reopening
+// the file, and reparsing the header, each time, by keeping a MappedDataset yourself
 PUBLIC STATIC void GenericLoader::load(const char * trainFilepath, unsigned char *images, int *labels, int startN, int numExamples) {
     StatefulTimer::timeCheck("GenericLoader::load start");
-    char *headerBytes = FileHelper::readBinaryChunk(trainFilepath, 0, 1024);
-    char type[1025];
-    strncpy(type, headerBytes, 4);
-    type[4] = 0;
-    unsigned int *headerInts = reinterpret_cast< unsigned int *>(headerBytes);
-
-    if(string(type) == "mlv2") {
-//        cout << "Loading as a Kgsv2 file" << endl;
-        Kgsv2Loader::load(trainFilepath, images, labels, startN, numExamples);
-    } else if(headerInts[0] == 0x1e3d4c55) {
-//        cout << "Loading as a Norb mat file" << endl;
-        NorbLoader::load(trainFilepath, images, labels, startN, numExamples);
-    } else if(headerInts[0] == 0x03080000) {
-        MnistLoader::load(trainFilepath, images, labels, startN, numExamples);
-    } else {
-        cout << "headstring" << type << endl;
-        throw runtime_error(string("Filetype of ") + trainFilepath + " not recognised");
-    }
+    MappedDataset dataset(trainFilepath);
+    dataset.load(images, labels, startN, numExamples);
     StatefulTimer::timeCheck("GenericLoader::load end");
 }
 
-
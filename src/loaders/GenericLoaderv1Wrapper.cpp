@@ -8,8 +8,9 @@
 
 #include "DeepCLDllExport.h"
 
-#include "loaders/GenericLoader.h"
+#include "loaders/MappedDataset.h"
 #include "loaders/GenericLoaderv1Wrapper.h"
+#include "util/StatefulTimer.h"
 
 using namespace std;
 
@@ -32,12 +33,20 @@ PUBLIC VIRTUAL int GenericLoaderv1Wrapper::getImageSize() {
 }
 PUBLIC GenericLoaderv1Wrapper::GenericLoaderv1Wrapper(std::string imagesFilepath) {
     this->imagesFilepath = imagesFilepath;
-    GenericLoader::getDimensions(imagesFilepath.c_str(), &N, &planes, &size);
+    dataset = new MappedDataset(imagesFilepath);
+    N = dataset->getN();
+    planes = dataset->getPlanes();
+    size = dataset->getImageSize();
+}
+PUBLIC VIRTUAL GenericLoaderv1Wrapper::~GenericLoaderv1Wrapper() {
+    delete dataset;
 }
 PUBLIC VIRTUAL int GenericLoaderv1Wrapper::getImageCubeSize() {
     return planes * size * size;
 }
 PUBLIC VIRTUAL void GenericLoaderv1Wrapper::load(unsigned char *data, int *labels, int startRecord, int numRecords) {
-    GenericLoader::load(imagesFilepath.c_str(), data, labels, startRecord, numRecords);
+    StatefulTimer::timeCheck("GenericLoaderv1Wrapper::load start");
+    dataset->load(data, labels, startRecord, numRecords);
+    StatefulTimer::timeCheck("GenericLoaderv1Wrapper::load end");
 }
 
@@ -13,6 +13,8 @@
 
 #include "loaders/Loader.h"
 
+class MappedDataset;
+
 #define VIRTUAL virtual
 #define STATIC static
 
@@ -26,6 +28,7 @@ class GenericLoaderv1Wrapper : public Loader {
     int N;
     int planes;
     int size;
+    MappedDataset *dataset; // header parsed once, then loads read straight from the mapping
 
     // [[[cog
     // import cog_addheaders
@@ -39,6 +42,7 @@ class GenericLoaderv1Wrapper : public Loader {
     VIRTUAL int getPlanes();
     VIRTUAL int getImageSize();
     GenericLoaderv1Wrapper(std::string imagesFilepath);
+    VIRTUAL ~GenericLoaderv1Wrapper();
     VIRTUAL int getImageCubeSize();
     VIRTUAL void load(unsigned char *data, int *labels, int startRecord, int numRecords);
 
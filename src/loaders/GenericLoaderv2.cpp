@@ -11,6 +11,7 @@
 #include "loaders/Loader.h"
 #include "loaders/GenericLoaderv1Wrapper.h"
 #include "loaders/GenericLoaderv2.h"
+#include "normalize/NormalizationHelper.h"
 
 #ifdef LIBJPEG_FOUND
 #include "loaders/ManifestLoaderv1.h"
@@ -27,7 +28,9 @@ using namespace std;
 #define STATIC
 #define VIRTUAL
 
-PUBLIC GenericLoaderv2::GenericLoaderv2(std::string imagesFilepath) {
+PUBLIC GenericLoaderv2::GenericLoaderv2(std::string imagesFilepath) :
+        byteBuffer(0),
+        byteBufferSize(0) {
     loader = 0;
     #ifdef LIBJPEG_FOUND
     if(ManifestLoaderv1::isFormatFor(imagesFilepath) ) {
@@ -39,16 +42,29 @@ PUBLIC GenericLoaderv2::GenericLoaderv2(std::string imagesFilepath) {
     }
 }
 
+PUBLIC GenericLoaderv2::~GenericLoaderv2() {
+    delete loader;
+    delete[] byteBuffer;
+}
 PUBLIC void GenericLoaderv2::load(float *images, int *labels, int startN, int numExamples) {
-    int linearSize =  numExamples * loader->getImageCubeSize();
-    unsigned char *ucImages = new unsigned char[ linearSize ];
+    load(images, labels, startN, numExamples, 0.0f, 1.0f);
+}
+// loads the raw bytes, then converts them to float, applying (value + translate) * scale
+// on the way, in one pass, so you can skip a separate normalization pass afterwards
+PUBLIC void GenericLoaderv2::load(float *images, int *labels, int startN, int numExamples, float translate, float scale) {
+    if(numExamples == 0) {
+        numExamples = loader->getN() - startN;
+    }
+    long long linearSize = (long long)numExamples * loader->getImageCubeSize();
+    if(linearSize > byteBufferSize) {
+        delete[] byteBuffer;
+        byteBuffer = new unsigned char[ linearSize ];
+        byteBufferSize = linearSize;
+    }
 
-    load(ucImages, labels, startN, numExamples);
+    load(byteBuffer, labels, startN, numExamples);
 
-    for(int i = 0; i < linearSize; i++) {
-        images[i] = ucImages[i];
-    }
-    delete[] ucImages;
+    NormalizationHelper::translateAndScale(byteBuffer, (int)linearSize, translate, scale, images);
 }
 PUBLIC int GenericLoaderv2::getN() {
     return loader->getN();
@@ -21,9 +21,15 @@ class Loader;
 // v1 loaders were stateless, all static functions
 // but for imagenet manifest, we dont really want to load the manifest every single
 // file read, so we make it stateful, hence GenericLoaderv2
+// not reentrant: load(float *...) reuses byteBuffer, so use one loader per thread;
+// OnDemandBatcherv2 only calls its loader from its prefetch thread, and train uses
+// separate loaders for training and validation
 class DeepCL_EXPORT GenericLoaderv2 {
     private:
     Loader *loader;
+    // raw bytes for load(float *...), reused between calls, grown as needed
+    unsigned char *byteBuffer;
+    long long byteBufferSize;
 
     // [[[cog
     // import cog_addheaders
@@ -33,7 +39,9 @@ class DeepCL_EXPORT GenericLoaderv2 {
 
     public:
     GenericLoaderv2(std::string imagesFilepath);
+    ~GenericLoaderv2();
     void load(float *images, int *labels, int startN, int numExamples);
+    void load(float *images, int *labels, int startN, int numExamples, float translate, float scale);
     int getN();
     int getPlanes();
     int getImageSize();
@@ -8,9 +8,11 @@
 #include <string>
 #include <vector>
 #include <stdexcept>
+#include <cstring>
 
 #include "util/FileHelper.h"
 #include "util/stringhelper.h"
+#include "util/MappedFile.h"
 
 #include "Kgsv2Loader.h"
 
@@ -23,8 +25,18 @@ using namespace std;
 
 STATIC void Kgsv2Loader::getDimensions(std::string filepath, int *p_N, int *p_numPlanes, int *p_imageSize) {
     char *headerBytes = FileHelper::readBinaryChunk(filepath, 0, 1024);
-    headerBytes[1023] = 0;
-    string headerString = string(headerBytes);
+    try {
+        parseHeader(filepath, headerBytes, p_N, p_numPlanes, p_imageSize);
+    } catch(runtime_error &e) {
+        delete[] headerBytes;
+        throw;
+    }
+    delete[] headerBytes;
+}
+// headerBytes is the first 1024 bytes of the file
+STATIC void Kgsv2Loader::parseHeader(std::string filepath, const char *headerBytes, int *p_N, int *p_numPlanes, int *p_imageSize) {
+    string headerString = string(headerBytes, 1023);
+    headerString = headerString.substr(0, headerString.find('\0'));
     vector<string> splitHeader = split(headerString, "-");
     if(splitHeader[0] != "mlv2") {
         throw runtime_error("file " + filepath + " is not an mlv2 (kgsgo) data file");
@@ -58,24 +70,33 @@ STATIC void Kgsv2Loader::load(std::string filepath, unsigned char *data, int *la
 }
 
 STATIC void Kgsv2Loader::load(std::string filepath, unsigned char *data, int *labels, int startRecord, int numRecords) {
+    // reads straight out of the mapping, rather than copying the chunk into a temporary buffer first
+    MappedFile file(filepath);
     int N;
     int imageSize;
     int numPlanes;
-//    int imagesSize;
-    getDimensions(filepath, &N, &numPlanes, &imageSize);
+    char headerBytes[1024];
+    memcpy(headerBytes, file.getData(0, 1024), 1024);
+    parseHeader(filepath, headerBytes, &N, &numPlanes, &imageSize);
     if(numRecords == 0) {
         numRecords = N - startRecord;
     }
-    const int imageSizeSquared = imageSize * imageSize;
-    const long recordSize = getRecordSize(numPlanes, imageSize);
-    long pos = (long)startRecord * recordSize + 1024 /* for header */;
-    long chunkByteSize = (long)numRecords * recordSize;
+    const long long recordSize = getRecordSize(numPlanes, imageSize);
+    long long pos = (long long)startRecord * recordSize + 1024 /* for header */;
+    long long chunkByteSize = (long long)numRecords * recordSize;
 //    cout << "chunkByteSize: " << chunkByteSize << endl;
-    unsigned char *kgsData = reinterpret_cast<unsigned char *>(FileHelper::readBinaryChunk(filepath, pos, chunkByteSize) );
+    unpackRecords(file.getData(pos, chunkByteSize), numPlanes, imageSize, numRecords, data, labels);
+//    return numRecords;
+}
+// kgsData points at the first of numRecords packed records; each plane is unpacked
+// to one byte per pixel, 0 or 255, in data
+STATIC void Kgsv2Loader::unpackRecords(const unsigned char *kgsData, int numPlanes, int imageSize, int numRecords, unsigned char *data, int *labels) {
+    const int imageSizeSquared = imageSize * imageSize;
+    const long long recordSize = getRecordSize(numPlanes, imageSize);
     for(int n = 0; n < numRecords; n++) {
-        long recordOffset = (long)n * recordSize;
+        long long recordOffset = (long long)n * recordSize;
 //        cout << "recordOffset: " << recordOffset << endl;
-        unsigned char *record = kgsData + recordOffset;
+        const unsigned char *record = kgsData + recordOffset;
         if(record[ 0 ] != 'G') {
             throw std::runtime_error("alignment error, for record " + toString(n));
         }
@@ -83,19 +104,19 @@ STATIC void Kgsv2Loader::load(std::string filepath, unsigned char *data, int *la
             throw std::runtime_error("alignment error, for record " + toString(n));
         }
         if(labels != 0) {
-            int *p_label = reinterpret_cast< int * >(record + 2);
-            int label = p_label[0];
+            int label;
+            memcpy(&label, record + 2, sizeof(int));
             labels[n] = label;
             if(label < 0) {
-                throw runtime_error("Error: label " + toString(labels) + " is negative");
+                throw runtime_error("Error: label " + toString(label) + " is negative");
             }
         }
-        unsigned char *recordImage = record + 6;
+        const unsigned char *recordImage = record + 6;
         int bitPos = 0;
         int intraRecordPos = 0;
         unsigned char thisrecordbyte = recordImage[ intraRecordPos ];
         for(int plane = 0; plane < numPlanes; plane++) {
-            unsigned char *dataPlane = data + ((long)n * numPlanes + plane) * imageSizeSquared;
+            unsigned char *dataPlane = data + ((long long)n * numPlanes + plane) * imageSizeSquared;
             for(int intraImagePos = 0; intraImagePos < imageSizeSquared; intraImagePos++) {
                 unsigned char thisbyte = (thisrecordbyte >> (7 - bitPos) ) & 1;
 //                cout << "thisbyte: " << (int)thisbyte << endl;
@@ -104,13 +125,14 @@ STATIC void Kgsv2Loader::load(std::string filepath, unsigned char *data, int *la
                 if(bitPos == 8) {
                     bitPos = 0;
                     intraRecordPos++;
-                    thisrecordbyte = recordImage[ intraRecordPos ];
+                    // dont read past the end of the last record
+                    if(intraRecordPos < recordSize - 6) {
+                        thisrecordbyte = recordImage[ intraRecordPos ];
+                    }
                 }
             }
         }
     }
-    delete[] kgsData;
-//    return numRecords;
 }
 
 //STATIC int Kgsv2Loader::loadKgs(std::string filepath, int *p_numPlanes, int *p_imageSize, unsigned char *data, int *labels, int recordStart, int numRecords) {
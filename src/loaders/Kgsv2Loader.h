@@ -22,8 +22,10 @@ public:
     // ]]]
     // generated, using cog:
     STATIC void getDimensions(std::string filepath, int *p_N, int *p_numPlanes, int *p_imageSize);
+    STATIC void parseHeader(std::string filepath, const char *headerBytes, int *p_N, int *p_numPlanes, int *p_imageSize);
     STATIC void load(std::string filepath, unsigned char *data, int *labels);
     STATIC void load(std::string filepath, unsigned char *data, int *labels, int startRecord, int numRecords);
+    STATIC void unpackRecords(const unsigned char *kgsData, int numPlanes, int imageSize, int numRecords, unsigned char *data, int *labels);
     STATIC int getRecordSize(int numPlanes, int imageSize);
 
     // [[[end]]]
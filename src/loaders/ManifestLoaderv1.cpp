@@ -13,7 +13,8 @@
 #include "util/FileHelper.h"
 #include "util/stringhelper.h"
 #include "ManifestLoaderv1.h"
-#include "util/JpegHelper.h"
+#include "util/JpegDecoder.h"
+#include "util/ThreadPool.h"
 
 #include "DeepCLDllExport.h"
 
@@ -24,6 +25,23 @@ using namespace std;
 #define STATIC
 #define VIRTUAL
 
+namespace {
+    // each task decodes a contiguous run of records, into its own slice of data
+    class ManifestLoaderv1DecodeTask : public ThreadPoolTask {
+    public:
+        ManifestLoaderv1 *owner;
+        unsigned char *data;
+        int startRecord;
+        int numRecords;
+        int recordsPerTask;
+        virtual void run(int threadId, int taskId) {
+            const int localBegin = taskId * recordsPerTask;
+            const int localEnd = min(numRecords, localBegin + recordsPerTask);
+            owner->decodeTask(threadId, data, startRecord, localBegin, localEnd);
+        }
+    };
+}
+
 PUBLIC STATIC bool ManifestLoaderv1::isFormatFor(std::string imagesFilepath) {
     cout << "ManifestLoaderv1 checking format for " << imagesFilepath << endl;
     char *headerBytes = FileHelper::readBinaryChunk(imagesFilepath, 0, 1024);
@@ -33,12 +51,36 @@ PUBLIC STATIC bool ManifestLoaderv1::isFormatFor(std::string imagesFilepath) {
     cout << "matched: " << matched << endl;
     return matched;
 }
-PUBLIC ManifestLoaderv1::ManifestLoaderv1(std::string imagesFilepath) {
+PUBLIC ManifestLoaderv1::ManifestLoaderv1(std::string imagesFilepath) :
+        numThreads(ThreadPool::getDefaultNumThreads()),
+        threadPool(0) {
     init(imagesFilepath, true);    
 }
-PUBLIC ManifestLoaderv1::ManifestLoaderv1(std::string imagesFilepath, bool includeLabels) {
+PUBLIC ManifestLoaderv1::ManifestLoaderv1(std::string imagesFilepath, bool includeLabels) :
+        numThreads(ThreadPool::getDefaultNumThreads()),
+        threadPool(0) {
     init(imagesFilepath, includeLabels);
 }
+PUBLIC VIRTUAL ManifestLoaderv1::~ManifestLoaderv1() {
+    delete threadPool;
+    for(int i = 0; i < (int)decoderByThread.size(); i++) {
+        delete decoderByThread[i];
+    }
+    delete[] files;
+    delete[] labels;
+}
+// takes effect from the next load()
+PUBLIC void ManifestLoaderv1::setNumThreads(int numThreads) {
+    if(numThreads < 1) {
+        throw runtime_error("ManifestLoaderv1: numThreads must be at least 1, but was " + toString(numThreads));
+    }
+    if(numThreads == this->numThreads) {
+        return;
+    }
+    this->numThreads = numThreads;
+    delete threadPool;
+    threadPool = 0;
+}
 PRIVATE void ManifestLoaderv1::init(std::string imagesFilepath, bool includeLabels) {
     this->includeLabels = includeLabels;
     this->imagesFilepath = imagesFilepath;
@@ -125,17 +167,37 @@ int ManifestLoaderv1::readIntValue(std::vector< std::string > splitLine, std::st
     throw runtime_error("Key " + key + " not found in file header");
 }
 PUBLIC VIRTUAL void ManifestLoaderv1::load(unsigned char *data, int *labels, int startRecord, int numRecords) {
-    int imageCubeSize = planes * size * size;
-//    cout << "ManifestLoaderv1, loading " << numRecords << " jpegs" << endl;
-    for(int localN = 0; localN < numRecords; localN++) {
-        int globalN = localN + startRecord;
-        JpegHelper::read(files[globalN], planes, size, size, data + localN * imageCubeSize);
-        if(labels != 0) {
-            if(!includeLabels) {
-                throw runtime_error("ManifestLoaderv1: labels reqested in load() method, but not activated in constructor");
-            }
-            labels[localN] = this->labels[globalN];
+    if(labels != 0) {
+        if(!includeLabels) {
+            throw runtime_error("ManifestLoaderv1: labels reqested in load() method, but not activated in constructor");
         }
+        for(int localN = 0; localN < numRecords; localN++) {
+            labels[localN] = this->labels[localN + startRecord];
+        }
+    }
+    if(threadPool == 0) {
+        threadPool = new ThreadPool(numThreads);
+        decoderByThread.resize(max((int)decoderByThread.size(), threadPool->getNumThreads()), 0);
+    }
+//    cout << "ManifestLoaderv1, loading " << numRecords << " jpegs" << endl;
+    // a few tasks per thread, so a thread that gets some slow files doesnt hold everyone up
+    const int numTasks = min(numRecords, threadPool->getNumThreads() * 4);
+    ManifestLoaderv1DecodeTask task;
+    task.owner = this;
+    task.data = data;
+    task.startRecord = startRecord;
+    task.numRecords = numRecords;
+    task.recordsPerTask = numTasks > 0 ? (numRecords + numTasks - 1) / numTasks : 0;
+    threadPool->run(numTasks, &task);
+}
+PUBLIC void ManifestLoaderv1::decodeTask(int threadId, unsigned char *data, int startRecord, int localBegin, int localEnd) {
+    if(decoderByThread[threadId] == 0) {
+        decoderByThread[threadId] = new JpegDecoder();
+    }
+    JpegDecoder *decoder = decoderByThread[threadId];
+    const int imageCubeSize = planes * size * size;
+    for(int localN = localBegin; localN < localEnd; localN++) {
+        decoder->read(files[startRecord + localN], planes, size, size, data + localN * imageCubeSize);
     }
 }
 
@@ -10,12 +10,20 @@
 #include <string>
 #include <iostream>
 #include <algorithm>
+#include <vector>
 
 #include "loaders/Loader.h"
 
+class JpegDecoder;
+class ThreadPool;
+
 #define VIRTUAL virtual
 #define STATIC static
 
+// jpegs are decoded in parallel, by a ThreadPool owned by this loader, so that
+// decoding doesnt compete with the cpu conv implementations for the shared pool
+// number of decode threads defaults to ThreadPool::getDefaultNumThreads(), or
+// can be changed with setNumThreads
 class ManifestLoaderv1 : public Loader {
     private:
     bool includeLabels;
@@ -27,6 +35,17 @@ class ManifestLoaderv1 : public Loader {
     std::string *files;
     int *labels;
 
+    int numThreads;
+    ThreadPool *threadPool; // created on first load()
+    // one per thread, indexed by threadId, created on first use
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    std::vector<JpegDecoder *> decoderByThread;
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
     // [[[cog
     // import cog_addheaders
     // cog_addheaders.addv2()
@@ -37,12 +56,15 @@ class ManifestLoaderv1 : public Loader {
     STATIC bool isFormatFor(std::string imagesFilepath);
     ManifestLoaderv1(std::string imagesFilepath);
     ManifestLoaderv1(std::string imagesFilepath, bool includeLabels);
+    VIRTUAL ~ManifestLoaderv1();
+    void setNumThreads(int numThreads);
     VIRTUAL std::string getType();
     VIRTUAL int getImageCubeSize();
     VIRTUAL int getN();
     VIRTUAL int getPlanes();
     VIRTUAL int getImageSize();
     VIRTUAL void load(unsigned char *data, int *labels, int startRecord, int numRecords);
+    void decodeTask(int threadId, unsigned char *data, int startRecord, int localBegin, int localEnd);
 
     private:
     void init(std::string imagesFilepath, bool includeLabels);
@@ -0,0 +1,172 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstring>
+#include <stdexcept>
+
+#include "util/MappedFile.h"
+#include "util/stringhelper.h"
+#include "loaders/Kgsv2Loader.h"
+#include "loaders/MnistLoader.h"
+#include "loaders/MappedDataset.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+const int MappedDataset::MNIST;
+const int MappedDataset::NORB;
+const int MappedDataset::MLV2;
+
+PUBLIC MappedDataset::MappedDataset(std::string imagesFilepath) :
+        imagesFilepath(imagesFilepath),
+        imagesFile(0),
+        labelsFile(0) {
+    imagesFile = new MappedFile(imagesFilepath);
+    try {
+        const unsigned char *header = imagesFile->getData(0, 4);
+        unsigned int magic;
+        memcpy(&magic, header, 4);
+        if(string((const char *)header, 4) == "mlv2") {
+            format = MLV2;
+            char headerBytes[1024];
+            memcpy(headerBytes, imagesFile->getData(0, 1024), 1024);
+            Kgsv2Loader::parseHeader(imagesFilepath, headerBytes, &N, &numPlanes, &imageSize);
+            headerSize = 1024;
+            recordSize = Kgsv2Loader::getRecordSize(numPlanes, imageSize);
+        } else if(magic == 0x1e3d4c55) {
+            format = NORB;
+            unsigned int headerValues[6];
+            memcpy(headerValues, imagesFile->getData(0, 6 * 4), 6 * 4);
+            N = headerValues[2];
+            numPlanes = headerValues[3];
+            imageSize = headerValues[4];
+            if((int)headerValues[5] != imageSize) {
+                throw runtime_error("Error, didnt match: imageSize " + toString(imageSize) + " != " + toString(headerValues[5]));
+            }
+            headerSize = 6 * 4;
+            recordSize = (long long)numPlanes * imageSize * imageSize;
+        } else if(magic == 0x03080000) {
+            format = MNIST;
+            unsigned char headerValues[4 * 4];
+            memcpy(headerValues, imagesFile->getData(0, 4 * 4), 4 * 4);
+            N = MnistLoader::readUInt(headerValues, 1);
+            numPlanes = 1;
+            imageSize = MnistLoader::readUInt(headerValues, 2);
+            if(MnistLoader::readUInt(headerValues, 3) != imageSize) {
+                throw runtime_error("error reading mnist-format file " + imagesFilepath + ": height and width not equal.  We only support square images currently.");
+            }
+            headerSize = 4 * 4;
+            recordSize = (long long)imageSize * imageSize;
+        } else {
+            throw runtime_error(string("Filetype of ") + imagesFilepath + " not recognised");
+        }
+        // catch truncated files now, rather than part way through an epoch
+        imagesFile->getData(headerSize, (long long)N * recordSize);
+    } catch(runtime_error &e) {
+        delete imagesFile;
+        throw;
+    }
+    imagesFile->adviseSequential();
+}
+PUBLIC MappedDataset::~MappedDataset() {
+    delete labelsFile;
+    delete imagesFile;
+}
+PUBLIC int MappedDataset::getFormat() {
+    return format;
+}
+PUBLIC int MappedDataset::getN() {
+    return N;
+}
+PUBLIC int MappedDataset::getPlanes() {
+    return numPlanes;
+}
+PUBLIC int MappedDataset::getImageSize() {
+    return imageSize;
+}
+PUBLIC int MappedDataset::getImageCubeSize() {
+    return numPlanes * imageSize * imageSize;
+}
+// points directly into the mapping, valid for the lifetime of this object
+// only for formats with one byte per pixel, ie not mlv2
+PUBLIC const unsigned char *MappedDataset::getImage(int n) {
+    if(format == MLV2) {
+        throw runtime_error("MappedDataset::getImage: mlv2 records are bit-packed, so use load() instead");
+    }
+    if(n < 0 || n >= N) {
+        throw runtime_error("MappedDataset::getImage: n " + toString(n) + " out of range, N=" + toString(N));
+    }
+    return imagesFile->getData() + headerSize + (long long)n * recordSize;
+}
+// same semantics as GenericLoader::load: numExamples 0 means all the remaining
+// examples from startN, and labels 0 means dont read labels
+// images for the next chunk after this one are hinted to the os, so the next
+// call in a sequential pass finds them already paged in
+PUBLIC void MappedDataset::load(unsigned char *images, int *labels, int startN, int numExamples) {
+    if(numExamples == 0) {
+        numExamples = N - startN;
+    }
+    if(startN < 0 || numExamples < 0 || startN + numExamples > N) {
+        throw runtime_error("You requested " + toString(numExamples) + " but there are only " + toString(N - startN) + " available after start N " + toString(startN));
+    }
+    const long long chunkOffset = headerSize + (long long)startN * recordSize;
+    const long long chunkSize = (long long)numExamples * recordSize;
+    const unsigned char *records = imagesFile->getData(chunkOffset, chunkSize);
+    if(format == MLV2) {
+        Kgsv2Loader::unpackRecords(records, numPlanes, imageSize, numExamples, images, labels);
+    } else {
+        memcpy(images, records, (size_t)chunkSize);
+        if(labels != 0) {
+            loadLabels(labels, startN, numExamples);
+        }
+    }
+    imagesFile->willNeed(chunkOffset + chunkSize, chunkSize);
+}
+PRIVATE void MappedDataset::loadLabels(int *labels, int startN, int numExamples) {
+    openLabelsFile();
+    if(format == NORB) {
+        memcpy(labels, labelsFile->getData(5 * 4 + (long long)startN * 4, (long long)numExamples * 4), numExamples * 4);
+    } else {
+        const unsigned char *labelBytes = labelsFile->getData(2 * 4 + (long long)startN, numExamples);
+        for(int i = 0; i < numExamples; i++) {
+            labels[i] = labelBytes[i];
+        }
+    }
+}
+PRIVATE void MappedDataset::openLabelsFile() {
+    if(labelsFile != 0) {
+        return;
+    }
+    string labelsFilepath;
+    unsigned int expectedMagic;
+    if(format == NORB) {
+        labelsFilepath = replace(imagesFilepath, "-dat.mat","-cat.mat");
+        expectedMagic = 0x1e3d4c54;
+    } else {
+        labelsFilepath = replace(imagesFilepath, "-images-idx3-ubyte", "-labels-idx1-ubyte");
+        labelsFilepath = replace(labelsFilepath, "-images.idx3-ubyte", "-labels.idx1-ubyte");
+        expectedMagic = 0x01080000;
+    }
+    MappedFile *file = new MappedFile(labelsFilepath);
+    unsigned int magic = 0;
+    int labelsN = -1;
+    if(file->getSize() >= 3 * 4) {
+        unsigned char header[3 * 4];
+        memcpy(header, file->getData(0, 3 * 4), 3 * 4);
+        memcpy(&magic, header, 4);
+        labelsN = format == NORB ? (int)((unsigned int *)header)[2] : MnistLoader::readUInt(header, 1);
+    }
+    if(magic != expectedMagic || labelsN < N) {
+        delete file;
+        throw runtime_error("labels file " + labelsFilepath + " doesnt match " + imagesFilepath);
+    }
+    labelsFile = file;
+}
+
@@ -0,0 +1,65 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+
+#include "DeepCLDllExport.h"
+
+class MappedFile;
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// memory-mapped handle onto an mnist, norb or mlv2 (kgsgo) dataset
+// the header is parsed once, in the constructor, and after that records are read
+// straight out of the mapping, so repeated load() calls on a large dataset dont
+// reopen the file, reparse the header, or allocate an intermediate buffer
+// mnist and norb store one byte per pixel, so getImage gives a pointer directly
+// into the mapping; mlv2 records are bit-packed, so have to go through load()
+// the labels file, for mnist and norb, is only opened the first time labels are asked for
+class DeepCL_EXPORT MappedDataset {
+    private:
+    std::string imagesFilepath;
+    int format;
+    int N;
+    int numPlanes;
+    int imageSize;
+    long long headerSize;
+    long long recordSize;
+    MappedFile *imagesFile;
+    MappedFile *labelsFile;
+
+    public:
+    static const int MNIST = 0;
+    static const int NORB = 1;
+    static const int MLV2 = 2;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    MappedDataset(std::string imagesFilepath);
+    ~MappedDataset();
+    int getFormat();
+    int getN();
+    int getPlanes();
+    int getImageSize();
+    int getImageCubeSize();
+    const unsigned char *getImage(int n);
+    void load(unsigned char *images, int *labels, int startN, int numExamples);
+
+    private:
+    void loadLabels(int *labels, int startN, int numExamples);
+    void openLabelsFile();
+
+    // [[[end]]]
+};
+
@@ -55,7 +55,9 @@ VIRTUAL void CrossEntropyLoss::setBatchSize(int batchSize) {
     if(gradInput != 0) {
         delete[] gradInput;
     }
-    gradInput = new float[ batchSize * previousLayer->getOutputNumElements() ];
+    if(!inferenceOnly) {
+        gradInput = new float[ batchSize * previousLayer->getOutputNumElements() ];
+    }
     this->batchSize = batchSize;
     allocatedSize = batchSize;
 }
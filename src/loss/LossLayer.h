@@ -24,6 +24,7 @@ public:
     VIRTUAL void forward();
     VIRTUAL bool needsBackProp();
     VIRTUAL float *getOutput();
+    VIRTUAL bool aliasesPreviousOutput() const;
     VIRTUAL int getOutputNumElements() const;
     VIRTUAL int getOutputCubeSize() const;
     VIRTUAL int getOutputSize() const;
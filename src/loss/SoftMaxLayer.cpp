@@ -4,6 +4,7 @@
 // v. 2.0. If a copy of the MPL was not distributed with this file, You can 
 // obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "EasyCL.h"
 #include "util/StatefulTimer.h"
 
 #include "layer/LayerMaker.h"
@@ -22,13 +23,257 @@ SoftMaxLayer::SoftMaxLayer(Layer *previousLayer, SoftMaxMaker *maker) :
         imageSize(previousLayer->getOutputSize()),
         numPlanes(previousLayer->getOutputPlanes()),
         imageSizeSquared(previousLayer->getOutputSize() * previousLayer->getOutputSize()),
+        cl(maker->cl),
+        forwardKernel(0),
+        gradInputFromLabelsKernel(0),
+        gradInputKernel(0),
         output(0),
         gradInput(0),
+        outputWrapper(0),
+        gradInputWrapper(0),
+        labelsArray(0),
+        expectedArray(0),
+        labelsWrapper(0),
+        expectedWrapper(0),
         allocatedSize(0),
         batchSize(0)
          {
+    if(!onDevice()) {
+        return;
+    }
+    if(!perPlane && imageSize != 1) {
+        throw std::runtime_error("perColumn only supported for imagesize 1 for now.  Sit tight :-)  (But please raise an issue to highlight your need)");
+    }
+    string options = "";
+    options += " -DgGroupSize=" + toString(perPlane ? imageSizeSquared : numPlanes);
+
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel2("forwardKernel", "cl/softmax.cl", "forward", 'options')
+    // ]]]
+    // generated using cog, from cl/softmax.cl:
+    const char * forwardKernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "// expected defines:\n"
+    "// gGroupSize: number of contiguous values each softmax is taken over,\n"
+    "//             ie imageSizeSquared for per-plane, or numPlanes for per-column\n"
+    "//             (per-column only supports imagesize 1, so the planes are contiguous)\n"
+    "\n"
+    "// one workitem per group\n"
+    "kernel void forward(\n"
+    "        const int numGroups,\n"
+    "        global const float *input,\n"
+    "        global float *output) {\n"
+    "    const int groupId = get_global_id(0);\n"
+    "    if (groupId >= numGroups) {\n"
+    "        return;\n"
+    "    }\n"
+    "    global const float *groupInput = input + groupId * gGroupSize;\n"
+    "    global float *groupOutput = output + groupId * gGroupSize;\n"
+    "    float maxValue = groupInput[0];\n"
+    "    for (int i = 1; i < gGroupSize; i++) {\n"
+    "        maxValue = max(maxValue, groupInput[i]);\n"
+    "    }\n"
+    "    float denominator = 0.0f;\n"
+    "    for (int i = 0; i < gGroupSize; i++) {\n"
+    "        denominator += exp(groupInput[i] - maxValue);\n"
+    "    }\n"
+    "    for (int i = 0; i < gGroupSize; i++) {\n"
+    "        groupOutput[i] = exp(groupInput[i] - maxValue) / denominator;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// one label per group, one workitem per value\n"
+    "kernel void gradInputFromLabels(\n"
+    "        const int N,\n"
+    "        global const float *output,\n"
+    "        global const int *labels,\n"
+    "        global float *gradInput) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int label = labels[globalId / gGroupSize];\n"
+    "    const int posInGroup = globalId % gGroupSize;\n"
+    "    gradInput[globalId] = output[globalId] - (posInGroup == label ? 1.0f : 0.0f);\n"
+    "}\n"
+    "\n"
+    "kernel void gradInput(\n"
+    "        const int N,\n"
+    "        global const float *output,\n"
+    "        global const float *expectedValues,\n"
+    "        global float *gradInput) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    gradInput[globalId] = output[globalId] - expectedValues[globalId];\n"
+    "}\n"
+    "\n"
+    "";
+    forwardKernel = cl->buildKernelFromString(forwardKernelSource, "forward", options, "cl/softmax.cl");
+    // [[[end]]]
+    if(inferenceOnly) {
+        return;
+    }
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel2("gradInputFromLabelsKernel", "cl/softmax.cl", "gradInputFromLabels", 'options')
+    // stringify.write_kernel2("gradInputKernel", "cl/softmax.cl", "gradInput", 'options')
+    // ]]]
+    // generated using cog, from cl/softmax.cl:
+    const char * gradInputFromLabelsKernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "// expected defines:\n"
+    "// gGroupSize: number of contiguous values each softmax is taken over,\n"
+    "//             ie imageSizeSquared for per-plane, or numPlanes for per-column\n"
+    "//             (per-column only supports imagesize 1, so the planes are contiguous)\n"
+    "\n"
+    "// one workitem per group\n"
+    "kernel void forward(\n"
+    "        const int numGroups,\n"
+    "        global const float *input,\n"
+    "        global float *output) {\n"
+    "    const int groupId = get_global_id(0);\n"
+    "    if (groupId >= numGroups) {\n"
+    "        return;\n"
+    "    }\n"
+    "    global const float *groupInput = input + groupId * gGroupSize;\n"
+    "    global float *groupOutput = output + groupId * gGroupSize;\n"
+    "    float maxValue = groupInput[0];\n"
+    "    for (int i = 1; i < gGroupSize; i++) {\n"
+    "        maxValue = max(maxValue, groupInput[i]);\n"
+    "    }\n"
+    "    float denominator = 0.0f;\n"
+    "    for (int i = 0; i < gGroupSize; i++) {\n"
+    "        denominator += exp(groupInput[i] - maxValue);\n"
+    "    }\n"
+    "    for (int i = 0; i < gGroupSize; i++) {\n"
+    "        groupOutput[i] = exp(groupInput[i] - maxValue) / denominator;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// one label per group, one workitem per value\n"
+    "kernel void gradInputFromLabels(\n"
+    "        const int N,\n"
+    "        global const float *output,\n"
+    "        global const int *labels,\n"
+    "        global float *gradInput) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int label = labels[globalId / gGroupSize];\n"
+    "    const int posInGroup = globalId % gGroupSize;\n"
+    "    gradInput[globalId] = output[globalId] - (posInGroup == label ? 1.0f : 0.0f);\n"
+    "}\n"
+    "\n"
+    "kernel void gradInput(\n"
+    "        const int N,\n"
+    "        global const float *output,\n"
+    "        global const float *expectedValues,\n"
+    "        global float *gradInput) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    gradInput[globalId] = output[globalId] - expectedValues[globalId];\n"
+    "}\n"
+    "\n"
+    "";
+    gradInputFromLabelsKernel = cl->buildKernelFromString(gradInputFromLabelsKernelSource, "gradInputFromLabels", options, "cl/softmax.cl");
+    // generated using cog, from cl/softmax.cl:
+    const char * gradInputKernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "// expected defines:\n"
+    "// gGroupSize: number of contiguous values each softmax is taken over,\n"
+    "//             ie imageSizeSquared for per-plane, or numPlanes for per-column\n"
+    "//             (per-column only supports imagesize 1, so the planes are contiguous)\n"
+    "\n"
+    "// one workitem per group\n"
+    "kernel void forward(\n"
+    "        const int numGroups,\n"
+    "        global const float *input,\n"
+    "        global float *output) {\n"
+    "    const int groupId = get_global_id(0);\n"
+    "    if (groupId >= numGroups) {\n"
+    "        return;\n"
+    "    }\n"
+    "    global const float *groupInput = input + groupId * gGroupSize;\n"
+    "    global float *groupOutput = output + groupId * gGroupSize;\n"
+    "    float maxValue = groupInput[0];\n"
+    "    for (int i = 1; i < gGroupSize; i++) {\n"
+    "        maxValue = max(maxValue, groupInput[i]);\n"
+    "    }\n"
+    "    float denominator = 0.0f;\n"
+    "    for (int i = 0; i < gGroupSize; i++) {\n"
+    "        denominator += exp(groupInput[i] - maxValue);\n"
+    "    }\n"
+    "    for (int i = 0; i < gGroupSize; i++) {\n"
+    "        groupOutput[i] = exp(groupInput[i] - maxValue) / denominator;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "// one label per group, one workitem per value\n"
+    "kernel void gradInputFromLabels(\n"
+    "        const int N,\n"
+    "        global const float *output,\n"
+    "        global const int *labels,\n"
+    "        global float *gradInput) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int label = labels[globalId / gGroupSize];\n"
+    "    const int posInGroup = globalId % gGroupSize;\n"
+    "    gradInput[globalId] = output[globalId] - (posInGroup == label ? 1.0f : 0.0f);\n"
+    "}\n"
+    "\n"
+    "kernel void gradInput(\n"
+    "        const int N,\n"
+    "        global const float *output,\n"
+    "        global const float *expectedValues,\n"
+    "        global float *gradInput) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    gradInput[globalId] = output[globalId] - expectedValues[globalId];\n"
+    "}\n"
+    "\n"
+    "";
+    gradInputKernel = cl->buildKernelFromString(gradInputKernelSource, "gradInput", options, "cl/softmax.cl");
+    // [[[end]]]
 }
 VIRTUAL SoftMaxLayer::~SoftMaxLayer() {
+    delete forwardKernel;
+    delete gradInputFromLabelsKernel;
+    delete gradInputKernel;
+    if(outputWrapper != 0) {
+        delete outputWrapper;
+    }
+    if(gradInputWrapper != 0) {
+        delete gradInputWrapper;
+    }
+    delete labelsWrapper;
+    delete expectedWrapper;
+    delete[] labelsArray;
+    delete[] expectedArray;
     if(gradInput != 0) {
         delete[] gradInput;
     }
@@ -39,17 +284,59 @@ VIRTUAL SoftMaxLayer::~SoftMaxLayer() {
 VIRTUAL std::string SoftMaxLayer::getClassName() const {
     return "SoftMaxLayer";
 }
+// we run on the device exactly when the previous layer hands us a device buffer,
+// otherwise we'd just be uploading to get the output back again straight away
+bool SoftMaxLayer::onDevice() const {
+    return cl != 0 && previousLayer->hasOutputWrapper();
+}
 VIRTUAL float *SoftMaxLayer::getOutput() {
+    if(outputWrapper != 0 && outputWrapper->isDeviceDirty()) {
+        outputWrapper->copyToHost();
+    }
     return output;
 }
+VIRTUAL bool SoftMaxLayer::aliasesPreviousOutput() const {
+    return false;
+}
 VIRTUAL float *SoftMaxLayer::getGradInput() {
+    if(gradInputWrapper != 0 && gradInputWrapper->isDeviceDirty()) {
+        gradInputWrapper->copyToHost();
+    }
     return gradInput;
 }
+VIRTUAL bool SoftMaxLayer::hasOutputWrapper() const {
+    return onDevice();
+}
+VIRTUAL CLWrapper *SoftMaxLayer::getOutputWrapper() {
+    return outputWrapper;
+}
+VIRTUAL bool SoftMaxLayer::providesGradInputWrapper() const {
+    return onDevice();
+}
+VIRTUAL CLWrapper *SoftMaxLayer::getGradInputWrapper() {
+    return gradInputWrapper;
+}
 VIRTUAL void SoftMaxLayer::setBatchSize(int batchSize) {
     this->batchSize = batchSize;
     if(batchSize <= this->allocatedSize) {
         return;
     }
+    if(outputWrapper != 0) {
+        delete outputWrapper;
+        outputWrapper = 0;
+    }
+    if(gradInputWrapper != 0) {
+        delete gradInputWrapper;
+        gradInputWrapper = 0;
+    }
+    delete labelsWrapper;
+    delete expectedWrapper;
+    delete[] labelsArray;
+    delete[] expectedArray;
+    labelsWrapper = 0;
+    expectedWrapper = 0;
+    labelsArray = 0;
+    expectedArray = 0;
     if(output != 0) {
         delete[] output;
     }
@@ -57,7 +344,23 @@ VIRTUAL void SoftMaxLayer::setBatchSize(int batchSize) {
         delete[] gradInput;
     }
     output = new float[ getOutputNumElements() ];
-    gradInput = new float[ previousLayer-> getOutputNumElements() ];
+    if(!inferenceOnly) {
+        gradInput = new float[ previousLayer-> getOutputNumElements() ];
+    }
+    if(onDevice()) {
+        outputWrapper = cl->wrap(getOutputNumElements(), output);
+        outputWrapper->createOnDevice();
+        if(!inferenceOnly) {
+            gradInputWrapper = cl->wrap(previousLayer->getOutputNumElements(), gradInput);
+            gradInputWrapper->createOnDevice();
+            labelsArray = new int[ batchSize * getNumLabelsPerExample() ];
+            labelsWrapper = cl->wrap(batchSize * getNumLabelsPerExample(), labelsArray);
+            labelsWrapper->createOnDevice();
+            expectedArray = new float[ getOutputNumElements() ];
+            expectedWrapper = cl->wrap(getOutputNumElements(), expectedArray);
+            expectedWrapper->createOnDevice();
+        }
+    }
     allocatedSize = batchSize;
 }
 VIRTUAL int SoftMaxLayer::getBatchSize() {
@@ -67,6 +370,7 @@ VIRTUAL int SoftMaxLayer::getBatchSize() {
 VIRTUAL float SoftMaxLayer::calcLossFromLabels(int const *labels) {
 //    cout << "softmaxlayer::calcloss" << endl;
     StatefulTimer::timeCheck("start SoftMaxLayer calcLossfromlabels");
+    getOutput();
     float loss = 0;
     if(perPlane) {
         for(int n = 0; n < batchSize; n++) {
@@ -93,6 +397,7 @@ VIRTUAL float SoftMaxLayer::calcLossFromLabels(int const *labels) {
 // need to calculate multinomial logistic /cross-entropy loss
 VIRTUAL float SoftMaxLayer::calcLoss(float const *expectedValues) {
     StatefulTimer::timeCheck("start SoftMaxLayer calcLoss");
+    getOutput();
     float loss = 0;
     if(perPlane) {
         for(int n = 0; n < batchSize; n++) {
@@ -128,6 +433,23 @@ VIRTUAL float SoftMaxLayer::calcLoss(float const *expectedValues) {
 VIRTUAL void SoftMaxLayer::calcGradInputFromLabels(int const *labels) {
 //    cout << "softmaxlayer::calcerrors" << endl;
     StatefulTimer::timeCheck("start SoftMaxLayer calcGradInputfromlabels");
+    if(onDevice()) {
+        const int numLabels = batchSize * getNumLabelsPerExample();
+        const int groupSize = perPlane ? imageSizeSquared : numPlanes;
+        for(int i = 0; i < numLabels; i++) {
+            if(labels[i] >= groupSize) {
+                throw runtime_error("Label " + toString(labels[i]) + " exceeds number of softmax planes " + toString(groupSize) );
+            } else if(labels[i] < 0) {
+                throw runtime_error("Label " + toString(labels[i]) + " negative");
+            }
+        }
+        writeToDevice(labelsWrapper, labels, sizeof(int) * numLabels);
+        const int N = previousLayer->getOutputNumElements();
+        gradInputFromLabelsKernel->in(N)->in(outputWrapper)->in(labelsWrapper)->out(gradInputWrapper);
+        runElementwise(gradInputFromLabelsKernel, N);
+        StatefulTimer::timeCheck("end SoftMaxLayer calcGradInputfromlabels");
+        return;
+    }
     if(perPlane) {
         for(int n = 0; n < batchSize; n++) {
             for(int plane = 0; plane < numPlanes; plane++) {
@@ -166,6 +488,14 @@ VIRTUAL void SoftMaxLayer::calcGradInputFromLabels(int const *labels) {
 VIRTUAL void SoftMaxLayer::calcGradInput(float const *expectedValues) {
 //    cout << "softmaxlayer::calcerrors" << endl;
     StatefulTimer::timeCheck("start SoftMaxLayer calcGradInput");
+    if(onDevice()) {
+        const int N = previousLayer->getOutputNumElements();
+        writeToDevice(expectedWrapper, expectedValues, sizeof(float) * N);
+        gradInputKernel->in(N)->in(outputWrapper)->in(expectedWrapper)->out(gradInputWrapper);
+        runElementwise(gradInputKernel, N);
+        StatefulTimer::timeCheck("end SoftMaxLayer calcGradInput");
+        return;
+    }
     if(perPlane) {
         for(int n = 0; n < batchSize; n++) {
             for(int plane = 0; plane < numPlanes; plane++) {
@@ -191,6 +521,13 @@ VIRTUAL void SoftMaxLayer::calcGradInput(float const *expectedValues) {
     }
     StatefulTimer::timeCheck("end SoftMaxLayer calcGradInput");
 }
+// writes from source directly, rather than copying into wrapper's host array first,
+// as InputLayer does
+void SoftMaxLayer::writeToDevice(CLWrapper *wrapper, void const *source, int numBytes) {
+    cl_int err = clEnqueueWriteBuffer(*cl->queue, wrapper->getBuffer(), CL_TRUE, 0,
+        numBytes, source, 0, NULL, NULL);
+    EasyCL::checkError(err);
+}
 VIRTUAL int SoftMaxLayer::getNumLabelsPerExample() {
     if(perPlane) {
         return numPlanes;
@@ -203,7 +540,7 @@ VIRTUAL int SoftMaxLayer::getPersistSize(int version) const {
 }
 VIRTUAL int SoftMaxLayer::calcNumRightFromLabels(int const*labels) {
     StatefulTimer::timeCheck("start SoftMaxLayer calcNumRight");
-//    float *input = previousLayer->getOutput(); // just retrieve as host-side array for now
+    getOutput();
     int numRight = 0;
     if(perPlane) {
         for(int n = 0; n < batchSize; n++) {
@@ -253,6 +590,13 @@ VIRTUAL int SoftMaxLayer::calcNumRightFromLabels(int const*labels) {
 VIRTUAL void SoftMaxLayer::forward() {
 //    cout << "softmaxlayer::forward" << endl;
     StatefulTimer::timeCheck("start SoftMaxLayer forward");
+    if(onDevice()) {
+        const int numGroups = perPlane ? batchSize * numPlanes : batchSize;
+        forwardKernel->in(numGroups)->in(previousLayer->getOutputWrapper())->out(outputWrapper);
+        runElementwise(forwardKernel, numGroups);
+        StatefulTimer::timeCheck("end SoftMaxLayer forward");
+        return;
+    }
     float *input = previousLayer->getOutput(); // just retrieve as host-side array for now
     if(perPlane) {
         for(int n = 0; n < batchSize; n++) {
@@ -303,6 +647,7 @@ VIRTUAL void SoftMaxLayer::getLabels(int *labels) { // need to allocate labels a
     if(imageSize != 1) {
         throw std::runtime_error("perColumn only supported for imagesize 1 for now.  Sit tight :-)  (But please raise an issue to highlight your need)");
     }
+    getOutput();
     for(int n = 0; n < batchSize; n++) {
         float *outputStack = output + n * numPlanes;
         float highestProb = outputStack[0];
@@ -324,6 +669,13 @@ VIRTUAL void SoftMaxLayer::getLabels(int *labels) { // need to allocate labels a
 //    cout << "softmaxlayer::backproperrors" << endl;
     // nop, do nothing :-)
 //}
+// one workitem per value, rounded up to whole workgroups; the kernels check bounds
+void SoftMaxLayer::runElementwise(CLKernel *kernel, int numWorkitems) {
+    const int workgroupSize = 64;
+    const int numWorkgroups = (numWorkitems + workgroupSize - 1) / workgroupSize;
+    kernel->run_1d(numWorkgroups * workgroupSize, workgroupSize);
+    cl->finish();
+}
 VIRTUAL std::string SoftMaxLayer::asString() const {
     return "SoftMaxLayer{ perPlane=" + toString(perPlane) + " numPlanes=" + toString(numPlanes)
         + " imageSize=" + toString(imageSize) + " }";
@@ -11,6 +11,8 @@
 #include "IAcceptsLabels.h"
 
 class SoftMaxMaker;
+class CLKernel;
+class CLWrapper;
 
 #define VIRTUAL virtual
 #define STATIC static
@@ -26,8 +28,23 @@ public:
     const int numPlanes;
     const int imageSizeSquared;
 
+    EasyCL *const cl; // NOT owned by us
+    CLKernel *forwardKernel;
+    CLKernel *gradInputFromLabelsKernel;
+    CLKernel *gradInputKernel;
+
+    // when the previous layer keeps its output on the device, so do we: output
+    // and gradInput are then only copied to host when someone asks for them
     float *output;
     float *gradInput;
+    CLWrapper *outputWrapper;
+    CLWrapper *gradInputWrapper;
+    // labels, or expected values, are written straight from the caller's array into
+    // these, each batch, rather than wrapping the caller's array each time
+    int *labelsArray;
+    float *expectedArray;
+    CLWrapper *labelsWrapper;
+    CLWrapper *expectedWrapper;
     int allocatedSize;
     int batchSize;
 
@@ -39,19 +56,27 @@ public:
     SoftMaxLayer(Layer *previousLayer, SoftMaxMaker *maker);
     VIRTUAL ~SoftMaxLayer();
     VIRTUAL std::string getClassName() const;
+    bool onDevice() const;
     VIRTUAL float *getOutput();
+    VIRTUAL bool aliasesPreviousOutput() const;
     VIRTUAL float *getGradInput();
+    VIRTUAL bool hasOutputWrapper() const;
+    VIRTUAL CLWrapper *getOutputWrapper();
+    VIRTUAL bool providesGradInputWrapper() const;
+    VIRTUAL CLWrapper *getGradInputWrapper();
     VIRTUAL void setBatchSize(int batchSize);
     VIRTUAL int getBatchSize();
     VIRTUAL float calcLossFromLabels(int const *labels);
     VIRTUAL float calcLoss(float const *expectedValues);
     VIRTUAL void calcGradInputFromLabels(int const *labels);
     VIRTUAL void calcGradInput(float const *expectedValues);
+    void writeToDevice(CLWrapper *wrapper, void const *source, int numBytes);
     VIRTUAL int getNumLabelsPerExample();
     VIRTUAL int getPersistSize(int version) const;
     VIRTUAL int calcNumRightFromLabels(int const*labels);
     VIRTUAL void forward();
     VIRTUAL void getLabels(int *labels);  // need to allocate labels array first, and have called 'forward' first
+    void runElementwise(CLKernel *kernel, int numWorkitems);
     VIRTUAL std::string asString() const;
 
     // [[[end]]]
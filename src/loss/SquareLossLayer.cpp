@@ -59,7 +59,9 @@ VIRTUAL void SquareLossLayer::setBatchSize(int batchSize) {
     }
     this->batchSize = batchSize;
     allocatedSize = batchSize;
-    gradInput = new float[ batchSize * previousLayer->getOutputNumElements() ];
+    if(!inferenceOnly) {
+        gradInput = new float[ batchSize * previousLayer->getOutputNumElements() ];
+    }
 }
 VIRTUAL void SquareLossLayer::calcGradInput(float const*expectedOutput) {
     int inputNumElements = previousLayer->getOutputNumElements();
@@ -5,8 +5,11 @@
 // obtain one at http://mozilla.org/MPL/2.0/.
 
 
+#include <algorithm>
+
 #include "DeepCL.h"
 #include "loss/SoftMaxLayer.h"
+#include "normalize/NormalizationLayer.h"
 #ifdef _WIN32
 #include <stdio.h>
 #include <fcntl.h>
@@ -31,7 +34,11 @@ using namespace std;
         {'name': 'outputFile', 'type': 'string', 'description': 'file to write outputs to, if empty, write to stdout', 'default': ''},
         {'name': 'outputLayer', 'type': 'int', 'description': 'layer to write output from, default -1 means: last layer', 'default': -1},
         {'name': 'writeLabels', 'type': 'int', 'description': 'write integer labels, instead of probabilities etc (default 0)', 'default': 0},
-        {'name': 'outputFormat', 'type': 'string', 'description': 'output format [binary|text]', 'default': 'text'}
+        {'name': 'outputFormat', 'type': 'string', 'description': 'output format [binary|text]', 'default': 'text'},
+        {'name': 'int8', 'type': 'int', 'description': 'run int8 inference on the cpu, needs weightsfile written by deepcl_quantize [1|0]', 'default': 0},
+        {'name': 'fuseLayers', 'type': 'int', 'description': 'run each activation layer followed by max-pooling as one fused layer [1|0]', 'default': 1},
+        {'name': 'shareActivations', 'type': 'int', 'description': 'let layers reuse each others output buffers, unless outputlayer is given [1|0]', 'default': 1},
+        {'name': 'deviceWeights', 'type': 'string', 'description': 'keep conv and fc weights on the gpu as fp32, or fp16 or bf16, for half the memory traffic [fp32|fp16|bf16]', 'default': 'fp32'}
     ]
 *///]]]
 // [[[end]]]
@@ -52,6 +59,10 @@ public:
     int outputLayer;
     int writeLabels;
     string outputFormat;
+    int int8;
+    int fuseLayers;
+    int shareActivations;
+    string deviceWeights;
     // [[[end]]]
 
     Config() {
@@ -81,6 +92,10 @@ public:
         outputLayer = -1;
         writeLabels = 0;
         outputFormat = "text";
+        int8 = 0;
+        fuseLayers = 1;
+        shareActivations = 1;
+        deviceWeights = "fp32";
         // [[[end]]]
     }
 };
@@ -130,6 +145,8 @@ void go(Config config) {
 
     NeuralNet *net;
     net = new NeuralNet(cl);
+    net->setInferenceOnly(true);
+    net->setDeviceWeights(config.deviceWeights);
 
     // just use the default for net creation, weights are overriden from the weightsFile
     WeightsInitializer *weightsInitializer = new OriginalInitializer();
@@ -152,6 +169,9 @@ void go(Config config) {
     if(!NetdefToNet::createNetFromNetdef(net, netDef, weightsInitializer) ) {
         return;
     }
+    if(config.fuseLayers) {
+        net->fuseLayers();
+    }
 
     // ignored int and float, s.t. we can use loadWeights
     int ignI;
@@ -167,8 +187,25 @@ void go(Config config) {
     if(verbose) {
         net->print();
     }
+    // intermediate layer outputs arent kept when sharing
+    net->setShareActivations(config.shareActivations && config.outputLayer == -1);
     net->setBatchSize(config.batchSize);
     if(verbose) cout << "batchSize: " << config.batchSize << endl;
+    Int8Predictor *int8Predictor = 0;
+    if(config.int8) {
+        int8Predictor = new Int8Predictor(net);
+    }
+    // when reading a file, the loader normalizes as it converts the bytes to float, so
+    // the normalization layer doesnt need its own pass; int8 normalizes itself.  If
+    // layer 1 isnt a normalization layer, the loader leaves the values as they are
+    float translate = 0.0f;
+    float scale = 1.0f;
+    NormalizationLayer *normalizationLayer = dynamic_cast<NormalizationLayer *>(net->getLayer(1));
+    if(config.inputFile != "" && int8Predictor == 0 && normalizationLayer != 0) {
+        translate = normalizationLayer->translate;
+        scale = normalizationLayer->scale;
+        normalizationLayer->setInputNormalized(true);
+    }
 
 
     //
@@ -210,24 +247,31 @@ void go(Config config) {
         // pass 0 for labels, and this will cause GenericLoader to simply not try to load any labels
         // now, after modifying GenericLoader to have this new behavior
         // GenericLoader::load(config.inputFile.c_str(), inputData, 0, n, config.batchSize);
-        loader->load(inputData, 0, n, config.batchSize);
+        loader->load(inputData, 0, n, config.batchSize, translate, scale);
     }
     while(more) {
         // no point in forwarding through all, so forward through each, one by one
         if(config.outputLayer < 0 || config.outputLayer > net->getNumLayers()) {
             throw runtime_error("outputLayer should be the layer number of one of the layers in the network");
         }
-        dynamic_cast<InputLayer *>(net->getLayer(0))->in(inputData);
-        for(int layerId = 0; layerId <= config.outputLayer; layerId++) {
-            StatefulTimer::setPrefix("layer" + toString(layerId) + " ");
-            net->getLayer(layerId)->forward();
-            StatefulTimer::setPrefix("");
+        float const*output = 0;
+        if(int8Predictor != 0) {
+            output = int8Predictor->forward(config.batchSize, inputData, config.outputLayer);
+        } else {
+            dynamic_cast<InputLayer *>(net->getLayer(0))->in(inputData);
+            for(int layerId = 0; layerId <= config.outputLayer; layerId++) {
+                StatefulTimer::setPrefix("layer" + toString(layerId) + " ");
+                net->getLayer(layerId)->forward();
+                StatefulTimer::setPrefix("");
+            }
         }
+        const int numFields = net->getLayer(config.outputLayer)->getOutputCubeSize();
 
         if(!config.writeLabels) {
+            if(output == 0) {
+                output = net->getLayer(config.outputLayer)->getOutput();
+            }
             if(config.outputFormat == "text") {
-                float const*output = net->getLayer(config.outputLayer)->getOutput();
-                const int numFields = net->getLayer(config.outputLayer)->getOutputCubeSize();
                 for(int i = 0; i < config.batchSize; i++) {
                     for(int f = 0; f < numFields; f++) {
                         if(f > 0) {
@@ -238,7 +282,7 @@ void go(Config config) {
                     *outFile << "\n";
                 }
             } else {
-                outFile->write(reinterpret_cast<const char *>(net->getOutput()), net->getOutputNumElements() * 4 * config.batchSize);
+                outFile->write(reinterpret_cast<const char *>(output), numFields * 4l * config.batchSize);
             }
         } else {
             SoftMaxLayer *softMaxLayer = dynamic_cast< SoftMaxLayer *>(net->getLayer(config.outputLayer) );
@@ -246,7 +290,15 @@ void go(Config config) {
                 cout << "must choose softmaxlayer, if want to output labels" << endl;
                 return;
             }
-            softMaxLayer->getLabels(labels);
+            if(int8Predictor != 0) {
+                // argmax, as SoftMaxLayer::getLabels
+                for(int i = 0; i < config.batchSize; i++) {
+                    float const*imageOutput = output + i * numFields;
+                    labels[i] = (int)(max_element(imageOutput, imageOutput + numFields) - imageOutput);
+                }
+            } else {
+                softMaxLayer->getLabels(labels);
+            }
             if(config.outputFormat == "text") {
                 for(int i = 0; i < config.batchSize; i++) {
                     *outFile << labels[i] << "\n";
@@ -263,7 +315,7 @@ void go(Config config) {
         } else {
             if(n + config.batchSize < N) {
                 // GenericLoader::load(config.inputFile.c_str(), inputData, 0, n, config.batchSize);
-                loader->load(inputData, 0, n, config.batchSize);
+                loader->load(inputData, 0, n, config.batchSize, translate, scale);
             } else {
                 more = false;
                 if(n != N) {
@@ -279,6 +331,7 @@ void go(Config config) {
 
     delete[] inputData;
     delete[] labels;
+    delete int8Predictor;
     delete weightsInitializer;
     delete net;
     delete cl;
@@ -316,6 +369,10 @@ void printUsage(char *argv[], Config config) {
     cout << "    outputlayer=[layer to write output from, default -1 means: last layer] (" << config.outputLayer << ")" << endl;
     cout << "    writelabels=[write integer labels, instead of probabilities etc (default 0)] (" << config.writeLabels << ")" << endl;
     cout << "    outputformat=[output format [binary|text]] (" << config.outputFormat << ")" << endl;
+    cout << "    int8=[run int8 inference on the cpu, needs weightsfile written by deepcl_quantize [1|0]] (" << config.int8 << ")" << endl;
+    cout << "    fuselayers=[run each activation layer followed by max-pooling as one fused layer [1|0]] (" << config.fuseLayers << ")" << endl;
+    cout << "    shareactivations=[let layers reuse each others output buffers, unless outputlayer is given [1|0]] (" << config.shareActivations << ")" << endl;
+    cout << "    deviceweights=[keep conv and fc weights on the gpu as fp32, or fp16 or bf16, for half the memory traffic [fp32|fp16|bf16]] (" << config.deviceWeights << ")" << endl;
     // [[[end]]]
 }
 
@@ -365,6 +422,14 @@ int main(int argc, char *argv[]) {
                 config.writeLabels = atoi(value);
             } else if(key == "outputformat") {
                 config.outputFormat = (value);
+            } else if(key == "int8") {
+                config.int8 = atoi(value);
+            } else if(key == "fuselayers") {
+                config.fuseLayers = atoi(value);
+            } else if(key == "shareactivations") {
+                config.shareActivations = atoi(value);
+            } else if(key == "deviceweights") {
+                config.deviceWeights = (value);
             // [[[end]]]
             } else {
                 cout << endl;
@@ -0,0 +1,221 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// reads a weights file, calibrates the input scale of each convolutional and
+// fully-connected layer, by running some images through the float net, and writes
+// a weights file with these layers stored as int8, for deepcl_predict int8=1
+
+#include "DeepCL.h"
+#include "clblas/ClBlasInstance.h"
+
+using namespace std;
+
+/* [[[cog
+    # These are used in the later cog sections in this file:
+    options = [
+        {'name': 'gpuIndex', 'type': 'int', 'description': 'gpu device index; default value is gpu if present, cpu otw.', 'default': -1, 'ispublicapi': True},
+        {'name': 'weightsFile', 'type': 'string', 'description': 'file to read weights from', 'default': 'weights.dat', 'ispublicapi': True},
+        {'name': 'outputFile', 'type': 'string', 'description': 'file to write int8 weights to', 'default': 'weights-int8.dat', 'ispublicapi': True},
+        {'name': 'calibrationFile', 'type': 'string', 'description': 'file to read calibration images from, in any format GenericLoaderv2 reads, eg the training set', 'default': '', 'ispublicapi': True},
+        {'name': 'numExamples', 'type': 'int', 'description': 'number of calibration images to use, from start of calibrationfile', 'default': 1024, 'ispublicapi': True},
+        {'name': 'batchSize', 'type': 'int', 'description': 'batch size', 'default': 128, 'ispublicapi': True},
+        {'name': 'verbose', 'type': 'int', 'description': 'print the input range calibrated for each layer [0|1]', 'default': 0, 'ispublicapi': True}
+    ]
+*///]]]
+// [[[end]]]
+
+class Config {
+public:
+    /* [[[cog
+        cog.outl('// generated using cog:')
+        for option in options:
+            cog.outl(option['type'] + ' ' + option['name'] + ';')
+    */// ]]]
+    // generated using cog:
+    int gpuIndex;
+    string weightsFile;
+    string outputFile;
+    string calibrationFile;
+    int numExamples;
+    int batchSize;
+    int verbose;
+    // [[[end]]]
+
+    Config() {
+        /* [[[cog
+            cog.outl('// generated using cog:')
+            for option in options:
+                defaultString = ''
+                default = option['default']
+                type = option['type']
+                if type == 'string':
+                    defaultString = '"' + default + '"'
+                elif type == 'int':
+                    defaultString = str(default)
+                elif type == 'float':
+                    defaultString = str(default)
+                    if '.' not in defaultString:
+                        defaultString += '.0'
+                    defaultString += 'f'
+                cog.outl(option['name'] + ' = ' + defaultString + ';')
+        */// ]]]
+        // generated using cog:
+        gpuIndex = -1;
+        weightsFile = "weights.dat";
+        outputFile = "weights-int8.dat";
+        calibrationFile = "";
+        numExamples = 1024;
+        batchSize = 128;
+        verbose = 0;
+        // [[[end]]]
+    }
+};
+
+void go(Config config) {
+    if(config.calibrationFile == "") {
+        cout << "calibrationFile not specified" << endl;
+        return;
+    }
+    GenericLoaderv2 loader(config.calibrationFile);
+    cout << "N " << loader.getN() << " planes " << loader.getPlanes() << " size " << loader.getImageSize() << endl;
+
+    EasyCL *cl = 0;
+    if(config.gpuIndex >= 0) {
+        cl = EasyCL::createForIndexedGpu(config.gpuIndex);
+    } else {
+        cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    }
+    ClBlasInstance blasInstance;
+
+    NeuralNet *net = new NeuralNet(cl);
+    net->setInferenceOnly(true); // calibration only runs forward
+    // just use the default for net creation, weights are overriden from the weightsFile
+    WeightsInitializer *weightsInitializer = new OriginalInitializer();
+
+    string netDef;
+    if(!WeightsPersister::loadConfigString(config.weightsFile, netDef)) {
+        cout << "Cannot load network definition from weightsFile." << endl;
+        return;
+    }
+    net->addLayer(InputLayerMaker::instance()->numPlanes(loader.getPlanes())->imageSize(loader.getImageSize()));
+    net->addLayer(NormalizationLayerMaker::instance()->translate(0.0f)->scale(1.0f)); // This will be read from weights file
+    if(!NetdefToNet::createNetFromNetdef(net, netDef, weightsInitializer)) {
+        return;
+    }
+    int epoch, batch, numRight;
+    float annealedLearningRate, loss;
+    string trainingConfigString = "netDef=" + netDef;
+    if(!WeightsPersister::loadWeights(config.weightsFile, trainingConfigString, net, &epoch, &batch, &annealedLearningRate, &numRight, &loss)) {
+        cout << "Cannot load network weights from weightsFile." << endl;
+        return;
+    }
+    net->print();
+
+    Int8Quantizer::calibrate(net, &loader, config.batchSize, config.numExamples, config.verbose != 0);
+    net->setWeightsStorage("int8");
+    WeightsPersister::persistWeights(config.outputFile, trainingConfigString, net, epoch, batch, annealedLearningRate, numRight, loss);
+
+    delete weightsInitializer;
+    delete net;
+    delete cl;
+}
+
+void printUsage(char *argv[], Config config) {
+    cout << "Usage: " << argv[0] << " [key]=[value] [[key]=[value]] ..." << endl;
+    cout << endl;
+    cout << "Possible key=value pairs:" << endl;
+    /* [[[cog
+        cog.outl('// generated using cog:')
+        cog.outl('cout << "public api, shouldnt change within major version:" << endl;')
+        for option in options:
+            name = option['name']
+            description = option['description']
+            if 'ispublicapi' in option and option['ispublicapi']:
+                cog.outl('cout << "    ' + name.lower() + '=[' + description + '] (" << config.' + name + ' << ")" << endl;')
+        cog.outl('cout << "" << endl; ')
+        cog.outl('cout << "unstable, might change within major version:" << endl; ')
+        for option in options:
+            if 'ispublicapi' not in option or not option['ispublicapi']:
+                name = option['name']
+                description = option['description']
+                cog.outl('cout << "    ' + name.lower() + '=[' + description + '] (" << config.' + name + ' << ")" << endl;')
+    *///]]]
+    // generated using cog:
+    cout << "public api, shouldnt change within major version:" << endl;
+    cout << "    gpuindex=[gpu device index; default value is gpu if present, cpu otw.] (" << config.gpuIndex << ")" << endl;
+    cout << "    weightsfile=[file to read weights from] (" << config.weightsFile << ")" << endl;
+    cout << "    outputfile=[file to write int8 weights to] (" << config.outputFile << ")" << endl;
+    cout << "    calibrationfile=[file to read calibration images from, in any format GenericLoaderv2 reads, eg the training set] (" << config.calibrationFile << ")" << endl;
+    cout << "    numexamples=[number of calibration images to use, from start of calibrationfile] (" << config.numExamples << ")" << endl;
+    cout << "    batchsize=[batch size] (" << config.batchSize << ")" << endl;
+    cout << "    verbose=[print the input range calibrated for each layer [0|1]] (" << config.verbose << ")" << endl;
+    cout << "" << endl; 
+    cout << "unstable, might change within major version:" << endl; 
+    // [[[end]]]
+}
+
+int main(int argc, char *argv[]) {
+    Config config;
+    if(argc == 2 && (string(argv[1]) == "--help" || string(argv[1]) == "--?" || string(argv[1]) == "-?" || string(argv[1]) == "-h") ) {
+        printUsage(argv, config);
+    }
+    for(int i = 1; i < argc; i++) {
+        vector<string> splitkeyval = split(argv[i], "=");
+        if(splitkeyval.size() != 2) {
+          cout << "Usage: " << argv[0] << " [key]=[value] [[key]=[value]] ..." << endl;
+          exit(1);
+        } else {
+            string key = splitkeyval[0];
+            string value = splitkeyval[1];
+            /* [[[cog
+                cog.outl('// generated using cog:')
+                cog.outl('if(false) {')
+                for option in options:
+                    name = option['name']
+                    type = option['type']
+                    cog.outl('} else if(key == "' + name.lower() + '") {')
+                    converter = '';
+                    if type == 'int':
+                        converter = 'atoi';
+                    elif type == 'float':
+                        converter = 'atof';
+                    cog.outl('    config.' + name + ' = ' + converter + '(value);')
+            */// ]]]
+            // generated using cog:
+            if(false) {
+            } else if(key == "gpuindex") {
+                config.gpuIndex = atoi(value);
+            } else if(key == "weightsfile") {
+                config.weightsFile = (value);
+            } else if(key == "outputfile") {
+                config.outputFile = (value);
+            } else if(key == "calibrationfile") {
+                config.calibrationFile = (value);
+            } else if(key == "numexamples") {
+                config.numExamples = atoi(value);
+            } else if(key == "batchsize") {
+                config.batchSize = atoi(value);
+            } else if(key == "verbose") {
+                config.verbose = atoi(value);
+            // [[[end]]]
+            } else {
+                cout << endl;
+                cout << "Error: key '" << key << "' not recognised" << endl;
+                cout << endl;
+                printUsage(argv, config);
+                cout << endl;
+                return -1;
+            }
+        }
+    }
+    try {
+        go(config);
+    } catch(runtime_error e) {
+        cout << "Something went wrong: " << e.what() << endl;
+        return -1;
+    }
+}
+
@@ -11,6 +11,7 @@
 #include "DeepCL.h"
 //#include "test/Sampler.h"  // TODO: REMOVE THIS
 #include "clblas/ClBlasInstance.h"
+#include "normalize/NormalizationLayer.h"
 
 using namespace std;
 
@@ -32,13 +33,18 @@ using namespace std;
         ('loadWeights', 'int', 'load weights from file at startup?', 0, True),
         ('weightsFile', 'string', 'file to write weights to','weights.dat', True),
         ('writeWeightsInterval', 'float', 'write weights every this many minutes', 0, True),
+        ('weightsStorage', 'string', 'fp16 or bf16 also writes the final weights, at half the size, to weightsfile.fp16, or .bf16; checkpoints stay fp32', 'fp32', True),
+        ('fuseLayers', 'int', 'run each activation layer followed by max-pooling as one fused layer [1|0]', 1, True),
         ('normalization', 'string', '[stddev|maxmin]', 'stddev', True),
         ('normalizationNumStds', 'float', 'with stddev normalization, how many stddevs from mean is 1?', 2.0, True),
         ('dumpTimings', 'int', 'dump detailed timings each epoch? [1|0]', 0, True),
         ('multiNet', 'int', 'number of Mcdnn columns to train', 1, True),
+        ('multiNetConcurrent', 'int', 'with multinet, train each column on its own OpenCL context, concurrently? [1|0]', 0, True),
         ('loadOnDemand', 'int', 'load data on demand [1|0]', 0, True),
         ('fileReadBatches', 'int', 'how many batches to read from file each time? (for loadondemand=1)', 50, True),
         ('normalizationExamples', 'int', 'number of examples to read to determine normalization parameters', 10000, True),
+        ('sampler', 'string', 'order of training examples each epoch: sequential, shuffle (not with loadondemand), or block (shuffle blocks of samplerblocksize examples, then within each filereadbatches*batchsize window)', 'sequential', True),
+        ('samplerBlockSize', 'int', 'for sampler=block, how many contiguous examples per block, must divide filereadbatches*batchsize; 0 means batchsize', 0, True),
         ('weightsInitializer', 'string', 'initializer for weights, choices: original, uniform (default: original)', 'original', True),
         ('initialWeights', 'float', 'for uniform initializer, weights will be initialized randomly within range -initialweights to +initialweights, divided by fanin, (default: 1.0f)', 1.0, False),
         ('trainer', 'string', 'which trainer, sgd, anneal, nesterov, adagrad, rmsprop, or adadelta (default: sgd)', 'sgd', True),
@@ -72,13 +78,18 @@ public:
     int loadWeights;
     string weightsFile;
     float writeWeightsInterval;
+    string weightsStorage;
+    int fuseLayers;
     string normalization;
     float normalizationNumStds;
     int dumpTimings;
     int multiNet;
+    int multiNetConcurrent;
     int loadOnDemand;
     int fileReadBatches;
     int normalizationExamples;
+    string sampler;
+    int samplerBlockSize;
     string weightsInitializer;
     float initialWeights;
     string trainer;
@@ -119,13 +130,18 @@ public:
         loadWeights = 0;
         weightsFile = "weights.dat";
         writeWeightsInterval = 0.0f;
+        weightsStorage = "fp32";
+        fuseLayers = 1;
         normalization = "stddev";
         normalizationNumStds = 2.0f;
         dumpTimings = 0;
         multiNet = 1;
+        multiNetConcurrent = 0;
         loadOnDemand = 0;
         fileReadBatches = 50;
         normalizationExamples = 10000;
+        sampler = "sequential";
+        samplerBlockSize = 0;
         weightsInitializer = "original";
         initialWeights = 1.0f;
         trainer = "sgd";
@@ -152,6 +168,13 @@ public:
     }
 };
 
+// status from CheckpointWriter, printed here, on the main thread
+void printWriteStatus(string status) {
+    if(status != "") {
+        cout << status << endl;
+    }
+}
+
 void go(Config config) {
     Timer timer;
 
@@ -283,6 +306,9 @@ void go(Config config) {
     if(!NetdefToNet::createNetFromNetdef(net, config.netDef, weightsInitializer)) {
         return;
     }
+    if(config.fuseLayers) {
+        cout << "fused " << net->fuseLayers() << " activation and pooling layer pairs" << endl;
+    }
     // apply the trainer
     Trainer *trainer = 0;
     if(toLower(config.trainer) == "sgd") {
@@ -320,6 +346,10 @@ void go(Config config) {
 //    trainer->bindTo(net);
 //    net->setTrainer(trainer);
     net->setBatchSize(config.batchSize);
+    // checkpoints, which loadweights resumes from, stay fp32; see the export after training
+    if(config.weightsStorage != "fp32" && config.weightsStorage != "fp16" && config.weightsStorage != "bf16") {
+        throw runtime_error("weightsstorage " + config.weightsStorage + " not recognized; choose fp32, fp16 or bf16");
+    }
     net->print();
 
     bool afterRestart = false;
@@ -330,10 +360,10 @@ void go(Config config) {
     float restartLoss = 0;
     if(config.loadWeights && config.weightsFile != "") {
         cout << "loadingweights" << endl;
-        afterRestart = WeightsPersister::loadWeights(config.weightsFile, config.getTrainingString(), net, &restartEpoch, &restartBatch, &restartAnnealedLearningRate, &restartNumRight, &restartLoss);
+        afterRestart = WeightsPersister::loadCheckpoint(config.weightsFile, config.getTrainingString(), net, &restartEpoch, &restartBatch, &restartAnnealedLearningRate, &restartNumRight, &restartLoss);
         if(!afterRestart && FileHelper::exists(config.weightsFile)) {
             // try old trainingstring
-            afterRestart = WeightsPersister::loadWeights(config.weightsFile, config.getOldTrainingString(), net, &restartEpoch, &restartBatch, &restartAnnealedLearningRate, &restartNumRight, &restartLoss);
+            afterRestart = WeightsPersister::loadCheckpoint(config.weightsFile, config.getOldTrainingString(), net, &restartEpoch, &restartBatch, &restartAnnealedLearningRate, &restartNumRight, &restartLoss);
         }
         if(!afterRestart && FileHelper::exists(config.weightsFile)) {
             cout << "Weights file " << config.weightsFile << " exists, but doesnt match training options provided." << endl;
@@ -357,16 +387,25 @@ void go(Config config) {
     Trainable *trainable = net;
     MultiNet *multiNet = 0;
     if(config.multiNet > 1) {
-        multiNet = new MultiNet(config.multiNet, net);
+        multiNet = new MultiNet(config.multiNet, net, config.multiNetConcurrent != 0);
         trainable = multiNet;
     }
     NetLearnerBase *netLearner = 0;
     if(config.loadOnDemand) {
-        netLearner = new NetLearnerOnDemandv2(trainer, trainable,
+        NetLearnerOnDemandv2 *netLearnerOnDemand = new NetLearnerOnDemandv2(trainer, trainable,
             &trainLoader, Ntrain,
             &testLoader, Ntest,
             config.fileReadBatches, config.batchSize
         );
+        // the loaders normalize as they convert the bytes to float, so the net doesnt
+        // need to; multinet's clones keep their own normalization layers, so we leave it,
+        // and if layer 1 isnt a normalization layer, the net gets the raw values
+        NormalizationLayer *normalizationLayer = dynamic_cast<NormalizationLayer *>(net->getLayer(1));
+        if(multiNet == 0 && normalizationLayer != 0) {
+            netLearnerOnDemand->setNormalization(normalizationLayer->translate, normalizationLayer->scale);
+            normalizationLayer->setInputNormalized(true);
+        }
+        netLearner = netLearnerOnDemand;
     } else {
         netLearner = new NetLearner(trainer, trainable,
             Ntrain, trainData, trainLabels,
@@ -374,6 +413,15 @@ void go(Config config) {
             config.batchSize 
         );
     }
+    // file order needs no sampler, and no gather buffers; otherwise a fixed seed, so a
+    // restart part way through an epoch sees the same order again
+    EpochSampler *sampler = 0;
+    if(config.sampler != "sequential") {
+        int samplerBlockSize = config.samplerBlockSize > 0 ? config.samplerBlockSize : config.batchSize;
+        sampler = EpochSampler::instance(config.sampler, Ntrain, samplerBlockSize,
+            config.fileReadBatches * config.batchSize, 0);
+        netLearner->setTrainSampler(sampler);
+    }
 //    netLearner->setTrainer(trainer);
     netLearner->reset();
     netLearner->setSchedule(config.numEpochs, afterRestart ? restartEpoch : 0);
@@ -383,14 +431,18 @@ void go(Config config) {
     netLearner->setDumpTimings(config.dumpTimings);
 //    netLearner->setLearningRate(config.learningRate, config.annealLearningRate);
     Timer weightsWriteTimer;
+    // training only waits while the weights are copied; the file is written in the background,
+    // and we print how that went from here, once it has
+    CheckpointWriter *checkpointWriter = new CheckpointWriter();
     while(!netLearner->isLearningDone()) {
 //        netLearnerBase->tickEpoch();
         netLearner->tickBatch();
+        printWriteStatus(checkpointWriter->takeStatus());
         if(netLearner->getEpochDone()) {
 //            cout << "epoch done" << endl;
             if(config.weightsFile != "") {
                 cout << "record epoch=" << netLearner->getNextEpoch() << endl;
-                WeightsPersister::persistWeights(config.weightsFile, config.getTrainingString(), net, netLearner->getNextEpoch(), 0, 0, 0, 0);
+                printWriteStatus(checkpointWriter->snapshot(config.weightsFile, config.getTrainingString(), net, netLearner->getNextEpoch(), 0, 0, 0, 0));
                 weightsWriteTimer.lap();
             }
 //            Sampler::sampleFloatWrapper("conv weights", net->getLayer(6)->getWeightsWrapper());
@@ -414,17 +466,28 @@ void go(Config config) {
                         "(" << ((float)nextBatch * 100.0f / netLearner->getNTrain() * config.batchSize) << "% of epoch)" <<
                         " numRight=" << batchNumRight << "(" << (batchNumRight * 100.0f / nextBatch / config.batchSize) << "%)" <<
                         " loss=" << batchLoss << endl;
-                    WeightsPersister::persistWeights(config.weightsFile, config.getTrainingString(), net,
-                        nextEpoch, nextBatch, 0, batchNumRight, batchLoss);
+                    printWriteStatus(checkpointWriter->snapshot(config.weightsFile, config.getTrainingString(), net,
+                        nextEpoch, nextBatch, 0, batchNumRight, batchLoss));
                     weightsWriteTimer.lap();
                 }
             }
         }
     }
 
+    printWriteStatus(checkpointWriter->flush());
+    delete checkpointWriter;
+    if(config.weightsStorage != "fp32" && config.weightsFile != "") {
+        string exportFile = config.weightsFile + "." + config.weightsStorage;
+        net->setWeightsStorage(config.weightsStorage);
+        WeightsPersister::persistWeights(exportFile, config.getTrainingString(), net, netLearner->getNextEpoch(), 0, 0, 0, 0);
+        net->setWeightsStorage("fp32");
+        cout << "wrote " << config.weightsStorage << " weights for inference to " << exportFile << endl;
+    }
+
     delete weightsInitializer;
     delete trainer;
     delete netLearner;
+    delete sampler;
     if(multiNet != 0) {
         delete multiNet;
     }
@@ -475,13 +538,18 @@ void printUsage(char *argv[], Config config) {
     cout << "    loadweights=[load weights from file at startup?] (" << config.loadWeights << ")" << endl;
     cout << "    weightsfile=[file to write weights to] (" << config.weightsFile << ")" << endl;
     cout << "    writeweightsinterval=[write weights every this many minutes] (" << config.writeWeightsInterval << ")" << endl;
+    cout << "    weightsstorage=[fp16 or bf16 also writes the final weights, at half the size, to weightsfile.fp16, or .bf16; checkpoints stay fp32] (" << config.weightsStorage << ")" << endl;
+    cout << "    fuselayers=[run each activation layer followed by max-pooling as one fused layer [1|0]] (" << config.fuseLayers << ")" << endl;
     cout << "    normalization=[[stddev|maxmin]] (" << config.normalization << ")" << endl;
     cout << "    normalizationnumstds=[with stddev normalization, how many stddevs from mean is 1?] (" << config.normalizationNumStds << ")" << endl;
     cout << "    dumptimings=[dump detailed timings each epoch? [1|0]] (" << config.dumpTimings << ")" << endl;
     cout << "    multinet=[number of Mcdnn columns to train] (" << config.multiNet << ")" << endl;
+    cout << "    multinetconcurrent=[with multinet, train each column on its own OpenCL context, concurrently? [1|0]] (" << config.multiNetConcurrent << ")" << endl;
     cout << "    loadondemand=[load data on demand [1|0]] (" << config.loadOnDemand << ")" << endl;
     cout << "    filereadbatches=[how many batches to read from file each time? (for loadondemand=1)] (" << config.fileReadBatches << ")" << endl;
     cout << "    normalizationexamples=[number of examples to read to determine normalization parameters] (" << config.normalizationExamples << ")" << endl;
+    cout << "    sampler=[order of training examples each epoch: sequential, shuffle (not with loadondemand), or block (shuffle blocks of samplerblocksize examples, then within each filereadbatches*batchsize window)] (" << config.sampler << ")" << endl;
+    cout << "    samplerblocksize=[for sampler=block, how many contiguous examples per block, must divide filereadbatches*batchsize; 0 means batchsize] (" << config.samplerBlockSize << ")" << endl;
     cout << "    weightsinitializer=[initializer for weights, choices: original, uniform (default: original)] (" << config.weightsInitializer << ")" << endl;
     cout << "    trainer=[which trainer, sgd, anneal, nesterov, adagrad, rmsprop, or adadelta (default: sgd)] (" << config.trainer << ")" << endl;
     cout << "    learningrate=[learning rate, a float value, used by all trainers] (" << config.learningRate << ")" << endl;
@@ -549,6 +617,10 @@ int main(int argc, char *argv[]) {
                 config.weightsFile = (value);
             } else if(key == "writeweightsinterval") {
                 config.writeWeightsInterval = atof(value);
+            } else if(key == "weightsstorage") {
+                config.weightsStorage = (value);
+            } else if(key == "fuselayers") {
+                config.fuseLayers = atoi(value);
             } else if(key == "normalization") {
                 config.normalization = (value);
             } else if(key == "normalizationnumstds") {
@@ -557,12 +629,18 @@ int main(int argc, char *argv[]) {
                 config.dumpTimings = atoi(value);
             } else if(key == "multinet") {
                 config.multiNet = atoi(value);
+            } else if(key == "multinetconcurrent") {
+                config.multiNetConcurrent = atoi(value);
             } else if(key == "loadondemand") {
                 config.loadOnDemand = atoi(value);
             } else if(key == "filereadbatches") {
                 config.fileReadBatches = atoi(value);
             } else if(key == "normalizationexamples") {
                 config.normalizationExamples = atoi(value);
+            } else if(key == "sampler") {
+                config.sampler = (value);
+            } else if(key == "samplerblocksize") {
+                config.samplerBlockSize = atoi(value);
             } else if(key == "weightsinitializer") {
                 config.weightsInitializer = (value);
             } else if(key == "initialweights") {
@@ -0,0 +1,132 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+#include <algorithm>
+
+#include "util/stringhelper.h"
+#include "net/MemoryPlanner.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+namespace {
+    // orders tensor indices by the step that writes them, then by index
+    class ByFirstStep {
+    public:
+        vector<int> const &firstStep;
+        ByFirstStep(vector<int> const &firstStep) :
+            firstStep(firstStep) {
+        }
+        bool operator()(int a, int b) const {
+            if(firstStep[a] != firstStep[b]) {
+                return firstStep[a] < firstStep[b];
+            }
+            return a < b;
+        }
+    };
+}
+
+PUBLIC MemoryPlanner::MemoryPlanner() {
+}
+// returns the new tensor's index; inPlaceOf is a tensor already added, or -1
+PUBLIC int MemoryPlanner::addTensor(int numElements, int firstStep, int lastStep, int inPlaceOf) {
+    const int tensor = (int)this->numElements.size();
+    if(numElements <= 0) {
+        throw runtime_error("MemoryPlanner::addTensor: tensor " + toString(tensor) + " has " + toString(numElements) + " elements");
+    }
+    if(lastStep < firstStep) {
+        throw runtime_error("MemoryPlanner::addTensor: tensor " + toString(tensor) + " is last read at step " + toString(lastStep) + ", before it is written, at step " + toString(firstStep));
+    }
+    if(inPlaceOf >= tensor) {
+        throw runtime_error("MemoryPlanner::addTensor: tensor " + toString(tensor) + " cant overwrite tensor " + toString(inPlaceOf) + ", which hasnt been added yet");
+    }
+    this->numElements.push_back(numElements);
+    this->firstStep.push_back(firstStep);
+    this->lastStep.push_back(lastStep);
+    this->inPlaceOf.push_back(inPlaceOf);
+    return tensor;
+}
+// a buffer is free for a tensor once the buffer's last tensor has been read for the
+// last time, at an earlier step than the one that writes the new tensor
+PUBLIC void MemoryPlanner::plan() {
+    const int numTensors = getNumTensors();
+    bufferOf.assign(numTensors, -1);
+    bufferSizes.clear();
+    vector<int> busyUntil; // per buffer, last step its tensors are read
+    vector<bool> overwritten(numTensors, false); // by a tensor in place
+    vector<int> order(numTensors);
+    for(int tensor = 0; tensor < numTensors; tensor++) {
+        order[tensor] = tensor;
+    }
+    sort(order.begin(), order.end(), ByFirstStep(firstStep));
+    for(int i = 0; i < numTensors; i++) {
+        const int tensor = order[i];
+        const int need = numElements[tensor];
+        int buffer = -1;
+        const int source = inPlaceOf[tensor];
+        const bool inPlace = source >= 0 && lastStep[source] == firstStep[tensor] && !overwritten[source];
+        if(inPlace) {
+            buffer = bufferOf[source];
+            overwritten[source] = true;
+        }
+        for(int candidate = 0; buffer == -1 && candidate < (int)bufferSizes.size(); candidate++) {
+            if(busyUntil[candidate] < firstStep[tensor]) {
+                buffer = candidate;
+            }
+        }
+        if(buffer != -1 && !inPlace) {
+            // best fit: the smallest free buffer that is big enough, else the biggest one
+            for(int candidate = buffer + 1; candidate < (int)bufferSizes.size(); candidate++) {
+                if(busyUntil[candidate] >= firstStep[tensor]) {
+                    continue;
+                }
+                const bool fits = bufferSizes[candidate] >= need;
+                const bool bestFits = bufferSizes[buffer] >= need;
+                if(fits && (!bestFits || bufferSizes[candidate] < bufferSizes[buffer])) {
+                    buffer = candidate;
+                } else if(!fits && !bestFits && bufferSizes[candidate] > bufferSizes[buffer]) {
+                    buffer = candidate;
+                }
+            }
+        }
+        if(buffer == -1) {
+            buffer = (int)bufferSizes.size();
+            bufferSizes.push_back(0);
+            busyUntil.push_back(-1);
+        }
+        bufferOf[tensor] = buffer;
+        bufferSizes[buffer] = max(bufferSizes[buffer], need);
+        busyUntil[buffer] = max(busyUntil[buffer], lastStep[tensor]);
+    }
+}
+PUBLIC int MemoryPlanner::getNumTensors() const {
+    return (int)numElements.size();
+}
+PUBLIC int MemoryPlanner::getNumBuffers() const {
+    return (int)bufferSizes.size();
+}
+// floats needed if each tensor had its own buffer
+PUBLIC long MemoryPlanner::getUnplannedSize() const {
+    long total = 0;
+    for(int tensor = 0; tensor < getNumTensors(); tensor++) {
+        total += numElements[tensor];
+    }
+    return total;
+}
+// floats in the planned buffers
+PUBLIC long MemoryPlanner::getPlannedSize() const {
+    long total = 0;
+    for(int buffer = 0; buffer < getNumBuffers(); buffer++) {
+        total += bufferSizes[buffer];
+    }
+    return total;
+}
+
@@ -0,0 +1,57 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// assigns tensors, each written at one step, and last read at a later, or the same,
+// step, to as few buffers as it can, by reusing a buffer once its tensor is dead
+// a tensor can overwrite, in place, the tensor it was calculated from, if that one
+// is last read at the step that writes it, eg for element-wise layers
+// buffers are picked best-fit, and grow to their largest tensor
+// used by NeuralNet::setShareActivations, with one step per layer
+class DeepCL_EXPORT MemoryPlanner {
+    public:
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    // per tensor, in the order they were added
+    std::vector<int> numElements;
+    std::vector<int> firstStep; // step that writes it
+    std::vector<int> lastStep; // last step that reads it
+    std::vector<int> inPlaceOf; // tensor it may overwrite, or -1
+
+    // filled by plan()
+    std::vector<int> bufferOf; // per tensor
+    std::vector<int> bufferSizes; // in floats
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    MemoryPlanner();
+    int addTensor(int numElements, int firstStep, int lastStep, int inPlaceOf);
+    void plan();
+    int getNumTensors() const;
+    int getNumBuffers() const;
+    long getUnplannedSize() const;
+    long getPlannedSize() const;
+
+    // [[[end]]]
+};
+
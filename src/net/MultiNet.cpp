@@ -11,6 +11,13 @@
 #include "input/InputLayer.h"
 #include "layer/LayerMaker.h"
 #include "input/InputLayerMaker.h"
+#include "clmath/CopyBuffer.h"
+#include "clmath/GpuAdd.h"
+#include "clmath/MultiplyInPlace.h"
+#include "trainers/Trainer.h"
+#include "util/ThreadPool.h"
+#include "util/StatefulTimer.h"
+#include "EasyCL.h"
 
 #include "net/MultiNet.h"
 
@@ -21,21 +28,74 @@ using namespace std;
 #define STATIC
 #define VIRTUAL
 
-MultiNet::MultiNet(int numNets, NeuralNet *model) :
-        output(0),
-        batchSize(0),
-        allocatedSize(0),
-        proxyInputLayer(0),
-        lossLayer(0) {
+namespace {
+    // one column per task; getOutput() too, so each column copies its output
+    // back to host while the others are still running
+    class ColumnForwardTask : public ThreadPoolTask {
+    public:
+        vector< Trainable * > *columns;
+        float const *images;
+        virtual void run(int threadId, int taskId) {
+            (*columns)[taskId]->forward(images);
+            (*columns)[taskId]->getOutput();
+        }
+    };
+    class ColumnBackwardTask : public ThreadPoolTask {
+    public:
+        vector< Trainable * > *columns;
+        float const *expectedOutput;
+        int const *labels; // if not 0, we use these, rather than expectedOutput
+        virtual void run(int threadId, int taskId) {
+            if(labels != 0) {
+                (*columns)[taskId]->backwardFromLabels(labels);
+            } else {
+                (*columns)[taskId]->backward(expectedOutput);
+            }
+        }
+    };
+}
+
+MultiNet::MultiNet(int numNets, NeuralNet *model) {
+    init(numNets, model, false);
+}
+// if concurrent, each column after the first gets its own EasyCL context, so the
+// columns can run at the same time, on ThreadPool, and we average on the host.
+// Otherwise the columns share the model's context, run one after the other, and
+// we average on the device, if their output is there
+MultiNet::MultiNet(int numNets, NeuralNet *model, bool concurrent) {
+    init(numNets, model, concurrent);
+}
+void MultiNet::init(int numNets, NeuralNet *model, bool concurrent) {
+    output = 0;
+    batchSize = 0;
+    allocatedSize = 0;
+    proxyInputLayer = 0;
+    lossLayer = 0;
+    cl = model->getCl();
+    outputWrapper = 0;
+    copyBuffer = 0;
+    gpuAdd = 0;
+    multiplyInPlace = 0;
+    this->concurrent = concurrent && numNets > 1;
 //    trainables.push_back(model);
     for(int i = 0; i < numNets; i++) {
-        trainables.push_back(model->clone());
+        EasyCL *columnCl = cl;
+        if(this->concurrent && i > 0 && cl != 0) {
+            columnCl = EasyCL::createForPlatformDeviceIds(cl->platform_id, cl->device);
+            columnCls.push_back(columnCl);
+        }
+        trainables.push_back(model->clone(columnCl));
     }
     InputLayerMaker *inputLayerMaker = InputLayerMaker::instance();
     inputLayerMaker->numPlanes(trainables[0]->getOutputPlanes());
     inputLayerMaker->imageSize(trainables[0]->getOutputSize());
     proxyInputLayer = new InputLayer(inputLayerMaker);
     lossLayer = dynamic_cast< LossLayer *>(trainables[0]->cloneLossLayerMaker()->createLayer(proxyInputLayer));
+    if(!this->concurrent && childrenHaveOutputWrappers()) {
+        copyBuffer = new CopyBuffer(cl);
+        gpuAdd = new GpuAdd(cl);
+        multiplyInPlace = new MultiplyInPlace(cl);
+    }
 }
 VIRTUAL MultiNet::~MultiNet() {
     if(proxyInputLayer != 0) {
@@ -44,12 +104,25 @@ VIRTUAL MultiNet::~MultiNet() {
     if(lossLayer != 0) {
         delete lossLayer;
     }
+    delete copyBuffer;
+    delete gpuAdd;
+    delete multiplyInPlace;
+    if(outputWrapper != 0) {
+        delete outputWrapper;
+    }
     if(output != 0) {
         delete[] output;
     }
     for(vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++) {
         delete (*it);
     }    
+    for(vector< Trainer * >::iterator it = columnTrainers.begin(); it != columnTrainers.end(); it++) {
+        delete (*it);
+    }
+    // after everything that lives on them
+    for(vector< EasyCL * >::iterator it = columnCls.begin(); it != columnCls.end(); it++) {
+        delete (*it);
+    }
 }
 VIRTUAL int MultiNet::getInputCubeSize() const {
     return trainables[0]->getInputCubeSize();
@@ -113,12 +186,20 @@ VIRTUAL void MultiNet::setBatchSize(int batchSize) {
         this->batchSize = batchSize;
         return;
     }
+    if(outputWrapper != 0) {
+        delete outputWrapper;
+        outputWrapper = 0;
+    }
     if(output != 0) {
         delete[] output;
     }
     this->batchSize = batchSize;
     this->allocatedSize = batchSize;
     output = new float[ trainables[0]->getOutputNumElements() ];
+    if(gpuAdd != 0) {
+        outputWrapper = cl->wrap(trainables[0]->getOutputNumElements(), output);
+        outputWrapper->createOnDevice();
+    }
 }
 VIRTUAL void MultiNet::setTraining(bool training) {
     for(vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++) {
@@ -143,40 +224,106 @@ VIRTUAL int MultiNet::calcNumRight(int const *labels) {
     }
     return softMaxLayer->calcNumRightFromLabels(labels);
 }
+// the children are clones of the same model, so either all of them keep their
+// output on the device, or none of them do
+bool MultiNet::childrenHaveOutputWrappers() {
+    NeuralNet *child = dynamic_cast< NeuralNet * >(trainables[0]);
+    return child != 0 && child->getLastLayer()->hasOutputWrapper();
+}
 void MultiNet::forwardToOurselves() {
     // now forward to ourselves :-)
-    // I suppose this could be done in GPU, but what if we want to split across mpi?
     const int outputNumElements = trainables[0]->getOutputNumElements();
-    memset(output, 0, sizeof(float) * outputNumElements);
-    for(vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++) {
-        float const*childOutput = (*it)->getOutput();
-        for(int i = 0; i < outputNumElements; i++) {
-            output[i] += childOutput[i];
-        }
-    }    
     const int numChildren = (int)trainables.size();
-    for(int i = 0; i < outputNumElements; i++) {
-        output[i] /= numChildren;
+    if(outputWrapper != 0) {
+        for(int i = 0; i < numChildren; i++) {
+            CLWrapper *childWrapper = dynamic_cast< NeuralNet * >(trainables[i])->getLastLayer()->getOutputWrapper();
+            if(i == 0) {
+                copyBuffer->copy(outputNumElements, childWrapper, outputWrapper);
+            } else {
+                gpuAdd->add(outputNumElements, outputWrapper, childWrapper);
+            }
+        }
+        multiplyInPlace->multiply(outputNumElements, 1.0f / numChildren, outputWrapper);
+        outputWrapper->copyToHost();
+    } else {
+        // one pass over each child, with the division folded into the last one
+        const float inverseNumChildren = 1.0f / numChildren;
+        memcpy(output, trainables[0]->getOutput(), sizeof(float) * outputNumElements);
+        for(int child = 1; child < numChildren; child++) {
+            float const*childOutput = trainables[child]->getOutput();
+            if(child == numChildren - 1) {
+                for(int i = 0; i < outputNumElements; i++) {
+                    output[i] = (output[i] + childOutput[i]) * inverseNumChildren;
+                }
+            } else {
+                for(int i = 0; i < outputNumElements; i++) {
+                    output[i] += childOutput[i];
+                }
+            }
+        }
     }
     memcpy(dynamic_cast< SoftMaxLayer * >(lossLayer)->output, output, sizeof(float) * lossLayer->getOutputNumElements());
 //    proxyInputLayer->in(output);
 }
 VIRTUAL void MultiNet::forward(float const*images) {
-    for(vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++) {
-        (*it)->forward(images);
-    }
+    ColumnForwardTask task;
+    task.columns = &trainables;
+    task.images = images;
+    runColumns(&task);
     forwardToOurselves();
 }
 VIRTUAL void MultiNet::backwardFromLabels(int const *labels) {
     // dont think we need to backprop onto ourselves?  Just direclty onto children, right?
-    for(vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++) {
-        (*it)->backwardFromLabels(labels);
-    }
+    ColumnBackwardTask task;
+    task.columns = &trainables;
+    task.expectedOutput = 0;
+    task.labels = labels;
+    runColumns(&task);
 }
 VIRTUAL void MultiNet::backward(float const *expectedOutput) {
-    for(vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++) {
-        (*it)->backward(expectedOutput);
+    ColumnBackwardTask task;
+    task.columns = &trainables;
+    task.expectedOutput = expectedOutput;
+    task.labels = 0;
+    runColumns(&task);
+}
+// runs task once per column, concurrently if we can; the timings StatefulTimer
+// collects are process-wide, so we stay on one thread while it is enabled
+void MultiNet::runColumns(ThreadPoolTask *task) {
+    const int numColumns = (int)trainables.size();
+    if(concurrent && !StatefulTimer::enabled) {
+        ThreadPool::instance()->run(numColumns, task);
+    } else {
+        for(int i = 0; i < numColumns; i++) {
+            task->run(0, i);
+        }
+    }
+}
+bool MultiNet::isConcurrent() const {
+    return concurrent;
+}
+EasyCL *MultiNet::getColumnCl(int column) {
+    return dynamic_cast< NeuralNet * >(trainables[column])->getCl();
+}
+// the trainer to use for one column: trainer itself, if the column is on its context,
+// otherwise a clone of trainer on the column's context, which we keep, and own
+Trainer *MultiNet::getColumnTrainer(int column, Trainer *trainer) {
+    EasyCL *columnCl = getColumnCl(column);
+    if(columnCl == trainer->cl) {
+        return trainer;
+    }
+    if(columnTrainers.size() != trainables.size()) {
+        columnTrainers.resize(trainables.size(), 0);
+        columnTrainerSources.resize(trainables.size(), 0);
+    }
+    if(columnTrainerSources[column] != trainer) {
+        delete columnTrainers[column];
+        columnTrainers[column] = trainer->clone(columnCl);
+        columnTrainerSources[column] = trainer;
     }
+    // eg changed by setLearningRate, since we cloned it
+    columnTrainers[column]->setLearningRate(trainer->learningRate);
+    return columnTrainers[column];
 }
 VIRTUAL float const *MultiNet::getOutput() const {
     return output;
@@ -18,6 +18,13 @@
 #include "DeepCLDllExport.h"
 
 class LossLayer;
+class EasyCL;
+class CLWrapper;
+class CopyBuffer;
+class GpuAdd;
+class MultiplyInPlace;
+class ThreadPoolTask;
+class Trainer;
 
 class NeuralNet;
 
@@ -30,6 +37,20 @@ class DeepCL_EXPORT MultiNet : public Trainable {
     InputLayer *proxyInputLayer; // used to feed in output from children, to give to lossLayer
     LossLayer *lossLayer;
 
+    // if the children keep their output on the device, we average there, and only
+    // copy the average to host, rather than each child's output
+    EasyCL *cl; // NOT owned by us
+    CLWrapper *outputWrapper;
+    CopyBuffer *copyBuffer;
+    GpuAdd *gpuAdd;
+    MultiplyInPlace *multiplyInPlace;
+
+    // if concurrent, columns after the first run on their own contexts, which we own
+    bool concurrent;
+    std::vector<EasyCL *> columnCls;
+    std::vector<Trainer *> columnTrainers; // per column, for columns not on the trainer's context
+    std::vector<Trainer *> columnTrainerSources; // the trainer each columnTrainer was cloned from
+
 public:
     // [[[cog
     // import cog_addheaders
@@ -37,6 +58,8 @@ public:
     // ]]]
     // generated, using cog:
     MultiNet(int numNets, NeuralNet *model);
+    MultiNet(int numNets, NeuralNet *model, bool concurrent);
+    void init(int numNets, NeuralNet *model, bool concurrent);
     VIRTUAL ~MultiNet();
     VIRTUAL int getInputCubeSize() const;
     VIRTUAL int getOutputCubeSize() const;
@@ -49,10 +72,15 @@ public:
     VIRTUAL void setBatchSize(int batchSize);
     VIRTUAL void setTraining(bool training);
     VIRTUAL int calcNumRight(int const *labels);
+    bool childrenHaveOutputWrappers();
     void forwardToOurselves();
     VIRTUAL void forward(float const*images);
     VIRTUAL void backwardFromLabels(int const *labels);
     VIRTUAL void backward(float const *expectedOutput);
+    void runColumns(ThreadPoolTask *task);
+    bool isConcurrent() const;
+    EasyCL *getColumnCl(int column);
+    Trainer *getColumnTrainer(int column, Trainer *trainer);
     VIRTUAL float const *getOutput() const;
     VIRTUAL int getNumNets() const;
     VIRTUAL Trainable *getNet(int idx);
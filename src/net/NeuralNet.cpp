@@ -25,7 +25,10 @@
 #include "trainers/Trainer.h"
 #include "trainers/TrainerMaker.h"
 #include "weights/WeightsPersister.h"
+#include "activate/ActivationLayer.h"
+#include "pooling/PoolingLayer.h"
 #include "CppRuntimeBoundary.h"
+#include "net/MemoryPlanner.h"
 
 #include "net/NeuralNet.h"
 
@@ -41,6 +44,11 @@ using namespace std;
 NeuralNet::NeuralNet(EasyCL *cl) :
         cl(cl) {
     trainer = 0;
+    weightsStorage = WeightsPersister::DTYPE_FLOAT32;
+    inferenceOnly = false;
+    deviceWeights = WeightsPersister::DTYPE_FLOAT32;
+    shareActivations = false;
+    plannedBatchSize = 0;
     isTraining = true;
 }
 STATIC NeuralNet *NeuralNet::instance(EasyCL *cl) {
@@ -58,25 +66,40 @@ void NeuralNet::deleteMe() {
 /// Constructor
 NeuralNet::NeuralNet(EasyCL *cl, int numPlanes, int imageSize) :
         cl(cl) {
+    inferenceOnly = false;
+    deviceWeights = WeightsPersister::DTYPE_FLOAT32;
+    shareActivations = false;
+    plannedBatchSize = 0;
     addLayer(InputLayerMaker::instance()->numPlanes(numPlanes)->imageSize(imageSize) );
     trainer = 0;
+    weightsStorage = WeightsPersister::DTYPE_FLOAT32;
 }
 NeuralNet::~NeuralNet() {
     for(int i = 0; i < (int)layers.size(); i++) {
         delete layers[i];
     }
+    freeActivationMemory();
 }
 STATIC NeuralNetMould *NeuralNet::maker(EasyCL *cl) {
     return new NeuralNetMould(cl);
 }
 NeuralNet *NeuralNet::clone() {
+    return clone(cl);
+}
+// copies the structure, but not the weights, onto the given context, eg so
+// MultiNet can run each column on its own context
+NeuralNet *NeuralNet::clone(EasyCL *cl) {
     NeuralNet *copy = new NeuralNet(cl);
+    copy->inferenceOnly = inferenceOnly;
+    copy->deviceWeights = deviceWeights;
+    copy->shareActivations = shareActivations;
     for(vector<Layer *>::iterator it = layers.begin(); it != layers.end(); it++) {
         LayerMaker2 *maker = (*it)->maker;
 
         LayerMaker2 *makerCopy = maker->clone();
         copy->addLayer(makerCopy);
     }
+    copy->weightsStorage = weightsStorage;
     copy->print();
     cout << "outputimagesize: " << copy->getOutputSize() << endl;
     return copy;
@@ -84,12 +107,199 @@ NeuralNet *NeuralNet::clone() {
 EasyCL *NeuralNet::getCl() {
     return cl;
 }
+/// \brief Choose how weights files store this net's weights: "fp32" (default), "fp16", "bf16" or "int8"
+///
+/// fp16 and bf16 halve the file size; the net itself keeps, and trains, fp32 weights,
+/// which are rounded when written, and converted back when loaded
+/// int8 quarters the convolutional and fully-connected weights, and needs the net
+/// to have been calibrated first, see Int8Quantizer
+PUBLICAPI void NeuralNet::setWeightsStorage(std::string dtypeName) {
+    weightsStorage = WeightsPersister::dtypeFromName(dtypeName);
+}
+PUBLICAPI int NeuralNet::getWeightsStorage() const {
+    return weightsStorage;
+}
+/// \brief Build this net for forward propagation only, eg for deepcl_predict
+///
+/// Layers added afterwards allocate no gradients, gradInput or trainer state, and
+/// dont compile their backward kernels, so serving a net needs about half the memory,
+/// and kernel build time.  backward, and setting up a trainer, then throw.  Call before
+/// adding any layers, other than the input layer.
+PUBLICAPI void NeuralNet::setInferenceOnly(bool inferenceOnly) {
+    if(layers.size() > 1) {
+        throw runtime_error("setInferenceOnly must be called before adding layers, other than the input layer");
+    }
+    if(!inferenceOnly && deviceWeights != WeightsPersister::DTYPE_FLOAT32) {
+        throw runtime_error("nets with 16-bit weights on the device are inference-only, see setDeviceWeights");
+    }
+    this->inferenceOnly = inferenceOnly;
+}
+PUBLICAPI bool NeuralNet::getInferenceOnly() const {
+    return inferenceOnly;
+}
+/// \brief Keep convolutional and fully-connected weights on the device as "fp16" or "bf16", or "fp32" (default)
+///
+/// Halves the gpu memory, and the memory traffic, for the weights.  The forward kernels
+/// read each weight as a float, so sums stay fp32, and the layers keep fp32 weights on
+/// the host, for getWeights and weights files.  Only for inference-only nets, since
+/// training needs fp32 weights on the device: call after setInferenceOnly(true), and
+/// before adding any layers, other than the input layer.
+PUBLICAPI void NeuralNet::setDeviceWeights(std::string dtypeName) {
+    if(layers.size() > 1) {
+        throw runtime_error("setDeviceWeights must be called before adding layers, other than the input layer");
+    }
+    const int dtype = WeightsPersister::dtypeFromName(dtypeName);
+    if(dtype == WeightsPersister::DTYPE_INT8) {
+        throw runtime_error("int8 weights run on the cpu, see Int8Predictor, so choose fp32, fp16 or bf16 for the device");
+    }
+    if(dtype != WeightsPersister::DTYPE_FLOAT32 && !inferenceOnly) {
+        throw runtime_error("setDeviceWeights(\"" + dtypeName + "\") needs an inference-only net, see setInferenceOnly");
+    }
+    deviceWeights = dtype;
+}
+PUBLICAPI int NeuralNet::getDeviceWeights() const {
+    return deviceWeights;
+}
+/// \brief Let layers share their output buffers, once the layers reading them have run
+///
+/// Each layer's output is only read by the next layer, so setBatchSize plans the
+/// outputs into a few buffers, reused once dead, and element-wise layers, activation
+/// and dropout, overwrite their input in place.  For a deep net this needs a fraction
+/// of the activation memory.  The outputs of the net, ie of the last layer, and of
+/// the layer a loss layer reads, keep their own buffers, but the outputs of the other
+/// layers, getOutput(layer), are not kept after forward: once a later layer has written
+/// over a layer's output, its getOutput and getOutputWrapper throw.  Needs an
+/// inference-only net, see setInferenceOnly, since backward reads every layer's output.
+PUBLICAPI void NeuralNet::setShareActivations(bool share) {
+    if(share && !inferenceOnly) {
+        throw runtime_error("setShareActivations needs an inference-only net, see setInferenceOnly");
+    }
+    if(!share) {
+        for(int layerIdx = 0; layerIdx < (int)layers.size(); layerIdx++) {
+            if(layers[layerIdx]->outputShared) {
+                layers[layerIdx]->setSharedOutput(0, 0);
+            }
+            layers[layerIdx]->outputOverwritten = false;
+        }
+        freeActivationMemory();
+        activationBufferOf.clear();
+    }
+    this->shareActivations = share;
+    plannedBatchSize = 0;
+}
+PUBLICAPI bool NeuralNet::getShareActivations() const {
+    return shareActivations;
+}
+// one step per layer, in forward order; a layer's output is written at its own step,
+// and last read at the next one, or later, if the next layer only passes it on, as
+// loss layers do.  a fused activation layer's step writes the pooling layer's output,
+// and its own output is only calculated on demand, after forward
+void NeuralNet::planActivationMemory(int batchSize) {
+    const int numLayers = (int)layers.size();
+    const int end = numLayers;
+    vector<int> firstStep(numLayers);
+    vector<int> lastStep(numLayers);
+    for(int layerIdx = numLayers - 1; layerIdx >= 0; layerIdx--) {
+        firstStep[layerIdx] = layerIdx;
+        if(layerIdx == numLayers - 1) {
+            lastStep[layerIdx] = end;
+        } else if(layers[layerIdx + 1]->aliasesPreviousOutput()) {
+            lastStep[layerIdx] = lastStep[layerIdx + 1];
+        } else {
+            lastStep[layerIdx] = layerIdx + 1;
+        }
+    }
+    for(int layerIdx = 1; layerIdx + 1 < numLayers; layerIdx++) {
+        ActivationLayer *activationLayer = dynamic_cast<ActivationLayer *>(layers[layerIdx]);
+        if(activationLayer != 0 && activationLayer->fusedPoolingLayer != 0) {
+            firstStep[layerIdx] = end;
+            lastStep[layerIdx] = end;
+            firstStep[layerIdx + 1] = layerIdx;
+        }
+    }
+    MemoryPlanner planner;
+    vector<int> tensorOf(numLayers, -1);
+    for(int layerIdx = 0; layerIdx < numLayers; layerIdx++) {
+        Layer *layer = layers[layerIdx];
+        const bool isNetOutput = lastStep[layerIdx] == end && firstStep[layerIdx] < end;
+        if(!layer->canShareOutput() || isNetOutput) {
+            continue;
+        }
+        const int inPlaceOf = layerIdx > 0 && layer->canForwardInPlace() ? tensorOf[layerIdx - 1] : -1;
+        const int numElements = batchSize * layer->getOutputPlanes() * layer->getOutputSize() * layer->getOutputSize();
+        tensorOf[layerIdx] = planner.addTensor(numElements, firstStep[layerIdx], lastStep[layerIdx], inPlaceOf);
+    }
+    planner.plan();
+
+    vector<float *> arrays;
+    vector<CLWrapper *> wrappers;
+    for(int buffer = 0; buffer < planner.getNumBuffers(); buffer++) {
+        float *array = new float[planner.bufferSizes[buffer]];
+        CLWrapper *wrapper = cl->wrap(planner.bufferSizes[buffer], array);
+        wrapper->createOnDevice();
+        arrays.push_back(array);
+        wrappers.push_back(wrapper);
+    }
+    // a fused activation layer writes its output on demand, after forward, so isnt
+    // counted as overwriting anything, see forward
+    activationBufferOf.assign(numLayers, -1);
+    for(int layerIdx = 0; layerIdx < numLayers; layerIdx++) {
+        const int tensor = tensorOf[layerIdx];
+        if(tensor != -1) {
+            const int buffer = planner.bufferOf[tensor];
+            layers[layerIdx]->setSharedOutput(arrays[buffer], wrappers[buffer]);
+            activationBufferOf[layerIdx] = firstStep[layerIdx] < end ? buffer : -1;
+        } else if(layers[layerIdx]->outputShared) {
+            layers[layerIdx]->setSharedOutput(0, 0);
+        }
+        layers[layerIdx]->outputOverwritten = false;
+    }
+    freeActivationMemory();
+    activationArrays = arrays;
+    activationWrappers = wrappers;
+    plannedBatchSize = batchSize;
+}
+void NeuralNet::freeActivationMemory() {
+    for(int buffer = 0; buffer < (int)activationWrappers.size(); buffer++) {
+        delete activationWrappers[buffer];
+        delete[] activationArrays[buffer];
+    }
+    activationWrappers.clear();
+    activationArrays.clear();
+}
+/// \brief Run each activation layer that is followed by a max-pooling layer as one fused layer, returns the number fused
+///
+/// The fused layer applies the activation inside the pooling window, so the activated,
+/// unpooled, values never go through global memory, and backprops through both layers
+/// in one pass.  Layer indices, weights files, and outputs are unchanged; the activation
+/// layer's own output is just calculated on demand.  Call after all layers are added.
+/// Convolutions add their bias in the same kernel already.
+PUBLICAPI int NeuralNet::fuseLayers() {
+    int numFused = 0;
+    for(int layerIdx = 1; layerIdx + 1 < (int)layers.size(); layerIdx++) {
+        ActivationLayer *activationLayer = dynamic_cast<ActivationLayer *>(layers[layerIdx]);
+        PoolingLayer *poolingLayer = dynamic_cast<PoolingLayer *>(layers[layerIdx + 1]);
+        if(activationLayer == 0 || poolingLayer == 0 || poolingLayer->fusedIntoPreviousLayer) {
+            continue;
+        }
+        activationLayer->fuseWithPoolingLayer(poolingLayer);
+        numFused++;
+    }
+    if(numFused > 0 && plannedBatchSize > 0) {
+        // fused activation outputs are read later than before, so plan again
+        planActivationMemory(plannedBatchSize);
+    }
+    return numFused;
+}
 /// Add a network layer, using a LayerMaker2 object
 PUBLICAPI void NeuralNet::addLayer(LayerMaker2 *maker) {
 //    cout << "neuralnet::insert numplanes " << inputLayerMaker._numPlanes << " imageSize " << inputLayerMaker._imageSize << endl;
     maker->setCl(cl);
+    maker->setInferenceOnly(inferenceOnly);
+    maker->setDeviceWeights(deviceWeights);
     Layer *layer = maker->createLayer(getLastLayer());
     layers.push_back(layer);
+    plannedBatchSize = 0;
 }
 PUBLICAPI void NeuralNet::initWeights(int layerIndex, float *weights, float *bias) {
     initWeights(layerIndex, weights);
@@ -167,6 +377,9 @@ PUBLICAPI VIRTUAL int NeuralNet::getOutputSize() const {
     return getLastLayer()->getOutputSize();
 }
 PUBLICAPI void NeuralNet::setBatchSize(int batchSize) {
+    if(shareActivations && (plannedBatchSize == 0 || batchSize > plannedBatchSize)) {
+        planActivationMemory(batchSize);
+    }
     for(std::vector<Layer*>::iterator it = layers.begin(); it != layers.end(); it++) {
         (*it)->setBatchSize(batchSize);
     }
@@ -186,14 +399,31 @@ PUBLICAPI int NeuralNet::calcNumRight(int const *labels) {
 PUBLICAPI void NeuralNet::forward(float const*images) {
     // forward...
     dynamic_cast<InputLayer *>(layers[0])->in(images);
+    // with shared activations, a layer's output is gone once a later layer writes to
+    // the same buffer, so we note that, and its getOutput then throws
+    const bool trackOverwrites = shareActivations && activationBufferOf.size() == layers.size();
+    vector<int> bufferWriter(activationWrappers.size(), -1);
+    for(int layerId = 0; layerId < (int)layers.size(); layerId++) {
+        layers[layerId]->outputOverwritten = false;
+    }
     for(int layerId = 0; layerId < (int)layers.size(); layerId++) {
         StatefulTimer::setPrefix("layer" + toString(layerId) + " ");
         layers[layerId]->forward();
         StatefulTimer::setPrefix("");
+        const int buffer = trackOverwrites ? activationBufferOf[layerId] : -1;
+        if(buffer != -1) {
+            if(bufferWriter[buffer] != -1) {
+                layers[bufferWriter[buffer]]->outputOverwritten = true;
+            }
+            bufferWriter[buffer] = layerId;
+        }
     }
 }
 /// \brief note: this does no learning, just calculates the gradients
 PUBLICAPI void NeuralNet::backwardFromLabels(int const *labels) {
+    if(inferenceOnly) {
+        throw std::runtime_error("Cannot backprop through a net that is inference-only, see setInferenceOnly");
+    }
     IAcceptsLabels *acceptsLabels = dynamic_cast<IAcceptsLabels*>(getLastLayer());
     if(acceptsLabels == 0) {
         throw std::runtime_error("Must add a child of IAcceptsLabels as last layer, to use backwardFromLabels");
@@ -210,6 +440,9 @@ PUBLICAPI void NeuralNet::backwardFromLabels(int const *labels) {
 }
 /// \brief note: this does no learning, just calculates the gradients
 PUBLICAPI void NeuralNet::backward(float const *expectedOutput) {
+    if(inferenceOnly) {
+        throw std::runtime_error("Cannot backprop through a net that is inference-only, see setInferenceOnly");
+    }
     LossLayer *lossLayer = dynamic_cast<LossLayer*>(getLastLayer());
     if(lossLayer == 0) {
         throw std::runtime_error("Must add a LossLayer as last layer of net");
@@ -222,6 +455,9 @@ PUBLICAPI void NeuralNet::backward(float const *expectedOutput) {
     }
 }
 void NeuralNet::backward(OutputData *outputData) {
+    if(inferenceOnly) {
+        throw std::runtime_error("Cannot backprop through a net that is inference-only, see setInferenceOnly");
+    }
     LossLayer *lossLayer = dynamic_cast<LossLayer*>(getLastLayer());
     lossLayer->calcGradInput(outputData);
     for(int layerIdx = (int)layers.size() - 2; layerIdx >= 1; layerIdx--) { // no point in propagating to input layer
@@ -26,6 +26,7 @@ class EpochMaker;
 class InputMaker;
 class InputLayer;
 class OutputData;
+class CLWrapper;
 
 #define VIRTUAL virtual
 #define STATIC static
@@ -38,11 +39,19 @@ protected:
 #pragma warning(disable: 4251)
 #endif
     std::vector< Layer *> layers;
+    std::vector< float *> activationArrays; // shared by layer outputs, see setShareActivations
+    std::vector< CLWrapper *> activationWrappers;
+    std::vector< int > activationBufferOf; // per layer, the activation buffer forward writes its output to, or -1
 #ifdef _WIN32
 #pragma warning(default: 4251)
 #endif
     EasyCL *cl; // NOT owned by us, dont delete
     Trainer *trainer; // NOT owned by us, dont delete
+    int weightsStorage; // WeightsPersister::DTYPE_FLOAT32, etc
+    bool inferenceOnly;
+    int deviceWeights; // WeightsPersister::DTYPE_FLOAT32, etc, see setDeviceWeights
+    bool shareActivations;
+    int plannedBatchSize; // activationArrays are planned for this, 0 if not planned yet
 
 public:
     int isTraining; // = true;
@@ -61,7 +70,19 @@ public:
     ~NeuralNet();
     STATIC NeuralNetMould *maker(EasyCL *cl);
     NeuralNet *clone();
+    NeuralNet *clone(EasyCL *cl);
     EasyCL *getCl();
+    PUBLICAPI void setWeightsStorage(std::string dtypeName);
+    PUBLICAPI int getWeightsStorage() const;
+    PUBLICAPI void setInferenceOnly(bool inferenceOnly);
+    PUBLICAPI bool getInferenceOnly() const;
+    PUBLICAPI void setDeviceWeights(std::string dtypeName);
+    PUBLICAPI int getDeviceWeights() const;
+    PUBLICAPI void setShareActivations(bool share);
+    PUBLICAPI bool getShareActivations() const;
+    void planActivationMemory(int batchSize);
+    void freeActivationMemory();
+    PUBLICAPI int fuseLayers();
     PUBLICAPI void addLayer(LayerMaker2 *maker);
     PUBLICAPI void initWeights(int layerIndex, float *weights, float *bias);
     PUBLICAPI void initWeights(int layerIndex, float *weights);
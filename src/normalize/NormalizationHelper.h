@@ -120,6 +120,20 @@ public:
             data[i] = (data[i] - mean) / scaling;
         }
     }
+
+    // out[i] = (in[i] + translate) * scale, in a single pass, as used by NormalizationLayer
+    // plain indexed loops, with no aliasing between in and out, so the compiler vectorizes them
+    static void translateAndScale(float const*in, int length, float translate, float scale, float *out) {
+        for(int i = 0; i < length; i++) {
+            out[i] = (in[i] + translate) * scale;
+        }
+    }
+    // converts raw uint8 pixels straight to normalized floats, without an intermediate float copy
+    static void translateAndScale(unsigned char const*in, int length, float translate, float scale, float *out) {
+        for(int i = 0; i < length; i++) {
+            out[i] = ((float)in[i] + translate) * scale;
+        }
+    }
 };
 
 
@@ -4,9 +4,13 @@
 // v. 2.0. If a copy of the MPL was not distributed with this file, You can 
 // obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "EasyCL.h"
+#include "util/StatefulTimer.h"
 #include "normalize/NormalizationLayerMaker.h"
 
 #include "normalize/NormalizationLayer.h"
+#include "normalize/NormalizationHelper.h"
+#include "input/InputLayer.h"
 
 using namespace std;
 
@@ -17,13 +21,55 @@ NormalizationLayer::NormalizationLayer(Layer *previousLayer, NormalizationLayerM
        Layer(previousLayer, maker),
     translate(maker->_translate),
     scale(maker->_scale),
+    inputNormalized(false),
     outputPlanes(previousLayer->getOutputPlanes()),
     outputSize(previousLayer->getOutputSize()),
     batchSize(0),
     allocatedSize(0),
-    output(0) {
+    output(0),
+    inputLayer(dynamic_cast<InputLayer *>(previousLayer)),
+    cl(maker->cl),
+    kernel(0),
+    outputWrapper(0) {
+    if(!onDevice()) {
+        return;
+    }
+    string options = "";
+
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel2("kernel", "cl/normalize.cl", "translateAndScale", 'options')
+    // ]]]
+    // generated using cog, from cl/normalize.cl:
+    const char * kernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "kernel void translateAndScale(\n"
+    "        const int N,\n"
+    "        const float translate,\n"
+    "        const float scale,\n"
+    "        global const float *in,\n"
+    "        global float *out) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    out[globalId] = (in[globalId] + translate) * scale;\n"
+    "}\n"
+    "\n"
+    "";
+    kernel = cl->buildKernelFromString(kernelSource, "translateAndScale", options, "cl/normalize.cl");
+    // [[[end]]]
 }
 VIRTUAL NormalizationLayer::~NormalizationLayer() {
+    delete kernel;
+    if(outputWrapper != 0) {
+        delete outputWrapper;
+    }
     if(output != 0) {
         delete[] output;
     }
@@ -31,9 +77,41 @@ VIRTUAL NormalizationLayer::~NormalizationLayer() {
 VIRTUAL std::string NormalizationLayer::getClassName() const {
     return "NormalizationLayer";
 }
+bool NormalizationLayer::onDevice() const {
+    return cl != 0 && previousLayer->hasOutputWrapper();
+}
+/// \brief The input will already have been normalized with our translate and scale,
+/// eg by GenericLoaderv2::load(images, labels, startN, numExamples, translate, scale),
+/// so forward does nothing, and our output is the previous layer's
+///
+/// translate and scale are still persisted with the weights, as usual
+void NormalizationLayer::setInputNormalized(bool inputNormalized) {
+    this->inputNormalized = inputNormalized;
+}
+VIRTUAL bool NormalizationLayer::aliasesPreviousOutput() const {
+    return inputNormalized;
+}
 VIRTUAL float *NormalizationLayer::getOutput() {
+    if(inputNormalized) {
+        return previousLayer->getOutput();
+    }
+    if(outputWrapper != 0 && outputWrapper->isDeviceDirty()) {
+        outputWrapper->copyToHost();
+    }
     return output;
 }
+VIRTUAL bool NormalizationLayer::hasOutputWrapper() const {
+    if(inputNormalized) {
+        return previousLayer->hasOutputWrapper();
+    }
+    return onDevice();
+}
+VIRTUAL CLWrapper *NormalizationLayer::getOutputWrapper() {
+    if(inputNormalized) {
+        return previousLayer->getOutputWrapper();
+    }
+    return outputWrapper;
+}
 VIRTUAL ActivationFunction const *NormalizationLayer::getActivationFunction() {
     return new LinearActivation();
 }
@@ -65,6 +143,9 @@ VIRTUAL void NormalizationLayer::printOutput() const {
     if(output == 0) {
          return;
     }
+    if(outputWrapper != 0 && outputWrapper->isDeviceDirty()) {
+        outputWrapper->copyToHost();
+    }
     for(int n = 0; n < std::min(5,batchSize); n++) {
         std::cout << "NormalizationLayer n " << n << ":" << std::endl;
         for(int plane = 0; plane < std::min(5, outputPlanes); plane++) {
@@ -99,19 +180,38 @@ VIRTUAL void NormalizationLayer::setBatchSize(int batchSize) {
         this->batchSize = batchSize;
         return;
     }
+    if(outputWrapper != 0) {
+        delete outputWrapper;
+    }
     if(output != 0) {
         delete[] output;
     }
     this->batchSize = batchSize;
-    this->allocatedSize = allocatedSize;
+    this->allocatedSize = batchSize;
     output = new float[ getOutputNumElements() ];
+    if(onDevice()) {
+        outputWrapper = cl->wrap(getOutputNumElements(), output);
+        outputWrapper->createOnDevice();
+    }
 }
 VIRTUAL void NormalizationLayer::forward() {
+    if(inputNormalized) {
+        return;
+    }
     int totalLinearLength = getOutputNumElements();
-    float *upstreamOutput = previousLayer->getOutput();
-    for(int i = 0; i < totalLinearLength; i++) {
-        output[i] = (upstreamOutput[i] + translate) * scale;
+    if(onDevice()) {
+        StatefulTimer::timeCheck("NormalizationLayer::forward start");
+        kernel->in(totalLinearLength)->in(translate)->in(scale)
+            ->in(previousLayer->getOutputWrapper())->out(outputWrapper);
+        const int workgroupSize = 64;
+        const int numWorkgroups = (totalLinearLength + workgroupSize - 1) / workgroupSize;
+        kernel->run_1d(numWorkgroups * workgroupSize, workgroupSize);
+        cl->finish();
+        StatefulTimer::timeCheck("NormalizationLayer::forward end");
+        return;
     }
+    float const*upstreamOutput = inputLayer != 0 ? inputLayer->getInput() : previousLayer->getOutput();
+    NormalizationHelper::translateAndScale(upstreamOutput, totalLinearLength, translate, scale, output);
 }
 VIRTUAL void NormalizationLayer::backward(float learningRate, float const *gradOutput) {
   // do nothing...
@@ -133,7 +233,7 @@ VIRTUAL std::string NormalizationLayer::toString() {
 }
 VIRTUAL std::string NormalizationLayer::asString() const {
     return std::string("") + "NormalizationLayer{ outputPlanes=" + ::toString(outputPlanes) + " outputSize=" +  ::toString(outputSize) + " translate=" + ::toString(translate) + 
-        " scale=" + ::toString(scale) + " }";
+        " scale=" + ::toString(scale) + (inputNormalized ? " input normalized by loader" : "") + " }";
 }
 
 
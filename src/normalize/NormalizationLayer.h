@@ -13,12 +13,19 @@
 #define VIRTUAL virtual
 
 class NormalizationLayerMaker;
+class InputLayer;
+class CLKernel;
+class CLWrapper;
 
 class NormalizationLayer : public Layer, IHasToString {
 public:
     float translate; // apply translate first
     float scale;  // then scale
 
+    // the loader normalized the input already, see setInputNormalized, so we just pass
+    // the previous layer's output on
+    bool inputNormalized;
+
     const int outputPlanes;
     const int outputSize;
 
@@ -26,6 +33,16 @@ public:
     int allocatedSize;
     float *output;
 
+    // if we come straight after the InputLayer, we read its input directly, and convert
+    // in a single pass, so the InputLayer doesnt need to copy it first
+    InputLayer *inputLayer; // not owned by us
+
+    // if the previous layer has its output on the device, we normalize there too, and
+    // only copy output to host if someone asks for it
+    EasyCL *const cl; // NOT owned by us
+    CLKernel *kernel;
+    CLWrapper *outputWrapper;
+
     inline int getResultIndex(int n, int outPlane, int outRow, int outCol) const {
         return (( n
             * outputPlanes + outPlane)
@@ -44,7 +61,12 @@ public:
     NormalizationLayer(Layer *previousLayer, NormalizationLayerMaker *maker);
     VIRTUAL ~NormalizationLayer();
     VIRTUAL std::string getClassName() const;
+    bool onDevice() const;
+    void setInputNormalized(bool inputNormalized);
+    VIRTUAL bool aliasesPreviousOutput() const;
     VIRTUAL float *getOutput();
+    VIRTUAL bool hasOutputWrapper() const;
+    VIRTUAL CLWrapper *getOutputWrapper();
     VIRTUAL ActivationFunction const *getActivationFunction();
     VIRTUAL int getPersistSize(int version) const;
     VIRTUAL void persistToArray(int version, float *array);
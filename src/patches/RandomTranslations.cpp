@@ -5,12 +5,16 @@
 // obtain one at http://mozilla.org/MPL/2.0/.
 
 #include <iostream>
+#include <cstring>
 
+#include "EasyCL.h"
 #include "net/NeuralNet.h"
 #include "layer/Layer.h"
 #include "RandomTranslations.h"
 #include "RandomTranslationsMaker.h"
 #include "util/RandomSingleton.h"
+#include "util/StatefulTimer.h"
+#include "clmath/CopyBuffer.h"
 #include "Translator.h"
 
 using namespace std;
@@ -27,6 +31,12 @@ RandomTranslations::RandomTranslations(Layer *previousLayer, RandomTranslationsM
         inputSize(previousLayer->getOutputSize()),
         outputSize(previousLayer->getOutputSize()),
         output(0),
+        cl(maker->cl),
+        kernel(0),
+        copyBuffer(0),
+        outputWrapper(0),
+        translations(0),
+        translationsWrapper(0),
         batchSize(0),
         allocatedSize(0) {
     if(inputSize == 0) {
@@ -40,8 +50,73 @@ RandomTranslations::RandomTranslations(Layer *previousLayer, RandomTranslationsM
     if(previousLayer->needsBackProp()) {
         throw runtime_error("Error: RandomTranslations layer does not provide backprop currently, so you cannot put it after a layer that needs backprop");
     }
+    if(!onDevice()) {
+        return;
+    }
+    string options = "";
+    options += " -DgNumPlanes=" + toString(numPlanes);
+    options += " -DgImageSize=" + toString(inputSize);
+    options += " -DgImageSizeSquared=" + toString(inputSize * inputSize);
+
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel2("kernel", "cl/translate.cl", "translate", 'options')
+    // ]]]
+    // generated using cog, from cl/translate.cl:
+    const char * kernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "// expected defines:\n"
+    "// gNumPlanes\n"
+    "// gImageSize\n"
+    "// gImageSizeSquared\n"
+    "\n"
+    "// translations holds [translateRows, translateCols] for each example\n"
+    "// output pixels that come from outside the input image are zeroed\n"
+    "// one workitem per output value\n"
+    "kernel void translate(\n"
+    "        const int N,\n"
+    "        global const int *translations,\n"
+    "        global const float *input,\n"
+    "        global float *output) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const int n = globalId / gNumPlanes / gImageSizeSquared;\n"
+    "    const int pos = globalId % gImageSizeSquared;\n"
+    "    const int outRow = pos / gImageSize;\n"
+    "    const int outCol = pos % gImageSize;\n"
+    "    const int inRow = outRow - translations[n * 2];\n"
+    "    const int inCol = outCol - translations[n * 2 + 1];\n"
+    "    float value = 0.0f;\n"
+    "    if (inRow >= 0 && inRow < gImageSize && inCol >= 0 && inCol < gImageSize) {\n"
+    "        value = input[globalId - pos + inRow * gImageSize + inCol];\n"
+    "    }\n"
+    "    output[globalId] = value;\n"
+    "}\n"
+    "\n"
+    "";
+    kernel = cl->buildKernelFromString(kernelSource, "translate", options, "cl/translate.cl");
+    // [[[end]]]
+    copyBuffer = new CopyBuffer(cl);
 }
 VIRTUAL RandomTranslations::~RandomTranslations() {
+    delete kernel;
+    delete copyBuffer;
+    if(outputWrapper != 0) {
+        delete outputWrapper;
+    }
+    if(translationsWrapper != 0) {
+        delete translationsWrapper;
+    }
+    if(translations != 0) {
+        delete[] translations;
+    }
     if(output != 0) {
         delete[] output;
     }
@@ -54,17 +129,39 @@ VIRTUAL void RandomTranslations::setBatchSize(int batchSize) {
         this->batchSize = batchSize;
         return;
     }
+    if(outputWrapper != 0) {
+        delete outputWrapper;
+    }
+    if(translationsWrapper != 0) {
+        delete translationsWrapper;
+    }
+    if(translations != 0) {
+        delete[] translations;
+    }
     if(output != 0) {
         delete[] output;
     }
     this->batchSize = batchSize;
     this->allocatedSize = batchSize;
     output = new float[ getOutputNumElements() ];
+    translations = new int[ batchSize * 2 ];
+    if(onDevice()) {
+        outputWrapper = cl->wrap(getOutputNumElements(), output);
+        outputWrapper->createOnDevice();
+        translationsWrapper = cl->wrap(batchSize * 2, translations);
+        translationsWrapper->createOnDevice();
+    }
 }
 VIRTUAL int RandomTranslations::getOutputNumElements() {
     return batchSize * numPlanes * outputSize * outputSize;
 }
+bool RandomTranslations::onDevice() const {
+    return cl != 0 && previousLayer->hasOutputWrapper();
+}
 VIRTUAL float *RandomTranslations::getOutput() {
+    if(outputWrapper != 0 && outputWrapper->isDeviceDirty()) {
+        outputWrapper->copyToHost();
+    }
     return output;
 }
 VIRTUAL bool RandomTranslations::needsBackProp() {
@@ -86,18 +183,42 @@ VIRTUAL bool RandomTranslations::providesGradInputWrapper() const {
     return false;
 }
 VIRTUAL bool RandomTranslations::hasOutputWrapper() const {
-    return false;
+    return onDevice();
+}
+VIRTUAL CLWrapper *RandomTranslations::getOutputWrapper() {
+    return outputWrapper;
 }
 VIRTUAL void RandomTranslations::forward() {
+    if(training) {
+        for(int n = 0; n < batchSize; n++) {
+            translations[n * 2] = RandomSingleton::instance()->uniformInt(- translateSize, translateSize);
+            translations[n * 2 + 1] = RandomSingleton::instance()->uniformInt(- translateSize, translateSize);
+        }
+    }
+    if(onDevice()) {
+        StatefulTimer::timeCheck("RandomTranslations::forward start");
+        CLWrapper *upstreamOutputWrapper = previousLayer->getOutputWrapper();
+        const int N = getOutputNumElements();
+        if(!training) {
+            copyBuffer->copy(N, upstreamOutputWrapper, outputWrapper);
+            return;
+        }
+        translationsWrapper->copyToDevice();
+        kernel->in(N)->in(translationsWrapper)->in(upstreamOutputWrapper)->out(outputWrapper);
+        const int workgroupSize = 64;
+        const int numWorkgroups = (N + workgroupSize - 1) / workgroupSize;
+        kernel->run_1d(numWorkgroups * workgroupSize, workgroupSize);
+        cl->finish();
+        StatefulTimer::timeCheck("RandomTranslations::forward end");
+        return;
+    }
     float *upstreamOutput = previousLayer->getOutput();
     if(!training) {
         memcpy(output, upstreamOutput, sizeof(float) * getOutputNumElements());
         return;
     }
     for(int n = 0; n < batchSize; n++) {
-        const int translateRows = RandomSingleton::instance()->uniformInt(- translateSize, translateSize);
-        const int translateCols = RandomSingleton::instance()->uniformInt(- translateSize, translateSize);
-        Translator::translate(n, numPlanes, inputSize, translateRows, translateCols, upstreamOutput, output);
+        Translator::translate(n, numPlanes, inputSize, translations[n * 2], translations[n * 2 + 1], upstreamOutput, output);
     }
 }
 VIRTUAL std::string RandomTranslations::asString() const {
@@ -13,6 +13,7 @@
 
 class CLKernel;
 class CLWrapper;
+class CopyBuffer;
 class PoolingForward;
 class PoolingBackward;
 class RandomTranslationsMaker;
@@ -27,6 +28,15 @@ public:
 
     float *output;
 
+    // if the previous layer has its output on the device, we translate there too: we
+    // still draw the translations on the host, so we get the same sequence either way
+    EasyCL *const cl; // NOT owned by us
+    CLKernel *kernel;
+    CopyBuffer *copyBuffer;
+    CLWrapper *outputWrapper;
+    int *translations; // [translateRows, translateCols] for each example
+    CLWrapper *translationsWrapper;
+
     int batchSize;
     int allocatedSize;
 
@@ -40,6 +50,7 @@ public:
     VIRTUAL std::string getClassName() const;
     VIRTUAL void setBatchSize(int batchSize);
     VIRTUAL int getOutputNumElements();
+    bool onDevice() const;
     VIRTUAL float *getOutput();
     VIRTUAL bool needsBackProp();
     VIRTUAL int getOutputNumElements() const;
@@ -48,6 +59,7 @@ public:
     VIRTUAL int getPersistSize(int version) const;
     VIRTUAL bool providesGradInputWrapper() const;
     VIRTUAL bool hasOutputWrapper() const;
+    VIRTUAL CLWrapper *getOutputWrapper();
     VIRTUAL void forward();
     VIRTUAL std::string asString() const;
 
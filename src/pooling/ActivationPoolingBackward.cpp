@@ -0,0 +1,78 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+
+#include "EasyCL.h"
+#include "util/stringhelper.h"
+
+#include "ActivationPoolingBackwardCpu.h"
+#include "ActivationPoolingBackwardGpuNaive.h"
+
+#include "ActivationPoolingBackward.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL 
+#undef STATIC
+#define STATIC
+
+ActivationPoolingBackward::ActivationPoolingBackward(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn) :
+        cl(cl),
+        padZeros(padZeros),
+        numPlanes(numPlanes),
+        inputSize(inputSize),
+        poolingSize(poolingSize),
+        outputSize(padZeros ? (inputSize + poolingSize - 1) / poolingSize : inputSize / poolingSize),
+        fn(fn) {
+}
+STATIC ActivationPoolingBackward *ActivationPoolingBackward::instance(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn) {
+    return new ActivationPoolingBackwardGpuNaive(cl, padZeros, numPlanes, inputSize, poolingSize, fn);
+}
+STATIC ActivationPoolingBackward *ActivationPoolingBackward::instanceForTest(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn) {
+    return new ActivationPoolingBackwardCpu(cl, padZeros, numPlanes, inputSize, poolingSize, fn);
+}
+STATIC ActivationPoolingBackward *ActivationPoolingBackward::instanceSpecific(int idx, EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn) {
+    if(idx == 0) {
+        return new ActivationPoolingBackwardCpu(cl, padZeros, numPlanes, inputSize, poolingSize, fn);
+    }
+    if(idx == 1) {
+        return new ActivationPoolingBackwardGpuNaive(cl, padZeros, numPlanes, inputSize, poolingSize, fn);
+    }
+    cout << "idx " << idx << " not known" << endl;
+    throw runtime_error("ActivationPoolingBackward::instanceSpecific idx not known: " + toString(idx) );
+}
+VIRTUAL int ActivationPoolingBackward::getInputNumElements(int batchSize) {
+    return batchSize * numPlanes * inputSize * inputSize;
+}
+VIRTUAL int ActivationPoolingBackward::getOutputNumElements(int batchSize) {
+    return batchSize * numPlanes * outputSize * outputSize;
+}
+VIRTUAL void ActivationPoolingBackward::backward(int batchSize, float *output, float *gradOutput, int *selectors, float *gradInput) {
+    CLWrapper *outputWrapper = cl->wrap(getOutputNumElements(batchSize), output);
+    CLWrapper *gradOutputWrapper = cl->wrap(getOutputNumElements(batchSize), gradOutput);
+    CLWrapper *selectorsWrapper = cl->wrap(getOutputNumElements(batchSize), selectors);
+    CLWrapper *gradInputWrapper = cl->wrap(getInputNumElements(batchSize), gradInput);
+
+    outputWrapper->copyToDevice();
+    gradOutputWrapper->copyToDevice();
+    selectorsWrapper->copyToDevice();
+
+    backward(batchSize, outputWrapper, gradOutputWrapper, selectorsWrapper, gradInputWrapper);
+
+    gradInputWrapper->copyToHost();
+
+    delete outputWrapper;
+    delete gradOutputWrapper;
+    delete selectorsWrapper;
+    delete gradInputWrapper;
+}
+VIRTUAL void ActivationPoolingBackward::backward(int batchSize, CLWrapper *outputWrapper, CLWrapper *gradOutputWrapper, CLWrapper *selectorsWrapper, CLWrapper *gradInputWrapper) {
+    throw runtime_error("ActivationPoolingBackward::backward wrappers not implemented");
+}
+
@@ -0,0 +1,65 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+class EasyCL;
+class CLWrapper;
+class ActivationFunction;
+
+// backward through a max-pooling layer, then the activation layer before it, in
+// one pass; output and selectors are those written by ActivationPoolingForward,
+// gradOutput is the gradient at the pooling layer's output, and gradInput the
+// gradient at the activation layer's input
+class DeepCL_EXPORT ActivationPoolingBackward {
+public:
+    EasyCL *cl;
+
+    const bool padZeros;
+    const int numPlanes;
+    const int inputSize;
+    const int poolingSize;
+
+    const int outputSize;
+
+    ActivationFunction const*fn;
+
+    virtual ~ActivationPoolingBackward() {}
+    inline int getInputIndex(int n, int plane, int row, int col) {
+        return (( n
+            * numPlanes + plane)
+            * inputSize + row)
+            * inputSize + col;
+    }
+    inline int getResultIndex(int n, int plane, int row, int col) {
+        return (( n
+            * numPlanes + plane)
+            * outputSize + row)
+            * outputSize + col;
+    }
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    ActivationPoolingBackward(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn);
+    STATIC ActivationPoolingBackward *instance(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn);
+    STATIC ActivationPoolingBackward *instanceForTest(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn);
+    STATIC ActivationPoolingBackward *instanceSpecific(int idx, EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn);
+    VIRTUAL int getInputNumElements(int batchSize);
+    VIRTUAL int getOutputNumElements(int batchSize);
+    VIRTUAL void backward(int batchSize, float *output, float *gradOutput, int *selectors, float *gradInput);
+    VIRTUAL void backward(int batchSize, CLWrapper *outputWrapper, CLWrapper *gradOutputWrapper, CLWrapper *selectorsWrapper, CLWrapper *gradInputWrapper);
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,70 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <cstring>
+
+#include "EasyCL.h"
+
+#include "util/StatefulTimer.h"
+#include "activate/ActivationFunction.h"
+
+#include "ActivationPoolingBackwardCpu.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL 
+#undef STATIC
+#define STATIC
+
+ActivationPoolingBackwardCpu::ActivationPoolingBackwardCpu(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn) :
+        ActivationPoolingBackward(cl, padZeros, numPlanes, inputSize, poolingSize, fn) {
+}
+VIRTUAL void ActivationPoolingBackwardCpu::backward(int batchSize, float *output, float *gradOutput, int *selectors, float *gradInput) {
+    memset(gradInput, 0, sizeof(float) * getInputNumElements(batchSize) );
+    for(int n = 0; n < batchSize; n++) {
+        for(int plane = 0; plane < numPlanes; plane++) {
+            for(int outputRow = 0; outputRow < outputSize; outputRow++) {
+                int inputRow = outputRow * poolingSize;
+                for(int outputCol = 0; outputCol < outputSize; outputCol++) {
+                    int inputCol = outputCol * poolingSize;
+                    int outputIndex = getResultIndex(n, plane, outputRow, outputCol);
+                    int selector = selectors[outputIndex];
+                    int drow = selector / poolingSize;
+                    int dcol = selector % poolingSize;
+                    int inputIndex = getInputIndex(n, plane, inputRow + drow, inputCol + dcol);
+                    // the pooled output is the activation's output at the selected position
+                    gradInput[ inputIndex ] = fn->calcDerivative(output[outputIndex]) * gradOutput[outputIndex];
+                }
+            }
+        }
+    }
+}
+VIRTUAL void ActivationPoolingBackwardCpu::backward(int batchSize, CLWrapper *outputWrapper, CLWrapper *gradOutputWrapper, 
+        CLWrapper *selectorsWrapper, CLWrapper *gradInputWrapper) {
+    StatefulTimer::instance()->timeCheck("ActivationPoolingBackwardCpu::backward start");
+
+    outputWrapper->copyToHost();
+    gradOutputWrapper->copyToHost();
+    selectorsWrapper->copyToHost();
+
+    float *output = reinterpret_cast<float *>(outputWrapper->getHostArray());
+    float *gradOutput = reinterpret_cast<float *>(gradOutputWrapper->getHostArray());
+    int *selectors = reinterpret_cast<int *>(selectorsWrapper->getHostArray());
+    float *gradInput = new float[ getInputNumElements(batchSize) ];
+
+    backward(batchSize, output, gradOutput, selectors, gradInput);
+
+    float *gradInputHostArray = reinterpret_cast<float *>(gradInputWrapper->getHostArray());
+    memcpy(gradInputHostArray, gradInput, sizeof(float) * getInputNumElements(batchSize) );
+    gradInputWrapper->copyToDevice();
+
+    delete[] gradInput;
+    
+    StatefulTimer::instance()->timeCheck("ActivationPoolingBackwardCpu::backward end");
+}
+
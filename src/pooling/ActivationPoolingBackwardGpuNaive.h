@@ -0,0 +1,33 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "ActivationPoolingBackward.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+class CLKernel;
+
+class ActivationPoolingBackwardGpuNaive : public ActivationPoolingBackward {
+public:
+    CLKernel *kernel;
+    CLKernel *kMemset;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    VIRTUAL ~ActivationPoolingBackwardGpuNaive();
+    VIRTUAL void backward(int batchSize, CLWrapper *outputWrapper, CLWrapper *gradOutputWrapper,
+    CLWrapper *selectorsWrapper, CLWrapper *gradInputWrapper);
+    ActivationPoolingBackwardGpuNaive(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn);
+
+    // [[[end]]]
+};
+
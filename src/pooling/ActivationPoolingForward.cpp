@@ -0,0 +1,72 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+
+#include "EasyCL.h"
+#include "util/stringhelper.h"
+#include "ActivationPoolingForwardCpu.h"
+#include "ActivationPoolingForwardGpuNaive.h"
+
+#include "ActivationPoolingForward.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL 
+#undef STATIC
+#define STATIC
+
+ActivationPoolingForward::ActivationPoolingForward(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn) :
+        cl(cl),
+        padZeros(padZeros),
+        numPlanes(numPlanes),
+        inputSize(inputSize),
+        poolingSize(poolingSize),
+        outputSize(padZeros ? (inputSize + poolingSize - 1) / poolingSize : inputSize / poolingSize),
+        fn(fn) {
+}
+STATIC ActivationPoolingForward *ActivationPoolingForward::instance(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn) {
+    return new ActivationPoolingForwardGpuNaive(cl, padZeros, numPlanes, inputSize, poolingSize, fn);
+}
+STATIC ActivationPoolingForward *ActivationPoolingForward::instanceForTest(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn) {
+    return new ActivationPoolingForwardGpuNaive(cl, padZeros, numPlanes, inputSize, poolingSize, fn);
+}
+STATIC ActivationPoolingForward *ActivationPoolingForward::instanceSpecific(int idx, EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn) {
+    if(idx == 0) {
+        return new ActivationPoolingForwardCpu(cl, padZeros, numPlanes, inputSize, poolingSize, fn);
+    }
+    if(idx == 1) {
+        return new ActivationPoolingForwardGpuNaive(cl, padZeros, numPlanes, inputSize, poolingSize, fn);
+    }
+    cout << "idx " << idx << " not known" << endl;
+    throw runtime_error("ActivationPoolingForward::instanceSpecific idx not known: " + toString(idx) );
+}
+VIRTUAL void ActivationPoolingForward::forward(int batchSize, CLWrapper *inputData, CLWrapper *selectors, CLWrapper *outputData) {
+    throw runtime_error("forward not implemented for this child type");
+}
+VIRTUAL void ActivationPoolingForward::forward(int batchSize, float *input, int *selectors, float *output) {
+    CLWrapper *inputWrapper = cl->wrap(getInputNumElements(batchSize), input);
+    CLWrapper *selectorsWrapper = cl->wrap(getOutputNumElements(batchSize), selectors);
+    CLWrapper *outputWrapper = cl->wrap(getOutputNumElements(batchSize), output);
+
+    inputWrapper->copyToDevice();
+    forward(batchSize, inputWrapper, selectorsWrapper, outputWrapper);
+    selectorsWrapper->copyToHost();    
+    outputWrapper->copyToHost();    
+
+    delete outputWrapper;
+    delete selectorsWrapper;
+    delete inputWrapper;
+}
+VIRTUAL int ActivationPoolingForward::getInputNumElements(int batchSize) {
+    return batchSize * numPlanes * inputSize * inputSize;
+}
+VIRTUAL int ActivationPoolingForward::getOutputNumElements(int batchSize) {
+    return batchSize * numPlanes * outputSize * outputSize;
+}
+
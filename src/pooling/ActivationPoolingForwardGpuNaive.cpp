@@ -0,0 +1,165 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <cstring>
+
+#include "EasyCL.h"
+
+#include "util/StatefulTimer.h"
+#include "util/stringhelper.h"
+#include "activate/ActivationFunction.h"
+
+#include "ActivationPoolingForwardGpuNaive.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL 
+#undef STATIC
+#define STATIC
+
+VIRTUAL ActivationPoolingForwardGpuNaive::~ActivationPoolingForwardGpuNaive() {
+    delete kernel;
+}
+VIRTUAL void ActivationPoolingForwardGpuNaive::forward(int batchSize, CLWrapper *inputWrapper, CLWrapper *selectorsWrapper, CLWrapper *outputWrapper) {
+    StatefulTimer::instance()->timeCheck("ActivationPoolingForwardGpuNaive::forward start");
+
+    kernel->input(batchSize)->input(inputWrapper)->output(selectorsWrapper)->output(outputWrapper);
+    int globalSize = batchSize * numPlanes * outputSize * outputSize;
+    int workgroupsize = cl->getMaxWorkgroupSize();
+    globalSize = (( globalSize + workgroupsize - 1) / workgroupsize) * workgroupsize;
+    kernel->run_1d(globalSize, workgroupsize);
+    cl->finish();
+
+    StatefulTimer::instance()->timeCheck("ActivationPoolingForwardGpuNaive::forward end");
+}
+ActivationPoolingForwardGpuNaive::ActivationPoolingForwardGpuNaive(EasyCL *cl, bool padZeros, int numPlanes, int inputSize, int poolingSize, ActivationFunction const*fn) :
+        ActivationPoolingForward(cl, padZeros, numPlanes, inputSize, poolingSize, fn) {
+    string options = "";
+    options += " -DgOutputSize=" + toString(outputSize);
+    options += " -DgOutputSizeSquared=" + toString(outputSize * outputSize);
+    options += " -DgInputSize=" + toString(inputSize);
+    options += " -DgInputSizeSquared=" + toString(inputSize * inputSize);
+    options += " -DgPoolingSize=" + toString(poolingSize);
+    options += " -DgNumPlanes=" + toString(numPlanes);
+    options += string(" -D ") + fn->getDefineName();
+
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel2("kernel", "cl/activationPooling.cl", "forwardNaive", 'options')
+    // ]]]
+    // generated using cog, from cl/activationPooling.cl:
+    const char * kernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "// an activation layer, followed by a max-pooling layer, in one pass, so the\n"
+    "// activated values never go to global memory\n"
+    "\n"
+    "// expected defines:\n"
+    "// one of: [ TANH | RELU | LINEAR | SIGMOID | SCALEDTANH | ELU ]\n"
+    "// gNumPlanes, gInputSize, gInputSizeSquared, gOutputSize, gOutputSizeSquared, gPoolingSize\n"
+    "\n"
+    "#ifdef TANH\n"
+    "    #define ACTIVATION_FUNCTION(output) (tanh(output))\n"
+    "    #define ACTIVATION_DERIV(output) (1 - output * output)\n"
+    "#elif defined SCALEDTANH\n"
+    "    #define ACTIVATION_FUNCTION(output) (1.7159f * tanh(0.66667f * output))\n"
+    "    #define ACTIVATION_DERIV(output) (0.66667f * (1.7159f - 1 / 1.7159f * output * output) )\n"
+    "#elif defined SIGMOID\n"
+    "    #define ACTIVATION_FUNCTION(output) (1.0f / (1 + exp(-output)))\n"
+    "    #define ACTIVATION_DERIV(output) (output * (1 - output) )\n"
+    "#elif defined RELU\n"
+    "    #define ACTIVATION_FUNCTION(output) (output> 0 ? output : 0)\n"
+    "    #define ACTIVATION_DERIV(output) (output > 0 ? 1 : 0)\n"
+    "#elif defined ELU\n"
+    "    #define ACTIVATION_FUNCTION(output) (output> 0 ? output : exp(output) - 1)\n"
+    "    #define ACTIVATION_DERIV(output) (output > 0 ? 1 : output + 1)\n"
+    "#elif defined LINEAR\n"
+    "    #define ACTIVATION_FUNCTION(output) (output)\n"
+    "    #define ACTIVATION_DERIV(output) (1.0f)\n"
+    "#endif\n"
+    "\n"
+    "// same as forwardNaive in pooling.cl, but activating each input first\n"
+    "// globalId: [n][plane][outputRow][outputCol]\n"
+    "#ifdef ACTIVATION_FUNCTION // protect against not defined\n"
+    "kernel void forwardNaive(const int batchSize, global const float *input, global int *selectors, global float *output) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "\n"
+    "    const int intraImageOffset = globalId % gOutputSizeSquared;\n"
+    "    const int outputRow = intraImageOffset / gOutputSize;\n"
+    "    const int outputCol = intraImageOffset % gOutputSize;\n"
+    "\n"
+    "    const int image2dIdx = globalId / gOutputSizeSquared;\n"
+    "    const int plane = image2dIdx % gNumPlanes;\n"
+    "    const int n = image2dIdx / gNumPlanes;\n"
+    "\n"
+    "    if (n >= batchSize) {\n"
+    "        return;\n"
+    "    }\n"
+    "\n"
+    "    const int inputRow = outputRow * gPoolingSize;\n"
+    "    const int inputCol = outputCol * gPoolingSize;\n"
+    "    const int inputImageOffset = (n * gNumPlanes + plane) * gInputSizeSquared;\n"
+    "    int selector = 0;\n"
+    "    int poolInputOffset = inputImageOffset + inputRow * gInputSize + inputCol;\n"
+    "    float maxValue = ACTIVATION_FUNCTION(input[ poolInputOffset ]);\n"
+    "    for (int dRow = 0; dRow < gPoolingSize; dRow++) {\n"
+    "        for (int dCol = 0; dCol < gPoolingSize; dCol++) {\n"
+    "            bool process = (inputRow + dRow < gInputSize) && (inputCol + dCol < gInputSize);\n"
+    "            if (process) {\n"
+    "                float thisValue = ACTIVATION_FUNCTION(input[ poolInputOffset + dRow * gInputSize + dCol ]);\n"
+    "                if (thisValue > maxValue) {\n"
+    "                    maxValue = thisValue;\n"
+    "                    selector = dRow * gPoolingSize + dCol;\n"
+    "                }\n"
+    "            }\n"
+    "        }\n"
+    "    }\n"
+    "    output[ globalId ] = maxValue;\n"
+    "    selectors[ globalId ] = selector;\n"
+    "}\n"
+    "#endif\n"
+    "\n"
+    "// the pooled output is the activation's output at the selected position, so\n"
+    "// the derivative can be taken from it directly\n"
+    "// gradInput should be zeroed first\n"
+    "// globalId: [n][plane][outputRow][outputCol]\n"
+    "#ifdef ACTIVATION_DERIV\n"
+    "kernel void backward(const int batchSize, global const float *output,\n"
+    "        global const float *gradOutput, global const int *selectors, global float *gradInput) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "\n"
+    "    const int intraImageOffset = globalId % gOutputSizeSquared;\n"
+    "    const int outputRow = intraImageOffset / gOutputSize;\n"
+    "    const int outputCol = intraImageOffset % gOutputSize;\n"
+    "\n"
+    "    const int image2dIdx = globalId / gOutputSizeSquared;\n"
+    "    const int plane = image2dIdx % gNumPlanes;\n"
+    "    const int n = image2dIdx / gNumPlanes;\n"
+    "\n"
+    "    if (n >= batchSize) {\n"
+    "        return;\n"
+    "    }\n"
+    "\n"
+    "    const int selector = selectors[globalId];\n"
+    "    const int inputRow = outputRow * gPoolingSize + selector / gPoolingSize;\n"
+    "    const int inputCol = outputCol * gPoolingSize + selector % gPoolingSize;\n"
+    "    const int inputIndex = ((n * gNumPlanes + plane) * gInputSize + inputRow) * gInputSize + inputCol;\n"
+    "    const float pooledOutput = output[globalId];\n"
+    "    gradInput[inputIndex] = ACTIVATION_DERIV(pooledOutput) * gradOutput[globalId];\n"
+    "}\n"
+    "#endif\n"
+    "\n"
+    "";
+    kernel = cl->buildKernelFromString(kernelSource, "forwardNaive", options, "cl/activationPooling.cl");
+    // [[[end]]]
+}
+
@@ -30,12 +30,14 @@ PoolingLayer::PoolingLayer(EasyCL *cl, Layer *previousLayer, PoolingMaker *maker
         poolingSize(maker->_poolingSize),
         outputSize(maker->_padZeros ? (previousLayer->getOutputSize() + maker->_poolingSize - 1) / maker->_poolingSize : previousLayer->getOutputSize() / maker->_poolingSize),
         cl(cl),
+        poolingBackpropImpl(0),
         output(0),
         selectors(0),
         gradInput(0),
         outputWrapper(0),
         selectorsWrapper(0),
         gradInputWrapper(0),
+        fusedIntoPreviousLayer(false),
 //        outputCopiedToHost(false),
 //        gradInputCopiedToHost(false),
         batchSize(0),
@@ -49,15 +51,17 @@ PoolingLayer::PoolingLayer(EasyCL *cl, Layer *previousLayer, PoolingMaker *maker
         throw runtime_error("Error: Pooling layer " + toString(layerIndex) + ": output image size is 0");
     }
     poolingForwardImpl = PoolingForward::instance(cl, padZeros, numPlanes, inputSize, poolingSize);
-    poolingBackpropImpl = PoolingBackward::instance(cl, padZeros, numPlanes, inputSize, poolingSize);
+    if(!inferenceOnly) {
+        poolingBackpropImpl = PoolingBackward::instance(cl, padZeros, numPlanes, inputSize, poolingSize);
+    }
 }
 VIRTUAL PoolingLayer::~PoolingLayer() {
     delete poolingForwardImpl;
     delete poolingBackpropImpl;
-    if(outputWrapper != 0) {
+    if(outputWrapper != 0 && !outputShared) {
         delete outputWrapper;
     }
-    if(output != 0) {
+    if(output != 0 && !outputShared) {
         delete[] output;
     }
     if(selectorsWrapper != 0) {
@@ -82,10 +86,10 @@ VIRTUAL void PoolingLayer::setBatchSize(int batchSize) {
         this->batchSize = batchSize;
         return;
     }
-    if(outputWrapper != 0) {
+    if(outputWrapper != 0 && !outputShared) {
         delete outputWrapper;
     }
-    if(output != 0) {
+    if(output != 0 && !outputShared) {
         delete[] output;
     }
     if(selectorsWrapper != 0) {
@@ -102,18 +106,38 @@ VIRTUAL void PoolingLayer::setBatchSize(int batchSize) {
     }
     this->batchSize = batchSize;
     this->allocatedSize = batchSize;
-    output = new float[ getOutputNumElements() ];
-    outputWrapper = cl->wrap(getOutputNumElements(), output);
+    if(!outputShared) {
+        output = new float[ getOutputNumElements() ];
+        outputWrapper = cl->wrap(getOutputNumElements(), output);
+    }
     selectors = new int[ getOutputNumElements() ];
     selectorsWrapper = cl->wrap(getOutputNumElements(), selectors);
-    gradInput = new float[ previousLayer->getOutputNumElements() ];
-    gradInputWrapper = cl->wrap(previousLayer->getOutputNumElements(), gradInput);
-    gradInputWrapper->createOnDevice();
+    if(!inferenceOnly) {
+        gradInput = new float[ previousLayer->getOutputNumElements() ];
+        gradInputWrapper = cl->wrap(previousLayer->getOutputNumElements(), gradInput);
+        gradInputWrapper->createOnDevice();
+    }
+}
+VIRTUAL bool PoolingLayer::canShareOutput() const {
+    return true;
+}
+VIRTUAL void PoolingLayer::setSharedOutput(float *output, CLWrapper *outputWrapper) {
+    if(!outputShared) {
+        delete this->outputWrapper;
+        delete[] this->output;
+    }
+    this->output = output;
+    this->outputWrapper = outputWrapper;
+    outputShared = output != 0;
+    if(!outputShared) {
+        allocatedSize = 0;
+    }
 }
 VIRTUAL int PoolingLayer::getOutputNumElements() {
     return batchSize * numPlanes * outputSize * outputSize;
 }
 VIRTUAL float *PoolingLayer::getOutput() {
+    checkOutputNotOverwritten();
     if(outputWrapper->isDeviceDirty()) {
         outputWrapper->copyToHost();
 //        outputCopiedToHost = true;
@@ -149,6 +173,7 @@ VIRTUAL bool PoolingLayer::hasOutputWrapper() const {
     return true;
 }
 VIRTUAL CLWrapper *PoolingLayer::getOutputWrapper() {
+    checkOutputNotOverwritten();
     return outputWrapper;
 }
 VIRTUAL float *PoolingLayer::getGradInput() {
@@ -159,6 +184,9 @@ VIRTUAL ActivationFunction const *PoolingLayer::getActivationFunction() {
     return new LinearActivation();
 }
 VIRTUAL void PoolingLayer::forward() {
+    if(fusedIntoPreviousLayer) {
+        return; // done by the activation layer
+    }
     CLWrapper *upstreamOutputWrapper = 0;
     if(previousLayer->hasOutputWrapper()) {
         upstreamOutputWrapper = previousLayer->getOutputWrapper();
@@ -185,6 +213,9 @@ VIRTUAL void PoolingLayer::forward() {
 }
 VIRTUAL void PoolingLayer::backward() {
     // have no weights to backprop to, just need to backprop the errors
+    if(fusedIntoPreviousLayer) {
+        return; // done by the activation layer
+    }
 
     CLWrapper *gradOutputWrapper = 0;
     bool weOwnErrorsWrapper = false;
@@ -241,7 +272,7 @@ VIRTUAL void PoolingLayer::backward() {
     }
 }
 VIRTUAL std::string PoolingLayer::asString() const {
-    return "PoolingLayer{ inputPlanes=" + toString(numPlanes) + " inputSize=" + toString(inputSize) + " poolingSize=" + toString(poolingSize) + " }";
+    return "PoolingLayer{ inputPlanes=" + toString(numPlanes) + " inputSize=" + toString(inputSize) + " poolingSize=" + toString(poolingSize) + (fusedIntoPreviousLayer ? " fused" : "") + " }";
 }
 
 
@@ -39,6 +39,9 @@ public:
     CLWrapper *selectorsWrapper;
     CLWrapper *gradInputWrapper;
 
+    // set by ActivationLayer::fuseWithPoolingLayer; the activation layer before us
+    // then writes our output and selectors, and backprops through us
+    bool fusedIntoPreviousLayer;
 //    bool outputCopiedToHost;
 //    bool gradInputCopiedToHost;
 
@@ -54,6 +57,8 @@ public:
     VIRTUAL ~PoolingLayer();
     VIRTUAL std::string getClassName() const;
     VIRTUAL void setBatchSize(int batchSize);
+    VIRTUAL bool canShareOutput() const;
+    VIRTUAL void setSharedOutput(float *output, CLWrapper *outputWrapper);
     VIRTUAL int getOutputNumElements();
     VIRTUAL float *getOutput();
     VIRTUAL bool needsBackProp();
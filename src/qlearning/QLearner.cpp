@@ -4,13 +4,54 @@
 // v. 2.0. If a copy of the MPL was not distributed with this file, You can 
 // obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <stdexcept>
+
 #include "net/NeuralNet.h"
 #include "qlearning/array_helper.h"
+#include "qlearning/ReplayMemory.h"
 #include "trainers/Trainer.h"
+#include "util/ThreadPool.h"
+#include "util/stringhelper.h"
+#include "weights/WeightsPersister.h"
 #include "qlearning/QLearner.h"
 
 using namespace std;
 
+namespace {
+    // one actor per task: act, then observe
+    class ActorStepTask : public ThreadPoolTask {
+    public:
+        vector< Scenario * > const *scenarios;
+        int perceptionSize;
+        int const *actions;
+        float *rewards;
+        bool *wasResets;
+        float *perceptions;
+        virtual void run(int threadId, int taskId) {
+            Scenario *scenario = (*scenarios)[taskId];
+            rewards[taskId] = scenario->act(actions[taskId]);
+            wasResets[taskId] = scenario->hasFinished();
+            if(wasResets[taskId]) {
+                scenario->reset();
+            }
+            scenario->getPerception(perceptions + taskId * perceptionSize);
+        }
+    };
+    #ifndef NOTHREADS
+    void runActorSteps(ActorStepTask *task, int numActors, exception_ptr *p_exception) {
+        try {
+            ThreadPool::instance()->run(numActors, task);
+        } catch(...) {
+            *p_exception = current_exception();
+        }
+    }
+    #endif
+    void copyWeights(NeuralNet *from, NeuralNet *to, float *buffer) {
+        WeightsPersister::copyNetWeightsToArray(from, buffer);
+        WeightsPersister::copyArrayToNetWeights(buffer, to);
+    }
+}
+
 QLearner::QLearner(Trainer *trainer, Scenario *scenario, NeuralNet *net) :
         trainer(trainer),
         scenario(scenario),
@@ -18,112 +59,132 @@ QLearner::QLearner(Trainer *trainer, Scenario *scenario, NeuralNet *net) :
     epoch = 0;
     lambda = 0.9f;
     maxSamples = 32;
+    replayCapacity = 10000;
     epsilon = 0.1f;
+    actorSyncInterval = 100;
 //    learningRate = 0.1f;
 
     size = scenario->getPerceptionSize();
     planes = scenario->getPerceptionPlanes();
     numActions = scenario->getNumActions();
 
-    lastPerception = new float[ size * size * planes ];
+    lastFrame = -1;
     game = 0;
     lastAction = -1;
+
+    replayMemory = 0;
+    stagedBatchSize = 0;
+    befores = 0;
+    afters = 0;
+    expectedValues = 0;
+    bestQ = 0;
+    actions = 0;
+    rewards = 0;
+    isEndStates = 0;
 }
 
 QLearner::~QLearner() {
-    delete[] lastPerception;
+    delete replayMemory;
+    delete[] befores;
+    delete[] afters;
+    delete[] expectedValues;
+    delete[] bestQ;
+    delete[] actions;
+    delete[] rewards;
+    delete[] isEndStates;
 }
 
-void QLearner::learnFromPast() {
-    const int availableSamples = history.size();
-    int batchSize = availableSamples >= maxSamples ? maxSamples : availableSamples;
-//    batchSize = ;
-    const int size = scenario->getPerceptionSize();
-    const int numActions = scenario->getNumActions();
-    net->setBatchSize(batchSize);
+void QLearner::setReplayCapacity(int replayCapacity) {
+    if(replayMemory != 0) {
+        throw runtime_error("QLearner::setReplayCapacity: must be called before the first step");
+    }
+    this->replayCapacity = replayCapacity;
+}
 
-//    cout << "batchSize: " << batchSize << endl;
+void QLearner::setActorSyncInterval(int actorSyncInterval) {
+    if(actorSyncInterval < 1) {
+        throw runtime_error("QLearner::setActorSyncInterval: must be at least 1, but was " + toString(actorSyncInterval));
+    }
+    this->actorSyncInterval = actorSyncInterval;
+}
 
-    // draw samples
-    Experience **experiences = new Experience *[ batchSize ];
-    for(int n = 0; n < batchSize; n++) {
-        int sampleIdx = myrand() % availableSamples;
-        Experience *experience = history[sampleIdx];
-        experiences[n] = experience;
-    }    
-
-    // copy in data 
-    float *afters = new float[ batchSize * planes * size * size ];
-    float *befores = new float[ batchSize * planes * size * size ];
-    for(int n = 0; n < batchSize; n++) {
-        Experience *experience = experiences[n]; 
-        arrayCopy(afters + n * planes * size * size, experience->after, planes * size * size);
-        arrayCopy(befores + n * planes * size * size, experience->before, planes * size * size);
+// (re)allocates the minibatch staging arrays, and sets the net batch size, only
+// when maxSamples has changed, so normally just once
+void QLearner::ensureStagingBuffers() {
+    if(stagedBatchSize == maxSamples) {
+        return;
     }
+    delete[] befores;
+    delete[] afters;
+    delete[] expectedValues;
+    delete[] bestQ;
+    delete[] actions;
+    delete[] rewards;
+    delete[] isEndStates;
+    const int perceptionSize = planes * size * size;
+    befores = new float[ maxSamples * perceptionSize ];
+    afters = new float[ maxSamples * perceptionSize ];
+    arrayZero(afters, maxSamples * perceptionSize);
+    expectedValues = new float[ maxSamples * numActions ];
+    bestQ = new float[ maxSamples ];
+    actions = new int[ maxSamples ];
+    rewards = new float[ maxSamples ];
+    isEndStates = new bool[ maxSamples ];
+    stagedBatchSize = maxSamples;
+    net->setBatchSize(maxSamples);
+}
+
+void QLearner::learnFromPast() {
+    ensureStagingBuffers();
+    // always a full batch, drawn with replacement, so the batch size never changes
+    const int batchSize = stagedBatchSize;
+    replayMemory->sample(myrand, batchSize, befores, afters, actions, rewards, isEndStates);
 
     // get next q values, based on forward prop 'afters'
     net->forward(afters);
     float const *allOutput = net->getOutput();
-    float *bestQ = new float[ batchSize ];
-    int *bestAction = new int[ batchSize ];
     for(int n = 0; n < batchSize; n++) {
         float const *output = allOutput + n * numActions;
         float thisBestQ = output[0];
-        int thisBestAction = 0;
         for(int action = 1; action < numActions; action++) {
             if(output[action] > thisBestQ) {
                 thisBestQ = output[action];
-                thisBestAction = action;
             }
         }
         bestQ[n] = thisBestQ;
-        bestAction[n] = thisBestAction;
     }
     // forward prop 'befores', set up expected values, and backprop
     // new q values
     net->forward(befores);
     allOutput = net->getOutput();
-    float *expectedValues = new float[ numActions * batchSize ];
     arrayCopy(expectedValues, allOutput, batchSize * numActions);
     for(int n = 0; n < batchSize; n++) {
-        Experience *experience = experiences[n]; 
-        if(experience->isEndState) {
-            expectedValues[ n * numActions + experience->action ] = experience->reward; 
+        if(isEndStates[n]) {
+            expectedValues[ n * numActions + actions[n] ] = rewards[n];
         } else {
-            expectedValues[ n * numActions + experience->action ] = experience->reward + lambda * bestQ[n];        
+            expectedValues[ n * numActions + actions[n] ] = rewards[n] + lambda * bestQ[n];
         }
     }
     // backprop...
-//    throw runtime_error("need to implement this");
     TrainingContext context(epoch, 0);
     trainer->train(net, &context, befores, expectedValues);
 //    net->backward(learningRate / batchSize, expectedValues);
-    net->setBatchSize(1);
 
     epoch++;
-
-    delete[] expectedValues;
-    delete[] bestQ;
-    delete[] bestAction;
-    delete[] afters;
-    delete[] befores;
-    delete[] experiences;
 }
 
 // this is now a scenario-free zone, and therefore no callbacks, and easy to wrap with
 // swig, cython etc.
 int QLearner::step(float lastReward, bool wasReset, float *perception) { // do one frame
+    const int perceptionSize = size * size * planes;
+    if(replayMemory == 0) {
+        replayMemory = new ReplayMemory(replayCapacity, perceptionSize, 1);
+    }
+    // each perception is stored once, as the 'after' of this transition, and the
+    // 'before' of the next one
+    const long long frame = replayMemory->addFrame(perception);
     if(lastAction != -1) {
-        Experience *experience = new Experience(); 
-        experience->action = lastAction;
-        experience->reward = lastReward;
-        experience->isEndState = wasReset;
-        experience->before = new float[ size * size * planes ];
-        arrayCopy(experience->before, this->lastPerception, size * size * planes);
-//        scenario->getPerception(perception);
-        experience->after = new float[ size * size * planes ];
-        arrayCopy(experience->after, perception, size * size * planes);
-        history.push_back(experience);
+        replayMemory->addTransition(lastFrame, lastAction, lastReward, wasReset, frame);
         if(wasReset) {
             game++;
         }
@@ -135,26 +196,152 @@ int QLearner::step(float lastReward, bool wasReset, float *perception) { // do o
         action = myrand() % numActions;
 //            cout << "action, rand: " << action << endl;
     } else {
-        net->setBatchSize(1);
-        net->forward(perception);
-        float highestQ = 0;
-        int bestAction = 0;
-        float const*output = net->getOutput();
-        for(int i = 0; i < numActions; i++) {
-            if(i == 0 || output[i] > highestQ) {
-                highestQ = output[i];
-                bestAction = i;
-            }
-        }
-        action = bestAction;
+        // reuse the 'afters' staging batch: perception goes in as example 0, and
+        // whatever is in the other examples is ignored
+        ensureStagingBuffers();
+        arrayCopy(afters, perception, perceptionSize);
+        net->forward(afters);
+        action = bestAction(net->getOutput());
 //            cout << "action, q: " << action << endl;
     }
-    arrayCopy(this->lastPerception, perception, size * size * planes);
+    lastFrame = frame;
 //        printDirections(net, scenario->height, scenario->width);
     this->lastAction = action;
     return action;
 }
 
+int QLearner::bestAction(float const *qValues) {
+    float highestQ = 0;
+    int bestAction = 0;
+    for(int i = 0; i < numActions; i++) {
+        if(i == 0 || qValues[i] > highestQ) {
+            highestQ = qValues[i];
+            bestAction = i;
+        }
+    }
+    return bestAction;
+}
+
+void QLearner::learnAndSyncActors(NeuralNet *actorNet, float *weightsBuffer, int *p_numUpdates) {
+    if(replayMemory->size() == 0) {
+        return;
+    }
+    learnFromPast();
+    (*p_numUpdates)++;
+    if(*p_numUpdates % actorSyncInterval == 0) {
+        syncActors(actorNet, weightsBuffer, *p_numUpdates);
+    }
+}
+
+// copies the learner's weights to the actors' net, every actorSyncInterval updates
+void QLearner::syncActors(NeuralNet *actorNet, float *weightsBuffer, int numUpdates) {
+    copyWeights(net, actorNet, weightsBuffer);
+}
+
+void QLearner::runAsync(vector< Scenario * > const &scenarios) {
+    runAsync(scenarios, -1);
+}
+
+// numSteps -1 means run forever, like run()
+void QLearner::runAsync(vector< Scenario * > const &scenarios, int numSteps) {
+    const int numActors = (int)scenarios.size();
+    if(numActors == 0) {
+        throw runtime_error("QLearner::runAsync: need at least one scenario");
+    }
+    if(actorSyncInterval < 1) {
+        throw runtime_error("QLearner::runAsync: actorSyncInterval must be at least 1, but was " + toString(actorSyncInterval));
+    }
+    for(int a = 0; a < numActors; a++) {
+        if(scenarios[a]->getPerceptionSize() != size || scenarios[a]->getPerceptionPlanes() != planes
+                || scenarios[a]->getNumActions() != numActions) {
+            throw runtime_error("QLearner::runAsync: scenario " + toString(a) + " has different dimensions from the first scenario");
+        }
+    }
+    const int perceptionSize = size * size * planes;
+    // a memory from step() has one chain; the actors' interleaved frames would
+    // overwrite each other's latest frame in it, so we start a new one
+    if(replayMemory != 0 && replayMemory->getNumChains() != numActors) {
+        delete replayMemory;
+        replayMemory = 0;
+        lastAction = -1; // step()'s last frame is gone
+    }
+    if(replayMemory == 0) {
+        replayMemory = new ReplayMemory(replayCapacity, perceptionSize, numActors);
+    }
+    // the actors get their own copy of the net, at batch size numActors, so acting
+    // doesnt resize the learner's net, and the learner can update its weights freely
+    NeuralNet *actorNet = net->clone();
+    actorNet->setBatchSize(numActors);
+    float *weightsBuffer = new float[ WeightsPersister::getTotalNumWeights(net) ];
+    copyWeights(net, actorNet, weightsBuffer);
+
+    float *perceptions = new float[ numActors * perceptionSize ];
+    int *actorActions = new int[ numActors ];
+    float *actorRewards = new float[ numActors ];
+    bool *actorResets = new bool[ numActors ];
+    long long *lastFrames = new long long[ numActors ];
+    for(int a = 0; a < numActors; a++) {
+        scenarios[a]->getPerception(perceptions + a * perceptionSize);
+        lastFrames[a] = replayMemory->addFrame(perceptions + a * perceptionSize);
+    }
+    ActorStepTask task;
+    task.scenarios = &scenarios;
+    task.perceptionSize = perceptionSize;
+    task.actions = actorActions;
+    task.rewards = actorRewards;
+    task.wasResets = actorResets;
+    task.perceptions = perceptions;
+
+    game = 0;
+    int numUpdates = 0;
+    for(int actorStep = 0; numSteps < 0 || actorStep < numSteps; actorStep++) {
+        // one batched forward picks the next action for every actor
+        actorNet->forward(perceptions);
+        float const *allOutput = actorNet->getOutput();
+        for(int a = 0; a < numActors; a++) {
+            if((myrand() % 10000 / 10000.0f) <= epsilon) {
+                actorActions[a] = myrand() % numActions;
+            } else {
+                actorActions[a] = bestAction(allOutput + a * numActions);
+            }
+        }
+        // the actors simulate in the background, whilst this thread, which is the only
+        // one that touches OpenCL, trains on the transitions so far
+        #ifdef NOTHREADS
+        ThreadPool::instance()->run(numActors, &task);
+        learnAndSyncActors(actorNet, weightsBuffer, &numUpdates);
+        #else
+        exception_ptr actorException;
+        thread actorThread(runActorSteps, &task, numActors, &actorException);
+        try {
+            learnAndSyncActors(actorNet, weightsBuffer, &numUpdates);
+        } catch(...) {
+            actorThread.join();
+            throw;
+        }
+        actorThread.join();
+        if(actorException) {
+            rethrow_exception(actorException);
+        }
+        #endif
+        for(int a = 0; a < numActors; a++) {
+            const long long frame = replayMemory->addFrame(perceptions + a * perceptionSize);
+            replayMemory->addTransition(lastFrames[a], actorActions[a], actorRewards[a], actorResets[a], frame);
+            lastFrames[a] = frame;
+            if(actorResets[a]) {
+                game++;
+            }
+        }
+    }
+    delete[] lastFrames;
+    delete[] actorResets;
+    delete[] actorRewards;
+    delete[] actorActions;
+    delete[] perceptions;
+    delete[] weightsBuffer;
+    delete actorNet;
+}
+
 void QLearner::run() {
     game = 0;
 
@@ -16,25 +16,21 @@
 #include "DeepCLDllExport.h"
 
 class NeuralNet;
+class ReplayMemory;
 
-class Experience {
-public:
-    float *before;
-    int action;
-    float reward;
-    bool isEndState;
-    float *after;
-};
-
+// net is kept at batch size maxSamples throughout, so we dont resize the layers
+// each frame; greedy actions are read from the first example of a full batch
 class DeepCL_EXPORT QLearner {
     int epoch;
 public:
     Trainer *trainer;
 
-    // following 4 parameters are user-configurable:
+    // following parameters are user-configurable:
     float lambda; // means: how far into the future do we look? (any number from 0.0 to 1.0 is possible)
     int maxSamples;  // how many samples from history do we revise after each action? (default: 32)
+    int replayCapacity; // how many past transitions do we remember, at most? (default: 10000)
     float epsilon; // probability of exploring, instead of exploiting, 0.0 to 1.0 ok
+    int actorSyncInterval; // runAsync only: learner updates between copying the weights to the actors' net (default: 100)
 //    float learningRate; // learning rate for the neuralnet; depends on what is appropriate for your particular
 //                        // network design
 
@@ -42,13 +38,22 @@ public:
     // do one frame:
     int step(float lastReward, bool wasReset, float *perception);
     void run();  // main entry point
+    // alternative entry point: one actor per scenario, all simulated in parallel, whilst
+    // the learner trains; actions for all actors come from one batched forward of a copy
+    // of net, updated every actorSyncInterval learner updates
+    // scenarios must be independent instances, and safe to call from any thread
+    void runAsync(std::vector< Scenario * > const &scenarios);
+    // as runAsync, but returns after numSteps steps of every actor, eg for testing
+    void runAsync(std::vector< Scenario * > const &scenarios, int numSteps);
     virtual ~QLearner();
 
     void learnFromPast(); // internal method; probably not useful to user, but who knows, so leaving it 
                           // public :-)
     void setLambda(float lambda) { this->lambda = lambda; }
     void setMaxSamples(int maxSamples) { this->maxSamples = maxSamples; }
+    void setReplayCapacity(int replayCapacity); // call before the first step
     void setEpsilon(float epsilon) { this->epsilon = epsilon; }
+    void setActorSyncInterval(int actorSyncInterval); // at least 1
 //    void setLearningRate(float learningRate) { this->learningRate = learningRate; }
 
 protected:
@@ -56,14 +61,29 @@ protected:
     int planes;
     int numActions;
 
-  //  float *perception;
-    float *lastPerception;
+    void ensureStagingBuffers();
+    int bestAction(float const *qValues);
+    void learnAndSyncActors(NeuralNet *actorNet, float *weightsBuffer, int *p_numUpdates);
+    virtual void syncActors(NeuralNet *actorNet, float *weightsBuffer, int numUpdates);
+
+    long long lastFrame; // id of the last perception, in replayMemory
     int game;
     int lastAction;
 
     MT19937 myrand;
 
-    std::vector< Experience * > history;
+    ReplayMemory *replayMemory;
+
+    // minibatch staging, allocated once, for stagedBatchSize examples
+    int stagedBatchSize;
+    float *befores;
+    float *afters;
+    float *expectedValues;
+    float *bestQ;
+    int *actions;
+    float *rewards;
+    bool *isEndStates;
+
     Scenario *scenario; // NOT belong to us, dont delete
     NeuralNet *net; // NOT belong to us, dont delete
 };
@@ -0,0 +1,120 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstring>
+#include <stdexcept>
+
+#include "util/stringhelper.h"
+#include "qlearning/ReplayMemory.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+// numChains is how many interleaved streams of frames will be added, eg one per
+// actor; each chain holds on to its latest frame while the others add theirs, so
+// we keep that many frame slots over capacity, so the oldest transitions still
+// have both of their frames
+PUBLIC ReplayMemory::ReplayMemory(int capacity, int frameSize, int numChains) :
+        capacity(capacity),
+        frameSize(frameSize),
+        numChains(numChains < 1 ? 1 : numChains),
+        numFrameSlots(capacity + this->numChains),
+        nextFrameId(0),
+        numTransitions(0),
+        nextTransition(0) {
+    if(capacity < 1) {
+        throw runtime_error("ReplayMemory: capacity must be at least 1, but was " + toString(capacity));
+    }
+    frames = new float[ (long long)numFrameSlots * frameSize ];
+    frameIdBySlot.resize(numFrameSlots, -1);
+    transitions.resize(capacity);
+}
+PUBLIC ReplayMemory::~ReplayMemory() {
+    delete[] frames;
+}
+PUBLIC int ReplayMemory::getCapacity() const {
+    return capacity;
+}
+PUBLIC int ReplayMemory::getFrameSize() const {
+    return frameSize;
+}
+PUBLIC int ReplayMemory::getNumChains() const {
+    return numChains;
+}
+// number of transitions stored, up to capacity
+PUBLIC int ReplayMemory::size() const {
+    return numTransitions;
+}
+// copies frame into the arena, overwriting the oldest frame if full, and returns
+// its id, for use in addTransition
+PUBLIC long long ReplayMemory::addFrame(float const *frame) {
+    const long long frameId = nextFrameId++;
+    const int slot = (int)(frameId % numFrameSlots);
+    memcpy(frames + (long long)slot * frameSize, frame, sizeof(float) * frameSize);
+    frameIdBySlot[slot] = frameId;
+    return frameId;
+}
+PUBLIC void ReplayMemory::addTransition(long long beforeFrame, int action, float reward, bool isEndState, long long afterFrame) {
+    if(!hasFrame(beforeFrame) || !hasFrame(afterFrame)) {
+        throw runtime_error("ReplayMemory::addTransition: frame " + toString(hasFrame(beforeFrame) ? afterFrame : beforeFrame)
+            + " no longer stored");
+    }
+    Transition *transition = &transitions[nextTransition];
+    transition->beforeFrame = beforeFrame;
+    transition->afterFrame = afterFrame;
+    transition->action = action;
+    transition->reward = reward;
+    transition->isEndState = isEndState;
+    nextTransition = (nextTransition + 1) % capacity;
+    if(numTransitions < capacity) {
+        numTransitions++;
+    }
+}
+PUBLIC bool ReplayMemory::hasFrame(long long frameId) const {
+    return frameId >= 0 && frameIdBySlot[(int)(frameId % numFrameSlots)] == frameId;
+}
+PUBLIC float const *ReplayMemory::getFrame(long long frameId) const {
+    if(!hasFrame(frameId)) {
+        throw runtime_error("ReplayMemory::getFrame: frame " + toString(frameId) + " no longer stored");
+    }
+    return frames + (frameId % numFrameSlots) * frameSize;
+}
+// draws batchSize transitions uniformly, with replacement, and copies them into the
+// caller's staging arrays; befores and afters are [batchSize][frameSize]
+// if fewer than batchSize transitions are stored, some are drawn more than once
+PUBLIC void ReplayMemory::sample(MT19937 &random, int batchSize, float *befores, float *afters, int *actions, float *rewards, bool *isEndStates) const {
+    if(numTransitions == 0) {
+        throw runtime_error("ReplayMemory::sample: no transitions stored yet");
+    }
+    for(int n = 0; n < batchSize; n++) {
+        int transitionIdx = random() % numTransitions;
+        // a transition whose frame was overwritten by another chain moves on to the
+        // next usable one; with one chain this never happens
+        int numTried = 0;
+        while(!isUsable(transitionIdx)) {
+            transitionIdx = (transitionIdx + 1) % numTransitions;
+            numTried++;
+            if(numTried == numTransitions) {
+                throw runtime_error("ReplayMemory::sample: no usable transitions");
+            }
+        }
+        const Transition &transition = transitions[transitionIdx];
+        memcpy(befores + (long long)n * frameSize, getFrame(transition.beforeFrame), sizeof(float) * frameSize);
+        memcpy(afters + (long long)n * frameSize, getFrame(transition.afterFrame), sizeof(float) * frameSize);
+        actions[n] = transition.action;
+        rewards[n] = transition.reward;
+        isEndStates[n] = transition.isEndState;
+    }
+}
+PRIVATE bool ReplayMemory::isUsable(int transitionIdx) const {
+    const Transition &transition = transitions[transitionIdx];
+    return hasFrame(transition.beforeFrame) && hasFrame(transition.afterFrame);
+}
+
@@ -0,0 +1,79 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+#include "util/mt19937defs.h"
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// fixed-capacity experience replay, for QLearner
+// perceptions ('frames') live in one preallocated arena, used as a ring, and each
+// frame is stored once: the 'after' of one transition is the 'before' of the next
+// transitions refer to frames by id, and the oldest transitions are overwritten once
+// the memory is full, so memory use stays constant, however long we run
+// frame ids keep increasing; a transition whose frame slot has since been reused
+// is skipped when sampling
+// not thread-safe
+class DeepCL_EXPORT ReplayMemory {
+    public:
+    class Transition {
+    public:
+        long long beforeFrame;
+        long long afterFrame;
+        int action;
+        float reward;
+        bool isEndState;
+    };
+
+    private:
+    int capacity; // max transitions
+    int frameSize; // floats per frame
+    int numChains;
+    int numFrameSlots;
+    float *frames; // [numFrameSlots][frameSize]
+    long long nextFrameId;
+    int numTransitions;
+    int nextTransition;
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    std::vector<long long> frameIdBySlot; // -1 if slot not written yet
+    std::vector<Transition> transitions;
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    ReplayMemory(int capacity, int frameSize, int numChains);
+    ~ReplayMemory();
+    int getCapacity() const;
+    int getFrameSize() const;
+    int getNumChains() const;
+    int size() const;
+    long long addFrame(float const *frame);
+    void addTransition(long long beforeFrame, int action, float reward, bool isEndState, long long afterFrame);
+    bool hasFrame(long long frameId) const;
+    float const *getFrame(long long frameId) const;
+    void sample(MT19937 &random, int batchSize, float *befores, float *afters, int *actions, float *rewards, bool *isEndStates) const;
+
+    private:
+    bool isUsable(int transitionIdx) const;
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,396 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+#define INT8_VNNI
+#define INT8_VNNI_DPBUSD _mm256_dpbusd_epi32
+#include <immintrin.h>
+#elif defined(__AVXVNNI__)
+#define INT8_VNNI
+#define INT8_VNNI_DPBUSD _mm256_dpbusd_avx_epi32
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#define INT8_AVX2
+#include <immintrin.h>
+#endif
+
+#include "util/ThreadPool.h"
+#include "util/stringhelper.h"
+#include "util/StatefulTimer.h"
+#include "net/NeuralNet.h"
+#include "layer/Layer.h"
+#include "input/InputLayer.h"
+#include "normalize/NormalizationLayer.h"
+#include "conv/ConvolutionalLayer.h"
+#include "activate/ActivationLayer.h"
+#include "pooling/PoolingLayer.h"
+#include "dropout/DropoutLayer.h"
+#include "loss/SoftMaxLayer.h"
+#include "quantize/Int8Quantizer.h"
+#include "quantize/Int8Predictor.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#undef STATIC
+#define VIRTUAL
+#define STATIC
+
+// vnni multiplies unsigned by signed bytes, so there we store the quantized inputs
+// offset by 128, ie with the sign bit flipped, and dot() takes 128 * sum(weights)
+// back off again
+#ifdef INT8_VNNI
+#define INT8_COLUMNS_OFFSET 128
+#else
+#define INT8_COLUMNS_OFFSET 0
+#endif
+
+namespace {
+    // one image per task: quantize and im2col it into the thread's columns, then
+    // dot with every filter
+    class Int8ImageTask : public ThreadPoolTask {
+    public:
+        Int8Predictor *owner;
+        const Int8Predictor::QuantizedLayer *layer;
+        const float *input;
+        float *output;
+        virtual void run(int threadId, int taskId) {
+            owner->columnsTask(threadId, taskId, threadId, layer, input);
+            owner->filtersTask(taskId, threadId, 0, layer->dim.numFilters, layer, output);
+        }
+    };
+    // for batches smaller than the pool: quantize and im2col each image once, into
+    // columns of its own...
+    class Int8ColumnsTask : public ThreadPoolTask {
+    public:
+        Int8Predictor *owner;
+        const Int8Predictor::QuantizedLayer *layer;
+        const float *input;
+        virtual void run(int threadId, int taskId) {
+            owner->columnsTask(threadId, taskId, taskId, layer, input);
+        }
+    };
+    // ... then split just the dot products, by [image][block of filters]
+    class Int8FiltersTask : public ThreadPoolTask {
+    public:
+        Int8Predictor *owner;
+        int numFilterBlocks;
+        int filtersPerBlock;
+        const Int8Predictor::QuantizedLayer *layer;
+        float *output;
+        virtual void run(int threadId, int taskId) {
+            const int n = taskId / numFilterBlocks;
+            const int filterBegin = (taskId % numFilterBlocks) * filtersPerBlock;
+            const int filterEnd = filterBegin + filtersPerBlock;
+            owner->filtersTask(n, n, filterBegin, filterEnd, layer, output);
+        }
+    };
+    // flips the sign bit, when INT8_COLUMNS_OFFSET is 128
+    inline signed char toColumnsValue(signed char value) {
+        return (signed char)(value ^ (signed char)INT8_COLUMNS_OFFSET);
+    }
+}
+
+PUBLIC PUBLICAPI Int8Predictor::Int8Predictor(NeuralNet *net) :
+        net(net),
+        threadPool(ThreadPool::instance()),
+        allocatedBatchSize(0),
+        maxImageSize(0),
+        maxColumnsSize(0) {
+    const int version = 4;
+    quantizedByLayer.resize(net->getNumLayers(), 0);
+    outputByLayer.resize(net->getNumLayers(), 0);
+    imageByThread.resize(threadPool->getNumThreads(), 0);
+    columnsBySlot.resize(threadPool->getNumThreads(), 0);
+    for(int layerIdx = 1; layerIdx < net->getNumLayers(); layerIdx++) {
+        Layer *layer = net->getLayer(layerIdx);
+        ConvolutionalLayer *convolutionalLayer = Int8Quantizer::getQuantizableLayer(layer);
+        if(convolutionalLayer == 0) {
+            continue;
+        }
+        const LayerDimensions &dim = convolutionalLayer->dim;
+        if(!(convolutionalLayer->inputQuantizationScale > 0)) {
+            throw runtime_error("Int8Predictor: layer " + toString(layerIdx) + " " + layer->getClassName()
+                + " not calibrated; load a weights file written by deepcl_quantize, or call Int8Quantizer::calibrate");
+        }
+        if(dim.skip != 0) {
+            throw runtime_error("Int8Predictor: skip not supported, layer " + toString(layerIdx));
+        }
+        QuantizedLayer *quantized = new QuantizedLayer();
+        quantized->dim = dim;
+        const int filterCubeSize = dim.inputPlanes * dim.filterSizeSquared;
+        quantized->paddedLength = (filterCubeSize + 31) / 32 * 32;
+        quantized->inputScale = convolutionalLayer->inputQuantizationScale;
+        quantized->weights = new signed char[(long long)dim.numFilters * quantized->paddedLength];
+        quantized->weightSums = new int[dim.numFilters];
+        quantized->outputScales = new float[dim.numFilters];
+        quantized->bias = 0;
+        memset(quantized->weights, 0, (long long)dim.numFilters * quantized->paddedLength);
+
+        float *persistArray = new float[layer->getPersistSize(version)];
+        layer->persistToArray(version, persistArray); // weights, then bias
+        Int8Quantizer::quantizeFilters(dim.numFilters, filterCubeSize, persistArray,
+            quantized->weights, quantized->paddedLength, quantized->outputScales);
+        for(int filter = 0; filter < dim.numFilters; filter++) {
+            signed char const *filterWeights = quantized->weights + (long long)filter * quantized->paddedLength;
+            int weightSum = 0;
+            for(int i = 0; i < filterCubeSize; i++) {
+                weightSum += filterWeights[i];
+            }
+            quantized->weightSums[filter] = weightSum;
+            quantized->outputScales[filter] *= quantized->inputScale;
+        }
+        if(dim.biased) {
+            quantized->bias = new float[dim.numFilters];
+            memcpy(quantized->bias, persistArray + (long long)dim.numFilters * filterCubeSize, sizeof(float) * dim.numFilters);
+        }
+        delete[] persistArray;
+        quantizedByLayer[layerIdx] = quantized;
+        maxImageSize = max(maxImageSize, dim.inputCubeSize);
+        maxColumnsSize = max(maxColumnsSize, dim.outputSizeSquared * quantized->paddedLength);
+    }
+}
+PUBLIC PUBLICAPI Int8Predictor::~Int8Predictor() {
+    for(int i = 0; i < (int)quantizedByLayer.size(); i++) {
+        QuantizedLayer *quantized = quantizedByLayer[i];
+        if(quantized != 0) {
+            delete[] quantized->weights;
+            delete[] quantized->weightSums;
+            delete[] quantized->outputScales;
+            delete[] quantized->bias;
+            delete quantized;
+        }
+        delete[] outputByLayer[i];
+    }
+    for(int i = 0; i < (int)imageByThread.size(); i++) {
+        delete[] imageByThread[i];
+        delete[] columnsBySlot[i];
+    }
+}
+/// \brief Forwards batchSize images, [batchSize][planes][size][size], through layers up to outputLayer
+///
+/// outputLayer -1 means the last layer.  Returns the output of outputLayer, which
+/// stays valid until the next call
+PUBLIC PUBLICAPI float const *Int8Predictor::forward(int batchSize, float const *images, int outputLayer) {
+    if(outputLayer < 0) {
+        outputLayer = net->getNumLayers() - 1;
+    }
+    if(outputLayer >= net->getNumLayers()) {
+        throw runtime_error("Int8Predictor::forward: outputLayer " + toString(outputLayer) + " out of range, net has " + toString(net->getNumLayers()) + " layers");
+    }
+    allocate(batchSize);
+    float const *input = images;
+    for(int layerIdx = 1; layerIdx <= outputLayer; layerIdx++) {
+        Layer *layer = net->getLayer(layerIdx);
+        float *output = outputByLayer[layerIdx];
+        const int numPlanes = layer->getOutputPlanes();
+        const int outputSize = layer->getOutputSize();
+        const int outputNumElements = batchSize * numPlanes * outputSize * outputSize;
+        StatefulTimer::setPrefix("layer" + toString(layerIdx) + " ");
+        if(quantizedByLayer[layerIdx] != 0) {
+            forwardQuantizedLayer(batchSize, quantizedByLayer[layerIdx], input, output);
+        } else if(NormalizationLayer *normalizationLayer = dynamic_cast<NormalizationLayer *>(layer)) {
+            for(int i = 0; i < outputNumElements; i++) {
+                output[i] = (input[i] + normalizationLayer->translate) * normalizationLayer->scale;
+            }
+        } else if(ActivationLayer *activationLayer = dynamic_cast<ActivationLayer *>(layer)) {
+            for(int i = 0; i < outputNumElements; i++) {
+                output[i] = activationLayer->fn->calc(input[i]);
+            }
+        } else if(PoolingLayer *poolingLayer = dynamic_cast<PoolingLayer *>(layer)) {
+            // same as PoolingForwardCpu, without the selectors
+            const int inputSize = poolingLayer->inputSize;
+            const int poolingSize = poolingLayer->poolingSize;
+            for(int plane = 0; plane < batchSize * numPlanes; plane++) {
+                float const *inputPlane = input + (long long)plane * inputSize * inputSize;
+                float *outputPlane = output + (long long)plane * outputSize * outputSize;
+                for(int outputRow = 0; outputRow < outputSize; outputRow++) {
+                    const int inputRow = outputRow * poolingSize;
+                    for(int outputCol = 0; outputCol < outputSize; outputCol++) {
+                        const int inputCol = outputCol * poolingSize;
+                        float maxValue = inputPlane[inputRow * inputSize + inputCol];
+                        for(int dx = 0; dx < poolingSize && inputRow + dx < inputSize; dx++) {
+                            for(int dy = 0; dy < poolingSize && inputCol + dy < inputSize; dy++) {
+                                maxValue = max(maxValue, inputPlane[(inputRow + dx) * inputSize + inputCol + dy]);
+                            }
+                        }
+                        outputPlane[outputRow * outputSize + outputCol] = maxValue;
+                    }
+                }
+            }
+        } else if(DropoutLayer *dropoutLayer = dynamic_cast<DropoutLayer *>(layer)) {
+            // same as DropoutLayer, when not training
+            for(int i = 0; i < outputNumElements; i++) {
+                output[i] = input[i] * dropoutLayer->dropRatio;
+            }
+        } else if(SoftMaxLayer *softMaxLayer = dynamic_cast<SoftMaxLayer *>(layer)) {
+            // per plane, or, for imagesize 1, across planes, like SoftMaxLayer::forward
+            const int groupSize = softMaxLayer->perPlane ? softMaxLayer->imageSizeSquared : numPlanes;
+            if(!softMaxLayer->perPlane && softMaxLayer->imageSize != 1) {
+                throw runtime_error("Int8Predictor: softmax across planes only supported for imagesize 1");
+            }
+            for(int group = 0; group < outputNumElements / groupSize; group++) {
+                float const *groupInput = input + (long long)group * groupSize;
+                float *groupOutput = output + (long long)group * groupSize;
+                float maxValue = groupInput[0];
+                for(int i = 1; i < groupSize; i++) {
+                    maxValue = max(maxValue, groupInput[i]);
+                }
+                float denominator = 0;
+                for(int i = 0; i < groupSize; i++) {
+                    denominator += exp(groupInput[i] - maxValue);
+                }
+                for(int i = 0; i < groupSize; i++) {
+                    groupOutput[i] = exp(groupInput[i] - maxValue) / denominator;
+                }
+            }
+        } else {
+            throw runtime_error("Int8Predictor: layer " + toString(layerIdx) + " " + layer->getClassName() + " not supported");
+        }
+        StatefulTimer::setPrefix("");
+        input = output;
+    }
+    return input;
+}
+// quantizes image n of input, and im2cols it into columnsBySlot[slot]
+PUBLIC void Int8Predictor::columnsTask(int threadId, int n, int slot, QuantizedLayer const *layer, float const *input) {
+    const LayerDimensions &dim = layer->dim;
+    if(imageByThread[threadId] == 0) {
+        imageByThread[threadId] = new signed char[maxImageSize];
+    }
+    if(columnsBySlot[slot] == 0) {
+        columnsBySlot[slot] = new signed char[maxColumnsSize];
+    }
+    signed char *image = imageByThread[threadId];
+    signed char *columns = columnsBySlot[slot];
+    float const *inputImage = input + (long long)n * dim.inputCubeSize;
+    for(int i = 0; i < dim.inputCubeSize; i++) {
+        image[i] = toColumnsValue(Int8Quantizer::quantize(inputImage[i], layer->inputScale));
+    }
+    // im2col, one row per output position: columns[outPos][inPlane, filterRow, filterCol]
+    // outside the image, and in the padding at the end of each row, the input is 0
+    const int padding = dim.padZeros ? dim.halfFilterSize : 0;
+    const signed char zero = toColumnsValue(0);
+    for(int outRow = 0; outRow < dim.outputSize; outRow++) {
+        for(int outCol = 0; outCol < dim.outputSize; outCol++) {
+            signed char *row = columns + (long long)(outRow * dim.outputSize + outCol) * layer->paddedLength;
+            int k = 0;
+            for(int inPlane = 0; inPlane < dim.inputPlanes; inPlane++) {
+                signed char const *imagePlane = image + inPlane * dim.inputSizeSquared;
+                for(int filterRow = 0; filterRow < dim.filterSize; filterRow++) {
+                    const int inRow = outRow + filterRow - padding;
+                    const bool rowInside = inRow >= 0 && inRow < dim.inputSize;
+                    for(int filterCol = 0; filterCol < dim.filterSize; filterCol++) {
+                        const int inCol = outCol + filterCol - padding;
+                        row[k++] = rowInside && inCol >= 0 && inCol < dim.inputSize ? imagePlane[inRow * dim.inputSize + inCol] : zero;
+                    }
+                }
+            }
+            for(; k < layer->paddedLength; k++) {
+                row[k] = zero;
+            }
+        }
+    }
+}
+// dots columnsBySlot[slot], from columnsTask for image n, with filters [filterBegin, filterEnd)
+PUBLIC void Int8Predictor::filtersTask(int n, int slot, int filterBegin, int filterEnd, QuantizedLayer const *layer, float *output) {
+    const LayerDimensions &dim = layer->dim;
+    filterEnd = min(filterEnd, dim.numFilters);
+    signed char const *columns = columnsBySlot[slot];
+    for(int filter = filterBegin; filter < filterEnd; filter++) {
+        signed char const *filterWeights = layer->weights + (long long)filter * layer->paddedLength;
+        const int weightSum = layer->weightSums[filter];
+        const float outputScale = layer->outputScales[filter];
+        const float bias = layer->bias != 0 ? layer->bias[filter] : 0.0f;
+        float *outputPlane = output + (long long)n * dim.outputCubeSize + filter * dim.outputSizeSquared;
+        for(int outPos = 0; outPos < dim.outputSizeSquared; outPos++) {
+            const int sum = dot(columns + (long long)outPos * layer->paddedLength, filterWeights, layer->paddedLength, weightSum);
+            outputPlane[outPos] = sum * outputScale + bias;
+        }
+    }
+}
+// sum of columns[i] * weights[i], over length, a multiple of 32; weightSum is the sum
+// of weights, for taking off the vnni offset
+PUBLIC STATIC int Int8Predictor::dot(signed char const *columns, signed char const *weights, int length, int weightSum) {
+    #if defined(INT8_VNNI)
+    __m256i sum = _mm256_setzero_si256();
+    for(int i = 0; i < length; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(columns + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i));
+        sum = INT8_VNNI_DPBUSD(sum, a, b);
+    }
+    #elif defined(INT8_AVX2)
+    __m256i sum = _mm256_setzero_si256();
+    for(int i = 0; i < length; i += 16) {
+        __m256i a = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(columns + i)));
+        __m256i b = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, b));
+    }
+    #endif
+    #if defined(INT8_VNNI) || defined(INT8_AVX2)
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_hadd_epi32(sum128, sum128);
+    sum128 = _mm_hadd_epi32(sum128, sum128);
+    return _mm_cvtsi128_si32(sum128) - INT8_COLUMNS_OFFSET * weightSum;
+    #else
+    int sum = 0;
+    for(int i = 0; i < length; i++) {
+        sum += columns[i] * weights[i];
+    }
+    return sum;
+    #endif
+}
+PRIVATE void Int8Predictor::allocate(int batchSize) {
+    if(batchSize <= allocatedBatchSize) {
+        return;
+    }
+    for(int layerIdx = 1; layerIdx < net->getNumLayers(); layerIdx++) {
+        Layer *layer = net->getLayer(layerIdx);
+        delete[] outputByLayer[layerIdx];
+        outputByLayer[layerIdx] = new float[(long long)batchSize * layer->getOutputPlanes() * layer->getOutputSize() * layer->getOutputSize()];
+    }
+    allocatedBatchSize = batchSize;
+}
+PRIVATE void Int8Predictor::forwardQuantizedLayer(int batchSize, QuantizedLayer const *layer, float const *input, float *output) {
+    StatefulTimer::timeCheck("Int8Predictor::forwardQuantizedLayer START");
+    // if the batch is smaller than the pool, also split the filters, as ForwardCpuIm2Col,
+    // but still quantize and im2col each image just once
+    const int numThreads = threadPool->getNumThreads();
+    int numFilterBlocks = 1;
+    if(batchSize < numThreads) {
+        numFilterBlocks = (numThreads + batchSize - 1) / batchSize;
+        numFilterBlocks = max(1, min(numFilterBlocks, layer->dim.numFilters / 16));
+    }
+    if(numFilterBlocks == 1) {
+        Int8ImageTask task;
+        task.owner = this;
+        task.layer = layer;
+        task.input = input;
+        task.output = output;
+        threadPool->run(batchSize, &task);
+    } else {
+        // one columns slot per image, which fits, since batchSize < numThreads
+        Int8ColumnsTask prePass;
+        prePass.owner = this;
+        prePass.layer = layer;
+        prePass.input = input;
+        threadPool->run(batchSize, &prePass);
+        Int8FiltersTask dotProducts;
+        dotProducts.owner = this;
+        dotProducts.numFilterBlocks = numFilterBlocks;
+        dotProducts.filtersPerBlock = (layer->dim.numFilters + numFilterBlocks - 1) / numFilterBlocks;
+        dotProducts.layer = layer;
+        dotProducts.output = output;
+        threadPool->run(batchSize * numFilterBlocks, &dotProducts);
+    }
+    StatefulTimer::timeCheck("Int8Predictor::forwardQuantizedLayer END");
+}
+
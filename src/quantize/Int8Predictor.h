@@ -0,0 +1,91 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+#include "conv/LayerDimensions.h"
+
+class NeuralNet;
+class ThreadPool;
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+/// \brief Inference on the cpu, with convolutional and fully-connected layers in int8
+///
+/// Needs a net whose layers were calibrated, either by Int8Quantizer::calibrate, or by
+/// loading a weights file written by deepcl_quantize.  The weights are quantized once,
+/// per filter, in the constructor.  For each image, the input of each of these layers
+/// is quantized with the layer's input scale, im2col'd into int8 rows, and dotted with
+/// each filter into int32, which is then scaled back to float, and biased.
+/// Dot products use avx-vnni, or avx512-vnni, if compiled with those enabled, else avx2,
+/// else plain loops; see BUILD_NATIVE_CPU_KERNELS.
+/// Normalization, activation, max-pooling, dropout and softmax layers run on the
+/// float values in between, on the calling thread: they're cheap next to the
+/// convolutions.  Other layer types throw.
+/// Work is spread across the ThreadPool by image; for batches smaller than the pool, each
+/// image is quantized and im2col'd once, then the dot products are split by
+/// [image][block of filters], like ForwardCpuIm2Col.
+/// The net itself is only read, so it can stay on the gpu, or be used for other things.
+PUBLICAPI
+class DeepCL_EXPORT Int8Predictor {
+    public:
+    class QuantizedLayer {
+    public:
+        LayerDimensions dim;
+        int paddedLength; // inputPlanes * filterSizeSquared, rounded up to multiple of 32
+        float inputScale;
+        signed char *weights; // [numFilters][paddedLength], zero-padded
+        int *weightSums; // [numFilters], for the vnni offset correction
+        float *outputScales; // [numFilters], inputScale * weight scale
+        float *bias; // [numFilters], or 0 if not biased
+    };
+
+    private:
+    NeuralNet *net;
+    ThreadPool *threadPool;
+    int allocatedBatchSize;
+    int maxImageSize; // bytes of quantized input, over all quantized layers
+    int maxColumnsSize; // bytes of im2col rows, over all quantized layers
+
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    std::vector<QuantizedLayer *> quantizedByLayer; // 0 for layers that arent quantized
+    std::vector<float *> outputByLayer;
+    // scratch, one per thread, allocated on first use: the quantized input, by threadId,
+    // and the im2col rows, by threadId, or by image when the filters are split
+    std::vector<signed char *> imageByThread;
+    std::vector<signed char *> columnsBySlot;
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    PUBLICAPI Int8Predictor(NeuralNet *net);
+    PUBLICAPI ~Int8Predictor();
+    PUBLICAPI float const *forward(int batchSize, float const *images, int outputLayer);
+    void columnsTask(int threadId, int n, int slot, QuantizedLayer const *layer, float const *input);
+    void filtersTask(int n, int slot, int filterBegin, int filterEnd, QuantizedLayer const *layer, float *output);
+    STATIC int dot(signed char const *columns, signed char const *weights, int length, int weightSum);
+
+    private:
+    void allocate(int batchSize);
+    void forwardQuantizedLayer(int batchSize, QuantizedLayer const *layer, float const *input, float *output);
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,189 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "util/stringhelper.h"
+#include "net/NeuralNet.h"
+#include "layer/Layer.h"
+#include "conv/ConvolutionalLayer.h"
+#include "fc/FullyConnectedLayer.h"
+#include "loaders/GenericLoaderv2.h"
+#include "quantize/Int8Quantizer.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL
+#undef STATIC
+#define STATIC
+
+// the convolutional layer holding the weights, for convolutional and fully-connected
+// layers, otherwise 0
+PUBLIC STATIC ConvolutionalLayer *Int8Quantizer::getQuantizableLayer(Layer *layer) {
+    ConvolutionalLayer *convolutionalLayer = dynamic_cast<ConvolutionalLayer *>(layer);
+    if(convolutionalLayer != 0) {
+        return convolutionalLayer;
+    }
+    FullyConnectedLayer *fullyConnectedLayer = dynamic_cast<FullyConnectedLayer *>(layer);
+    if(fullyConnectedLayer != 0) {
+        return fullyConnectedLayer->convolutionalLayer;
+    }
+    return 0;
+}
+// round to nearest, clamped to [-127, 127], so the range is symmetric
+PUBLIC STATIC signed char Int8Quantizer::quantize(float value, float scale) {
+    float scaled = value / scale;
+    if(scaled >= 127.0f) {
+        return 127;
+    }
+    if(scaled <= -127.0f) {
+        return -127;
+    }
+    return (signed char)(scaled >= 0 ? (int)(scaled + 0.5f) : -(int)(0.5f - scaled));
+}
+// weights is [numFilters][filterCubeSize]; writes each filter to target + filter * targetStride,
+// and its scale to scales[filter].  An all-zero filter gets scale 1
+PUBLIC STATIC void Int8Quantizer::quantizeFilters(int numFilters, int filterCubeSize, float const *weights, signed char *target, int targetStride, float *scales) {
+    for(int filter = 0; filter < numFilters; filter++) {
+        float const *filterWeights = weights + (long long)filter * filterCubeSize;
+        float maxAbs = 0;
+        for(int i = 0; i < filterCubeSize; i++) {
+            maxAbs = max(maxAbs, fabs(filterWeights[i]));
+        }
+        const float scale = maxAbs > 0 ? maxAbs / 127.0f : 1.0f;
+        signed char *filterTarget = target + (long long)filter * targetStride;
+        for(int i = 0; i < filterCubeSize; i++) {
+            filterTarget[i] = quantize(filterWeights[i], scale);
+        }
+        scales[filter] = scale;
+    }
+}
+// bytes, in a weights file
+PUBLIC STATIC long long Int8Quantizer::getInt8PersistSize(ConvolutionalLayer *layer) {
+    const LayerDimensions &dim = layer->dim;
+    return 4 * (1 + dim.numFilters + (dim.biased ? dim.numFilters : 0)) + (long long)layer->getWeightsSize();
+}
+// persistArray is the layer's own persistToArray() output: the float weights, then the bias
+PUBLIC STATIC void Int8Quantizer::persistInt8(ConvolutionalLayer *layer, float const *persistArray, char *target) {
+    const LayerDimensions &dim = layer->dim;
+    if(!(layer->inputQuantizationScale > 0)) {
+        throw runtime_error("Int8Quantizer: layer " + toString(layer->layerIndex) + " has no input scale; run Int8Quantizer::calibrate, eg via deepcl_quantize, before storing as int8");
+    }
+    const int filterCubeSize = dim.inputPlanes * dim.filterSizeSquared;
+    float *targetFloats = reinterpret_cast<float *>(target);
+    targetFloats[0] = layer->inputQuantizationScale;
+    float *weightScales = targetFloats + 1;
+    int numFloats = 1 + dim.numFilters;
+    if(dim.biased) {
+        memcpy(targetFloats + numFloats, persistArray + layer->getWeightsSize(), sizeof(float) * dim.numFilters);
+        numFloats += dim.numFilters;
+    }
+    quantizeFilters(dim.numFilters, filterCubeSize, persistArray,
+        reinterpret_cast<signed char *>(target + 4 * numFloats), filterCubeSize, weightScales);
+}
+// the reverse of persistInt8: dequantizes into persistArray, for the layer's
+// unpersistFromArray(), and sets the layer's input scale
+PUBLIC STATIC void Int8Quantizer::unpersistInt8(ConvolutionalLayer *layer, char const *source, float *persistArray) {
+    const LayerDimensions &dim = layer->dim;
+    const int filterCubeSize = dim.inputPlanes * dim.filterSizeSquared;
+    float const *sourceFloats = reinterpret_cast<float const *>(source);
+    float const *weightScales = sourceFloats + 1;
+    int numFloats = 1 + dim.numFilters;
+    if(dim.biased) {
+        memcpy(persistArray + layer->getWeightsSize(), sourceFloats + numFloats, sizeof(float) * dim.numFilters);
+        numFloats += dim.numFilters;
+    }
+    signed char const *weights = reinterpret_cast<signed char const *>(source + 4 * numFloats);
+    for(int filter = 0; filter < dim.numFilters; filter++) {
+        const float scale = weightScales[filter];
+        const long long filterOffset = (long long)filter * filterCubeSize;
+        for(int i = 0; i < filterCubeSize; i++) {
+            persistArray[filterOffset + i] = weights[filterOffset + i] * scale;
+        }
+    }
+    layer->inputQuantizationScale = sourceFloats[0];
+}
+/// \brief Sets the input scale of each convolutional and fully-connected layer, from the first numExamples images in loader
+///
+/// runs the float net forward, in batches of batchSize, and records the largest absolute
+/// value arriving at each of these layers.  Leaves the net's batch size as batchSize.
+/// Any remainder of numExamples that doesnt fill a batch is ignored.
+PUBLIC PUBLICAPI STATIC void Int8Quantizer::calibrate(NeuralNet *net, GenericLoaderv2 *loader, int batchSize, int numExamples) {
+    calibrate(net, loader, batchSize, numExamples, false);
+}
+/// \brief Same, and if verbose, prints the input range found for each layer
+PUBLIC PUBLICAPI STATIC void Int8Quantizer::calibrate(NeuralNet *net, GenericLoaderv2 *loader, int batchSize, int numExamples, bool verbose) {
+    numExamples = min(numExamples, loader->getN());
+    if(numExamples < batchSize) {
+        throw runtime_error("Int8Quantizer::calibrate: need at least batchSize " + toString(batchSize) + " calibration examples, but have " + toString(numExamples));
+    }
+    const long long inputCubeSize = (long long)loader->getPlanes() * loader->getImageSize() * loader->getImageSize();
+    float *images = new float[inputCubeSize * batchSize];
+    vector<float> maxAbsByLayer(net->getNumLayers(), 0.0f);
+    net->setBatchSize(batchSize);
+    net->setTraining(false);
+    for(int n = 0; n + batchSize <= numExamples; n += batchSize) {
+        // pass 0 for labels, so GenericLoaderv2 doesnt load any
+        loader->load(images, 0, n, batchSize);
+        net->forward(images);
+        observeInputs(net, maxAbsByLayer);
+    }
+    delete[] images;
+    setInputScales(net, maxAbsByLayer, verbose);
+}
+/// \brief Same as the GenericLoaderv2 version, but with the calibration images already in memory, as [numExamples][planes][size][size]
+PUBLIC PUBLICAPI STATIC void Int8Quantizer::calibrate(NeuralNet *net, float const *images, int batchSize, int numExamples) {
+    calibrate(net, images, batchSize, numExamples, false);
+}
+/// \brief Same, and if verbose, prints the input range found for each layer
+PUBLIC PUBLICAPI STATIC void Int8Quantizer::calibrate(NeuralNet *net, float const *images, int batchSize, int numExamples, bool verbose) {
+    if(numExamples < batchSize) {
+        throw runtime_error("Int8Quantizer::calibrate: need at least batchSize " + toString(batchSize) + " calibration examples, but have " + toString(numExamples));
+    }
+    const long long inputCubeSize = net->getLayer(0)->getOutputCubeSize();
+    vector<float> maxAbsByLayer(net->getNumLayers(), 0.0f);
+    net->setBatchSize(batchSize);
+    net->setTraining(false);
+    for(int n = 0; n + batchSize <= numExamples; n += batchSize) {
+        net->forward(images + n * inputCubeSize);
+        observeInputs(net, maxAbsByLayer);
+    }
+    setInputScales(net, maxAbsByLayer, verbose);
+}
+PRIVATE STATIC void Int8Quantizer::observeInputs(NeuralNet *net, std::vector<float> &maxAbsByLayer) {
+    for(int layerIdx = 1; layerIdx < net->getNumLayers(); layerIdx++) {
+        if(getQuantizableLayer(net->getLayer(layerIdx)) == 0) {
+            continue;
+        }
+        Layer *previousLayer = net->getLayer(layerIdx - 1);
+        float const *input = previousLayer->getOutput();
+        const int numElements = previousLayer->getOutputNumElements();
+        float maxAbs = maxAbsByLayer[layerIdx];
+        for(int i = 0; i < numElements; i++) {
+            maxAbs = max(maxAbs, fabs(input[i]));
+        }
+        maxAbsByLayer[layerIdx] = maxAbs;
+    }
+}
+PRIVATE STATIC void Int8Quantizer::setInputScales(NeuralNet *net, std::vector<float> const &maxAbsByLayer, bool verbose) {
+    for(int layerIdx = 1; layerIdx < net->getNumLayers(); layerIdx++) {
+        ConvolutionalLayer *layer = getQuantizableLayer(net->getLayer(layerIdx));
+        if(layer == 0) {
+            continue;
+        }
+        const float maxAbs = maxAbsByLayer[layerIdx];
+        layer->inputQuantizationScale = maxAbs > 0 ? maxAbs / 127.0f : 1.0f;
+        if(verbose) {
+            cout << "layer " << layerIdx << " " << net->getLayer(layerIdx)->getClassName() << ": input max abs " << maxAbs << endl;
+        }
+    }
+}
+
@@ -0,0 +1,57 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+class Layer;
+class ConvolutionalLayer;
+class NeuralNet;
+class GenericLoaderv2;
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+/// \brief Post-training int8 quantization, of convolutional and fully-connected layers
+///
+/// Weights are quantized symmetrically, per filter, ie per output channel: each filter
+/// gets scale max|w| / 127.  Each layer's input gets a single scale, max|x| / 127, where
+/// max|x| is observed by running calibration images through the float net, see calibrate().
+/// Int8Predictor then runs these layers with int8 dot products.
+/// In a version 4 weights file, with NeuralNet::setWeightsStorage("int8"), each of these
+/// layers is stored as:
+///     float inputScale, float weightScales[numFilters], float bias[numFilters] (if biased),
+///     signed char weights[numFilters][inputPlanes][filterSize][filterSize]
+PUBLICAPI
+class DeepCL_EXPORT Int8Quantizer {
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    STATIC ConvolutionalLayer *getQuantizableLayer(Layer *layer);
+    STATIC signed char quantize(float value, float scale);
+    STATIC void quantizeFilters(int numFilters, int filterCubeSize, float const *weights, signed char *target, int targetStride, float *scales);
+    STATIC long long getInt8PersistSize(ConvolutionalLayer *layer);
+    STATIC void persistInt8(ConvolutionalLayer *layer, float const *persistArray, char *target);
+    STATIC void unpersistInt8(ConvolutionalLayer *layer, char const *source, float *persistArray);
+    PUBLICAPI STATIC void calibrate(NeuralNet *net, GenericLoaderv2 *loader, int batchSize, int numExamples);
+    PUBLICAPI STATIC void calibrate(NeuralNet *net, GenericLoaderv2 *loader, int batchSize, int numExamples, bool verbose);
+    PUBLICAPI STATIC void calibrate(NeuralNet *net, float const *images, int batchSize, int numExamples);
+    PUBLICAPI STATIC void calibrate(NeuralNet *net, float const *images, int batchSize, int numExamples, bool verbose);
+
+    private:
+    STATIC void observeInputs(NeuralNet *net, std::vector<float> &maxAbsByLayer);
+    STATIC void setInputScales(NeuralNet *net, std::vector<float> const &maxAbsByLayer, bool verbose);
+
+    // [[[end]]]
+};
+
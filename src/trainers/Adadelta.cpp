@@ -15,7 +15,7 @@
 #include "trainers/Adadelta.h"
 #include "loss/IAcceptsLabels.h"
 #include "batch/NetAction.h"
-#include "clmath/CLMathWrapper.h"
+#include "trainers/OptimizerKernels.h"
 #include "batch/BatchData.h"
 
 //#include "test/Sampler.h"
@@ -40,41 +40,10 @@ VIRTUAL void Adadelta::updateWeights(CLWrapper *weightsWrapper, CLWrapper *gradW
     // update = - sumUpdateSquared.sqrt() / sumGradSquared.sqrt() * grad
     // sumUpdateSquared = decay * sumUpdateSquared + (1 - decay) * update.squared()
     // weights += update
-
-    int numWeights = trainerState->numWeights;
-    float *working = new float[ numWeights ];
-    CLWrapper *workingWrapper = cl->wrap(numWeights, working);
-    workingWrapper->createOnDevice();
-
-    CLMathWrapper clWeights(weightsWrapper);
-    CLMathWrapper clGradWeights(gradWeightsWrapper);
-    CLMathWrapper clSumGradSquared(trainerState->sumGradSquaredWrapper);
-    CLMathWrapper clSumUpdateSquared(trainerState->sumUpdateSquaredWrapper);
-    CLMathWrapper clWorking(workingWrapper);
-
-    // following all happens on gpu, via clmathwrapper:
-    clWorking = clGradWeights;
-    clWorking.squared();
-    clWorking *= (1 - decay);
-    clSumGradSquared *= decay;
-    clSumGradSquared += clWorking;
-
-    clWorking = clSumGradSquared;
-    clWorking.inv();
-    clWorking *= clSumUpdateSquared;
-    clWorking.sqrt();
-    clWorking *= clGradWeights;
-    clWorking *= - 1;
-
-    clWeights += clWorking;
-
-    clSumUpdateSquared *= decay;
-    clWorking.squared();
-    clWorking *= (1 - decay);
-    clSumUpdateSquared += clWorking;
-
-    delete workingWrapper;
-    delete[] working;
+    // all in a single kernel, see cl/optimizers.cl
+    optimizerKernels->adadelta(trainerState->numWeights, decay,
+        weightsWrapper, gradWeightsWrapper,
+        trainerState->sumGradSquaredWrapper, trainerState->sumUpdateSquaredWrapper);
 }
 VIRTUAL BatchResult Adadelta::trainNet(NeuralNet *net, TrainingContext *context,
     float const*input, OutputData *outputData) {
@@ -119,6 +88,11 @@ VIRTUAL void Adadelta::bindState(NeuralNet *net) {
     AdadeltaStateMaker stateMaker;
     this->_bindState(net, &stateMaker);
 }
+VIRTUAL Trainer *Adadelta::clone(EasyCL *cl) const {
+    Adadelta *copy = new Adadelta(cl, decay);
+    copy->setLearningRate(learningRate);
+    return copy;
+}
 STATIC Adadelta *Adadelta::instance(EasyCL *cl, float decay) {
     Adadelta *trainer = new Adadelta(cl, decay);
     return trainer;
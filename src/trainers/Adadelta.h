@@ -44,6 +44,7 @@ public:
     VIRTUAL BatchResult trainNetFromLabels(NeuralNet *net, TrainingContext *context,
     float const*input, int const*labels);
     VIRTUAL void bindState(NeuralNet *net);
+    VIRTUAL Trainer *clone(EasyCL *cl) const;
     STATIC Adadelta *instance(EasyCL *cl, float decay);
     Adadelta(EasyCL *cl, float decay);
 
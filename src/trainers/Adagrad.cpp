@@ -15,7 +15,7 @@
 #include "trainers/Adagrad.h"
 #include "loss/IAcceptsLabels.h"
 #include "batch/NetAction.h"
-#include "clmath/CLMathWrapper.h"
+#include "trainers/OptimizerKernels.h"
 #include "batch/BatchData.h"
 
 //#include "test/Sampler.h"
@@ -39,31 +39,11 @@ VIRTUAL std::string Adagrad::asString() {
 }
 VIRTUAL void Adagrad::updateWeights(CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper,
         AdagradState *trainerState) {
-
-    int numWeights = trainerState->numWeights;
-    float *working = new float[ numWeights ];
-    CLWrapper *workingWrapper = cl->wrap(numWeights, working);
-    workingWrapper->createOnDevice();
-
-    CLMathWrapper clWeights(weightsWrapper);
-    CLMathWrapper clGradWeights(gradWeightsWrapper);
-    CLMathWrapper clSumSquares(trainerState->sumSquaresWrapper);
-    CLMathWrapper clWorking(workingWrapper);
-
-    // following all happens on gpu, via clmathwrapper:
-    clWorking = clGradWeights;
-    clWorking.squared();
-    clSumSquares += clWorking;
-
-    clWorking = clSumSquares;
-    clWorking.sqrt();
-    clWorking.inv();
-    clWorking *= clGradWeights;
-    clWorking *= - learningRate;
-    clWeights += clWorking;
-
-    delete workingWrapper;
-    delete[] working;
+    // sumSquares += gradWeights ^ 2
+    // weights -= learningRate * gradWeights / sqrt(sumSquares)
+    // in a single kernel, see cl/optimizers.cl
+    optimizerKernels->adagrad(trainerState->numWeights, learningRate,
+        weightsWrapper, gradWeightsWrapper, trainerState->sumSquaresWrapper);
 }
 VIRTUAL BatchResult Adagrad::trainNet(NeuralNet *net, TrainingContext *context,
     float const*input, OutputData *outputData) {
@@ -108,6 +88,12 @@ VIRTUAL void Adagrad::bindState(NeuralNet *net) {
     AdagradStateMaker stateMaker(fudgeFactor);
     this->_bindState(net, &stateMaker);
 }
+VIRTUAL Trainer *Adagrad::clone(EasyCL *cl) const {
+    Adagrad *copy = new Adagrad(cl);
+    copy->setLearningRate(learningRate);
+    copy->setFudgeFactor(fudgeFactor);
+    return copy;
+}
 STATIC Adagrad *Adagrad::instance(EasyCL *cl, float learningRate) {
     Adagrad *sgd = new Adagrad(cl);
     sgd->setLearningRate(learningRate);
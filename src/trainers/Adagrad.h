@@ -46,6 +46,7 @@ public:
     VIRTUAL BatchResult trainNetFromLabels(NeuralNet *net, TrainingContext *context,
     float const*input, int const*labels);
     VIRTUAL void bindState(NeuralNet *net);
+    VIRTUAL Trainer *clone(EasyCL *cl) const;
     STATIC Adagrad *instance(EasyCL *cl, float learningRate);
     Adagrad(EasyCL *cl);
 
@@ -13,6 +13,7 @@
 #include "net/NeuralNet.h"
 #include "layer/Layer.h"
 #include "clmath/CLMathWrapper.h"
+#include "clmath/ScratchPool.h"
 #include "loss/LossLayer.h"
 #include "loss/IAcceptsLabels.h"
 #include "batch/BatchData.h"
@@ -24,6 +25,12 @@ using namespace std;
 #define STATIC
 #define VIRTUAL
 
+VIRTUAL Trainer *Annealer::clone(EasyCL *cl) const {
+    Annealer *copy = new Annealer(cl);
+    copy->setLearningRate(learningRate);
+    copy->setAnneal(anneal);
+    return copy;
+}
 STATIC Annealer *Annealer::instance(EasyCL *cl, float learningRate, float anneal) {
     Annealer *annealer = new Annealer(cl);
     annealer->setLearningRate(learningRate);
@@ -57,9 +64,7 @@ VIRTUAL void Annealer::updateWeights(float annealedLearningRate, CLWrapper *weig
 
     int numWeights = weightsWrapper->size();
 
-    float *gradWeightsCopy = new float[ numWeights ];
-    CLWrapper *gradWeightsCopyWrapper = cl->wrap(numWeights, gradWeightsCopy);
-    gradWeightsCopyWrapper->createOnDevice();
+    CLWrapper *gradWeightsCopyWrapper = scratchPool->borrow(numWeights);
 
     CLMathWrapper gradWeights_(gradWeightsWrapper);
     CLMathWrapper gradWeightsCopy_(gradWeightsCopyWrapper);
@@ -70,8 +75,7 @@ VIRTUAL void Annealer::updateWeights(float annealedLearningRate, CLWrapper *weig
     gradWeightsCopy_ *= - annealedLearningRate;
     weights_ += gradWeightsCopy_;
 
-    delete gradWeightsCopyWrapper;
-    delete[] gradWeightsCopy;
+    scratchPool->giveBack(gradWeightsCopyWrapper);
 }
 VIRTUAL BatchResult Annealer::trainNet( 
         NeuralNet *net, TrainingContext *context,
@@ -40,6 +40,7 @@ public:
     // cog_addheaders.add()
     // ]]]
     // generated, using cog:
+    VIRTUAL Trainer *clone(EasyCL *cl) const;
     STATIC Annealer *instance(EasyCL *cl, float learningRate, float anneal);
     Annealer(EasyCL *cl);
     VIRTUAL ~Annealer();
@@ -15,7 +15,7 @@
 #include "trainers/Nesterov.h"
 #include "loss/IAcceptsLabels.h"
 #include "batch/NetAction.h"
-#include "clmath/CLMathWrapper.h"
+#include "trainers/OptimizerKernels.h"
 #include "batch/BatchData.h"
 
 using namespace std;
@@ -36,21 +36,13 @@ VIRTUAL std::string Nesterov::asString() {
         toString(momentum) + " }";
 }
 VIRTUAL void Nesterov::loadFutureWeights(
-        CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper,
-        NesterovState *trainerState) {
+        CLWrapper *weightsWrapper, NesterovState *trainerState) {
     // this will save the old weights, into the trainerState,
-    // and then add mom * dweights to them
-
-    // create CLMathWrapper objects, so we can do per-element maths on the gpu:
-    CLMathWrapper clOldWeights(trainerState->oldWeightsWrapper);
-    CLMathWrapper clWeights(weightsWrapper);
-    CLMathWrapper clGradWeights(gradWeightsWrapper);
-
-    // following happens on the gpu:
-    clOldWeights = clWeights;
-    clWeights = clGradWeights;
-    clWeights *= momentum;
-    clWeights += clOldWeights;
+    // and then add mom * dweights to them, where dweights is trainerState->lastUpdate,
+    // not gradWeights, which hold the raw gradient from the last batch
+
+    optimizerKernels->nesterovLoadFuture(trainerState->numWeights, momentum,
+        weightsWrapper, trainerState->lastUpdateWrapper, trainerState->oldWeightsWrapper);
 }
 VIRTUAL void Nesterov::updateWeights(CLWrapper *weightsWrapper,
         CLWrapper *gradWeightsWrapper,
@@ -63,19 +55,10 @@ VIRTUAL void Nesterov::updateWeights(CLWrapper *weightsWrapper,
     //                          weights[t] + mom * dweights[t])
     //      weights[t+1] = weights[t] + dweights[t+1]
 
-    // create CLMathWrapper objects, so we can do per-element maths on the gpu:
-    CLMathWrapper clLastUpdate(trainerState->lastUpdateWrapper);
-    CLMathWrapper clOldWeights(trainerState->oldWeightsWrapper);
-    CLMathWrapper clGradWeights(gradWeightsWrapper);
-    CLMathWrapper clWeights(weightsWrapper);
-
-    // following happens on the gpu, via CLMathWrapper:
-
-    clGradWeights *= - learningRate;
-    clLastUpdate *= momentum;
-    clLastUpdate += clGradWeights;
-    clWeights = clOldWeights;
-    clWeights += clLastUpdate;
+    // in a single kernel, see cl/optimizers.cl
+    optimizerKernels->nesterov(trainerState->numWeights, learningRate, momentum,
+        weightsWrapper, gradWeightsWrapper, trainerState->oldWeightsWrapper,
+        trainerState->lastUpdateWrapper);
 }
 VIRTUAL BatchResult Nesterov::trainNet( 
     NeuralNet *net, TrainingContext *context,
@@ -105,10 +88,10 @@ VIRTUAL BatchResult Nesterov::trainNet(
             break;
         }
         if(layer->needsTrainerState()) {
-            loadFutureWeights(layer->getWeightsWrapper(), layer->getGradWeightsWrapper(), 
+            loadFutureWeights(layer->getWeightsWrapper(),
                 dynamic_cast< NesterovState * >(layer->getTrainerState()) );
             if(layer->biased()) {
-                loadFutureWeights(layer->getBiasWrapper(), layer->getGradBiasWrapper(),
+                loadFutureWeights(layer->getBiasWrapper(),
                     dynamic_cast< NesterovState * >(layer->getBiasTrainerState()) );
             }
         }
@@ -155,6 +138,12 @@ VIRTUAL void Nesterov::bindState(NeuralNet *net) {
     NesterovStateMaker stateMaker;
     this->_bindState(net, &stateMaker);
 }
+VIRTUAL Trainer *Nesterov::clone(EasyCL *cl) const {
+    Nesterov *copy = new Nesterov(cl);
+    copy->setLearningRate(learningRate);
+    copy->setMomentum(momentum);
+    return copy;
+}
 STATIC Nesterov *Nesterov::instance(EasyCL *cl, float learningRate) {
     Nesterov *sgd = new Nesterov(cl);
     sgd->setLearningRate(learningRate);
@@ -43,8 +43,7 @@ public:
     VIRTUAL void setMomentum(float momentum);
     VIRTUAL std::string asString();
     VIRTUAL void loadFutureWeights(
-    CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper,
-    NesterovState *trainerState);
+    CLWrapper *weightsWrapper, NesterovState *trainerState);
     VIRTUAL void updateWeights(CLWrapper *weightsWrapper,
     CLWrapper *gradWeightsWrapper,
     NesterovState *trainerState);
@@ -56,6 +55,7 @@ public:
     VIRTUAL BatchResult trainNetFromLabels(NeuralNet *net, TrainingContext *context,
     float const*input, int const*labels);
     VIRTUAL void bindState(NeuralNet *net);
+    VIRTUAL Trainer *clone(EasyCL *cl) const;
     STATIC Nesterov *instance(EasyCL *cl, float learningRate);
     STATIC Nesterov *instance(EasyCL *cl, float learningRate, float momentum);
     Nesterov(EasyCL *cl);
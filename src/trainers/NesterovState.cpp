@@ -20,8 +20,8 @@ using namespace std;
 VIRTUAL NesterovState::~NesterovState() {
     delete lastUpdateWrapper;
     delete[] lastUpdate;
-    delete oldWeights;
-    delete[] oldWeightsWrapper;
+    delete oldWeightsWrapper;
+    delete[] oldWeights;
 }
 
 NesterovState::NesterovState(EasyCL *cl, int numWeights) :
@@ -0,0 +1,158 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+#include <cmath>
+
+#include "trainers/OptimizerCpu.h"
+#include "util/ThreadPool.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+
+namespace {
+    const int chunkSize = 16384;
+
+    enum Optimizer { SGD_, NESTEROV_LOAD_FUTURE, NESTEROV, ADAGRAD, RMSPROP, ADADELTA };
+
+    // one task per chunk of chunkSize weights
+    class OptimizerCpuTask : public ThreadPoolTask {
+    public:
+        Optimizer optimizer;
+        int N;
+        float learningRate;
+        float momentum;
+        float multiplier; // weightDecay multiplier for sgd, decay for adadelta
+        float *weights;
+        float const *gradWeights; // or delta, for nesterovLoadFuture
+        float *state1;
+        float *state2;
+        virtual void run(int threadId, int taskId) {
+            const int begin = taskId * chunkSize;
+            const int end = min(N, begin + chunkSize);
+            switch(optimizer) {
+                case SGD_:
+                    for(int i = begin; i < end; i++) {
+                        const float update = momentum * state1[i] - learningRate * gradWeights[i];
+                        state1[i] = update;
+                        weights[i] = (weights[i] + update) * multiplier;
+                    }
+                    break;
+                case NESTEROV_LOAD_FUTURE:
+                    for(int i = begin; i < end; i++) {
+                        const float weight = weights[i];
+                        state1[i] = weight;
+                        weights[i] = weight + momentum * gradWeights[i];
+                    }
+                    break;
+                case NESTEROV:
+                    for(int i = begin; i < end; i++) {
+                        const float update = momentum * state2[i] - learningRate * gradWeights[i];
+                        state2[i] = update;
+                        weights[i] = state1[i] + update;
+                    }
+                    break;
+                case ADAGRAD:
+                    for(int i = begin; i < end; i++) {
+                        const float grad = gradWeights[i];
+                        const float sumSquare = state1[i] + grad * grad;
+                        state1[i] = sumSquare;
+                        weights[i] -= learningRate * grad / sqrt(sumSquare);
+                    }
+                    break;
+                case RMSPROP:
+                    for(int i = begin; i < end; i++) {
+                        const float grad = gradWeights[i];
+                        const float meanSquare = 0.9f * state1[i] + 0.1f * grad * grad;
+                        state1[i] = meanSquare;
+                        weights[i] -= learningRate * grad / sqrt(meanSquare);
+                    }
+                    break;
+                case ADADELTA:
+                    for(int i = begin; i < end; i++) {
+                        const float grad = gradWeights[i];
+                        const float gradSquared = multiplier * state1[i] + (1 - multiplier) * grad * grad;
+                        const float oldUpdateSquared = state2[i];
+                        const float update = - sqrt(oldUpdateSquared / gradSquared) * grad;
+                        state1[i] = gradSquared;
+                        state2[i] = multiplier * oldUpdateSquared + (1 - multiplier) * update * update;
+                        weights[i] += update;
+                    }
+                    break;
+            }
+        }
+    };
+
+    void runChunks(OptimizerCpuTask *task) {
+        ThreadPool::instance()->run((task->N + chunkSize - 1) / chunkSize, task);
+    }
+    OptimizerCpuTask makeTask(Optimizer optimizer, int N, float *weights, float const *gradWeights) {
+        OptimizerCpuTask task;
+        task.optimizer = optimizer;
+        task.N = N;
+        task.learningRate = 0;
+        task.momentum = 0;
+        task.multiplier = 1;
+        task.weights = weights;
+        task.gradWeights = gradWeights;
+        task.state1 = 0;
+        task.state2 = 0;
+        return task;
+    }
+}
+
+PUBLIC STATIC void OptimizerCpu::sgd(int N, float learningRate, float momentum, float weightDecay,
+        float *weights, float const *gradWeights, float *lastUpdate) {
+    OptimizerCpuTask task = makeTask(SGD_, N, weights, gradWeights);
+    task.learningRate = learningRate;
+    task.momentum = momentum;
+    task.multiplier = weightDecay > 0 ? 1.0f - weightDecay : 1.0f;
+    task.state1 = lastUpdate;
+    runChunks(&task);
+}
+PUBLIC STATIC void OptimizerCpu::nesterovLoadFuture(int N, float momentum,
+        float *weights, float const *delta, float *oldWeights) {
+    OptimizerCpuTask task = makeTask(NESTEROV_LOAD_FUTURE, N, weights, delta);
+    task.momentum = momentum;
+    task.state1 = oldWeights;
+    runChunks(&task);
+}
+PUBLIC STATIC void OptimizerCpu::nesterov(int N, float learningRate, float momentum,
+        float *weights, float const *gradWeights, float *oldWeights, float *lastUpdate) {
+    OptimizerCpuTask task = makeTask(NESTEROV, N, weights, gradWeights);
+    task.learningRate = learningRate;
+    task.momentum = momentum;
+    task.state1 = oldWeights;
+    task.state2 = lastUpdate;
+    runChunks(&task);
+}
+PUBLIC STATIC void OptimizerCpu::adagrad(int N, float learningRate,
+        float *weights, float const *gradWeights, float *sumSquares) {
+    OptimizerCpuTask task = makeTask(ADAGRAD, N, weights, gradWeights);
+    task.learningRate = learningRate;
+    task.state1 = sumSquares;
+    runChunks(&task);
+}
+PUBLIC STATIC void OptimizerCpu::rmsprop(int N, float learningRate,
+        float *weights, float const *gradWeights, float *meanSquares) {
+    OptimizerCpuTask task = makeTask(RMSPROP, N, weights, gradWeights);
+    task.learningRate = learningRate;
+    task.state1 = meanSquares;
+    runChunks(&task);
+}
+PUBLIC STATIC void OptimizerCpu::adadelta(int N, float decay,
+        float *weights, float const *gradWeights, float *sumGradSquared, float *sumUpdateSquared) {
+    OptimizerCpuTask task = makeTask(ADADELTA, N, weights, gradWeights);
+    task.multiplier = decay;
+    task.state1 = sumGradSquared;
+    task.state2 = sumUpdateSquared;
+    runChunks(&task);
+}
+
@@ -0,0 +1,41 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// the same fused updates as OptimizerKernels, on host arrays, split into
+// chunks across the ThreadPool
+// the loops are plain element-wise loops, with no dependencies between
+// iterations, so the compiler can vectorize them
+class DeepCL_EXPORT OptimizerCpu {
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    STATIC void sgd(int N, float learningRate, float momentum, float weightDecay,
+    float *weights, float const *gradWeights, float *lastUpdate);
+    STATIC void nesterovLoadFuture(int N, float momentum,
+    float *weights, float const *delta, float *oldWeights);
+    STATIC void nesterov(int N, float learningRate, float momentum,
+    float *weights, float const *gradWeights, float *oldWeights, float *lastUpdate);
+    STATIC void adagrad(int N, float learningRate,
+    float *weights, float const *gradWeights, float *sumSquares);
+    STATIC void rmsprop(int N, float learningRate,
+    float *weights, float const *gradWeights, float *meanSquares);
+    STATIC void adadelta(int N, float decay,
+    float *weights, float const *gradWeights, float *sumGradSquared, float *sumUpdateSquared);
+
+    // [[[end]]]
+};
+
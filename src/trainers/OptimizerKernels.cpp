@@ -0,0 +1,218 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "EasyCL.h"
+#include "util/StatefulTimer.h"
+#include "trainers/OptimizerKernels.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+PUBLIC OptimizerKernels::OptimizerKernels(EasyCL *cl) :
+        cl(cl) {
+}
+PUBLIC void OptimizerKernels::sgd(int N, float learningRate, float momentum, float weightDecay,
+        CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *lastUpdateWrapper) {
+    CLKernel *kernel = getKernel("sgd");
+    kernel->in(N)->in(learningRate)->in(momentum)->in(weightDecay > 0 ? 1.0f - weightDecay : 1.0f);
+    kernel->inout(weightsWrapper)->in(gradWeightsWrapper)->inout(lastUpdateWrapper);
+    run(kernel, N);
+}
+PUBLIC void OptimizerKernels::nesterovLoadFuture(int N, float momentum,
+        CLWrapper *weightsWrapper, CLWrapper *deltaWrapper, CLWrapper *oldWeightsWrapper) {
+    CLKernel *kernel = getKernel("nesterovLoadFuture");
+    kernel->in(N)->in(momentum);
+    kernel->inout(weightsWrapper)->in(deltaWrapper)->out(oldWeightsWrapper);
+    run(kernel, N);
+}
+PUBLIC void OptimizerKernels::nesterov(int N, float learningRate, float momentum,
+        CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *oldWeightsWrapper,
+        CLWrapper *lastUpdateWrapper) {
+    CLKernel *kernel = getKernel("nesterov");
+    kernel->in(N)->in(learningRate)->in(momentum);
+    kernel->out(weightsWrapper)->in(gradWeightsWrapper)->in(oldWeightsWrapper)->inout(lastUpdateWrapper);
+    run(kernel, N);
+}
+PUBLIC void OptimizerKernels::adagrad(int N, float learningRate,
+        CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *sumSquaresWrapper) {
+    CLKernel *kernel = getKernel("adagrad");
+    kernel->in(N)->in(learningRate);
+    kernel->inout(weightsWrapper)->in(gradWeightsWrapper)->inout(sumSquaresWrapper);
+    run(kernel, N);
+}
+PUBLIC void OptimizerKernels::rmsprop(int N, float learningRate,
+        CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *meanSquaresWrapper) {
+    CLKernel *kernel = getKernel("rmsprop");
+    kernel->in(N)->in(learningRate);
+    kernel->inout(weightsWrapper)->in(gradWeightsWrapper)->inout(meanSquaresWrapper);
+    run(kernel, N);
+}
+PUBLIC void OptimizerKernels::adadelta(int N, float decay,
+        CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper,
+        CLWrapper *sumGradSquaredWrapper, CLWrapper *sumUpdateSquaredWrapper) {
+    CLKernel *kernel = getKernel("adadelta");
+    kernel->in(N)->in(decay);
+    kernel->inout(weightsWrapper)->in(gradWeightsWrapper);
+    kernel->inout(sumGradSquaredWrapper)->inout(sumUpdateSquaredWrapper);
+    run(kernel, N);
+}
+PRIVATE void OptimizerKernels::run(CLKernel *kernel, int N) {
+    StatefulTimer::instance()->timeCheck("OptimizerKernels::run start");
+    int workgroupSize = 64;
+    int numWorkgroups = (N + workgroupSize - 1) / workgroupSize;
+    kernel->run_1d(numWorkgroups * workgroupSize, workgroupSize);
+    cl->finish();
+    StatefulTimer::instance()->timeCheck("OptimizerKernels::run end");
+}
+PRIVATE CLKernel *OptimizerKernels::getKernel(std::string name) {
+    std::string kernelName = "optimizers." + name;
+    if(cl->kernelExists(kernelName)) {
+        return cl->getKernel(kernelName);
+    }
+    string options = "";
+
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel("kernel", "cl/optimizers.cl")
+    // ]]]
+    // generated using cog, from cl/optimizers.cl:
+    const char * kernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n"
+    "//\n"
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n"
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n"
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n"
+    "\n"
+    "// one kernel per trainer, each reading weights, gradients and trainer state once,\n"
+    "// and writing them once, rather than a chain of per-element ops\n"
+    "// see src/trainers/OptimizerCpu.cpp for the cpu versions, which should give the same results\n"
+    "\n"
+    "// lastUpdate = momentum * lastUpdate - learningRate * gradWeights\n"
+    "// weights = (weights + lastUpdate) * (1 - weightDecay)\n"
+    "kernel void sgd(\n"
+    "        const int N,\n"
+    "        const float learningRate,\n"
+    "        const float momentum,\n"
+    "        const float weightDecayMultiplier,\n"
+    "        global float *weights,\n"
+    "        global const float *gradWeights,\n"
+    "        global float *lastUpdate) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const float update = momentum * lastUpdate[globalId] - learningRate * gradWeights[globalId];\n"
+    "    lastUpdate[globalId] = update;\n"
+    "    weights[globalId] = (weights[globalId] + update) * weightDecayMultiplier;\n"
+    "}\n"
+    "\n"
+    "// oldWeights = weights\n"
+    "// weights = weights + momentum * delta\n"
+    "kernel void nesterovLoadFuture(\n"
+    "        const int N,\n"
+    "        const float momentum,\n"
+    "        global float *weights,\n"
+    "        global const float *delta,\n"
+    "        global float *oldWeights) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const float weight = weights[globalId];\n"
+    "    oldWeights[globalId] = weight;\n"
+    "    weights[globalId] = weight + momentum * delta[globalId];\n"
+    "}\n"
+    "\n"
+    "// lastUpdate = momentum * lastUpdate - learningRate * gradWeights\n"
+    "// weights = oldWeights + lastUpdate\n"
+    "kernel void nesterov(\n"
+    "        const int N,\n"
+    "        const float learningRate,\n"
+    "        const float momentum,\n"
+    "        global float *weights,\n"
+    "        global const float *gradWeights,\n"
+    "        global const float *oldWeights,\n"
+    "        global float *lastUpdate) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const float update = momentum * lastUpdate[globalId] - learningRate * gradWeights[globalId];\n"
+    "    lastUpdate[globalId] = update;\n"
+    "    weights[globalId] = oldWeights[globalId] + update;\n"
+    "}\n"
+    "\n"
+    "// sumSquares += gradWeights ^ 2\n"
+    "// weights -= learningRate * gradWeights / sqrt(sumSquares)\n"
+    "kernel void adagrad(\n"
+    "        const int N,\n"
+    "        const float learningRate,\n"
+    "        global float *weights,\n"
+    "        global const float *gradWeights,\n"
+    "        global float *sumSquares) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const float grad = gradWeights[globalId];\n"
+    "    const float sumSquare = sumSquares[globalId] + grad * grad;\n"
+    "    sumSquares[globalId] = sumSquare;\n"
+    "    weights[globalId] -= learningRate * grad / sqrt(sumSquare);\n"
+    "}\n"
+    "\n"
+    "// meanSquares = 0.9 * meanSquares + 0.1 * gradWeights ^ 2\n"
+    "// weights -= learningRate * gradWeights / sqrt(meanSquares)\n"
+    "kernel void rmsprop(\n"
+    "        const int N,\n"
+    "        const float learningRate,\n"
+    "        global float *weights,\n"
+    "        global const float *gradWeights,\n"
+    "        global float *meanSquares) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const float grad = gradWeights[globalId];\n"
+    "    const float meanSquare = 0.9f * meanSquares[globalId] + 0.1f * grad * grad;\n"
+    "    meanSquares[globalId] = meanSquare;\n"
+    "    weights[globalId] -= learningRate * grad / sqrt(meanSquare);\n"
+    "}\n"
+    "\n"
+    "// sumGradSquared = decay * sumGradSquared + (1 - decay) * gradWeights ^ 2\n"
+    "// update = - sqrt(sumUpdateSquared / sumGradSquared) * gradWeights\n"
+    "// sumUpdateSquared = decay * sumUpdateSquared + (1 - decay) * update ^ 2\n"
+    "// weights += update\n"
+    "kernel void adadelta(\n"
+    "        const int N,\n"
+    "        const float decay,\n"
+    "        global float *weights,\n"
+    "        global const float *gradWeights,\n"
+    "        global float *sumGradSquared,\n"
+    "        global float *sumUpdateSquared) {\n"
+    "    const int globalId = get_global_id(0);\n"
+    "    if (globalId >= N) {\n"
+    "        return;\n"
+    "    }\n"
+    "    const float grad = gradWeights[globalId];\n"
+    "    const float gradSquared = decay * sumGradSquared[globalId] + (1 - decay) * grad * grad;\n"
+    "    const float oldUpdateSquared = sumUpdateSquared[globalId];\n"
+    "    const float update = - sqrt(oldUpdateSquared / gradSquared) * grad;\n"
+    "    sumGradSquared[globalId] = gradSquared;\n"
+    "    sumUpdateSquared[globalId] = decay * oldUpdateSquared + (1 - decay) * update * update;\n"
+    "    weights[globalId] += update;\n"
+    "}\n"
+    "\n"
+    "";
+    // [[[end]]]
+    CLKernel *kernel = cl->buildKernelFromString(kernelSource, name, options, "cl/optimizers.cl");
+    cl->storeKernel(kernelName, kernel, true);
+    return kernel;
+}
+
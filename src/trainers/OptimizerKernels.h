@@ -0,0 +1,59 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+
+class EasyCL;
+class CLKernel;
+class CLWrapper;
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// the weight update for each trainer as a single kernel, from cl/optimizers.cl,
+// so weights, gradients and trainer state are each read once and written once,
+// instead of once per CLMathWrapper op
+// OptimizerCpu has the same updates, on host arrays
+// kernels are built on first use, and stored in the EasyCL object, so all
+// trainers on the same EasyCL share them
+class DeepCL_EXPORT OptimizerKernels {
+    private:
+    EasyCL *cl; // NOT owned by us
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    OptimizerKernels(EasyCL *cl);
+    void sgd(int N, float learningRate, float momentum, float weightDecay,
+    CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *lastUpdateWrapper);
+    void nesterovLoadFuture(int N, float momentum,
+    CLWrapper *weightsWrapper, CLWrapper *deltaWrapper, CLWrapper *oldWeightsWrapper);
+    void nesterov(int N, float learningRate, float momentum,
+        CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *oldWeightsWrapper,
+    CLWrapper *lastUpdateWrapper);
+    void adagrad(int N, float learningRate,
+    CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *sumSquaresWrapper);
+    void rmsprop(int N, float learningRate,
+    CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper, CLWrapper *meanSquaresWrapper);
+    void adadelta(int N, float decay,
+        CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper,
+    CLWrapper *sumGradSquaredWrapper, CLWrapper *sumUpdateSquaredWrapper);
+
+    private:
+    void run(CLKernel *kernel, int N);
+    CLKernel *getKernel(std::string name);
+
+    // [[[end]]]
+};
+
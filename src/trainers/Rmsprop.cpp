@@ -15,7 +15,7 @@
 #include "trainers/Rmsprop.h"
 #include "loss/IAcceptsLabels.h"
 #include "batch/NetAction.h"
-#include "clmath/CLMathWrapper.h"
+#include "trainers/OptimizerKernels.h"
 #include "batch/BatchData.h"
 
 //#include "test/Sampler.h"
@@ -35,33 +35,11 @@ VIRTUAL std::string Rmsprop::asString() {
 }
 VIRTUAL void Rmsprop::updateWeights(CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper,
         RmspropState *trainerState) {
-
-    int numWeights = trainerState->numWeights;
-    float *working = new float[ numWeights ];
-    CLWrapper *workingWrapper = cl->wrap(numWeights, working);
-    workingWrapper->createOnDevice();
-
-    CLMathWrapper clWeights(weightsWrapper);
-    CLMathWrapper clGradWeights(gradWeightsWrapper);
-    CLMathWrapper clMeanSquares(trainerState->meanSquareWrapper);
-    CLMathWrapper clWorking(workingWrapper);
-
-    // following all happens on gpu, via clmathwrapper:
-    clWorking = clGradWeights;
-    clWorking.squared();
-    clWorking *= 0.1f; // I guess this should be a hyper-parameter?
-    clMeanSquares *= 0.9f;
-    clMeanSquares += clWorking;
-
-    clWorking = clMeanSquares;
-    clWorking.sqrt();
-    clWorking.inv();
-    clWorking *= clGradWeights;
-    clWorking *= - learningRate;
-    clWeights += clWorking;
-
-    delete workingWrapper;
-    delete[] working;
+    // meanSquares = 0.9 * meanSquares + 0.1 * gradWeights ^ 2
+    // weights -= learningRate * gradWeights / sqrt(meanSquares)
+    // in a single kernel, see cl/optimizers.cl
+    optimizerKernels->rmsprop(trainerState->numWeights, learningRate,
+        weightsWrapper, gradWeightsWrapper, trainerState->meanSquareWrapper);
 }
 VIRTUAL BatchResult Rmsprop::trainNet(NeuralNet *net, TrainingContext *context,
     float const*input, OutputData *outputData) {
@@ -106,6 +84,11 @@ VIRTUAL void Rmsprop::bindState(NeuralNet *net) {
     RmspropStateMaker stateMaker;
     this->_bindState(net, &stateMaker);
 }
+VIRTUAL Trainer *Rmsprop::clone(EasyCL *cl) const {
+    Rmsprop *copy = new Rmsprop(cl);
+    copy->setLearningRate(learningRate);
+    return copy;
+}
 STATIC Rmsprop *Rmsprop::instance(EasyCL *cl, float learningRate) {
     Rmsprop *sgd = new Rmsprop(cl);
     sgd->setLearningRate(learningRate);
@@ -44,6 +44,7 @@ public:
     VIRTUAL BatchResult trainNetFromLabels(NeuralNet *net, TrainingContext *context,
     float const*input, int const*labels);
     VIRTUAL void bindState(NeuralNet *net);
+    VIRTUAL Trainer *clone(EasyCL *cl) const;
     STATIC Rmsprop *instance(EasyCL *cl, float learningRate);
     Rmsprop(EasyCL *cl);
 
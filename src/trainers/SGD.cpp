@@ -15,7 +15,7 @@
 #include "trainers/SGD.h"
 #include "loss/IAcceptsLabels.h"
 #include "batch/NetAction.h"
-#include "clmath/CLMathWrapper.h"
+#include "trainers/OptimizerKernels.h"
 #include "batch/BatchData.h"
 
 using namespace std;
@@ -40,33 +40,13 @@ VIRTUAL std::string SGD::asString() {
 }
 VIRTUAL void SGD::updateWeights(CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper,
         SGDState *trainerState) {
-    int numWeights = trainerState->numWeights;
-    CLWrapper *lastUpdateWrapper = trainerState->lastUpdateWrapper;
-    float *gradWeightsCopy = new float[ numWeights ];
-    CLWrapper *gradWeightsCopyWrapper = cl->wrap(numWeights, gradWeightsCopy);
-    gradWeightsCopyWrapper->createOnDevice();
-
-    CLMathWrapper lastUpdates_(lastUpdateWrapper);
-    CLMathWrapper gradWeights_(gradWeightsWrapper);
-    CLMathWrapper gradWeightsCopy_(gradWeightsCopyWrapper);
-    CLMathWrapper weights_(weightsWrapper);
-
-    // following all happens on gpu, via clmathwrapper:
-    lastUpdates_ *= momentum;
-    gradWeightsCopy_ = gradWeights_;
-    gradWeightsCopy_ *= - learningRate;
-    lastUpdates_ += gradWeightsCopy_;
-    weights_ += lastUpdates_;
-
-    if(weightDecay > 0) {
-        // apply weight decay, by multiplying the weights by (1.0f - weightDecay)
-        // so weightDecay == 0 means no decay; and weightDecay == 1.0f means
-        // weights go immediately to zero
-        weights_ *= 1.0f - weightDecay;
-    }
-
-    delete gradWeightsCopyWrapper;
-    delete[] gradWeightsCopy;
+    // lastUpdate = momentum * lastUpdate - learningRate * gradWeights
+    // weights = (weights + lastUpdate) * (1 - weightDecay)
+    // in a single kernel, see cl/optimizers.cl
+    // weightDecay == 0 means no decay; and weightDecay == 1.0f means
+    // weights go immediately to zero
+    optimizerKernels->sgd(trainerState->numWeights, learningRate, momentum, weightDecay,
+        weightsWrapper, gradWeightsWrapper, trainerState->lastUpdateWrapper);
 }
 VIRTUAL BatchResult SGD::trainNet(NeuralNet *net, TrainingContext *context,
     float const*input, OutputData *outputData) {
@@ -111,6 +91,13 @@ VIRTUAL void SGD::bindState(NeuralNet *net) {
     SGDStateMaker stateMaker;
     this->_bindState(net, &stateMaker);
 }
+VIRTUAL Trainer *SGD::clone(EasyCL *cl) const {
+    SGD *copy = new SGD(cl);
+    copy->setLearningRate(learningRate);
+    copy->setMomentum(momentum);
+    copy->setWeightDecay(weightDecay);
+    return copy;
+}
 STATIC SGD *SGD::instance(EasyCL *cl, float learningRate) {
     SGD *sgd = new SGD(cl);
     sgd->setLearningRate(learningRate);
@@ -58,6 +58,7 @@ public:
     VIRTUAL BatchResult trainNetFromLabels(NeuralNet *net, TrainingContext *context,
     float const*input, int const*labels);
     VIRTUAL void bindState(NeuralNet *net);
+    VIRTUAL Trainer *clone(EasyCL *cl) const;
     STATIC SGD *instance(EasyCL *cl, float learningRate);
     STATIC SGD *instance(EasyCL *cl, float learningRate, float momentum);
     SGD(EasyCL *cl);
@@ -15,6 +15,9 @@
 #include "trainers/TrainerStateMaker.h"
 #include "trainers/TrainerState.h"
 #include "layer/Layer.h"
+#include "clmath/ScratchPool.h"
+#include "trainers/OptimizerKernels.h"
+#include "util/ThreadPool.h"
 
 using namespace std;
 
@@ -23,12 +26,49 @@ using namespace std;
 #define STATIC
 #define VIRTUAL
 
+namespace {
+    // one MultiNet column per task, each with the trainer for its context
+    class ColumnTrainTask : public ThreadPoolTask {
+    public:
+        vector< Trainer * > trainers;
+        vector< Trainable * > columns;
+        vector< BatchResult > results;
+        TrainingContext *context;
+        float const *input;
+        float const *expectedOutput;
+        int const *labels; // if not 0, we use these, rather than expectedOutput
+        ColumnTrainTask(Trainer *trainer, MultiNet *multiNet, TrainingContext *context,
+                float const *input, float const *expectedOutput, int const *labels) :
+                results(multiNet->getNumNets()),
+                context(context),
+                input(input),
+                expectedOutput(expectedOutput),
+                labels(labels) {
+            for(int i = 0; i < multiNet->getNumNets(); i++) {
+                trainers.push_back(multiNet->getColumnTrainer(i, trainer));
+                columns.push_back(multiNet->getNet(i));
+            }
+        }
+        virtual void run(int threadId, int taskId) {
+            if(labels != 0) {
+                results[taskId] = trainers[taskId]->trainFromLabels(columns[taskId], context, input, labels);
+            } else {
+                results[taskId] = trainers[taskId]->train(columns[taskId], context, input, expectedOutput);
+            }
+        }
+    };
+}
+
 
 Trainer::Trainer(EasyCL *cl) :
     cl(cl),
+    scratchPool(new ScratchPool(cl)),
+    optimizerKernels(new OptimizerKernels(cl)),
     learningRate(0) {
 }
 VIRTUAL Trainer::~Trainer() {
+    delete optimizerKernels;
+    delete scratchPool;
 }
 VIRTUAL void Trainer::setLearningRate(float learningRate) {
     this->learningRate = learningRate;
@@ -36,16 +76,20 @@ VIRTUAL void Trainer::setLearningRate(float learningRate) {
 VIRTUAL std::string Trainer::asString() {
     return "Trainer{ learningRate=" + toString(learningRate) + " }";
 }
+// a trainer like this one, for a net on another context, eg for a MultiNet column
+VIRTUAL Trainer *Trainer::clone(EasyCL *cl) const {
+    throw runtime_error("clone not implemented for this trainer");
+}
 VIRTUAL BatchResult Trainer::train(Trainable *trainable, 
         TrainingContext *context,
         float const*input, float const*expectedOutput) {
     MultiNet *multiNet = dynamic_cast< MultiNet *>(trainable);
     float loss = 0;
     if(multiNet != 0) {
+        ColumnTrainTask task(this, multiNet, context, input, expectedOutput, 0);
+        multiNet->runColumns(&task);
         for(int i = 0; i < multiNet->getNumNets(); i++) {
-            Trainable *child = multiNet->getNet(i);
-            BatchResult result = this->train(child, context, input, expectedOutput);
-            loss += result.loss;
+            loss += task.results[i].loss;
         }
     } else {
         NeuralNet *net = dynamic_cast< NeuralNet * > (trainable);
@@ -60,11 +104,11 @@ VIRTUAL BatchResult Trainer::trainFromLabels(Trainable *trainable,
     float loss = 0;
     int numRight = 0;
     if(multiNet != 0) {
+        ColumnTrainTask task(this, multiNet, context, input, 0, labels);
+        multiNet->runColumns(&task);
         for(int i = 0; i < multiNet->getNumNets(); i++) {
-            Trainable *child = multiNet->getNet(i);
-            BatchResult result = this->trainFromLabels(child, context, input, labels);
-            loss += result.loss;
-            numRight += result.numRight;
+            loss += task.results[i].loss;
+            numRight += task.results[i].numRight;
         }
     } else {
         NeuralNet *net = dynamic_cast< NeuralNet * > (trainable);
@@ -17,6 +17,8 @@ class Trainable;
 class EpochResult;
 class TrainerStateMaker;
 class BatchResult;
+class ScratchPool;
+class OptimizerKernels;
 
 #include "trainers/TrainingContext.h"
 
@@ -56,6 +58,8 @@ class DeepCL_EXPORT Trainer{
 public:
     EasyCL *cl; // NOT delete
 //    NeuralNet *net;
+    ScratchPool *scratchPool; // for the per-layer temporaries in updateWeights
+    OptimizerKernels *optimizerKernels;
 
     float learningRate;
 
@@ -74,6 +78,7 @@ public:
     VIRTUAL ~Trainer();
     VIRTUAL void setLearningRate(float learningRate);
     VIRTUAL std::string asString();
+    VIRTUAL Trainer *clone(EasyCL *cl) const;
     VIRTUAL BatchResult train(Trainable *trainable,
     TrainingContext *context,
     float const*input, float const*expectedOutput);
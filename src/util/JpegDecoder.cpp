@@ -0,0 +1,115 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstdio>
+#include <csetjmp>
+extern "C" {
+    #include <jpeglib.h>
+}
+#include <stdexcept>
+
+#include "util/stringhelper.h"
+#include "util/JpegDecoder.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+// libjpeg's default error_exit calls exit(), so we longjmp back to read() instead,
+// and throw from there, once we're out of the c code
+class JpegDecoderState {
+public:
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    jmp_buf onError;
+    char message[JMSG_LENGTH_MAX];
+};
+
+namespace {
+    void jpegDecoderErrorExit(j_common_ptr cinfo) {
+        JpegDecoderState *state = (JpegDecoderState *)cinfo->client_data;
+        (*cinfo->err->format_message)(cinfo, state->message);
+        longjmp(state->onError, 1);
+    }
+}
+
+PUBLIC JpegDecoder::JpegDecoder() :
+        imageBuffer(0),
+        imageBufferSize(0) {
+    state = new JpegDecoderState();
+    state->cinfo.err = jpeg_std_error(&state->jerr);
+    state->jerr.error_exit = jpegDecoderErrorExit;
+    state->cinfo.client_data = state;
+    jpeg_create_decompress(&state->cinfo);
+}
+PUBLIC JpegDecoder::~JpegDecoder() {
+    jpeg_destroy_decompress(&state->cinfo);
+    delete state;
+    delete[] imageBuffer;
+}
+// values is written as [plane][row][col]
+PUBLIC void JpegDecoder::read(std::string filename, int planes, int width, int height, unsigned char *values) {
+    if(width * height * planes > imageBufferSize) {
+        delete[] imageBuffer;
+        imageBufferSize = width * height * planes;
+        imageBuffer = new unsigned char[imageBufferSize];
+    }
+    FILE *infile;
+    if ((infile = fopen(filename.c_str(), "rb")) == NULL) {
+        throw runtime_error("can't open "  + filename);
+    }
+    struct jpeg_decompress_struct *cinfo = &state->cinfo;
+    string error = "";
+    // nothing below, up to jpeg_finish_decompress, may need destructing, since
+    // a libjpeg error longjmps straight back here
+    if(setjmp(state->onError)) {
+        error = "error reading " + filename + ": " + state->message;
+    } else {
+        jpeg_stdio_src(cinfo, infile);
+        jpeg_read_header(cinfo, TRUE);
+        jpeg_start_decompress(cinfo);
+        if((int)cinfo->output_width != width) {
+            error = "error reading " + filename + ":" + 
+                " width is " + toString(cinfo->output_width) + 
+                " and not " + toString(width);
+        } else if((int)cinfo->output_height != height) {
+            error = "error reading " + filename + ":" + 
+                " height is " + toString(cinfo->output_height) + 
+                " and not " + toString(height);
+        } else if((int)cinfo->output_components != planes) {
+            error = "error reading " + filename + ":" + 
+                " planes is " + toString(cinfo->output_components) + 
+                " and not " + toString(planes);
+        } else {
+            JSAMPROW row_pointer[1];        /* pointer to a single row */
+            int row_stride = width * planes;   /* JSAMPLEs per row in imageBuffer */
+            while (cinfo->output_scanline < cinfo->output_height) {
+                row_pointer[0] = & imageBuffer[cinfo->output_scanline * row_stride];
+                jpeg_read_scanlines(cinfo, row_pointer, 1);
+            }
+            jpeg_finish_decompress(cinfo);
+        }
+    }
+    // leaves the decompress object ready for the next file, whether or not we finished this one
+    jpeg_abort_decompress(cinfo);
+    fclose(infile);
+    if(error != "") {
+        throw runtime_error(error);
+    }
+
+    const int imageSizeSquared = width * height;
+    for(int plane = 0; plane < planes; plane++) {
+        unsigned char *valuesPlane = values + plane * imageSizeSquared;
+        const unsigned char *src = imageBuffer + plane;
+        for(int i = 0; i < imageSizeSquared; i++) {
+            valuesPlane[i] = src[i * planes];
+        }
+    }
+}
+
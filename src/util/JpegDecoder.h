@@ -0,0 +1,42 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+class JpegDecoderState;
+
+// reusable jpeg decompressor: the libjpeg decompress object, and the
+// interleaved scanline buffer, are created once, and reused for each file,
+// so decoding many small jpegs doesnt pay the setup cost each time
+// not thread-safe: use one instance per thread
+// libjpeg errors are thrown as runtime_error, rather than exiting the process
+class DeepCL_EXPORT JpegDecoder {
+    private:
+    JpegDecoderState *state;
+    unsigned char *imageBuffer;
+    int imageBufferSize;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    JpegDecoder();
+    ~JpegDecoder();
+    void read(std::string filename, int planes, int width, int height, unsigned char *values);
+
+    // [[[end]]]
+};
+
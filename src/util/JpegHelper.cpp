@@ -13,6 +13,7 @@ extern "C" {
 
 #include "util/stringhelper.h"
 #include "util/JpegHelper.h"
+#include "util/JpegDecoder.h"
 
 using namespace std;
 
@@ -84,61 +85,8 @@ PUBLIC STATIC void JpegHelper::write(std::string filename, int planes, int width
 }
 
 PUBLIC STATIC void JpegHelper::read(std::string filename, int planes, int width, int height, unsigned char *values) {
-    unsigned char *image_buffer = new unsigned char[width * height * planes];
-
-    struct jpeg_decompress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_decompress(&cinfo);
-
-//    string filename = "foo.jpeg";
-    FILE * infile;
-    if ((infile = fopen(filename.c_str(), "rb")) == NULL) {
-        throw runtime_error("can't open "  + filename);
-    }
-    jpeg_stdio_src(&cinfo, infile);
-    jpeg_read_header(&cinfo, TRUE);
-
-    jpeg_start_decompress(&cinfo);
-    if((int)cinfo.output_width != width) {
-        throw runtime_error("error reading " + filename + ":" + 
-            " width is " + toString(cinfo.output_width) + 
-            " and not " + toString(width) );
-    }
-    if((int)cinfo.output_height != height) {
-        throw runtime_error("error reading " + filename + ":" + 
-            " height is " + toString(cinfo.output_height) + 
-            " and not " + toString(height) );
-    }
-    if((int)cinfo.output_components != planes) {
-        throw runtime_error("error reading " + filename + ":" + 
-            " planes is " + toString(cinfo.output_components) + 
-            " and not " + toString(planes) );
-    }
-
-    JSAMPROW row_pointer[1];        /* pointer to a single row */
-    int row_stride;                 /* physical row width in buffer */
-
-    row_stride = cinfo.image_width * planes;   /* JSAMPLEs per row in image_buffer */
-
-    while (cinfo.output_scanline < cinfo.output_height) {
-        row_pointer[0] = & image_buffer[cinfo.output_scanline * row_stride];
-        jpeg_read_scanlines(&cinfo, row_pointer, 1);
-    }
-
-    jpeg_finish_decompress(&cinfo);
-    jpeg_destroy_decompress(&cinfo);
-
-    fclose(infile);
-
-    for(int row = 0; row < height; row++) {
-        for(int col = 0; col < width; col++) {
-            for(int plane = 0; plane < planes; plane++) {
-                values[plane*width*height + row*width + col] = image_buffer[row*width*planes + col*planes + plane];
-            }
-        }
-    }
-
-    delete[] image_buffer;
+    // if you are reading many files, keep a JpegDecoder around yourself, and save the setup each time
+    JpegDecoder decoder;
+    decoder.read(filename, planes, width, height, values);
 }
 
@@ -0,0 +1,142 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "util/FileHelper.h"
+#include "util/stringhelper.h"
+#include "util/MappedFile.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+PUBLIC MappedFile::MappedFile(std::string filepath) :
+        filepath(filepath),
+        data(0),
+        size(0) {
+    string localPath = FileHelper::localizePath(filepath);
+    #ifdef _WIN32
+    fileHandle = 0;
+    mappingHandle = 0;
+    HANDLE file = CreateFileA(localPath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE) {
+        throw runtime_error("failed to open file: " + localPath);
+    }
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw runtime_error("failed to get size of " + localPath);
+    }
+    size = fileSize.QuadPart;
+    fileHandle = file;
+    if(size == 0) {
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mapping == NULL) {
+        CloseHandle(file);
+        throw runtime_error("failed to map " + localPath);
+    }
+    mappingHandle = mapping;
+    data = (unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(data == 0) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw runtime_error("failed to map " + localPath);
+    }
+    #else
+    fd = open(localPath.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw runtime_error("failed to open file: " + localPath);
+    }
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0) {
+        close(fd);
+        throw runtime_error("failed to get size of " + localPath);
+    }
+    size = fileStat.st_size;
+    if(size == 0) {
+        return;
+    }
+    void *mapped = mmap(0, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    if(mapped == MAP_FAILED) {
+        close(fd);
+        throw runtime_error("failed to map " + localPath);
+    }
+    data = (unsigned char *)mapped;
+    #endif
+}
+PUBLIC MappedFile::~MappedFile() {
+    #ifdef _WIN32
+    if(data != 0) {
+        UnmapViewOfFile(data);
+    }
+    if(mappingHandle != 0) {
+        CloseHandle((HANDLE)mappingHandle);
+    }
+    CloseHandle((HANDLE)fileHandle);
+    #else
+    if(data != 0) {
+        munmap(data, (size_t)size);
+    }
+    close(fd);
+    #endif
+}
+PUBLIC std::string MappedFile::getFilepath() {
+    return filepath;
+}
+PUBLIC long long MappedFile::getSize() {
+    return size;
+}
+PUBLIC const unsigned char *MappedFile::getData() {
+    return data;
+}
+// throws if [offset, offset + length) isnt entirely inside the file, eg truncated files
+PUBLIC const unsigned char *MappedFile::getData(long long offset, long long length) {
+    if(offset < 0 || length < 0 || offset + length > size) {
+        throw runtime_error("failed to read from " + filepath + ": bytes " + toString(offset) + " to " + 
+            toString(offset + length) + " requested, but file size is " + toString(size));
+    }
+    return data + offset;
+}
+// we're going to read through most of the file in order
+PUBLIC void MappedFile::adviseSequential() {
+    #if !defined(_WIN32) && defined(MADV_SEQUENTIAL)
+    if(data != 0) {
+        madvise(data, (size_t)size, MADV_SEQUENTIAL);
+    }
+    #endif
+}
+// we're going to read [offset, offset + length) soon, so start paging it in
+PUBLIC void MappedFile::willNeed(long long offset, long long length) {
+    #if !defined(_WIN32) && defined(MADV_WILLNEED)
+    if(data == 0 || offset >= size || length <= 0) {
+        return;
+    }
+    if(offset + length > size) {
+        length = size - offset;
+    }
+    // madvise wants a page-aligned start address
+    long long pageSize = sysconf(_SC_PAGESIZE);
+    long long alignedOffset = offset - offset % pageSize;
+    madvise(data + alignedOffset, (size_t)(length + offset - alignedOffset), MADV_WILLNEED);
+    #endif
+}
+
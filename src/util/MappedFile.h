@@ -0,0 +1,51 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// read-only memory mapping of an entire file, so loaders can read records
+// straight out of the page cache, without allocating and copying a buffer
+// for each chunk
+// adviseSequential and willNeed are just hints to the os; they do nothing
+// on platforms that dont support them
+class DeepCL_EXPORT MappedFile {
+    private:
+    std::string filepath;
+    unsigned char *data;
+    long long size;
+    #ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+    #else
+    int fd;
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    MappedFile(std::string filepath);
+    ~MappedFile();
+    std::string getFilepath();
+    long long getSize();
+    const unsigned char *getData();
+    const unsigned char *getData(long long offset, long long length);
+    void adviseSequential();
+    void willNeed(long long offset, long long length);
+
+    // [[[end]]]
+};
+
@@ -31,20 +31,35 @@ PUBLIC RandomSingleton::RandomSingleton() {
 }
 PUBLIC STATIC RandomSingleton *RandomSingleton::instance() {
     static RandomSingleton *thisinstance = new RandomSingleton();
-    return thisinstance; // assume single-threaded, which... we are :-)
+    return thisinstance;
 }
 //    void testingonly_setInstance(RandomSingleton *testInstance) {
 //        _instance = testinstance;
 //    }
 PUBLIC VIRTUAL float RandomSingleton::_uniform() {
+    #ifndef NOTHREADS
+    std::lock_guard<std::mutex> lock(mutex);
+    #endif
     return myrandom() / (float)myrandom.max();
 }
 PUBLIC STATIC float RandomSingleton::uniform() {
     return instance()->_uniform();
 }
 PUBLIC STATIC int RandomSingleton::uniformInt(int minValueInclusive, int maxValueInclusive) {
-    return (instance()->myrandom() % 
+    RandomSingleton *random = instance();
+    #ifndef NOTHREADS
+    std::lock_guard<std::mutex> lock(random->mutex);
+    #endif
+    return (random->myrandom() % 
         (maxValueInclusive - minValueInclusive + 1) )
      + minValueInclusive;
 }
+// a full 32 bits, eg to seed another generator
+PUBLIC STATIC unsigned int RandomSingleton::uniformUInt32() {
+    RandomSingleton *random = instance();
+    #ifndef NOTHREADS
+    std::lock_guard<std::mutex> lock(random->mutex);
+    #endif
+    return (unsigned int)(random->myrandom() & 0xffffffffUL);
+}
 
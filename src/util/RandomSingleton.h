@@ -10,6 +10,12 @@
 #include "DeepCLDllExport.h"
 #include "util/mt19937defs.h"
 
+#if defined(_MSC_VER) && _MSC_VER < 1700 // visual studio 2010 has no std::mutex
+#define NOTHREADS
+#else
+#include <mutex>
+#endif
+
 #ifdef _MSC_VER // apply to all msvc versions, so dont have to retest on different msvc versions
 #define TR1RANDOM
 #endif
@@ -38,6 +44,9 @@ class DeepCL_EXPORT RandomSingleton {
     #pragma warning(disable: 4251)
     #endif
     MT19937 myrandom;
+    #ifndef NOTHREADS
+    std::mutex mutex; // eg MultiNet columns draw translations from several threads
+    #endif
     #ifdef _WIN32
     #pragma warning(default: 4251)
     #endif
@@ -54,6 +63,7 @@ class DeepCL_EXPORT RandomSingleton {
     VIRTUAL float _uniform();
     STATIC float uniform();
     STATIC int uniformInt(int minValueInclusive, int maxValueInclusive);
+    STATIC unsigned int uniformUInt32();
 
     // [[[end]]]
 };
@@ -0,0 +1,99 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstring>
+
+#include "util/ReducedPrecision.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+PUBLIC STATIC unsigned short ReducedPrecision::floatToHalf(float value) {
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned int sign = (bits >> 16) & 0x8000;
+    unsigned int absBits = bits & 0x7fffffff;
+    if(absBits >= 0x7f800000) { // inf, or nan, which stays a (quiet) nan
+        return (unsigned short)(sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 | ((absBits >> 13) & 0x3ff) : 0));
+    }
+    if(absBits >= 0x477ff000) { // 65520 and up round to infinity
+        return (unsigned short)(sign | 0x7c00);
+    }
+    if(absBits < 0x38800000) { // below 2^-14, the smallest normal half
+        int exponent = (int)(absBits >> 23);
+        if(exponent < 102) { // below 2^-25, half the smallest subnormal
+            return (unsigned short)sign;
+        }
+        unsigned int mantissa = (absBits & 0x7fffff) | 0x800000;
+        int shift = 126 - exponent;
+        unsigned int halfMantissa = mantissa >> shift;
+        unsigned int remainder = mantissa & ((1u << shift) - 1);
+        unsigned int halfway = 1u << (shift - 1);
+        if(remainder > halfway || (remainder == halfway && (halfMantissa & 1))) {
+            halfMantissa++; // might carry into the smallest normal, which is still right
+        }
+        return (unsigned short)(sign | halfMantissa);
+    }
+    unsigned int rounded = absBits + 0xfff + ((absBits >> 13) & 1);
+    return (unsigned short)(sign | ((rounded - 0x38000000) >> 13)); // exponent bias 127 => 15
+}
+PUBLIC STATIC float ReducedPrecision::halfToFloat(unsigned short half) {
+    unsigned int sign = (unsigned int)(half & 0x8000) << 16;
+    unsigned int exponent = (half >> 10) & 0x1f;
+    unsigned int mantissa = half & 0x3ff;
+    unsigned int bits;
+    if(exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if(exponent == 0) {
+        float value = mantissa * 5.9604644775390625e-8f; // 2^-24; exact
+        return sign ? -value : value;
+    } else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+PUBLIC STATIC unsigned short ReducedPrecision::floatToBfloat16(float value) {
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if((bits & 0x7fffffff) > 0x7f800000) { // nan: keep it a nan, even if only low bits set
+        return (unsigned short)((bits >> 16) | 0x40);
+    }
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return (unsigned short)(bits >> 16);
+}
+PUBLIC STATIC float ReducedPrecision::bfloat16ToFloat(unsigned short bfloat16) {
+    unsigned int bits = (unsigned int)bfloat16 << 16;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+PUBLIC STATIC void ReducedPrecision::floatsToHalves(float const *source, unsigned short *dest, long long n) {
+    for(long long i = 0; i < n; i++) {
+        dest[i] = floatToHalf(source[i]);
+    }
+}
+PUBLIC STATIC void ReducedPrecision::halvesToFloats(unsigned short const *source, float *dest, long long n) {
+    for(long long i = 0; i < n; i++) {
+        dest[i] = halfToFloat(source[i]);
+    }
+}
+PUBLIC STATIC void ReducedPrecision::floatsToBfloat16s(float const *source, unsigned short *dest, long long n) {
+    for(long long i = 0; i < n; i++) {
+        dest[i] = floatToBfloat16(source[i]);
+    }
+}
+PUBLIC STATIC void ReducedPrecision::bfloat16sToFloats(unsigned short const *source, float *dest, long long n) {
+    for(long long i = 0; i < n; i++) {
+        dest[i] = bfloat16ToFloat(source[i]);
+    }
+}
+
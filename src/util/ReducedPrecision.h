@@ -0,0 +1,36 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// conversions between float and the 16-bit formats, for storing weights in half
+// the space: ieee 754 half, and bfloat16, the top half of a float
+// both round to nearest, ties to even; halves overflow to infinity, and keep subnormals
+class DeepCL_EXPORT ReducedPrecision {
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    STATIC unsigned short floatToHalf(float value);
+    STATIC float halfToFloat(unsigned short half);
+    STATIC unsigned short floatToBfloat16(float value);
+    STATIC float bfloat16ToFloat(unsigned short bfloat16);
+    STATIC void floatsToHalves(float const *source, unsigned short *dest, long long n);
+    STATIC void halvesToFloats(unsigned short const *source, float *dest, long long n);
+    STATIC void floatsToBfloat16s(float const *source, unsigned short *dest, long long n);
+    STATIC void bfloat16sToFloats(unsigned short const *source, float *dest, long long n);
+
+    // [[[end]]]
+};
+
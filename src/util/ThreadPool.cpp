@@ -0,0 +1,148 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstdlib>
+#include <exception>
+
+#include "util/ThreadPool.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+#undef VIRTUAL
+#define VIRTUAL
+
+PUBLIC ThreadPool::ThreadPool(int numThreads) :
+        numThreads(numThreads < 1 ? 1 : numThreads),
+        task(0),
+        numTasks(0),
+        generation(0),
+        numWorkersBusy(0),
+        stopping(false) {
+    #ifdef NOTHREADS
+    this->numThreads = 1;
+    #else
+    nextTaskId = 0;
+    // thread 0 is whoever calls run(), so we only need numThreads - 1 workers
+    for(int i = 1; i < this->numThreads; i++) {
+        workers.push_back(thread(&ThreadPool::workerLoop, this, i));
+    }
+    #endif
+}
+PUBLIC ThreadPool::~ThreadPool() {
+    #ifndef NOTHREADS
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for(int i = 0; i < (int)workers.size(); i++) {
+        workers[i].join();
+    }
+    #endif
+}
+PUBLIC STATIC ThreadPool *ThreadPool::instance() {
+    static ThreadPool *thisinstance = new ThreadPool(getDefaultNumThreads());
+    return thisinstance;
+}
+PUBLIC STATIC int ThreadPool::getDefaultNumThreads() {
+    #ifdef NOTHREADS
+    return 1;
+    #else
+    const char *fromEnv = getenv("DEEPCL_NUM_THREADS");
+    if(fromEnv != 0 && atoi(fromEnv) > 0) {
+        return atoi(fromEnv);
+    }
+    int numHardwareThreads = (int)thread::hardware_concurrency();
+    return numHardwareThreads > 0 ? numHardwareThreads : 1;
+    #endif
+}
+PUBLIC int ThreadPool::getNumThreads() {
+    return numThreads;
+}
+PUBLIC void ThreadPool::run(int numTasks, ThreadPoolTask *task) {
+    if(numTasks <= 0) {
+        return;
+    }
+    #ifdef NOTHREADS
+    for(int taskId = 0; taskId < numTasks; taskId++) {
+        task->run(0, taskId);
+    }
+    #else
+    unique_lock<mutex> runLock(runMutex, try_to_lock);
+    if(!runLock.owns_lock() || workers.size() == 0 || numTasks == 1) {
+        for(int taskId = 0; taskId < numTasks; taskId++) {
+            task->run(0, taskId);
+        }
+        return;
+    }
+    {
+        lock_guard<mutex> lock(stateMutex);
+        this->task = task;
+        this->numTasks = numTasks;
+        this->nextTaskId = 0;
+        this->firstException = exception_ptr();
+        numWorkersBusy = (int)workers.size();
+        generation++;
+    }
+    workAvailable.notify_all();
+    drainTasks(0);
+    exception_ptr exceptionToRethrow;
+    {
+        unique_lock<mutex> lock(stateMutex);
+        while(numWorkersBusy > 0) {
+            workDone.wait(lock);
+        }
+        this->task = 0;
+        exceptionToRethrow = firstException;
+        firstException = exception_ptr();
+    }
+    if(exceptionToRethrow) {
+        rethrow_exception(exceptionToRethrow);
+    }
+    #endif
+}
+PRIVATE void ThreadPool::workerLoop(int threadId) {
+    #ifndef NOTHREADS
+    int seenGeneration = 0;
+    while(true) {
+        {
+            unique_lock<mutex> lock(stateMutex);
+            while(!stopping && generation == seenGeneration) {
+                workAvailable.wait(lock);
+            }
+            if(stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+        drainTasks(threadId);
+        {
+            lock_guard<mutex> lock(stateMutex);
+            numWorkersBusy--;
+        }
+        workDone.notify_one();
+    }
+    #endif
+}
+PRIVATE void ThreadPool::drainTasks(int threadId) {
+    #ifndef NOTHREADS
+    int taskId;
+    while((taskId = nextTaskId++) < numTasks) {
+        try {
+            task->run(threadId, taskId);
+        } catch(...) {
+            lock_guard<mutex> lock(stateMutex);
+            if(!firstException) {
+                firstException = current_exception();
+            }
+            nextTaskId = numTasks; // abandon whatever is left
+        }
+    }
+    #endif
+}
+
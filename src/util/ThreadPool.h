@@ -0,0 +1,91 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <exception>
+
+#if defined(_MSC_VER) && _MSC_VER < 1700 // visual studio 2010 has no std::thread
+#define NOTHREADS
+#else
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#endif
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// derive from this, and pass to ThreadPool::run
+// run() is called once for each taskId in [0, numTasks), possibly concurrently
+// threadId is in [0, pool->getNumThreads()), and is stable for the duration of one
+// call to run(), so can be used to index per-thread scratch buffers
+class DeepCL_EXPORT ThreadPoolTask {
+public:
+    virtual ~ThreadPoolTask() {}
+    virtual void run(int threadId, int taskId) = 0;
+};
+
+// fixed-size pool of worker threads, for the cpu implementations
+// the calling thread participates too, as threadId 0
+// if run() is called while the pool is already busy (eg nested, or from
+// another thread), the tasks just run serially on the calling thread, as threadId 0
+// ... so if you call it from several of your own threads at once, dont share
+// per-thread scratch between those callers
+// number of threads defaults to the number of hardware threads, or
+// the value of environment variable DEEPCL_NUM_THREADS, if set
+// if NOTHREADS, then everything just runs serially on the calling thread
+class DeepCL_EXPORT ThreadPool {
+    private:
+    // as long as these stay private, should be ok to disable the warnings I think?
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    #ifndef NOTHREADS
+    std::vector<std::thread> workers;
+    std::mutex runMutex; // held for the duration of one run()
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+    std::atomic<int> nextTaskId;
+    std::exception_ptr firstException; // rethrown from run(), on the calling thread
+    #endif
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    int numThreads;
+    ThreadPoolTask *task;
+    int numTasks;
+    int generation;
+    int numWorkersBusy;
+    bool stopping;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    ThreadPool(int numThreads);
+    ~ThreadPool();
+    STATIC ThreadPool *instance();
+    STATIC int getDefaultNumThreads();
+    int getNumThreads();
+    void run(int numTasks, ThreadPoolTask *task);
+
+    private:
+    void workerLoop(int threadId);
+    void drainTasks(int threadId);
+
+    // [[[end]]]
+};
+
@@ -78,6 +78,19 @@ public:
       return timemilliseconds;
     }
 
+    double lapMicroseconds() { // like lap(), but finer-grained, for timing individual kernels
+    #ifdef WINNOCHRONO
+       DWORD thistime = getCount();
+      double timemicroseconds = (thistime - last) * 1000.0;
+       #else
+      std::chrono::time_point<std::chrono::high_resolution_clock> thistime = getCount();
+    std::chrono::duration<double> change = thistime - last;
+      double timemicroseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds> (change).count());
+       #endif
+      last = thistime;
+      return timemicroseconds;
+    }
+
    double lap() {
 //       #ifdef _WIN32
     #ifdef WINNOCHRONO
@@ -0,0 +1,201 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+
+#include "util/FileHelper.h"
+#include "util/stringhelper.h"
+#include "net/NeuralNet.h"
+#include "weights/WeightsPersister.h"
+#include "weights/CheckpointWriter.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL
+#undef STATIC
+#define STATIC
+
+PUBLIC PUBLICAPI CheckpointWriter::CheckpointWriter() :
+        chunkSize(4 * 1024 * 1024),
+        stopping(false) {
+    for(int i = 0; i < 2; i++) {
+        checkpoints[i].data = 0;
+        checkpoints[i].capacity = 0;
+        checkpoints[i].size = 0;
+        checkpoints[i].state = FREE;
+    }
+    #ifndef NOTHREADS
+    writerThread = thread(&CheckpointWriter::writerLoop, this);
+    #endif
+}
+// waits for any checkpoint already handed over to finish writing; call flush() first
+// to find out whether that worked
+PUBLIC PUBLICAPI CheckpointWriter::~CheckpointWriter() {
+    #ifndef NOTHREADS
+    {
+        lock_guard<mutex> lock(stateMutex);
+        stopping = true;
+    }
+    stateChanged.notify_all();
+    writerThread.join();
+    #endif
+    for(int i = 0; i < 2; i++) {
+        delete[] checkpoints[i].data;
+    }
+}
+// bytes per write() call, default 4MB
+PUBLIC PUBLICAPI void CheckpointWriter::setChunkSize(long long bytes) {
+    if(bytes < 1) {
+        throw runtime_error("CheckpointWriter::setChunkSize: chunk size must be at least 1, but was " + toString(bytes));
+    }
+    chunkSize = bytes;
+}
+// same arguments as WeightsPersister::persistWeights
+// returns as soon as the weights are copied; call from one thread only
+// returns the status of any earlier snapshot finished since we last said, see takeStatus
+PUBLIC PUBLICAPI std::string CheckpointWriter::snapshot(std::string filepath, std::string trainingConfigString, NeuralNet *net, int epoch, int batch, float annealedLearningRate, int numRight, float loss) {
+    string status = takeStatus();
+    Checkpoint *checkpoint = 0;
+    {
+        #ifndef NOTHREADS
+        lock_guard<mutex> lock(stateMutex);
+        #endif
+        // the writer holds at most one of the two, so the other is either free, or
+        // pending, ie not yet started, and stale, so we can overwrite it
+        for(int i = 0; i < 2; i++) {
+            if(checkpoints[i].state == PENDING) {
+                checkpoint = &checkpoints[i];
+            }
+        }
+        for(int i = 0; i < 2 && checkpoint == 0; i++) {
+            if(checkpoints[i].state == FREE) {
+                checkpoint = &checkpoints[i];
+            }
+        }
+        checkpoint->state = FILLING;
+    }
+    long long size = WeightsPersister::getPersistFileSize(net);
+    if(size > checkpoint->capacity) {
+        delete[] checkpoint->data;
+        checkpoint->data = new char[size];
+        checkpoint->capacity = size;
+    }
+    checkpoint->size = size;
+    checkpoint->filepath = filepath;
+    WeightsPersister::copyNetToPersistArray(checkpoint->data, trainingConfigString, net, epoch, batch, annealedLearningRate, numRight, loss);
+    #ifdef NOTHREADS
+    checkpoint->state = FREE;
+    status = write(checkpoint);
+    #else
+    {
+        lock_guard<mutex> lock(stateMutex);
+        checkpoint->state = PENDING;
+    }
+    stateChanged.notify_all();
+    #endif
+    return status;
+}
+// blocks until every snapshot so far is on disk, and returns their status, see takeStatus
+PUBLIC PUBLICAPI std::string CheckpointWriter::flush() {
+    #ifndef NOTHREADS
+    {
+        unique_lock<mutex> lock(stateMutex);
+        while(checkpoints[0].state == PENDING || checkpoints[0].state == WRITING
+                || checkpoints[1].state == PENDING || checkpoints[1].state == WRITING) {
+            stateChanged.wait(lock);
+        }
+    }
+    #endif
+    return takeStatus();
+}
+// eg "wrote weights to file, filesize 1234KB", for the latest snapshot written since
+// the last call, or "" if none; throws if a write failed
+// the writer thread doesnt print anything itself, so the caller can print this
+PUBLIC PUBLICAPI std::string CheckpointWriter::takeStatus() {
+    rethrowWriterError();
+    #ifndef NOTHREADS
+    lock_guard<mutex> lock(stateMutex);
+    #endif
+    string status = writerStatus;
+    writerStatus = "";
+    return status;
+}
+PRIVATE void CheckpointWriter::writerLoop() {
+    #ifndef NOTHREADS
+    unique_lock<mutex> lock(stateMutex);
+    while(true) {
+        Checkpoint *checkpoint = 0;
+        for(int i = 0; i < 2; i++) {
+            if(checkpoints[i].state == PENDING) {
+                checkpoint = &checkpoints[i];
+            }
+        }
+        if(checkpoint == 0) {
+            if(stopping) {
+                return;
+            }
+            stateChanged.wait(lock);
+            continue;
+        }
+        checkpoint->state = WRITING;
+        lock.unlock();
+        string status = "";
+        string error = "";
+        try {
+            status = write(checkpoint);
+        } catch(exception &e) {
+            error = e.what();
+        }
+        lock.lock();
+        if(error != "") {
+            writerError = error;
+        } else {
+            writerStatus = status;
+        }
+        checkpoint->state = FREE;
+        stateChanged.notify_all();
+    }
+    #endif
+}
+// writes to filepath~, then renames over filepath, same as WeightsPersister::persistWeights
+// returns the status for takeStatus
+PRIVATE std::string CheckpointWriter::write(Checkpoint *checkpoint) {
+    string tempPath = FileHelper::localizePath(checkpoint->filepath + "~");
+    ofstream file(tempPath.c_str(), ios::out | ios::binary);
+    if(!file.is_open()) {
+        throw runtime_error("cannot open file " + tempPath);
+    }
+    for(long long pos = 0; pos < checkpoint->size; pos += chunkSize) {
+        long long thisChunkSize = checkpoint->size - pos < chunkSize ? checkpoint->size - pos : chunkSize;
+        if(!file.write(checkpoint->data + pos, (streamsize)thisChunkSize)) {
+            throw runtime_error("failed to write to " + tempPath);
+        }
+    }
+    file.close();
+    if(file.fail()) {
+        throw runtime_error("failed to write to " + tempPath);
+    }
+    FileHelper::remove(checkpoint->filepath);
+    FileHelper::rename(checkpoint->filepath + "~", checkpoint->filepath);
+    return "wrote weights to file, filesize " + toString(checkpoint->size / 1024) + "KB";
+}
+PRIVATE void CheckpointWriter::rethrowWriterError() {
+    string error;
+    {
+        #ifndef NOTHREADS
+        lock_guard<mutex> lock(stateMutex);
+        #endif
+        error = writerError;
+        writerError = "";
+    }
+    if(error != "") {
+        throw runtime_error("CheckpointWriter: " + error);
+    }
+}
+
@@ -0,0 +1,85 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+
+#include "util/ThreadPool.h" // for NOTHREADS, and the thread headers
+
+class NeuralNet;
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+/// \brief Writes weights files, in the WeightsPersister format, from a background thread
+///
+/// snapshot() copies the weights into one of two buffers, which are kept, and reused,
+/// from one checkpoint to the next, and returns; a writer thread then streams the
+/// buffer to disk, in chunks, and renames it into place, like WeightsPersister::persistWeights
+/// So training only pays for copying the weights.
+/// If a snapshot comes in before the previous one has started writing, the older
+/// one is dropped, since the newer one supersedes it
+/// Errors from the writer thread are rethrown from the next snapshot() or flush()
+/// if NOTHREADS, snapshot() just writes synchronously
+PUBLICAPI
+class DeepCL_EXPORT CheckpointWriter {
+    private:
+    class Checkpoint {
+    public:
+        char *data;
+        long long capacity; // bytes allocated
+        long long size; // bytes used
+        std::string filepath;
+        int state;
+    };
+    static const int FREE = 0;
+    static const int FILLING = 1;
+    static const int PENDING = 2;
+    static const int WRITING = 3;
+
+    Checkpoint checkpoints[2];
+    long long chunkSize;
+    bool stopping;
+    std::string writerError; // empty if no error
+    std::string writerStatus; // latest write since takeStatus, empty if none
+
+    #ifdef _WIN32
+    #pragma warning(disable: 4251)
+    #endif
+    #ifndef NOTHREADS
+    std::mutex stateMutex;
+    std::condition_variable stateChanged;
+    std::thread writerThread;
+    #endif
+    #ifdef _WIN32
+    #pragma warning(default: 4251)
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.addv2()
+    // ]]]
+    // generated, using cog:
+
+    public:
+    PUBLICAPI CheckpointWriter();
+    PUBLICAPI ~CheckpointWriter();
+    PUBLICAPI void setChunkSize(long long bytes);
+    PUBLICAPI std::string snapshot(std::string filepath, std::string trainingConfigString, NeuralNet *net, int epoch, int batch, float annealedLearningRate, int numRight, float loss);
+    PUBLICAPI std::string flush();
+    PUBLICAPI std::string takeStatus();
+
+    private:
+    void writerLoop();
+    std::string write(Checkpoint *checkpoint);
+    void rethrowWriterError();
+
+    // [[[end]]]
+};
+
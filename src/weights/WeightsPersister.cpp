@@ -6,10 +6,16 @@
 
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 
 #include "util/FileHelper.h"
+#include "util/MappedFile.h"
+#include "util/ReducedPrecision.h"
+#include "util/stringhelper.h"
 #include "net/NeuralNet.h"
 #include "layer/Layer.h"
+#include "quantize/Int8Quantizer.h"
 #include "weights/WeightsPersister.h"
 
 using namespace std;
@@ -80,41 +86,188 @@ STATIC int WeightsPersister::getArrayOffsetForLayer(int version, NeuralNet *net,
 // the machine fails right in between the 'delete' and the 'rename', but you 
 // should ideally never actually lose the weights file (unless the drive itself
 // fails of course...)
+// fills in the headerLength bytes that come before the weights
+STATIC void WeightsPersister::writeHeader(char *header, std::string trainingConfigString, int epoch, int batch, float annealedLearningRate, int numRight, float loss) {
+    int *headerInts = reinterpret_cast<int *>(header);
+    float *headerFloats = reinterpret_cast<float *>(header);
+    memset(header, 0, headerLength);
+    strcpy_safe(header, "ClCn", 4); // so easy to recognise file type
+    headerInts[1] = latestVersion; // data file version number
+    headerInts[2] = epoch;
+    headerInts[3] = batch;
+    headerInts[4] = numRight;
+    headerFloats[5] = loss;
+    headerFloats[6] = annealedLearningRate;
+    strcpy_safe(header + 7 * 4, trainingConfigString.c_str(), 800);
+}
+// this will either succeed or fail in general
+// in the worst case, you can find the weights in a file postfixed with '~', if 
+// the machine fails right in between the 'delete' and the 'rename', but you 
+// should ideally never actually lose the weights file (unless the drive itself
+// fails of course...)
+// blocks until written; see CheckpointWriter to write from a background thread instead
 STATIC void WeightsPersister::persistWeights(std::string filepath, std::string trainingConfigString, NeuralNet *net, int epoch, int batch, float annealedLearningRate, int numRight, float loss) { // we should probably rename 'weights' to 'model' now that we are storing normalization data too?
-    int headerLength = 1024;
-    int totalWeightsSize = getTotalNumWeights(latestVersion, net);
-    char *persistArray = new char[headerLength + totalWeightsSize * sizeof(float) ];
-    int *persistArrayInts = reinterpret_cast<int *>(persistArray);
-    float *persistArrayFloats = reinterpret_cast<float *>(persistArray);
-    strcpy_safe(persistArray, "ClCn", 4); // so easy to recognise file type
-    persistArrayInts[1] = latestVersion; // data file version number
-    persistArrayInts[2] = epoch;
-    persistArrayInts[3] = batch;
-    persistArrayInts[4] = numRight;
-    persistArrayFloats[5] = loss;
-    persistArrayFloats[6] = annealedLearningRate;
-    strcpy_safe(persistArray + 7 * 4, trainingConfigString.c_str(), 800);
-    copyNetWeightsToArray(latestVersion, net, reinterpret_cast<float *>(persistArray + headerLength));
-    FileHelper::writeBinary(filepath + "~", reinterpret_cast<char *>(persistArray), 
-        headerLength + totalWeightsSize * sizeof(float));
+    long long fileSize = getPersistFileSize(net);
+    char *persistArray = new char[fileSize];
+    copyNetToPersistArray(persistArray, trainingConfigString, net, epoch, batch, annealedLearningRate, numRight, loss);
+    FileHelper::writeBinary(filepath + "~", persistArray, (long)fileSize);
     FileHelper::remove(filepath);
     FileHelper::rename(filepath + "~", filepath);
-    std::cout << "wrote weights to file, filesize " << (( headerLength + totalWeightsSize) *sizeof(float)/1024) << "KB" << std::endl;
+    std::cout << "wrote weights to file, filesize " << (fileSize / 1024) << "KB" << std::endl;
     delete[] persistArray;
 }
+STATIC int WeightsPersister::getNumPersistedLayers(NeuralNet *net) {
+    int numPersistedLayers = 0;
+    for(int layerIdx = 1; layerIdx < net->getNumLayers(); layerIdx++) {
+        if(net->getLayer(layerIdx)->getPersistSize(latestVersion) > 0) {
+            numPersistedLayers++;
+        }
+    }
+    return numPersistedLayers;
+}
+STATIC long long WeightsPersister::alignTo64(long long offset) {
+    return (offset + 63) / 64 * 64;
+}
+// 'fp32', 'fp16', 'bf16' or 'int8'
+STATIC int WeightsPersister::dtypeFromName(std::string dtypeName) {
+    if(dtypeName == "fp32") {
+        return DTYPE_FLOAT32;
+    } else if(dtypeName == "fp16") {
+        return DTYPE_FLOAT16;
+    } else if(dtypeName == "bf16") {
+        return DTYPE_BFLOAT16;
+    } else if(dtypeName == "int8") {
+        return DTYPE_INT8;
+    }
+    throw std::runtime_error("weights storage dtype " + dtypeName + " not recognized; choose fp32, fp16, bf16 or int8");
+}
+STATIC std::string WeightsPersister::dtypeName(int dtype) {
+    if(dtype == DTYPE_FLOAT32) {
+        return "fp32";
+    } else if(dtype == DTYPE_FLOAT16) {
+        return "fp16";
+    } else if(dtype == DTYPE_BFLOAT16) {
+        return "bf16";
+    } else if(dtype == DTYPE_INT8) {
+        return "int8";
+    }
+    throw std::runtime_error("weights storage dtype " + toString(dtype) + " not recognized");
+}
+// bytes per weight; int8 layers also store their scales, see getLayerPersistBytes
+STATIC int WeightsPersister::getDtypeSize(int dtype) {
+    if(dtype == DTYPE_INT8) {
+        return 1;
+    }
+    return dtype == DTYPE_FLOAT32 ? 4 : 2;
+}
+// int8 storage only applies to convolutional and fully-connected layers; the others,
+// eg normalization, stay fp32
+STATIC int WeightsPersister::getLayerDtype(int weightsStorage, Layer *layer) {
+    if(weightsStorage == DTYPE_INT8 && Int8Quantizer::getQuantizableLayer(layer) == 0) {
+        return DTYPE_FLOAT32;
+    }
+    return weightsStorage;
+}
+STATIC long long WeightsPersister::getLayerPersistBytes(Layer *layer, int dtype) {
+    if(dtype == DTYPE_INT8) {
+        return Int8Quantizer::getInt8PersistSize(Int8Quantizer::getQuantizableLayer(layer));
+    }
+    return (long long)layer->getPersistSize(latestVersion) * getDtypeSize(dtype);
+}
+// header, then layer table, then each layer's weights, 64-byte aligned, in the
+// net's weights storage dtype
+STATIC long long WeightsPersister::getPersistFileSize(NeuralNet *net) {
+    long long pos = alignTo64(headerLength + 8 + (long long)getNumPersistedLayers(net) * sizeof(WeightsFileLayerEntry));
+    for(int layerIdx = 1; layerIdx < net->getNumLayers(); layerIdx++) {
+        Layer *layer = net->getLayer(layerIdx);
+        if(layer->getPersistSize(latestVersion) > 0) {
+            pos = alignTo64(pos + getLayerPersistBytes(layer, getLayerDtype(net->getWeightsStorage(), layer)));
+        }
+    }
+    return pos;
+}
+// writes a complete latestVersion file image into persistArray, which should be
+// getPersistFileSize(net) bytes
+STATIC void WeightsPersister::copyNetToPersistArray(char *persistArray, std::string trainingConfigString, NeuralNet *net, int epoch, int batch, float annealedLearningRate, int numRight, float loss) {
+    int numPersistedLayers = getNumPersistedLayers(net);
+    long long dataStart = alignTo64(headerLength + 8 + (long long)numPersistedLayers * sizeof(WeightsFileLayerEntry));
+    writeHeader(persistArray, trainingConfigString, epoch, batch, annealedLearningRate, numRight, loss);
+    memset(persistArray + headerLength, 0, (size_t)(dataStart - headerLength));
+    reinterpret_cast<int *>(persistArray + headerLength)[0] = numPersistedLayers;
+    WeightsFileLayerEntry *entries = reinterpret_cast<WeightsFileLayerEntry *>(persistArray + headerLength + 8);
+    std::vector<float> floats; // for conversion, if not storing fp32
+    long long pos = dataStart;
+    int entryIdx = 0;
+    for(int layerIdx = 1; layerIdx < net->getNumLayers(); layerIdx++) {
+        Layer *layer = net->getLayer(layerIdx);
+        int persistSize = layer->getPersistSize(latestVersion);
+        if(persistSize == 0) {
+            continue;
+        }
+        int dtype = getLayerDtype(net->getWeightsStorage(), layer);
+        long long numBytes = getLayerPersistBytes(layer, dtype);
+        if(dtype == DTYPE_FLOAT32) {
+            layer->persistToArray(latestVersion, reinterpret_cast<float *>(persistArray + pos));
+        } else {
+            floats.resize(persistSize);
+            layer->persistToArray(latestVersion, &floats[0]);
+            if(dtype == DTYPE_INT8) {
+                Int8Quantizer::persistInt8(Int8Quantizer::getQuantizableLayer(layer), &floats[0], persistArray + pos);
+            } else if(dtype == DTYPE_FLOAT16) {
+                ReducedPrecision::floatsToHalves(&floats[0], reinterpret_cast<unsigned short *>(persistArray + pos), persistSize);
+            } else {
+                ReducedPrecision::floatsToBfloat16s(&floats[0], reinterpret_cast<unsigned short *>(persistArray + pos), persistSize);
+            }
+        }
+        long long end = alignTo64(pos + numBytes);
+        memset(persistArray + pos + numBytes, 0, (size_t)(end - pos - numBytes));
+
+        WeightsFileLayerEntry *entry = &entries[entryIdx++];
+        entry->layerIndex = layerIdx;
+        entry->dtype = dtype;
+        entry->numElements = persistSize;
+        entry->outputPlanes = layer->getOutputPlanes();
+        entry->outputSize = layer->getOutputSize();
+        entry->checksum = checksum(persistArray + pos, numBytes);
+        entry->offset = pos;
+        strcpy_safe(entry->layerType, layer->getClassName().c_str(), sizeof(entry->layerType) - 1);
+        pos = end;
+    }
+}
+// fnv-1a, 32-bit
+STATIC unsigned int WeightsPersister::checksum(char const *data, long long length) {
+    unsigned int hash = 2166136261u;
+    unsigned char const *bytes = reinterpret_cast<unsigned char const *>(data);
+    for(long long i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+// the training config string in a header, which might not be null-terminated
+STATIC std::string WeightsPersister::getConfigString(char const *header) {
+    char const *configString = header + 7 * 4;
+    int length = 0;
+    while(length < headerLength - 7 * 4 - 1 && configString[length] != 0) {
+        length++;
+    }
+    return std::string(configString, length);
+}
 STATIC bool WeightsPersister::loadWeights(std::string filepath, std::string trainingConfigString, NeuralNet *net, int *p_epoch, int *p_batch, float *p_annealedLearningRate, int *p_numRight, float *p_loss) {
     if(FileHelper::exists(filepath) ){
-        int headerSize = 1024;
-        long fileSize;
-        char * data = FileHelper::readBinary(filepath, &fileSize);
-
-        if(!checkData(data, headerSize, fileSize) ){
-            delete [] data;
-            return false;
+        int version;
+        {
+            MappedFile file(filepath);
+            if(!checkData(reinterpret_cast<const char *>(file.getData()), headerLength, (long)file.getSize())) {
+                return false;
+            }
+            version = reinterpret_cast<const int *>(file.getData())[1];
+            if(version == 4) {
+                return loadWeightsv4(&file, trainingConfigString, net, p_epoch, p_batch, p_annealedLearningRate, p_numRight, p_loss);
+            }
         }
-        int *dataAsInts = reinterpret_cast<int *>(data);
-        int version = dataAsInts[1];
         if(version == 1 || version == 3) {
+            long fileSize;
+            char * data = FileHelper::readBinary(filepath, &fileSize);
             return loadWeightsv1or3(data, fileSize, trainingConfigString, net, p_epoch, p_batch, p_annealedLearningRate, p_numRight, p_loss);
         } else {
             throw std::runtime_error("weights version " + toString(version) + " not recognized");
@@ -122,6 +275,124 @@ STATIC bool WeightsPersister::loadWeights(std::string filepath, std::string trai
     }
     return false;
 }
+// same as loadWeights, but for resuming training: refuses a file with fp16, bf16 or int8
+// layers, since training would silently continue from the rounded weights, rather than
+// the fp32 weights it wrote them from
+STATIC bool WeightsPersister::loadCheckpoint(std::string filepath, std::string trainingConfigString, NeuralNet *net, int *p_epoch, int *p_batch, float *p_annealedLearningRate, int *p_numRight, float *p_loss) {
+    int dtype = getReducedDtype(filepath);
+    if(dtype != DTYPE_FLOAT32) {
+        throw std::runtime_error("weights file " + filepath + " stores weights as " + dtypeName(dtype) + ", so training cant resume from it.  Resume from an fp32 checkpoint; reduced weights files are for inference");
+    }
+    return loadWeights(filepath, trainingConfigString, net, p_epoch, p_batch, p_annealedLearningRate, p_numRight, p_loss);
+}
+// the first dtype, other than fp32, in a weights file's layer table, or DTYPE_FLOAT32 if
+// every layer is fp32, or the file is from before version 4, or doesnt exist
+STATIC int WeightsPersister::getReducedDtype(std::string filepath) {
+    if(!FileHelper::exists(filepath)) {
+        return DTYPE_FLOAT32;
+    }
+    MappedFile file(filepath);
+    const char *data = reinterpret_cast<const char *>(file.getData());
+    long long fileSize = file.getSize();
+    if(!checkData(data, headerLength, (long)fileSize) || reinterpret_cast<const int *>(data)[1] != 4
+            || fileSize < headerLength + 8) {
+        return DTYPE_FLOAT32;
+    }
+    int numEntries = reinterpret_cast<const int *>(data + headerLength)[0];
+    if(numEntries < 0 || headerLength + 8 + (long long)numEntries * (long long)sizeof(WeightsFileLayerEntry) > fileSize) {
+        throw std::runtime_error("weights file " + filepath + " truncated, or corrupt, layer table");
+    }
+    const WeightsFileLayerEntry *entries = reinterpret_cast<const WeightsFileLayerEntry *>(data + headerLength + 8);
+    for(int i = 0; i < numEntries; i++) {
+        if(entries[i].dtype != DTYPE_FLOAT32) {
+            return entries[i].dtype;
+        }
+    }
+    return DTYPE_FLOAT32;
+}
+// each layer unpersists straight from the mapped pages; fp16, bf16 and int8 layers go
+// through a float buffer
+STATIC bool WeightsPersister::loadWeightsv4(MappedFile *file, std::string trainingConfigString, NeuralNet *net, int *p_epoch, int *p_batch, float *p_annealedLearningRate, int *p_numRight, float *p_loss) {
+    const char *data = reinterpret_cast<const char *>(file->getData());
+    long long fileSize = file->getSize();
+    std::string configInFile = getConfigString(data);
+    if(trainingConfigString != configInFile) {
+        std::cout << "training options dont match weights file" << std::endl;
+        std::cout << "in file: [" + configInFile + "]" << std::endl;
+        std::cout << "current options: [" + trainingConfigString + "]" << std::endl;
+        return false;
+    }
+
+    const int *dataAsInts = reinterpret_cast<const int *>(data);
+    const float *dataAsFloats = reinterpret_cast<const float *>(data);
+    int version = dataAsInts[1];
+    *p_epoch = dataAsInts[2];
+    *p_batch = dataAsInts[3];
+    *p_numRight = dataAsInts[4];
+    *p_loss = dataAsFloats[5];
+    *p_annealedLearningRate = dataAsFloats[6];
+
+    if(fileSize < headerLength + 8) {
+        throw std::runtime_error("weights file " + file->getFilepath() + " truncated: no layer table");
+    }
+    int numEntries = reinterpret_cast<const int *>(data + headerLength)[0];
+    if(numEntries < 0 || headerLength + 8 + (long long)numEntries * (long long)sizeof(WeightsFileLayerEntry) > fileSize) {
+        throw std::runtime_error("weights file " + file->getFilepath() + " truncated, or corrupt, layer table");
+    }
+    const WeightsFileLayerEntry *entries = reinterpret_cast<const WeightsFileLayerEntry *>(data + headerLength + 8);
+    std::vector<float> floats; // for conversion, if not stored as fp32
+    int entryIdx = 0;
+    for(int layerIdx = 1; layerIdx < net->getNumLayers(); layerIdx++) {
+        Layer *layer = net->getLayer(layerIdx);
+        int persistSize = layer->getPersistSize(version);
+        if(persistSize == 0) {
+            continue;
+        }
+        if(entryIdx >= numEntries) {
+            throw std::runtime_error("weights file contains " + toString(numEntries) + " layers with weights, but the net has more.  So there is probably some mismatch between the weights file, and the settings, or network version, used.");
+        }
+        const WeightsFileLayerEntry &entry = entries[entryIdx++];
+        if(entry.layerIndex != layerIdx || entry.numElements != persistSize
+                || entry.outputPlanes != layer->getOutputPlanes() || entry.outputSize != layer->getOutputSize()) {
+            std::string layerType(entry.layerType, std::find(entry.layerType, entry.layerType + sizeof(entry.layerType), 0));
+            throw std::runtime_error("weights file layer " + toString(entry.layerIndex) + " (" + layerType + ", "
+                + toString(entry.numElements) + " values, " + toString(entry.outputPlanes) + "x" + toString(entry.outputSize) + ") doesnt match net layer "
+                + toString(layerIdx) + " (" + layer->getClassName() + ", " + toString(persistSize) + " values, "
+                + toString(layer->getOutputPlanes()) + "x" + toString(layer->getOutputSize()) + ").  So there is probably some mismatch between the weights file, and the settings, or network version, used.");
+        }
+        if(entry.dtype != DTYPE_FLOAT32 && entry.dtype != DTYPE_FLOAT16 && entry.dtype != DTYPE_BFLOAT16 && entry.dtype != DTYPE_INT8) {
+            throw std::runtime_error("weights file layer " + toString(layerIdx) + ": dtype " + toString(entry.dtype) + " not recognized");
+        }
+        if(entry.dtype == DTYPE_INT8 && Int8Quantizer::getQuantizableLayer(layer) == 0) {
+            throw std::runtime_error("weights file layer " + toString(layerIdx) + ": int8, but net layer " + layer->getClassName() + " cant be quantized");
+        }
+        long long numBytes = getLayerPersistBytes(layer, entry.dtype);
+        if(entry.offset < 0 || entry.offset % 64 != 0 || entry.offset + numBytes > fileSize) {
+            throw std::runtime_error("weights file " + file->getFilepath() + " truncated, or corrupt, at layer " + toString(layerIdx));
+        }
+        const char *layerData = data + entry.offset;
+        if(checksum(layerData, numBytes) != entry.checksum) {
+            throw std::runtime_error("weights file " + file->getFilepath() + " checksum mismatch at layer " + toString(layerIdx) + ": file corrupt");
+        }
+        if(entry.dtype == DTYPE_FLOAT32) {
+            layer->unpersistFromArray(version, reinterpret_cast<const float *>(layerData));
+        } else {
+            floats.resize(persistSize);
+            if(entry.dtype == DTYPE_INT8) {
+                Int8Quantizer::unpersistInt8(Int8Quantizer::getQuantizableLayer(layer), layerData, &floats[0]);
+            } else if(entry.dtype == DTYPE_FLOAT16) {
+                ReducedPrecision::halvesToFloats(reinterpret_cast<const unsigned short *>(layerData), &floats[0], persistSize);
+            } else {
+                ReducedPrecision::bfloat16sToFloats(reinterpret_cast<const unsigned short *>(layerData), &floats[0], persistSize);
+            }
+            layer->unpersistFromArray(version, &floats[0]);
+        }
+    }
+    if(entryIdx != numEntries) {
+        throw std::runtime_error("weights file contains " + toString(numEntries) + " layers with weights, but the net has only " + toString(entryIdx) + ".  So there is probably some mismatch between the weights file, and the settings, or network version, used.");
+    }
+    return true;
+}
 STATIC bool WeightsPersister::loadWeightsv1or3(char *data, long fileSize, std::string trainingConfigString, NeuralNet *net, int *p_epoch, int *p_batch, float *p_annealedLearningRate, int *p_numRight, float *p_loss) {
         int headerSize = 1024;
         data[headerSize - 1] = 0; // null-terminate the string, if not already done
@@ -175,36 +446,31 @@ STATIC bool WeightsPersister::checkData(const char * data, long headerSize, long
     }
 
     const int *dataAsInts = reinterpret_cast<const int *>(data);
-    if(dataAsInts[1] != 1 && dataAsInts[1] != 3) {
+    if(dataAsInts[1] != 1 && dataAsInts[1] != 3 && dataAsInts[1] != 4) {
         std::cout << "weights file version not known" << std::endl;
         return false;
     }
 
     return true;
 }
+// only reads the header, so this is cheap, even for large weights files
 STATIC bool WeightsPersister::loadConfigString(std::string filepath, std::string & configString) {
     if(FileHelper::exists(filepath) ){
-        int headerSize = 1024;
-        long fileSize;
-        char * data = FileHelper::readBinary(filepath, &fileSize);
-
-        if(!checkData(data, headerSize, fileSize) ) {
-            delete [] data;
+        MappedFile file(filepath);
+        const char *data = reinterpret_cast<const char *>(file.getData());
+        if(!checkData(data, headerLength, (long)file.getSize()) ) {
             return false;
         }
 
-        data[headerSize - 1] = 0; // null-terminate the string, if not already done
-
         // + skip the 'netdef='
         const int *dataAsInts = reinterpret_cast<const int *>(data);
         int version = dataAsInts[1];
-        if(version == 1 || version == 3) {
-            configString = std::string(data + 7 * 4 + 7);
+        if(version == 1 || version == 3 || version == 4) {
+            std::string fullString = getConfigString(data);
+            configString = fullString.length() >= 7 ? fullString.substr(7) : "";
         } else {
             throw std::runtime_error("unknown versoin " + toString(version));
         }
-
-        delete [] data;
         return true;
     }
     return false;
@@ -10,12 +10,29 @@
 #include <string>
 
 class NeuralNet;
+class Layer;
+class MappedFile;
 
 #define VIRTUAL virtual
 #define STATIC static
 
 #include "DeepCLDllExport.h"
 
+// one row of the layer table in version 4 weights files, which comes straight
+// after the header, after an int holding the number of rows, and padding to 8 bytes
+// one row per layer that persists anything, in layer order
+class WeightsFileLayerEntry {
+public:
+    int layerIndex;
+    int dtype; // WeightsPersister::DTYPE_FLOAT32, DTYPE_FLOAT16, DTYPE_BFLOAT16 or DTYPE_INT8
+    int numElements; // persisted values, ie layer->getPersistSize()
+    int outputPlanes; // shape of the layer, checked against the net on load
+    int outputSize;
+    unsigned int checksum; // fnv-1a, over the layer's bytes
+    long long offset; // bytes, from start of file; multiple of 64
+    char layerType[32]; // getClassName(), for error messages
+};
+
 /// \brief Use to read/write weights from a NeuralNet
 ///
 /// whilst this class is portable, the weights files created totally are not (ie: endianness)
@@ -25,11 +42,26 @@ class NeuralNet;
 ///
 /// Target usage for this class is quickly snapshotting the weights after each epoch.  
 /// Therefore should be: fast, low IO :-)
+///
+/// From version 4, each layer's weights are stored separately, 64-byte aligned, and
+/// described by a table of WeightsFileLayerEntry, so loading maps the file and each
+/// layer reads its weights straight from the mapped pages, with no intermediate copy
+/// of the whole file.  Versions 1 and 3 can still be loaded.
+/// Version 4 files can store the weights as fp16 or bf16, see NeuralNet::setWeightsStorage;
+/// they're converted back to float on load, so training and inference still run in fp32
+/// They can also store convolutional and fully-connected layers as int8, after
+/// calibration, see Int8Quantizer; these are dequantized on load, and keep their
+/// scales, for Int8Predictor
 /// 
 PUBLICAPI
 class DeepCL_EXPORT WeightsPersister {
 public:
-    static const int latestVersion = 3;
+    static const int latestVersion = 4;
+    static const int headerLength = 1024; // bytes, before the layer table, or, before version 4, the weights
+    static const int DTYPE_FLOAT32 = 0;
+    static const int DTYPE_FLOAT16 = 1;
+    static const int DTYPE_BFLOAT16 = 2;
+    static const int DTYPE_INT8 = 3;
 
     // [[[cog
     // import cog_addheaders
@@ -45,8 +77,23 @@ public:
     STATIC void copyArrayToNetWeights(int version, float const*source, NeuralNet *net);
     STATIC int getArrayOffsetForLayer(NeuralNet *net, int layer);
     STATIC int getArrayOffsetForLayer(int version, NeuralNet *net, int layer);
+    STATIC void writeHeader(char *header, std::string trainingConfigString, int epoch, int batch, float annealedLearningRate, int numRight, float loss);
     STATIC void persistWeights(std::string filepath, std::string trainingConfigString, NeuralNet *net, int epoch, int batch, float annealedLearningRate, int numRight, float loss);  // we should probably rename 'weights' to 'model' now that we are storing normalization data too?
+    STATIC int getNumPersistedLayers(NeuralNet *net);
+    STATIC long long alignTo64(long long offset);
+    STATIC int dtypeFromName(std::string dtypeName);
+    STATIC std::string dtypeName(int dtype);
+    STATIC int getDtypeSize(int dtype);
+    STATIC int getLayerDtype(int weightsStorage, Layer *layer);
+    STATIC long long getLayerPersistBytes(Layer *layer, int dtype);
+    STATIC long long getPersistFileSize(NeuralNet *net);
+    STATIC void copyNetToPersistArray(char *persistArray, std::string trainingConfigString, NeuralNet *net, int epoch, int batch, float annealedLearningRate, int numRight, float loss);
+    STATIC unsigned int checksum(char const *data, long long length);
+    STATIC std::string getConfigString(char const *header);
     STATIC bool loadWeights(std::string filepath, std::string trainingConfigString, NeuralNet *net, int *p_epoch, int *p_batch, float *p_annealedLearningRate, int *p_numRight, float *p_loss);
+    STATIC bool loadCheckpoint(std::string filepath, std::string trainingConfigString, NeuralNet *net, int *p_epoch, int *p_batch, float *p_annealedLearningRate, int *p_numRight, float *p_loss);
+    STATIC int getReducedDtype(std::string filepath);
+    STATIC bool loadWeightsv4(MappedFile *file, std::string trainingConfigString, NeuralNet *net, int *p_epoch, int *p_batch, float *p_annealedLearningRate, int *p_numRight, float *p_loss);
     STATIC bool loadWeightsv1or3(char *data, long fileSize, std::string trainingConfigString, NeuralNet *net, int *p_epoch, int *p_batch, float *p_annealedLearningRate, int *p_numRight, float *p_loss);
     STATIC bool checkData(const char * data, long headerSize, long fileSize);
     STATIC bool loadConfigString(std::string filepath, std::string & configString);
@@ -6,6 +6,8 @@
 
 #include "net/NeuralNet.h"
 #include "layer/Layer.h"
+#include "layer/LayerMakers.h"
+#include "netdef/NetdefToNet.h"
 #include "NetTestHelper.h"
 
 #undef STATIC
@@ -60,4 +62,12 @@ PUBLIC STATIC void NetTestHelper::printBiasAsCode(NeuralNet *net) {
         printBiasAsCode( layer );
     }
 }
-
+// a small net for the weights file tests: 2 input planes of 9x9, a normalization
+// layer, which has weights to persist too, then netdef
+PUBLIC STATIC NeuralNet *NetTestHelper::createWeightsFileNet(EasyCL *cl, std::string netdef) {
+    NeuralNet *net = new NeuralNet(cl);
+    net->addLayer(InputLayerMaker::instance()->numPlanes(2)->imageSize(9));
+    net->addLayer(NormalizationLayerMaker::instance()->translate(0.5f)->scale(2.0f));
+    NetdefToNet::createNetFromNetdef(net, netdef);
+    return net;
+}
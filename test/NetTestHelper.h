@@ -7,6 +7,9 @@
 
 #pragma once
 
+#include <string>
+
+class EasyCL;
 class NeuralNet;
 
 class NetTestHelper {
@@ -21,6 +24,7 @@ class NetTestHelper {
     STATIC void printBiasAsCode( Layer *layer );
     STATIC void printWeightsAsCode(NeuralNet *net);
     STATIC void printBiasAsCode(NeuralNet *net);
+    STATIC NeuralNet *createWeightsFileNet(EasyCL *cl, std::string netdef);
 
     // [[[end]]]
 };
@@ -0,0 +1,115 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <fstream>
+
+#include "EasyCL.h"
+
+#include "conv/AutoTuneCache.h"
+#include "conv/LayerDimensions.h"
+#include "util/FileHelper.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace {
+    LayerDimensions makeDim(int filterSize) {
+        LayerDimensions dim;
+        dim.setInputPlanes(4).setInputSize(12).setNumFilters(8).setFilterSize(filterSize)
+            .setPadZeros(true).setBiased(true);
+        return dim;
+    }
+}
+
+TEST(testAutoTuneCache, roundTrip) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    string filepath = "testAutoTuneCache.txt";
+    FileHelper::remove(filepath);
+
+    AutoTuneCache *cache = new AutoTuneCache(filepath);
+    string forwardKey = AutoTuneCache::makeKey(cl, "forward", 7, makeDim(3), 128);
+    string backwardKey = AutoTuneCache::makeKey(cl, "backward", 4, makeDim(3), 128);
+    int index = -1;
+    EXPECT_FALSE(cache->get(forwardKey, &index));
+    cache->set(forwardKey, 5);
+    cache->set(backwardKey, 2);
+    delete cache;
+
+    // a new process sees the same choices
+    AutoTuneCache *reloaded = new AutoTuneCache(filepath);
+    EXPECT_TRUE(reloaded->get(forwardKey, &index));
+    EXPECT_EQ(5, index);
+    EXPECT_TRUE(reloaded->get(backwardKey, &index));
+    EXPECT_EQ(2, index);
+    delete reloaded;
+
+    FileHelper::remove(filepath);
+    delete cl;
+}
+
+TEST(testAutoTuneCache, keyMismatch) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    string filepath = "testAutoTuneCache.txt";
+    FileHelper::remove(filepath);
+
+    AutoTuneCache *cache = new AutoTuneCache(filepath);
+    cache->set(AutoTuneCache::makeKey(cl, "forward", 7, makeDim(3), 128), 5);
+    delete cache;
+
+    AutoTuneCache *reloaded = new AutoTuneCache(filepath);
+    int index = -1;
+    // another device
+    EXPECT_FALSE(reloaded->get(AutoTuneCache::makeKey(0, "forward", 7, makeDim(3), 128), &index));
+    // other dimensions, batchsize, kind, or number of implementations
+    EXPECT_FALSE(reloaded->get(AutoTuneCache::makeKey(cl, "forward", 7, makeDim(5), 128), &index));
+    EXPECT_FALSE(reloaded->get(AutoTuneCache::makeKey(cl, "forward", 7, makeDim(3), 64), &index));
+    EXPECT_FALSE(reloaded->get(AutoTuneCache::makeKey(cl, "backward", 7, makeDim(3), 128), &index));
+    EXPECT_FALSE(reloaded->get(AutoTuneCache::makeKey(cl, "forward", 8, makeDim(3), 128), &index));
+    EXPECT_EQ(-1, index);
+    delete reloaded;
+
+    FileHelper::remove(filepath);
+    delete cl;
+}
+
+TEST(testAutoTuneCache, corruptFile) {
+    string filepath = "testAutoTuneCache.txt";
+    {
+        ofstream file(filepath.c_str());
+        file << "no tab on this line\n";
+        file << "\x01\x02garbage";
+        file << "\ngoodkey\t3\n";
+    }
+    AutoTuneCache *cache = new AutoTuneCache(filepath);
+    int index = -1;
+    EXPECT_FALSE(cache->get("no tab on this line", &index));
+    EXPECT_TRUE(cache->get("goodkey", &index));
+    EXPECT_EQ(3, index);
+    // and we can still add to it
+    cache->set("newkey", 4);
+    delete cache;
+
+    AutoTuneCache *reloaded = new AutoTuneCache(filepath);
+    EXPECT_TRUE(reloaded->get("newkey", &index));
+    EXPECT_EQ(4, index);
+    delete reloaded;
+    FileHelper::remove(filepath);
+}
+
+TEST(testAutoTuneCache, unwritableFile) {
+    // the directory doesnt exist, so we cant write, and keep choices in memory only
+    AutoTuneCache *cache = new AutoTuneCache("testAutoTuneCache_nosuchdir/cache.txt");
+    cache->set("key", 6);
+    int index = -1;
+    EXPECT_TRUE(cache->get("key", &index));
+    EXPECT_EQ(6, index);
+    cache->set("key2", 1);
+    EXPECT_TRUE(cache->get("key2", &index));
+    EXPECT_EQ(1, index);
+    delete cache;
+    EXPECT_FALSE(FileHelper::exists("testAutoTuneCache_nosuchdir/cache.txt"));
+}
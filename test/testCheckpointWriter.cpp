@@ -0,0 +1,87 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+
+#include "EasyCL.h"
+#include "net/NeuralNet.h"
+#include "util/FileHelper.h"
+#include "util/stringhelper.h"
+#include "weights/WeightsPersister.h"
+#include "weights/CheckpointWriter.h"
+
+#include "test/NetTestHelper.h"
+
+using namespace std;
+
+TEST(testCheckpointWriter, writesLatestSnapshot) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    NeuralNet *net = NetTestHelper::createWeightsFileNet(cl, "8c3z-10n");
+    string filepath = "testCheckpointWriter.dat";
+    int numWeights = WeightsPersister::getTotalNumWeights(net);
+    float *weights = new float[numWeights];
+
+    CheckpointWriter *writer = new CheckpointWriter();
+    writer->setChunkSize(100); // so we write several chunks
+    writer->snapshot(filepath, "netdef=8c3z-10n", net, 1, 5, 0, 3, 0.5f);
+    for(int i = 0; i < numWeights; i++) {
+        weights[i] = i * 0.01f;
+    }
+    WeightsPersister::copyArrayToNetWeights(weights, net);
+    writer->snapshot(filepath, "netdef=8c3z-10n", net, 2, 7, 0, 4, 0.25f);
+    writer->flush();
+
+    NeuralNet *loaded = NetTestHelper::createWeightsFileNet(cl, "8c3z-10n");
+    int epoch, batch, numRight;
+    float annealedLearningRate, loss;
+    EXPECT_TRUE(WeightsPersister::loadWeights(filepath, "netdef=8c3z-10n", loaded, &epoch, &batch,
+        &annealedLearningRate, &numRight, &loss));
+    EXPECT_EQ(2, epoch);
+    EXPECT_EQ(7, batch);
+    EXPECT_EQ(4, numRight);
+    EXPECT_FLOAT_EQ(0.25f, loss);
+    float *loadedWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray(loaded, loadedWeights);
+    for(int i = 0; i < numWeights; i++) {
+        EXPECT_FLOAT_EQ(weights[i], loadedWeights[i]);
+    }
+
+    delete writer;
+    FileHelper::remove(filepath);
+    delete[] loadedWeights;
+    delete[] weights;
+    delete loaded;
+    delete net;
+    delete cl;
+}
+
+
+TEST(testCheckpointWriter, returnsStatusToCaller) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    NeuralNet *net = NetTestHelper::createWeightsFileNet(cl, "8c3z-10n");
+    string filepath = "testCheckpointWriterStatus.dat";
+    const long long fileSizeKB = WeightsPersister::getPersistFileSize(net) / 1024;
+    const string expectedStatus = "wrote weights to file, filesize " + toString(fileSizeKB) + "KB";
+
+    CheckpointWriter *writer = new CheckpointWriter();
+    EXPECT_EQ("", writer->takeStatus());
+    writer->snapshot(filepath, "netdef=8c3z-10n", net, 1, 0, 0, 0, 0);
+    EXPECT_EQ(expectedStatus, writer->flush());
+    // each write is reported once
+    EXPECT_EQ("", writer->takeStatus());
+    EXPECT_EQ("", writer->flush());
+
+    // a write that fails throws, from the caller's thread
+    writer->snapshot("nonexistentdir/testCheckpointWriterStatus.dat", "netdef=8c3z-10n", net, 2, 0, 0, 0, 0);
+    EXPECT_THROW(writer->flush(), runtime_error);
+    EXPECT_EQ("", writer->takeStatus());
+
+    delete writer;
+    FileHelper::remove(filepath);
+    delete net;
+    delete cl;
+}
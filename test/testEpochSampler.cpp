@@ -0,0 +1,90 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <vector>
+
+#include "batch/EpochSampler.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace testEpochSampler {
+
+void checkIsPermutation(int N, int const *order) {
+    vector<int> seen(N, 0);
+    for(int i = 0; i < N; i++) {
+        ASSERT_GE(order[i], 0);
+        ASSERT_LT(order[i], N);
+        seen[order[i]]++;
+    }
+    for(int i = 0; i < N; i++) {
+        EXPECT_EQ(1, seen[i]);
+    }
+}
+
+TEST(testEpochSampler, sequential) {
+    EpochSampler *sampler = EpochSampler::instance("sequential", 10, 1, 10, 0);
+    sampler->startEpoch(3);
+    for(int i = 0; i < 10; i++) {
+        EXPECT_EQ(i, sampler->getOrder()[i]);
+    }
+    delete sampler;
+}
+
+TEST(testEpochSampler, shuffleIsRepeatablePerEpoch) {
+    const int N = 1000;
+    EpochSampler *sampler = EpochSampler::instance("shuffle", N, 1, N, 123);
+    sampler->startEpoch(0);
+    checkIsPermutation(N, sampler->getOrder());
+    vector<int> epoch0(sampler->getOrder(), sampler->getOrder() + N);
+    sampler->startEpoch(1);
+    checkIsPermutation(N, sampler->getOrder());
+    int numSame = 0;
+    for(int i = 0; i < N; i++) {
+        numSame += sampler->getOrder()[i] == epoch0[i] ? 1 : 0;
+    }
+    EXPECT_LT(numSame, 20);
+    sampler->startEpoch(0);
+    for(int i = 0; i < N; i++) {
+        EXPECT_EQ(epoch0[i], sampler->getOrder()[i]);
+    }
+    delete sampler;
+}
+
+TEST(testEpochSampler, blockShuffleStaysWithinWindowBlocks) {
+    const int N = 1050; // last block is short
+    const int blockSize = 100;
+    const int windowSize = 300;
+    EpochSampler *sampler = EpochSampler::instance("block", N, blockSize, windowSize, 7);
+    sampler->startEpoch(2);
+    int const *order = sampler->getOrder();
+    checkIsPermutation(N, order);
+    int const *blockOrder = sampler->getBlockOrder();
+    EXPECT_EQ(11, sampler->getNumBlocks());
+    EXPECT_EQ(10, blockOrder[10]); // short block stays last
+    for(int i = 0; i < N; i++) {
+        // each example comes from one of the blocks read for its window
+        const int window = i / windowSize;
+        const int block = order[i] / blockSize;
+        bool found = false;
+        for(int k = window * 3; k < window * 3 + 3 && k < 11; k++) {
+            found = found || blockOrder[k] == block;
+        }
+        EXPECT_TRUE(found);
+        const int loadPosition = sampler->getLoadPosition(order[i]);
+        EXPECT_EQ(window, loadPosition / windowSize);
+    }
+    delete sampler;
+}
+
+TEST(testEpochSampler, blockShuffleNeedsWholeBlocksPerWindow) {
+    EXPECT_THROW(EpochSampler::instance("block", 100, 30, 100, 0), runtime_error);
+    EXPECT_THROW(EpochSampler::instance("foo", 100, 10, 100, 0), runtime_error);
+}
+
+}
+
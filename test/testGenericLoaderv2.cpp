@@ -0,0 +1,70 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "loaders/GenericLoaderv2.h"
+#include "loaders/NorbLoader.h"
+#include "normalize/NormalizationHelper.h"
+#include "util/FileHelper.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+
+using namespace std;
+
+TEST(testGenericLoaderv2, loadNormalizedMatchesNormalizationHelper) {
+    const int N = 9;
+    const int numPlanes = 3;
+    const int imageSize = 4;
+    const int cubeSize = numPlanes * imageSize * imageSize;
+    unsigned char *images = new unsigned char[N * cubeSize];
+    int *labels = new int[N];
+    for(int i = 0; i < N * cubeSize; i++) {
+        images[i] = (unsigned char)((i * 53) % 256);
+    }
+    for(int n = 0; n < N; n++) {
+        labels[n] = n % 4;
+    }
+    NorbLoader::writeImages("~testloaderv2-dat.mat", images, N, numPlanes, imageSize);
+    NorbLoader::writeLabels("~testloaderv2-cat.mat", labels, N);
+
+    GenericLoaderv2 loader("~testloaderv2-dat.mat");
+    const float translate = -127.3f;
+    const float scale = 1.0f / 64.1f;
+    const int startN = 2;
+    const int numExamples = 6;
+    const int numElements = numExamples * cubeSize;
+    float *expected = new float[numElements];
+    int *expectedLabels = new int[numExamples];
+    loader.load(expected, expectedLabels, startN, numExamples);
+    NormalizationHelper::normalize(expected, numElements, - translate, 1.0f / scale);
+
+    float *fused = new float[numElements];
+    int *fusedLabels = new int[numExamples];
+    loader.load(fused, fusedLabels, startN, numExamples, translate, scale);
+    for(int i = 0; i < numElements; i++) {
+        EXPECT_FLOAT_NEAR(expected[i], fused[i]);
+        EXPECT_FLOAT_NEAR((images[startN * cubeSize + i] + translate) * scale, fused[i]);
+    }
+    for(int n = 0; n < numExamples; n++) {
+        EXPECT_EQ(labels[startN + n], fusedLabels[n]);
+        EXPECT_EQ(expectedLabels[n], fusedLabels[n]);
+    }
+
+    // a smaller load afterwards reuses the byte buffer
+    loader.load(fused, fusedLabels, startN, 2, translate, scale);
+    for(int i = 0; i < 2 * cubeSize; i++) {
+        EXPECT_FLOAT_NEAR(expected[i], fused[i]);
+    }
+
+    delete[] fusedLabels;
+    delete[] fused;
+    delete[] expectedLabels;
+    delete[] expected;
+    delete[] labels;
+    delete[] images;
+    FileHelper::remove("~testloaderv2-dat.mat");
+    FileHelper::remove("~testloaderv2-cat.mat");
+}
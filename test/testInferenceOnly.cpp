@@ -0,0 +1,293 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+
+#include "EasyCL.h"
+
+#include "net/NeuralNet.h"
+#include "layer/LayerMakers.h"
+#include "conv/ConvolutionalLayer.h"
+#include "activate/ActivationLayer.h"
+#include "pooling/PoolingLayer.h"
+#include "fc/FullyConnectedLayer.h"
+#include "conv/Forward1.h"
+#include "conv/ForwardFc.h"
+#include "util/ReducedPrecision.h"
+#include "weights/WeightsPersister.h"
+#include "clblas/ClBlasInstance.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "test/WeightRandomizer.h"
+
+using namespace std;
+
+namespace {
+    const int batchSize = 4;
+    const int numPlanes = 2;
+    const int imageSize = 8;
+
+    NeuralNet *createNet(EasyCL *cl, bool inferenceOnly, bool shareActivations = false, string deviceWeights = "fp32") {
+        NeuralNet *net = new NeuralNet(cl, numPlanes, imageSize);
+        net->setInferenceOnly(inferenceOnly);
+        net->setDeviceWeights(deviceWeights);
+        net->addLayer(ConvolutionalMaker::instance()->numFilters(4)->filterSize(3)->padZeros()->biased());
+        net->addLayer(ActivationMaker::instance()->relu());
+        net->addLayer(PoolingMaker::instance()->poolingSize(2));
+        net->addLayer(ConvolutionalMaker::instance()->numFilters(4)->filterSize(3)->padZeros()->biased());
+        net->addLayer(ActivationMaker::instance()->tanh());
+        net->addLayer(FullyConnectedMaker::instance()->numPlanes(3)->imageSize(1)->biased());
+        net->addLayer(SoftMaxMaker::instance());
+        net->setShareActivations(shareActivations);
+        net->setBatchSize(batchSize);
+        return net;
+    }
+    void copyWeights(NeuralNet *source, NeuralNet *dest) {
+        for(int layerIdx = 0; layerIdx < source->getNumLayers(); layerIdx++) {
+            Layer *sourceLayer = source->getLayer(layerIdx);
+            const int persistSize = sourceLayer->getPersistSize();
+            if(persistSize == 0) {
+                continue;
+            }
+            float *array = new float[persistSize];
+            sourceLayer->persistToArray(array);
+            dest->getLayer(layerIdx)->unpersistFromArray(array);
+            delete[] array;
+        }
+    }
+    // the conv and fc weights, as the device sees them with 16-bit weights
+    void roundWeights(ConvolutionalLayer *layer, string dtype) {
+        const int numWeights = layer->getWeightsSize();
+        float *weights = new float[numWeights];
+        unsigned short *reduced = new unsigned short[numWeights];
+        if(dtype == "fp16") {
+            ReducedPrecision::floatsToHalves(layer->getWeights(), reduced, numWeights);
+            ReducedPrecision::halvesToFloats(reduced, weights, numWeights);
+        } else {
+            ReducedPrecision::floatsToBfloat16s(layer->getWeights(), reduced, numWeights);
+            ReducedPrecision::bfloat16sToFloats(reduced, weights, numWeights);
+        }
+        layer->initWeights(weights);
+        delete[] reduced;
+        delete[] weights;
+    }
+    void checkSameOutput(NeuralNet *expectedNet, NeuralNet *net, int seed) {
+        const int inputNumElements = batchSize * net->getInputCubeSize();
+        float *input = new float[inputNumElements];
+        WeightRandomizer::randomize(seed, input, inputNumElements, -1.0f, 1.0f);
+        expectedNet->forward(input);
+        net->forward(input);
+        const int outputNumElements = net->getOutputNumElements();
+        float const *expectedOutput = expectedNet->getOutput();
+        float const *output = net->getOutput();
+        for(int i = 0; i < outputNumElements; i++) {
+            EXPECT_FLOAT_NEAR(expectedOutput[i], output[i]);
+        }
+        delete[] input;
+    }
+}
+
+TEST(testInferenceOnly, sameOutputNoGradients) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *trainingNet = createNet(cl, false);
+    NeuralNet *net = createNet(cl, true);
+    EXPECT_FALSE(trainingNet->getInferenceOnly());
+    EXPECT_TRUE(net->getInferenceOnly());
+    copyWeights(trainingNet, net);
+
+    const int inputNumElements = batchSize * net->getInputCubeSize();
+    float *input = new float[inputNumElements];
+    WeightRandomizer::randomize(0, input, inputNumElements, -1.0f, 1.0f);
+    trainingNet->forward(input);
+    net->forward(input);
+    const int outputNumElements = net->getOutputNumElements();
+    float const *expectedOutput = trainingNet->getOutput();
+    float const *output = net->getOutput();
+    for(int i = 0; i < outputNumElements; i++) {
+        EXPECT_FLOAT_NEAR(expectedOutput[i], output[i]);
+    }
+
+    for(int layerIdx = 1; layerIdx < net->getNumLayers(); layerIdx++) {
+        EXPECT_TRUE(net->getLayer(layerIdx)->inferenceOnly);
+        EXPECT_FALSE(trainingNet->getLayer(layerIdx)->inferenceOnly);
+    }
+    ConvolutionalLayer *conv = dynamic_cast<ConvolutionalLayer *>(net->getLayer(4));
+    EXPECT_EQ(0, conv->backpropWeightsImpl);
+    EXPECT_EQ(0, conv->backwardImpl);
+    EXPECT_EQ(0, conv->gradWeightsWrapper);
+    EXPECT_EQ(0, conv->gradBiasWrapper);
+    EXPECT_EQ(0, conv->gradInputWrapper);
+    ConvolutionalLayer *trainingConv = dynamic_cast<ConvolutionalLayer *>(trainingNet->getLayer(4));
+    EXPECT_TRUE(trainingConv->backwardImpl != 0);
+    EXPECT_TRUE(trainingConv->gradInputWrapper != 0);
+    PoolingLayer *pooling = dynamic_cast<PoolingLayer *>(net->getLayer(3));
+    EXPECT_EQ(0, pooling->poolingBackpropImpl);
+    EXPECT_EQ(0, pooling->gradInputWrapper);
+    ActivationLayer *activation = dynamic_cast<ActivationLayer *>(net->getLayer(2));
+    EXPECT_EQ(0, activation->activationBackpropImpl);
+    EXPECT_EQ(0, activation->gradInputWrapper);
+
+    int labels[batchSize] = {0, 1, 2, 1};
+    EXPECT_THROW(net->backwardFromLabels(labels), runtime_error);
+
+    delete[] input;
+    delete net;
+    delete trainingNet;
+    delete cl;
+}
+
+TEST(testInferenceOnly, fusedLayers) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *trainingNet = createNet(cl, false);
+    NeuralNet *net = createNet(cl, true);
+    copyWeights(trainingNet, net);
+    EXPECT_EQ(1, net->fuseLayers());
+    ActivationLayer *activation = dynamic_cast<ActivationLayer *>(net->getLayer(2));
+    EXPECT_EQ(0, activation->activationPoolingBackwardImpl);
+
+    const int inputNumElements = batchSize * net->getInputCubeSize();
+    float *input = new float[inputNumElements];
+    WeightRandomizer::randomize(1, input, inputNumElements, -1.0f, 1.0f);
+    trainingNet->forward(input);
+    net->forward(input);
+    const int outputNumElements = net->getOutputNumElements();
+    float const *expectedOutput = trainingNet->getOutput();
+    float const *output = net->getOutput();
+    for(int i = 0; i < outputNumElements; i++) {
+        EXPECT_FLOAT_NEAR(expectedOutput[i], output[i]);
+    }
+
+    delete[] input;
+    delete net;
+    delete trainingNet;
+    delete cl;
+}
+
+TEST(testInferenceOnly, mustBeSetBeforeLayers) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *net = new NeuralNet(cl, numPlanes, imageSize);
+    net->setInferenceOnly(true);
+    net->setInferenceOnly(false);
+    net->addLayer(ConvolutionalMaker::instance()->numFilters(2)->filterSize(3)->padZeros()->biased());
+    EXPECT_THROW(net->setInferenceOnly(true), runtime_error);
+    delete net;
+    delete cl;
+}
+
+TEST(testInferenceOnly, sharedActivations) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *trainingNet = createNet(cl, false);
+    NeuralNet *net = createNet(cl, true, true);
+    EXPECT_TRUE(net->getShareActivations());
+    copyWeights(trainingNet, net);
+
+    // relu and tanh run in place; the pooling layer's output is live while relu's is
+    // read, so needs the second buffer, and the fc layer's is live while tanh's is
+    EXPECT_EQ(net->getLayer(1)->getOutputWrapper(), net->getLayer(2)->getOutputWrapper());
+    EXPECT_NE(net->getLayer(1)->getOutputWrapper(), net->getLayer(3)->getOutputWrapper());
+    EXPECT_EQ(net->getLayer(1)->getOutputWrapper(), net->getLayer(4)->getOutputWrapper());
+    EXPECT_EQ(net->getLayer(4)->getOutputWrapper(), net->getLayer(5)->getOutputWrapper());
+    EXPECT_EQ(net->getLayer(3)->getOutputWrapper(), net->getLayer(6)->getOutputWrapper());
+    EXPECT_TRUE(net->getLayer(1)->outputShared);
+    EXPECT_FALSE(net->getLayer(0)->outputShared);
+    EXPECT_FALSE(net->getLayer(7)->outputShared);
+
+    checkSameOutput(trainingNet, net, 2);
+    // after forward, outputs that later layers wrote over cant be read
+    EXPECT_THROW(net->getOutput(1), runtime_error);
+    EXPECT_THROW(net->getLayer(2)->getOutputWrapper(), runtime_error);
+    EXPECT_THROW(net->getOutput(3), runtime_error);
+    EXPECT_THROW(net->getOutput(4), runtime_error);
+    EXPECT_NO_THROW(net->getOutput(5));
+    EXPECT_NO_THROW(net->getOutput(6));
+
+    // fusing plans again
+    EXPECT_EQ(1, trainingNet->fuseLayers());
+    EXPECT_EQ(1, net->fuseLayers());
+    checkSameOutput(trainingNet, net, 3);
+
+    net->setShareActivations(false);
+    net->setBatchSize(batchSize);
+    for(int layerIdx = 0; layerIdx < net->getNumLayers(); layerIdx++) {
+        EXPECT_FALSE(net->getLayer(layerIdx)->outputShared);
+    }
+    checkSameOutput(trainingNet, net, 4);
+    EXPECT_NO_THROW(net->getOutput(1));
+
+    delete net;
+    delete trainingNet;
+    delete cl;
+}
+
+TEST(testInferenceOnly, sharedActivationsNeedInferenceOnly) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *net = new NeuralNet(cl, numPlanes, imageSize);
+    EXPECT_THROW(net->setShareActivations(true), runtime_error);
+    delete net;
+    delete cl;
+}
+
+TEST(testInferenceOnly, reducedDeviceWeights) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *trainingNet = createNet(cl, false);
+    string dtypes[] = {"fp16", "bf16"};
+    for(int i = 0; i < 2; i++) {
+        // an fp32 net with the weights rounded as the device sees them, vs the 16-bit net
+        NeuralNet *roundedNet = createNet(cl, true);
+        NeuralNet *net = createNet(cl, true, false, dtypes[i]);
+        copyWeights(trainingNet, roundedNet);
+        copyWeights(trainingNet, net);
+        roundWeights(dynamic_cast<ConvolutionalLayer *>(roundedNet->getLayer(1)), dtypes[i]);
+        roundWeights(dynamic_cast<ConvolutionalLayer *>(roundedNet->getLayer(4)), dtypes[i]);
+        roundWeights(dynamic_cast<FullyConnectedLayer *>(roundedNet->getLayer(6))->convolutionalLayer, dtypes[i]);
+        checkSameOutput(roundedNet, net, 5 + i);
+
+        // the conv layers read 16-bit weights with Forward1, and the fc layer with ForwardFc
+        ConvolutionalLayer *conv = dynamic_cast<ConvolutionalLayer *>(net->getLayer(1));
+        ConvolutionalLayer *fc = dynamic_cast<FullyConnectedLayer *>(net->getLayer(6))->convolutionalLayer;
+        EXPECT_EQ(WeightsPersister::dtypeFromName(dtypes[i]), net->getDeviceWeights());
+        EXPECT_TRUE(dynamic_cast<Forward1 *>(conv->forwardImpl) != 0);
+        EXPECT_TRUE(dynamic_cast<ForwardFc *>(fc->forwardImpl) != 0);
+        EXPECT_TRUE(conv->reducedWeightsWrapper != 0);
+        EXPECT_TRUE(fc->reducedWeightsWrapper != 0);
+        EXPECT_THROW(conv->getWeightsWrapper(), runtime_error);
+
+        // the host keeps the fp32 weights, eg for weights files
+        ConvolutionalLayer *trainingConv = dynamic_cast<ConvolutionalLayer *>(trainingNet->getLayer(1));
+        for(int j = 0; j < conv->getWeightsSize(); j++) {
+            EXPECT_EQ(trainingConv->getWeights()[j], conv->getWeights()[j]);
+        }
+
+        delete net;
+        delete roundedNet;
+    }
+    delete trainingNet;
+    delete cl;
+}
+
+TEST(testInferenceOnly, reducedDeviceWeightsNeedInferenceOnly) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *net = new NeuralNet(cl, numPlanes, imageSize);
+    EXPECT_THROW(net->setDeviceWeights("fp16"), runtime_error);
+    net->setDeviceWeights("fp32");
+    net->setInferenceOnly(true);
+    EXPECT_THROW(net->setDeviceWeights("int8"), runtime_error);
+    net->setDeviceWeights("bf16");
+    EXPECT_THROW(net->setInferenceOnly(false), runtime_error);
+    net->addLayer(ConvolutionalMaker::instance()->numFilters(2)->filterSize(3)->padZeros()->biased());
+    EXPECT_THROW(net->setDeviceWeights("fp32"), runtime_error);
+    delete net;
+    delete cl;
+}
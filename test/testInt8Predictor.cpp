@@ -0,0 +1,181 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+#include <cmath>
+#include <algorithm>
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+
+#include "EasyCL.h"
+#include "net/NeuralNet.h"
+#include "netdef/NetdefToNet.h"
+#include "layer/LayerMakers.h"
+#include "conv/ConvolutionalLayer.h"
+#include "normalize/NormalizationLayer.h"
+#include "weights/WeightsPersister.h"
+#include "quantize/Int8Quantizer.h"
+#include "quantize/Int8Predictor.h"
+
+using namespace std;
+
+namespace {
+    const string netdef = "8c3z-relu-mp2-16c3z-relu-mp2-20n-tanh-10n";
+    NeuralNet *makeNet(EasyCL *cl) {
+        NeuralNet *net = new NeuralNet(cl);
+        net->addLayer(InputLayerMaker::instance()->numPlanes(2)->imageSize(12));
+        net->addLayer(NormalizationLayerMaker::instance()->translate(-0.5f)->scale(2.0f));
+        NetdefToNet::createNetFromNetdef(net, netdef);
+        return net;
+    }
+    float *makeImages(int numImages) {
+        const int imageCubeSize = 2 * 12 * 12;
+        float *images = new float[numImages * imageCubeSize];
+        for(int i = 0; i < numImages * imageCubeSize; i++) {
+            images[i] = 0.5f + 0.5f * sin(i * 0.37f) * cos(i * 0.011f);
+        }
+        return images;
+    }
+}
+
+TEST(testInt8Predictor, closeToFloat) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    NeuralNet *net = makeNet(cl);
+    const int batchSize = 16;
+    float *images = makeImages(batchSize);
+    Int8Quantizer::calibrate(net, images, batchSize, batchSize);
+
+    net->forward(images);
+    float const *floatOutput = net->getOutput();
+    const int numOutputs = batchSize * net->getOutputCubeSize();
+    Int8Predictor predictor(net);
+    float const *int8Output = predictor.forward(batchSize, images, -1);
+    int numSameLabel = 0;
+    for(int n = 0; n < batchSize; n++) {
+        float const *floatImage = floatOutput + n * 10;
+        float const *int8Image = int8Output + n * 10;
+        if(max_element(floatImage, floatImage + 10) - floatImage == max_element(int8Image, int8Image + 10) - int8Image) {
+            numSameLabel++;
+        }
+    }
+    for(int i = 0; i < numOutputs; i++) {
+        EXPECT_NEAR(floatOutput[i], int8Output[i], 0.02f);
+    }
+    EXPECT_GE(numSameLabel, batchSize - 1);
+
+    // a smaller batch, and an earlier output layer, reuse the buffers
+    float const *conv1Output = predictor.forward(3, images, 2);
+    net->forward(images);
+    float const *floatConv1Output = net->getLayer(2)->getOutput();
+    for(int i = 0; i < 3 * 8 * 12 * 12; i++) {
+        EXPECT_NEAR(floatConv1Output[i], conv1Output[i], 0.05f);
+    }
+
+    delete[] images;
+    delete net;
+    delete cl;
+}
+
+TEST(testInt8Predictor, int8WeightsFile) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    NeuralNet *net = makeNet(cl);
+    const int batchSize = 8;
+    float *images = makeImages(batchSize);
+    string filepath = "testInt8Predictor.dat";
+
+    // not calibrated yet
+    net->setWeightsStorage("int8");
+    EXPECT_THROW(WeightsPersister::persistWeights(filepath, "netDef=" + netdef, net, 0, 0, 0, 0, 0), runtime_error);
+    EXPECT_THROW(Int8Predictor predictor(net), runtime_error);
+
+    Int8Quantizer::calibrate(net, images, batchSize, batchSize);
+    WeightsPersister::persistWeights(filepath, "netDef=" + netdef, net, 0, 0, 0, 0, 0);
+
+    NeuralNet *loaded = makeNet(cl);
+    int epoch, batch, numRight;
+    float annealedLearningRate, loss;
+    EXPECT_TRUE(WeightsPersister::loadWeights(filepath, "netDef=" + netdef, loaded, &epoch, &batch,
+        &annealedLearningRate, &numRight, &loss));
+    for(int layerIdx = 1; layerIdx < net->getNumLayers(); layerIdx++) {
+        ConvolutionalLayer *layer = Int8Quantizer::getQuantizableLayer(net->getLayer(layerIdx));
+        if(layer != 0) {
+            EXPECT_EQ(layer->inputQuantizationScale,
+                Int8Quantizer::getQuantizableLayer(loaded->getLayer(layerIdx))->inputQuantizationScale);
+        }
+    }
+    EXPECT_EQ(-0.5f, dynamic_cast<NormalizationLayer *>(loaded->getLayer(1))->translate);
+
+    // the loaded weights quantize to the same int8 values, so give the same outputs
+    Int8Predictor predictor(net);
+    Int8Predictor loadedPredictor(loaded);
+    const int numOutputs = batchSize * net->getOutputCubeSize();
+    float *expected = new float[numOutputs];
+    float const *output = predictor.forward(batchSize, images, -1);
+    copy(output, output + numOutputs, expected);
+    float const *loadedOutput = loadedPredictor.forward(batchSize, images, -1);
+    for(int i = 0; i < numOutputs; i++) {
+        EXPECT_NEAR(expected[i], loadedOutput[i], 1e-5f);
+    }
+
+    delete[] expected;
+    delete[] images;
+    delete loaded;
+    delete net;
+    delete cl;
+}
+
+TEST(testInt8Predictor, smallBatchSameAsLargeBatch) {
+    // enough filters that a batch smaller than the thread pool splits them across threads
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    NeuralNet *net = new NeuralNet(cl);
+    net->addLayer(InputLayerMaker::instance()->numPlanes(2)->imageSize(12));
+    NetdefToNet::createNetFromNetdef(net, "64c3z-relu-48c3z-relu-10n");
+    const int batchSize = 8;
+    float *images = makeImages(batchSize);
+    Int8Quantizer::calibrate(net, images, batchSize, batchSize);
+
+    Int8Predictor predictor(net);
+    const int outputCubeSize = net->getOutputCubeSize();
+    float *expected = new float[batchSize * outputCubeSize];
+    float const *output = predictor.forward(batchSize, images, -1);
+    copy(output, output + batchSize * outputCubeSize, expected);
+    const int imageCubeSize = 2 * 12 * 12;
+    for(int n = 0; n < batchSize; n++) {
+        float const *single = predictor.forward(1, images + n * imageCubeSize, -1);
+        for(int i = 0; i < outputCubeSize; i++) {
+            EXPECT_EQ(expected[n * outputCubeSize + i], single[i]);
+        }
+    }
+    float const *pair = predictor.forward(2, images + 2 * imageCubeSize, -1);
+    for(int i = 0; i < 2 * outputCubeSize; i++) {
+        EXPECT_EQ(expected[2 * outputCubeSize + i], pair[i]);
+    }
+
+    delete[] expected;
+    delete[] images;
+    delete net;
+    delete cl;
+}
+
+TEST(testInt8Predictor, quantize) {
+    EXPECT_EQ(0, Int8Quantizer::quantize(0.0f, 0.1f));
+    EXPECT_EQ(3, Int8Quantizer::quantize(0.26f, 0.1f));
+    EXPECT_EQ(-3, Int8Quantizer::quantize(-0.26f, 0.1f));
+    EXPECT_EQ(127, Int8Quantizer::quantize(100.0f, 0.1f));
+    EXPECT_EQ(-127, Int8Quantizer::quantize(-100.0f, 0.1f));
+
+    float weights[] = { 1.1f, -2.0f, 0.5f,   0.0f, 0.0f, 0.0f };
+    signed char quantized[8];
+    float scales[2];
+    Int8Quantizer::quantizeFilters(2, 3, weights, quantized, 4, scales);
+    EXPECT_FLOAT_EQ(2.0f / 127, scales[0]);
+    EXPECT_EQ(-127, quantized[1]);
+    EXPECT_EQ(70, quantized[0]);
+    EXPECT_EQ(1.0f, scales[1]);
+    EXPECT_EQ(0, quantized[4]);
+}
+
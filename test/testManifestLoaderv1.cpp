@@ -0,0 +1,83 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include "loaders/ManifestLoaderv1.h"
+#include "util/JpegHelper.h"
+#include "util/FileHelper.h"
+#include "util/stringhelper.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+
+using namespace std;
+
+namespace {
+    const int N = 50; // so the manifest is at least the 1024 bytes isFormatFor reads
+    const int planes = 1;
+    const int imageSize = 8;
+    const int cubeSize = planes * imageSize * imageSize;
+
+    string jpegPath(int n) {
+        return "~testmanifest-" + toString(n) + ".jpeg";
+    }
+    // each image is a single grey level, so survives jpeg, and tells us which file it came from
+    void writeManifest(string manifestPath) {
+        unsigned char *image = new unsigned char[cubeSize];
+        ofstream manifest(manifestPath.c_str());
+        manifest << "# format=deepcl-jpeg-list-v1 N=" << N << " planes=" << planes << " width=" << imageSize << " height=" << imageSize << endl;
+        for(int n = 0; n < N; n++) {
+            memset(image, n * 5, cubeSize);
+            JpegHelper::write(jpegPath(n), planes, imageSize, imageSize, image);
+            manifest << jpegPath(n) << " " << (n % 7) << endl;
+        }
+        manifest.close();
+        delete[] image;
+    }
+    void removeManifest(string manifestPath) {
+        for(int n = 0; n < N; n++) {
+            FileHelper::remove(jpegPath(n));
+        }
+        FileHelper::remove(manifestPath);
+    }
+}
+
+TEST(testManifestLoaderv1, parallelMatchesSerial) {
+    writeManifest("~testmanifest.txt");
+    ManifestLoaderv1 serial("~testmanifest.txt");
+    serial.setNumThreads(1);
+    ManifestLoaderv1 parallel("~testmanifest.txt");
+    parallel.setNumThreads(4);
+
+    unsigned char *serialData = new unsigned char[N * cubeSize];
+    unsigned char *parallelData = new unsigned char[N * cubeSize];
+    int serialLabels[N];
+    int parallelLabels[N];
+    // the whole file, then a range not starting at the first record
+    const int starts[] = { 0, 7 };
+    const int counts[] = { N, 30 };
+    for(int i = 0; i < 2; i++) {
+        memset(parallelData, 0, N * cubeSize);
+        serial.load(serialData, serialLabels, starts[i], counts[i]);
+        parallel.load(parallelData, parallelLabels, starts[i], counts[i]);
+        EXPECT_EQ(0, memcmp(serialData, parallelData, counts[i] * cubeSize));
+        for(int localN = 0; localN < counts[i]; localN++) {
+            const int n = starts[i] + localN;
+            EXPECT_EQ(n % 7, parallelLabels[localN]);
+            EXPECT_EQ(serialLabels[localN], parallelLabels[localN]);
+            // and each image lands in its own record
+            const int diff = (int)parallelData[localN * cubeSize] - n * 5;
+            EXPECT_LE(diff < 0 ? - diff : diff, 2);
+        }
+    }
+
+    delete[] parallelData;
+    delete[] serialData;
+    removeManifest("~testmanifest.txt");
+}
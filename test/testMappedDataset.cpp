@@ -0,0 +1,109 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <cstring>
+
+#include "loaders/NorbLoader.h"
+#include "loaders/Kgsv2Loader.h"
+#include "loaders/MappedDataset.h"
+#include "util/FileHelper.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+
+using namespace std;
+
+TEST(testMappedDataset, norb) {
+    int N = 7;
+    int numPlanes = 2;
+    int imageSize = 5;
+    int cubeSize = numPlanes * imageSize * imageSize;
+    unsigned char *images = new unsigned char[N * cubeSize];
+    int *labels = new int[N];
+    for(int i = 0; i < N * cubeSize; i++) {
+        images[i] = (unsigned char)((i * 37) % 256);
+    }
+    for(int n = 0; n < N; n++) {
+        labels[n] = n * 3 % 5;
+    }
+    NorbLoader::writeImages("~testmapped-dat.mat", images, N, numPlanes, imageSize);
+    NorbLoader::writeLabels("~testmapped-cat.mat", labels, N);
+
+    unsigned char *loadedImages = new unsigned char[4 * cubeSize];
+    int *loadedLabels = new int[4];
+    {
+        // the dataset maps the files, so unmaps them before we remove them
+        MappedDataset dataset("~testmapped-dat.mat");
+        EXPECT_EQ(MappedDataset::NORB, dataset.getFormat());
+        EXPECT_EQ(N, dataset.getN());
+        EXPECT_EQ(numPlanes, dataset.getPlanes());
+        EXPECT_EQ(imageSize, dataset.getImageSize());
+        EXPECT_EQ(0, memcmp(images + 3 * cubeSize, dataset.getImage(3), cubeSize));
+
+        dataset.load(loadedImages, loadedLabels, 2, 4);
+        EXPECT_EQ(0, memcmp(images + 2 * cubeSize, loadedImages, 4 * cubeSize));
+        for(int n = 0; n < 4; n++) {
+            EXPECT_EQ(labels[2 + n], loadedLabels[n]);
+        }
+        EXPECT_THROW(dataset.load(loadedImages, loadedLabels, 5, 4), runtime_error);
+    }
+    FileHelper::remove("~testmapped-dat.mat");
+    FileHelper::remove("~testmapped-cat.mat");
+
+    delete[] loadedLabels;
+    delete[] loadedImages;
+    delete[] labels;
+    delete[] images;
+}
+
+TEST(testMappedDataset, mlv2) {
+    int N = 5;
+    int numPlanes = 3;
+    int imageSize = 7;
+    int cubeSize = numPlanes * imageSize * imageSize;
+    int recordSize = Kgsv2Loader::getRecordSize(numPlanes, imageSize);
+    long fileSize = 1024 + N * recordSize;
+    char *fileData = new char[fileSize];
+    memset(fileData, 0, fileSize);
+    strcpy(fileData, "mlv2-n=5-numplanes=3-imagewidth=7-imageheight=7-datatype=int-bpp=1\n");
+    for(int n = 0; n < N; n++) {
+        unsigned char *record = (unsigned char *)fileData + 1024 + n * recordSize;
+        record[0] = 'G';
+        record[1] = 'O';
+        int label = n * 11;
+        memcpy(record + 2, &label, 4);
+        for(int i = 6; i < recordSize; i++) {
+            record[i] = (unsigned char)((n * 71 + i * 13) % 256);
+        }
+    }
+    FileHelper::writeBinary("~testmapped.mlv2", fileData, fileSize);
+
+    unsigned char *images = new unsigned char[3 * cubeSize];
+    int *labels = new int[3];
+    {
+        MappedDataset dataset("~testmapped.mlv2");
+        EXPECT_EQ(MappedDataset::MLV2, dataset.getFormat());
+        EXPECT_EQ(N, dataset.getN());
+        EXPECT_EQ(numPlanes, dataset.getPlanes());
+        EXPECT_EQ(imageSize, dataset.getImageSize());
+        dataset.load(images, labels, 2, 3);
+    }
+    FileHelper::remove("~testmapped.mlv2");
+    for(int n = 0; n < 3; n++) {
+        const unsigned char *record = (unsigned char *)fileData + 1024 + (2 + n) * recordSize;
+        EXPECT_EQ((2 + n) * 11, labels[n]);
+        for(int i = 0; i < cubeSize; i++) {
+            int bit = (record[6 + i / 8] >> (7 - i % 8)) & 1;
+            EXPECT_EQ(bit * 255, images[n * cubeSize + i]);
+        }
+    }
+
+    delete[] labels;
+    delete[] images;
+    delete[] fileData;
+}
+
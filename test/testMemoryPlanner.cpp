@@ -0,0 +1,92 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+
+#include "net/MemoryPlanner.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+TEST(testMemoryPlanner, chainNeedsTwoBuffers) {
+    MemoryPlanner planner;
+    for(int step = 0; step < 4; step++) {
+        planner.addTensor(100, step, step + 1, -1);
+    }
+    planner.plan();
+    EXPECT_EQ(2, planner.getNumBuffers());
+    EXPECT_EQ(0, planner.bufferOf[0]);
+    EXPECT_EQ(1, planner.bufferOf[1]);
+    EXPECT_EQ(0, planner.bufferOf[2]);
+    EXPECT_EQ(1, planner.bufferOf[3]);
+    EXPECT_EQ(400, planner.getUnplannedSize());
+    EXPECT_EQ(200, planner.getPlannedSize());
+}
+
+TEST(testMemoryPlanner, inPlace) {
+    MemoryPlanner planner;
+    int conv = planner.addTensor(100, 0, 1, -1);
+    int relu = planner.addTensor(100, 1, 2, conv);
+    planner.addTensor(100, 2, 3, relu);
+    planner.plan();
+    EXPECT_EQ(1, planner.getNumBuffers());
+    EXPECT_EQ(100, planner.getPlannedSize());
+}
+
+TEST(testMemoryPlanner, inPlaceRejected) {
+    // source is still read after the step that would overwrite it
+    MemoryPlanner planner;
+    int source = planner.addTensor(100, 0, 2, -1);
+    planner.addTensor(100, 1, 2, source);
+    planner.plan();
+    EXPECT_EQ(2, planner.getNumBuffers());
+
+    // only one tensor can overwrite a source
+    MemoryPlanner planner2;
+    source = planner2.addTensor(100, 0, 1, -1);
+    planner2.addTensor(100, 1, 2, source);
+    planner2.addTensor(100, 1, 2, source);
+    planner2.plan();
+    EXPECT_EQ(0, planner2.bufferOf[1]);
+    EXPECT_EQ(1, planner2.bufferOf[2]);
+}
+
+TEST(testMemoryPlanner, bestFit) {
+    MemoryPlanner planner;
+    planner.addTensor(100, 0, 1, -1);
+    planner.addTensor(50, 0, 1, -1);
+    int small = planner.addTensor(40, 2, 3, -1);
+    int large = planner.addTensor(90, 2, 3, -1);
+    int larger = planner.addTensor(200, 4, 5, -1);
+    planner.plan();
+    EXPECT_EQ(2, planner.getNumBuffers());
+    EXPECT_EQ(1, planner.bufferOf[small]);
+    EXPECT_EQ(0, planner.bufferOf[large]);
+    // nothing fits, so the biggest buffer grows
+    EXPECT_EQ(0, planner.bufferOf[larger]);
+    EXPECT_EQ(200, planner.bufferSizes[0]);
+    EXPECT_EQ(50, planner.bufferSizes[1]);
+}
+
+TEST(testMemoryPlanner, onDemandAfterLastStep) {
+    // like a fused activation layer's output, written after everything else is dead
+    MemoryPlanner planner;
+    planner.addTensor(100, 0, 1, -1);
+    int onDemand = planner.addTensor(100, 3, 3, -1);
+    planner.addTensor(100, 1, 2, -1);
+    planner.plan();
+    EXPECT_EQ(2, planner.getNumBuffers());
+    EXPECT_EQ(0, planner.bufferOf[onDemand]);
+}
+
+TEST(testMemoryPlanner, invalidTensors) {
+    MemoryPlanner planner;
+    EXPECT_THROW(planner.addTensor(0, 0, 1, -1), runtime_error);
+    EXPECT_THROW(planner.addTensor(100, 2, 1, -1), runtime_error);
+    EXPECT_THROW(planner.addTensor(100, 0, 1, 0), runtime_error);
+    EXPECT_EQ(0, planner.getNumTensors());
+}
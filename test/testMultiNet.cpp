@@ -0,0 +1,186 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <vector>
+
+#include "EasyCL.h"
+
+#include "net/NeuralNet.h"
+#include "net/MultiNet.h"
+#include "layer/LayerMakers.h"
+#include "layer/Layer.h"
+#include "trainers/SGD.h"
+#include "trainers/TrainingContext.h"
+#include "clblas/ClBlasInstance.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "test/WeightRandomizer.h"
+
+using namespace std;
+
+namespace {
+    const int batchSize = 4;
+    const int numPlanes = 2;
+    const int imageSize = 8;
+    const int numClasses = 3;
+
+    NeuralNet *createModel(EasyCL *cl) {
+        NeuralNet *net = new NeuralNet(cl, numPlanes, imageSize);
+        net->addLayer(ConvolutionalMaker::instance()->numFilters(4)->filterSize(3)->padZeros()->biased());
+        net->addLayer(ActivationMaker::instance()->relu());
+        net->addLayer(FullyConnectedMaker::instance()->numPlanes(numClasses)->imageSize(1)->biased());
+        net->addLayer(SoftMaxMaker::instance());
+        return net;
+    }
+    NeuralNet *getColumn(MultiNet *multiNet, int column) {
+        return dynamic_cast< NeuralNet * >(multiNet->getNet(column));
+    }
+    // the columns are initialized randomly, so we give both multinets the same weights
+    void copyWeights(MultiNet *source, MultiNet *dest) {
+        for(int column = 0; column < source->getNumNets(); column++) {
+            NeuralNet *sourceNet = getColumn(source, column);
+            NeuralNet *destNet = getColumn(dest, column);
+            for(int layerIdx = 0; layerIdx < sourceNet->getNumLayers(); layerIdx++) {
+                const int persistSize = sourceNet->getLayer(layerIdx)->getPersistSize();
+                if(persistSize == 0) {
+                    continue;
+                }
+                float *array = new float[persistSize];
+                sourceNet->getLayer(layerIdx)->persistToArray(array);
+                destNet->getLayer(layerIdx)->unpersistFromArray(array);
+                delete[] array;
+            }
+        }
+    }
+    void checkSameOutput(MultiNet *expected, MultiNet *actual) {
+        const int outputNumElements = expected->getOutputNumElements();
+        float const *expectedOutput = expected->getOutput();
+        float const *output = actual->getOutput();
+        for(int i = 0; i < outputNumElements; i++) {
+            EXPECT_FLOAT_NEAR(expectedOutput[i], output[i]);
+        }
+    }
+}
+
+TEST(testMultiNet, deviceAverageMatchesHostAverage) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *model = createModel(cl);
+    for(int numColumns = 2; numColumns <= 4; numColumns++) {
+        MultiNet *multiNet = new MultiNet(numColumns, model, false);
+        EXPECT_FALSE(multiNet->isConcurrent());
+        EXPECT_TRUE(multiNet->childrenHaveOutputWrappers());
+        multiNet->setBatchSize(batchSize);
+
+        const int inputNumElements = batchSize * multiNet->getInputCubeSize();
+        float *input = new float[inputNumElements];
+        WeightRandomizer::randomize(numColumns, input, inputNumElements, -1.0f, 1.0f);
+        multiNet->forward(input);
+
+        const int outputNumElements = multiNet->getOutputNumElements();
+        vector<float> hostAverage(outputNumElements, 0.0f);
+        for(int column = 0; column < numColumns; column++) {
+            float const *columnOutput = multiNet->getNet(column)->getOutput();
+            for(int i = 0; i < outputNumElements; i++) {
+                hostAverage[i] += columnOutput[i] / numColumns;
+            }
+        }
+        float const *output = multiNet->getOutput();
+        for(int i = 0; i < outputNumElements; i++) {
+            EXPECT_FLOAT_NEAR(hostAverage[i], output[i]);
+        }
+
+        delete[] input;
+        delete multiNet;
+    }
+    delete model;
+    delete cl;
+}
+
+TEST(testMultiNet, serialByDefault) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *model = createModel(cl);
+    MultiNet *multiNet = new MultiNet(3, model);
+    EXPECT_FALSE(multiNet->isConcurrent());
+    for(int column = 0; column < 3; column++) {
+        EXPECT_EQ(cl, multiNet->getColumnCl(column));
+    }
+
+    delete multiNet;
+    delete model;
+    delete cl;
+}
+
+TEST(testMultiNet, concurrentColumnsOwnContexts) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *model = createModel(cl);
+    MultiNet *multiNet = new MultiNet(3, model, true);
+    EXPECT_TRUE(multiNet->isConcurrent());
+    EXPECT_EQ(cl, multiNet->getColumnCl(0));
+    EXPECT_NE(cl, multiNet->getColumnCl(1));
+    EXPECT_NE(cl, multiNet->getColumnCl(2));
+    EXPECT_NE(multiNet->getColumnCl(1), multiNet->getColumnCl(2));
+
+    // one column on its own isnt concurrent
+    MultiNet *single = new MultiNet(1, model, true);
+    EXPECT_FALSE(single->isConcurrent());
+
+    delete single;
+    delete multiNet;
+    delete model;
+    delete cl;
+}
+
+TEST(testMultiNet, concurrentMatchesSequential) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *model = createModel(cl);
+    MultiNet *sequential = new MultiNet(3, model, false);
+    MultiNet *concurrent = new MultiNet(3, model, true);
+    copyWeights(sequential, concurrent);
+    sequential->setBatchSize(batchSize);
+    concurrent->setBatchSize(batchSize);
+
+    const int inputNumElements = batchSize * model->getInputCubeSize();
+    float *input = new float[inputNumElements];
+    WeightRandomizer::randomize(0, input, inputNumElements, -1.0f, 1.0f);
+    int labels[batchSize];
+    for(int n = 0; n < batchSize; n++) {
+        labels[n] = n % numClasses;
+    }
+
+    // averaged on the device, vs on the host
+    sequential->forward(input);
+    concurrent->forward(input);
+    checkSameOutput(sequential, concurrent);
+    EXPECT_EQ(sequential->calcNumRight(labels), concurrent->calcNumRight(labels));
+
+    // the concurrent columns train with clones of the trainer, on their own contexts
+    SGD *sgd = SGD::instance(cl, 0.1f, 0.0f);
+    for(int batch = 0; batch < 3; batch++) {
+        TrainingContext context(0, batch);
+        BatchResult sequentialResult = sgd->trainFromLabels(sequential, &context, input, labels);
+        BatchResult concurrentResult = sgd->trainFromLabels(concurrent, &context, input, labels);
+        EXPECT_FLOAT_NEAR(sequentialResult.loss, concurrentResult.loss);
+        EXPECT_EQ(sequentialResult.numRight, concurrentResult.numRight);
+    }
+    EXPECT_EQ(sgd, concurrent->getColumnTrainer(0, sgd));
+    EXPECT_NE(sgd, concurrent->getColumnTrainer(1, sgd));
+    sequential->forward(input);
+    concurrent->forward(input);
+    checkSameOutput(sequential, concurrent);
+
+    delete sgd;
+    delete[] input;
+    delete concurrent;
+    delete sequential;
+    delete model;
+    delete cl;
+}
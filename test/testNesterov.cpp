@@ -0,0 +1,161 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <vector>
+
+#include "EasyCL.h"
+
+#include "net/NeuralNet.h"
+#include "layer/Layer.h"
+#include "layer/LayerMakers.h"
+#include "trainers/Nesterov.h"
+#include "trainers/TrainingContext.h"
+#include "clmath/CLMathWrapper.h"
+#include "weights/WeightsPersister.h"
+#include "clblas/ClBlasInstance.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "test/WeightRandomizer.h"
+
+using namespace std;
+
+namespace {
+    const int batchSize = 4;
+    const int numClasses = 3;
+    const float learningRate = 0.1f;
+    const float momentum = 0.9f;
+
+    NeuralNet *createNet(EasyCL *cl) {
+        NeuralNet *net = new NeuralNet(cl, 2, 6);
+        net->addLayer(ConvolutionalMaker::instance()->numFilters(4)->filterSize(3)->padZeros()->biased());
+        net->addLayer(ActivationMaker::instance()->tanh());
+        net->addLayer(FullyConnectedMaker::instance()->numPlanes(numClasses)->imageSize(1)->biased());
+        net->addLayer(SoftMaxMaker::instance());
+        net->setBatchSize(batchSize);
+        return net;
+    }
+    // the update as Nesterov did it with CLMathWrapper, before OptimizerKernels, for one
+    // weights array: look ahead by mom * dweights[t], then, once backward has filled
+    // gradWeights, step from the saved weights
+    class ReferenceState {
+    public:
+        int numWeights;
+        float *lastUpdate;
+        float *oldWeights;
+        CLWrapper *lastUpdateWrapper;
+        CLWrapper *oldWeightsWrapper;
+        ReferenceState(EasyCL *cl, int numWeights) :
+                numWeights(numWeights) {
+            lastUpdate = new float[numWeights];
+            oldWeights = new float[numWeights];
+            for(int i = 0; i < numWeights; i++) {
+                lastUpdate[i] = 0.0f;
+            }
+            lastUpdateWrapper = cl->wrap(numWeights, lastUpdate);
+            lastUpdateWrapper->copyToDevice();
+            oldWeightsWrapper = cl->wrap(numWeights, oldWeights);
+            oldWeightsWrapper->createOnDevice();
+        }
+        ~ReferenceState() {
+            delete lastUpdateWrapper;
+            delete oldWeightsWrapper;
+            delete[] lastUpdate;
+            delete[] oldWeights;
+        }
+        void loadFuture(CLWrapper *weightsWrapper) {
+            CLMathWrapper clOldWeights(oldWeightsWrapper);
+            CLMathWrapper clWeights(weightsWrapper);
+            CLMathWrapper clLastUpdate(lastUpdateWrapper);
+            clOldWeights = clWeights;
+            clWeights = clLastUpdate;
+            clWeights *= momentum;
+            clWeights += clOldWeights;
+        }
+        void update(CLWrapper *weightsWrapper, CLWrapper *gradWeightsWrapper) {
+            CLMathWrapper clLastUpdate(lastUpdateWrapper);
+            CLMathWrapper clOldWeights(oldWeightsWrapper);
+            CLMathWrapper clGradWeights(gradWeightsWrapper);
+            CLMathWrapper clWeights(weightsWrapper);
+            clGradWeights *= - learningRate;
+            clLastUpdate *= momentum;
+            clLastUpdate += clGradWeights;
+            clWeights = clOldWeights;
+            clWeights += clLastUpdate;
+        }
+    };
+}
+
+TEST(testNesterov, matchesClMathWrapperUpdate) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *net = createNet(cl);
+    NeuralNet *reference = createNet(cl);
+    const int numWeights = WeightsPersister::getTotalNumWeights(net);
+    float *weights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray(net, weights);
+    WeightsPersister::copyArrayToNetWeights(weights, reference);
+    float *initialWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray(net, initialWeights);
+
+    // the layers with weights, and a state for each weights and bias array
+    vector<Layer *> layers;
+    vector<ReferenceState *> states;
+    for(int layerIdx = 1; layerIdx < reference->getNumLayers() - 1; layerIdx++) {
+        Layer *layer = reference->getLayer(layerIdx);
+        if(layer->needsTrainerState()) {
+            layers.push_back(layer);
+            states.push_back(new ReferenceState(cl, layer->getWeightsSize()));
+            states.push_back(new ReferenceState(cl, layer->getBiasSize()));
+        }
+    }
+
+    const int inputNumElements = batchSize * net->getInputCubeSize();
+    float *input = new float[inputNumElements];
+    int labels[batchSize] = {0, 2, 1, 2};
+    Nesterov *nesterov = Nesterov::instance(cl, learningRate, momentum);
+    for(int batch = 0; batch < 4; batch++) {
+        WeightRandomizer::randomize(batch, input, inputNumElements, -1.0f, 1.0f);
+        TrainingContext context(0, batch);
+        nesterov->trainFromLabels(net, &context, input, labels);
+
+        for(int i = 0; i < (int)layers.size(); i++) {
+            states[i * 2]->loadFuture(layers[i]->getWeightsWrapper());
+            states[i * 2 + 1]->loadFuture(layers[i]->getBiasWrapper());
+        }
+        reference->forward(input);
+        reference->backwardFromLabels(labels);
+        for(int i = 0; i < (int)layers.size(); i++) {
+            states[i * 2]->update(layers[i]->getWeightsWrapper(), layers[i]->getGradWeightsWrapper());
+            states[i * 2 + 1]->update(layers[i]->getBiasWrapper(), layers[i]->getGradBiasWrapper());
+        }
+    }
+
+    float *expectedWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray(reference, expectedWeights);
+    WeightsPersister::copyNetWeightsToArray(net, weights);
+    int numChanged = 0;
+    for(int i = 0; i < numWeights; i++) {
+        EXPECT_FLOAT_NEAR(expectedWeights[i], weights[i]);
+        if(weights[i] != initialWeights[i]) {
+            numChanged++;
+        }
+    }
+    EXPECT_GT(numChanged, numWeights / 2);
+
+    for(int i = 0; i < (int)states.size(); i++) {
+        delete states[i];
+    }
+    delete[] initialWeights;
+    delete[] expectedWeights;
+    delete nesterov;
+    delete[] input;
+    delete[] weights;
+    delete reference;
+    delete net;
+    delete cl;
+}
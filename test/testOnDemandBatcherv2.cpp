@@ -0,0 +1,220 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <vector>
+
+#include "batch/OnDemandBatcherv2.h"
+#include "batch/Batcher.h"
+#include "batch/EpochSampler.h"
+#include "batch/NetAction.h"
+#include "net/Trainable.h"
+#include "loaders/GenericLoaderv2.h"
+#include "loaders/NorbLoader.h"
+#include "util/FileHelper.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace {
+    const int N = 23;
+    const int numPlanes = 1;
+    const int imageSize = 3;
+    const int cubeSize = numPlanes * imageSize * imageSize;
+    const int batchSize = 4;
+    const int fileReadBatches = 2; // so 3 file batches, the last one holding 7 examples
+
+    // just enough of a net for Batcher: remembers the batch size, and has no loss
+    class StubNet : public Trainable {
+    public:
+        int batchSize;
+        StubNet() : batchSize(0) {}
+        virtual int getOutputNumElements() const { return batchSize; }
+        virtual float calcLoss(float const *expectedValues) { return 0; }
+        virtual float calcLossFromLabels(int const *labels) { return 0; }
+        virtual void setBatchSize(int batchSize) { this->batchSize = batchSize; }
+        virtual void setTraining(bool training) {}
+        virtual int calcNumRight(int const *labels) { return 0; }
+        virtual void forward(float const*images) {}
+        virtual void backwardFromLabels(int const *labels) {}
+        virtual void backward(float const *expectedOutput) {}
+        virtual float const *getOutput() const { return 0; }
+        virtual LossLayerMaker *cloneLossLayerMaker() const { return 0; }
+        virtual int getOutputPlanes() const { return 1; }
+        virtual int getOutputSize() const { return 1; }
+        virtual int getInputCubeSize() const { return cubeSize; }
+        virtual int getOutputCubeSize() const { return 1; }
+    };
+    // copies each batch it is given
+    class RecordAction : public NetAction {
+    public:
+        vector< vector<float> > data;
+        vector< vector<int> > labels;
+        virtual void run(Trainable *net, int epoch, int batch, float const*const batchData, int const*const batchLabels) {
+            const int thisBatchSize = dynamic_cast<StubNet *>(net)->batchSize;
+            data.push_back(vector<float>(batchData, batchData + thisBatchSize * cubeSize));
+            labels.push_back(vector<int>(batchLabels, batchLabels + thisBatchSize));
+        }
+    };
+    void writeDataset(string filepath) {
+        unsigned char *images = new unsigned char[N * cubeSize];
+        int *labels = new int[N];
+        for(int i = 0; i < N * cubeSize; i++) {
+            images[i] = (unsigned char)((i * 7) % 256);
+        }
+        for(int n = 0; n < N; n++) {
+            labels[n] = n;
+        }
+        NorbLoader::writeImages(filepath + "-dat.mat", images, N, numPlanes, imageSize);
+        NorbLoader::writeLabels(filepath + "-cat.mat", labels, N);
+        delete[] labels;
+        delete[] images;
+    }
+    // the value writeDataset gives element i of example n
+    float imageValue(int n, int i) {
+        return (float)(((n * cubeSize + i) * 7) % 256);
+    }
+    // checks the batches of epoch visit each example once, in sampler's order for
+    // epoch, and that each image is the one for its label
+    void checkEpochFollowsSampler(RecordAction *action, int firstBatch, EpochSampler *sampler, int epoch) {
+        sampler->startEpoch(epoch);
+        int const *order = sampler->getOrder();
+        vector<int> seen(N, 0);
+        int pos = 0;
+        for(int batch = firstBatch; pos < N; batch++) {
+            ASSERT_LT(batch, (int)action->labels.size());
+            for(int i = 0; i < (int)action->labels[batch].size(); i++, pos++) {
+                const int n = action->labels[batch][i];
+                ASSERT_GE(n, 0);
+                ASSERT_LT(n, N);
+                seen[n]++;
+                EXPECT_EQ(order[pos], n);
+                for(int j = 0; j < cubeSize; j++) {
+                    EXPECT_EQ(imageValue(n, j), action->data[batch][i * cubeSize + j]);
+                }
+            }
+        }
+        EXPECT_EQ(N, pos);
+        for(int n = 0; n < N; n++) {
+            EXPECT_EQ(1, seen[n]);
+        }
+    }
+    void runEpochs(GenericLoaderv2 *loader, int numBuffers, int numEpochs, RecordAction *action) {
+        StubNet net;
+        OnDemandBatcherv2 batcher(&net, action, loader, N, fileReadBatches, batchSize, numBuffers);
+        for(int epoch = 0; epoch < numEpochs; epoch++) {
+            batcher.run(epoch);
+        }
+    }
+}
+
+TEST(testOnDemandBatcherv2, prefetchGivesSameBatches) {
+    writeDataset("~testondemand");
+    GenericLoaderv2 loader("~testondemand-dat.mat");
+
+    // one buffer means nothing is read ahead
+    RecordAction noPrefetch;
+    runEpochs(&loader, 1, 2, &noPrefetch);
+    RecordAction prefetch;
+    runEpochs(&loader, 3, 2, &prefetch);
+
+    // 2 epochs of 6 batches, the last one in each epoch partial
+    ASSERT_EQ(12, (int)noPrefetch.labels.size());
+    ASSERT_EQ(12, (int)prefetch.labels.size());
+    EXPECT_EQ(3, (int)noPrefetch.labels[5].size());
+    for(int batch = 0; batch < 12; batch++) {
+        EXPECT_EQ(noPrefetch.data[batch], prefetch.data[batch]);
+        EXPECT_EQ(noPrefetch.labels[batch], prefetch.labels[batch]);
+    }
+    // and in file order
+    int n = 0;
+    for(int batch = 0; batch < 6; batch++) {
+        for(int i = 0; i < (int)prefetch.labels[batch].size(); i++, n++) {
+            EXPECT_EQ(n, prefetch.labels[batch][i]);
+            EXPECT_EQ((float)((n * cubeSize * 7) % 256), prefetch.data[batch][i * cubeSize]);
+        }
+    }
+    EXPECT_EQ(N, n);
+
+    FileHelper::remove("~testondemand-dat.mat");
+    FileHelper::remove("~testondemand-cat.mat");
+}
+
+TEST(testOnDemandBatcherv2, destroyMidEpoch) {
+    writeDataset("~testondemand");
+    GenericLoaderv2 loader("~testondemand-dat.mat");
+    StubNet net;
+    RecordAction action;
+    for(int numTicks = 0; numTicks < 3; numTicks++) {
+        // the prefetch thread may still be loading when we delete the batcher
+        OnDemandBatcherv2 *batcher = new OnDemandBatcherv2(&net, &action, &loader, N, fileReadBatches, batchSize, 3);
+        for(int tick = 0; tick < numTicks; tick++) {
+            batcher->tick(0);
+        }
+        delete batcher;
+    }
+    // 0, then 1, then 2 file batches, of 2 batches each
+    EXPECT_EQ(6, (int)action.labels.size());
+    EXPECT_EQ(12, action.labels[5][0]);
+
+    FileHelper::remove("~testondemand-dat.mat");
+    FileHelper::remove("~testondemand-cat.mat");
+}
+
+TEST(testOnDemandBatcherv2, blockShuffleVisitsEachExampleOnce) {
+    writeDataset("~testondemand");
+    GenericLoaderv2 loader("~testondemand-dat.mat");
+    // blocks of 2, so the last block, of example 22, is short
+    EpochSampler *sampler = EpochSampler::instance("block", N, 2, fileReadBatches * batchSize, 5);
+    StubNet net;
+    RecordAction action;
+    OnDemandBatcherv2 batcher(&net, &action, &loader, N, fileReadBatches, batchSize, 3);
+    batcher.setSampler(sampler);
+    for(int epoch = 0; epoch < 2; epoch++) {
+        batcher.run(epoch);
+    }
+    ASSERT_EQ(12, (int)action.labels.size());
+    checkEpochFollowsSampler(&action, 0, sampler, 0);
+    checkEpochFollowsSampler(&action, 6, sampler, 1);
+    // and not just file order
+    bool shuffled = false;
+    for(int i = 0; i < (int)action.labels[0].size(); i++) {
+        shuffled = shuffled || action.labels[0][i] != i;
+    }
+    EXPECT_TRUE(shuffled);
+
+    delete sampler;
+    FileHelper::remove("~testondemand-dat.mat");
+    FileHelper::remove("~testondemand-cat.mat");
+}
+
+TEST(testBatcher, samplerGathersInMemory) {
+    float *data = new float[N * cubeSize];
+    int *labels = new int[N];
+    for(int n = 0; n < N; n++) {
+        labels[n] = n;
+        for(int j = 0; j < cubeSize; j++) {
+            data[n * cubeSize + j] = imageValue(n, j);
+        }
+    }
+    const char *modes[] = { "shuffle", "block" };
+    for(int m = 0; m < 2; m++) {
+        EpochSampler *sampler = EpochSampler::instance(modes[m], N, 2, fileReadBatches * batchSize, 11);
+        StubNet net;
+        RecordAction action;
+        NetActionBatcher batcher(&net, batchSize, N, data, labels, &action);
+        batcher.setSampler(sampler);
+        for(int epoch = 0; epoch < 2; epoch++) {
+            batcher.run(epoch);
+        }
+        ASSERT_EQ(12, (int)action.labels.size());
+        checkEpochFollowsSampler(&action, 0, sampler, 0);
+        checkEpochFollowsSampler(&action, 6, sampler, 1);
+        delete sampler;
+    }
+    delete[] labels;
+    delete[] data;
+}
@@ -0,0 +1,191 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+
+#include "EasyCL.h"
+
+#include "layer/LayerMakers.h"
+#include "input/InputLayer.h"
+#include "normalize/NormalizationLayer.h"
+#include "patches/RandomTranslations.h"
+#include "patches/Translator.h"
+#include "loss/SoftMaxLayer.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "test/WeightRandomizer.h"
+
+using namespace std;
+
+// compares the device kernels of the input-side layers, and softmax, with their host
+// code paths; a layer runs on the host when it, or the layer before it, has no cl
+
+namespace {
+    Layer *createLayer(LayerMaker2 *maker, EasyCL *cl, Layer *previousLayer) {
+        maker->setCl(cl);
+        return maker->createLayer(previousLayer);
+    }
+    InputLayer *createInput(EasyCL *cl, int numPlanes, int imageSize, int batchSize, float const *images) {
+        InputLayer *layer = dynamic_cast<InputLayer *>(createLayer(
+            InputLayerMaker::instance()->numPlanes(numPlanes)->imageSize(imageSize), cl, 0));
+        layer->setBatchSize(batchSize);
+        layer->in(images);
+        layer->forward();
+        return layer;
+    }
+}
+
+TEST(testOnDeviceLayers, normalization) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    const int batchSize = 5;
+    const int numPlanes = 3;
+    const int imageSize = 7;
+    const int numElements = batchSize * numPlanes * imageSize * imageSize;
+    float *images = new float[numElements];
+    WeightRandomizer::randomize(0, images, numElements, 0.0f, 255.0f);
+
+    InputLayer *hostInput = createInput(0, numPlanes, imageSize, batchSize, images);
+    InputLayer *deviceInput = createInput(cl, numPlanes, imageSize, batchSize, images);
+    Layer *host = createLayer(NormalizationLayerMaker::instance()->translate(-127.0f)->scale(0.02f), 0, hostInput);
+    Layer *device = createLayer(NormalizationLayerMaker::instance()->translate(-127.0f)->scale(0.02f), cl, deviceInput);
+    EXPECT_FALSE(host->hasOutputWrapper());
+    EXPECT_TRUE(device->hasOutputWrapper());
+    host->setBatchSize(batchSize);
+    device->setBatchSize(batchSize);
+    host->forward();
+    device->forward();
+    float const *hostOutput = host->getOutput();
+    float const *deviceOutput = device->getOutput();
+    for(int i = 0; i < numElements; i++) {
+        EXPECT_FLOAT_NEAR(hostOutput[i], deviceOutput[i]);
+    }
+
+    delete device;
+    delete host;
+    delete deviceInput;
+    delete hostInput;
+    delete[] images;
+    delete cl;
+}
+
+TEST(testOnDeviceLayers, translation) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    const int batchSize = 6;
+    const int numPlanes = 2;
+    const int imageSize = 9;
+    const int numElements = batchSize * numPlanes * imageSize * imageSize;
+    float *images = new float[numElements];
+    WeightRandomizer::randomize(1, images, numElements, -1.0f, 1.0f);
+
+    InputLayer *deviceInput = createInput(cl, numPlanes, imageSize, batchSize, images);
+    RandomTranslations *device = dynamic_cast<RandomTranslations *>(createLayer(
+        RandomTranslationsMaker::instance()->translateSize(3), cl, deviceInput));
+    EXPECT_TRUE(device->hasOutputWrapper());
+    device->setBatchSize(batchSize);
+    device->setTraining(true);
+    device->forward();
+
+    // the host path, with the translations the device layer drew
+    float *expected = new float[numElements];
+    for(int n = 0; n < batchSize; n++) {
+        Translator::translate(n, numPlanes, imageSize, device->translations[n * 2], device->translations[n * 2 + 1],
+            images, expected);
+    }
+    float const *deviceOutput = device->getOutput();
+    for(int i = 0; i < numElements; i++) {
+        EXPECT_FLOAT_NEAR(expected[i], deviceOutput[i]);
+    }
+
+    // not training, it just copies
+    device->setTraining(false);
+    deviceInput->in(images);
+    deviceInput->forward();
+    device->forward();
+    deviceOutput = device->getOutput();
+    for(int i = 0; i < numElements; i++) {
+        EXPECT_FLOAT_NEAR(images[i], deviceOutput[i]);
+    }
+
+    delete[] expected;
+    delete device;
+    delete deviceInput;
+    delete[] images;
+    delete cl;
+}
+
+namespace {
+    void compareSoftMax(SoftMaxMaker *hostMaker, SoftMaxMaker *deviceMaker, int numPlanes, int imageSize, int numClasses) {
+        EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+        const int batchSize = 7;
+        const int numElements = batchSize * numPlanes * imageSize * imageSize;
+        float *inputs = new float[numElements];
+        WeightRandomizer::randomize(2, inputs, numElements, -3.0f, 3.0f);
+
+        InputLayer *hostInput = createInput(0, numPlanes, imageSize, batchSize, inputs);
+        InputLayer *deviceInput = createInput(cl, numPlanes, imageSize, batchSize, inputs);
+        SoftMaxLayer *host = dynamic_cast<SoftMaxLayer *>(createLayer(hostMaker, 0, hostInput));
+        SoftMaxLayer *device = dynamic_cast<SoftMaxLayer *>(createLayer(deviceMaker, cl, deviceInput));
+        EXPECT_FALSE(host->onDevice());
+        EXPECT_TRUE(device->onDevice());
+        host->setBatchSize(batchSize);
+        device->setBatchSize(batchSize);
+        host->forward();
+        device->forward();
+        float const *hostOutput = host->getOutput();
+        float const *deviceOutput = device->getOutput();
+        for(int i = 0; i < numElements; i++) {
+            EXPECT_FLOAT_NEAR(hostOutput[i], deviceOutput[i]);
+        }
+
+        const int numLabels = batchSize * host->getNumLabelsPerExample();
+        int *labels = new int[numLabels];
+        for(int i = 0; i < numLabels; i++) {
+            labels[i] = (i * 5 + 1) % numClasses;
+        }
+        EXPECT_FLOAT_NEAR(host->calcLossFromLabels(labels), device->calcLossFromLabels(labels));
+        EXPECT_EQ(host->calcNumRightFromLabels(labels), device->calcNumRightFromLabels(labels));
+        // twice, so the second batch reuses the labels buffer
+        for(int it = 0; it < 2; it++) {
+            labels[it] = (labels[it] + 1) % numClasses;
+            host->calcGradInputFromLabels(labels);
+            device->calcGradInputFromLabels(labels);
+            float const *hostGradInput = host->getGradInput();
+            float const *deviceGradInput = device->getGradInput();
+            for(int i = 0; i < numElements; i++) {
+                EXPECT_FLOAT_NEAR(hostGradInput[i], deviceGradInput[i]);
+            }
+        }
+
+        float *expected = new float[numElements];
+        WeightRandomizer::randomize(3, expected, numElements, 0.0f, 1.0f);
+        EXPECT_FLOAT_NEAR(host->calcLoss(expected), device->calcLoss(expected));
+        host->calcGradInput(expected);
+        device->calcGradInput(expected);
+        float const *hostGradInput = host->getGradInput();
+        float const *deviceGradInput = device->getGradInput();
+        for(int i = 0; i < numElements; i++) {
+            EXPECT_FLOAT_NEAR(hostGradInput[i], deviceGradInput[i]);
+        }
+
+        delete[] expected;
+        delete[] labels;
+        delete device;
+        delete host;
+        delete deviceInput;
+        delete hostInput;
+        delete[] inputs;
+        delete cl;
+    }
+}
+
+TEST(testOnDeviceLayers, softmaxPerColumn) {
+    compareSoftMax(SoftMaxMaker::instance()->perColumn(), SoftMaxMaker::instance()->perColumn(), 10, 1, 10);
+}
+
+TEST(testOnDeviceLayers, softmaxPerPlane) {
+    compareSoftMax(SoftMaxMaker::instance()->perPlane(), SoftMaxMaker::instance()->perPlane(), 3, 4, 16);
+}
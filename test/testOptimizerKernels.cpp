@@ -0,0 +1,140 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <cstring>
+
+#include "EasyCL.h"
+
+#include "trainers/OptimizerKernels.h"
+#include "trainers/OptimizerCpu.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "test/WeightRandomizer.h"
+
+using namespace std;
+
+namespace testOptimizerKernels {
+
+// enough to span several cpu chunks, and a partial workgroup at the end
+const int N = 40000 + 17;
+
+// weights, gradWeights, and two state arrays, each with a host copy for the cpu
+// version, and one for the gpu version
+class Arrays {
+public:
+    float *host[4];
+    float *gpu[4];
+    CLWrapper *wrappers[4];
+    Arrays(EasyCL *cl) {
+        for(int i = 0; i < 4; i++) {
+            host[i] = new float[N];
+            gpu[i] = new float[N];
+            // state needs to be positive, since some optimizers take its sqrt
+            WeightRandomizer::randomize(i, host[i], N, i < 2 ? -1.0f : 0.1f, 1.0f);
+            memcpy(gpu[i], host[i], sizeof(float) * N);
+            wrappers[i] = cl->wrap(N, gpu[i]);
+            wrappers[i]->copyToDevice();
+        }
+    }
+    ~Arrays() {
+        for(int i = 0; i < 4; i++) {
+            delete wrappers[i];
+            delete[] host[i];
+            delete[] gpu[i];
+        }
+    }
+    void checkSame() {
+        for(int i = 0; i < 4; i++) {
+            wrappers[i]->copyToHost();
+            for(int j = 0; j < N; j += 997) {
+                EXPECT_FLOAT_NEAR(host[i][j], gpu[i][j]);
+            }
+            EXPECT_FLOAT_NEAR(host[i][N - 1], gpu[i][N - 1]);
+        }
+    }
+};
+
+TEST(testOptimizerKernels, sgd) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    OptimizerKernels kernels(cl);
+    Arrays *arrays = new Arrays(cl);
+
+    float weight = arrays->host[0][5];
+    float grad = arrays->host[1][5];
+    float lastUpdate = arrays->host[2][5];
+
+    kernels.sgd(N, 0.1f, 0.9f, 0.001f, arrays->wrappers[0], arrays->wrappers[1], arrays->wrappers[2]);
+    OptimizerCpu::sgd(N, 0.1f, 0.9f, 0.001f, arrays->host[0], arrays->host[1], arrays->host[2]);
+    arrays->checkSame();
+
+    float update = 0.9f * lastUpdate - 0.1f * grad;
+    EXPECT_FLOAT_NEAR(update, arrays->host[2][5]);
+    EXPECT_FLOAT_NEAR((weight + update) * 0.999f, arrays->host[0][5]);
+
+    delete arrays;
+    delete cl;
+}
+
+TEST(testOptimizerKernels, nesterov) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    OptimizerKernels kernels(cl);
+    Arrays *arrays = new Arrays(cl);
+
+    kernels.nesterovLoadFuture(N, 0.9f, arrays->wrappers[0], arrays->wrappers[1], arrays->wrappers[2]);
+    OptimizerCpu::nesterovLoadFuture(N, 0.9f, arrays->host[0], arrays->host[1], arrays->host[2]);
+    arrays->checkSame();
+
+    kernels.nesterov(N, 0.1f, 0.9f, arrays->wrappers[0], arrays->wrappers[1], arrays->wrappers[2], arrays->wrappers[3]);
+    OptimizerCpu::nesterov(N, 0.1f, 0.9f, arrays->host[0], arrays->host[1], arrays->host[2], arrays->host[3]);
+    arrays->checkSame();
+
+    delete arrays;
+    delete cl;
+}
+
+TEST(testOptimizerKernels, adagrad) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    OptimizerKernels kernels(cl);
+    Arrays *arrays = new Arrays(cl);
+
+    kernels.adagrad(N, 0.1f, arrays->wrappers[0], arrays->wrappers[1], arrays->wrappers[2]);
+    OptimizerCpu::adagrad(N, 0.1f, arrays->host[0], arrays->host[1], arrays->host[2]);
+    arrays->checkSame();
+
+    delete arrays;
+    delete cl;
+}
+
+TEST(testOptimizerKernels, rmsprop) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    OptimizerKernels kernels(cl);
+    Arrays *arrays = new Arrays(cl);
+
+    kernels.rmsprop(N, 0.1f, arrays->wrappers[0], arrays->wrappers[1], arrays->wrappers[2]);
+    OptimizerCpu::rmsprop(N, 0.1f, arrays->host[0], arrays->host[1], arrays->host[2]);
+    arrays->checkSame();
+
+    delete arrays;
+    delete cl;
+}
+
+TEST(testOptimizerKernels, adadelta) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    OptimizerKernels kernels(cl);
+    Arrays *arrays = new Arrays(cl);
+
+    kernels.adadelta(N, 0.9f, arrays->wrappers[0], arrays->wrappers[1], arrays->wrappers[2], arrays->wrappers[3]);
+    OptimizerCpu::adadelta(N, 0.9f, arrays->host[0], arrays->host[1], arrays->host[2], arrays->host[3]);
+    arrays->checkSame();
+
+    delete arrays;
+    delete cl;
+}
+
+}
+
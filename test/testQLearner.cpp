@@ -0,0 +1,235 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+
+#include "EasyCL.h"
+
+#include "net/NeuralNet.h"
+#include "layer/LayerMakers.h"
+#include "trainers/SGD.h"
+#include "weights/WeightsPersister.h"
+#include "qlearning/QLearner.h"
+#include "qlearning/ReplayMemory.h"
+#include "clblas/ClBlasInstance.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace {
+    // perception is [id, time since reset, 0, 0], so we can tell which actor, and
+    // which step, each frame came from
+    class ToyScenario : public Scenario {
+    public:
+        int id;
+        int time;
+        ToyScenario(int id) :
+            id(id),
+            time(0) {
+        }
+        virtual int getPerceptionSize() {
+            return 2;
+        }
+        virtual int getPerceptionPlanes() {
+            return 1;
+        }
+        virtual void getPerception(float *perception) {
+            perception[0] = (float)id;
+            perception[1] = (float)time;
+            perception[2] = 0;
+            perception[3] = 0;
+        }
+        virtual void reset() {
+            time = 0;
+        }
+        virtual int getNumActions() {
+            return 2;
+        }
+        virtual float act(int index) {
+            time++;
+            return index == id % 2 ? 1.0f : -1.0f;
+        }
+        virtual bool hasFinished() {
+            return time >= 4;
+        }
+    };
+    bool sameWeights(NeuralNet *one, NeuralNet *two) {
+        const int numWeights = WeightsPersister::getTotalNumWeights(one);
+        float *oneWeights = new float[numWeights];
+        float *twoWeights = new float[numWeights];
+        WeightsPersister::copyNetWeightsToArray(one, oneWeights);
+        WeightsPersister::copyNetWeightsToArray(two, twoWeights);
+        bool same = true;
+        for(int i = 0; i < numWeights; i++) {
+            if(oneWeights[i] != twoWeights[i]) {
+                same = false;
+            }
+        }
+        delete[] oneWeights;
+        delete[] twoWeights;
+        return same;
+    }
+    // records when the actors are synced, and checks the weights either side
+    class RecordingQLearner : public QLearner {
+    public:
+        vector<int> syncedAt;
+        RecordingQLearner(Trainer *trainer, Scenario *scenario, NeuralNet *net) :
+            QLearner(trainer, scenario, net) {
+        }
+        ReplayMemory *getReplayMemory() {
+            return replayMemory;
+        }
+        virtual void syncActors(NeuralNet *actorNet, float *weightsBuffer, int numUpdates) {
+            // the learner has trained since the last sync, and the actors not yet
+            EXPECT_FALSE(sameWeights(net, actorNet));
+            QLearner::syncActors(actorNet, weightsBuffer, numUpdates);
+            EXPECT_TRUE(sameWeights(net, actorNet));
+            syncedAt.push_back(numUpdates);
+        }
+    };
+    NeuralNet *createNet(EasyCL *cl) {
+        NeuralNet *net = new NeuralNet(cl, 1, 2);
+        net->addLayer(FullyConnectedMaker::instance()->numPlanes(2)->imageSize(1)->biased());
+        net->addLayer(SquareLossMaker::instance());
+        return net;
+    }
+}
+
+TEST(testQLearner, actorSyncIntervalAtLeastOne) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *net = createNet(cl);
+    SGD *sgd = SGD::instance(cl, 0.1f);
+    ToyScenario scenario(0);
+    QLearner qLearner(sgd, &scenario, net);
+    EXPECT_THROW(qLearner.setActorSyncInterval(0), runtime_error);
+    EXPECT_THROW(qLearner.setActorSyncInterval(-3), runtime_error);
+    qLearner.setActorSyncInterval(1);
+    EXPECT_EQ(1, qLearner.actorSyncInterval);
+
+    // the field is public, so runAsync checks too
+    qLearner.actorSyncInterval = 0;
+    vector< Scenario * > scenarios;
+    scenarios.push_back(&scenario);
+    EXPECT_THROW(qLearner.runAsync(scenarios, 1), runtime_error);
+
+    delete sgd;
+    delete net;
+    delete cl;
+}
+
+TEST(testQLearner, runAsyncAllActorsAndSyncs) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *net = createNet(cl);
+    SGD *sgd = SGD::instance(cl, 0.1f);
+    const int numActors = 3;
+    const int numSteps = 20;
+    vector< Scenario * > scenarios;
+    for(int a = 0; a < numActors; a++) {
+        scenarios.push_back(new ToyScenario(a));
+    }
+    RecordingQLearner qLearner(sgd, scenarios[0], net);
+    qLearner.setMaxSamples(8);
+    qLearner.setActorSyncInterval(5);
+    qLearner.runAsync(scenarios, numSteps);
+
+    ReplayMemory *memory = qLearner.getReplayMemory();
+    EXPECT_EQ(numActors, memory->getNumChains());
+    EXPECT_EQ(numActors * numSteps, memory->size());
+
+    // the learner trains from the first step with a transition, ie numSteps - 1 times
+    vector<int> expectedSyncs;
+    expectedSyncs.push_back(5);
+    expectedSyncs.push_back(10);
+    expectedSyncs.push_back(15);
+    EXPECT_EQ(expectedSyncs, qLearner.syncedAt);
+
+    // every actor's transitions are there, and each joins two frames from the same actor
+    MT19937 random;
+    random.seed(0);
+    const int batchSize = 300;
+    const int frameSize = 4;
+    float *befores = new float[batchSize * frameSize];
+    float *afters = new float[batchSize * frameSize];
+    int *actions = new int[batchSize];
+    float *rewards = new float[batchSize];
+    bool *isEndStates = new bool[batchSize];
+    memory->sample(random, batchSize, befores, afters, actions, rewards, isEndStates);
+    vector<int> countByActor(numActors, 0);
+    for(int n = 0; n < batchSize; n++) {
+        const int actor = (int)befores[n * frameSize];
+        ASSERT_GE(actor, 0);
+        ASSERT_LT(actor, numActors);
+        countByActor[actor]++;
+        EXPECT_EQ((float)actor, afters[n * frameSize]);
+        EXPECT_EQ(actions[n] == actor % 2 ? 1.0f : -1.0f, rewards[n]);
+        if(isEndStates[n]) {
+            EXPECT_EQ(3.0f, befores[n * frameSize + 1]);
+            EXPECT_EQ(0.0f, afters[n * frameSize + 1]);
+        } else {
+            EXPECT_EQ(befores[n * frameSize + 1] + 1, afters[n * frameSize + 1]);
+        }
+    }
+    for(int a = 0; a < numActors; a++) {
+        EXPECT_GT(countByActor[a], 0);
+    }
+
+    delete[] befores;
+    delete[] afters;
+    delete[] actions;
+    delete[] rewards;
+    delete[] isEndStates;
+    for(int a = 0; a < numActors; a++) {
+        delete scenarios[a];
+    }
+    delete sgd;
+    delete net;
+    delete cl;
+}
+
+TEST(testQLearner, runAsyncAfterStepNewMemory) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ClBlasInstance blasInstance;
+    NeuralNet *net = createNet(cl);
+    SGD *sgd = SGD::instance(cl, 0.1f);
+    vector< Scenario * > scenarios;
+    scenarios.push_back(new ToyScenario(0));
+    scenarios.push_back(new ToyScenario(1));
+    RecordingQLearner qLearner(sgd, scenarios[0], net);
+    qLearner.setMaxSamples(4);
+
+    float perception[4];
+    scenarios[0]->getPerception(perception);
+    int action = qLearner.step(0, false, perception);
+    for(int i = 0; i < 3; i++) {
+        float reward = scenarios[0]->act(action);
+        scenarios[0]->getPerception(perception);
+        action = qLearner.step(reward, false, perception);
+    }
+    EXPECT_EQ(1, qLearner.getReplayMemory()->getNumChains());
+    EXPECT_EQ(3, qLearner.getReplayMemory()->size());
+
+    qLearner.runAsync(scenarios, 4);
+    EXPECT_EQ(2, qLearner.getReplayMemory()->getNumChains());
+    EXPECT_EQ(8, qLearner.getReplayMemory()->size());
+
+    // and step() starts a new chain of its own, rather than referring to the old memory
+    scenarios[0]->getPerception(perception);
+    qLearner.step(0, false, perception);
+    scenarios[0]->getPerception(perception);
+    qLearner.step(1, false, perception);
+    EXPECT_EQ(9, qLearner.getReplayMemory()->size());
+
+    delete scenarios[0];
+    delete scenarios[1];
+    delete sgd;
+    delete net;
+    delete cl;
+}
@@ -0,0 +1,63 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cmath>
+#include <cstring>
+
+#include "util/ReducedPrecision.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+TEST(testReducedPrecision, half) {
+    EXPECT_EQ(0x3c00, ReducedPrecision::floatToHalf(1.0f));
+    EXPECT_EQ(0xc000, ReducedPrecision::floatToHalf(-2.0f));
+    EXPECT_EQ(0x2e66, ReducedPrecision::floatToHalf(0.1f));
+    EXPECT_EQ(0x7bff, ReducedPrecision::floatToHalf(65504.0f)); // largest half
+    EXPECT_EQ(0x7bff, ReducedPrecision::floatToHalf(65519.0f));
+    EXPECT_EQ(0x7c00, ReducedPrecision::floatToHalf(65520.0f));
+    EXPECT_EQ(0xfc00, ReducedPrecision::floatToHalf(-1e10f));
+    EXPECT_EQ(0x0001, ReducedPrecision::floatToHalf(ldexpf(1.0f, -24))); // smallest subnormal
+    EXPECT_EQ(0x0000, ReducedPrecision::floatToHalf(ldexpf(1.0f, -25))); // tie, to even
+    EXPECT_EQ(0x0001, ReducedPrecision::floatToHalf(ldexpf(1.5f, -25)));
+    EXPECT_EQ(0x0400, ReducedPrecision::floatToHalf(ldexpf(1.0f, -14))); // smallest normal
+    EXPECT_EQ(0x3c00, ReducedPrecision::floatToHalf(1.0f + ldexpf(1.0f, -11))); // tie, to even
+    EXPECT_EQ(0x3c02, ReducedPrecision::floatToHalf(1.0f + 3 * ldexpf(1.0f, -11))); // tie, to even
+    float nan = ReducedPrecision::halfToFloat(ReducedPrecision::floatToHalf(sqrtf(-1.0f)));
+    EXPECT_TRUE(nan != nan);
+
+    // every half, apart from nans, survives the round trip
+    for(int i = 0; i < 65536; i++) {
+        unsigned short half = (unsigned short)i;
+        if((half & 0x7c00) == 0x7c00 && (half & 0x3ff) != 0) {
+            continue;
+        }
+        EXPECT_EQ(half, ReducedPrecision::floatToHalf(ReducedPrecision::halfToFloat(half)));
+    }
+    EXPECT_EQ(ldexpf(1.0f, -24), ReducedPrecision::halfToFloat(0x0001));
+    EXPECT_EQ(-65504.0f, ReducedPrecision::halfToFloat(0xfbff));
+}
+
+TEST(testReducedPrecision, bfloat16) {
+    EXPECT_EQ(0x3f80, ReducedPrecision::floatToBfloat16(1.0f));
+    EXPECT_EQ(0x3f80, ReducedPrecision::floatToBfloat16(1.0f + ldexpf(1.0f, -8))); // tie, to even
+    EXPECT_EQ(0x3f82, ReducedPrecision::floatToBfloat16(1.0f + 3 * ldexpf(1.0f, -8))); // tie, to even
+    EXPECT_EQ(0x3f81, ReducedPrecision::floatToBfloat16(1.0f + ldexpf(1.0f, -8) + ldexpf(1.0f, -20)));
+    EXPECT_EQ(-2.0f, ReducedPrecision::bfloat16ToFloat(ReducedPrecision::floatToBfloat16(-2.0f)));
+    float nan = ReducedPrecision::bfloat16ToFloat(ReducedPrecision::floatToBfloat16(sqrtf(-1.0f)));
+    EXPECT_TRUE(nan != nan);
+
+    float values[4] = {0.1f, -3.0f, 1e30f, 0.0f};
+    unsigned short stored[4];
+    float restored[4];
+    ReducedPrecision::floatsToBfloat16s(values, stored, 4);
+    ReducedPrecision::bfloat16sToFloats(stored, restored, 4);
+    for(int i = 0; i < 4; i++) {
+        EXPECT_NEAR(values[i], restored[i], fabsf(values[i]) / 256);
+    }
+}
+
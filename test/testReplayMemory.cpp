@@ -0,0 +1,77 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "qlearning/ReplayMemory.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+TEST(testReplayMemory, sharesFramesAndWraps) {
+    const int frameSize = 3;
+    ReplayMemory memory(4, frameSize, 1);
+    float frame[frameSize];
+    frame[0] = frame[1] = frame[2] = 0;
+    long long lastFrame = memory.addFrame(frame);
+    for(int i = 1; i <= 10; i++) {
+        frame[0] = frame[1] = frame[2] = (float)i;
+        long long thisFrame = memory.addFrame(frame);
+        memory.addTransition(lastFrame, i, i * 10.0f, i % 3 == 0, thisFrame);
+        lastFrame = thisFrame;
+        EXPECT_EQ(i < 4 ? i : 4, memory.size());
+    }
+    // only the newest 4 transitions, 7 to 10, and their 5 frames, remain
+    EXPECT_FALSE(memory.hasFrame(5));
+    EXPECT_TRUE(memory.hasFrame(6));
+    EXPECT_EQ(6.0f, memory.getFrame(6)[2]);
+
+    MT19937 random;
+    random.seed(0);
+    const int batchSize = 50;
+    float *befores = new float[batchSize * frameSize];
+    float *afters = new float[batchSize * frameSize];
+    int *actions = new int[batchSize];
+    float *rewards = new float[batchSize];
+    bool *isEndStates = new bool[batchSize];
+    memory.sample(random, batchSize, befores, afters, actions, rewards, isEndStates);
+    for(int n = 0; n < batchSize; n++) {
+        const int action = actions[n];
+        EXPECT_GE(action, 7);
+        EXPECT_LE(action, 10);
+        EXPECT_EQ(action * 10.0f, rewards[n]);
+        EXPECT_EQ(action % 3 == 0, isEndStates[n]);
+        EXPECT_EQ((float)(action - 1), befores[n * frameSize]);
+        EXPECT_EQ((float)action, afters[n * frameSize + 2]);
+    }
+    delete[] befores;
+    delete[] afters;
+    delete[] actions;
+    delete[] rewards;
+    delete[] isEndStates;
+}
+
+TEST(testReplayMemory, skipsTransitionsWithOverwrittenFrames) {
+    // two chains, so 3 frame slots for capacity 1
+    ReplayMemory memory(1, 1, 2);
+    float value = 1;
+    long long before = memory.addFrame(&value);
+    value = 2;
+    long long after = memory.addFrame(&value);
+    memory.addTransition(before, 0, 1.0f, false, after);
+    value = 3;
+    memory.addFrame(&value);
+    value = 4;
+    memory.addFrame(&value); // overwrites 'before'
+    EXPECT_FALSE(memory.hasFrame(before));
+
+    MT19937 random;
+    random.seed(0);
+    float befores[1], afters[1], rewards[1];
+    int actions[1];
+    bool isEndStates[1];
+    EXPECT_THROW(memory.sample(random, 1, befores, afters, actions, rewards, isEndStates), runtime_error);
+}
+
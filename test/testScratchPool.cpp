@@ -0,0 +1,40 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "EasyCL.h"
+
+#include "clmath/ScratchPool.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+TEST(testScratchPool, reusesBySize) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    ScratchPool *pool = new ScratchPool(cl);
+
+    CLWrapper *a = pool->borrow(100);
+    CLWrapper *b = pool->borrow(100);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(100, a->size());
+    EXPECT_TRUE(a->isOnDevice());
+    pool->giveBack(a);
+
+    // same size comes back out, without allocating
+    EXPECT_EQ(a, pool->borrow(100));
+    EXPECT_EQ(2, pool->getNumBuffers());
+
+    // different size needs a new one
+    pool->giveBack(b);
+    CLWrapper *c = pool->borrow(50);
+    EXPECT_NE(b, c);
+    EXPECT_EQ(50, c->size());
+    EXPECT_EQ(3, pool->getNumBuffers());
+
+    delete pool;
+    delete cl;
+}
+
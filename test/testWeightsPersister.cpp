@@ -0,0 +1,167 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+#include <cmath>
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+
+#include "EasyCL.h"
+#include "net/NeuralNet.h"
+#include "util/FileHelper.h"
+#include "weights/WeightsPersister.h"
+
+#include "test/NetTestHelper.h"
+
+using namespace std;
+
+TEST(testWeightsPersister, layerTableRoundTrip) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    NeuralNet *net = NetTestHelper::createWeightsFileNet(cl, "8c3z-10n");
+    string filepath = "testWeightsPersister.dat";
+    WeightsPersister::persistWeights(filepath, "netdef=8c3z-10n", net, 3, 4, 0.1f, 5, 0.5f);
+
+    string configString;
+    EXPECT_TRUE(WeightsPersister::loadConfigString(filepath, configString));
+    EXPECT_EQ("8c3z-10n", configString);
+
+    long fileSize;
+    char *data = FileHelper::readBinary(filepath, &fileSize);
+    EXPECT_EQ(WeightsPersister::getPersistFileSize(net), fileSize);
+    EXPECT_EQ(4, reinterpret_cast<int *>(data)[1]);
+    EXPECT_EQ(3, reinterpret_cast<int *>(data + WeightsPersister::headerLength)[0]); // normalization, conv, fc
+    WeightsFileLayerEntry *entries = reinterpret_cast<WeightsFileLayerEntry *>(data + WeightsPersister::headerLength + 8);
+    EXPECT_EQ(1, entries[0].layerIndex);
+    EXPECT_EQ(2, entries[0].numElements);
+    EXPECT_EQ(8, entries[1].outputPlanes);
+    EXPECT_EQ(9, entries[1].outputSize);
+    for(int i = 0; i < 3; i++) {
+        EXPECT_EQ(0, entries[i].offset % 64);
+    }
+
+    NeuralNet *loaded = NetTestHelper::createWeightsFileNet(cl, "8c3z-10n");
+    int epoch, batch, numRight;
+    float annealedLearningRate, loss;
+    EXPECT_TRUE(WeightsPersister::loadWeights(filepath, "netdef=8c3z-10n", loaded, &epoch, &batch,
+        &annealedLearningRate, &numRight, &loss));
+    EXPECT_EQ(3, epoch);
+    EXPECT_EQ(5, numRight);
+    int numWeights = WeightsPersister::getTotalNumWeights(net);
+    float *weights = new float[numWeights];
+    float *loadedWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray(net, weights);
+    WeightsPersister::copyNetWeightsToArray(loaded, loadedWeights);
+    for(int i = 0; i < numWeights; i++) {
+        EXPECT_EQ(weights[i], loadedWeights[i]);
+    }
+
+    // corrupt one byte of the conv layer weights
+    data[entries[1].offset + 5] ^= 1;
+    FileHelper::writeBinary(filepath, data, fileSize);
+    EXPECT_THROW(WeightsPersister::loadWeights(filepath, "netdef=8c3z-10n", loaded, &epoch, &batch,
+        &annealedLearningRate, &numRight, &loss), runtime_error);
+
+    // different shape, same netdef string
+    NeuralNet *other = NetTestHelper::createWeightsFileNet(cl, "8c3-10n");
+    data[entries[1].offset + 5] ^= 1;
+    FileHelper::writeBinary(filepath, data, fileSize);
+    EXPECT_THROW(WeightsPersister::loadWeights(filepath, "netdef=8c3z-10n", other, &epoch, &batch,
+        &annealedLearningRate, &numRight, &loss), runtime_error);
+
+    FileHelper::remove(filepath);
+    delete[] data;
+    delete[] loadedWeights;
+    delete[] weights;
+    delete other;
+    delete loaded;
+    delete net;
+    delete cl;
+}
+
+TEST(testWeightsPersister, reducedPrecisionStorage) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    NeuralNet *net = NetTestHelper::createWeightsFileNet(cl, "8c3z-10n");
+    string filepath = "testWeightsPersister.dat";
+    int numWeights = WeightsPersister::getTotalNumWeights(net);
+    float *weights = new float[numWeights];
+    float *loadedWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray(net, weights);
+    long long fp32Size = WeightsPersister::getPersistFileSize(net);
+
+    string dtypes[] = {"fp16", "bf16"};
+    float tolerances[] = {1.0f / 1024, 1.0f / 128};
+    for(int d = 0; d < 2; d++) {
+        net->setWeightsStorage(dtypes[d]);
+        EXPECT_LT(WeightsPersister::getPersistFileSize(net), fp32Size * 6 / 10);
+        WeightsPersister::persistWeights(filepath, "netdef=8c3z-10n", net, 1, 0, 0, 0, 0);
+
+        NeuralNet *loaded = NetTestHelper::createWeightsFileNet(cl, "8c3z-10n");
+        int epoch, batch, numRight;
+        float annealedLearningRate, loss;
+        EXPECT_TRUE(WeightsPersister::loadWeights(filepath, "netdef=8c3z-10n", loaded, &epoch, &batch,
+            &annealedLearningRate, &numRight, &loss));
+        WeightsPersister::copyNetWeightsToArray(loaded, loadedWeights);
+        for(int i = 0; i < numWeights; i++) {
+            EXPECT_NEAR(weights[i], loadedWeights[i], fabs(weights[i]) * tolerances[d] + 1e-7f);
+        }
+        delete loaded;
+    }
+    EXPECT_THROW(net->setWeightsStorage("fp8"), runtime_error);
+
+    FileHelper::remove(filepath);
+    delete[] loadedWeights;
+    delete[] weights;
+    delete net;
+    delete cl;
+}
+
+
+TEST(testWeightsPersister, resumeNeedsFp32Checkpoint) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    NeuralNet *net = NetTestHelper::createWeightsFileNet(cl, "8c3z-10n");
+    string filepath = "testWeightsPersister.dat";
+    int numWeights = WeightsPersister::getTotalNumWeights(net);
+    float *weights = new float[numWeights];
+    float *loadedWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray(net, weights);
+    int epoch, batch, numRight;
+    float annealedLearningRate, loss;
+
+    // an fp32 checkpoint resumes with exactly the weights it was written from
+    WeightsPersister::persistWeights(filepath, "netdef=8c3z-10n", net, 2, 0, 0, 0, 0);
+    EXPECT_EQ(WeightsPersister::DTYPE_FLOAT32, WeightsPersister::getReducedDtype(filepath));
+    NeuralNet *resumed = NetTestHelper::createWeightsFileNet(cl, "8c3z-10n");
+    EXPECT_TRUE(WeightsPersister::loadCheckpoint(filepath, "netdef=8c3z-10n", resumed, &epoch, &batch,
+        &annealedLearningRate, &numRight, &loss));
+    EXPECT_EQ(2, epoch);
+    WeightsPersister::copyNetWeightsToArray(resumed, loadedWeights);
+    for(int i = 0; i < numWeights; i++) {
+        EXPECT_EQ(weights[i], loadedWeights[i]);
+    }
+
+    // a reduced file would resume from rounded weights, so is refused; inference can still load it
+    net->setWeightsStorage("bf16");
+    WeightsPersister::persistWeights(filepath, "netdef=8c3z-10n", net, 3, 0, 0, 0, 0);
+    EXPECT_EQ(WeightsPersister::DTYPE_BFLOAT16, WeightsPersister::getReducedDtype(filepath));
+    EXPECT_THROW(WeightsPersister::loadCheckpoint(filepath, "netdef=8c3z-10n", resumed, &epoch, &batch,
+        &annealedLearningRate, &numRight, &loss), runtime_error);
+    EXPECT_EQ(2, epoch);
+    EXPECT_TRUE(WeightsPersister::loadWeights(filepath, "netdef=8c3z-10n", resumed, &epoch, &batch,
+        &annealedLearningRate, &numRight, &loss));
+
+    // and theres nothing to refuse if theres no file yet
+    FileHelper::remove(filepath);
+    EXPECT_EQ(WeightsPersister::DTYPE_FLOAT32, WeightsPersister::getReducedDtype(filepath));
+    EXPECT_FALSE(WeightsPersister::loadCheckpoint(filepath, "netdef=8c3z-10n", resumed, &epoch, &batch,
+        &annealedLearningRate, &numRight, &loss));
+
+    delete[] loadedWeights;
+    delete[] weights;
+    delete resumed;
+    delete net;
+    delete cl;
+}
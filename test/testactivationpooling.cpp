@@ -0,0 +1,191 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+
+#include "EasyCL.h"
+
+#include "activate/ActivationFunction.h"
+#include "pooling/PoolingForward.h"
+#include "pooling/PoolingBackward.h"
+#include "pooling/ActivationPoolingForward.h"
+#include "pooling/ActivationPoolingBackward.h"
+#include "net/NeuralNet.h"
+#include "layer/LayerMakers.h"
+#include "forcebackprop/ForceBackpropLayerMaker.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "test/WeightRandomizer.h"
+
+using namespace std;
+
+namespace {
+    const int batchSize = 3;
+    const int numPlanes = 2;
+    const int inputSize = 5;
+    const int poolingSize = 2;
+
+    // activation, then PoolingForwardCpu, as the unfused layers would do
+    void forwardUnfused(EasyCL *cl, ActivationFunction const *fn, bool padZeros, float *input, float *activated, int *selectors, float *output) {
+        PoolingForward *poolingForward = PoolingForward::instanceSpecific(0, cl, padZeros, numPlanes, inputSize, poolingSize);
+        const int inputNumElements = poolingForward->getInputNumElements(batchSize);
+        for(int i = 0; i < inputNumElements; i++) {
+            activated[i] = fn->calc(input[i]);
+        }
+        poolingForward->forward(batchSize, activated, selectors, output);
+        delete poolingForward;
+    }
+    void checkForward(string activationName, bool padZeros) {
+        EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+        ActivationFunction *fn = ActivationFunction::fromName(activationName);
+        PoolingForward *poolingForward = PoolingForward::instanceSpecific(0, cl, padZeros, numPlanes, inputSize, poolingSize);
+        const int inputNumElements = poolingForward->getInputNumElements(batchSize);
+        const int outputNumElements = poolingForward->getOutputNumElements(batchSize);
+        float *input = new float[inputNumElements];
+        float *activated = new float[inputNumElements];
+        int *expectedSelectors = new int[outputNumElements];
+        float *expectedOutput = new float[outputNumElements];
+        int *selectors = new int[outputNumElements];
+        float *output = new float[outputNumElements];
+        WeightRandomizer::randomize(0, input, inputNumElements, -2.0f, 2.0f);
+        forwardUnfused(cl, fn, padZeros, input, activated, expectedSelectors, expectedOutput);
+
+        for(int idx = 0; idx < 2; idx++) {
+            ActivationPoolingForward *fused = ActivationPoolingForward::instanceSpecific(idx, cl, padZeros, numPlanes, inputSize, poolingSize, fn);
+            EXPECT_EQ(poolingForward->outputSize, fused->outputSize);
+            fused->forward(batchSize, input, selectors, output);
+            for(int i = 0; i < outputNumElements; i++) {
+                EXPECT_FLOAT_NEAR(expectedOutput[i], output[i]);
+                EXPECT_EQ(expectedSelectors[i], selectors[i]);
+            }
+            delete fused;
+        }
+
+        delete[] output;
+        delete[] selectors;
+        delete[] expectedOutput;
+        delete[] expectedSelectors;
+        delete[] activated;
+        delete[] input;
+        delete poolingForward;
+        delete fn;
+        delete cl;
+    }
+    void checkBackward(string activationName, bool padZeros) {
+        EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+        ActivationFunction *fn = ActivationFunction::fromName(activationName);
+        PoolingBackward *poolingBackward = PoolingBackward::instanceSpecific(0, cl, padZeros, numPlanes, inputSize, poolingSize);
+        const int inputNumElements = poolingBackward->getInputNumElements(batchSize);
+        const int outputNumElements = poolingBackward->getOutputNumElements(batchSize);
+        float *input = new float[inputNumElements];
+        float *activated = new float[inputNumElements];
+        int *selectors = new int[outputNumElements];
+        float *output = new float[outputNumElements];
+        float *gradOutput = new float[outputNumElements];
+        float *expectedGradInput = new float[inputNumElements];
+        float *gradInput = new float[inputNumElements];
+        WeightRandomizer::randomize(0, input, inputNumElements, -2.0f, 2.0f);
+        WeightRandomizer::randomize(1, gradOutput, outputNumElements, -1.0f, 1.0f);
+        forwardUnfused(cl, fn, padZeros, input, activated, selectors, output);
+
+        // pooling backward, then activation backward, as the unfused layers would do
+        poolingBackward->backward(batchSize, gradOutput, selectors, expectedGradInput);
+        for(int i = 0; i < inputNumElements; i++) {
+            expectedGradInput[i] *= fn->calcDerivative(activated[i]);
+        }
+
+        for(int idx = 0; idx < 2; idx++) {
+            ActivationPoolingBackward *fused = ActivationPoolingBackward::instanceSpecific(idx, cl, padZeros, numPlanes, inputSize, poolingSize, fn);
+            fused->backward(batchSize, output, gradOutput, selectors, gradInput);
+            for(int i = 0; i < inputNumElements; i++) {
+                EXPECT_FLOAT_NEAR(expectedGradInput[i], gradInput[i]);
+            }
+            delete fused;
+        }
+
+        delete[] gradInput;
+        delete[] expectedGradInput;
+        delete[] gradOutput;
+        delete[] output;
+        delete[] selectors;
+        delete[] activated;
+        delete[] input;
+        delete poolingBackward;
+        delete fn;
+        delete cl;
+    }
+}
+
+TEST(testactivationpooling, forward) {
+    checkForward("tanh", false);
+    checkForward("relu", false);
+    checkForward("elu", true);
+    checkForward("sigmoid", true);
+}
+
+TEST(testactivationpooling, backward) {
+    checkBackward("tanh", false);
+    checkBackward("relu", false);
+    checkBackward("elu", true);
+    checkBackward("sigmoid", true);
+}
+
+TEST(testactivationpooling, fusedNet) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    NeuralNet *net = new NeuralNet(cl, numPlanes, 6);
+    net->addLayer(ForceBackpropLayerMaker::instance());
+    net->addLayer(ActivationMaker::instance()->tanh());
+    net->addLayer(PoolingMaker::instance()->poolingSize(poolingSize));
+    net->addLayer(SquareLossMaker::instance());
+    net->setBatchSize(batchSize);
+
+    const int inputNumElements = batchSize * net->getInputCubeSize();
+    const int outputNumElements = batchSize * net->getOutputCubeSize();
+    const int activatedNumElements = net->getLayer(2)->getOutputNumElements();
+    float *input = new float[inputNumElements];
+    float *expectedOutput = new float[outputNumElements];
+    WeightRandomizer::randomize(0, input, inputNumElements, -2.0f, 2.0f);
+    WeightRandomizer::randomize(1, expectedOutput, outputNumElements, -1.0f, 1.0f);
+
+    net->forward(input);
+    net->backward(expectedOutput);
+    float *output = new float[outputNumElements];
+    float *activated = new float[activatedNumElements];
+    float *gradInput = new float[activatedNumElements];
+    copy(net->getOutput(), net->getOutput() + outputNumElements, output);
+    copy(net->getLayer(2)->getOutput(), net->getLayer(2)->getOutput() + activatedNumElements, activated);
+    copy(net->getLayer(2)->getGradInput(), net->getLayer(2)->getGradInput() + activatedNumElements, gradInput);
+
+    EXPECT_EQ(1, net->fuseLayers());
+    EXPECT_EQ(0, net->fuseLayers());
+    net->forward(input);
+    net->backward(expectedOutput);
+    float const *fusedOutput = net->getOutput();
+    for(int i = 0; i < outputNumElements; i++) {
+        EXPECT_FLOAT_NEAR(output[i], fusedOutput[i]);
+    }
+    float const *fusedGradInput = net->getLayer(2)->getGradInput();
+    for(int i = 0; i < activatedNumElements; i++) {
+        EXPECT_FLOAT_NEAR(gradInput[i], fusedGradInput[i]);
+    }
+    // the activation's own output is still there, if asked for
+    float const *fusedActivated = net->getLayer(2)->getOutput();
+    for(int i = 0; i < activatedNumElements; i++) {
+        EXPECT_FLOAT_NEAR(activated[i], fusedActivated[i]);
+    }
+
+    delete[] gradInput;
+    delete[] activated;
+    delete[] output;
+    delete[] expectedOutput;
+    delete[] input;
+    delete net;
+    delete cl;
+}
+
@@ -10,6 +10,7 @@
 
 #include "net/NeuralNet.h"
 #include "conv/Backward.h"
+#include "conv/Im2Col.h"
 #include "activate/ActivationFunction.h"
 #include "loss/LossLayer.h"
 #include "forcebackprop/ForceBackpropLayerMaker.h"
@@ -808,6 +809,9 @@ TEST(testbackward, compare_1_n_kgsgo_32c5) {
 
     compareSpecific(0, 1, 1, batchSize, dim);
     for(int instance=2; instance < Backward::getNumImplementations(); instance++) {
+        if(!Backward::plausiblyOptimal(instance, batchSize, dim)) {
+            continue; // eg winograd, which is 3x3 only
+        }
         cout << "instance " << instance << endl;
         dim.setInputSize(19);
         if(instance == 2 && maxWorkgroupSize < 19 * 19) {
@@ -817,6 +821,37 @@ TEST(testbackward, compare_1_n_kgsgo_32c5) {
     }
 }
 
+TEST(testbackward, compare_0_3_im2col_subbatches) { // batch doesnt divide into the sub-batches
+    LayerDimensions dim;
+    dim.setInputPlanes(8).setInputSize(19).setNumFilters(16).setFilterSize(5)
+        .setPadZeros(true).setBiased(true);
+    int64 oldBudget = Im2Col::getWorkspaceBudget();
+    int64 bytesPerImage = (dim.inputPlanes * dim.filterSizeSquared + dim.numFilters) * dim.outputSizeSquared * 4;
+    Im2Col::setWorkspaceBudget(3 * bytesPerImage);
+    compareSpecific(0, 3, 1, 7, dim);
+    Im2Col::setWorkspaceBudget(oldBudget);
+}
+
+TEST(testbackward, compare_0_n_winograd_pad) { // inputs dont divide into the tiles
+    LayerDimensions dim;
+    dim.setInputPlanes(6).setInputSize(13).setNumFilters(8).setFilterSize(3)
+        .setPadZeros(true).setBiased(true);
+    for(int instance = 5; instance <= 7; instance++) {
+        cout << "instance " << instance << endl;
+        compareSpecific(0, instance, 1, 5, dim);
+    }
+}
+
+TEST(testbackward, compare_0_n_winograd_nopad) {
+    LayerDimensions dim;
+    dim.setInputPlanes(7).setInputSize(9).setNumFilters(5).setFilterSize(3)
+        .setPadZeros(false).setBiased(false);
+    for(int instance = 5; instance <= 7; instance++) {
+        cout << "instance " << instance << endl;
+        compareSpecific(0, instance, 1, 4, dim);
+    }
+}
+
 TEST(SLOW_testbackward, compare_kgsgo_32c5mini) {
     int batchSize = 4;
     LayerDimensions dim;
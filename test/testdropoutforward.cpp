@@ -7,6 +7,7 @@
 #include "EasyCL.h"
 
 #include "dropout/DropoutForward.h"
+#include "dropout/DropoutMaskGenerator.h"
 #include "activate/ActivationFunction.h"
 
 #include "gtest/gtest.h"
@@ -386,5 +387,92 @@ TEST( testdropoutforward, comparespecific_0_1_dropout3_small2_tanh ) {
         .instance0(0).instance1(1) );
 }
 
+TEST( testdropoutforward, generatemasks_gpu_matches_cpu ) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    const int N = 100003; // not a multiple of 4
+    const float dropRatio = 0.3f;
+    DropoutMaskGenerator *generator = new DropoutMaskGenerator( cl, dropRatio, 12345, 2 );
+    unsigned char *gpuMasks = new unsigned char[N];
+    unsigned char *cpuMasks = new unsigned char[N];
+    CLWrapper *masksWrapper = cl->wrap( N, gpuMasks );
+    masksWrapper->createOnDevice();
+
+    for( int batch = 0; batch < 2; batch++ ) {
+        generator->generate( N, batch, masksWrapper );
+        masksWrapper->copyToHost();
+        generator->generateCpu( N, batch, cpuMasks );
+        int numDropped = 0;
+        for( int i = 0; i < N; i++ ) {
+            ASSERT_EQ( cpuMasks[i], gpuMasks[i] );
+            if( cpuMasks[i] == 0 ) {
+                numDropped++;
+            }
+        }
+        EXPECT_NEAR( dropRatio, numDropped / (float)N, 0.01f );
+    }
+    // different batches get different masks
+    generator->generateCpu( N, 0, gpuMasks );
+    int numSame = 0;
+    for( int i = 0; i < N; i++ ) {
+        numSame += gpuMasks[i] == cpuMasks[i] ? 1 : 0;
+    }
+    EXPECT_LT( numSame, N * 0.7f );
+
+    delete masksWrapper;
+    delete[] cpuMasks;
+    delete[] gpuMasks;
+    delete generator;
+    delete cl;
 }
 
+// known-answer vectors for philox4x32-10, from Random123's kat_vectors
+TEST( testdropoutforward, philox4x32_known_answers ) {
+    const unsigned int counters[3][4] = {
+        { 0x00000000u, 0x00000000u, 0x00000000u, 0x00000000u },
+        { 0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu },
+        { 0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u } };
+    const unsigned int keys[3][2] = {
+        { 0x00000000u, 0x00000000u },
+        { 0xffffffffu, 0xffffffffu },
+        { 0xa4093822u, 0x299f31d0u } };
+    const unsigned int expected[3][4] = {
+        { 0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u },
+        { 0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu },
+        { 0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u } };
+    for( int v = 0; v < 3; v++ ) {
+        unsigned int counter[4];
+        for( int i = 0; i < 4; i++ ) {
+            counter[i] = counters[v][i];
+        }
+        DropoutMaskGenerator::philox4x32( keys[v][0], keys[v][1], counter );
+        for( int i = 0; i < 4; i++ ) {
+            EXPECT_EQ( expected[v][i], counter[i] );
+        }
+    }
+}
+
+// the first four masks for seed 0, layer 0, batch 0 come from the zero counter, zero
+// key vector, so each is dropped exactly when its uint is below the threshold
+TEST( testdropoutforward, generatemasks_cpu_known_answers ) {
+    const unsigned int zeroKeyOutput[4] = { 0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u };
+    const int N = 4;
+    unsigned char masks[N];
+    for( int tenths = 0; tenths <= 10; tenths++ ) {
+        const float dropRatio = tenths / 10.0f;
+        const unsigned int threshold = DropoutMaskGenerator::calcThreshold( dropRatio );
+        DropoutMaskGenerator generator( 0, dropRatio, 0, 0 );
+        generator.generateCpu( N, 0, masks );
+        for( int i = 0; i < N; i++ ) {
+            EXPECT_EQ( zeroKeyOutput[i] < threshold ? 0 : 1, (int)masks[i] );
+        }
+    }
+    // eg at 0.7, 0x6627e8d5 and 0x9b00dbd8 are below 0.7 * 2^32, and the other two arent
+    DropoutMaskGenerator generator( 0, 0.7f, 0, 0 );
+    generator.generateCpu( N, 0, masks );
+    EXPECT_EQ( 0, masks[0] );
+    EXPECT_EQ( 1, masks[1] );
+    EXPECT_EQ( 1, masks[2] );
+    EXPECT_EQ( 0, masks[3] );
+}
+
+}
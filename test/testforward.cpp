@@ -7,6 +7,9 @@
 #include "EasyCL.h"
 #include "net/NeuralNet.h"
 #include "conv/Forward.h"
+#include "conv/Backward.h"
+#include "conv/BackpropWeights.h"
+#include "conv/Im2Col.h"
 #include "activate/ActivationFunction.h"
 #include "layer/Layer.h"
 #include "layer/LayerMakers.h"
@@ -567,7 +570,7 @@ TEST( testforward, compare_1_n_biased_nopad ) {
     dim.setInputPlanes( 8 ).setInputSize(19).setNumFilters( 8 )
         .setFilterSize( 5 )
         .setPadZeros( false ).setBiased( true );
-    for( int instance = 2; instance <= 7; instance++ ) {
+    for( int instance = 2; instance <= 8; instance++ ) {
         if( instance == 5 ) {
             continue; // forwardfc, cant use for inputimagesize != filtersize
         }
@@ -588,7 +591,7 @@ TEST( testforward, compare_1_n_biased_pad ) {
     dim.setInputPlanes( 8 ).setInputSize(19).setNumFilters( 8 )
         .setFilterSize( 5 )
         .setPadZeros( true ).setBiased( true );
-    for( int instance = 2; instance <= 7; instance++ ) {
+    for( int instance = 2; instance <= 8; instance++ ) {
         if( instance == 5 ) {
             continue; // forwardfc, cant use for inputimagesize != filtersize
         }
@@ -627,7 +630,7 @@ TEST( testforward, compare_1_4_fcscenario ) { // only need to do nopad, since fc
 }
 
 /* [[[cog
-    for n in [1, 4]:
+    for n in [1, 4, 8]:
         cog.outl(
             'TEST( testforward, compare_break1_0_{n} ) {{\n'
             '    LayerDimensions dim;\n'
@@ -651,8 +654,178 @@ TEST( testforward, compare_break1_0_4 ) {
     compareSpecific( false, 1, 1, dim, 0, 4 );
 }
 
+TEST( testforward, compare_break1_0_8 ) {
+    LayerDimensions dim;
+    dim.setInputPlanes( 1 ).setInputSize( 33 ).setNumFilters( 1 ).setFilterSize( 1 )
+        .setPadZeros( false ).setBiased( false );
+    compareSpecific( false, 1, 1, dim, 0, 8 );
+}
+
 // [[[end]]]
 
+TEST( testforward, compare_0_8_manyfilters_smallbatch ) { // so cpuim2col splits the filters across threads
+    LayerDimensions dim;
+    dim.setInputPlanes( 16 ).setInputSize( 19 ).setNumFilters( 128 )
+        .setFilterSize( 3 )
+        .setPadZeros( true ).setBiased( true );
+    compareSpecific( false, 3, 1, dim, 0, 8 );
+}
+
+TEST( testforward, compare_1_7_im2col_subbatches ) { // batch doesnt divide into the sub-batches
+    LayerDimensions dim;
+    dim.setInputPlanes( 8 ).setInputSize( 19 ).setNumFilters( 8 )
+        .setFilterSize( 5 )
+        .setPadZeros( true ).setBiased( true );
+    int64 oldBudget = Im2Col::getWorkspaceBudget();
+    int64 bytesPerImage = ( dim.inputPlanes * dim.filterSizeSquared + dim.numFilters ) * dim.outputSizeSquared * 4;
+    Im2Col::setWorkspaceBudget( 3 * bytesPerImage );
+    compareSpecific( false, 2, 7, dim, 1, 7 );
+    Im2Col::setWorkspaceBudget( oldBudget );
+}
+
+TEST( testforward, compare_0_n_winograd_pad ) { // outputs dont divide into the tiles
+    LayerDimensions dim;
+    dim.setInputPlanes( 8 ).setInputSize( 13 ).setNumFilters( 6 )
+        .setFilterSize( 3 )
+        .setPadZeros( true ).setBiased( true );
+    for( int instance = 9; instance <= 11; instance++ ) {
+        cout << "instance: " << instance << endl;
+        compareSpecific( false, 5, 2, dim, 0, instance );
+    }
+}
+
+TEST( testforward, compare_0_n_winograd_nopad ) {
+    LayerDimensions dim;
+    dim.setInputPlanes( 5 ).setInputSize( 9 ).setNumFilters( 7 )
+        .setFilterSize( 3 )
+        .setPadZeros( false ).setBiased( false );
+    for( int instance = 9; instance <= 11; instance++ ) {
+        cout << "instance: " << instance << endl;
+        compareSpecific( false, 4, 4, dim, 0, instance );
+    }
+}
+
+TEST( testforward, compare_1_9_winograd_subbatches ) {
+    LayerDimensions dim;
+    dim.setInputPlanes( 4 ).setInputSize( 10 ).setNumFilters( 4 )
+        .setFilterSize( 3 )
+        .setPadZeros( true ).setBiased( true );
+    int64 oldBudget = Im2Col::getWorkspaceBudget();
+    int tilesPerRow = ( dim.outputSize + 1 ) / 2;
+    int64 bytesPerImage = 16 * tilesPerRow * tilesPerRow * ( dim.inputPlanes + dim.numFilters ) * 4;
+    Im2Col::setWorkspaceBudget( 2 * bytesPerImage );
+    compareSpecific( false, 5, 5, dim, 1, 9 );
+    Im2Col::setWorkspaceBudget( oldBudget );
+}
+
+TEST( testforward, compare_0_12_fft_pad ) {
+    LayerDimensions dim;
+    dim.setInputPlanes( 8 ).setInputSize( 19 ).setNumFilters( 8 )
+        .setFilterSize( 5 )
+        .setPadZeros( true ).setBiased( true );
+    compareSpecific( false, 4, 4, dim, 0, 12 );
+}
+
+TEST( testforward, compare_0_12_fft_nopad_subbatches ) {
+    LayerDimensions dim;
+    dim.setInputPlanes( 4 ).setInputSize( 16 ).setNumFilters( 6 )
+        .setFilterSize( 7 )
+        .setPadZeros( false ).setBiased( false );
+    int64 oldBudget = Im2Col::getWorkspaceBudget();
+    int64 bytesPerImage = (int64)( dim.inputPlanes + dim.numFilters ) * 16 * 16 * 2 * 4;
+    Im2Col::setWorkspaceBudget( 2 * bytesPerImage );
+    compareSpecific( false, 5, 5, dim, 0, 12 );
+    Im2Col::setWorkspaceBudget( oldBudget );
+}
+
+TEST( testforward, fft_reuses_filters_until_generation_changes ) {
+    EasyCL *cl = EasyCL::createForFirstGpuOtherwiseCpu();
+    LayerDimensions dim;
+    dim.setInputPlanes( 3 ).setInputSize( 12 ).setNumFilters( 4 )
+        .setFilterSize( 5 )
+        .setPadZeros( true ).setBiased( false );
+    const int batchSize = 2;
+    const int outputNumElements = batchSize * dim.outputCubeSize;
+    float *input = new float[ batchSize * dim.inputCubeSize ];
+    float *weights = new float[ dim.filtersSize ];
+    float *expected = new float[ outputNumElements ];
+    float *output = new float[ outputNumElements ];
+    WeightRandomizer::randomize( 0, input, batchSize * dim.inputCubeSize, -0.5f, 0.5f );
+    WeightRandomizer::randomize( 1, weights, dim.filtersSize, -0.5f, 0.5f );
+    Forward *cpu = Forward::instanceSpecific( 0, cl, dim );
+    cpu->forward( batchSize, input, weights, 0, expected );
+
+    CLWrapper *inputWrapper = cl->wrap( batchSize * dim.inputCubeSize, input );
+    CLWrapper *weightsWrapper = cl->wrap( dim.filtersSize, weights );
+    CLWrapper *outputWrapper = cl->wrap( outputNumElements, output );
+    inputWrapper->copyToDevice();
+    weightsWrapper->copyToDevice();
+    Forward *fft = Forward::instanceSpecific( 12, cl, dim );
+    fft->setWeightsGeneration( 1 );
+    fft->forward( batchSize, inputWrapper, weightsWrapper, 0, outputWrapper );
+    outputWrapper->copyToHost();
+    for( int i = 0; i < outputNumElements; i++ ) {
+        EXPECT_NEAR( expected[i], output[i], 0.0001f );
+    }
+
+    // same generation: the filters transformed last time are used, not these
+    for( int i = 0; i < dim.filtersSize; i++ ) {
+        weights[i] *= 2;
+    }
+    weightsWrapper->copyToDevice();
+    fft->forward( batchSize, inputWrapper, weightsWrapper, 0, outputWrapper );
+    outputWrapper->copyToHost();
+    for( int i = 0; i < outputNumElements; i++ ) {
+        EXPECT_NEAR( expected[i], output[i], 0.0001f );
+    }
+
+    fft->setWeightsGeneration( 2 );
+    fft->forward( batchSize, inputWrapper, weightsWrapper, 0, outputWrapper );
+    outputWrapper->copyToHost();
+    for( int i = 0; i < outputNumElements; i++ ) {
+        EXPECT_NEAR( 2 * expected[i], output[i], 0.0002f );
+    }
+
+    delete fft;
+    delete cpu;
+    delete outputWrapper;
+    delete weightsWrapper;
+    delete inputWrapper;
+    delete[] output;
+    delete[] expected;
+    delete[] weights;
+    delete[] input;
+    delete cl;
+}
+
+TEST( testforward, fft_plausible_only_for_large_filters ) {
+    LayerDimensions dim;
+    dim.setInputPlanes( 4 ).setInputSize( 19 ).setNumFilters( 4 )
+        .setFilterSize( 3 )
+        .setPadZeros( true ).setBiased( true );
+    EXPECT_FALSE( Forward::plausiblyOptimal( 12, 4, dim ) );
+    EXPECT_FALSE( Backward::plausiblyOptimal( 8, 4, dim ) );
+    EXPECT_FALSE( BackpropWeights::plausiblyOptimal( 6, 4, dim ) );
+    dim.setFilterSize( 5 );
+    EXPECT_TRUE( Forward::plausiblyOptimal( 12, 4, dim ) );
+    EXPECT_TRUE( Backward::plausiblyOptimal( 8, 4, dim ) );
+    EXPECT_TRUE( BackpropWeights::plausiblyOptimal( 6, 4, dim ) );
+}
+
+TEST( testforward, winograd_not_plausible_for_5x5 ) {
+    LayerDimensions dim;
+    dim.setInputPlanes( 4 ).setInputSize( 10 ).setNumFilters( 4 )
+        .setFilterSize( 5 )
+        .setPadZeros( true ).setBiased( true );
+    for( int instance = 9; instance <= 11; instance++ ) {
+        EXPECT_FALSE( Forward::plausiblyOptimal( instance, 4, dim ) );
+    }
+    dim.setFilterSize( 3 );
+    for( int instance = 9; instance <= 11; instance++ ) {
+        EXPECT_TRUE( Forward::plausiblyOptimal( instance, 4, dim ) );
+    }
+}
+
 //TEST( SLOW_testforward, comparespecific ) {
 //    LayerDimensions dim;
 //    dim.setInputPlanes( 2 ).setInputSize(5).setNumFilters( 1 ).setFilterSize( 5 )
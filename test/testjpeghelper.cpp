@@ -8,6 +8,7 @@
 using namespace std;
 
 #include "util/JpegHelper.h"
+#include "util/JpegDecoder.h"
 
 #include "gtest/gtest.h"
 #include "test/gtest_supp.h"
@@ -44,3 +45,31 @@ TEST( testjpeghelper, writeread ) {
     delete[] data;
 }
 
+
+TEST( testjpeghelper, decoderreuse ) {
+    // one decoder, several files, including a bad one, should match JpegHelper::read each time
+    int planes = 3;
+    int imageSize = 16;
+    int linearSize = planes * imageSize * imageSize;
+    uchar *data = new uchar[linearSize];
+    uchar *expected = new uchar[linearSize];
+    uchar *actual = new uchar[linearSize];
+    JpegDecoder decoder;
+    for( int file = 0; file < 3; file++ ) {
+        for( int i = 0; i < linearSize; i++ ) {
+            data[i] = (uchar)( ( file * 31 + i * 7 ) % 255 );
+        }
+        JpegHelper::write("~foo.jpeg", planes, imageSize, imageSize, data );
+        JpegHelper::read( "~foo.jpeg", planes, imageSize, imageSize, expected );
+        decoder.read( "~foo.jpeg", planes, imageSize, imageSize, actual );
+        for( int i = 0; i < linearSize; i++ ) {
+            EXPECT_EQ( expected[i], actual[i] );
+        }
+        EXPECT_THROW( decoder.read( "~foo.jpeg", planes, imageSize + 1, imageSize, actual ), std::runtime_error );
+    }
+
+    delete[] actual;
+    delete[] expected;
+    delete[] data;
+}
+
@@ -12,6 +12,7 @@
 #include "net/NeuralNet.h"
 #include "conv/BackpropWeights.h"
 #include "conv/BackpropWeightsNaive.h"
+#include "conv/Im2Col.h"
 #include "layer/Layer.h"
 #include "conv/ConvolutionalLayer.h"
 #include "conv/ConvolutionalMaker.h"
@@ -698,7 +699,9 @@ public:
 
 namespace testupdateweights {
 
-void compareSpecific(bool debug, float learningRate, int its, int batchSize, LayerDimensions dim, int instance0, int instance1) {
+// absoluteTolerance: differences up to this are ok, whatever the relative difference, eg
+// for fft, whose rounding error is relative to the largest values, not to each one
+void compareSpecific(bool debug, float learningRate, int its, int batchSize, LayerDimensions dim, int instance0, int instance1, float absoluteTolerance = 0.0f) {
     cout << dim << endl;
 
     int outputNumElements = batchSize * dim.outputCubeSize;
@@ -785,7 +788,7 @@ void compareSpecific(bool debug, float learningRate, int its, int batchSize, Lay
     bool same = true;
     int errCount = 0;
     for(int i = 0; i < weightsSize; i++) {
-        if(abs(weights1[i] - weights2[i]) > 0.001 * max(abs(weights1[i]), abs(weights2[i]))) {
+        if(abs(weights1[i] - weights2[i]) > absoluteTolerance && abs(weights1[i] - weights2[i]) > 0.001 * max(abs(weights1[i]), abs(weights2[i]))) {
 //        if(abs(weights1[i] - weights2[i]) > abs(weights1[i]) / 10000.0f) {
             cout << "DIFF: weights i " << i << " " << weights1[i] << " != " << weights2[i] << endl;
             same = false;
@@ -851,6 +854,56 @@ TEST(SLOW_testupdateweights, compare_args) {
     compareSpecific(debug, learningRate, its, batchSize, dim, instance0, instance1);        
 }
 
+TEST(testupdateweights, compare_0_5_biased_pad) {
+    LayerDimensions dim;
+    dim.setInputSize(19).setInputPlanes(8).setNumFilters(32).setFilterSize(5)
+        .setBiased(1).setPadZeros(1);
+    compareSpecific(false, 1.0f, 1, 4, dim, 0, 5);
+}
+
+TEST(testupdateweights, compare_0_5_unbiased_nopad) {
+    LayerDimensions dim;
+    dim.setInputSize(28).setInputPlanes(4).setNumFilters(8).setFilterSize(5)
+        .setBiased(0).setPadZeros(0);
+    compareSpecific(false, 1.0f, 1, 3, dim, 0, 5);
+}
+
+TEST(testupdateweights, compare_0_4_im2col_subbatches) { // batch doesnt divide into the sub-batches
+    LayerDimensions dim;
+    dim.setInputSize(19).setInputPlanes(8).setNumFilters(32).setFilterSize(5)
+        .setBiased(1).setPadZeros(1);
+    int64 oldBudget = Im2Col::getWorkspaceBudget();
+    int64 bytesPerImage = (dim.inputPlanes * dim.filterSizeSquared + dim.numFilters) * dim.outputSizeSquared * 4;
+    Im2Col::setWorkspaceBudget(2 * bytesPerImage);
+    compareSpecific(false, 1.0f, 1, 5, dim, 0, 4);
+    Im2Col::setWorkspaceBudget(oldBudget);
+}
+
+TEST(testupdateweights, compare_0_6_fft_biased_pad) {
+    LayerDimensions dim;
+    dim.setInputSize(19).setInputPlanes(8).setNumFilters(16).setFilterSize(5)
+        .setBiased(1).setPadZeros(1);
+    compareSpecific(false, 1.0f, 1, 4, dim, 0, 6, 0.00001f);
+}
+
+TEST(testupdateweights, compare_0_6_fft_unbiased_nopad) {
+    LayerDimensions dim;
+    dim.setInputSize(16).setInputPlanes(4).setNumFilters(8).setFilterSize(7)
+        .setBiased(0).setPadZeros(0);
+    compareSpecific(false, 1.0f, 1, 3, dim, 0, 6, 0.00001f);
+}
+
+TEST(testupdateweights, compare_0_6_fft_subbatches) { // gradWeights summed across sub-batches
+    LayerDimensions dim;
+    dim.setInputSize(13).setInputPlanes(4).setNumFilters(6).setFilterSize(7)
+        .setBiased(1).setPadZeros(1);
+    int64 oldBudget = Im2Col::getWorkspaceBudget();
+    int64 bytesPerImage = (int64)(dim.inputPlanes + dim.numFilters) * 32 * 32 * 2 * 4;
+    Im2Col::setWorkspaceBudget(2 * bytesPerImage);
+    compareSpecific(false, 1.0f, 1, 5, dim, 0, 6, 0.00001f);
+    Im2Col::setWorkspaceBudget(oldBudget);
+}
+
 //    TEST(testupdateweights, compare_instance3_smaller2) {
 //        LayerDimensions dim;
 //        dim.setInputSize(96).setInputPlanes(1).setNumFilters(1).setFilterSize(6)